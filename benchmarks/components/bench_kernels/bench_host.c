@@ -0,0 +1,14 @@
+#include "bench_kernels.h"
+
+// Kept out of line so the native run pays for a real call like the module does
+__attribute__((noinline))
+int32_t bench_host_ping(int32_t value) {
+    return value ^ 0x5a5a;
+}
+
+__attribute__((noinline))
+void bench_host_invoke(bench_host_cb_t cb, int32_t n, void *user_data) {
+    for (int32_t i = 0; i < n; i++) {
+        cb(i, user_data);
+    }
+}
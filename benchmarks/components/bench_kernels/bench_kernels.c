@@ -0,0 +1,290 @@
+// Benchmark kernels. This file is compiled twice: natively as part of the
+// bench_kernels component, and to LLVM bitcode that is translated to bench.espb
+// (see benchmarks/README.md). Keep it free of libc calls so both builds run the
+// same code; the only imports are the bench_host_* functions.
+#include "bench_kernels.h"
+
+#define NOINLINE __attribute__((noinline))
+
+// --- CoreMark-like: linked list, state machine, CRC16 ---
+
+#define CM_LIST_LEN 32
+#define CM_BUF_LEN  64
+
+typedef struct CmNode {
+    struct CmNode *next;
+    int16_t data;
+    int16_t idx;
+} CmNode;
+
+static CmNode cm_nodes[CM_LIST_LEN];
+static uint8_t cm_buf[CM_BUF_LEN];
+
+static uint16_t crc16_byte(uint8_t data, uint16_t crc) {
+    for (int i = 0; i < 8; i++) {
+        uint8_t x = (uint8_t)((data ^ crc) & 1);
+        data >>= 1;
+        crc >>= 1;
+        if (x) crc ^= 0xa001;
+    }
+    return crc;
+}
+
+static CmNode *cm_reverse(CmNode *list) {
+    CmNode *prev = 0;
+    while (list) {
+        CmNode *next = list->next;
+        list->next = prev;
+        prev = list;
+        list = next;
+    }
+    return prev;
+}
+
+// States: 0 - start, 1 - digits, 2 - sign, 3 - invalid
+static int cm_state_machine(const uint8_t *buf, int len, int32_t *counts) {
+    int state = 0;
+    for (int i = 0; i < len; i++) {
+        uint8_t c = buf[i];
+        if (c >= '0' && c <= '9') {
+            state = (state == 3) ? 3 : 1;
+        } else if (c == '+' || c == '-') {
+            state = (state == 0) ? 2 : 3;
+        } else if (c == ',') {
+            counts[state]++;
+            state = 0;
+        } else {
+            state = 3;
+        }
+    }
+    return state;
+}
+
+int32_t bench_coremark(int32_t n) {
+    for (int i = 0; i < CM_LIST_LEN; i++) {
+        cm_nodes[i].next = (i + 1 < CM_LIST_LEN) ? &cm_nodes[i + 1] : 0;
+        cm_nodes[i].data = (int16_t)(i * 37 + 11);
+        cm_nodes[i].idx = (int16_t)i;
+    }
+    static const uint8_t pattern[8] = { '1', '2', ',', '-', '7', ',', 'x', ',' };
+    for (int i = 0; i < CM_BUF_LEN; i++) cm_buf[i] = pattern[i & 7];
+
+    CmNode *list = &cm_nodes[0];
+    uint16_t crc = 0;
+    int32_t counts[4] = { 0, 0, 0, 0 };
+    for (int32_t iter = 0; iter < n; iter++) {
+        list = cm_reverse(list);
+        for (CmNode *p = list; p; p = p->next) {
+            p->data = (int16_t)(p->data * 3 + iter);
+            crc = crc16_byte((uint8_t)p->data, crc);
+        }
+        cm_buf[iter & (CM_BUF_LEN - 1)] ^= (uint8_t)crc;
+        crc = crc16_byte((uint8_t)cm_state_machine(cm_buf, CM_BUF_LEN, counts), crc);
+    }
+    return (int32_t)(crc ^ (uint32_t)counts[0] ^ ((uint32_t)counts[1] << 8) ^ ((uint32_t)counts[2] << 16) ^
+                     ((uint32_t)counts[3] << 24));
+}
+
+// --- CRC32 ---
+
+#define CRC_BUF_LEN 1024
+
+static uint8_t crc_buf[CRC_BUF_LEN];
+
+int32_t bench_crc32(int32_t n) {
+    for (int i = 0; i < CRC_BUF_LEN; i++) crc_buf[i] = (uint8_t)(i * 7 + 3);
+    uint32_t crc = 0xffffffffu;
+    for (int32_t iter = 0; iter < n; iter++) {
+        for (int i = 0; i < CRC_BUF_LEN; i++) {
+            crc ^= crc_buf[i];
+            for (int b = 0; b < 8; b++) {
+                crc = (crc >> 1) ^ (0xedb88320u & (0u - (crc & 1u)));
+            }
+        }
+    }
+    return (int32_t)~crc;
+}
+
+// --- FIR (float) ---
+
+#define FIR_TAPS    16
+#define FIR_SAMPLES 256
+
+static float fir_in[FIR_SAMPLES + FIR_TAPS];
+static float fir_out[FIR_SAMPLES];
+static float fir_coef[FIR_TAPS];
+
+int32_t bench_fir(int32_t n) {
+    for (int i = 0; i < FIR_TAPS; i++) fir_coef[i] = (float)(i + 1) / (float)(FIR_TAPS * 8);
+    for (int i = 0; i < FIR_SAMPLES + FIR_TAPS; i++) fir_in[i] = (float)((i * 13) % 64 - 32) * 0.125f;
+
+    float acc_all = 0.0f;
+    for (int32_t iter = 0; iter < n; iter++) {
+        for (int i = 0; i < FIR_SAMPLES; i++) {
+            float acc = 0.0f;
+            for (int t = 0; t < FIR_TAPS; t++) acc += fir_coef[t] * fir_in[i + t];
+            fir_out[i] = acc;
+        }
+        acc_all += fir_out[iter & (FIR_SAMPLES - 1)];
+    }
+    return (int32_t)(acc_all * 1000.0f);
+}
+
+// --- FFT (float, radix-2, in place) ---
+
+#define FFT_N 64
+
+static float fft_re[FFT_N];
+static float fft_im[FFT_N];
+static float fft_wre[FFT_N / 2];
+static float fft_wim[FFT_N / 2];
+
+// Twiddles from one rotation by -2*pi/N: no libm in the module
+static void fft_twiddles(void) {
+    const float c = 0.99518472667f; // cos(2*pi/64)
+    const float s = 0.09801714033f; // sin(2*pi/64)
+    float re = 1.0f, im = 0.0f;
+    for (int k = 0; k < FFT_N / 2; k++) {
+        fft_wre[k] = re;
+        fft_wim[k] = im;
+        float nre = re * c + im * s;
+        im = im * c - re * s;
+        re = nre;
+    }
+}
+
+static void fft_run(void) {
+    for (int i = 1, j = 0; i < FFT_N; i++) {
+        int bit = FFT_N >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) {
+            float tr = fft_re[i]; fft_re[i] = fft_re[j]; fft_re[j] = tr;
+            float ti = fft_im[i]; fft_im[i] = fft_im[j]; fft_im[j] = ti;
+        }
+    }
+    for (int len = 2; len <= FFT_N; len <<= 1) {
+        int half = len >> 1;
+        int step = FFT_N / len;
+        for (int i = 0; i < FFT_N; i += len) {
+            for (int k = 0; k < half; k++) {
+                float wr = fft_wre[k * step], wi = fft_wim[k * step];
+                float xr = fft_re[i + k + half], xi = fft_im[i + k + half];
+                float tr = xr * wr - xi * wi;
+                float ti = xr * wi + xi * wr;
+                fft_re[i + k + half] = fft_re[i + k] - tr;
+                fft_im[i + k + half] = fft_im[i + k] - ti;
+                fft_re[i + k] += tr;
+                fft_im[i + k] += ti;
+            }
+        }
+    }
+}
+
+int32_t bench_fft(int32_t n) {
+    fft_twiddles();
+    float energy = 0.0f;
+    for (int32_t iter = 0; iter < n; iter++) {
+        for (int i = 0; i < FFT_N; i++) {
+            fft_re[i] = (float)(((i + iter) * 11) % 16) - 8.0f;
+            fft_im[i] = 0.0f;
+        }
+        fft_run();
+        int k = iter & (FFT_N - 1);
+        energy += fft_re[k] * fft_re[k] + fft_im[k] * fft_im[k] + fft_re[4];
+    }
+    return (int32_t)energy;
+}
+
+// --- 64-bit integer math ---
+
+int32_t bench_math64(int32_t n) {
+    uint64_t x = 0x0123456789abcdefull;
+    uint64_t acc = 0;
+    for (int32_t i = 0; i < n; i++) {
+        x = x * 6364136223846793005ull + 1442695040888963407ull;
+        int64_t d = (int64_t)(x >> 3) / ((int64_t)(i & 0xff) + 3);
+        acc += (uint64_t)d ^ (x << 7);
+        acc = (acc >> 1) | (acc << 63);
+        acc += (x >> 32) % 1000003u;
+    }
+    return (int32_t)(acc ^ (acc >> 32));
+}
+
+// --- Matrix multiply ---
+
+#define MAT_N 16
+
+static int32_t mat_a[MAT_N][MAT_N];
+static int32_t mat_b[MAT_N][MAT_N];
+static int32_t mat_c[MAT_N][MAT_N];
+
+int32_t bench_matmul(int32_t n) {
+    for (int i = 0; i < MAT_N; i++) {
+        for (int j = 0; j < MAT_N; j++) {
+            mat_a[i][j] = (i * 3 + j) % 17 - 8;
+            mat_b[i][j] = (i + j * 5) % 13 - 6;
+        }
+    }
+    int32_t sum = 0;
+    for (int32_t iter = 0; iter < n; iter++) {
+        for (int i = 0; i < MAT_N; i++) {
+            for (int j = 0; j < MAT_N; j++) {
+                int32_t acc = 0;
+                for (int k = 0; k < MAT_N; k++) acc += mat_a[i][k] * mat_b[k][j];
+                mat_c[i][j] = acc;
+            }
+        }
+        sum += mat_c[iter & (MAT_N - 1)][(iter * 7) & (MAT_N - 1)];
+        mat_a[iter & (MAT_N - 1)][0] += 1;
+    }
+    return sum;
+}
+
+// --- Call-heavy recursion ---
+
+static NOINLINE int32_t fib(int32_t n) {
+    return n < 2 ? n : fib(n - 1) + fib(n - 2);
+}
+
+int32_t bench_fib(int32_t n) {
+    return fib(n);
+}
+
+// --- Indirect-call dispatch ---
+
+typedef int32_t (*dispatch_op_t)(int32_t acc, int32_t v);
+
+static NOINLINE int32_t op_add(int32_t acc, int32_t v) { return (int32_t)((uint32_t)acc + (uint32_t)v); }
+static NOINLINE int32_t op_xor(int32_t acc, int32_t v) { return acc ^ (int32_t)((uint32_t)v * 31u); }
+static NOINLINE int32_t op_rot(int32_t acc, int32_t v) { return (int32_t)((((uint32_t)acc << 5) | ((uint32_t)acc >> 27)) + (uint32_t)v); }
+static NOINLINE int32_t op_sub(int32_t acc, int32_t v) { return (int32_t)((uint32_t)acc - (uint32_t)(v >> 1)); }
+
+static dispatch_op_t dispatch_table[4] = { op_add, op_xor, op_rot, op_sub };
+
+int32_t bench_dispatch(int32_t n) {
+    int32_t acc = 1;
+    for (int32_t i = 0; i < n; i++) {
+        acc = dispatch_table[(i ^ (i >> 3)) & 3](acc, i);
+    }
+    return acc;
+}
+
+// --- FFI import and callback round trips ---
+
+int32_t bench_ffi_ping(int32_t n) {
+    uint32_t acc = 0;
+    for (int32_t i = 0; i < n; i++) acc += (uint32_t)bench_host_ping(i);
+    return (int32_t)acc;
+}
+
+static void cb_ping(int32_t value, void *user_data) {
+    int32_t *acc = (int32_t *)user_data;
+    *acc = (int32_t)((uint32_t)*acc * 3u + (uint32_t)value);
+}
+
+int32_t bench_cb_ping(int32_t n) {
+    int32_t acc = 0;
+    bench_host_invoke(cb_ping, n, &acc);
+    return acc;
+}
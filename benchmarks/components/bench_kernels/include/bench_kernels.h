@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Every kernel takes an iteration count and returns a checksum, so the native,
+// interpreter and JIT runs of one kernel can be compared by value.
+typedef int32_t (*bench_kernel_fn)(int32_t n);
+
+int32_t bench_coremark(int32_t n);   // List walk, state machine and CRC16 over a small buffer
+int32_t bench_crc32(int32_t n);      // Bitwise CRC32 over 1 KiB
+int32_t bench_fir(int32_t n);        // 16-tap float FIR over 256 samples
+int32_t bench_fft(int32_t n);        // 64-point radix-2 float FFT
+int32_t bench_math64(int32_t n);     // 64-bit multiply, divide and shifts
+int32_t bench_matmul(int32_t n);     // 16x16 int32 matrix multiply
+int32_t bench_fib(int32_t n);        // Call-heavy recursion
+int32_t bench_dispatch(int32_t n);   // Indirect calls through a function pointer table
+int32_t bench_ffi_ping(int32_t n);   // n calls of a host import
+int32_t bench_cb_ping(int32_t n);    // One host call that calls back into the kernel n times
+
+// --- Host side (bench_host.c), imported by the module by name ---
+
+typedef void (*bench_host_cb_t)(int32_t value, void *user_data);
+
+int32_t bench_host_ping(int32_t value);
+void bench_host_invoke(bench_host_cb_t cb, int32_t n, void *user_data);
+
+#ifdef __cplusplus
+}
+#endif
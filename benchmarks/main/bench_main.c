@@ -0,0 +1,213 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "sdkconfig.h"
+#include "esp_cpu.h"
+#include "esp_heap_caps.h"
+
+#include "espb_api.h"
+#include "espb_host_symbols.h"
+#include "espb_interpreter_runtime.h"
+#include "espb_jit_dispatcher.h"
+#include "espb_jit_precompile.h"
+
+#include "bench_kernels.h"
+
+typedef struct {
+    const char *name;
+    uint32_t size;
+} BenchNativeSize;
+
+#include "bench_native_sizes.h" // Generated from the native kernels library at build time
+
+extern const uint8_t bench_espb_start[] asm("_binary_bench_espb_start");
+extern const uint8_t bench_espb_end[]   asm("_binary_bench_espb_end");
+
+// Every measurement is the best of BENCH_REPS runs after one warm-up run
+#define BENCH_REPS 5
+
+typedef struct {
+    const char *name;      // Export name in bench.espb and native symbol name
+    bench_kernel_fn native;
+    int32_t n;             // Iteration count, sized for about a millisecond natively
+} BenchKernel;
+
+static const BenchKernel kernels[] = {
+    { "bench_coremark", bench_coremark, 50 },
+    { "bench_crc32",    bench_crc32,    4 },
+    { "bench_fir",      bench_fir,      8 },
+    { "bench_fft",      bench_fft,      16 },
+    { "bench_math64",   bench_math64,   2000 },
+    { "bench_matmul",   bench_matmul,   8 },
+    { "bench_fib",      bench_fib,      18 },
+    { "bench_dispatch", bench_dispatch, 5000 },
+    { "bench_ffi_ping", bench_ffi_ping, 2000 },
+    { "bench_cb_ping",  bench_cb_ping,  2000 },
+};
+#define BENCH_NUM_KERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+// Host functions imported by bench.espb by name
+static const EspbSymbol bench_host_symbols[] = {
+    ESP_ELFSYM_EXPORT(bench_host_ping),
+    ESP_ELFSYM_EXPORT(bench_host_invoke),
+    ESP_ELFSYM_END
+};
+
+typedef enum {
+    BENCH_NATIVE,
+    BENCH_INTERP,
+    BENCH_JIT,
+} BenchMode;
+
+static const char *const bench_mode_names[] = { "native", "interp", "jit" };
+
+typedef struct {
+    uint32_t cycles;
+    int32_t result;
+    EspbResult status;
+} BenchRun;
+
+static uint32_t native_size(const char *name) {
+    for (size_t i = 0; i < sizeof(bench_native_sizes) / sizeof(bench_native_sizes[0]); i++) {
+        if (strcmp(bench_native_sizes[i].name, name) == 0) return bench_native_sizes[i].size;
+    }
+    return 0;
+}
+
+// Returns the global function index (imports first), UINT32_MAX if not exported
+static uint32_t find_export(const EspbModule *module, const char *name) {
+    for (uint32_t i = 0; i < module->num_exports; i++) {
+        if (module->exports[i].kind == ESPB_IMPORT_KIND_FUNC && strcmp(module->exports[i].name, name) == 0) {
+            return module->exports[i].index + module->num_imported_funcs;
+        }
+    }
+    return UINT32_MAX;
+}
+
+static BenchRun bench_measure(BenchMode mode, const BenchKernel *k, EspbInstance *instance, espb_exec_ctx_t ctx,
+                              uint32_t func_idx) {
+    BenchRun run = { .cycles = UINT32_MAX, .result = 0, .status = ESPB_OK };
+    for (int rep = 0; rep <= BENCH_REPS; rep++) {
+        Value arg = ESPB_I32(k->n);
+        Value res = ESPB_I32(0);
+        EspbResult status = ESPB_OK;
+
+        if (mode != BENCH_NATIVE) reset_execution_context(ctx, instance);
+        uint32_t t0 = esp_cpu_get_cycle_count();
+        switch (mode) {
+        case BENCH_NATIVE:
+            res.i32 = k->native(k->n);
+            break;
+        case BENCH_INTERP:
+            status = espb_call_function(instance, ctx, func_idx, &arg, &res);
+            break;
+        case BENCH_JIT:
+            status = espb_execute_function_jit_only(instance, ctx, func_idx, &arg, &res);
+            break;
+        }
+        uint32_t dt = esp_cpu_get_cycle_count() - t0;
+
+        if (status != ESPB_OK) {
+            run.status = status;
+            break;
+        }
+        run.result = res.i32;
+        if (rep > 0 && dt < run.cycles) run.cycles = dt;
+    }
+    return run;
+}
+
+static void bench_print(const char *kernel, BenchMode mode, const BenchRun *run, int32_t expected,
+                        uint32_t code_bytes, uint32_t iram_bytes) {
+    if (run->status != ESPB_OK) {
+        printf("%s,%s,%s,,,error %d,%u,%u\n", CONFIG_IDF_TARGET, kernel, bench_mode_names[mode], run->status,
+               (unsigned)code_bytes, (unsigned)iram_bytes);
+        return;
+    }
+    printf("%s,%s,%s,%u,%ld,%s,%u,%u\n", CONFIG_IDF_TARGET, kernel, bench_mode_names[mode], (unsigned)run->cycles,
+           (long)run->result, run->result == expected ? "ok" : "MISMATCH", (unsigned)code_bytes,
+           (unsigned)iram_bytes);
+}
+
+void app_main(void) {
+    printf("# ESPB benchmark: chip=%s cpu_mhz=%d reps=%d\n", CONFIG_IDF_TARGET, CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+           BENCH_REPS);
+
+    espb_register_symbol_table(2, bench_host_symbols);
+
+    espb_module_t module = NULL;
+    EspbInstance *instance = NULL;
+    espb_exec_ctx_t ctx = NULL;
+    EspbResult result = espb_create_module(bench_espb_start, bench_espb_end - bench_espb_start, &module);
+    if (result != ESPB_OK) {
+        printf("Failed to load bench.espb, error: %d\n", result);
+        return;
+    }
+    result = espb_instantiate(&instance, module);
+    if (result == ESPB_OK) result = espb_create_exec_ctx(&ctx);
+    if (result != ESPB_OK) {
+        printf("Failed to instantiate bench.espb, error: %d\n", result);
+        goto cleanup;
+    }
+
+    int32_t expected[BENCH_NUM_KERNELS];
+    uint32_t func_idx[BENCH_NUM_KERNELS];
+    uint32_t num_imported = module->num_imported_funcs;
+
+    printf("chip,kernel,mode,cycles,result,check,code_bytes,iram_bytes\n");
+
+    // Native first: its results are the reference for the other modes
+    for (size_t i = 0; i < BENCH_NUM_KERNELS; i++) {
+        BenchRun run = bench_measure(BENCH_NATIVE, &kernels[i], NULL, NULL, 0);
+        expected[i] = run.result;
+        bench_print(kernels[i].name, BENCH_NATIVE, &run, expected[i], native_size(kernels[i].name), 0);
+    }
+
+    // The interpreter runs before anything is compiled: a compiled callee would be
+    // entered natively from the interpreter's CALL
+    uint32_t bytecode_total = 0;
+    for (uint32_t f = 0; f < module->num_functions; f++) bytecode_total += module->function_bodies[f].code_size;
+    for (size_t i = 0; i < BENCH_NUM_KERNELS; i++) {
+        func_idx[i] = find_export(module, kernels[i].name);
+        if (func_idx[i] == UINT32_MAX) {
+            printf("%s,%s,interp,,,missing export,0,0\n", CONFIG_IDF_TARGET, kernels[i].name);
+            continue;
+        }
+        const EspbFunctionBody *body = &module->function_bodies[func_idx[i] - num_imported];
+        BenchRun run = bench_measure(BENCH_INTERP, &kernels[i], instance, ctx, func_idx[i]);
+        bench_print(kernels[i].name, BENCH_INTERP, &run, expected[i], body->code_size, 0);
+    }
+
+#if CONFIG_ESPB_JIT_ENABLED
+    // All functions are compiled up front so kernel helpers and callees run natively too;
+    // functions the JIT rejects stay in the interpreter
+    size_t exec_free_before = heap_caps_get_free_size(MALLOC_CAP_EXEC);
+    uint32_t jit_total = 0;
+    for (uint32_t f = 0; f < module->num_functions; f++) {
+        if (espb_jit_precompile_function(instance, f + num_imported) == ESPB_OK) {
+            jit_total += module->function_bodies[f].jit_code_size;
+        }
+    }
+    size_t exec_used = exec_free_before - heap_caps_get_free_size(MALLOC_CAP_EXEC);
+
+    for (size_t i = 0; i < BENCH_NUM_KERNELS; i++) {
+        if (func_idx[i] == UINT32_MAX) continue;
+        const EspbFunctionBody *body = &module->function_bodies[func_idx[i] - num_imported];
+        BenchRun run = bench_measure(BENCH_JIT, &kernels[i], instance, ctx, func_idx[i]);
+        bench_print(kernels[i].name, BENCH_JIT, &run, expected[i], body->jit_code_size, body->jit_code_size);
+    }
+#endif
+
+    // Whole-module sizes, static helpers included
+    printf("%s,total,native,,,,%u,0\n", CONFIG_IDF_TARGET, (unsigned)BENCH_NATIVE_TOTAL_SIZE);
+    printf("%s,total,interp,,,,%u,0\n", CONFIG_IDF_TARGET, (unsigned)bytecode_total);
+#if CONFIG_ESPB_JIT_ENABLED
+    printf("%s,total,jit,,,,%u,%u\n", CONFIG_IDF_TARGET, (unsigned)jit_total, (unsigned)exec_used);
+#endif
+    printf("# done\n");
+
+cleanup:
+    if (ctx) espb_destroy_exec_ctx(ctx);
+    if (instance) espb_free_instance(instance);
+    espb_release_module(module);
+}
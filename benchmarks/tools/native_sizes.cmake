@@ -0,0 +1,35 @@
+# Generates bench_native_sizes.h from the symbol sizes of the native kernels library.
+# Usage: cmake -DNM=<nm> -DLIB=<libbench_kernels.a> -DOUT=<header> -P native_sizes.cmake
+execute_process(COMMAND ${NM} --size-sort -S --defined-only "${LIB}"
+                OUTPUT_VARIABLE nm_out
+                RESULT_VARIABLE nm_res)
+if(NOT nm_res EQUAL 0)
+    message(FATAL_ERROR "nm failed on ${LIB}")
+endif()
+
+set(entries "")
+set(total 0)
+string(REPLACE "\n" ";" nm_lines "${nm_out}")
+foreach(line IN LISTS nm_lines)
+    # <address> <size> <type> <name>: entry points by name, static helpers only in the total.
+    # bench_host_* are the host imports, not kernel code.
+    if(line MATCHES "^[0-9a-fA-F]+ ([0-9a-fA-F]+) ([Tt]) ([A-Za-z0-9_.]+)$")
+        set(sym_size "${CMAKE_MATCH_1}")
+        set(sym_type "${CMAKE_MATCH_2}")
+        set(sym_name "${CMAKE_MATCH_3}")
+        if(NOT sym_name MATCHES "^bench_host_")
+            math(EXPR size "0x${sym_size}" OUTPUT_FORMAT DECIMAL)
+            math(EXPR total "${total} + ${size}")
+            if(sym_type STREQUAL "T" AND sym_name MATCHES "^bench_")
+                string(APPEND entries "    { \"${sym_name}\", ${size} },\n")
+            endif()
+        endif()
+    endif()
+endforeach()
+
+file(WRITE "${OUT}.tmp"
+     "// Generated by tools/native_sizes.cmake, do not edit\n"
+     "#define BENCH_NATIVE_TOTAL_SIZE ${total}\n"
+     "static const BenchNativeSize bench_native_sizes[] = {\n${entries}};\n")
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy_if_different "${OUT}.tmp" "${OUT}")
+file(REMOVE "${OUT}.tmp")
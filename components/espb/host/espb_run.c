@@ -0,0 +1,193 @@
+// espb_run: loads an .espb module on the host and calls one exported function.
+//
+//   espb_run [-n count] module.espb function [args...]
+//
+// Arguments are converted by the function signature (integers, floats; PTR gets the
+// argument string itself). The call is repeated count times on one execution context;
+// the result of the last call and the per-call time are printed.
+//
+// The host functions of the main/ demo application are registered as its custom fast
+// table (main/symbols/custom_fast.sym), so modules built for it, e.g. main/test.espb,
+// run unchanged.
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_timer.h"
+#include "espb_api.h"
+#include "espb_fast_symbols.h"
+
+// --- Host functions of main/main.cpp ---
+
+typedef void (*cb1_t)(void *);
+typedef void (*cb2_t)(int, void *);
+
+static void my_custom_print(const char *str) {
+    printf(">> Custom Print: %s\n", str);
+}
+
+static void native_set_magic_number(int *out_value) {
+    if (out_value) *out_value = 42;
+}
+
+static void host_invoke_cb(cb1_t cb, void *user_data) {
+    if (cb) cb(user_data);
+}
+
+static void host_invoke_cb2(cb2_t cb, int x, void *user_data) {
+    if (cb) cb(x, user_data);
+}
+
+static const EspbSymbolFast demo_fast_table[] = {
+#include "symbols/custom_fast.sym"
+};
+
+static void usage(void) {
+    fprintf(stderr, "usage: espb_run [-n count] module.espb function [args...]\n");
+}
+
+static uint8_t *read_file(const char *path, size_t *out_size) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    uint8_t *data = NULL;
+    long size = -1;
+    if (fseek(f, 0, SEEK_END) == 0) size = ftell(f);
+    if (size > 0 && fseek(f, 0, SEEK_SET) == 0) {
+        data = malloc((size_t)size);
+        if (data && fread(data, 1, (size_t)size, f) != (size_t)size) {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(f);
+    *out_size = data ? (size_t)size : 0;
+    return data;
+}
+
+static int parse_arg(EspbValueType type, const char *text, Value *out) {
+    char *end = NULL;
+    errno = 0;
+    switch (type) {
+    case ESPB_TYPE_F32:
+        *out = ESPB_F32(strtof(text, &end));
+        break;
+    case ESPB_TYPE_F64:
+        *out = ESPB_F64(strtod(text, &end));
+        break;
+    case ESPB_TYPE_PTR:
+        // argv lives on the stack above 4 GB; the heap copy is reachable through a 32-bit pointer
+        *out = ESPB_PTR(strdup(text));
+        return out->ptr ? 0 : -1;
+    case ESPB_TYPE_I64:
+        *out = ESPB_I64(strtoll(text, &end, 0));
+        break;
+    case ESPB_TYPE_U64:
+        *out = ESPB_U64(strtoull(text, &end, 0));
+        break;
+    default:
+        *out = ESPB_I64(strtoll(text, &end, 0));
+        out->_pad = 0;
+        break;
+    }
+    return (errno || end == text || *end) ? -1 : 0;
+}
+
+static void print_result(EspbValueType type, const Value *v) {
+    switch (type) {
+    case ESPB_TYPE_I64: printf("%lld\n", (long long)v->i64); break;
+    case ESPB_TYPE_U64: printf("%llu\n", (unsigned long long)v->u64); break;
+    case ESPB_TYPE_F32: printf("%g\n", (double)v->f32); break;
+    case ESPB_TYPE_F64: printf("%g\n", v->f64); break;
+    case ESPB_TYPE_PTR: printf("%p\n", v->ptr); break;
+    case ESPB_TYPE_U32: printf("%u\n", (unsigned)v->u32); break;
+    default: printf("%d\n", (int)v->i32); break;
+    }
+}
+
+int main(int argc, char **argv) {
+    unsigned long count = 1;
+    int argi = 1;
+    if (argi + 1 < argc && strcmp(argv[argi], "-n") == 0) {
+        count = strtoul(argv[argi + 1], NULL, 0);
+        argi += 2;
+    }
+    if (argc - argi < 2 || count == 0) {
+        usage();
+        return 2;
+    }
+    const char *path = argv[argi];
+    const char *func_name = argv[argi + 1];
+    argi += 2;
+
+    espb_register_custom_index_symbol_table(demo_fast_table);
+
+    size_t size = 0;
+    uint8_t *data = read_file(path, &size);
+    if (!data) {
+        fprintf(stderr, "espb_run: cannot read %s\n", path);
+        return 1;
+    }
+
+    int rc = 1;
+    espb_module_t module = NULL;
+    espb_handle_t handle = NULL;
+    espb_exec_ctx_t ctx = NULL;
+    Value *args = NULL;
+    espb_func_t func;
+
+    EspbResult result = espb_create_module(data, size, &module);
+    if (result != ESPB_OK) {
+        fprintf(stderr, "espb_run: failed to load %s, error %d\n", path, result);
+        goto cleanup;
+    }
+    result = espb_instantiate_module(module, &handle);
+    if (result != ESPB_OK) {
+        fprintf(stderr, "espb_run: failed to instantiate %s, error %d\n", path, result);
+        goto cleanup;
+    }
+    if (espb_get_function(handle, func_name, &func) != ESPB_OK) {
+        fprintf(stderr, "espb_run: no exported function '%s'\n", func_name);
+        goto cleanup;
+    }
+
+    const EspbFuncSignature *sig =
+        &module->signatures[module->function_signature_indices[func - module->num_imported_funcs]];
+    if ((uint32_t)(argc - argi) != sig->num_params) {
+        fprintf(stderr, "espb_run: '%s' takes %u arguments, %d given\n", func_name, sig->num_params, argc - argi);
+        goto cleanup;
+    }
+    args = calloc(sig->num_params ? sig->num_params : 1, sizeof(Value));
+    if (!args) goto cleanup;
+    for (uint32_t i = 0; i < sig->num_params; i++) {
+        if (parse_arg(sig->param_types[i], argv[argi + i], &args[i]) != 0) {
+            fprintf(stderr, "espb_run: bad argument %u: '%s'\n", i + 1, argv[argi + i]);
+            goto cleanup;
+        }
+    }
+
+    if (espb_create_exec_ctx(&ctx) != ESPB_OK) goto cleanup;
+
+    Value res = ESPB_VOID();
+    int64_t t0 = esp_timer_get_time();
+    for (unsigned long i = 0; i < count; i++) {
+        result = espb_call_function_with_ctx(handle, ctx, func, args, sig->num_params, &res);
+        if (result != ESPB_OK) {
+            fprintf(stderr, "espb_run: call %lu failed, error %d\n", i + 1, result);
+            goto cleanup;
+        }
+    }
+    int64_t elapsed = esp_timer_get_time() - t0;
+
+    if (sig->num_returns > 0 && sig->return_types[0] != ESPB_TYPE_VOID) print_result(sig->return_types[0], &res);
+    fprintf(stderr, "%s: %lu calls, %.3f us/call\n", func_name, count, (double)elapsed / (double)count);
+    rc = 0;
+
+cleanup:
+    free(args);
+    if (ctx) espb_destroy_exec_ctx(ctx);
+    if (handle) espb_unload_module(handle);
+    espb_release_module(module);
+    free(data);
+    return rc;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+// GPIO imports resolve on the host and only log the call
+typedef int gpio_num_t;
+
+typedef struct {
+    uint64_t pin_bit_mask;
+    int mode;
+    int pull_up_en;
+    int pull_down_en;
+    int intr_type;
+} gpio_config_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+esp_err_t gpio_config(const gpio_config_t *config);
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level);
+
+#ifdef __cplusplus
+}
+#endif
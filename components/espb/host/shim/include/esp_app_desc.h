@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+
+// Host image description: a zero ELF hash, so JIT snapshots never match a device firmware
+typedef struct {
+    char version[32];
+    char project_name[32];
+    uint8_t app_elf_sha256[32];
+} esp_app_desc_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+const esp_app_desc_t *esp_app_get_description(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,9 @@
+#pragma once
+
+// No IRAM/DRAM split on the host: placement attributes are no-ops
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define EXT_RAM_BSS_ATTR
+#define NOINLINE_ATTR __attribute__((noinline))
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Nanoseconds since process start, truncated: a monotonic stand-in for the CPU cycle counter
+uint32_t esp_cpu_get_cycle_count(void);
+
+#ifdef __cplusplus
+}
+#endif
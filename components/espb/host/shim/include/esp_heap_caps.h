@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "multi_heap.h"
+#include "esp_system.h" // esp_get_free_heap_size, reached transitively in ESP-IDF
+
+// Capability flags are accepted and ignored: the host has a single malloc heap
+#define MALLOC_CAP_EXEC       (1 << 0)
+#define MALLOC_CAP_32BIT      (1 << 1)
+#define MALLOC_CAP_8BIT       (1 << 2)
+#define MALLOC_CAP_DMA        (1 << 3)
+#define MALLOC_CAP_SPIRAM     (1 << 10)
+#define MALLOC_CAP_INTERNAL   (1 << 11)
+#define MALLOC_CAP_DEFAULT    (1 << 12)
+#define MALLOC_CAP_IRAM_8BIT  (1 << 13)
+#define MALLOC_CAP_TCM        (1 << 15)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void *heap_caps_malloc(size_t size, uint32_t caps);
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps);
+void *heap_caps_realloc(void *ptr, size_t size, uint32_t caps);
+void *heap_caps_aligned_alloc(size_t alignment, size_t size, uint32_t caps);
+void heap_caps_free(void *ptr);
+size_t heap_caps_get_free_size(uint32_t caps);
+size_t heap_caps_get_largest_free_block(uint32_t caps);
+bool heap_caps_check_integrity_all(bool print_errors);
+
+#ifdef __cplusplus
+}
+#endif
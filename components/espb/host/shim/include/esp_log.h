@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+// Messages above this level are compiled out, as with CONFIG_LOG_MAXIMUM_LEVEL
+#ifndef ESPB_HOST_LOG_LEVEL
+#define ESPB_HOST_LOG_LEVEL ESP_LOG_WARN
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+uint32_t esp_log_timestamp(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define ESPB_HOST_LOG(level, letter, tag, format, ...) do { \
+        if ((level) <= ESPB_HOST_LOG_LEVEL) { \
+            esp_log_write(level, tag, letter " (%u) %s: " format "\n", (unsigned)esp_log_timestamp(), tag, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...) ESPB_HOST_LOG(ESP_LOG_ERROR, "E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESPB_HOST_LOG(ESP_LOG_WARN, "W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESPB_HOST_LOG(ESP_LOG_INFO, "I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ESPB_HOST_LOG(ESP_LOG_DEBUG, "D", tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) ESPB_HOST_LOG(ESP_LOG_VERBOSE, "V", tag, format, ##__VA_ARGS__)
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdbool.h>
+
+// One flat address space on the host. libffi closures live in executable mappings the
+// shim cannot tell apart, so every non-NULL pointer counts as executable and internal;
+// nothing is ROM, external RAM or DMA-capable.
+static inline bool esp_ptr_executable(const void *p) { return p != 0; }
+static inline bool esp_ptr_in_iram(const void *p) { return p != 0; }
+static inline bool esp_ptr_in_rom(const void *p) { (void)p; return false; }
+static inline bool esp_ptr_in_dram(const void *p) { return p != 0; }
+static inline bool esp_ptr_internal(const void *p) { return p != 0; }
+static inline bool esp_ptr_external_ram(const void *p) { (void)p; return false; }
+static inline bool esp_ptr_byte_accessible(const void *p) { return p != 0; }
+static inline bool esp_ptr_dma_capable(const void *p) { (void)p; return false; }
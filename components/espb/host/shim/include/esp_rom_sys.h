@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t esp_rom_get_cpu_ticks_per_us(void);
+
+#ifdef __cplusplus
+}
+#endif
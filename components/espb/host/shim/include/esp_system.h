@@ -0,0 +1,16 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void esp_restart(void) __attribute__((noreturn));
+uint32_t esp_get_free_heap_size(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct esp_timer *esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void *arg);
+
+typedef enum {
+    ESP_TIMER_TASK,
+    ESP_TIMER_ISR,
+} esp_timer_dispatch_t;
+
+typedef struct {
+    esp_timer_cb_t callback;
+    void *arg;
+    esp_timer_dispatch_t dispatch_method; // Ignored: every timer has its own thread
+    const char *name;
+    bool skip_unhandled_events;           // Always true: a late callback is not repeated
+} esp_timer_create_args_t;
+
+// Microseconds since process start (CLOCK_MONOTONIC)
+int64_t esp_timer_get_time(void);
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out_handle);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us);
+// Like ESP-IDF, does not wait for a callback that has already started
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+// Must not be called from the timer's own callback
+esp_err_t esp_timer_delete(esp_timer_handle_t timer);
+
+#ifdef __cplusplus
+}
+#endif
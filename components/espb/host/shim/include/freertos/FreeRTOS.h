@@ -0,0 +1,33 @@
+#pragma once
+
+// FreeRTOS subset on top of POSIX threads: tasks are pthreads, ticks are milliseconds.
+#include <stddef.h>
+#include <stdint.h>
+#include "sdkconfig.h"
+// As in the ESP-IDF port layer (portmacro.h)
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t StackType_t;
+// Visible without timers.h, as through the ESP-IDF headers
+typedef struct HostTimer *TimerHandle_t;
+
+#define configTICK_RATE_HZ   CONFIG_FREERTOS_HZ
+#define portTICK_PERIOD_MS   (1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY        ((TickType_t)0xffffffffu)
+#define portNUM_PROCESSORS   1
+#define pdMS_TO_TICKS(ms)    ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+
+#define pdFALSE  ((BaseType_t)0)
+#define pdTRUE   ((BaseType_t)1)
+#define pdFAIL   pdFALSE
+#define pdPASS   pdTRUE
+
+#define portYIELD_FROM_ISR(x) ((void)(x))
+
+// No interrupts on the host
+static inline BaseType_t xPortInIsrContext(void) { return pdFALSE; }
+static inline BaseType_t xPortGetCoreID(void) { return 0; }
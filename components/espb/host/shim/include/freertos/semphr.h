@@ -0,0 +1,24 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct HostSemaphore *SemaphoreHandle_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem);
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t *higher_prio_woken);
+void vSemaphoreDelete(SemaphoreHandle_t sem);
+
+#ifdef __cplusplus
+}
+#endif
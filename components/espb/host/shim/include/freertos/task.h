@@ -0,0 +1,42 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct HostTask *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *arg);
+
+typedef enum {
+    eRunning = 0,
+    eReady,
+    eBlocked,
+    eSuspended,
+    eDeleted,
+    eInvalid,
+} eTaskState;
+
+#define tskNO_AFFINITY  0x7FFFFFFF
+#define tskIDLE_PRIORITY 0
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Stack size, priority and core are ignored: every task is a detached pthread
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *out_handle, BaseType_t core_id);
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *out_handle);
+// Only vTaskDelete(NULL) (a task ending itself) is supported
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+// Threads cannot be inspected: every task reports eRunning, as if it ran on another core
+eTaskState eTaskGetState(TaskHandle_t task);
+void vTaskYield(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define taskYIELD() vTaskYield()
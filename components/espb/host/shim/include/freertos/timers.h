@@ -0,0 +1,28 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef void (*TimerCallbackFunction_t)(TimerHandle_t timer);
+
+#define tmrCOMMAND_START  1
+#define tmrCOMMAND_STOP   3
+#define tmrCOMMAND_DELETE 5
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Software timers run on one pthread each; only start, stop and delete commands are handled
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t auto_reload, void *timer_id,
+                           TimerCallbackFunction_t callback);
+void *pvTimerGetTimerID(TimerHandle_t timer);
+BaseType_t xTimerGenericCommand(TimerHandle_t timer, BaseType_t command, TickType_t optional_value,
+                                BaseType_t *higher_prio_woken, TickType_t ticks_to_wait);
+
+#ifdef __cplusplus
+}
+#endif
+
+#define xTimerStart(t, ticks)  xTimerGenericCommand((t), tmrCOMMAND_START, xTaskGetTickCount(), NULL, (ticks))
+#define xTimerStop(t, ticks)   xTimerGenericCommand((t), tmrCOMMAND_STOP, 0U, NULL, (ticks))
+#define xTimerDelete(t, ticks) xTimerGenericCommand((t), tmrCOMMAND_DELETE, 0U, NULL, (ticks))
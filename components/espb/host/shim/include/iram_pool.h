@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stddef.h>
+
+// The host libffi allocates its own closure trampolines: no IRAM pool.
+// iram_pool_init stays undefined, so the weak reference in iram_pool_wrapper.c is NULL.
+void iram_pool_init(void);
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+
+// Heap inside a caller-provided region (guest heap in linear memory). All metadata
+// lives in the region and uses offsets, so a copied region stays valid at a new base.
+typedef struct multi_heap_info *multi_heap_handle_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+multi_heap_handle_t multi_heap_register(void *start, size_t size);
+void *multi_heap_malloc(multi_heap_handle_t heap, size_t size);
+void *multi_heap_aligned_alloc(multi_heap_handle_t heap, size_t size, size_t alignment);
+void *multi_heap_realloc(multi_heap_handle_t heap, void *p, size_t size);
+void multi_heap_free(multi_heap_handle_t heap, void *p);
+void multi_heap_aligned_free(multi_heap_handle_t heap, void *p);
+size_t multi_heap_get_allocated_size(multi_heap_handle_t heap, void *p);
+size_t multi_heap_free_size(multi_heap_handle_t heap);
+size_t multi_heap_minimum_free_size(multi_heap_handle_t heap);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,115 @@
+// Host build configuration: Kconfig defaults of the espb component with the JIT
+// disabled (no native code generator for the host CPU). Options can be overridden
+// from CMake, e.g. -DCONFIG_ESPB_PROFILER=1, except the ones that need the chip:
+// CONFIG_ESPB_JIT_* (no host backend), CONFIG_ESPB_BULK_MEMORY_PIE,
+// CONFIG_ESPB_SIMD_PIE (ESP32-S3/P4 vector instructions) and
+// CONFIG_ESPB_BULK_MEMORY_DMA (async memcpy driver).
+#pragma once
+
+#define CONFIG_IDF_TARGET "linux"
+#define CONFIG_IDF_TARGET_LINUX 1
+#define CONFIG_FREERTOS_HZ 1000
+#define CONFIG_FREERTOS_UNICORE 1
+
+#ifndef CONFIG_ESPB_INTERPRETER_ENABLED
+#define CONFIG_ESPB_INTERPRETER_ENABLED 1
+#endif
+#ifndef CONFIG_ESPB_IDF_GPIO
+#define CONFIG_ESPB_IDF_GPIO 1
+#endif
+#ifndef CONFIG_ESPB_LINEAR_MEMORY_SIZE
+#define CONFIG_ESPB_LINEAR_MEMORY_SIZE 65536
+#endif
+#ifndef CONFIG_ESPB_LINEAR_MEMORY_HEAP_SIZE
+#define CONFIG_ESPB_LINEAR_MEMORY_HEAP_SIZE 16384
+#endif
+#ifndef CONFIG_ESPB_LINEAR_MEMORY_GROW_RESERVE
+#define CONFIG_ESPB_LINEAR_MEMORY_GROW_RESERVE 0
+#endif
+#ifndef CONFIG_ESPB_HEAP_SLABS
+#define CONFIG_ESPB_HEAP_SLABS 1
+#endif
+#ifndef CONFIG_ESPB_HEAP_GROW_STEP
+#define CONFIG_ESPB_HEAP_GROW_STEP 4096
+#endif
+#ifndef CONFIG_ESPB_ALLOCA_STACK_SIZE
+#define CONFIG_ESPB_ALLOCA_STACK_SIZE 8192
+#endif
+#ifndef CONFIG_ESPB_RODATA_IN_PLACE
+#define CONFIG_ESPB_RODATA_IN_PLACE 1
+#endif
+#ifndef CONFIG_ESPB_SHADOW_STACK_INITIAL_SIZE
+#define CONFIG_ESPB_SHADOW_STACK_INITIAL_SIZE 4096
+#endif
+#ifndef CONFIG_ESPB_SHADOW_STACK_INCREMENT
+#define CONFIG_ESPB_SHADOW_STACK_INCREMENT 4096
+#endif
+#ifndef CONFIG_ESPB_PARTIAL_FRAME_ZEROING
+#define CONFIG_ESPB_PARTIAL_FRAME_ZEROING 1
+#endif
+#ifndef CONFIG_ESPB_CALL_STACK_INITIAL_DEPTH
+#define CONFIG_ESPB_CALL_STACK_INITIAL_DEPTH 16
+#endif
+#ifndef CONFIG_ESPB_CALL_STACK_MAX_DEPTH
+#define CONFIG_ESPB_CALL_STACK_MAX_DEPTH 1024
+#endif
+#ifndef CONFIG_ESPB_TAIL_CALLS
+#define CONFIG_ESPB_TAIL_CALLS 1
+#endif
+#ifndef CONFIG_ESPB_EXEC_CTX_CACHE
+#define CONFIG_ESPB_EXEC_CTX_CACHE 1
+#endif
+#ifndef CONFIG_ESPB_CONCURRENT_CALLS
+#define CONFIG_ESPB_CONCURRENT_CALLS 1
+#endif
+#ifndef CONFIG_ESPB_BYTECODE_OPT
+#define CONFIG_ESPB_BYTECODE_OPT 1
+#endif
+#ifndef CONFIG_ESPB_THREADED_CODE
+#define CONFIG_ESPB_THREADED_CODE 1
+#endif
+#ifndef CONFIG_ESPB_THREADED_SUPERINSTRUCTIONS
+#define CONFIG_ESPB_THREADED_SUPERINSTRUCTIONS 1
+#endif
+#ifndef CONFIG_ESPB_CALL_IC_ENTRIES
+#define CONFIG_ESPB_CALL_IC_ENTRIES 32
+#endif
+#ifndef CONFIG_ESPB_CALLBACK_MAX_CLOSURES
+#define CONFIG_ESPB_CALLBACK_MAX_CLOSURES 32
+#endif
+#ifndef CONFIG_ESPB_CALLBACK_POOL_SIZE
+#define CONFIG_ESPB_CALLBACK_POOL_SIZE 4
+#endif
+
+// Options that depend on enabled bool options (values as in Kconfig)
+#if defined(CONFIG_ESPB_ASYNC_CALLS) && CONFIG_ESPB_ASYNC_CALLS
+#ifndef CONFIG_ESPB_ASYNC_WORKERS_PER_CORE
+#define CONFIG_ESPB_ASYNC_WORKERS_PER_CORE 1
+#endif
+#ifndef CONFIG_ESPB_ASYNC_QUEUE_LENGTH
+#define CONFIG_ESPB_ASYNC_QUEUE_LENGTH 16
+#endif
+#ifndef CONFIG_ESPB_ASYNC_TASK_STACK_SIZE
+#define CONFIG_ESPB_ASYNC_TASK_STACK_SIZE 8192
+#endif
+#ifndef CONFIG_ESPB_ASYNC_TASK_PRIORITY
+#define CONFIG_ESPB_ASYNC_TASK_PRIORITY 5
+#endif
+#endif
+#if defined(CONFIG_ESPB_FUEL) && CONFIG_ESPB_FUEL && !defined(CONFIG_ESPB_FUEL_SLICE)
+#define CONFIG_ESPB_FUEL_SLICE 10000
+#endif
+#if defined(CONFIG_ESPB_GREEN_THREADS) && CONFIG_ESPB_GREEN_THREADS && !defined(CONFIG_ESPB_GREEN_PRIORITIES)
+#define CONFIG_ESPB_GREEN_PRIORITIES 4
+#endif
+#if defined(CONFIG_ESPB_SAMPLER) && CONFIG_ESPB_SAMPLER
+#ifndef CONFIG_ESPB_SAMPLER_PERIOD_US
+#define CONFIG_ESPB_SAMPLER_PERIOD_US 1000
+#endif
+#ifndef CONFIG_ESPB_SAMPLER_SLOTS
+#define CONFIG_ESPB_SAMPLER_SLOTS 256
+#endif
+#ifndef CONFIG_ESPB_SAMPLER_STACKS
+#define CONFIG_ESPB_SAMPLER_STACKS 64
+#endif
+#endif
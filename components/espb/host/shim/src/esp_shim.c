@@ -0,0 +1,270 @@
+// ESP-IDF system services on top of libc: heap_caps, log, timers, partitions, GPIO.
+#define _GNU_SOURCE
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_app_desc.h"
+#include "esp_cpu.h"
+#include "esp_err.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_rom_sys.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+
+// --- heap_caps ---
+
+// Guest pointers are 32-bit (the device ABI is ILP32). Together with the non-PIE link
+// this keeps every heap block below 4 GB: no mmap-backed blocks and no per-thread
+// arenas, only the brk heap right after .bss.
+__attribute__((constructor)) static void host_heap_init(void) {
+    mallopt(M_MMAP_MAX, 0);
+    mallopt(M_ARENA_MAX, 1);
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps) { (void)caps; return malloc(size); }
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps) { (void)caps; return calloc(n, size); }
+void *heap_caps_realloc(void *ptr, size_t size, uint32_t caps) { (void)caps; return realloc(ptr, size); }
+void heap_caps_free(void *ptr) { free(ptr); }
+
+void *heap_caps_aligned_alloc(size_t alignment, size_t size, uint32_t caps) {
+    (void)caps;
+    void *p = NULL;
+    if (alignment < sizeof(void *)) alignment = sizeof(void *);
+    return posix_memalign(&p, alignment, size) == 0 ? p : NULL;
+}
+
+// The host heap is not bounded: report a large constant so budget checks pass
+#define HOST_FREE_HEAP (64u * 1024u * 1024u)
+
+size_t heap_caps_get_free_size(uint32_t caps) { (void)caps; return HOST_FREE_HEAP; }
+size_t heap_caps_get_largest_free_block(uint32_t caps) { (void)caps; return HOST_FREE_HEAP; }
+bool heap_caps_check_integrity_all(bool print_errors) { (void)print_errors; return true; }
+uint32_t esp_get_free_heap_size(void) { return HOST_FREE_HEAP; }
+
+// --- Time ---
+
+static uint64_t host_now_ns(void) {
+    static uint64_t start_ns;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t now = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+    if (!start_ns) start_ns = now;
+    return now - start_ns;
+}
+
+int64_t esp_timer_get_time(void) { return (int64_t)(host_now_ns() / 1000u); }
+
+// --- esp_timer: one thread per timer, callbacks run on it ---
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void *arg;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    uint64_t period_us;     // 0 - stopped
+    uint64_t generation;    // Bumped by start/stop so a sleeping thread re-reads its deadline
+    bool exit;
+};
+
+static struct timespec timer_deadline(uint64_t after_us) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t ns = (uint64_t)ts.tv_nsec + after_us * 1000u;
+    ts.tv_sec += (time_t)(ns / 1000000000ull);
+    ts.tv_nsec = (long)(ns % 1000000000ull);
+    return ts;
+}
+
+static void *timer_thread(void *p) {
+    struct esp_timer *t = (struct esp_timer *)p;
+    pthread_mutex_lock(&t->mutex);
+    while (!t->exit) {
+        if (t->period_us == 0) {
+            pthread_cond_wait(&t->cond, &t->mutex);
+            continue;
+        }
+        uint64_t generation = t->generation;
+        struct timespec dl = timer_deadline(t->period_us);
+        int rc = 0;
+        while (!t->exit && t->generation == generation && rc != ETIMEDOUT) {
+            rc = pthread_cond_timedwait(&t->cond, &t->mutex, &dl);
+        }
+        if (t->exit || t->generation != generation) continue;
+        pthread_mutex_unlock(&t->mutex);
+        t->callback(t->arg);
+        pthread_mutex_lock(&t->mutex);
+    }
+    pthread_mutex_unlock(&t->mutex);
+    return NULL;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out_handle) {
+    if (!args || !args->callback || !out_handle) return ESP_ERR_INVALID_ARG;
+    struct esp_timer *t = calloc(1, sizeof(*t));
+    if (!t) return ESP_ERR_NO_MEM;
+    t->callback = args->callback;
+    t->arg = args->arg;
+    pthread_mutex_init(&t->mutex, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&t->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    if (pthread_create(&t->thread, NULL, timer_thread, t) != 0) {
+        pthread_cond_destroy(&t->cond);
+        pthread_mutex_destroy(&t->mutex);
+        free(t);
+        return ESP_ERR_NO_MEM;
+    }
+    *out_handle = t;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us) {
+    if (!timer || period_us == 0) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&timer->mutex);
+    esp_err_t err = ESP_ERR_INVALID_STATE;
+    if (timer->period_us == 0) {
+        timer->period_us = period_us;
+        timer->generation++;
+        pthread_cond_signal(&timer->cond);
+        err = ESP_OK;
+    }
+    pthread_mutex_unlock(&timer->mutex);
+    return err;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    if (!timer) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&timer->mutex);
+    esp_err_t err = ESP_ERR_INVALID_STATE;
+    if (timer->period_us != 0) {
+        timer->period_us = 0;
+        timer->generation++;
+        pthread_cond_signal(&timer->cond);
+        err = ESP_OK;
+    }
+    pthread_mutex_unlock(&timer->mutex);
+    return err;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    if (!timer) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&timer->mutex);
+    if (timer->period_us != 0) {
+        pthread_mutex_unlock(&timer->mutex);
+        return ESP_ERR_INVALID_STATE; // Like ESP-IDF: a running timer must be stopped first
+    }
+    timer->exit = true;
+    pthread_cond_signal(&timer->cond);
+    pthread_mutex_unlock(&timer->mutex);
+    pthread_join(timer->thread, NULL);
+    pthread_cond_destroy(&timer->cond);
+    pthread_mutex_destroy(&timer->mutex);
+    free(timer);
+    return ESP_OK;
+}
+uint32_t esp_cpu_get_cycle_count(void) { return (uint32_t)host_now_ns(); }
+// Cycle counts are nanoseconds: 1000 "cycles" per microsecond
+uint32_t esp_rom_get_cpu_ticks_per_us(void) { return 1000; }
+
+// --- Log ---
+
+uint32_t esp_log_timestamp(void) { return (uint32_t)(host_now_ns() / 1000000u); }
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...) {
+    (void)tag;
+    va_list ap;
+    va_start(ap, format);
+    vfprintf(level <= ESP_LOG_WARN ? stderr : stdout, format, ap);
+    va_end(ap);
+}
+
+const char *esp_err_to_name(esp_err_t code) {
+    switch (code) {
+    case ESP_OK: return "ESP_OK";
+    case ESP_FAIL: return "ESP_FAIL";
+    case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+    case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+    case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+    case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+    case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+    case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+    default: return "UNKNOWN_ERROR";
+    }
+}
+
+void esp_restart(void) {
+    fprintf(stderr, "esp_restart() called\n");
+    exit(1);
+}
+
+// --- Partitions: none on the host ---
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                 const char *label) {
+    (void)type; (void)subtype; (void)label;
+    return NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t offset, void *dst, size_t size) {
+    (void)partition; (void)offset; (void)dst; (void)size;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t offset, const void *src, size_t size) {
+    (void)partition; (void)offset; (void)src; (void)size;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size) {
+    (void)partition; (void)offset; (void)size;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *partition, size_t offset, size_t size,
+                             esp_partition_mmap_memory_t memory, const void **out_ptr,
+                             esp_partition_mmap_handle_t *out_handle) {
+    (void)partition; (void)offset; (void)size; (void)memory; (void)out_ptr; (void)out_handle;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void esp_partition_munmap(esp_partition_mmap_handle_t handle) { (void)handle; }
+
+const esp_app_desc_t *esp_app_get_description(void) {
+    static const esp_app_desc_t desc = { .version = "host", .project_name = "espb_host" };
+    return &desc;
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int b = 0; b < 8; b++) crc = (crc >> 1) ^ (0xedb88320u & (0u - (crc & 1u)));
+    }
+    return ~crc;
+}
+
+// --- GPIO: logged only ---
+
+esp_err_t gpio_config(const gpio_config_t *config) {
+    if (!config) return ESP_ERR_INVALID_ARG;
+    ESP_LOGI("gpio", "gpio_config(mask=0x%llx, mode=%d)", (unsigned long long)config->pin_bit_mask, config->mode);
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level) {
+    ESP_LOGI("gpio", "gpio_set_level(%d, %u)", gpio_num, (unsigned)level);
+    return ESP_OK;
+}
@@ -0,0 +1,421 @@
+// FreeRTOS subset on POSIX threads. Tasks run truly in parallel and priorities are
+// ignored; ticks are milliseconds of CLOCK_MONOTONIC.
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+
+// --- Time ---
+
+static struct timespec deadline_after(TickType_t ticks) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t ns = (uint64_t)ts.tv_nsec + (uint64_t)ticks * portTICK_PERIOD_MS * 1000000ull;
+    ts.tv_sec += (time_t)(ns / 1000000000ull);
+    ts.tv_nsec = (long)(ns % 1000000000ull);
+    return ts;
+}
+
+static void cond_init_monotonic(pthread_cond_t *cond) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+// Waits on cond until pred holds; ticks == 0 polls, portMAX_DELAY waits forever
+#define WAIT_UNTIL(pred, cond, mutex, ticks, ok) do { \
+        struct timespec dl_ = deadline_after(ticks); \
+        (ok) = 1; \
+        while (!(pred)) { \
+            if ((ticks) == 0) { (ok) = 0; break; } \
+            if ((ticks) == portMAX_DELAY) { pthread_cond_wait((cond), (mutex)); continue; } \
+            if (pthread_cond_timedwait((cond), (mutex), &dl_) == ETIMEDOUT && !(pred)) { (ok) = 0; break; } \
+        } \
+    } while (0)
+
+TickType_t xTaskGetTickCount(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t ms = (uint64_t)ts.tv_sec * 1000ull + (uint64_t)ts.tv_nsec / 1000000ull;
+    return (TickType_t)(ms / portTICK_PERIOD_MS);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    if (ticks == 0) {
+        sched_yield();
+        return;
+    }
+    struct timespec ts = { .tv_sec = (time_t)(ticks * portTICK_PERIOD_MS / 1000),
+                           .tv_nsec = (long)(ticks * portTICK_PERIOD_MS % 1000) * 1000000L };
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {}
+}
+
+void vTaskYield(void) { sched_yield(); }
+
+// --- Tasks ---
+
+struct HostTask {
+    TaskFunction_t fn;
+    void *arg;
+};
+
+static __thread TaskHandle_t current_task;
+static struct HostTask main_task;
+
+static void *task_entry(void *p) {
+    TaskHandle_t task = (TaskHandle_t)p;
+    current_task = task;
+    task->fn(task->arg);
+    // A FreeRTOS task must not return; treat it as vTaskDelete(NULL)
+    vTaskDelete(NULL);
+    return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *out_handle, BaseType_t core_id) {
+    (void)name; (void)priority; (void)core_id;
+    TaskHandle_t task = calloc(1, sizeof(*task));
+    if (!task) return pdFAIL;
+    task->fn = fn;
+    task->arg = arg;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    // Interpreter frames are larger on a 64-bit host: never go below 256 KB
+    size_t stack = (size_t)stack_depth * 4u;
+    if (stack < 256u * 1024u) stack = 256u * 1024u;
+    pthread_attr_setstacksize(&attr, stack);
+    pthread_t thread;
+    int rc = pthread_create(&thread, &attr, task_entry, task);
+    pthread_attr_destroy(&attr);
+    if (rc != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    if (out_handle) *out_handle = task;
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stack_depth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *out_handle) {
+    return xTaskCreatePinnedToCore(fn, name, stack_depth, arg, priority, out_handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task != NULL && task != current_task) return; // Killing another thread is not supported
+    if (current_task == NULL || current_task == &main_task) pthread_exit(NULL);
+    free(current_task);
+    current_task = NULL;
+    pthread_exit(NULL);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    if (!current_task) current_task = &main_task;
+    return current_task;
+}
+
+eTaskState eTaskGetState(TaskHandle_t task) {
+    return task ? eRunning : eInvalid;
+}
+
+// --- Semaphores and mutexes ---
+
+typedef enum {
+    SEM_MUTEX,
+    SEM_RECURSIVE,
+    SEM_COUNTING,
+} HostSemKind;
+
+struct HostSemaphore {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    HostSemKind kind;
+    UBaseType_t count;
+    UBaseType_t max_count;
+    TaskHandle_t owner;     // Recursive mutex only
+    UBaseType_t depth;
+};
+
+static SemaphoreHandle_t sem_create(HostSemKind kind, UBaseType_t max_count, UBaseType_t initial) {
+    SemaphoreHandle_t sem = calloc(1, sizeof(*sem));
+    if (!sem) return NULL;
+    pthread_mutex_init(&sem->lock, NULL);
+    cond_init_monotonic(&sem->cond);
+    sem->kind = kind;
+    sem->max_count = max_count;
+    sem->count = initial;
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) { return sem_create(SEM_MUTEX, 1, 1); }
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void) { return sem_create(SEM_RECURSIVE, 1, 1); }
+SemaphoreHandle_t xSemaphoreCreateBinary(void) { return sem_create(SEM_COUNTING, 1, 0); }
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count) {
+    return sem_create(SEM_COUNTING, max_count, initial_count);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks) {
+    if (!sem) return pdFAIL;
+    int ok;
+    pthread_mutex_lock(&sem->lock);
+    WAIT_UNTIL(sem->count > 0, &sem->cond, &sem->lock, ticks, ok);
+    if (ok) sem->count--;
+    pthread_mutex_unlock(&sem->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem) {
+    if (!sem) return pdFAIL;
+    BaseType_t ret = pdFALSE;
+    pthread_mutex_lock(&sem->lock);
+    if (sem->count < sem->max_count) {
+        sem->count++;
+        pthread_cond_signal(&sem->cond);
+        ret = pdTRUE;
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return ret;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t sem, TickType_t ticks) {
+    if (!sem) return pdFAIL;
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    int ok;
+    pthread_mutex_lock(&sem->lock);
+    WAIT_UNTIL(sem->count > 0 || sem->owner == self, &sem->cond, &sem->lock, ticks, ok);
+    if (ok) {
+        if (sem->owner != self) {
+            sem->count--;
+            sem->owner = self;
+        }
+        sem->depth++;
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return ok ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t sem) {
+    if (!sem) return pdFAIL;
+    BaseType_t ret = pdFALSE;
+    pthread_mutex_lock(&sem->lock);
+    if (sem->owner == xTaskGetCurrentTaskHandle() && sem->depth > 0) {
+        if (--sem->depth == 0) {
+            sem->owner = NULL;
+            sem->count = 1;
+            pthread_cond_signal(&sem->cond);
+        }
+        ret = pdTRUE;
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return ret;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t sem, BaseType_t *higher_prio_woken) {
+    if (higher_prio_woken) *higher_prio_woken = pdFALSE;
+    return xSemaphoreGive(sem);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem) {
+    if (!sem) return;
+    pthread_cond_destroy(&sem->cond);
+    pthread_mutex_destroy(&sem->lock);
+    free(sem);
+}
+
+// --- Queues ---
+
+struct HostQueue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    UBaseType_t length;
+    UBaseType_t item_size;
+    UBaseType_t head;
+    UBaseType_t count;
+    uint8_t *items;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+    if (length == 0) return NULL;
+    QueueHandle_t q = calloc(1, sizeof(*q));
+    if (!q) return NULL;
+    q->items = malloc((size_t)length * (item_size ? item_size : 1));
+    if (!q->items) {
+        free(q);
+        return NULL;
+    }
+    pthread_mutex_init(&q->lock, NULL);
+    cond_init_monotonic(&q->not_empty);
+    cond_init_monotonic(&q->not_full);
+    q->length = length;
+    q->item_size = item_size;
+    return q;
+}
+
+static BaseType_t queue_send(QueueHandle_t q, const void *item, TickType_t ticks, int front) {
+    if (!q) return pdFAIL;
+    int ok;
+    pthread_mutex_lock(&q->lock);
+    WAIT_UNTIL(q->count < q->length, &q->not_full, &q->lock, ticks, ok);
+    if (ok) {
+        UBaseType_t slot;
+        if (front) {
+            q->head = (q->head + q->length - 1) % q->length;
+            slot = q->head;
+        } else {
+            slot = (q->head + q->count) % q->length;
+        }
+        if (q->item_size) memcpy(q->items + (size_t)slot * q->item_size, item, q->item_size);
+        q->count++;
+        pthread_cond_signal(&q->not_empty);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok ? pdPASS : pdFAIL;
+}
+
+BaseType_t xQueueSend(QueueHandle_t q, const void *item, TickType_t ticks) { return queue_send(q, item, ticks, 0); }
+BaseType_t xQueueSendToBack(QueueHandle_t q, const void *item, TickType_t ticks) { return queue_send(q, item, ticks, 0); }
+BaseType_t xQueueSendToFront(QueueHandle_t q, const void *item, TickType_t ticks) { return queue_send(q, item, ticks, 1); }
+
+BaseType_t xQueueReceive(QueueHandle_t q, void *item, TickType_t ticks) {
+    if (!q) return pdFAIL;
+    int ok;
+    pthread_mutex_lock(&q->lock);
+    WAIT_UNTIL(q->count > 0, &q->not_empty, &q->lock, ticks, ok);
+    if (ok) {
+        if (q->item_size) memcpy(item, q->items + (size_t)q->head * q->item_size, q->item_size);
+        q->head = (q->head + 1) % q->length;
+        q->count--;
+        pthread_cond_signal(&q->not_full);
+    }
+    pthread_mutex_unlock(&q->lock);
+    return ok ? pdPASS : pdFAIL;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t q) {
+    if (!q) return 0;
+    pthread_mutex_lock(&q->lock);
+    UBaseType_t n = q->count;
+    pthread_mutex_unlock(&q->lock);
+    return n;
+}
+
+void vQueueDelete(QueueHandle_t q) {
+    if (!q) return;
+    pthread_cond_destroy(&q->not_empty);
+    pthread_cond_destroy(&q->not_full);
+    pthread_mutex_destroy(&q->lock);
+    free(q->items);
+    free(q);
+}
+
+// --- Software timers: one detached thread per timer, started on first command ---
+
+struct HostTimer {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    TickType_t period;
+    UBaseType_t auto_reload;
+    void *id;
+    TimerCallbackFunction_t callback;
+    uint32_t generation;    // Bumped by every command so the thread re-arms
+    int running;
+    int deleted;
+    int thread_started;
+};
+
+static void *timer_thread(void *p) {
+    TimerHandle_t t = (TimerHandle_t)p;
+    pthread_mutex_lock(&t->lock);
+    while (!t->deleted) {
+        if (!t->running) {
+            pthread_cond_wait(&t->cond, &t->lock);
+            continue;
+        }
+        uint32_t gen = t->generation;
+        struct timespec dl = deadline_after(t->period);
+        int rc = 0;
+        while (rc != ETIMEDOUT && t->generation == gen && !t->deleted) {
+            rc = pthread_cond_timedwait(&t->cond, &t->lock, &dl);
+        }
+        if (t->generation != gen || t->deleted) continue;
+        t->running = t->auto_reload ? 1 : 0;
+        pthread_mutex_unlock(&t->lock);
+        t->callback(t);
+        pthread_mutex_lock(&t->lock);
+    }
+    pthread_mutex_unlock(&t->lock);
+    pthread_cond_destroy(&t->cond);
+    pthread_mutex_destroy(&t->lock);
+    free(t);
+    return NULL;
+}
+
+TimerHandle_t xTimerCreate(const char *name, TickType_t period, UBaseType_t auto_reload, void *timer_id,
+                           TimerCallbackFunction_t callback) {
+    (void)name;
+    if (period == 0 || !callback) return NULL;
+    TimerHandle_t t = calloc(1, sizeof(*t));
+    if (!t) return NULL;
+    pthread_mutex_init(&t->lock, NULL);
+    cond_init_monotonic(&t->cond);
+    t->period = period;
+    t->auto_reload = auto_reload;
+    t->id = timer_id;
+    t->callback = callback;
+    return t;
+}
+
+void *pvTimerGetTimerID(TimerHandle_t timer) {
+    return timer ? timer->id : NULL;
+}
+
+BaseType_t xTimerGenericCommand(TimerHandle_t timer, BaseType_t command, TickType_t optional_value,
+                                BaseType_t *higher_prio_woken, TickType_t ticks_to_wait) {
+    (void)optional_value; (void)ticks_to_wait;
+    if (higher_prio_woken) *higher_prio_woken = pdFALSE;
+    if (!timer) return pdFAIL;
+
+    pthread_mutex_lock(&timer->lock);
+    if (command == tmrCOMMAND_DELETE && !timer->thread_started) {
+        pthread_mutex_unlock(&timer->lock);
+        pthread_cond_destroy(&timer->cond);
+        pthread_mutex_destroy(&timer->lock);
+        free(timer);
+        return pdPASS;
+    }
+    switch (command) {
+    case tmrCOMMAND_START: timer->running = 1; break;
+    case tmrCOMMAND_STOP: timer->running = 0; break;
+    case tmrCOMMAND_DELETE: timer->deleted = 1; break;
+    default:
+        pthread_mutex_unlock(&timer->lock);
+        return pdFAIL;
+    }
+    timer->generation++;
+    if (!timer->thread_started && timer->running) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, timer_thread, timer) != 0) {
+            timer->running = 0;
+            pthread_mutex_unlock(&timer->lock);
+            return pdFAIL;
+        }
+        pthread_detach(thread);
+        timer->thread_started = 1;
+    }
+    pthread_cond_broadcast(&timer->cond);
+    pthread_mutex_unlock(&timer->lock);
+    return pdPASS;
+}
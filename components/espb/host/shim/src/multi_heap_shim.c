@@ -0,0 +1,142 @@
+// First-fit heap inside a caller-provided region, standing in for the ESP-IDF multi_heap.
+// The handle is the region start and blocks are chained by size, with no absolute pointers,
+// so a byte copy of the region (instance snapshots) is a valid heap at the new base.
+#include <stdint.h>
+#include <string.h>
+
+#include "multi_heap.h"
+
+#define HEAP_ALIGN        8u
+#define BLOCK_MAGIC       0x4b4c4248u // "HBLK"
+#define ALIGNED_MAGIC     0x4e4c4148u // "HALN"
+#define BLOCK_USED        1u
+
+typedef struct {
+    uint32_t size_flags; // Block size including the header; bit 0 - used
+    uint32_t magic;
+} HeapBlock;
+
+// Placed in front of a pointer returned by multi_heap_aligned_alloc
+typedef struct {
+    uint32_t back;       // Distance back to the payload of the owning block
+    uint32_t magic;
+} AlignedTag;
+
+struct multi_heap_info {
+    uint32_t size;       // Bytes from the handle to the end of the region
+    uint32_t free_bytes;
+    uint32_t min_free_bytes; // Low-water mark of free_bytes
+};
+
+#define HEAP_FIRST_OFFSET ((uint32_t)((sizeof(struct multi_heap_info) + HEAP_ALIGN - 1) & ~(HEAP_ALIGN - 1)))
+
+static inline uint32_t block_size(const HeapBlock *b) { return b->size_flags & ~BLOCK_USED; }
+static inline int block_used(const HeapBlock *b) { return (b->size_flags & BLOCK_USED) != 0; }
+static inline uint8_t *heap_base(multi_heap_handle_t heap) { return (uint8_t *)heap; }
+static inline HeapBlock *heap_end(multi_heap_handle_t heap) { return (HeapBlock *)(heap_base(heap) + heap->size); }
+static inline HeapBlock *block_next(HeapBlock *b) { return (HeapBlock *)((uint8_t *)b + block_size(b)); }
+
+multi_heap_handle_t multi_heap_register(void *start, size_t size) {
+    uintptr_t base = ((uintptr_t)start + HEAP_ALIGN - 1) & ~(uintptr_t)(HEAP_ALIGN - 1);
+    size_t lost = base - (uintptr_t)start;
+    if (!start || size < lost + HEAP_FIRST_OFFSET + 2 * sizeof(HeapBlock) || size - lost > UINT32_MAX) return NULL;
+    size = (size - lost) & ~(size_t)(HEAP_ALIGN - 1);
+
+    multi_heap_handle_t heap = (multi_heap_handle_t)base;
+    heap->size = (uint32_t)size;
+    HeapBlock *first = (HeapBlock *)(heap_base(heap) + HEAP_FIRST_OFFSET);
+    first->size_flags = heap->size - HEAP_FIRST_OFFSET;
+    first->magic = BLOCK_MAGIC;
+    heap->free_bytes = first->size_flags - sizeof(HeapBlock);
+    heap->min_free_bytes = heap->free_bytes;
+    return heap;
+}
+
+void *multi_heap_malloc(multi_heap_handle_t heap, size_t size) {
+    if (!heap || size == 0 || size > heap->size) return NULL;
+    uint32_t need = (uint32_t)((size + sizeof(HeapBlock) + HEAP_ALIGN - 1) & ~(size_t)(HEAP_ALIGN - 1));
+    HeapBlock *end = heap_end(heap);
+    for (HeapBlock *b = (HeapBlock *)(heap_base(heap) + HEAP_FIRST_OFFSET); b < end; b = block_next(b)) {
+        if (block_used(b)) continue;
+        // Free neighbours are merged lazily here instead of on every free
+        for (HeapBlock *n = block_next(b); n < end && !block_used(n); n = block_next(b)) {
+            b->size_flags += block_size(n);
+            heap->free_bytes += sizeof(HeapBlock);
+        }
+        if (block_size(b) < need) continue;
+        if (block_size(b) - need >= sizeof(HeapBlock) + HEAP_ALIGN) {
+            HeapBlock *rest = (HeapBlock *)((uint8_t *)b + need);
+            rest->size_flags = block_size(b) - need;
+            rest->magic = BLOCK_MAGIC;
+            b->size_flags = need;
+            heap->free_bytes -= sizeof(HeapBlock);
+        }
+        b->size_flags |= BLOCK_USED;
+        heap->free_bytes -= block_size(b) - sizeof(HeapBlock);
+        if (heap->free_bytes < heap->min_free_bytes) heap->min_free_bytes = heap->free_bytes;
+        return b + 1;
+    }
+    return NULL;
+}
+
+static HeapBlock *block_of(void *p) {
+    AlignedTag *tag = (AlignedTag *)p - 1;
+    if (tag->magic == ALIGNED_MAGIC) p = (uint8_t *)p - tag->back;
+    HeapBlock *b = (HeapBlock *)p - 1;
+    return (b->magic == BLOCK_MAGIC && block_used(b)) ? b : NULL;
+}
+
+void multi_heap_free(multi_heap_handle_t heap, void *p) {
+    if (!heap || !p) return;
+    HeapBlock *b = block_of(p);
+    if (!b) return;
+    b->size_flags &= ~BLOCK_USED;
+    heap->free_bytes += block_size(b) - sizeof(HeapBlock);
+}
+
+void *multi_heap_aligned_alloc(multi_heap_handle_t heap, size_t size, size_t alignment) {
+    if (alignment <= HEAP_ALIGN) return multi_heap_malloc(heap, size);
+    if (alignment & (alignment - 1)) return NULL;
+    uint8_t *raw = multi_heap_malloc(heap, size + alignment + sizeof(AlignedTag));
+    if (!raw) return NULL;
+    uint8_t *p = (uint8_t *)(((uintptr_t)raw + sizeof(AlignedTag) + alignment - 1) & ~(uintptr_t)(alignment - 1));
+    AlignedTag *tag = (AlignedTag *)p - 1;
+    tag->back = (uint32_t)(p - raw);
+    tag->magic = ALIGNED_MAGIC;
+    return p;
+}
+
+void multi_heap_aligned_free(multi_heap_handle_t heap, void *p) {
+    multi_heap_free(heap, p);
+}
+
+size_t multi_heap_get_allocated_size(multi_heap_handle_t heap, void *p) {
+    (void)heap;
+    if (!p) return 0;
+    HeapBlock *b = block_of(p);
+    if (!b) return 0;
+    return (size_t)((uint8_t *)block_next(b) - (uint8_t *)p);
+}
+
+void *multi_heap_realloc(multi_heap_handle_t heap, void *p, size_t size) {
+    if (!p) return multi_heap_malloc(heap, size);
+    if (size == 0) {
+        multi_heap_free(heap, p);
+        return NULL;
+    }
+    size_t old_size = multi_heap_get_allocated_size(heap, p);
+    if (size <= old_size) return p;
+    void *np = multi_heap_malloc(heap, size);
+    if (!np) return NULL;
+    memcpy(np, p, old_size);
+    multi_heap_free(heap, p);
+    return np;
+}
+
+size_t multi_heap_free_size(multi_heap_handle_t heap) {
+    return heap ? heap->free_bytes : 0;
+}
+
+size_t multi_heap_minimum_free_size(multi_heap_handle_t heap) {
+    return heap ? heap->min_free_bytes : 0;
+}
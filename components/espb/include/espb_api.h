@@ -21,10 +21,23 @@
 #include <stdint.h>
 #include <stddef.h>
 #include "espb_interpreter_common_types.h"
+#include "espb_loader.h"
+#include "freertos/queue.h" // QueueHandle_t для espb_call_function_async
+#include "freertos/task.h"  // TaskHandle_t для espb_sampler_start
 
 // Определяем непрозрачный указатель для дескриптора модуля
 typedef struct espb_module_handle_t* espb_handle_t;
 
+// Разобранный модуль, из которого создаётся несколько экземпляров (см. espb_create_module)
+typedef EspbModule* espb_module_t;
+
+// Предварительно разрешённая функция модуля (глобальный индекс: импорты + локальные)
+typedef uint32_t espb_func_t;
+#define ESPB_INVALID_FUNC ((espb_func_t)UINT32_MAX)
+
+// Контекст выполнения, которым владеет вызывающая сторона (см. espb_call_function_with_ctx)
+typedef struct ExecutionContext* espb_exec_ctx_t;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -48,6 +61,127 @@ EspbResult espb_load_module(const uint8_t *espb_data, size_t espb_size, espb_han
  */
 void espb_unload_module(espb_handle_t handle);
 
+/**
+ * @brief Заменяет загруженный модуль новой версией.
+ *
+ * Новая версия загружается как espb_load_module (память и глобалы - с нуля), затем старая
+ * выгружается. С CONFIG_ESPB_JIT_RELOAD JIT-код функций, которые не изменились (байт-код,
+ * сигнатуры, импорты и глобалы, от которых зависит код), переносится в новый экземпляр
+ * без перекомпиляции; остальные функции компилируются как обычно.
+ * Вызовы через старый дескриптор должны быть завершены.
+ *
+ * @param handle Дескриптор текущей версии; при ошибке остаётся рабочим.
+ * @param out_handle Дескриптор новой версии.
+ */
+EspbResult espb_reload_module(espb_handle_t handle, const uint8_t *espb_data, size_t espb_size,
+                              espb_handle_t *out_handle);
+
+/**
+ * @brief Разбирает модуль ESPB один раз для создания нескольких экземпляров.
+ *
+ * Таблицы модуля, байт-код и JIT-код общие для всех экземпляров; у каждого
+ * экземпляра своя линейная память, глобальные переменные и таблицы. JIT-код
+ * получает экземпляр в регистре и не содержит его адресов, поэтому компилируется
+ * один раз на модуль и не вытесняется по бюджету IRAM.
+ *
+ * Буфер espb_data должен жить, пока живы модуль и все его экземпляры.
+ *
+ * @param espb_data Указатель на данные модуля ESPB.
+ * @param espb_size Размер данных модуля в байтах.
+ * @param out_module Указатель для сохранения модуля.
+ * @return ESPB_OK в случае успеха, или код ошибки.
+ */
+EspbResult espb_create_module(const uint8_t *espb_data, size_t espb_size, espb_module_t *out_module);
+
+/**
+ * @brief Загружает и инстанцирует модуль ESPB, записанный в data-раздел flash.
+ *
+ * Раздел отображается через esp_partition_mmap, и модуль разбирается на месте:
+ * байт-код, сегменты данных и имена импортов/экспортов читаются из кэша flash,
+ * а не копируются в DRAM. Отображение снимается вместе с модулем.
+ *
+ * @param partition_label Метка раздела (тип data, подтип любой).
+ * @param out_handle Указатель на переменную для сохранения дескриптора модуля.
+ * @return ESPB_OK в случае успеха, или код ошибки.
+ */
+EspbResult espb_load_module_from_partition(const char *partition_label, espb_handle_t *out_handle);
+
+/**
+ * @brief То же, что espb_create_module, но для модуля в data-разделе flash.
+ *
+ * @param partition_label Метка раздела (тип data, подтип любой).
+ * @param out_module Указатель для сохранения модуля.
+ * @return ESPB_OK в случае успеха, или код ошибки.
+ */
+EspbResult espb_create_module_from_partition(const char *partition_label, espb_module_t *out_module);
+
+/**
+ * @brief Завершает потоковую загрузку (espb_loader_begin / espb_loader_feed) и
+ * инстанцирует модуль, как espb_load_module. Загрузчик освобождается в любом случае.
+ *
+ * @param loader Загрузчик, получивший весь файл модуля.
+ * @param out_handle Указатель на переменную для сохранения дескриптора модуля.
+ * @return ESPB_OK в случае успеха, или код ошибки.
+ */
+EspbResult espb_loader_finish(espb_loader_t loader, espb_handle_t *out_handle);
+
+/**
+ * @brief То же, что espb_loader_finish, но возвращает разделяемый модуль,
+ * как espb_create_module.
+ *
+ * @param loader Загрузчик, получивший весь файл модуля.
+ * @param out_module Указатель для сохранения модуля.
+ * @return ESPB_OK в случае успеха, или код ошибки.
+ */
+EspbResult espb_loader_finish_module(espb_loader_t loader, espb_module_t *out_module);
+
+/**
+ * @brief Создаёт новый экземпляр модуля, полученного от espb_create_module.
+ *
+ * Экземпляр освобождается espb_unload_module. Модули с импортируемой памятью
+ * ("memory") получают в каждом экземпляре одну и ту же память хоста.
+ * Экземпляры одного модуля создаются последовательно (не из нескольких задач сразу),
+ * вызывать их функции можно из разных задач.
+ *
+ * @param module Разделяемый модуль.
+ * @param out_handle Указатель для сохранения дескриптора экземпляра.
+ * @return ESPB_OK в случае успеха, или код ошибки.
+ */
+EspbResult espb_instantiate_module(espb_module_t module, espb_handle_t *out_handle);
+
+/**
+ * @brief Освобождает ссылку на модуль, полученную от espb_create_module.
+ *
+ * Уже созданные экземпляры остаются рабочими: модуль освобождается вместе
+ * с последним из них.
+ *
+ * @param module Разделяемый модуль (может быть NULL).
+ */
+void espb_release_module(espb_module_t module);
+
+/*
+ * Параллельные вызовы одного экземпляра (CONFIG_ESPB_CONCURRENT_CALLS).
+ *
+ * Функции экземпляра можно вызывать одновременно из нескольких задач на обоих ядрах.
+ * Всё состояние исполнения принадлежит ExecutionContext вызывающей задачи: стек
+ * вызовов, shadow stack с регистрами кадров и блоки ALLOCA. espb_call и
+ * espb_call_function_sync берут контекст текущей задачи (CONFIG_ESPB_EXEC_CTX_CACHE),
+ * espb_call_function_with_ctx - контекст вызывающей стороны; один контекст в один
+ * момент времени использует только одна задача.
+ *
+ * Общее состояние экземпляра защищено так:
+ * - куча гостя (HEAP_MALLOC/FREE, ALLOCA, MEMORY.GROW) - мьютекс кучи экземпляра;
+ * - вызовы импортов через async wrapper (OUT-параметры immeta) - рекурсивный мьютекс,
+ *   такие вызовы одного экземпляра сериализуются;
+ * - компиляция JIT - мьютекс JIT модуля (или экземпляра), ленивая подготовка тел
+ *   функций - атомарное состояние тела;
+ * - кэши CIF, inline-кэш вызовов и реестр колбэков - атомарная публикация или мьютекс
+ *   системы колбэков.
+ *
+ * Глобальные переменные и линейная память гостя не синхронизируются: общие данные
+ * модуль защищает сам (атомарные опкоды). Счётчики профилировщика не атомарны.
+ * Без CONFIG_ESPB_CONCURRENT_CALLS экземпляр должен вызываться из одной задачи.
+ */
 
 /**
  * @brief Синхронно вызывает функцию в загруженном модуле ESPB.
@@ -61,6 +195,478 @@ void espb_unload_module(espb_handle_t handle);
  */
 EspbResult espb_call_function_sync(espb_handle_t handle, const char* function_name, const Value *args, uint32_t num_args, Value *results);
 
+/**
+ * @brief Разрешает имя экспортируемой функции в дескриптор для быстрых вызовов.
+ *
+ * Поиск выполняется один раз через хэш-индекс экспортов; полученный дескриптор
+ * действителен, пока модуль загружен.
+ *
+ * @param handle Дескриптор модуля.
+ * @param function_name Имя экспортируемой функции.
+ * @param out_func Указатель для сохранения дескриптора функции.
+ * @return ESPB_OK, или ESPB_ERR_INVALID_FUNC_INDEX если функция не найдена.
+ */
+EspbResult espb_get_function(espb_handle_t handle, const char* function_name, espb_func_t *out_func);
+
+/**
+ * @brief Синхронно вызывает функцию по дескриптору, полученному от espb_get_function.
+ *
+ * Не выполняет никаких строковых операций.
+ *
+ * @param handle Дескриптор модуля.
+ * @param func Дескриптор функции.
+ * @param args Массив аргументов для функции.
+ * @param num_args Количество аргументов в массиве.
+ * @param results Указатель на массив для сохранения результатов (может быть NULL).
+ * @return ESPB_OK в случае успешного выполнения, или код ошибки.
+ */
+EspbResult espb_call(espb_handle_t handle, espb_func_t func, const Value *args, uint32_t num_args, Value *results);
+
+/**
+ * @brief Создаёт контекст выполнения для многократного использования.
+ *
+ * Контекст не привязан к модулю и может использоваться с любым дескриптором,
+ * но только одним потоком одновременно.
+ *
+ * @param out_ctx Указатель для сохранения контекста.
+ * @return ESPB_OK, или ESPB_ERR_MEMORY_ALLOC.
+ */
+EspbResult espb_create_exec_ctx(espb_exec_ctx_t *out_ctx);
+
+/**
+ * @brief Освобождает контекст, созданный espb_create_exec_ctx.
+ *
+ * @param ctx Контекст выполнения (может быть NULL).
+ */
+void espb_destroy_exec_ctx(espb_exec_ctx_t ctx);
+
+/**
+ * @brief Вызывает функцию, используя контекст выполнения вызывающей стороны.
+ *
+ * Не выделяет память в куче (кроме роста shadow stack при первой глубокой рекурсии).
+ *
+ * @param handle Дескриптор модуля.
+ * @param ctx Контекст выполнения, полученный от espb_create_exec_ctx.
+ * @param func Дескриптор функции.
+ * @param args Массив аргументов для функции.
+ * @param num_args Количество аргументов в массиве.
+ * @param results Указатель на массив для сохранения результатов (может быть NULL).
+ * @return ESPB_OK в случае успешного выполнения, или код ошибки.
+ */
+EspbResult espb_call_function_with_ctx(espb_handle_t handle, espb_exec_ctx_t ctx, espb_func_t func, const Value *args, uint32_t num_args, Value *results);
+
+/**
+ * @brief Вызывает функцию count раз подряд, например фильтр для каждого отсчёта АЦП.
+ *
+ * Контекст выполнения, тело функции и её JIT-код берутся один раз на пакет; JIT-код
+ * исполняется плотным циклом в одном кадре регистров.
+ *
+ * @param handle Дескриптор модуля.
+ * @param func Дескриптор функции (espb_get_function).
+ * @param args Аргументы: i-й вызов получает args + i * stride (может быть NULL без параметров).
+ * @param stride Шаг между наборами аргументов в элементах Value (0 - одни и те же аргументы).
+ * @param count Количество вызовов.
+ * @param results Массив из count результатов (может быть NULL).
+ * @return ESPB_OK, или код ошибки первого неудачного вызова (последующие не выполняются).
+ */
+EspbResult espb_call_function_batch(espb_handle_t handle, espb_func_t func, const Value *args, size_t stride,
+                                    size_t count, Value *results);
+
+/**
+ * @brief Освобождает контекст выполнения, закэшированный для текущей задачи.
+ *
+ * espb_call и espb_call_function_sync держат по одному контексту на задачу
+ * (CONFIG_ESPB_EXEC_CTX_CACHE). Вызовите перед удалением задачи, чтобы вернуть память.
+ */
+void espb_release_task_exec_ctx(void);
+
+// Предел аргументов и результатов асинхронного вызова: они копируются в заявку
+#define ESPB_ASYNC_MAX_ARGS    8
+#define ESPB_ASYNC_MAX_RESULTS 2
+
+/**
+ * @brief Результат асинхронного вызова (espb_call_function_async).
+ */
+typedef struct {
+    espb_handle_t handle;
+    espb_func_t func;
+    EspbResult result;                      // ESPB_OK или код ошибки вызова
+    Value results[ESPB_ASYNC_MAX_RESULTS];  // Возвращаемые значения функции
+    void *user_data;
+} espb_async_result_t;
+
+// Вызывается в задаче-исполнителе сразу после завершения вызова.
+typedef void (*espb_async_done_t)(const espb_async_result_t *result);
+
+/**
+ * @brief Запускает пул исполнителей асинхронных вызовов (CONFIG_ESPB_ASYNC_CALLS).
+ *
+ * На каждом ядре создаётся CONFIG_ESPB_ASYNC_WORKERS_PER_CORE задач, закреплённых
+ * за ядром; все берут заявки из общей очереди и держат по одному контексту выполнения.
+ * Повторный вызов ничего не делает.
+ *
+ * @return ESPB_OK, ESPB_ERR_MEMORY_ALLOC, или ESPB_ERR_UNSUPPORTED если пул отключён.
+ */
+EspbResult espb_async_start(void);
+
+/**
+ * @brief Останавливает пул: исполнители завершают уже поставленные заявки и удаляются.
+ * Вызывать из задачи, не входящей в пул.
+ */
+void espb_async_stop(void);
+
+/**
+ * @brief Ставит вызов функции в очередь пула, не блокируя вызывающую задачу.
+ *
+ * Аргументы копируются. Результат передаётся колбэку done (в задаче-исполнителе) и/или
+ * отправляется в result_queue (элементы espb_async_result_t; исполнитель ждёт место
+ * в очереди). Дескриптор должен жить до завершения вызова. Можно вызывать из любой
+ * задачи, но не из ISR.
+ *
+ * @param handle Дескриптор модуля.
+ * @param func Дескриптор функции (espb_get_function).
+ * @param args Массив аргументов для функции.
+ * @param num_args Количество аргументов (не больше ESPB_ASYNC_MAX_ARGS).
+ * @param done Колбэк завершения (может быть NULL).
+ * @param result_queue Очередь результатов (может быть NULL).
+ * @param user_data Передаётся в espb_async_result_t.
+ * @return ESPB_OK, ESPB_ERR_QUEUE_FULL если очередь заполнена, ESPB_ERR_INVALID_STATE
+ *         если пул не запущен, или ESPB_ERR_UNSUPPORTED если пул отключён.
+ */
+EspbResult espb_call_function_async(espb_handle_t handle, espb_func_t func, const Value *args, uint32_t num_args,
+                                    espb_async_done_t done, QueueHandle_t result_queue, void *user_data);
+
+/**
+ * @brief Счётчики профилировщика для одной функции модуля.
+ */
+typedef struct {
+    espb_func_t func;               // Дескриптор функции (как у espb_get_function)
+    uint32_t calls;                 // Количество интерпретируемых входов
+    uint64_t inclusive_cycles;      // Такты CPU вместе с вызванными функциями
+    uint64_t exclusive_cycles;      // Такты CPU только в теле функции
+} espb_func_profile_t;
+
+/**
+ * @brief Снимает копию счётчиков профилировщика (CONFIG_ESPB_PROFILER).
+ *
+ * Учитывается только интерпретатор: функции, исполняемые JIT-кодом, не попадают
+ * в счётчики опкодов, а их вызовы из JIT не считаются. Счётчики не атомарны.
+ *
+ * @param handle Дескриптор модуля.
+ * @param opcode_counts Массив из 256 элементов для счётчиков диспетчеризации по опкоду (может быть NULL).
+ * @param funcs Массив для счётчиков функций (может быть NULL).
+ * @param max_funcs Ёмкость массива funcs.
+ * @param out_num_funcs Количество функций в модуле (может быть NULL); в funcs записывается не больше max_funcs.
+ * @return ESPB_OK, или ESPB_ERR_UNSUPPORTED если профилировщик отключён.
+ */
+EspbResult espb_profile_snapshot(espb_handle_t handle, uint64_t *opcode_counts, espb_func_profile_t *funcs, uint32_t max_funcs, uint32_t *out_num_funcs);
+
+/**
+ * @brief Обнуляет счётчики профилировщика модуля.
+ *
+ * @param handle Дескриптор модуля.
+ * @return ESPB_OK, или ESPB_ERR_UNSUPPORTED если профилировщик отключён.
+ */
+EspbResult espb_profile_reset(espb_handle_t handle);
+
+/**
+ * @brief Счётчики вызовов одного импорта.
+ *
+ * total_cycles = marshal_cycles + native_cycles + copyback_cycles.
+ */
+typedef struct {
+    uint32_t import_idx;            // Индекс импорта в модуле
+    const char *name;               // Имя импорта или NULL (импорт по индексу символа)
+    uint32_t calls;
+    uint32_t max_cycles;            // Самый долгий вызов целиком
+    uint64_t total_cycles;
+    uint64_t marshal_cycles;        // Упаковка аргументов, колбэки, маршалинг IN-буферов
+    uint64_t native_cycles;         // Нативная функция (ffi_call)
+    uint64_t copyback_cycles;       // Копирование OUT-буферов и результата обратно
+} espb_import_stats_t;
+
+/**
+ * @brief Снимает копию счётчиков вызовов импортов (CONFIG_ESPB_IMPORT_PROFILE).
+ *
+ * Учитываются вызовы из интерпретатора и из JIT-кода: пока профиль включён,
+ * JIT вызывает импорты через helper, а не напрямую. Счётчики не атомарны.
+ *
+ * @param handle Дескриптор модуля.
+ * @param out Массив для счётчиков импортов (может быть NULL).
+ * @param max_imports Ёмкость массива out.
+ * @param out_num_imports Количество импортов модуля (может быть NULL); в out записывается не больше max_imports.
+ * @return ESPB_OK, или ESPB_ERR_UNSUPPORTED если профиль импортов отключён.
+ */
+EspbResult espb_import_profile_snapshot(espb_handle_t handle, espb_import_stats_t *out, uint32_t max_imports,
+                                        uint32_t *out_num_imports);
+
+/**
+ * @brief Обнуляет счётчики вызовов импортов.
+ *
+ * @return ESPB_OK, или ESPB_ERR_UNSUPPORTED если профиль импортов отключён.
+ */
+EspbResult espb_import_profile_reset(espb_handle_t handle);
+
+/**
+ * @brief Статистика JIT для одной функции модуля.
+ */
+typedef struct {
+    espb_func_t func;               // Дескриптор функции (как у espb_get_function)
+    uint32_t bytecode_size;         // Размер байткода
+    uint32_t native_size;           // Размер опубликованного JIT-кода (0 - не скомпилирована)
+    uint32_t compile_time_us;       // Время последней компиляции
+    uint16_t compiles;              // Число компиляций (больше 1 - после вытеснения)
+    uint16_t helper_calls;          // Места вызова C-helper'ов в коде
+    uint16_t abs_helper_calls;      // Из них через абсолютный адрес
+    uint16_t spills;                // Сбросы закреплённых регистров в v_regs
+    uint32_t fallbacks;             // Вызовы HOT-функции, обслуженные интерпретатором
+    uint32_t exec_count;            // Входы в JIT-код
+    uint8_t jit_reject;             // ESPB_JIT_REJECT_*: почему функция оставлена в интерпретаторе
+} espb_jit_func_stats_t;
+
+/**
+ * @brief Итоговая статистика JIT модуля.
+ */
+typedef struct {
+    uint32_t num_functions;         // Функций в модуле
+    uint32_t num_hot;               // Помечено HOT (включая tier-up)
+    uint32_t num_compiled;          // Имеют опубликованный JIT-код
+    uint32_t compile_failures;      // Неудачные компиляции
+    uint32_t evictions;             // Вытеснения из JIT cache
+    uint32_t jit_code_bytes;        // Суммарный размер опубликованного кода
+    uint64_t compile_time_us;       // Суммарное время компиляций
+    uint64_t exec_count;            // Сумма exec_count по функциям
+    uint64_t fallbacks;             // Сумма fallbacks по функциям
+    uint32_t iram_free;             // Свободно исполняемой памяти (MALLOC_CAP_EXEC)
+    uint32_t iram_largest_block;    // Наибольший свободный блок исполняемой памяти
+} espb_jit_stats_t;
+
+/**
+ * @brief Снимает копию статистики JIT (CONFIG_ESPB_JIT_STATS).
+ *
+ * Входы считаются из интерпретатора, колбэков и OSR; прямые вызовы JIT -> JIT
+ * не учитываются. Счётчики не атомарны.
+ *
+ * @param handle Дескриптор модуля.
+ * @param totals Итоги по модулю (может быть NULL).
+ * @param funcs Массив для статистики функций (может быть NULL).
+ * @param max_funcs Ёмкость массива funcs.
+ * @param out_num_funcs Количество функций в модуле (может быть NULL); в funcs записывается не больше max_funcs.
+ * @return ESPB_OK, или ESPB_ERR_UNSUPPORTED если статистика JIT отключена.
+ */
+EspbResult espb_jit_stats_snapshot(espb_handle_t handle, espb_jit_stats_t *totals, espb_jit_func_stats_t *funcs,
+                                   uint32_t max_funcs, uint32_t *out_num_funcs);
+
+/**
+ * @brief Обнуляет счётчики событий JIT (входы, fallback'и, ошибки, вытеснения).
+ *
+ * Сведения о скомпилированном коде (размеры, helper'ы, время компиляции) сохраняются.
+ *
+ * @param handle Дескриптор модуля.
+ * @return ESPB_OK, или ESPB_ERR_UNSUPPORTED если статистика JIT отключена.
+ */
+EspbResult espb_jit_stats_reset(espb_handle_t handle);
+
+/**
+ * @brief Почему JIT отказался компилировать функцию (бюджеты компиляции, espb_jit_budget.h).
+ *
+ * Отклонённая функция навсегда остаётся в интерпретаторе.
+ *
+ * @param handle Дескриптор модуля.
+ * @param func Дескриптор функции (как у espb_get_function).
+ * @param out_reason ESPB_JIT_REJECT_*; ESPB_JIT_REJECT_NONE - функция не отклонялась.
+ * @return ESPB_OK, или ESPB_ERR_UNSUPPORTED если JIT отключён.
+ */
+EspbResult espb_jit_get_reject_reason(espb_handle_t handle, espb_func_t func, uint8_t *out_reason);
+
+#define ESPB_SAMPLE_OFFSET_UNKNOWN UINT32_MAX // Смещение в байт-коде не восстановлено (код без карты)
+
+/**
+ * @brief Итоги сэмплирующего профилировщика.
+ */
+typedef struct {
+    uint32_t samples;               // Срабатывания таймера
+    uint32_t jit;                   // Отсчёты в JIT-коде (по сохранённому PC задачи)
+    uint32_t interp;                // Отсчёты, снятые интерпретатором в точке опроса
+    uint32_t idle;                  // Целевая задача была заблокирована
+    uint32_t missed;                // Предыдущий запрос интерпретатору ещё не был снят
+    uint32_t dropped;               // Таблица смещений или стеков переполнена
+} espb_sampler_totals_t;
+
+/**
+ * @brief Отсчёты сэмплера одной функции.
+ */
+typedef struct {
+    espb_func_t func;               // Дескриптор функции (как у espb_get_function)
+    uint32_t interp_samples;
+    uint32_t jit_samples;
+} espb_sample_func_t;
+
+/**
+ * @brief Элемент гистограммы по смещениям байт-кода.
+ */
+typedef struct {
+    espb_func_t func;
+    uint32_t bc_offset;             // Начало инструкции в байт-коде или ESPB_SAMPLE_OFFSET_UNKNOWN
+    uint32_t samples;
+    bool jit;                       // Отсчёты в JIT-коде функции
+} espb_sample_offset_t;
+
+// Приёмник текста для espb_sampler_write_folded и espb_jit_code_map_write (строка может приходить частями)
+typedef void (*espb_sampler_write_t)(const char *data, size_t len, void *user_data);
+
+/**
+ * @brief Запускает сэмплирующий профилировщик (CONFIG_ESPB_SAMPLER).
+ *
+ * Отсчёты в JIT-коде берутся по сохранённому PC вытесненной задачи; остальные
+ * снимает интерпретатор на ближайшем переходе или CALL. Пока сэмплер работает,
+ * JIT-код модуля не вытесняется.
+ *
+ * @param handle Дескриптор модуля.
+ * @param task Задача, исполняющая модуль; NULL - вызывающая.
+ * @param period_us Период в мкс; 0 - CONFIG_ESPB_SAMPLER_PERIOD_US.
+ * @return ESPB_OK, ESPB_ERR_INVALID_STATE если уже запущен, ESPB_ERR_UNSUPPORTED если сэмплер отключён.
+ */
+EspbResult espb_sampler_start(espb_handle_t handle, TaskHandle_t task, uint32_t period_us);
+
+/**
+ * @brief Останавливает таймер сэмплера; накопленные данные остаются доступны.
+ */
+EspbResult espb_sampler_stop(espb_handle_t handle);
+
+/**
+ * @brief Копирует итоги и отсчёты по функциям.
+ *
+ * @param totals Итоги (может быть NULL).
+ * @param funcs Массив для отсчётов функций (может быть NULL).
+ * @param max_funcs Ёмкость массива funcs.
+ * @param out_num_funcs Количество функций в модуле (может быть NULL).
+ * @return ESPB_OK, ESPB_ERR_INVALID_STATE если сэмплер не запускался.
+ */
+EspbResult espb_sampler_snapshot(espb_handle_t handle, espb_sampler_totals_t *totals, espb_sample_func_t *funcs,
+                                 uint32_t max_funcs, uint32_t *out_num_funcs);
+
+/**
+ * @brief Копирует гистограмму по смещениям байт-кода (CONFIG_ESPB_SAMPLER_SLOTS элементов максимум).
+ *
+ * @param out_num_entries Число занятых элементов (может быть NULL); в out записывается не больше max_entries.
+ */
+EspbResult espb_sampler_offsets(espb_handle_t handle, espb_sample_offset_t *out, uint32_t max_entries,
+                                uint32_t *out_num_entries);
+
+/**
+ * @brief Выводит стеки в свёрнутом формате flamegraph.pl: "f;g;h count" построчно.
+ *
+ * Функции именуются именем экспорта или func_<индекс>. Стеки интерпретатора полные
+ * (до ESPB_SAMPLER_MAX_DEPTH ближайших кадров); отсчёт в JIT-коде даёт только
+ * функцию вершины с суффиксом "_[j]".
+ */
+EspbResult espb_sampler_write_folded(espb_handle_t handle, espb_sampler_write_t write, void *user_data);
+
+/**
+ * @brief Обнуляет накопленные отсчёты сэмплера.
+ */
+EspbResult espb_sampler_reset(espb_handle_t handle);
+
+/**
+ * @brief Функция ESPB, которой принадлежит адрес JIT-кода.
+ */
+typedef struct {
+    const void *code;               // Начало кода функции
+    uint32_t code_size;
+    const void *module;             // Модуль (EspbModule) - различает экземпляры разных модулей
+    espb_func_t func;               // Глобальный индекс функции
+    const char *name;               // Имя экспорта или NULL
+    uint32_t bc_offset;             // Инструкция байт-кода или ESPB_SAMPLE_OFFSET_UNKNOWN
+} espb_jit_code_info_t;
+
+/**
+ * @brief Находит функцию ESPB по адресу в JIT-коде (CONFIG_ESPB_JIT_CODE_MAP).
+ *
+ * Для разбора backtrace и трасс: ищет по всем загруженным модулям. Вызывать из задачи.
+ *
+ * @param pc Адрес инструкции.
+ * @param out Сведения о функции (может быть NULL).
+ * @return true, если адрес внутри опубликованного JIT-кода; false - нет или карта отключена.
+ */
+bool espb_jit_code_lookup(uintptr_t pc, espb_jit_code_info_t *out);
+
+/**
+ * @brief Выводит карту JIT-кода в формате perf map: "START SIZE espb:name" построчно (hex).
+ *
+ * with_offsets разбивает функции на диапазоны инструкций байт-кода ("espb:name+bc_1a").
+ * Текст подходит для /tmp/perf-<pid>.map, для передачи через UART или esp_apptrace_write().
+ *
+ * @return ESPB_OK, или ESPB_ERR_UNSUPPORTED если карта JIT-кода отключена.
+ */
+EspbResult espb_jit_code_map_write(espb_sampler_write_t write, void *user_data, bool with_offsets);
+
+/**
+ * @brief Потребление памяти одного вида: сейчас и в пике.
+ */
+typedef struct {
+    size_t current;
+    size_t peak;
+} espb_memory_usage_t;
+
+/**
+ * @brief Память экземпляра модуля (espb_get_memory_stats).
+ *
+ * Куча гостя размещается в линейной памяти (или в отдельных блоках, учтённых по виду
+ * памяти), поэтому heap_* - разбивка уже посчитанных байт, а не слагаемое.
+ */
+typedef struct {
+    espb_memory_usage_t internal;   // Внутренняя DRAM: линейная память, глобалы, таблица, кэши импортов, JIT cache
+    espb_memory_usage_t psram;      // Внешняя PSRAM (например, CONFIG_ESPB_LINEAR_MEMORY_PSRAM_THRESHOLD)
+    espb_memory_usage_t exec;       // IRAM / исполняемая память: JIT-код, замыкания колбэков и async wrappers
+    size_t heap_used;               // Куча гостя: занято, с метаданными multi_heap
+    size_t heap_free;
+    size_t heap_peak;               // Наибольшее занятое в куче гостя
+    size_t shadow_stack_peak;       // Наибольшая ёмкость блоков теневого стека в вызовах экземпляра
+    size_t iram_pool_used;          // IRAM-пул замыканий libffi (CONFIG_LIBFFI_USE_IRAM_POOL), общий для всех модулей
+    size_t iram_pool_total;
+} espb_memory_stats_t;
+
+/**
+ * @brief Возвращает текущее и пиковое потребление памяти экземпляром.
+ *
+ * Текущие значения считаются по буферам экземпляра при вызове; пики обновляются при
+ * инстанцировании, росте кучи, компиляции JIT-кода, создании async wrapper и при каждом
+ * вызове этой функции. Общий JIT cache разделяемого модуля входит в каждый экземпляр;
+ * память, импортированная у хоста (env.memory), не учитывается.
+ *
+ * @param handle Дескриптор модуля.
+ * @param stats Результат.
+ * @return ESPB_OK, ESPB_ERR_INVALID_OPERAND если stats == NULL.
+ */
+EspbResult espb_get_memory_stats(espb_handle_t handle, espb_memory_stats_t *stats);
+
+/**
+ * @brief Задаёт порцию топлива экземпляра и сразу заправляет его (CONFIG_ESPB_FUEL).
+ *
+ * Топливо тратится на обратных переходах и вызовах; когда оно кончается, вызывается
+ * обработчик (espb_set_fuel_handler). Можно вызывать из обработчика: новая порция
+ * действует сразу после него.
+ *
+ * @param handle Дескриптор модуля.
+ * @param slice Единиц топлива между вызовами обработчика (> 0).
+ * @return ESPB_OK, ESPB_ERR_INVALID_OPERAND при slice == 0 или вне int32_t,
+ *         ESPB_ERR_UNSUPPORTED если учёт топлива отключён.
+ */
+EspbResult espb_set_fuel(espb_handle_t handle, uint32_t slice);
+
+/**
+ * @brief Задаёт обработчик исчерпания топлива (CONFIG_ESPB_FUEL).
+ *
+ * Обработчик исполняется в задаче, вызвавшей модуль. true - продолжить с новой порцией,
+ * false - прервать вызов с ESPB_ERR_FUEL_EXHAUSTED. Вызов, ушедший в JIT-код, прервать
+ * нельзя: он дорабатывает до возврата в интерпретатор, спрашивая обработчик в каждом
+ * цикле. NULL восстанавливает поведение по умолчанию: taskYIELD и продолжить.
+ *
+ * @return ESPB_OK, или ESPB_ERR_UNSUPPORTED если учёт топлива отключён.
+ */
+EspbResult espb_set_fuel_handler(espb_handle_t handle, EspbFuelHandler handler, void *user_data);
+
 
 #ifdef __cplusplus
 }
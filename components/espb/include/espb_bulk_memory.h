@@ -0,0 +1,60 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef ESPB_BULK_MEMORY_H
+#define ESPB_BULK_MEMORY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Ядра MEMORY.COPY / MEMORY.FILL для интерпретатора и JIT.
+ *
+ * Одинаково сдвинутые буферы копируются словами (по 16 байт за итерацию), на ESP32-S3
+ * блоки от 64 байт - векторными 128-битными загрузками/записями PIE, большие
+ * непересекающиеся копии DMA-доступной памяти - через async memcpy (GDMA).
+ * Короткие и по-разному сдвинутые блоки уходят в memmove/memset.
+ * Сигнатуры совпадают с memmove/memset, поэтому JIT вызывает их как обычные хелперы.
+ */
+
+// Копирование с семантикой memmove (области могут перекрываться).
+void *espb_memory_copy(void *dst, const void *src, size_t n);
+
+// Заполнение младшим байтом val, как memset.
+void *espb_memory_fill(void *dst, int val, size_t n);
+
+/**
+ * @brief Константный размер MEMORY.COPY/MEMORY.FILL для JIT.
+ *
+ * Истина, если перед инструкцией по смещению insn_off (не считая NOP) стоит
+ * LDC.I32 rn, imm и ни один переход не ведёт на участок между ними.
+ * Холодный путь компиляции: просматривает всё тело.
+ */
+bool espb_bulk_const_size(const uint8_t *code, uint32_t code_size, uint32_t insn_off,
+                          uint8_t rn, uint32_t *out_size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPB_BULK_MEMORY_H
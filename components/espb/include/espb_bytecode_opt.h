@@ -0,0 +1,70 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef ESPB_BYTECODE_OPT_H
+#define ESPB_BYTECODE_OPT_H
+
+#include "espb_interpreter_common_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef CONFIG_ESPB_BYTECODE_OPT
+#define CONFIG_ESPB_BYTECODE_OPT 0
+#endif
+
+/*
+ * Оптимизатор байт-кода при загрузке модуля (после espb_parse_code_section).
+ *
+ * Работает до интерпретатора, прошитого кода и JIT, поэтому все они исполняют
+ * уже оптимизированное тело. Проходы: протягивание переходов (BR на BR), копирующее
+ * распространение MOV.I32/MOV.I64, свёртка LDC.I32 + *.I32.IMM8 и удаление мёртвых
+ * записей по глобальному анализу живости регистров.
+ *
+ * Переписывание сохраняет длину: удалённые инструкции заполняются NOP (0x00),
+ * заменённые занимают прежние байты. Смещения инструкций, цели переходов, точки
+ * OSR и снапшоты JIT остаются согласованными с исходной раскладкой.
+ *
+ * Тело копируется в EspbFunctionBody::optimized_code, только если что-то изменилось;
+ * функции с ADDR_OF (регистры доступны по указателю) не оптимизируются.
+ */
+
+#if CONFIG_ESPB_BYTECODE_OPT
+
+/**
+ * @brief Оптимизирует тело функции.
+ *
+ * @return true, если body->code заменён оптимизированной копией.
+ */
+bool espb_bytecode_optimize_function(EspbFunctionBody *body);
+
+// Оптимизирует все тела модуля; ошибки не фатальны - тело остаётся исходным.
+void espb_bytecode_optimize_module(EspbModule *module);
+
+#else
+
+static inline bool espb_bytecode_optimize_function(EspbFunctionBody *body) { (void)body; return false; }
+static inline void espb_bytecode_optimize_module(EspbModule *module) { (void)module; }
+
+#endif // CONFIG_ESPB_BYTECODE_OPT
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPB_BYTECODE_OPT_H
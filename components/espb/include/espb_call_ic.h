@@ -0,0 +1,113 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef ESPB_CALL_IC_H
+#define ESPB_CALL_IC_H
+
+#include "espb_interpreter_common_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef CONFIG_ESPB_CALL_IC_ENTRIES
+#define CONFIG_ESPB_CALL_IC_ENTRIES 0
+#endif
+
+/*
+ * Inline-кэш непрямых вызовов (CALL_INDIRECT / CALL_INDIRECT_PTR и JIT-хелперы).
+ *
+ * Таблица прямого отображения на экземпляр: ключ - (место вызова, значение регистра
+ * цели, type_idx), значение - индекс локальной функции, для которой уже пройдены
+ * разрешение указателя через func_ptr_map и проверка сигнатуры. Местом вызова служит
+ * pc интерпретатора или адрес возврата из JIT-хелпера.
+ *
+ * Одним экземпляром могут пользоваться несколько задач, поэтому запись защищена
+ * seqlock: писатель переводит seq в нечётное значение CAS-ом (если запись уже занята,
+ * обновление пропускается), читатель принимает запись, только если seq чётный и не
+ * изменился за время чтения. Промах всегда безопасен - вызывающий идёт медленным путём.
+ */
+
+struct EspbCallIcEntry {
+    uint32_t seq;           // Чётный - запись стабильна
+    uint16_t type_idx;
+    uint32_t func_idx;      // Локальный индекс функции (без учёта импортов)
+    uintptr_t site;
+    uintptr_t target;       // Значение регистра цели как есть (индекс или указатель)
+};
+
+#if CONFIG_ESPB_CALL_IC_ENTRIES > 0
+
+static inline uint32_t espb_call_ic_hash(uintptr_t site, uintptr_t target) {
+    uint32_t h = (uint32_t)(site >> 1) ^ (uint32_t)(site >> 9);
+    return h ^ ((uint32_t)target * 0x9E3779B1u >> 16);
+}
+
+/**
+ * @brief Ищет проверенную цель непрямого вызова.
+ * @return true и *out_func_idx при попадании.
+ */
+static inline bool espb_call_ic_lookup(const EspbInstance *instance, uintptr_t site, uintptr_t target,
+                                       uint16_t type_idx, uint32_t *out_func_idx) {
+    EspbCallIcEntry *ic = instance->call_ic;
+    if (!ic) return false;
+    EspbCallIcEntry *e = &ic[espb_call_ic_hash(site, target) & instance->call_ic_mask];
+
+    uint32_t seq = __atomic_load_n(&e->seq, __ATOMIC_ACQUIRE);
+    if (seq & 1u) return false;
+    if (__atomic_load_n(&e->site, __ATOMIC_RELAXED) != site ||
+        __atomic_load_n(&e->target, __ATOMIC_RELAXED) != target ||
+        __atomic_load_n(&e->type_idx, __ATOMIC_RELAXED) != type_idx) {
+        return false;
+    }
+    uint32_t func_idx = __atomic_load_n(&e->func_idx, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&e->seq, __ATOMIC_RELAXED) != seq) return false;
+
+    *out_func_idx = func_idx;
+    return true;
+}
+
+// Запоминает цель, прошедшую медленный путь. Вызывать только после успешной проверки сигнатуры.
+void espb_call_ic_update(EspbInstance *instance, uintptr_t site, uintptr_t target,
+                         uint16_t type_idx, uint32_t func_idx);
+
+// Выделяет таблицу при инстанцировании (CONFIG_ESPB_CALL_IC_ENTRIES записей, округляется до 2^n).
+EspbResult espb_call_ic_init(EspbInstance *instance);
+void espb_call_ic_free(EspbInstance *instance);
+
+#else
+
+static inline bool espb_call_ic_lookup(const EspbInstance *instance, uintptr_t site, uintptr_t target,
+                                       uint16_t type_idx, uint32_t *out_func_idx) {
+    (void)instance; (void)site; (void)target; (void)type_idx; (void)out_func_idx;
+    return false;
+}
+static inline void espb_call_ic_update(EspbInstance *instance, uintptr_t site, uintptr_t target,
+                                       uint16_t type_idx, uint32_t func_idx) {
+    (void)instance; (void)site; (void)target; (void)type_idx; (void)func_idx;
+}
+static inline EspbResult espb_call_ic_init(EspbInstance *instance) { instance->call_ic = NULL; return ESPB_OK; }
+static inline void espb_call_ic_free(EspbInstance *instance) { (void)instance; }
+
+#endif // CONFIG_ESPB_CALL_IC_ENTRIES > 0
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPB_CALL_IC_H
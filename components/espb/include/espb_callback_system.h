@@ -33,30 +33,62 @@ extern "C" {
 // Максимальное количество параметров в callback функции
 #define ESPB_CALLBACK_MAX_PARAMS 16
 
+// Подготовленный CIF колбэка: один на сигнатуру ESPB-функции в кэше экземпляра.
+// Живёт до освобождения экземпляра - на него ссылаются подготовленные замыкания.
+typedef struct EspbCallbackCif {
+    const EspbFuncSignature *espb_signature; // Ключ кэша
+    ffi_cif cif;
+    ffi_type *arg_types[ESPB_CALLBACK_MAX_PARAMS];
+    // План конвертации для специализированных thunk'ов: известен при подготовке CIF
+    uint8_t num_args;                 // Аргументов, копируемых в ESPB-функцию
+    uint8_t arg_types_espb[ESPB_CALLBACK_MAX_PARAMS]; // EspbValueType каждого аргумента
+    uint8_t ret_type_espb;            // EspbValueType результата (ESPB_TYPE_VOID - нет)
+    bool words_only;                  // Все аргументы - 32-битные слова: копирование без switch
+    struct EspbCallbackCif *next;
+} EspbCallbackCif;
+
 // Структура для хранения информации о callback функции
 typedef struct EspbCallbackInfo {
     uint32_t espb_func_idx;           // Индекс ESPB функции для callback
     EspbFuncSignature *espb_signature; // Сигнатура ESPB функции
-    ffi_cif native_cif;               // FFI CIF для нативной функции
-    ffi_type *native_arg_types[ESPB_CALLBACK_MAX_PARAMS]; // Типы аргументов для FFI
+    EspbCallbackCif *native_cif;      // FFI CIF из кэша экземпляра
     int32_t user_data_param_index;    // Индекс параметра user_data (-1 если нет)
     void *original_user_data;         // Оригинальные пользовательские данные
-    struct EspbCallbackInfo *next;    // Для связанного списка
+    int32_t user_data_arg;            // Аргумент, заменяемый original_user_data в thunk'е (-1 если нет)
+    EspbFunctionBody *body;           // Тело ESPB функции: thunk вызывает её JIT-код напрямую
 } EspbCallbackInfo;
 
 // Структура для контекста callback замыкания
 typedef struct EspbCallbackClosure {
     ffi_closure *closure_ptr;         // Указатель на FFI замыкание
     void *executable_code;            // Исполняемый код замыкания
-    EspbCallbackInfo *callback_info;  // Информация о callback
+    EspbCallbackInfo *callback_info;  // Информация о callback (указывает на info)
     EspbInstance *instance;           // Экземпляр ESPB модуля
-    struct EspbCallbackClosure *next; // Для связанного списка
+    EspbCallbackInfo info;
 } EspbCallbackClosure;
 
-// Глобальная структура для управления callback системой
+#define ESPB_CALLBACK_SLOT_FREE   0u
+#define ESPB_CALLBACK_SLOT_ACTIVE 1u
+#define ESPB_CALLBACK_SLOT_NONE   0xFFFFu  // Пустой стек свободных слотов
+
+// Слот реестра замыканий. Замыкание libffi остаётся в слоте после освобождения и
+// переиспользуется следующим колбэком без ffi_closure_alloc.
+typedef struct EspbCallbackSlot {
+    uint32_t state;                   // ESPB_CALLBACK_SLOT_*, меняется атомарно
+    uint32_t next_free;               // Следующий слот в стеке свободных
+    EspbCallbackClosure *closure;     // NULL, пока слот ни разу не использовался
+} EspbCallbackSlot;
+
+// Глобальная структура для управления callback системой. Создание и освобождение
+// колбэка не берут мьютекс: слот снимается со стека свободных CAS'ом, замыкание
+// находится по исполняемому адресу через хеш-индекс.
 typedef struct EspbCallbackSystem {
-    SemaphoreHandle_t mutex;          // Мьютекс для потокобезопасности
-    EspbCallbackClosure *active_closures; // Список активных замыканий
+    SemaphoreHandle_t mutex;          // Только холодный путь: заполнение кэша CIF экземпляра
+    EspbCallbackSlot *slots;          // CONFIG_ESPB_CALLBACK_MAX_CLOSURES слотов
+    uint32_t capacity;
+    uint32_t free_head;               // Вершина стека свободных: индекс | (тег ABA << 16)
+    uint32_t *exec_index;             // Открытая адресация: executable_code -> индекс слота + 1
+    uint32_t exec_index_mask;
     bool initialized;                 // Флаг инициализации системы
 } EspbCallbackSystem;
 
@@ -119,6 +151,20 @@ EspbResult espb_create_callback_closure(
  */
 EspbResult espb_free_callback_closure(void *closure_ptr);
 
+/**
+ * Освобождение колбэков экземпляра (вызывается из espb_free_instance): активные
+ * замыкания возвращаются в реестр, кэш CIF освобождается. Вызывать замыкания
+ * экземпляра после этого нельзя.
+ * @param instance Экземпляр ESPB модуля
+ */
+void espb_callback_release_instance(EspbInstance *instance);
+
+/**
+ * Количество активных callback-замыканий экземпляра (для учёта памяти, espb_memory_stats.h).
+ * @param instance Экземпляр ESPB модуля
+ */
+uint32_t espb_callback_instance_closures(const EspbInstance *instance);
+
 /**
  * Универсальный обработчик callback замыканий
  * КРИТИЧНАЯ ФУНКЦИЯ: размещается в IRAM для максимальной производительности
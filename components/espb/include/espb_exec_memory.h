@@ -17,6 +17,7 @@
  */
 #pragma once
 
+#include <stdbool.h>
 #include <stddef.h>
 
 #ifdef __cplusplus
@@ -40,6 +41,19 @@ void *espb_exec_realloc(void *ptr, size_t size);
  */
 void espb_exec_free(void *ptr);
 
+/**
+ * Reserve the JIT code region (CONFIG_ESPB_JIT_CODE_REGION_SIZE) if it is not reserved yet.
+ * espb_exec_alloc serves requests from the region first and falls back to the heap when it
+ * is full or could not be reserved. Calling this early, before the executable heap is
+ * fragmented, gives the region the best chance. Safe to call repeatedly and concurrently.
+ */
+void espb_exec_region_init(void);
+
+/**
+ * Region usage in bytes. Returns false when there is no region.
+ */
+bool espb_exec_region_stats(size_t *out_total, size_t *out_free, size_t *out_largest_free);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,82 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef ESPB_FUEL_H
+#define ESPB_FUEL_H
+
+#include "espb_interpreter_common_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef CONFIG_ESPB_FUEL_SLICE
+#define CONFIG_ESPB_FUEL_SLICE 10000
+#endif
+
+/*
+ * Топливо: счётчик экземпляра, который уменьшается на обратных переходах и вызовах.
+ *
+ * Интерпретатор тратит единицу на каждом обратном BR/BR_IF/BR_TABLE и CALL*, JIT-код -
+ * в заголовках циклов и в прологе не-leaf функций (leaf без циклов завершается сам).
+ * Когда счётчик доходит до нуля, вызывается обработчик экземпляра; без обработчика
+ * задача уступает процессор (taskYIELD) и продолжает с новой порцией.
+ * В green-потоке (espb_green.h) исчерпание на обратном переходе интерпретатора вместо
+ * обработчика вытесняет поток: планировщик пополняет топливо перед каждым его запуском.
+ *
+ * Счётчик общий для всех вызовов экземпляра и меняется без атомиков: при параллельных
+ * вызовах часть списаний теряется, что для ограничения латентности допустимо.
+ *
+ * JIT-код прервать нельзя: если обработчик отказал внутри него, счётчик остаётся
+ * исчерпанным, а ESPB_ERR_FUEL_EXHAUSTED вернёт первая же точка учёта в интерпретаторе
+ * (JIT-функция при этом дорабатывает до возврата, спрашивая обработчик в каждом цикле).
+ */
+
+#if CONFIG_ESPB_FUEL
+
+/**
+ * @brief Топливо кончилось: спрашивает обработчик и пополняет счётчик.
+ * Вызывается интерпретатором и JIT-кодом (a0 = instance).
+ * @return false - вызов надо прервать с ESPB_ERR_FUEL_EXHAUSTED.
+ */
+bool espb_fuel_refill(EspbInstance *instance);
+
+// Списывает единицу топлива; false - прервать вызов
+static inline bool espb_fuel_tick(EspbInstance *instance) {
+    if (__builtin_expect(--instance->fuel > 0, 1)) return true;
+    return espb_fuel_refill(instance);
+}
+
+static inline void espb_fuel_init(EspbInstance *instance) {
+    instance->fuel_slice = CONFIG_ESPB_FUEL_SLICE;
+    instance->fuel = CONFIG_ESPB_FUEL_SLICE;
+    instance->fuel_handler = NULL;
+    instance->fuel_user_data = NULL;
+}
+
+#else
+
+static inline bool espb_fuel_tick(EspbInstance *instance) { (void)instance; return true; }
+static inline void espb_fuel_init(EspbInstance *instance) { (void)instance; }
+
+#endif // CONFIG_ESPB_FUEL
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPB_FUEL_H
@@ -0,0 +1,134 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef ESPB_GREEN_H
+#define ESPB_GREEN_H
+
+#include "espb_interpreter_common_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef CONFIG_ESPB_GREEN_THREADS
+#define CONFIG_ESPB_GREEN_THREADS 0
+#endif
+
+#ifndef CONFIG_ESPB_GREEN_PRIORITIES
+#define CONFIG_ESPB_GREEN_PRIORITIES 4
+#endif
+
+/*
+ * Green-потоки ESPB: много модулей на одной задаче FreeRTOS и одном стеке C.
+ *
+ * Каждый поток владеет своим ExecutionContext. Когда интерпретируемый код вызывает
+ * блокирующий импорт vTaskDelay, интерпретатор не блокирует задачу, а возвращает
+ * ESPB_SUSPENDED: стек вызовов, регистры и теневой стек остаются в контексте, точка
+ * возобновления (функция, pc) запоминается в нём же. Ожидание превращается в событие
+ * таймера планировщика; когда оно наступает, тот же контекст продолжает исполнение
+ * с инструкции после CALL_IMPORT. Задача засыпает, только когда ждут все потоки.
+ *
+ * Остановка возможна только в интерпретируемом коде внешнего входа: внутри JIT-кода и
+ * во вложенных входах в интерпретатор (колбэки, JIT-хелперы) блокирующие импорты, как и
+ * прочие блокирующие вызовы (xTimerGenericCommand), по-прежнему блокируют задачу.
+ *
+ * Кванты и приоритеты. С CONFIG_ESPB_FUEL поток вытесняется и на обратном переходе, когда
+ * кончается его квант топлива (espb_fuel.h); перед каждым запуском планировщик заправляет
+ * экземпляр квантом модуля. Готовые потоки стоят в очередях по приоритету модуля
+ * (espb_green_set_module): исполняется самый приоритетный уровень, внутри уровня - по
+ * кругу. Нижние уровни ждут, пока на верхнем есть готовые потоки.
+ *
+ * Исполнители. Планировщик крутится либо на задаче, вызывающей espb_green_run_once /
+ * espb_green_run, либо на пуле задач espb_green_start_workers - тогда потоки разных
+ * модулей исполняются параллельно, а espb_green_spawn можно вызывать из любой задачи.
+ * Два потока одного экземпляра на разных исполнителях требуют CONFIG_ESPB_CONCURRENT_CALLS
+ * и делят его счётчик топлива.
+ */
+
+#if CONFIG_ESPB_GREEN_THREADS
+
+#ifndef ESPB_GREEN_MAX_ARGS
+#define ESPB_GREEN_MAX_ARGS 16
+#endif
+
+typedef struct EspbGreenScheduler EspbGreenScheduler;
+typedef struct EspbGreenThread EspbGreenThread;
+
+// Вызывается, когда поток завершился (result - ESPB_OK или код ошибки).
+// Поток освобождается сразу после возврата.
+typedef void (*EspbGreenDoneFn)(EspbGreenThread *thread, EspbResult result, const Value *ret, void *user_data);
+
+EspbResult espb_green_scheduler_create(EspbGreenScheduler **out_sched);
+
+/**
+ * @brief Останавливает исполнителей и освобождает планировщик и все незавершённые
+ * потоки (done для них не вызывается).
+ */
+void espb_green_scheduler_free(EspbGreenScheduler *sched);
+
+/**
+ * @brief Задаёт приоритет и квант потоков экземпляра; действует на потоки, созданные после.
+ *
+ * @param priority 0..CONFIG_ESPB_GREEN_PRIORITIES-1, больше - важнее (как в FreeRTOS).
+ *        Модули без настройки получают 0.
+ * @param slice Квант топлива на один запуск потока; 0 - порция экземпляра (espb_set_fuel).
+ *        Без CONFIG_ESPB_FUEL квант не действует.
+ */
+EspbResult espb_green_set_module(EspbGreenScheduler *sched, const EspbInstance *instance,
+                                 uint8_t priority, uint32_t slice);
+
+/**
+ * @brief Ставит в очередь вызов функции func_idx экземпляра. Аргументы копируются.
+ * Экземпляр должен жить до завершения потока.
+ */
+EspbResult espb_green_spawn(EspbGreenScheduler *sched, EspbInstance *instance, uint32_t func_idx,
+                            const Value *args, EspbGreenDoneFn done, void *user_data,
+                            EspbGreenThread **out_thread);
+
+/**
+ * @brief Исполняет готовые потоки до их остановки или завершения, не блокируя задачу.
+ * @param out_wait_ticks Через сколько тиков проснётся следующий поток
+ *        (portMAX_DELAY - потоков нет, 0 - есть готовые). Может быть NULL.
+ * @return Число оставшихся потоков.
+ */
+uint32_t espb_green_run_once(EspbGreenScheduler *sched, uint32_t *out_wait_ticks);
+
+/**
+ * @brief Крутит планировщик на текущей задаче, пока не завершатся все потоки.
+ */
+void espb_green_run(EspbGreenScheduler *sched);
+
+/**
+ * @brief Запускает num_workers задач-исполнителей, которые разбирают готовые потоки
+ * до espb_green_stop_workers. espb_green_run_once/run при этом не вызываются.
+ */
+EspbResult espb_green_start_workers(EspbGreenScheduler *sched, uint32_t num_workers,
+                                    uint32_t stack_size, UBaseType_t priority);
+
+/**
+ * @brief Дожидается, пока исполнители доработают текущие запуски, и завершает их.
+ * Незавершённые потоки остаются в планировщике.
+ */
+void espb_green_stop_workers(EspbGreenScheduler *sched);
+
+#endif // CONFIG_ESPB_GREEN_THREADS
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPB_GREEN_H
@@ -30,6 +30,41 @@ void espb_heap_free(EspbInstance *instance, void* ptr);
 void* espb_heap_realloc(EspbInstance *instance, void* ptr, size_t new_size);
 void espb_heap_deinit(EspbInstance *instance);
 
+/**
+ * @brief Флаги heap_caps для блока памяти гостя размером bytes: небольшие блоки
+ * остаются во внутренней RAM, крупные (от CONFIG_ESPB_LINEAR_MEMORY_PSRAM_THRESHOLD) - в PSRAM.
+ */
+uint32_t espb_memory_caps(size_t bytes);
+
+/**
+ * @brief Лежит ли [addr, addr+size) целиком в отдельном блоке кучи гостя (вне линейной памяти).
+ */
+bool espb_heap_chunk_contains(const EspbInstance *instance, uintptr_t addr, uint32_t size);
+
+/**
+ * @brief Проверка границ для операций над памятью гостя: линейная память или блок кучи.
+ */
+static inline bool espb_guest_range_valid(const EspbInstance *instance, uintptr_t addr, uint32_t size) {
+    uintptr_t off = addr - (uintptr_t)instance->memory_data;
+    if ((uint64_t)off + size <= instance->memory_size_bytes) return true;
+    return espb_heap_chunk_contains(instance, addr, size);
+}
+
+/**
+ * @brief MEMORY.SIZE: текущий размер линейной памяти в страницах ESPB_MEMORY_PAGE_SIZE.
+ */
+uint32_t espb_memory_size(const EspbInstance *instance);
+
+/**
+ * @brief MEMORY.GROW: увеличивает линейную память на delta_pages страниц.
+ *
+ * Гость хранит в памяти нативные указатели, поэтому блок не перемещается: рост идёт
+ * на месте, в пределах memory_capacity_bytes (запас CONFIG_ESPB_LINEAR_MEMORY_GROW_RESERVE)
+ * и memory_max_size_bytes. Новые страницы нулевые и в кучу гостя не добавляются.
+ * @return Прежний размер в страницах или -1, если расти некуда.
+ */
+int32_t espb_memory_grow(EspbInstance *instance, uint32_t delta_pages);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,85 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef ESPB_IMPORT_PROFILE_H
+#define ESPB_IMPORT_PROFILE_H
+
+#include "espb_interpreter_common_types.h"
+#include "sdkconfig.h"
+
+#if CONFIG_ESPB_IMPORT_PROFILE
+#include "esp_cpu.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Счётчики одного импорта. Время вызова делится на три части:
+// подготовка (упаковка аргументов, колбэки, маршалинг IN), нативная функция (ffi_call)
+// и возврат (копирование OUT-буферов, преобразование результата).
+typedef struct {
+    uint32_t calls;
+    uint32_t max_cycles;        // Самый долгий вызов целиком
+    uint64_t total_cycles;
+    uint64_t marshal_cycles;
+    uint64_t native_cycles;
+    uint64_t copyback_cycles;
+} EspbImportStat;
+
+// Профиль импортов инстанса. Счётчики не атомарны (как у EspbProfile).
+struct EspbImportProfile {
+    uint32_t num_imports;
+    EspbImportStat *imports;    // [num_imports], индекс - индекс импорта
+};
+
+// Выделяет instance->import_profile (только с CONFIG_ESPB_IMPORT_PROFILE; иначе ничего не делает).
+EspbResult espb_import_profile_init(EspbInstance *instance);
+void espb_import_profile_free(EspbInstance *instance);
+void espb_import_profile_clear(EspbImportProfile *profile);
+
+#if CONFIG_ESPB_IMPORT_PROFILE
+
+#define ESPB_IMPORT_PROFILE_NOW() ((uint32_t)esp_cpu_get_cycle_count())
+
+// Отметки: t_begin - начало CALL_IMPORT, t_call/t_ret - вокруг ffi_call, t_end - конец.
+static inline void espb_import_profile_record(EspbInstance *instance, uint16_t import_idx, uint32_t t_begin,
+                                              uint32_t t_call, uint32_t t_ret, uint32_t t_end) {
+    EspbImportProfile *prof = instance->import_profile;
+    if (!prof || import_idx >= prof->num_imports) return;
+    EspbImportStat *st = &prof->imports[import_idx];
+    uint32_t total = t_end - t_begin;
+    st->calls++;
+    st->total_cycles += total;
+    if (total > st->max_cycles) st->max_cycles = total;
+    st->marshal_cycles += t_call - t_begin;
+    st->native_cycles += t_ret - t_call;
+    st->copyback_cycles += t_end - t_ret;
+}
+
+#else
+
+#define ESPB_IMPORT_PROFILE_NOW() 0u
+#define espb_import_profile_record(instance, import_idx, t_begin, t_call, t_ret, t_end) do { } while (0)
+
+#endif // CONFIG_ESPB_IMPORT_PROFILE
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPB_IMPORT_PROFILE_H
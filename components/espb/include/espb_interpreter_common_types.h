@@ -23,6 +23,8 @@
 #include <stdbool.h>
 #include <stdio.h> // Для FILE* в некоторых структурах (если используется, проверить)
 
+#include "sdkconfig.h" // CONFIG_ESPB_* для макросов ниже
+
 // Зависимости для потокобезопасности
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
@@ -30,12 +32,31 @@
 // Включаем ffi.h здесь, чтобы типы libffi были полностью определены
 #include "ffi.h"
 
+#include "espb_module_arena.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 // Forward declarations для избежания циклических зависимостей
 typedef struct EspbJitCache EspbJitCache;
+typedef struct EspbJitOsrInfo EspbJitOsrInfo;
+typedef struct EspbJitPcMap EspbJitPcMap;
+typedef struct EspbJitRelocs EspbJitRelocs;
+typedef struct EspbProfile EspbProfile;
+typedef struct EspbImportProfile EspbImportProfile;
+typedef struct EspbJitStats EspbJitStats;
+typedef struct EspbSampler EspbSampler;
+typedef struct EspbJitBackground EspbJitBackground;
+typedef struct EspbJitSnapshot EspbJitSnapshot;
+typedef struct EspbCallIcEntry EspbCallIcEntry;
+typedef struct EspbMarshalPlan EspbMarshalPlan;
+typedef struct EspbVarCif EspbVarCif;
+
+// Обработчик исчерпания топлива (espb_fuel.h): true - продолжить с новой порцией,
+// false - прервать вызов с ESPB_ERR_FUEL_EXHAUSTED
+struct EspbInstance;
+typedef bool (*EspbFuelHandler)(struct EspbInstance *instance, void *user_data);
 
 // Определяем макрос MIN, если он еще не определен
 // Флаги функций (JIT-заголовок, поле flags)
@@ -114,7 +135,13 @@ typedef enum {
     ESPB_ERR_UNSUPPORTED_SIGNATURE = -56,
     ESPB_ERR_JIT_UNSUPPORTED_OPCODE = -57, // Новый код ошибки для JIT
     ESPB_ERR_UNSUPPORTED = -58,
-    ESPB_OK = 0
+    ESPB_ERR_QUEUE_FULL = -59,     // Очередь асинхронных вызовов заполнена (espb_call_function_async)
+    ESPB_ERR_FUEL_EXHAUSTED = -60, // Обработчик топлива прервал вызов (CONFIG_ESPB_FUEL)
+    ESPB_ERR_JIT_BUSY = -61,       // Функцию компилирует другая задача, код ещё не опубликован
+    ESPB_ERR_JIT_CODE_TOO_LARGE = -62, // Функция превысила бюджет размера JIT (espb_jit_budget.h)
+    ESPB_ERR_JIT_TIMEOUT = -63,    // Компиляция превысила CONFIG_ESPB_JIT_MAX_COMPILE_TIME_MS
+    ESPB_OK = 0,
+    ESPB_SUSPENDED = 1 // Green-поток остановлен на блокирующем импорте (espb_green.h), не ошибка
 } EspbResult;
 
 // Коды Типов (u8) из спецификации
@@ -132,7 +159,7 @@ typedef enum EspbValueType {
     ESPB_TYPE_F64     = 0x0A,
     ESPB_TYPE_PTR     = 0x0B,
     ESPB_TYPE_BOOL    = 0x0C, // Может отображаться в i32
-    ESPB_TYPE_V128    = 0x0D, // Пока не используется
+    ESPB_TYPE_V128    = 0x0D, // Только в регистрах (пара Rn, Rn+1), не в сигнатурах
     ESPB_TYPE_INTERNAL_FUNC_IDX = 0x0E, // Индекс ESPB-функции внутри модуля
     ESPB_TYPE_VOID    = 0x0F  // Используется для обозначения отсутствия возвращаемого значения в сигнатурах
 } EspbValueType;
@@ -144,9 +171,32 @@ extern const uint8_t value_size_map[];
 // Forward declarations and basic types needed early
 #include "multi_heap.h"
 
+// Малые объекты кучи гостя (CONFIG_ESPB_HEAP_SLABS): классы 8, 16, ... 256 байт,
+// нарезанные из страниц ESPB_HEAP_SLAB_SIZE, которые берутся у multi_heap.
+#define ESPB_HEAP_SLAB_SIZE    1024u
+#define ESPB_HEAP_SLAB_MAX     256u
+#define ESPB_HEAP_SLAB_CLASSES 6
+
+// Куча гостя растёт регионами: хвост линейной памяти (MEMORY.GROW на месте) или, если
+// расти некуда, отдельный блок. Регион 0 - остаток памяти за статическими данными.
+#define ESPB_HEAP_MAX_REGIONS 8
+
+typedef struct {
+    multi_heap_handle_t handle;
+    uint8_t *base;
+    uint32_t size;
+    bool owned;              // Отдельный блок вне линейной памяти, освобождается кучей
+} EspbHeapRegion;
+
 typedef struct EspbHeapContext {
-    multi_heap_handle_t heap_handle;
+    EspbHeapRegion regions[ESPB_HEAP_MAX_REGIONS];
+    uint8_t num_regions;
     bool initialized;
+#if CONFIG_ESPB_HEAP_SLABS
+    void *slab_free[ESPB_HEAP_SLAB_CLASSES]; // Списки свободных блоков по классам
+    uint8_t *slab_map;       // На каждую страницу линейной памяти: класс + 1, 0 - не slab
+    uint32_t slab_map_pages;
+#endif
 } EspbHeapContext;
 
 // Флаги возможностей модуля из заголовка ESPB файла
@@ -208,13 +258,38 @@ typedef struct {
 #define ESPB_FUNC_FLAG_HAS_MEMORY   0x10  // Использует LOAD/STORE
 #define ESPB_FUNC_FLAG_SIMPLE_CF    0x20  // Простой control flow (нет циклов)
 #define ESPB_FUNC_FLAG_HOT          0x40  // Горячая функция (приоритет JIT)
-// 0x80 - резерв
+#define ESPB_FUNC_FLAG_ZERO_INIT    0x80  // header.reserved = число регистров R0..Rn-1, которые могут
+                                          // читаться до записи (только их нужно обнулять при входе)
+
+// Состояние подготовки тела функции (CONFIG_ESPB_LAZY_FUNCTIONS)
+#define ESPB_BODY_PENDING   0     // Только смещение и заголовок из секции Code
+#define ESPB_BODY_PREPARING 1     // Готовится другой задачей
+#define ESPB_BODY_READY     2     // Проверено, оптимизировано, транслировано
+#define ESPB_BODY_INVALID   3     // Проверка не прошла: вызовы возвращают ошибку
+
+// Состояния JIT-компиляции тела функции (EspbFunctionBody::jit_state)
+#define ESPB_JIT_STATE_NONE      0  // Кода нет, компиляцию может захватить любая задача
+#define ESPB_JIT_STATE_COMPILING 1  // Компилирует другая задача
+#define ESPB_JIT_STATE_READY     2  // jit_code опубликован
+#define ESPB_JIT_STATE_FAILED    3  // Компиляция не удалась: функция остаётся в интерпретаторе
+
+// Почему функция оставлена в интерпретаторе (EspbFunctionBody::jit_reject, espb_jit_budget.h)
+#define ESPB_JIT_REJECT_NONE          0
+#define ESPB_JIT_REJECT_BYTECODE_SIZE 1  // Байт-код больше CONFIG_ESPB_JIT_MAX_BYTECODE_SIZE
+#define ESPB_JIT_REJECT_NATIVE_SIZE   2  // Нативный код не влез в CONFIG_ESPB_JIT_MAX_NATIVE_SIZE
+#define ESPB_JIT_REJECT_COMPILE_TIME  3  // Компиляция дольше CONFIG_ESPB_JIT_MAX_COMPILE_TIME_MS
+#define ESPB_JIT_REJECT_IRAM_QUOTA    4  // Код не влез в остаток CONFIG_ESPB_JIT_IRAM_QUOTA экземпляра
+#define ESPB_JIT_REJECT_UNSUPPORTED   5  // Бэкенд не смог скомпилировать функцию
 
 // Структура для хранения информации о теле функции из секции Code
 typedef struct {
     EspbFuncHeader header;      // ✅ JIT-ready заголовок с метаданными
     uint32_t code_size;
     const uint8_t *code;
+    uint8_t *optimized_code;    // Копия тела после оптимизатора байт-кода (code указывает на неё), NULL - нет
+    uint16_t zero_init_regs;    // Сколько регистров (с R0) обнулять при входе; вычисляет парсер
+    bool regs32;                // Регистры хранят только 32-битные значения (espb_function_regs32); шаг кадра всё равно 8 байт
+    uint8_t prepare_state;      // ESPB_BODY_*: ленивая подготовка при первом вызове
 
     // --- НОВЫЕ ПОЛЯ ДЛЯ DIRECT-THREADED CODE ---
     uint8_t* threaded_code_buffer;     // Указатель на "сырой" буфер с прошитым кодом
@@ -226,9 +301,25 @@ typedef struct {
     void *jit_code;             // Указатель на скомпилированный нативный код
     size_t jit_code_size;       // Размер JIT кода в байтах
     bool is_jit_compiled;       // Флаг JIT компиляции
+    uint8_t jit_state;          // ESPB_JIT_STATE_*: одна компиляция на функцию при параллельных вызовах
+    uint8_t jit_reject;         // ESPB_JIT_REJECT_*: причина ESPB_JIT_STATE_FAILED
+    bool tier_up_blocked;       // Автоматический tier-up не удался / не влез в бюджет - больше не пробуем
+    uint32_t tier_up_counter;   // Вызовы + обратные переходы в интерпретаторе (CONFIG_ESPB_JIT_TIERED)
+    bool tier_up_hot;           // Скомпилирована tier-up'ом: дальше обслуживается как HOT (CONFIG_ESPB_JIT_TIERED)
+    bool jit_bg_queued;         // Запрос на компиляцию уже отправлен фоновой задаче (CONFIG_ESPB_JIT_BACKGROUND)
+    EspbJitOsrInfo *jit_osr;    // Точки входа в jit_code из цикла интерпретатора (CONFIG_ESPB_JIT_OSR), NULL - нет
+    EspbJitPcMap *jit_pc_map;   // Нативное смещение -> байт-код (ESPB_JIT_PC_MAPS), NULL - нет
+    EspbJitRelocs *jit_relocs;  // Релокации jit_code для переноса в новый модуль (CONFIG_ESPB_JIT_RELOAD), NULL - нет
     // --------------------------
 } EspbFunctionBody;
 
+// Число регистров, обнуляемых при входе в функцию (CONFIG_ESPB_PARTIAL_FRAME_ZEROING)
+#if CONFIG_ESPB_PARTIAL_FRAME_ZEROING
+#define ESPB_FRAME_ZERO_INIT_REGS(body) ((body)->zero_init_regs)
+#else
+#define ESPB_FRAME_ZERO_INIT_REGS(body) ((body)->header.num_virtual_regs)
+#endif
+
 // Лимиты для памяти или таблиц
 typedef struct {
     uint8_t flags;
@@ -241,6 +332,11 @@ typedef struct {
     EspbMemoryLimits limits;
 } EspbMemoryDesc;
 
+// Лимиты в секциях Memory/Imports заданы в страницах Wasm (64 KB). Рантайм выделяет
+// память и растит её (MEMORY.GROW, MEMORY.SIZE) страницами по 4 KB.
+#define ESPB_WASM_PAGE_SIZE   65536u
+#define ESPB_MEMORY_PAGE_SIZE 4096u
+
 // Тип инициализатора для глобальной переменной
 typedef enum {
     ESPB_INIT_KIND_ZERO = 0,
@@ -262,9 +358,13 @@ typedef struct {
     EspbGlobalInitializer initializer;
 } EspbGlobalDesc;
 
+// Бит segment_type: транслятор пометил сегмент как .rodata (гость в него не пишет)
+#define ESPB_DATA_SEGMENT_READONLY 0x80
+
 // Описание сегмента данных из секции Data
 typedef struct {
     uint8_t segment_type;
+    bool read_only;          // ESPB_DATA_SEGMENT_READONLY (сам бит из segment_type снят)
     uint32_t memory_index;
     const uint8_t *offset_expr;
     size_t offset_expr_len;
@@ -403,6 +503,7 @@ typedef struct {
 #define ESPB_IMMETA_DIRECTION_INOUT  0x03
 #define ESPB_IMMETA_SIZE_KIND_CONST     0x00
 #define ESPB_IMMETA_SIZE_KIND_FROM_ARG  0x01
+#define ESPB_IMMETA_SIZE_KIND_NULL_TERMINATED 0x02 // strlen(аргумент size_value) + 1
 
 typedef struct {
     uint8_t arg_index;       // Индекс аргумента
@@ -466,9 +567,34 @@ typedef struct {
     EspbFuncPtrMapEntry *func_ptr_map;
     uint32_t *func_ptr_map_by_index; // O(1) lookup: function_index -> data_offset (UINT32_MAX if not present)
     uint32_t func_ptr_map_by_index_size;
+    uint32_t *func_ptr_hash_slots;  // Обратный индекс data_offset -> индекс в func_ptr_map[] или UINT32_MAX (пусто)
+    uint32_t func_ptr_hash_mask;    // Размер таблицы - 1 (размер всегда степень двойки)
     
     // --- Cached values for performance ---
     uint32_t num_imported_funcs;  // Кэшированное количество импортированных функций
+
+    // --- Export name index (open addressing, строится парсером) ---
+    uint32_t *export_name_hashes;  // FNV-1a хэш имени для каждого экспорта (параллельно exports[])
+    uint32_t *export_hash_slots;   // Слоты хэш-таблицы: индекс в exports[] или UINT32_MAX (пусто)
+    uint32_t export_hash_mask;     // Размер таблицы - 1 (размер всегда степень двойки)
+
+    // --- Direct-threaded code ---
+    bool threaded_code_prepared;   // Трансляция тел функций уже выполнена (один раз на модуль)
+
+    // --- Разделяемый модуль (espb_module_create / espb_module_instantiate) ---
+    uint32_t refcount;             // Ссылки: владелец модуля + каждый живой экземпляр
+    bool shared;                   // Экземпляров может быть несколько: JIT-код не зависит от экземпляра
+    EspbJitCache *shared_jit_cache; // JIT cache модуля, общий для всех экземпляров (только shared)
+    SemaphoreHandle_t jit_mutex;   // Сериализует JIT-компиляцию между экземплярами (только shared)
+
+    // --- Модуль из flash-раздела (espb_load_module_from_partition) ---
+    bool buffer_mmapped;           // buffer - отображение раздела через кэш flash, снимается вместе с модулем
+    uint32_t buffer_mmap_handle;   // esp_partition_mmap_handle_t отображения
+    bool buffer_owned;             // buffer выделен потоковым загрузчиком и освобождается вместе с модулем
+    uint8_t parse_step;            // Следующий шаг espb_parse_module_advance
+
+    // --- Память модуля ---
+    EspbModuleArena arena;         // Все таблицы модуля и сама структура; освобождается целиком
 } EspbModule;
 
 // === Async Wrapper System для OUT параметров (moved here before EspbInstance) ===
@@ -496,12 +622,36 @@ typedef struct AsyncWrapper {
     bool is_initialized;             // Флаг инициализации
 } AsyncWrapper;
 
+// Сегмент .rodata, оставленный в образе модуля: смещения [start, end) линейной памяти
+// читаются из data (буфер модуля или mmap раздела), см. espb_rodata.h
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+    const uint8_t *data;
+} EspbRodataSpan;
+
+// Виды памяти в учёте экземпляра (espb_memory_stats.h)
+typedef enum {
+    ESPB_MEM_INTERNAL = 0,            // Внутренняя DRAM
+    ESPB_MEM_PSRAM,                   // Внешняя PSRAM
+    ESPB_MEM_EXEC,                    // IRAM / исполняемая память: JIT-код, замыкания libffi
+    ESPB_MEM_NUM_KINDS
+} EspbMemKind;
+
 // Представляет инстанцированный ESPb модуль
 typedef struct EspbInstance {
     const EspbModule *module;
     uint8_t *memory_data;
     uint32_t memory_size_bytes;
     uint32_t memory_max_size_bytes;
+    uint32_t memory_capacity_bytes;  // Выделено под memory_data: MEMORY.GROW растёт на месте в этих пределах
+#if CONFIG_ESPB_RODATA_IN_PLACE
+    EspbRodataSpan *rodata;          // Сегменты .rodata вне memory_data (espb_data_address)
+    uint32_t num_rodata;
+#endif
+#if CONFIG_ESPB_SANDBOX_MASKED
+    uint32_t memory_mask;            // Маска песочницы: память 2^n байт, выровнена на свой размер (espb_sandbox.h)
+#endif
     uint8_t *globals_data;
     uint32_t globals_data_size;
     uint32_t *global_offsets;
@@ -511,6 +661,19 @@ typedef struct EspbInstance {
     void **resolved_import_funcs;
     void **resolved_import_globals;
     SemaphoreHandle_t instance_mutex;
+#if CONFIG_ESPB_CONCURRENT_CALLS
+    // Вызовы из нескольких задач (espb_api.h): куча гостя с MEMORY.GROW и async wrappers
+    SemaphoreHandle_t heap_mutex;
+    SemaphoreHandle_t async_mutex;       // Рекурсивный: хост может вызвать колбэк гостя изнутри обёртки
+#endif
+#if CONFIG_ESPB_FUEL
+    // Топливо (espb_fuel.h): JIT-код обращается к fuel по offsetof через s1 / instance,
+    // смещение должно умещаться в imm12 (RISC-V) и l32i (Xtensa)
+    int32_t fuel;                        // Остаток; <= 0 - вызвать обработчик
+    int32_t fuel_slice;                  // Пополнение после обработчика
+    EspbFuelHandler fuel_handler;        // NULL - taskYIELD и продолжить
+    void *fuel_user_data;
+#endif
     uint32_t passive_data_at_offset_zero_size;
     uint32_t runtime_stack_capacity;
     uint8_t *runtime_sp;
@@ -518,17 +681,43 @@ typedef struct EspbInstance {
     // === Async Wrapper System ===
     AsyncWrapper **async_wrappers;   // Динамический массив async wrappers
     uint32_t num_async_wrappers;     // Количество async wrappers
+    struct EspbCallbackCif *callback_cifs; // Кэш CIF колбэков по сигнатуре (espb_callback_system.c)
     // --- ДОБАВИТЬ ЭТИ ПОЛЯ ---
     EspbHeapContext heap_ctx;
+    void *alloca_stack_spare;  // Свободный блок стека ALLOCA для следующего контекста (espb_runtime_alloca.h)
     uint32_t static_data_end_offset;
     bool *import_is_blocking; // ОПТИМИЗАЦИЯ: Кэшированные флаги для блокирующих импортов
     uint8_t *import_is_readonly; // ОПТИМИЗАЦИЯ: readonly-imports (memcmp/strcmp) для async out-params
+    // ОПТИМИЗАЦИЯ: ffi_cif по фиксированной сигнатуре каждого функционального импорта,
+    // готовится один раз при инстанцировании. Запись готова, если import_cifs[i].rtype != NULL.
+    // Вызовы с расширенной информацией о типах (0xAA, variadic) берут CIF из var_cifs.
+    ffi_cif *import_cifs;
+    ffi_type **import_cif_arg_types; // Общий пул массивов arg_types для import_cifs
+    EspbMarshalPlan *import_marshal;  // Планы маршалинга immeta по импортам (espb_marshal_plan.h), иначе NULL
+    EspbVarCif **var_cifs;            // Кэш CIF вызовов с типами 0xAA (espb_runtime_ffi_call.h), ESPB_VAR_CIF_BUCKETS цепочек
+    uint32_t var_cif_count;           // Записей в var_cifs (не больше ESPB_VAR_CIF_MAX_ENTRIES)
     // --- КОНЕЦ ДОБАВЛЕНИЯ ---
 
+    EspbCallIcEntry *call_ic;         // Inline-кэш непрямых вызовов (CONFIG_ESPB_CALL_IC_ENTRIES), иначе NULL
+    uint32_t call_ic_mask;            // Число записей call_ic - 1
+
     // --- JIT Cache ---
     EspbJitCache *jit_cache;          // Кеш скомпилированных JIT-функций
     uint32_t jit_hot_function_count;  // Сколько функций помечено HOT в модуле (если 0 — JIT не нужен вообще, можно обходить весь диспетчер)
+    size_t jit_tier_up_bytes;         // Размер кода, скомпилированного автоматическим tier-up (бюджет IRAM)
+    EspbJitBackground *jit_bg;        // Фоновая задача компиляции (CONFIG_ESPB_JIT_BACKGROUND), иначе NULL
+    EspbJitSnapshot *jit_snapshot;    // Индекс снимка JIT-кода во flash (CONFIG_ESPB_JIT_SNAPSHOT), иначе NULL
+    uint32_t jit_active_calls;        // Вложенность execute_jit_code: код можно вытеснять только при 0
+    EspbJitStats *jit_stats;          // Статистика JIT (CONFIG_ESPB_JIT_STATS), иначе NULL
     // -----------------
+
+    EspbProfile *profile;             // Счётчики профилировщика (CONFIG_ESPB_PROFILER), иначе NULL
+    EspbImportProfile *import_profile; // Счётчики вызовов импортов (CONFIG_ESPB_IMPORT_PROFILE), иначе NULL
+    EspbSampler *sampler;             // Сэмплирующий профилировщик (espb_sampler_start), иначе NULL
+    uint8_t sample_pending;           // Сэмплер ждёт отсчёт от интерпретатора в ближайшей точке опроса
+
+    size_t mem_peak[ESPB_MEM_NUM_KINDS]; // Пик памяти экземпляра по видам EspbMemKind (espb_memory_stats.h)
+    size_t shadow_stack_peak;         // Пик блоков теневого стека в вызовах экземпляра, байт
 } EspbInstance;
 
 // Представление значения на стеке операндов
@@ -562,9 +751,30 @@ typedef union __attribute__((aligned(8))) {
 #define V_I64(val) ((val).i64)
 #define V_F32(val) ((val).f32)
 #define V_F64(val) ((val).f64)
+#if UINTPTR_MAX > 0xFFFFFFFFu
+// 64-bit хост (host/): 32-битные операции не трогают старшую половину регистра, поэтому
+// указатель берётся из младших 32 бит (весь адресуемый гостем код и данные ниже 4 ГБ)
+static inline void **espb_value_ptr_slot(Value *v) { v->_pad = 0; return &v->ptr; }
+#define V_PTR(val) (*espb_value_ptr_slot((Value *)&(val)))
+#else
 #define V_PTR(val) ((val).ptr)
+#endif
 #define V_RAW(val) ((val).raw)
 
+// V128: вектор Vn занимает пару регистров (Rn, Rn+1), байты 0..7 - Rn, 8..15 - Rn+1
+typedef union __attribute__((aligned(8), may_alias)) {
+    uint8_t  u8[16];
+    int8_t   i8[16];
+    uint16_t u16[8];
+    int16_t  i16[8];
+    uint32_t u32[4];
+    int32_t  i32[4];
+    float    f32[4];
+    uint64_t u64[2];
+} EspbV128;
+
+#define V_V128(regs, r) (*(EspbV128 *)&(regs)[(r)])
+
 // Заглушки для старого кода (чтобы не ломать логику, если она осталась)
 #define SET_TYPE(val, t) do { } while(0)
 #define CHECK_TYPE(val, t) (true)
@@ -588,7 +798,6 @@ typedef struct RuntimeFrame {
 #define ESPB_F64(v)    ((Value){.f64 = (double)(v)})
 #define ESPB_PTR(v)    ((Value){.ptr = (void*)(v)})
 #define ESPB_BOOL(v)   ((Value){.i32 = (v) ? 1 : 0})
-#define ESPB_V128(v)   ((Value){.raw = 0}) // Placeholder for V128
 #define ESPB_FUNC(idx) ((Value){.u32 = (idx)})
 #define ESPB_VOID()    ((Value){.raw = 0})
 
@@ -598,38 +807,80 @@ typedef struct RuntimeFrame {
 #define ESPB_STRING(str)    ESPB_PTR(str)
     uint32_t caller_local_func_idx; // Индекс вызывающей функции для восстановления контекста
 
-    // --- ИСПРАВЛЕНИЕ для CALL_INDIRECT: Сохранение полного кадра ---
-    Value* saved_frame;               // Сохраненная копия регистров вызывающей стороны
-    size_t saved_num_virtual_regs;    // Количество регистров в сохраненном кадре
-    // -----------------------------------------------------------
+    // Регистры вызывающей стороны не копируются: её кадр [SavedFP, SavedFP + num_virtual_regs)
+    // лежит ниже кадра вызываемой и при вызове не затрагивается
+    bool stack_chunk_entered;         // Вызов перешёл в следующий блок теневого стека: SavedFP - в предыдущем
 
-    // Система отслеживания ALLOCA выделений
-    void *alloca_ptrs[32];     // Массив ALLOCA указателей (увеличен с 16)
-    uint8_t alloca_count;      // Количество выделений
-    bool has_custom_aligned;   // Флаг custom alignment
+    // Вершина стека ALLOCA (EspbAllocaStack::sp) при входе в кадр; восстанавливается при выходе
+    uint32_t alloca_base;
+
+#if CONFIG_ESPB_PROFILER
+    uint32_t prof_enter_cycles;       // Счётчик тактов при входе в функцию этого кадра
+    uint32_t prof_child_cycles;       // Такты, проведённые в вызванных функциях
+#endif
 } RuntimeFrame;
 
+// Блок теневого стека. Кадры не перемещаются: если новый кадр не помещается в текущий
+// блок, он размещается с начала следующего. Пройденные блоки остаются в списке и
+// переиспользуются при следующем переходе через границу.
+typedef struct EspbShadowChunk {
+    struct EspbShadowChunk *prev;
+    struct EspbShadowChunk *next;
+    size_t capacity;                  // Байт в data
+    size_t prev_sp;                   // sp предыдущего блока в момент перехода
+    uint8_t data[] __attribute__((aligned(8)));
+} EspbShadowChunk;
+
+// Стек ALLOCA: блок кучи гостя, в котором выделение - сдвиг вершины, а выход из кадра
+// возвращает вершину на место. Блок берётся у экземпляра при первом ALLOCA и отдаётся
+// обратно, когда вершина опускается до нуля.
+typedef struct EspbAllocaStack {
+    uint8_t *base;            // NULL - блок не взят
+    uint32_t size;
+    uint32_t sp;              // Смещение вершины от base
+    EspbInstance *instance;   // Чья куча владеет блоком
+} EspbAllocaStack;
+
 // Контекст выполнения для одного потока
 // РЕФАКТОРИНГ: Переход на модель единого виртуального стека
 typedef struct ExecutionContext {
     RuntimeFrame* call_stack;
     int call_stack_top;
+    int call_stack_capacity;       // Выделено кадров; стек растёт блоками до CONFIG_ESPB_CALL_STACK_MAX_DEPTH
+
+    // ALLOCA всех активных кадров (espb_runtime_alloca.h)
+    EspbAllocaStack alloca_stack;
 
     // shadow_stack теперь используется как единый виртуальный стек
-    uint8_t* shadow_stack_buffer;
+    uint8_t* shadow_stack_buffer;  // data текущего блока shadow_chunk
     size_t shadow_stack_capacity;  // В байтах
+    EspbShadowChunk *shadow_chunk;
+    bool shadow_chunk_entered;     // Переход в новый блок ждёт следующего push_call_frame
+    size_t shadow_peak_bytes;      // Ёмкость блоков от первого до самого дальнего с последнего сброса
     
-    size_t sp; // Указатель стека (смещение в байтах) - было shadow_stack_ptr
-    size_t fp; // Указатель кадра (смещение в байтах) - НОВОЕ
+    size_t sp; // Указатель стека (смещение в байтах в текущем блоке) - было shadow_stack_ptr
+    size_t fp; // Указатель кадра (смещение в байтах в текущем блоке) - НОВОЕ
 
     // УДАЛЕНО: Value* registers; - больше не нужен динамический буфер
     // УДАЛЕНО: uint16_t num_virtual_regs; - размер кадра рассчитывается на лету
 
     // Остальные поля остаются
-    uint32_t linear_memory_sp;
     uint32_t next_alloc_offset;
     bool feature_callback_auto_active;
     bool callback_system_initialized;
+
+#if CONFIG_ESPB_GREEN_THREADS
+    // Контекст green-потока (espb_green.h): на блокирующем импорте исполнение
+    // останавливается, кадры и теневой стек ждут здесь возобновления
+    bool green;
+    bool green_suspended;             // Следующий espb_call_function продолжит с точки остановки
+    bool green_threaded;              // Точка остановки в прошитом коде
+    uint32_t green_func_idx;          // Локальная функция точки остановки
+    uint32_t green_pc;                // Смещение pc за инструкцией CALL_IMPORT
+    size_t green_locals;              // Смещение регистров функции в текущем блоке теневого стека
+    uint32_t green_wait_ticks;        // Запрошенное ожидание (аргумент vTaskDelay)
+    EspbShadowChunk *green_entry_chunk;
+#endif
 } ExecutionContext;
 
 // Контекст для универсального диспетчера обратных вызовов
@@ -28,6 +28,14 @@ extern "C" {
 // --- Основные функции парсинга модуля ---
 
 EspbResult espb_parse_module(EspbModule **out_module, const uint8_t *buffer, size_t buffer_size);
+
+// Пошаговый разбор для потокового загрузчика (espb_loader.h). buffer - окончательное
+// место модуля размером buffer_size, из которого получены первые available байт
+// (заголовок и таблица секций - обязательно). advance разбирает секции, пришедшие
+// целиком, и выставляет out_done после последней. При ошибке модуль освобождает
+// вызывающая сторона (espb_free_module).
+EspbResult espb_parse_module_begin(EspbModule **out_module, const uint8_t *buffer, size_t buffer_size, size_t available);
+EspbResult espb_parse_module_advance(EspbModule *module, size_t available, bool *out_done);
 void espb_free_module(EspbModule *module);
 
 // --- Вспомогательные функции парсинга ---
@@ -35,6 +43,34 @@ void espb_free_module(EspbModule *module);
 // Поиск секции по ID
 bool espb_find_section(const EspbModule *module, uint8_t section_id, const uint8_t **out_data, uint32_t *out_size);
 
+// Поиск экспорта по имени и виду через хэш-индекс (O(1) в среднем).
+// Возвращает индекс в module->exports через out_export_idx.
+bool espb_find_export(const EspbModule *module, const char *name, EspbExportKind kind, uint32_t *out_export_idx);
+
+static inline uint32_t espb_func_ptr_hash(uint32_t data_offset) {
+    uint32_t h = data_offset * 0x9E3779B1u;
+    return h ^ (h >> 15);
+}
+
+// Поиск функции по смещению указателя в data сегменте (func_ptr_map) через хэш-индекс, O(1) в среднем.
+// Возвращает локальный индекс функции через out_func_idx.
+static inline bool espb_find_func_ptr(const EspbModule *module, uint32_t data_offset, uint32_t *out_func_idx) {
+    const uint32_t *slots = module->func_ptr_hash_slots;
+    if (!slots) return false;
+    uint32_t slot = espb_func_ptr_hash(data_offset) & module->func_ptr_hash_mask;
+    for (uint32_t e; (e = slots[slot]) != UINT32_MAX; slot = (slot + 1) & module->func_ptr_hash_mask) {
+        if (module->func_ptr_map[e].data_offset == data_offset) {
+            *out_func_idx = module->func_ptr_map[e].function_index;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Проверка метаданных тела функции (заголовок против кода); при CONFIG_ESPB_LAZY_FUNCTIONS -
+// при первом вызове, иначе при разборе секции Code
+EspbResult espb_validate_function_body(const EspbFunctionBody *body, uint32_t func_idx);
+
 // Парсинг заголовка и таблицы секций
 EspbResult espb_parse_header_and_sections(EspbModule *module, const uint8_t *buffer, size_t buffer_size);
 
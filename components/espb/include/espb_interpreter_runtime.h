@@ -30,6 +30,39 @@ extern "C" {
 EspbResult espb_instantiate(EspbInstance **out_instance, const EspbModule *module /*, HostResolver *host_resolver */);
 void espb_free_instance(EspbInstance *instance);
 
+// --- Разделяемый модуль ---
+
+// Делает модуль разделяемым: общий JIT cache и мьютекс компиляции для всех экземпляров.
+// Вызывается один раз до первого espb_instantiate.
+EspbResult espb_module_make_shared(EspbModule *module);
+void espb_module_retain(EspbModule *module);
+// Снимает ссылку; на последней освобождает общий JIT cache и сам модуль.
+void espb_module_release(EspbModule *module);
+
+// --- Снимок экземпляра ---
+
+typedef struct EspbInstanceSnapshot EspbInstanceSnapshot;
+
+/**
+ * @brief Снимает образ только что созданного экземпляра: память, глобалы, таблицу,
+ * разрешённые импорты и состояние кучи после start function.
+ *
+ * Для поиска нативных указателей в образе поднимается и сразу освобождается второй
+ * экземпляр модуля (start function исполняется ещё раз). Не поддерживаются импортируемая
+ * память, async wrappers и куча, выросшая за пределы линейной памяти. С JIT модуль должен
+ * быть разделяемым (espb_module_make_shared) до создания экземпляра. Состояние хоста,
+ * созданное start function (callback'и, задачи), в клоны не переносится.
+ */
+EspbResult espb_instance_snapshot(const EspbInstance *instance, EspbInstanceSnapshot **out_snapshot);
+
+/**
+ * @brief Создаёт экземпляр из снимка без импорта, релокаций, инициализации сегментов и
+ * start function: копирование образов и перенос указателей на новые базы.
+ * Клон сразу использует общий JIT-код модуля.
+ */
+EspbResult espb_instance_clone(const EspbInstanceSnapshot *snapshot, EspbInstance **out_instance);
+void espb_instance_snapshot_free(EspbInstanceSnapshot *snapshot);
+
 EspbResult espb_apply_relocations(EspbInstance *instance);
 EspbResult espb_initialize_data_segments(EspbInstance *instance);
 EspbResult espb_initialize_element_segments(EspbInstance *instance);
@@ -39,6 +72,10 @@ EspbResult espb_call_function(EspbInstance *instance, ExecutionContext *exec_ctx
 
 ExecutionContext* init_execution_context(void);
 void free_execution_context(ExecutionContext *ctx);
+void reset_execution_context(ExecutionContext *ctx, EspbInstance *instance);
+ExecutionContext* acquire_execution_context(void);
+void release_execution_context(ExecutionContext *ctx, EspbInstance *instance);
+void free_task_execution_context(void);
 
 // Вспомогательные функции времени выполнения (обычно static и не объявляются здесь, но если что-то нужно извне...)
 // static EspbResult allocate_linear_memory(EspbInstance *instance); // Пример
@@ -26,6 +26,10 @@ extern "C" {
 
 ExecutionContext* init_execution_context(void);
 void free_execution_context(ExecutionContext *ctx);
+void reset_execution_context(ExecutionContext *ctx, EspbInstance *instance);
+ExecutionContext* acquire_execution_context(void);
+void release_execution_context(ExecutionContext *ctx, EspbInstance *instance);
+void free_task_execution_context(void);
 
 /**
  * @brief Выполняет вызов функции ESPb по ее индексу.
@@ -39,6 +43,45 @@ void free_execution_context(ExecutionContext *ctx);
  */
 EspbResult espb_call_function(EspbInstance *instance, ExecutionContext *exec_ctx, uint32_t func_idx, const Value *args, Value *results);
 
+/**
+ * @brief Транслирует тела функций модуля в direct-threaded код (CONFIG_ESPB_THREADED_CODE).
+ *
+ * Вызывается при инстанцировании до первого исполнения кода модуля.
+ * Без CONFIG_ESPB_THREADED_CODE ничего не делает.
+ */
+void espb_interpreter_prepare_threaded_code(EspbModule *module);
+
+/**
+ * @brief Смещение в байт-коде инструкции, начинающейся в прошитом коде тела с threaded_off.
+ * Холодный путь (выделяет временные таблицы). Без CONFIG_ESPB_THREADED_CODE возвращает false.
+ */
+bool espb_interpreter_bytecode_offset(const EspbFunctionBody *body, uint32_t threaded_off, uint32_t *out_bc_off);
+
+/**
+ * @brief Подготавливает тело функции к исполнению (CONFIG_ESPB_LAZY_FUNCTIONS):
+ * проверка заголовка, оптимизация байт-кода и трансляция в прошитый код.
+ *
+ * Вызывается при первом входе в функцию и перед JIT-компиляцией. Потокобезопасна:
+ * если тело готовит другая задача, ждёт её. Без CONFIG_ESPB_LAZY_FUNCTIONS всё это
+ * делается при загрузке и функция ничего не делает.
+ *
+ * @return ESPB_OK, или ESPB_ERR_INVALID_CODE_SECTION если тело не прошло проверку.
+ */
+EspbResult espb_prepare_function(EspbModule *module, uint32_t local_func_idx);
+
+static inline EspbResult espb_ensure_function_ready(const EspbModule *module, uint32_t local_func_idx) {
+#if CONFIG_ESPB_LAZY_FUNCTIONS
+    if (__builtin_expect(__atomic_load_n(&module->function_bodies[local_func_idx].prepare_state, __ATOMIC_ACQUIRE) !=
+                         ESPB_BODY_READY, 0)) {
+        return espb_prepare_function((EspbModule *)module, local_func_idx);
+    }
+#else
+    (void)module;
+    (void)local_func_idx;
+#endif
+    return ESPB_OK;
+}
+
 #ifdef __cplusplus
 }
 #endif
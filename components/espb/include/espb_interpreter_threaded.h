@@ -0,0 +1,130 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef ESPB_INTERPRETER_THREADED_H
+#define ESPB_INTERPRETER_THREADED_H
+
+#include "espb_interpreter_common_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Формат прошитого (direct-threaded) кода, EspbFunctionBody::threaded_code_buffer.
+ *
+ * Каждая инструкция занимает целое число слотов указателя:
+ *   [void *handler][opcode u8][операнды байт-кода как есть][нули до выравнивания]
+ * Диспетчер читает handler и opcode, ставит pc на операнды и делает goto *handler,
+ * поэтому обычные обработчики опкодов работают без изменений.
+ *
+ * Исключение - переходы (BR/BR_IF/BR_TABLE): их операнды перекодированы в
+ * выровненные int32 смещения относительно начала прошитой инструкции:
+ *   BR:       [handler][op][pad]       @DISP: i32 disp
+ *   BR_IF:    [handler][op][reg u8]    @DISP: i32 disp
+ *   BR_TABLE: [handler][op][reg u8]    @DISP: u32 n, i32 targets[n], i32 default
+ *
+ * Суперинструкции - частые пары, слитые в одну прошитую инструкцию
+ * (вторая инструкция пары не должна быть целью перехода):
+ *   CMP.*.I32 Rd,R1,R2 + BR_IF Rd:  [handler][op][rd][r1][r2]    @FUSED_DISP: i32 disp
+ *   ADD.I32.IMM8 Rd,R1,imm + BR:    [handler][op][rd][r1][imm8]  @FUSED_DISP: i32 disp
+ *
+ * NOP (0x00/0x01) в поток не попадают, в том числе NOP-заполнение оптимизатора байт-кода.
+ *
+ * Поток завершается стражем с обработчиком end_of_code, поэтому в прошитом
+ * режиме цикл интерпретатора не проверяет pc на выход за границу кода.
+ */
+#define ESPB_THREADED_SLOT          (sizeof(void *))
+#define ESPB_THREADED_HDR           (ESPB_THREADED_SLOT + 1)
+#define ESPB_THREADED_ALIGN(n)      (((n) + ESPB_THREADED_SLOT - 1) & ~(ESPB_THREADED_SLOT - 1))
+#define ESPB_THREADED_BR_DISP       ((ESPB_THREADED_HDR + 1 + 3) & ~(size_t)3)
+#define ESPB_THREADED_BR_LEN        ESPB_THREADED_ALIGN(ESPB_THREADED_BR_DISP + 4)
+#define ESPB_THREADED_BR_TABLE_LEN(n) ESPB_THREADED_ALIGN(ESPB_THREADED_BR_DISP + 4 + 4 * ((size_t)(n) + 1))
+#define ESPB_THREADED_FUSED_DISP    ((ESPB_THREADED_HDR + 3 + 3) & ~(size_t)3)
+#define ESPB_THREADED_FUSED_LEN     ESPB_THREADED_ALIGN(ESPB_THREADED_FUSED_DISP + 4)
+
+// Адреса обработчиков интерпретатора (labels computed goto), нужные транслятору.
+typedef struct {
+    void * const *dispatch_table;   // 256 обработчиков байт-кода
+    void *br;                       // BR в прошитой форме
+    void *br_if;                    // BR_IF в прошитой форме
+    void *br_table;                 // BR_TABLE в прошитой форме
+    void *end_of_code;              // Страж в конце потока
+    // Суперинструкции; NULL - пара не сливается
+    void *cmp_i32_br_if;            // CMP.EQ.I32 .. CMP.GE.I32U (0xC0..0xC9) + BR_IF
+    void *add_i32_imm8_br;          // ADD.I32.IMM8 (0x40) + BR
+    // MOV.I8/I16/I32 (0x10..0x12) тел с regs32: копирует только младшее слово; NULL - обычный MOV
+    void *mov32;
+} EspbThreadedHandlers;
+
+/**
+ * @brief Полная длина инструкции байт-кода (опкод + операнды) в байтах.
+ *
+ * @return 0 для неизвестного/зарезервированного опкода или обрезанной инструкции.
+ */
+size_t espb_instruction_length(const uint8_t *pc, const uint8_t *end);
+
+/**
+ * @brief Проверяет, что функция не использует 64-битных значений (EspbFunctionBody::regs32).
+ *
+ * true, если ни сигнатура функции, ни сигнатуры её вызовов, ни читаемые глобалы, ни
+ * инструкции тела не работают с I64/U64/F64/V128, а тело не берёт адрес регистра
+ * (ADDR_OF). Тогда старшие 4 байта каждого регистра кадра не читаются, и копирование
+ * регистров (MOV, JIT) может их пропускать. На целях с 64-битными указателями - всегда false.
+ *
+ * Раскладка кадра от флага не зависит: регистр занимает 8 байт и в кадрах интерпретатора,
+ * и в v_regs JIT. Регистровый файл с шагом 4 байта (свои обработчики интерпретатора,
+ * размеры кадров в push_callee_frame/execute_jit_code, смещения rd * 4 в JIT) не сделан.
+ */
+bool espb_function_regs32(const EspbModule *module, uint32_t local_func_idx);
+
+/**
+ * @brief Транслирует тело функции в прошитый код.
+ *
+ * При успехе заполняет threaded_code_buffer/threaded_code_size_bytes и
+ * устанавливает is_threaded. При ошибке тело остаётся нетронутым и
+ * исполняется из байт-кода.
+ */
+EspbResult espb_threaded_translate_function(EspbFunctionBody *body, const EspbThreadedHandlers *handlers);
+
+/**
+ * @brief Транслирует все тела модуля, ещё не скомпилированные JIT.
+ *
+ * Выполняется один раз на модуль (module->threaded_code_prepared);
+ * функции, которые не удалось транслировать, остаются на байт-коде.
+ */
+void espb_threaded_translate_module(EspbModule *module, const EspbThreadedHandlers *handlers);
+
+/**
+ * @brief Смещение в байт-коде инструкции, начинающейся в прошитом потоке с threaded_off.
+ *
+ * Повторяет раскладку транслятора, поэтому handlers должны совпадать с переданными
+ * при трансляции. Холодный путь (OSR): выделяет временные таблицы.
+ *
+ * @return false, если по threaded_off нет начала инструкции.
+ */
+bool espb_threaded_bytecode_offset(const EspbFunctionBody *body, const EspbThreadedHandlers *handlers,
+                                   uint32_t threaded_off, uint32_t *out_bc_off);
+
+// Освобождает прошитый код тела функции.
+void espb_threaded_free_function(EspbFunctionBody *body);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPB_INTERPRETER_THREADED_H
@@ -19,6 +19,8 @@
 #define ESPB_JIT_H
 
 #include "espb_interpreter_common_types.h"
+#include "espb_jit_arena.h"
+#include "espb_jit_stats.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -36,6 +38,7 @@ typedef struct {
     void* jit_code;             // Указатель на скомпилированный нативный код
     size_t code_size;           // Размер кода в байтах
     bool is_valid;              // Флаг валидности записи
+    uint32_t last_use;          // Отметка последнего вызова (LRU-вытеснение)
 } EspbJitCacheEntry;
 
 /**
@@ -44,15 +47,108 @@ typedef struct {
  * Используем имя структуры, чтобы соответствовать forward declaration в common_types.h
  */
 struct EspbJitCache {
-    EspbJitCacheEntry* entries; // Массив записей
-    size_t capacity;            // Максимальное количество записей
+    EspbJitCacheEntry* entries; // Записи, индекс = func_idx - first_func_idx (по одной на функцию)
+    size_t capacity;            // Количество слотов (локальных функций модуля)
     size_t count;               // Текущее количество записей
+    uint32_t first_func_idx;    // Глобальный индекс первой локальной функции (число импортов)
+    size_t used_bytes;          // Суммарный размер кода в cache
+    size_t budget_bytes;        // Лимит размера кода (CONFIG_ESPB_JIT_IRAM_BUDGET), 0 - без лимита
+    uint32_t clock;             // Счётчик для отметок last_use
+    const EspbModule* module;   // Модуль функций: имена для карты JIT-кода (CONFIG_ESPB_JIT_CODE_MAP)
+#if CONFIG_ESPB_JIT_ARENA
+    EspbJitArena arena;         // Исполняемая память скомпилированных функций экземпляра
+#endif
 };
 
 /**
  * @brief Инициализирует JIT cache
+ *
+ * @param module Модуль, функции которого хранит cache: слот на каждую локальную функцию.
+ */
+EspbResult espb_jit_cache_init(EspbJitCache* cache, const EspbModule* module);
+
+/**
+ * @brief Возвращает запись функции или NULL (O(1)).
+ */
+static inline EspbJitCacheEntry* espb_jit_cache_entry(EspbJitCache* cache, uint32_t func_idx) {
+    uint32_t slot = func_idx - cache->first_func_idx;
+    if (!cache->entries || slot >= cache->capacity || !cache->entries[slot].is_valid) return NULL;
+    return &cache->entries[slot];
+}
+
+/**
+ * @brief Отмечает вызов функции для LRU-вытеснения.
+ */
+static inline void espb_jit_cache_touch(EspbJitCache* cache, uint32_t func_idx) {
+    uint32_t slot = func_idx - cache->first_func_idx;
+    if (slot < cache->capacity) cache->entries[slot].last_use = ++cache->clock;
+}
+
+// Вытеснение по бюджету IRAM. С фоновым компилятором код может исполняться на другом
+// ядре в момент компиляции, поэтому там вытеснение не используется.
+#if CONFIG_ESPB_JIT_ENABLED && CONFIG_ESPB_JIT_IRAM_BUDGET > 0 && !CONFIG_ESPB_JIT_BACKGROUND
+#define ESPB_JIT_EVICTION 1
+#else
+#define ESPB_JIT_EVICTION 0
+#endif
+
+/**
+ * @brief Отмечает вход в JIT-код функции func_idx (LRU при ESPB_JIT_EVICTION, счётчик CONFIG_ESPB_JIT_STATS).
+ */
+static inline void espb_jit_note_call(EspbInstance* instance, uint32_t func_idx) {
+#if ESPB_JIT_EVICTION
+    if (instance->jit_cache) espb_jit_cache_touch(instance->jit_cache, func_idx);
+#endif
+    espb_jit_stats_exec(instance, func_idx, 1);
+    (void)instance; (void)func_idx;
+}
+
+// Не больше стольких регистров обнуляет переход хвостового самовызова, иначе - обычный CALL
+#define ESPB_JIT_TAIL_CALL_MAX_ZERO 8
+
+/**
+ * @brief Проверяет самовызов в хвостовой позиции (CONFIG_ESPB_TAIL_CALLS): CALL local_func_idx
+ * на компилируемую функцию func_idx (глобальный индекс), сразу за которым идёт END.
+ *
+ * Бэкенд заменяет такой вызов переходом на начало тела: аргументы уже лежат в v_regs[0..),
+ * кадр тот же. Регистры [*out_zero_from, *out_zero_to) обнуляются перед переходом так же,
+ * как их обнулил бы jit_call_espb_function для нового кадра.
+ *
+ * @param next     Байт-код сразу после операндов CALL
+ * @param end      Конец байт-кода функции
+ * @param max_args Сколько аргументов передаёт CALL бэкенда
  */
-EspbResult espb_jit_cache_init(EspbJitCache* cache, size_t capacity);
+static inline bool espb_jit_self_tail_call(const EspbModule* module, uint32_t func_idx, uint16_t local_func_idx,
+                                           const uint8_t* next, const uint8_t* end, uint32_t max_args,
+                                           uint32_t* out_zero_from, uint32_t* out_zero_to) {
+#if CONFIG_ESPB_TAIL_CALLS
+    if (local_func_idx >= module->num_functions || local_func_idx + module->num_imported_funcs != func_idx ||
+        next >= end || *next != 0x0F) {
+        return false;
+    }
+    const EspbFunctionBody* body = &module->function_bodies[local_func_idx];
+    uint32_t num_params = module->signatures[module->function_signature_indices[local_func_idx]].num_params;
+    uint32_t num_regs = body->header.num_virtual_regs;
+    uint32_t zero_from = num_params < max_args ? num_params : max_args;
+    uint32_t zero_to = ESPB_FRAME_ZERO_INIT_REGS(body);
+    if (zero_to > num_regs) zero_to = num_regs;
+    if (zero_to < zero_from) zero_to = zero_from;
+    if (zero_to - zero_from > ESPB_JIT_TAIL_CALL_MAX_ZERO) return false;
+    *out_zero_from = zero_from;
+    *out_zero_to = zero_to;
+    return true;
+#else
+    (void)module; (void)func_idx; (void)local_func_idx; (void)next; (void)end; (void)max_args;
+    (void)out_zero_from; (void)out_zero_to;
+    return false;
+#endif
+}
+
+/**
+ * @brief Находит наименее недавно использованную запись (кандидат на вытеснение).
+ * @return Глобальный индекс функции или UINT32_MAX, если cache пуст.
+ */
+uint32_t espb_jit_cache_lru(EspbJitCache* cache);
 
 /**
  * @brief Освобождает JIT cache
@@ -75,6 +171,28 @@ EspbResult espb_jit_cache_insert(EspbJitCache* cache, uint32_t func_idx, void* j
  */
 void espb_jit_cache_remove(EspbJitCache* cache, uint32_t func_idx);
 
+/**
+ * @brief Резервирует исполняемую память под компиляцию одной функции.
+ *
+ * При CONFIG_ESPB_JIT_ARENA резерв берётся из арены JIT cache экземпляра (функции
+ * упаковываются подряд), иначе - отдельный espb_exec_alloc. island/island_count задают
+ * литерал-остров блока арены; out->island указывает на него в исполняемой памяти
+ * (NULL без арены). Резерв завершается espb_jit_code_commit() или espb_jit_code_abort().
+ */
+bool espb_jit_code_reserve(EspbInstance* instance, size_t max_size, const uint32_t* island, size_t island_count,
+                           EspbJitArenaReservation* out);
+
+/**
+ * @brief Фиксирует used байт кода в начале резерва.
+ * @return true, если код в арене: буфер нельзя ужимать или перемещать.
+ */
+bool espb_jit_code_commit(EspbInstance* instance, void* code, size_t used);
+
+/**
+ * @brief Отменяет резерв после ошибки компиляции.
+ */
+void espb_jit_code_abort(EspbInstance* instance, void* code);
+
 /**
  * @brief Компилирует одну функцию ESPB в нативный код.
  *
@@ -88,6 +206,22 @@ void espb_jit_cache_remove(EspbJitCache* cache, uint32_t func_idx);
  */
 EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx, const EspbFunctionBody *body, void **out_code, size_t *out_size);
 
+/**
+ * @brief То же, что espb_jit_compile_function, плюс вход-трамплин для OSR и карта кода.
+ *
+ * @param out_osr Если не NULL и функция содержит циклы, получает таблицу OSR-точек
+ *                (см. espb_jit_osr.h, освобождается free); иначе NULL.
+ *                Код из снимка (CONFIG_ESPB_JIT_SNAPSHOT) OSR-точек не имеет.
+ * @param out_pc_map Если не NULL (ESPB_JIT_PC_MAPS), получает карту нативных смещений
+ *                   в байт-код (см. espb_jit_code_map.h, освобождается free); иначе NULL.
+ *                   Код из снимка карты не имеет.
+ * @param out_relocs Если не NULL (CONFIG_ESPB_JIT_RELOAD, RISC-V), получает релокации helper-вызовов
+ *                   (см. espb_jit_snapshot.h, освобождается free); NULL - код нельзя переносить.
+ */
+EspbResult espb_jit_compile_function_ex(EspbInstance* instance, uint32_t func_idx, const EspbFunctionBody *body,
+                                        void **out_code, size_t *out_size, EspbJitOsrInfo **out_osr,
+                                        EspbJitPcMap **out_pc_map, EspbJitRelocs **out_relocs);
+
 /**
  * @brief Компилирует JIT-регион (часть функции) в нативный код.
  *
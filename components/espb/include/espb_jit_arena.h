@@ -0,0 +1,100 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef ESPB_JIT_ARENA_H
+#define ESPB_JIT_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Арена JIT-кода экземпляра: функции упаковываются подряд в крупные блоки исполняемой
+// памяти вместо отдельного espb_exec_alloc на каждую (заголовки аллокатора и хвосты
+// буферов под худший случай больше не тратят IRAM).
+//
+// Компиляция резервирует хвост блока под оценку размера, пишет код на месте и фиксирует
+// фактический размер: код не перемещается, поэтому PC-relative вызовы остаются верными.
+// В начале блока может лежать общий литерал-остров (адреса helper'ов), на который
+// ссылается код всех функций блока (Xtensa l32r).
+
+typedef struct EspbJitArenaChunk {
+    struct EspbJitArenaChunk *next;
+    uint8_t *base;         // Исполняемая память блока
+    size_t size;
+    size_t used;           // Граница выделенного (кратна 4)
+    size_t live;           // Байты кода живых функций; 0 - блок можно освободить
+    size_t island_count;   // Слов литерал-острова в начале блока
+} EspbJitArenaChunk;
+
+typedef struct {
+    EspbJitArenaChunk *chunks;
+    EspbJitArenaChunk *reserved; // Блок с незафиксированным резервом (компиляции сериализованы)
+    size_t chunk_size;
+} EspbJitArena;
+
+typedef struct {
+    void *code;                   // Начало резерва (выровнено на 4)
+    size_t capacity;
+    const uint32_t *island;       // Литерал-остров блока в исполняемой памяти (NULL - нет)
+    size_t island_count;
+} EspbJitArenaReservation;
+
+void espb_jit_arena_init(EspbJitArena *arena, size_t chunk_size);
+
+/**
+ * @brief Освобождает все блоки. Код арены после этого исполнять нельзя.
+ */
+void espb_jit_arena_destroy(EspbJitArena *arena);
+
+/**
+ * @brief Резервирует не меньше max_size байт под код одной функции.
+ *
+ * Блок подбирается с тем же литерал-островом (island/island_count) и достаточным
+ * свободным хвостом; иначе выделяется новый. Незафиксированный предыдущий резерв
+ * отменяется.
+ * @return false, если исполняемая память исчерпана.
+ */
+bool espb_jit_arena_reserve(EspbJitArena *arena, size_t max_size, const uint32_t *island, size_t island_count,
+                            EspbJitArenaReservation *out);
+
+/**
+ * @brief Фиксирует used байт в начале текущего резерва.
+ */
+void espb_jit_arena_commit(EspbJitArena *arena, void *code, size_t used);
+
+/**
+ * @brief Отменяет текущий резерв (ошибка компиляции).
+ */
+void espb_jit_arena_abort(EspbJitArena *arena, void *code);
+
+/**
+ * @brief Возвращает код функции арене. Код в конце блока освобождает хвост под новые
+ * функции, пустой блок освобождается целиком.
+ */
+void espb_jit_arena_release(EspbJitArena *arena, void *code, size_t size);
+
+bool espb_jit_arena_owns(const EspbJitArena *arena, const void *code);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPB_JIT_ARENA_H
@@ -0,0 +1,59 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef ESPB_JIT_BACKGROUND_H
+#define ESPB_JIT_BACKGROUND_H
+
+#include "espb_interpreter_common_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if CONFIG_ESPB_JIT_BACKGROUND
+
+/**
+ * @brief Запускает низкоприоритетную задачу компиляции для инстанса.
+ *
+ * Задача закреплена за ядром CONFIG_ESPB_JIT_BG_TASK_CORE и получает запросы
+ * через очередь. Результат публикуется через espb_jit_compile_and_publish.
+ */
+EspbResult espb_jit_bg_start(EspbInstance *instance);
+
+/**
+ * @brief Останавливает задачу; текущая компиляция дожидается завершения,
+ *        необработанные запросы отбрасываются.
+ */
+void espb_jit_bg_stop(EspbInstance *instance);
+
+/**
+ * @brief Ставит локальную функцию в очередь компиляции.
+ *
+ * Не блокирует. Повторные запросы для уже поставленной функции игнорируются.
+ *
+ * @param tier_up true - компиляция по счётчику tier-up (учитывается бюджет и ставится флаг HOT).
+ * @return false, если фоновая задача не запущена (вызывающий компилирует синхронно).
+ */
+bool espb_jit_bg_request(EspbInstance *instance, uint32_t local_func_idx, bool tier_up);
+
+#endif // CONFIG_ESPB_JIT_BACKGROUND
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPB_JIT_BACKGROUND_H
@@ -0,0 +1,97 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef ESPB_JIT_BUDGET_H
+#define ESPB_JIT_BUDGET_H
+
+#include "espb_interpreter_common_types.h"
+#include "espb_jit.h"
+#include "esp_timer.h"
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifndef CONFIG_ESPB_JIT_MAX_BYTECODE_SIZE
+#define CONFIG_ESPB_JIT_MAX_BYTECODE_SIZE 0
+#endif
+#ifndef CONFIG_ESPB_JIT_MAX_NATIVE_SIZE
+#define CONFIG_ESPB_JIT_MAX_NATIVE_SIZE 0
+#endif
+#ifndef CONFIG_ESPB_JIT_MAX_COMPILE_TIME_MS
+#define CONFIG_ESPB_JIT_MAX_COMPILE_TIME_MS 0
+#endif
+#ifndef CONFIG_ESPB_JIT_IRAM_QUOTA
+#define CONFIG_ESPB_JIT_IRAM_QUOTA 0
+#endif
+
+/*
+ * Бюджеты компиляции (0 - без лимита).
+ *
+ * Размер байт-кода и квота IRAM экземпляра проверяет диспетчер до компиляции.
+ * Бэкенд ограничивает зарезервированный буфер нативным лимитом (и остатком квоты)
+ * и прерывает компиляцию, если код в него не влез (ESPB_ERR_JIT_CODE_TOO_LARGE)
+ * или вышло время (ESPB_ERR_JIT_TIMEOUT). Отклонённая функция навсегда остаётся
+ * в интерпретаторе, причина - в body->jit_reject (ESPB_JIT_REJECT_*).
+ */
+
+// Проверка часов раз в столько инструкций байт-кода
+#define ESPB_JIT_DEADLINE_STRIDE 64u
+
+/**
+ * @brief Сколько байт нативного кода может получить следующая функция экземпляра.
+ * @param out_quota_bound true - лимит задан остатком квоты, а не ESPB_JIT_MAX_NATIVE_SIZE.
+ * @return SIZE_MAX - без лимита.
+ */
+static inline size_t espb_jit_native_limit(const EspbInstance *instance, bool *out_quota_bound) {
+    size_t limit = CONFIG_ESPB_JIT_MAX_NATIVE_SIZE > 0 ? (size_t)CONFIG_ESPB_JIT_MAX_NATIVE_SIZE : SIZE_MAX;
+    bool quota_bound = false;
+#if CONFIG_ESPB_JIT_IRAM_QUOTA > 0
+    size_t used = instance->jit_cache ? instance->jit_cache->used_bytes : 0;
+    size_t left = used < (size_t)CONFIG_ESPB_JIT_IRAM_QUOTA ? (size_t)CONFIG_ESPB_JIT_IRAM_QUOTA - used : 0;
+    if (left < limit) {
+        limit = left;
+        quota_bound = true;
+    }
+#else
+    (void)instance;
+#endif
+    if (out_quota_bound) *out_quota_bound = quota_bound;
+    return limit;
+}
+
+// Срок окончания компиляции, начатой сейчас (мкс esp_timer); 0 - без лимита
+static inline int64_t espb_jit_deadline_start(void) {
+#if CONFIG_ESPB_JIT_MAX_COMPILE_TIME_MS > 0
+    return esp_timer_get_time() + (int64_t)CONFIG_ESPB_JIT_MAX_COMPILE_TIME_MS * 1000;
+#else
+    return 0;
+#endif
+}
+
+// insn_count - номер инструкции байт-кода: часы читаются раз в ESPB_JIT_DEADLINE_STRIDE
+static inline bool espb_jit_deadline_passed(int64_t deadline, uint32_t insn_count) {
+    if (deadline == 0 || (insn_count % ESPB_JIT_DEADLINE_STRIDE) != 0) return false;
+    return esp_timer_get_time() > deadline;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPB_JIT_BUDGET_H
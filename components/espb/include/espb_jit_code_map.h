@@ -0,0 +1,90 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef ESPB_JIT_CODE_MAP_H
+#define ESPB_JIT_CODE_MAP_H
+
+#include "espb_interpreter_common_types.h"
+#include "espb_api.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Карта JIT-кода (CONFIG_ESPB_JIT_CODE_MAP).
+ *
+ * Общий для всех экземпляров список нативных диапазонов опубликованных функций:
+ * модуль, индекс, имя экспорта и карта смещений байт-кода (EspbJitPcMap). Записи
+ * добавляет и удаляет JIT cache вместе с кодом. Список читается без блокировок,
+ * поэтому им пользуется и обработчик паники (CONFIG_ESPB_JIT_CODE_MAP_PANIC).
+ */
+
+// Бэкенды строят карты смещений для сэмплера и для карты кода
+#if CONFIG_ESPB_SAMPLER || CONFIG_ESPB_JIT_CODE_MAP
+#define ESPB_JIT_PC_MAPS 1
+#else
+#define ESPB_JIT_PC_MAPS 0
+#endif
+
+// Карта JIT-кода функции: нативное смещение -> смещение инструкции в байт-коде
+typedef struct {
+    uint32_t native_offset;
+    uint32_t bc_offset;
+} EspbJitPcMapEntry;
+
+struct EspbJitPcMap {
+    uint32_t num_entries;
+    EspbJitPcMapEntry entries[];    // По возрастанию native_offset
+};
+
+#if ESPB_JIT_PC_MAPS
+
+/**
+ * @brief Создаёт карту из пар (nat, bc) в любом порядке (одно выделение, освобождается free).
+ * entries сортируется на месте; из пар с одинаковым native_offset остаётся последняя
+ * по байт-коду (NOP не порождают кода). @return NULL, если пар нет или не хватило памяти.
+ */
+EspbJitPcMap *espb_jit_pc_map_create(EspbJitPcMapEntry *entries, size_t num_entries);
+
+/**
+ * @brief Смещение байт-кода инструкции, которой принадлежит нативное смещение.
+ * Код до первой инструкции (пролог) относится к смещению 0.
+ */
+uint32_t espb_jit_pc_map_lookup(const EspbJitPcMap *map, uint32_t native_offset);
+
+#endif // ESPB_JIT_PC_MAPS
+
+#if CONFIG_ESPB_JIT_CODE_MAP
+
+// Регистрация кода функции local_func_idx модуля (вызывает JIT cache)
+void espb_jit_code_map_add(const EspbModule *module, uint32_t local_func_idx, const void *code, size_t code_size);
+// Снимает запись до освобождения кода
+void espb_jit_code_map_remove(const void *code);
+
+// Реализация espb_jit_code_lookup/espb_jit_code_map_write из espb_api.h
+bool espb_jit_code_map_lookup(uintptr_t pc, espb_jit_code_info_t *out);
+void espb_jit_code_map_write_all(espb_sampler_write_t write, void *user_data, bool with_offsets);
+
+#endif // CONFIG_ESPB_JIT_CODE_MAP
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPB_JIT_CODE_MAP_H
@@ -48,6 +48,17 @@ EspbResult espb_execute_function(EspbInstance *instance, ExecutionContext *exec_
  */
 EspbResult espb_execute_function_jit_only(EspbInstance *instance, ExecutionContext *exec_ctx, uint32_t func_idx, const Value *args, Value *results);
 
+/**
+ * @brief Выполняет функцию count раз подряд: аргументы i-го вызова - args + i * stride,
+ * результат - results[i] (results может быть NULL).
+ *
+ * Функция и её JIT-код разрешаются один раз; пока кода нет, вызовы идут через
+ * espb_execute_function (компиляция HOT-функции, tier-up), а после его появления
+ * остаток пакета исполняется в одном кадре регистров без повторных проверок.
+ * Первая ошибка прерывает пакет.
+ */
+EspbResult espb_execute_function_batch(EspbInstance *instance, ExecutionContext *exec_ctx, uint32_t func_idx,
+                                       const Value *args, size_t stride, size_t count, Value *results);
 
 /**
  * @brief Заглушка для выполнения скомпилированного JIT-кода.
@@ -59,9 +70,64 @@ EspbResult espb_execute_function_jit_only(EspbInstance *instance, ExecutionConte
  * @param args Указатель на массив аргументов.
  * @param results Указатель на Value для сохранения результата.
  * @param frame_size Размер стекового кадра, который нужно выделить.
+ * @param zero_init_regs Сколько регистров (с R0) обнулить; остальные не читаются до записи.
  * @return EspbResult Код результата выполнения.
  */
-EspbResult execute_jit_code(EspbInstance *instance, void *jit_code, const Value *args, uint8_t num_args, Value *results, uint16_t frame_size);
+EspbResult execute_jit_code(EspbInstance *instance, void *jit_code, const Value *args, uint8_t num_args, Value *results, uint16_t frame_size, uint16_t zero_init_regs);
+
+#if CONFIG_ESPB_JIT_ENABLED
+/**
+ * @brief Компилирует локальную функцию и атомарно публикует jit_code / is_jit_compiled.
+ *
+ * Компиляцию функции захватывает ровно одна задача (jit_state NONE -> COMPILING), компиляции
+ * разных функций сериализуются instance_mutex, поэтому функцию можно вызывать как из
+ * интерпретатора, так и из фоновой задачи JIT (CONFIG_ESPB_JIT_BACKGROUND).
+ * Если функция уже скомпилирована, возвращает ESPB_OK и *out_size = 0; если её компилирует
+ * другая задача - ESPB_ERR_JIT_BUSY (вызывающий уходит в интерпретатор или ждёт публикации).
+ * Неудачная компиляция (кроме нехватки памяти) не повторяется.
+ *
+ * @param out_size Размер нового кода в байтах (может быть NULL).
+ */
+EspbResult espb_jit_compile_and_publish(EspbInstance *instance, uint32_t local_func_idx, size_t *out_size);
+
+/**
+ * @brief Публикует готовый код функции и переводит jit_state в READY.
+ *
+ * Вызывающий владеет захватом компиляции (jit_state == COMPILING) и передаёт владение
+ * code, osr, pc_map и relocs телу функции. Используется также горячей заменой модуля
+ * (espb_jit_reload.h) для кода, перенесённого из старой версии.
+ */
+void espb_jit_publish(EspbInstance *instance, uint32_t local_func_idx, void *code, size_t code_size,
+                      EspbJitOsrInfo *osr, EspbJitPcMap *pc_map, EspbJitRelocs *relocs);
+#endif
+
+#if CONFIG_ESPB_JIT_TIERED
+/**
+ * @brief Добавляет weight к счётчику горячести функции.
+ * @return true, если достигнут порог CONFIG_ESPB_JIT_TIER_UP_THRESHOLD (нужно вызвать espb_jit_tier_up).
+ */
+static inline bool espb_jit_tier_up_tick(EspbFunctionBody *body, uint32_t weight) {
+    body->tier_up_counter += weight;
+    return __builtin_expect(body->tier_up_counter >= CONFIG_ESPB_JIT_TIER_UP_THRESHOLD, 0);
+}
+
+/**
+ * @brief Компилирует функцию, достигшую порога, и помечает её как HOT (tier_up_hot).
+ *
+ * Сбрасывает счётчик. Учитывает бюджет CONFIG_ESPB_JIT_TIER_UP_IRAM_BUDGET; при ошибке
+ * компиляции или исчерпании бюджета функция больше не предлагается к tier-up.
+ *
+ * @return true, если функция теперь имеет JIT-код.
+ */
+bool espb_jit_tier_up(EspbInstance *instance, uint32_t local_func_idx);
+
+/**
+ * @brief Синхронная часть tier-up: проверка бюджета, компиляция, пометка tier_up_hot.
+ *
+ * Вызывается из espb_jit_tier_up или из фоновой задачи JIT.
+ */
+bool espb_jit_tier_up_compile(EspbInstance *instance, uint32_t local_func_idx);
+#endif
 
 
 #ifdef __cplusplus
@@ -25,6 +25,24 @@
 extern "C" {
 #endif
 
+/**
+ * @brief Размер глобала, к которому JIT-код обращается без helper'а, иначе 0.
+ *
+ * Глобалы CONST/ZERO лежат в instance->globals_data по смещению global_offsets[idx]:
+ * база не меняется, пока жив экземпляр, а раскладка одна для всех экземпляров модуля.
+ * Код читает базу из экземпляра, поэтому годится и для разделяемых модулей, и для
+ * снимков JIT-кода. Глобалы в линейной памяти (DATA_OFFSET), V128 и запись в
+ * неизменяемый глобал идут через helper'ы ниже.
+ */
+static inline uint8_t espb_jit_global_direct_size(const EspbModule* module, uint16_t global_idx, bool store) {
+    if (global_idx >= module->num_globals) return 0;
+    const EspbGlobalDesc* g = &module->globals[global_idx];
+    if (g->init_kind != ESPB_INIT_KIND_CONST && g->init_kind != ESPB_INIT_KIND_ZERO) return 0;
+    if (store && !g->mutability) return 0;
+    if (g->type == ESPB_TYPE_UNKNOWN || g->type >= ESPB_TYPE_V128) return 0;
+    return value_size_map[g->type];
+}
+
 // Writes result into v_regs[rd]
 void espb_jit_ld_global_addr(EspbInstance* instance, uint16_t symbol_idx, Value* v_regs, uint16_t num_virtual_regs, uint8_t rd);
 void espb_jit_ld_global(EspbInstance* instance, uint16_t global_idx, Value* v_regs, uint16_t num_virtual_regs, uint8_t rd);
@@ -28,10 +28,11 @@ extern "C" {
  * @brief JIT helper for ALLOCA opcode (0x8F).
  * Allocates memory on heap with alignment, tracks via RuntimeFrame, frees on function exit.
  */
-void espb_jit_alloca(EspbInstance *instance, Value *v_regs, uint8_t rd, uint8_t rs_size, uint8_t align);
+EspbResult espb_jit_alloca(EspbInstance *instance, Value *v_regs, uint8_t rd, uint8_t rs_size, uint8_t align);
 
 // Extended ABI: num_regs_allocated must match actual length of v_regs array.
-void espb_jit_alloca_ex(EspbInstance *instance, Value *v_regs, uint16_t num_regs_allocated,
+// Returns ESPB_OK or the espb_runtime_alloca error (rd is then NULL); JIT code traps on non-zero.
+EspbResult espb_jit_alloca_ex(EspbInstance *instance, Value *v_regs, uint16_t num_regs_allocated,
                         uint8_t rd, uint8_t rs_size, uint8_t align);
 
 #ifdef __cplusplus
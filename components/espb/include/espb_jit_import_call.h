@@ -42,6 +42,21 @@ void espb_jit_call_import(EspbInstance *instance,
                           uint8_t num_total_args,
                           const uint8_t *arg_types_u8);
 
+/**
+ * @brief Можно ли вызвать импорт из JIT-кода напрямую, минуя espb_jit_call_import.
+ *
+ * true, если импорт — функция с разрешённым адресом, без cbmeta-колбэков
+ * (при FEATURE_CALLBACK_AUTO) и без immeta-маршалинга. Вариадический вызов (0xAA)
+ * проверяет сам backend. ABI-ограничения на типы аргументов тоже на стороне backend'а.
+ *
+ * @param out_sig  Сигнатура импорта (если не NULL)
+ * @param out_fptr Адрес нативной функции (если не NULL)
+ */
+bool espb_jit_import_can_call_direct(const EspbInstance *instance,
+                                     uint16_t import_idx,
+                                     const EspbFuncSignature **out_sig,
+                                     void **out_fptr);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,87 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef ESPB_JIT_OSR_H
+#define ESPB_JIT_OSR_H
+
+#include "espb_interpreter_common_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * On-stack replacement: продолжение вызова, начатого в интерпретаторе, в JIT-коде.
+ *
+ * Вход возможен только в заголовках циклов (целях обратных переходов), где кодогенератор
+ * держит все vreg в v_regs[] (и закреплённых регистрах, загружаемых трамплином).
+ * Компилятор дописывает после тела функции вход-трамплин
+ *     void stub(EspbInstance *instance, Value *v_regs, void *target)
+ * который строит тот же кадр, что и пролог функции, и прыгает на target. Эпилог функции
+ * общий, поэтому результат, как и при обычном вызове, возвращается в v_regs[0].
+ */
+
+typedef struct {
+    uint32_t bc_offset;         // Смещение заголовка цикла в байт-коде
+    uint32_t native_offset;     // Куда прыгает трамплин, от начала jit_code
+} EspbJitOsrPoint;
+
+struct EspbJitOsrInfo {
+    uint32_t stub_offset;       // Вход-трамплин, от начала jit_code
+    uint32_t num_points;
+    EspbJitOsrPoint points[];   // По возрастанию bc_offset
+};
+
+#if CONFIG_ESPB_JIT_OSR || CONFIG_ESPB_FUEL
+
+/**
+ * @brief Собирает заголовки циклов: цели обратных BR/BR_IF/BR_TABLE.
+ * Нужны и OSR, и учёту топлива в JIT-коде (espb_fuel.h).
+ *
+ * @return Отсортированный массив без повторов (освобождается free) или NULL, если
+ *         циклов нет либо не хватило памяти. *out_count - число элементов.
+ */
+uint32_t *espb_jit_osr_scan_headers(const uint8_t *code, size_t code_size, size_t *out_count);
+
+#endif // CONFIG_ESPB_JIT_OSR || CONFIG_ESPB_FUEL
+
+#if CONFIG_ESPB_JIT_OSR
+
+/**
+ * @brief Создаёт таблицу OSR-точек скомпилированной функции (одно выделение, освобождается free).
+ * @return NULL, если точек нет или не хватило памяти.
+ */
+EspbJitOsrInfo *espb_jit_osr_info_create(uint32_t stub_offset, const EspbJitOsrPoint *points, size_t num_points);
+
+/**
+ * @brief Переносит вызов из интерпретатора в JIT-код body на заголовке цикла bc_offset.
+ *
+ * locals - регистры интерпретатора (num_virtual_regs штук); после возврата из JIT-кода
+ * locals[0] содержит результат функции, и интерпретатору остаётся выполнить END.
+ *
+ * @return false, если в bc_offset нет OSR-точки: интерпретатор продолжает цикл сам.
+ */
+bool espb_jit_osr_enter(EspbInstance *instance, const EspbFunctionBody *body, uint32_t bc_offset,
+                        Value *locals, uint16_t num_virtual_regs);
+
+#endif // CONFIG_ESPB_JIT_OSR
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPB_JIT_OSR_H
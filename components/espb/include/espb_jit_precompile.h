@@ -55,6 +55,18 @@ EspbResult espb_jit_precompile_hot_functions(EspbInstance* instance, espb_jit_pr
  */
 EspbResult espb_jit_precompile_function(EspbInstance* instance, uint32_t func_idx);
 
+/**
+ * @brief Готовит функцию к интерпретации без JIT-компиляции
+ *
+ * С CONFIG_ESPB_LAZY_FUNCTIONS выполняет проверку, оптимизацию и трансляцию тела,
+ * которые иначе произошли бы при первом вызове. Без этой опции ничего не делает.
+ *
+ * @param instance Экземпляр ESPB модуля
+ * @param func_idx Глобальный индекс функции (включая импорты)
+ * @return ESPB_OK в случае успеха, ESPB_ERR_INVALID_CODE_SECTION если тело не прошло проверку
+ */
+EspbResult espb_jit_precompile_prepare(EspbInstance* instance, uint32_t func_idx);
+
 /**
  * @brief Предварительно компилирует функцию по имени (если есть экспорт)
  * 
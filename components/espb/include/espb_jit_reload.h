@@ -0,0 +1,53 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef ESPB_JIT_RELOAD_H
+#define ESPB_JIT_RELOAD_H
+
+#include "espb_interpreter_common_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if CONFIG_ESPB_JIT_RELOAD
+
+/**
+ * @brief Переносит JIT-код неизменившихся функций old_instance в new_instance.
+ *
+ * Функции сопоставляются по хэшу: байт-код тела плюс всё, что JIT встраивает в код как
+ * константы (сигнатуры функции и вызываемых, тела встраиваемых callee, имена и типы
+ * импортов, типы CALL_INDIRECT, смещения глобалов). Индекс функции в хэш не входит:
+ * функция, сдвинутая в новой версии, тоже переносится. Код копируется в исполняемую
+ * память new_instance, helper-вызовы перелинковываются (EspbFunctionBody::jit_relocs).
+ * Код без списка релокаций (неполный список, Xtensa) не переносится.
+ *
+ * Ни один из экземпляров не должен исполнять код во время переноса.
+ *
+ * @param out_carried Сколько функций перенесено (может быть NULL).
+ * @return ESPB_OK; ошибка выделения памяти прекращает перенос, оставшиеся функции
+ *         компилируются как обычно.
+ */
+EspbResult espb_jit_reload_carry(EspbInstance *old_instance, EspbInstance *new_instance, uint32_t *out_carried);
+
+#endif // CONFIG_ESPB_JIT_RELOAD
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPB_JIT_RELOAD_H
@@ -0,0 +1,86 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef ESPB_JIT_SNAPSHOT_H
+#define ESPB_JIT_SNAPSHOT_H
+
+#include "espb_interpreter_common_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Релокация в JIT-коде: пара auipc+jalr по native_offset вызывает абсолютный адрес target.
+typedef struct {
+    uint32_t native_offset;
+    uint32_t target;
+} EspbJitReloc;
+
+// Релокации опубликованного кода функции (EspbFunctionBody::jit_relocs, освобождается free)
+struct EspbJitRelocs {
+    uint32_t count;
+    EspbJitReloc entries[];
+};
+
+#if CONFIG_ESPB_JIT_SNAPSHOT || CONFIG_ESPB_JIT_RELOAD
+
+/**
+ * @brief Перекодирует пару auipc+jalr по rel->native_offset под текущий адрес code.
+ */
+void espb_jit_reloc_apply(uint8_t *code, const EspbJitReloc *rel);
+
+/**
+ * @brief Копирует список релокаций в EspbJitRelocs (освобождается free).
+ * @return NULL при нехватке памяти.
+ */
+EspbJitRelocs *espb_jit_relocs_create(const EspbJitReloc *relocs, size_t count);
+
+#endif
+
+#if CONFIG_ESPB_JIT_SNAPSHOT
+
+/**
+ * @brief Открывает раздел снимка JIT-кода и строит индекс записей текущего модуля.
+ *
+ * Ключ записи - хэш буфера модуля, SHA прошивки и индекс функции. Если в разделе есть записи
+ * другой прошивки (адреса helper'ов изменились), раздел стирается целиком.
+ * Отсутствие раздела не является ошибкой: снимок просто не используется.
+ */
+EspbResult espb_jit_snapshot_open(EspbInstance *instance);
+void espb_jit_snapshot_close(EspbInstance *instance);
+
+/**
+ * @brief Загружает код функции из снимка в исполняемую память и применяет релокации.
+ * @param out_relocs Если не NULL, получает копию релокаций записи (может остаться NULL).
+ * @return ESPB_OK при успехе; иначе функцию нужно скомпилировать.
+ */
+EspbResult espb_jit_snapshot_load(EspbInstance *instance, uint32_t func_idx, void **out_code, size_t *out_size,
+                                  EspbJitRelocs **out_relocs);
+
+/**
+ * @brief Дописывает скомпилированный код функции в снимок (если записи ещё нет).
+ */
+void espb_jit_snapshot_store(EspbInstance *instance, uint32_t func_idx, const void *code, size_t code_size,
+                             const EspbJitReloc *relocs, size_t num_relocs);
+
+#endif // CONFIG_ESPB_JIT_SNAPSHOT
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPB_JIT_SNAPSHOT_H
@@ -0,0 +1,115 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef ESPB_JIT_STATS_H
+#define ESPB_JIT_STATS_H
+
+#include "espb_interpreter_common_types.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Счётчики JIT одной локальной функции
+typedef struct {
+    uint32_t compile_time_us;   // Время последней успешной компиляции
+    uint16_t helper_calls;      // Места вызова C-helper'ов в коде
+    uint16_t abs_helper_calls;  // Из них через абсолютный адрес (вне досягаемости PC-relative)
+    uint16_t spills;            // Сохранения закреплённых регистров в кадр v_regs
+    uint16_t compiles;          // Успешные компиляции (больше 1 - после вытеснения)
+    uint32_t fallbacks;         // Вызовы HOT-функции, обслуженные интерпретатором
+    uint32_t exec_count;        // Входы в JIT-код через диспетчер, колбэки и OSR
+} EspbJitFuncStats;
+
+// Статистика JIT инстанса. Счётчики исполнения не атомарны, как у профилировщика.
+struct EspbJitStats {
+    uint32_t num_functions;
+    EspbJitFuncStats *funcs;        // [num_functions], индекс - локальный индекс функции
+    uint32_t compile_failures;      // Компиляции, завершившиеся ошибкой (кроме нехватки памяти)
+    uint32_t evictions;             // Функции, вытесненные из JIT cache
+    uint64_t compile_time_us;       // Суммарное время успешных компиляций
+};
+
+// Выделяет instance->jit_stats (только с CONFIG_ESPB_JIT_STATS; иначе ничего не делает).
+EspbResult espb_jit_stats_init(EspbInstance *instance);
+void espb_jit_stats_free(EspbInstance *instance);
+void espb_jit_stats_clear(EspbJitStats *stats);
+
+#if CONFIG_ESPB_JIT_STATS
+
+static inline EspbJitFuncStats *espb_jit_stats_func(EspbInstance *instance, uint32_t func_idx) {
+    EspbJitStats *stats = instance->jit_stats;
+    uint32_t local = func_idx - instance->module->num_imported_funcs;
+    return (stats && local < stats->num_functions) ? &stats->funcs[local] : NULL;
+}
+
+// count входов в JIT-код функции func_idx (глобальный индекс)
+static inline void espb_jit_stats_exec(EspbInstance *instance, uint32_t func_idx, uint32_t count) {
+    EspbJitFuncStats *fs = espb_jit_stats_func(instance, func_idx);
+    if (fs) fs->exec_count += count;
+}
+
+// HOT-функция исполнена интерпретатором (кода нет: компилируется, не удалась, в очереди)
+static inline void espb_jit_stats_fallback(EspbInstance *instance, uint32_t func_idx) {
+    EspbJitFuncStats *fs = espb_jit_stats_func(instance, func_idx);
+    if (fs) fs->fallbacks++;
+}
+
+// Успешная компиляция функции func_idx за time_us
+static inline void espb_jit_stats_compiled(EspbInstance *instance, uint32_t func_idx, uint32_t time_us) {
+    EspbJitFuncStats *fs = espb_jit_stats_func(instance, func_idx);
+    if (!fs) return;
+    fs->compile_time_us = time_us;
+    if (fs->compiles < UINT16_MAX) fs->compiles++;
+    instance->jit_stats->compile_time_us += time_us;
+}
+
+static inline void espb_jit_stats_compile_failed(EspbInstance *instance) {
+    if (instance->jit_stats) instance->jit_stats->compile_failures++;
+}
+
+static inline void espb_jit_stats_evicted(EspbInstance *instance) {
+    if (instance->jit_stats) instance->jit_stats->evictions++;
+}
+
+// Вызывается backend'ом после успешной генерации кода функции func_idx
+static inline void espb_jit_stats_codegen(EspbInstance *instance, uint32_t func_idx, uint32_t helper_calls,
+                                          uint32_t abs_helper_calls, uint32_t spills) {
+    EspbJitFuncStats *fs = espb_jit_stats_func(instance, func_idx);
+    if (!fs) return;
+    fs->helper_calls = helper_calls > UINT16_MAX ? UINT16_MAX : (uint16_t)helper_calls;
+    fs->abs_helper_calls = abs_helper_calls > UINT16_MAX ? UINT16_MAX : (uint16_t)abs_helper_calls;
+    fs->spills = spills > UINT16_MAX ? UINT16_MAX : (uint16_t)spills;
+}
+
+#else
+
+#define espb_jit_stats_exec(instance, func_idx, count) do { } while (0)
+#define espb_jit_stats_fallback(instance, func_idx) do { } while (0)
+#define espb_jit_stats_compiled(instance, func_idx, time_us) do { } while (0)
+#define espb_jit_stats_compile_failed(instance) do { } while (0)
+#define espb_jit_stats_evicted(instance) do { } while (0)
+#define espb_jit_stats_codegen(instance, func_idx, helper_calls, abs_helper_calls, spills) do { } while (0)
+
+#endif // CONFIG_ESPB_JIT_STATS
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPB_JIT_STATS_H
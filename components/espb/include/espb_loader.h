@@ -0,0 +1,86 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef ESPB_LOADER_H
+#define ESPB_LOADER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "espb_interpreter_common_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Потоковый загрузчик модуля (OTA по HTTP/BLE): файл .espb подаётся кусками любого
+// размера, без буферизации всего файла.
+//
+// По заголовку и таблице секций загрузчик узнаёт размер модуля и сразу выделяет
+// окончательное место: буфер в RAM или область data-раздела flash. Дальнейшие куски
+// пишутся прямо туда, а каждая секция разбирается, как только получена целиком.
+// Ошибка в модуле обнаруживается на той секции, где она есть, а не после загрузки.
+typedef struct EspbLoader* espb_loader_t;
+
+/**
+ * @brief Начинает потоковую загрузку.
+ *
+ * @param partition_label Метка data-раздела, в который записывается модуль, или NULL -
+ *                        модуль собирается в RAM. Раздел стирается по мере записи.
+ * @param out_loader Указатель для сохранения загрузчика.
+ * @return ESPB_OK, ESPB_ERR_MEMORY_ALLOC, или ESPB_ERR_INVALID_STATE если раздел не найден.
+ */
+EspbResult espb_loader_begin(const char *partition_label, espb_loader_t *out_loader);
+
+/**
+ * @brief Передаёт очередной кусок файла.
+ *
+ * Ошибка запоминается: следующие вызовы и espb_loader_finish возвращают её же.
+ * Байты после конца модуля (выравнивание транспорта) игнорируются.
+ *
+ * @param loader Загрузчик.
+ * @param data Данные куска.
+ * @param len Размер куска в байтах.
+ * @return ESPB_OK, или код ошибки разбора/записи.
+ */
+EspbResult espb_loader_feed(espb_loader_t loader, const uint8_t *data, size_t len);
+
+/**
+ * @brief Завершает загрузку и отдаёт разобранный модуль (ссылка вызывающей стороны,
+ * снимается espb_module_release). Буфер модуля освобождается вместе с ним.
+ * Загрузчик освобождается в любом случае.
+ *
+ * Обёртки espb_loader_finish / espb_loader_finish_module в espb_api.h сразу
+ * инстанцируют модуль или делают его разделяемым.
+ *
+ * @param loader Загрузчик.
+ * @param out_module Указатель для сохранения модуля.
+ * @return ESPB_OK, ESPB_ERR_BUFFER_TOO_SMALL если файл получен не полностью, или код ошибки.
+ */
+EspbResult espb_loader_take_module(espb_loader_t loader, EspbModule **out_module);
+
+/**
+ * @brief Прерывает загрузку и освобождает загрузчик вместе с частично разобранным модулем.
+ *
+ * @param loader Загрузчик (может быть NULL).
+ */
+void espb_loader_abort(espb_loader_t loader);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPB_LOADER_H
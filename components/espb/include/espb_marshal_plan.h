@@ -0,0 +1,114 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef ESPB_MARSHAL_PLAN_H
+#define ESPB_MARSHAL_PLAN_H
+
+#include "espb_interpreter_common_types.h"
+
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Планы маршалинга immeta для CALL_IMPORT.
+ *
+ * При инстанцировании записи immeta каждого импорта компилируются в массив операций
+ * по аргументам: copy-in, copy-out и источник размера буфера (константа, регистр
+ * аргумента или strlen строки-аргумента). Интерпретатор и JIT-хелпер CALL_IMPORT берут
+ * план по индексу импорта и не ищут записи в метаданных модуля на каждом вызове.
+ */
+
+#define ESPB_MARSHAL_OP_COPY_IN   0x01  // Совпадает с ESPB_IMMETA_DIRECTION_IN
+#define ESPB_MARSHAL_OP_COPY_OUT  0x02  // Совпадает с ESPB_IMMETA_DIRECTION_OUT
+#define ESPB_MARSHAL_OP_ASYNC     0x04  // handler 1: OUT копирует async wrapper после завершения
+
+#define ESPB_MARSHAL_MAX_OPS 16
+
+typedef struct {
+    uint8_t arg;          // Индекс аргумента импорта
+    uint8_t flags;        // ESPB_MARSHAL_OP_*
+    uint8_t size_kind;    // ESPB_IMMETA_SIZE_KIND_*
+    uint8_t size_value;   // Константа или индекс аргумента-источника размера
+} EspbMarshalOp;
+
+struct EspbMarshalPlan {
+    const EspbMarshalOp *ops;     // По одной операции на аргумент, в порядке immeta
+    uint8_t num_ops;              // 0 - у импорта нет маршалинга
+    bool has_async_out;           // Есть OUT-аргумент с async-обработчиком
+};
+
+// Временные буферы одного вызова со стандартным маршалингом
+typedef struct {
+    void *temp[ESPB_MARSHAL_MAX_OPS];
+    void *original[ESPB_MARSHAL_MAX_OPS];
+    uint32_t size[ESPB_MARSHAL_MAX_OPS];
+} EspbMarshalFrame;
+
+/**
+ * @brief План импорта или NULL, если маршалинга нет.
+ */
+static inline const EspbMarshalPlan *espb_marshal_plan(const EspbInstance *instance, uint16_t import_idx) {
+    if (!instance->import_marshal) return NULL;
+    const EspbMarshalPlan *plan = &instance->import_marshal[import_idx];
+    return plan->num_ops ? plan : NULL;
+}
+
+static inline uint32_t espb_marshal_op_size(const EspbMarshalOp *op, const Value *args, uint32_t num_args) {
+    switch (op->size_kind) {
+        case ESPB_IMMETA_SIZE_KIND_CONST:
+            return op->size_value;
+        case ESPB_IMMETA_SIZE_KIND_FROM_ARG:
+            if (op->size_value < num_args) return (uint32_t)V_I32(args[op->size_value]);
+            return 32; // Fallback
+        case ESPB_IMMETA_SIZE_KIND_NULL_TERMINATED:
+            if (op->size_value < num_args) {
+                const char *src_str = (const char *)V_PTR(args[op->size_value]);
+                if (src_str) return (uint32_t)(strlen(src_str) + 1);
+            }
+            return 32; // Fallback if source is invalid
+        default:
+            return 32; // Fallback
+    }
+}
+
+// Строит планы всех импортов модуля (при инстанцировании и клонировании).
+EspbResult espb_marshal_plans_init(EspbInstance *instance);
+void espb_marshal_plans_free(EspbInstance *instance);
+
+/**
+ * @brief Стандартный маршалинг (handler 0) перед вызовом: буфер под каждый аргумент плана,
+ * copy-in для IN или обнуление для OUT, подмена arg_values[arg] на указатель на буфер.
+ *
+ * Исходный указатель берётся из *(void **)arg_values[arg], т.е. уже в нативном виде.
+ * @return ESPB_ERR_MEMORY_ALLOC, если буфер не выделен (выделенные ранее освобождены).
+ */
+EspbResult espb_marshal_begin(const EspbMarshalPlan *plan, const Value *args, uint32_t num_args,
+                              void **arg_values, EspbMarshalFrame *frame);
+
+/**
+ * @brief copy-out OUT-аргументов в исходные буферы и освобождение временных.
+ */
+void espb_marshal_end(const EspbMarshalPlan *plan, EspbMarshalFrame *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPB_MARSHAL_PLAN_H
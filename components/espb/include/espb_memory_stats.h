@@ -0,0 +1,53 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef ESPB_MEMORY_STATS_H
+#define ESPB_MEMORY_STATS_H
+
+#include "espb_interpreter_common_types.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Учёт памяти экземпляра: текущие байты считаются по его буферам при запросе, пики
+// фиксируются в точках роста (инстанцирование, MEMORY.GROW, регион кучи, JIT-код,
+// async wrapper) и при каждом запросе. Каждый буфер относится к PSRAM или внутренней
+// DRAM по адресу; JIT-код и замыкания libffi - к исполняемой памяти.
+
+// Текущее потребление по видам EspbMemKind. Общий JIT cache разделяемого модуля
+// входит в каждый его экземпляр; память, импортированная у хоста (env.memory), не входит.
+void espb_memory_usage(const EspbInstance *instance, size_t usage[ESPB_MEM_NUM_KINDS]);
+
+// Пересчитывает потребление и обновляет instance->mem_peak. Холодный путь.
+void espb_memory_note_peak(EspbInstance *instance);
+
+// Куча гостя по всем регионам: занято и свободно сейчас, занято в пике (с метаданными multi_heap)
+void espb_memory_heap_usage(const EspbInstance *instance, size_t *out_used, size_t *out_free, size_t *out_peak);
+
+// Переносит пик теневого стека контекста в экземпляр (перед сбросом контекста)
+static inline void espb_memory_note_shadow_stack(EspbInstance *instance, const ExecutionContext *ctx) {
+    if (instance && ctx->shadow_peak_bytes > instance->shadow_stack_peak) {
+        instance->shadow_stack_peak = ctx->shadow_peak_bytes;
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPB_MEMORY_STATS_H
@@ -0,0 +1,87 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef ESPB_MODULE_ARENA_H
+#define ESPB_MODULE_ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Арена разобранного модуля: все таблицы (сигнатуры, тела функций, импорты, экспорты,
+// сегменты, метаданные) и сама структура EspbModule размещаются в одном блоке, размер
+// которого парсер оценивает заранее по таблице секций. Загрузка - одно выделение,
+// выгрузка - одно освобождение; отдельных free по таблицам нет.
+//
+// Блок делится на две области: горячую (то, что читает исполнение: сигнатуры, тела,
+// глобалы, func_ptr_map) и холодную (то, что нужно только при инстанцировании и
+// разрешении импортов). С CONFIG_ESPB_MODULE_ARENA_COLD_PSRAM холодная область
+// выделяется отдельно во внешней PSRAM.
+//
+// Если оценка оказалась мала, арена добирает память дополнительными блоками.
+
+typedef enum {
+    ESPB_MODULE_ARENA_HOT = 0,
+    ESPB_MODULE_ARENA_COLD = 1,
+    ESPB_MODULE_ARENA_REGIONS
+} EspbModuleArenaRegionId;
+
+typedef struct EspbModuleArenaChunk {
+    struct EspbModuleArenaChunk *next;
+    size_t size;           // Байт данных после заголовка
+} EspbModuleArenaChunk;
+
+typedef struct {
+    uint8_t *cur;
+    uint8_t *end;
+} EspbModuleArenaRegion;
+
+typedef struct {
+    EspbModuleArenaChunk *chunks;
+    EspbModuleArenaRegion regions[ESPB_MODULE_ARENA_REGIONS];
+    size_t total;          // Байт во всех блоках (для статистики)
+} EspbModuleArena;
+
+/**
+ * @brief Выделяет начальный блок под hot_bytes + cold_bytes.
+ * @return false, если памяти нет.
+ */
+bool espb_module_arena_init(EspbModuleArena *arena, size_t hot_bytes, size_t cold_bytes);
+
+/**
+ * @brief Обнулённая память из области region, выровненная на 8. size == 0 даёт
+ * валидный указатель. Возвращает NULL, только если исчерпана куча.
+ */
+void *espb_module_arena_alloc(EspbModuleArena *arena, EspbModuleArenaRegionId region, size_t size);
+
+bool espb_module_arena_owns(const EspbModuleArena *arena, const void *p);
+
+/**
+ * @brief Освобождает все блоки. Арена может содержать саму себя (EspbModule::arena),
+ * поэтому список блоков снимается до освобождения.
+ */
+void espb_module_arena_destroy(EspbModuleArena *arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPB_MODULE_ARENA_H
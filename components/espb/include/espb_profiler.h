@@ -0,0 +1,93 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef ESPB_PROFILER_H
+#define ESPB_PROFILER_H
+
+#include "espb_interpreter_common_types.h"
+#include "sdkconfig.h"
+
+#if CONFIG_ESPB_PROFILER
+#include "esp_cpu.h"
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Счётчики одной локальной функции
+typedef struct {
+    uint32_t calls;             // Интерпретируемые входы в функцию
+    uint64_t inclusive_cycles;  // Такты с учётом вызванных функций
+    uint64_t exclusive_cycles;  // Такты только в теле функции
+} EspbFuncProfile;
+
+// Профиль инстанса. Счётчики не атомарны: при одновременных вызовах из
+// нескольких задач возможны потерянные инкременты (для профилирования допустимо).
+struct EspbProfile {
+    uint64_t opcode_counts[256];    // Диспетчеризации по опкоду (суперинструкция - по первому опкоду)
+    uint32_t num_functions;
+    EspbFuncProfile *funcs;         // [num_functions], индекс - локальный индекс функции
+};
+
+// Выделяет instance->profile (только с CONFIG_ESPB_PROFILER; иначе ничего не делает).
+EspbResult espb_profile_init(EspbInstance *instance);
+void espb_profile_free(EspbInstance *instance);
+void espb_profile_clear(EspbProfile *profile);
+
+#if CONFIG_ESPB_PROFILER
+
+#define ESPB_PROFILE_OPCODE(instance, op) \
+    do { if ((instance)->profile) (instance)->profile->opcode_counts[(op)]++; } while (0)
+
+// Вход в интерпретируемую функцию: кадр вершины стека вызовов принадлежит ей.
+static inline void espb_profile_enter(EspbInstance *instance, ExecutionContext *ctx, uint32_t local_func_idx) {
+    EspbProfile *prof = instance->profile;
+    if (!prof || ctx->call_stack_top <= 0 || local_func_idx >= prof->num_functions) return;
+    RuntimeFrame *frame = &ctx->call_stack[ctx->call_stack_top - 1];
+    frame->prof_enter_cycles = (uint32_t)esp_cpu_get_cycle_count();
+    frame->prof_child_cycles = 0;
+    prof->funcs[local_func_idx].calls++;
+}
+
+// Выход из функции (END), вызывается до снятия кадра.
+static inline void espb_profile_leave(EspbInstance *instance, ExecutionContext *ctx, uint32_t local_func_idx) {
+    EspbProfile *prof = instance->profile;
+    if (!prof || ctx->call_stack_top <= 0 || local_func_idx >= prof->num_functions) return;
+    RuntimeFrame *frame = &ctx->call_stack[ctx->call_stack_top - 1];
+    uint32_t elapsed = (uint32_t)esp_cpu_get_cycle_count() - frame->prof_enter_cycles;
+    EspbFuncProfile *fp = &prof->funcs[local_func_idx];
+    fp->inclusive_cycles += elapsed;
+    fp->exclusive_cycles += (elapsed > frame->prof_child_cycles) ? (elapsed - frame->prof_child_cycles) : 0;
+    if (ctx->call_stack_top >= 2) {
+        ctx->call_stack[ctx->call_stack_top - 2].prof_child_cycles += elapsed;
+    }
+}
+
+#else
+
+#define ESPB_PROFILE_OPCODE(instance, op) do { } while (0)
+#define espb_profile_enter(instance, ctx, local_func_idx) do { } while (0)
+#define espb_profile_leave(instance, ctx, local_func_idx) do { } while (0)
+
+#endif // CONFIG_ESPB_PROFILER
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPB_PROFILER_H
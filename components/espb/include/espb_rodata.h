@@ -0,0 +1,54 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef ESPB_RODATA_H
+#define ESPB_RODATA_H
+
+#include "espb_interpreter_common_types.h"
+
+#ifndef CONFIG_ESPB_RODATA_IN_PLACE
+#define CONFIG_ESPB_RODATA_IN_PLACE 0
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Нативный адрес смещения offset линейной памяти.
+ *
+ * Смещения внутри сегментов .rodata, оставленных в образе модуля, указывают на их
+ * байты в буфере модуля (flash), остальные - в memory_data. Так вычисляются адреса
+ * DATA_OFFSET-глобалов и релокаций; сами указатели гость дальше использует как есть.
+ */
+static inline uint8_t *espb_data_address(const EspbInstance *instance, uint32_t offset) {
+#if CONFIG_ESPB_RODATA_IN_PLACE
+    for (uint32_t i = 0; i < instance->num_rodata; i++) {
+        const EspbRodataSpan *span = &instance->rodata[i];
+        if (offset - span->start < span->end - span->start) {
+            return (uint8_t *)span->data + (offset - span->start);
+        }
+    }
+#endif
+    return instance->memory_data + offset;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPB_RODATA_H
@@ -20,6 +20,8 @@
 
 #include "espb_interpreter_common_types.h"
 
+#include <string.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -30,6 +32,13 @@ extern "C" {
  * This helper contains no JIT-specific code and can be used by:
  * - interpreter (opcode handler)
  * - JIT backends (RISC-V today, Xtensa in future)
+ *
+ * Memory comes from the context's ALLOCA stack (EspbAllocaStack): a block of
+ * CONFIG_ESPB_ALLOCA_STACK_SIZE bytes of guest heap, so an allocation is a
+ * pointer bump and a frame exit is a store. With exec_ctx == NULL (JIT code has
+ * no ExecutionContext) the calling task's JIT stack is used; every JIT entry and
+ * JIT-to-JIT call brackets the callee with espb_jit_alloca_mark/espb_jit_alloca_restore.
+ * On failure rd is set to NULL and the error is returned (JIT code traps on it).
  */
 EspbResult espb_runtime_alloca(EspbInstance *instance,
                               ExecutionContext *exec_ctx,
@@ -39,6 +48,43 @@ EspbResult espb_runtime_alloca(EspbInstance *instance,
                               uint8_t rs_size,
                               uint8_t align);
 
+// Slow path of espb_alloca_stack_push: takes a block for `instance` (its spare
+// block or a new guest heap allocation).
+EspbResult espb_alloca_stack_attach(EspbAllocaStack *stack, EspbInstance *instance);
+
+// Hands the block back to its instance as the spare; called once sp is back at 0.
+void espb_alloca_stack_detach(EspbAllocaStack *stack);
+
+// Drops every allocation (after a trap left frames behind). The block is handed
+// back only when it belongs to `instance`: another instance may already be freed.
+void espb_alloca_stack_reset(EspbAllocaStack *stack, EspbInstance *instance);
+
+// Zero-filled, `align`-aligned (power of two) block of `size` bytes on top of the stack.
+static inline EspbResult espb_alloca_stack_push(EspbAllocaStack *stack, EspbInstance *instance,
+                                                uint32_t size, uint32_t align, void **out_ptr) {
+    if (__builtin_expect(stack->instance != instance || !stack->base, 0)) {
+        EspbResult res = espb_alloca_stack_attach(stack, instance);
+        if (res != ESPB_OK) return res;
+    }
+    uintptr_t base = (uintptr_t)stack->base;
+    uintptr_t top = (base + stack->sp + align - 1) & ~(uintptr_t)(align - 1);
+    if (top + size > base + stack->size) return ESPB_ERR_STACK_OVERFLOW;
+    stack->sp = (uint32_t)(top + size - base);
+    memset((void *)top, 0, size);
+    *out_ptr = (void *)top;
+    return ESPB_OK;
+}
+
+// Frame exit: frees everything allocated since the frame saved `sp`.
+static inline void espb_alloca_stack_pop(EspbAllocaStack *stack, uint32_t sp) {
+    stack->sp = sp;
+    if (sp == 0 && stack->base) espb_alloca_stack_detach(stack);
+}
+
+// JIT entry points (execute_jit_code, OSR) and JIT-to-JIT calls bracket native code with these.
+uint32_t espb_jit_alloca_mark(void);
+void espb_jit_alloca_restore(uint32_t mark);
+
 #ifdef __cplusplus
 }
 #endif
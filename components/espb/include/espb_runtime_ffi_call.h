@@ -52,6 +52,42 @@ EspbResult espb_runtime_ffi_call(void *fptr,
                                 EspbValueType ret_es_type,
                                 Value *regs);
 
+// Same as espb_runtime_ffi_call, but with an already prepared cif (no ffi_prep_cif per call).
+EspbResult espb_runtime_ffi_call_with_cif(ffi_cif *cif,
+                                         void *fptr,
+                                         void **arg_values,
+                                         EspbValueType ret_es_type,
+                                         Value *regs);
+
+// Cif prepared at instantiation for the fixed signature of a function import, or NULL.
+// Only valid for calls without extended (0xAA / variadic) type info.
+static inline ffi_cif *espb_runtime_import_cif(const EspbInstance *instance, uint16_t import_idx) {
+    if (!instance->import_cifs || import_idx >= instance->module->num_imports) return NULL;
+    ffi_cif *cif = &instance->import_cifs[import_idx];
+    return cif->rtype ? cif : NULL;
+}
+
+// Cif cache for calls with extended (0xAA) type info, e.g. printf/snprintf.
+// A call site always passes the same type blob, so the cif prepared by ffi_prep_cif_var is
+// kept per instance, keyed by (import, nfixedargs, return type, resolved ffi arg types).
+// Entries are never removed before espb_runtime_var_cifs_free; lookups are lock-free.
+#define ESPB_VAR_CIF_BUCKETS     16
+#define ESPB_VAR_CIF_MAX_ENTRIES 64
+
+// Returns the cached ffi_prep_cif_var cif (preparing and inserting it on a miss), or NULL if the cif
+// cannot be prepared or the cache is full - the caller then prepares a cif on its stack.
+ffi_cif *espb_runtime_var_cif(const EspbInstance *instance,
+                              uint16_t import_idx,
+                              uint32_t nfixedargs,
+                              uint32_t nargs,
+                              ffi_type *ret_ffi_type,
+                              ffi_type **arg_types);
+
+EspbResult espb_runtime_var_cifs_init(EspbInstance *instance);
+void espb_runtime_var_cifs_free(EspbInstance *instance);
+// Bytes held by the cif cache (memory accounting, espb_memory_stats.h).
+size_t espb_runtime_var_cifs_bytes(const EspbInstance *instance);
+
 // Low-level helpers (for interpreter which may need prepared cif for wrappers).
 void espb_runtime_ffi_call_prepared(ffi_cif *cif, void *fptr, void *ret_storage, void **arg_values);
 void espb_runtime_store_ffi_ret(Value *regs, uint8_t ret_reg, EspbValueType ret_es_type, const void *ret_storage);
@@ -0,0 +1,72 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef ESPB_SAMPLER_H
+#define ESPB_SAMPLER_H
+
+#include "espb_interpreter_common_types.h"
+#include "espb_api.h"
+#include "espb_jit_code_map.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Сэмплирующий профилировщик (CONFIG_ESPB_SAMPLER).
+ *
+ * Периодический esp_timer раз в период смотрит на целевую задачу:
+ *  - задача вытеснена и её сохранённый PC внутри JIT-кода модуля - отсчёт сразу
+ *    относится к функции и смещению байт-кода по карте EspbJitPcMap (espb_jit_code_map.h);
+ *  - задача исполняется (другое ядро) или её PC вне JIT-кода (интерпретатор,
+ *    helper'ы, FFI) - выставляется instance->sample_pending, и отсчёт снимает
+ *    интерпретатор в ближайшей точке опроса (переход или CALL) вместе со стеком
+ *    интерпретируемых вызовов;
+ *  - задача заблокирована - отсчёт простоя.
+ * Точки опроса - одна проверка байта на переходах и CALL.
+ */
+
+#define ESPB_SAMPLER_MAX_DEPTH 16   // Кадров в сохраняемом стеке (ближайшие к вершине)
+
+#if CONFIG_ESPB_SAMPLER
+
+// Отсчёт в интерпретаторе (холодный путь ESPB_SAMPLE_POINT). offset - начало инструкции
+// в байт-коде или, при threaded, в прошитом потоке функции.
+void espb_sampler_take(EspbInstance *instance, ExecutionContext *exec_ctx, uint32_t local_func_idx,
+                       uint32_t offset, bool threaded);
+
+// Реализация espb_sampler_* из espb_api.h
+EspbResult espb_sampler_start_instance(EspbInstance *instance, TaskHandle_t task, uint32_t period_us);
+EspbResult espb_sampler_stop_instance(EspbInstance *instance);
+void espb_sampler_clear(EspbSampler *s);
+EspbResult espb_sampler_read_totals(const EspbSampler *s, espb_sampler_totals_t *totals, espb_sample_func_t *funcs,
+                                    uint32_t max_funcs, uint32_t *out_num_funcs);
+EspbResult espb_sampler_read_offsets(const EspbSampler *s, espb_sample_offset_t *out, uint32_t max_entries,
+                                     uint32_t *out_num_entries);
+EspbResult espb_sampler_write_folded_stacks(const EspbSampler *s, espb_sampler_write_t write, void *user_data);
+
+#endif // CONFIG_ESPB_SAMPLER
+
+// Останавливает таймер и освобождает instance->sampler.
+void espb_sampler_free(EspbInstance *instance);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPB_SAMPLER_H
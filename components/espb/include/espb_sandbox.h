@@ -0,0 +1,66 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef ESPB_SANDBOX_H
+#define ESPB_SANDBOX_H
+
+#include "espb_interpreter_common_types.h"
+
+#ifndef CONFIG_ESPB_SANDBOX_MASKED
+#define CONFIG_ESPB_SANDBOX_MASKED 0
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if CONFIG_ESPB_SANDBOX_MASKED
+
+/**
+ * @brief Запас за концом линейной памяти под хвост широкого доступа.
+ *
+ * Маска ограничивает только начальный адрес, поэтому 8-байтный доступ по
+ * адресу base + mask может выйти за память не более чем на 7 байт.
+ */
+#define ESPB_SANDBOX_SLACK 8u
+
+/**
+ * @brief Адрес доступа ptr + off, принудительно помещённый в линейную память.
+ *
+ * Линейная память занимает 2^n байт и выровнена на свой размер, поэтому
+ * base | (addr & mask) всегда лежит внутри неё: одна AND и одна OR вместо
+ * проверки границ. Указатель вне памяти не отклоняется, а заворачивается в неё.
+ */
+static inline uint8_t *espb_sandbox_addr(const EspbInstance *instance, const void *ptr, int32_t off) {
+    uintptr_t addr = (uintptr_t)ptr + (uintptr_t)(intptr_t)off;
+    return (uint8_t *)((uintptr_t)instance->memory_data | (addr & instance->memory_mask));
+}
+
+/** @brief Указатель без смещения (атомарные операции), ограниченный линейной памятью. */
+#define ESPB_SANDBOX_PTR(instance, ptr) ((void *)espb_sandbox_addr((instance), (ptr), 0))
+
+#else
+
+#define ESPB_SANDBOX_PTR(instance, ptr) (ptr)
+
+#endif // CONFIG_ESPB_SANDBOX_MASKED
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPB_SANDBOX_H
@@ -0,0 +1,153 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#ifndef ESPB_SIMD_H
+#define ESPB_SIMD_H
+
+#include "espb_interpreter_common_types.h"
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * V128 - префикс 0xFD (FEATURE_SIMD_V128).
+ *
+ * Вектор Vn - пара регистров (Rn, Rn+1), см. EspbV128; n + 1 не больше max_reg_used.
+ * Дорожки little-endian: дорожка k типа T лежит по байтовому смещению k * sizeof(T).
+ *
+ * Форматы (после [0xFD][sub_op]):
+ *   LOAD / STORE:    V, Ra, offset(i16)        адрес V_PTR(Ra) + offset, без выравнивания
+ *   CONST:           Vd, imm[16]
+ *   SPLAT:           Vd, Rs                    младшие 8/16/32 бита Rs во все дорожки
+ *   EXTRACT_LANE:    Rd, Vs, lane
+ *   REPLACE_LANE:    Vd, Va, Rs, lane          Vd = Va с заменённой дорожкой
+ *   SHUFFLE:         Vd, Va, Vb, lanes[16]     lanes[i] < 16 - байт Va, иначе байт Vb
+ *   унарные:         Vd, Va
+ *   бинарные:        Vd, Va, Vb
+ * Vd может совпадать с любым источником.
+ */
+enum {
+    ESPB_V128_LOAD                  = 0x00,
+    ESPB_V128_STORE                 = 0x01,
+    ESPB_V128_CONST                 = 0x02,
+    ESPB_V128_I8X16_SPLAT           = 0x03,
+    ESPB_V128_I16X8_SPLAT           = 0x04,
+    ESPB_V128_I32X4_SPLAT           = 0x05, // и F32X4.SPLAT: биты те же
+    ESPB_V128_I16X8_EXTRACT_LANE_S  = 0x06,
+    ESPB_V128_I32X4_EXTRACT_LANE    = 0x07, // и F32X4.EXTRACT_LANE
+    ESPB_V128_I32X4_REPLACE_LANE    = 0x08,
+    ESPB_V128_I8X16_SHUFFLE         = 0x09,
+
+    ESPB_V128_NOT                   = 0x0C, // унарная
+
+    ESPB_V128_I8X16_ADD             = 0x10,
+    ESPB_V128_I8X16_SUB             = 0x11,
+    ESPB_V128_I8X16_ADD_SAT_S       = 0x12,
+    ESPB_V128_I8X16_SUB_SAT_S       = 0x13,
+    ESPB_V128_I8X16_MIN_S           = 0x14,
+    ESPB_V128_I8X16_MAX_S           = 0x15,
+    ESPB_V128_I8X16_MIN_U           = 0x16,
+    ESPB_V128_I8X16_MAX_U           = 0x17,
+
+    ESPB_V128_I16X8_ADD             = 0x18,
+    ESPB_V128_I16X8_SUB             = 0x19,
+    ESPB_V128_I16X8_ADD_SAT_S       = 0x1A,
+    ESPB_V128_I16X8_SUB_SAT_S       = 0x1B,
+    ESPB_V128_I16X8_MIN_S           = 0x1C,
+    ESPB_V128_I16X8_MAX_S           = 0x1D,
+    ESPB_V128_I16X8_MUL             = 0x1E,
+    ESPB_V128_I16X8_Q15MULR_SAT_S   = 0x1F, // (a * b + 0x4000) >> 15 с насыщением
+
+    ESPB_V128_I32X4_ADD             = 0x20,
+    ESPB_V128_I32X4_SUB             = 0x21,
+    ESPB_V128_I32X4_MUL             = 0x22,
+    ESPB_V128_I32X4_MIN_S           = 0x23,
+    ESPB_V128_I32X4_MAX_S           = 0x24,
+
+    ESPB_V128_F32X4_ADD             = 0x28,
+    ESPB_V128_F32X4_SUB             = 0x29,
+    ESPB_V128_F32X4_MUL             = 0x2A,
+    ESPB_V128_F32X4_MIN             = 0x2B, // NaN, если любой операнд NaN; -0 < +0
+    ESPB_V128_F32X4_MAX             = 0x2C,
+
+    ESPB_V128_AND                   = 0x30,
+    ESPB_V128_OR                    = 0x31,
+    ESPB_V128_XOR                   = 0x32,
+    ESPB_V128_ANDNOT                = 0x33, // a & ~b
+};
+
+// Арифметика и логика: бинарные, унарные вызываются с b == a. d может перекрывать a/b
+// (пары регистров, сдвинутые на один), поэтому ядра сначала читают операнды целиком.
+typedef void (*EspbV128Op)(EspbV128 *d, const EspbV128 *a, const EspbV128 *b);
+typedef void (*EspbV128SplatOp)(EspbV128 *d, uint32_t x);
+
+/**
+ * @brief Длина операндов 0xFD-инструкции после байта sub_op.
+ * @return 0 для неизвестного sub_op.
+ */
+size_t espb_v128_operand_len(uint8_t sub_op);
+
+#define ESPB_V128_MAX_READS 6
+
+/**
+ * @brief Регистры, которые читает 0xFD-инструкция (вектор - оба регистра пары).
+ *
+ * Для распределителя регистров JIT: байты imm (CONST) и дорожек (SHUFFLE) не операнды.
+ * @param operands Операнды после байта sub_op.
+ * @return Число регистров в out.
+ */
+uint32_t espb_v128_reads(uint8_t sub_op, const uint8_t *operands, uint8_t out[ESPB_V128_MAX_READS]);
+
+// Ядро арифметической/логической операции; NULL - sub_op не из этой группы.
+EspbV128Op espb_v128_op(uint8_t sub_op);
+
+static inline bool espb_v128_is_unary(uint8_t sub_op) {
+    return sub_op == ESPB_V128_NOT;
+}
+
+// Ядро SPLAT; NULL - sub_op не SPLAT.
+EspbV128SplatOp espb_v128_splat_op(uint8_t sub_op);
+
+void espb_v128_load(EspbV128 *d, const void *addr);
+void espb_v128_store(const EspbV128 *s, void *addr);
+void espb_v128_shuffle(EspbV128 *d, const EspbV128 *a, const EspbV128 *b, const uint8_t lanes[16]);
+
+/*
+ * SHUFFLE для JIT: дорожки по 5 бит, w[0] - дорожки 0..5, w[1] - 6..11, w[2] - 12..15,
+ * чтобы вызов укладывался в 6 регистровых аргументов.
+ */
+void espb_v128_shuffle_pack(const uint8_t lanes[16], uint32_t w[3]);
+void espb_v128_shuffle_packed(EspbV128 *d, const EspbV128 *a, const EspbV128 *b,
+                              uint32_t w0, uint32_t w1, uint32_t w2);
+
+/**
+ * @brief Исполняет 0xFD-инструкцию в интерпретаторе.
+ *
+ * @param insn Указатель на байт 0xFD; *next_pc - следующая инструкция.
+ * @return ESPB_OK; ESPB_ERR_INVALID_OPERAND / ESPB_ERR_INVALID_REGISTER_INDEX для
+ *         неверной инструкции, ESPB_ERR_MEMORY_ACCESS_OUT_OF_BOUNDS для LOAD/STORE.
+ */
+EspbResult espb_v128_execute(EspbInstance *instance, Value *locals, uint8_t max_reg_used,
+                             const uint8_t *insn, const uint8_t **next_pc);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESPB_SIMD_H
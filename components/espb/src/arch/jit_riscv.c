@@ -20,12 +20,23 @@
 #include "espb_api.h"
 #include "espb_interpreter_runtime_oc.h"
 #include "espb_jit_dispatcher.h"
+#include "espb_jit.h"
+#include "espb_jit_budget.h"
 #include "espb_jit_import_call.h"
 #include "espb_jit_indirect_ptr.h"
 #include "espb_jit_globals.h"
 #include "espb_jit_helpers.h"
+#include "espb_runtime_alloca.h"
 #include "espb_exec_memory.h"
 #include "espb_heap_manager.h"
+#include "espb_jit_snapshot.h"
+#include "espb_jit_osr.h"
+#include "espb_jit_code_map.h"
+#include "espb_fuel.h"
+#include "espb_interpreter_threaded.h"
+#include "espb_sandbox.h"
+#include "espb_bulk_memory.h"
+#include "espb_simd.h"
 #include <stdio.h>
 #include <inttypes.h>
 #include <stdlib.h>
@@ -54,6 +65,34 @@ ffi_type* espb_type_to_ffi_type(EspbValueType es_type) {
     }
 }
 
+// При наличии FPU (ESP32-P4) F32-арифметика, сравнения и I32<->F32 конверсии
+// генерируются инструкциями расширения F; соответствующие helper'ы не нужны.
+#if CONFIG_ESPB_JIT_HW_FPU && defined(__riscv_flen) && (__riscv_flen >= 32)
+#define JIT_RV_HW_FPU 1
+#else
+#define JIT_RV_HW_FPU 0
+#endif
+
+// Счётные циклы байткода на аппаратных циклах ESP32-P4 (esp.lp.setup), см. jit_hwloop_scan
+#if CONFIG_ESPB_JIT_RISCV_HW_LOOPS
+#define JIT_RV_HW_LOOPS 1
+#else
+#define JIT_RV_HW_LOOPS 0
+#endif
+
+// Список релокаций helper-вызовов нужен снимку (код по другому адресу после перезагрузки)
+// и горячей замене модуля (код переносится в тело новой версии функции)
+#define JIT_RV_RELOCS (CONFIG_ESPB_JIT_SNAPSHOT || CONFIG_ESPB_JIT_RELOAD)
+
+// Профиль ESP32-P4 (RV32IMAFC + Xhwlp + Xesppie), выбирается по CONFIG_IDF_TARGET_ESP32P4:
+//  - F32 - инструкции расширения F (JIT_RV_HW_FPU);
+//  - MEMORY.COPY/FILL вызывают espb_memory_copy/fill, V128 - ядра espb_v128_op: на P4 они
+//    собраны на PIE, блочные циклы - аппаратные (esp.lp.setup), см. ESPB_BULK_MEMORY_PIE
+//    и ESPB_SIMD_PIE.
+//  - счётные внутренние циклы - esp.lp.setup (JIT_RV_HW_LOOPS). Кодирование не зашито
+//    в JIT: оно выводится из эталонных инструкций, собранных тулчейном, и при
+//    несовпадении циклы остаются на bne. PIE самим JIT не генерируется.
+
 // Helper functions for soft-float emulation in JIT code
 // These are called from JIT-compiled code to perform float operations
 
@@ -218,6 +257,7 @@ static uint32_t jit_helper_fpround_f64_to_f32_bits(uint64_t a_bits) {
     return f_bits;
 }
 
+#if !JIT_RV_HW_FPU
 // Convert U32 to F32
 __attribute__((noinline))
 static uint32_t jit_helper_cvt_u32_f32_bits(uint32_t val) {
@@ -226,6 +266,7 @@ static uint32_t jit_helper_cvt_u32_f32_bits(uint32_t val) {
     memcpy(&bits, &f, sizeof(bits));
     return bits;
 }
+#endif
 
 // Convert U64 to F32
 __attribute__((noinline))
@@ -254,6 +295,7 @@ static uint64_t jit_helper_cvt_u32_f64_bits(uint32_t val) {
     return bits;
 }
 
+#if !JIT_RV_HW_FPU
 // Convert I32 to F32
 __attribute__((noinline))
 static uint32_t jit_helper_cvt_i32_f32_bits(int32_t val) {
@@ -262,6 +304,7 @@ static uint32_t jit_helper_cvt_i32_f32_bits(int32_t val) {
     memcpy(&bits, &f, sizeof(bits));
     return bits;
 }
+#endif
 
 // Convert I32 to F64
 __attribute__((noinline))
@@ -272,6 +315,7 @@ static uint64_t jit_helper_cvt_i32_f64_bits(int32_t val) {
     return bits;
 }
 
+#if !JIT_RV_HW_FPU
 // Convert F32 to U32 (truncate toward zero)
 __attribute__((noinline))
 static uint32_t jit_helper_cvt_f32_u32(uint32_t a_bits) {
@@ -279,6 +323,7 @@ static uint32_t jit_helper_cvt_f32_u32(uint32_t a_bits) {
     memcpy(&a, &a_bits, sizeof(a));
     return (uint32_t)a;
 }
+#endif
 
 // Convert F32 to U64 (truncate toward zero)
 __attribute__((noinline))
@@ -288,6 +333,7 @@ static uint64_t jit_helper_cvt_f32_u64(uint32_t a_bits) {
     return (uint64_t)a;
 }
 
+#if !JIT_RV_HW_FPU
 // Convert F32 to I32 (truncate toward zero)
 __attribute__((noinline))
 static int32_t jit_helper_cvt_f32_i32(uint32_t a_bits) {
@@ -295,6 +341,7 @@ static int32_t jit_helper_cvt_f32_i32(uint32_t a_bits) {
     memcpy(&a, &a_bits, sizeof(a));
     return (int32_t)a;
 }
+#endif
 
 // Convert F32 to I64 (truncate toward zero)
 __attribute__((noinline))
@@ -416,34 +463,6 @@ static uint64_t jit_helper_remu64(uint64_t dividend, uint64_t divisor) {
     return dividend % divisor;
 }
 
-// 64-bit multiplication
-__attribute__((noinline))
-static uint64_t jit_helper_mul64(uint64_t a, uint64_t b) {
-    return a * b;
-}
-
-// --- I64 bitwise/shift helpers (v1.7 opcodes 0x38..0x3E) ---
-__attribute__((noinline))
-static uint64_t jit_helper_and_i64(uint64_t a, uint64_t b) { return a & b; }
-
-__attribute__((noinline))
-static uint64_t jit_helper_or_i64(uint64_t a, uint64_t b) { return a | b; }
-
-__attribute__((noinline))
-static uint64_t jit_helper_xor_i64(uint64_t a, uint64_t b) { return a ^ b; }
-
-__attribute__((noinline))
-static uint64_t jit_helper_not_i64(uint64_t a) { return ~a; }
-
-__attribute__((noinline))
-static uint64_t jit_helper_shl_i64(uint64_t a, uint32_t sh) { return a << (sh & 63u); }
-
-__attribute__((noinline))
-static int64_t jit_helper_shr_i64(int64_t a, uint32_t sh) { return a >> (sh & 63u); }
-
-__attribute__((noinline))
-static uint64_t jit_helper_ushr_i64(uint64_t a, uint32_t sh) { return a >> (sh & 63u); }
-
 // External compiler-rt/libgcc function for uint64_t to double conversion
 // This function is provided by the compiler's runtime library
 extern double __floatundidf(uint64_t val);
@@ -489,47 +508,7 @@ static EspbResult jit_helper_data_drop(EspbInstance *instance, uint32_t data_seg
     return ESPB_OK;
 }
 
-// ===== I64 comparison helpers =====
-__attribute__((noinline))
-static uint32_t jit_helper_cmp_lts_i64(int64_t a, int64_t b) {
-    return (a < b) ? 1 : 0;
-}
-
-__attribute__((noinline))
-static uint32_t jit_helper_cmp_gt_i64(int64_t a, int64_t b) {
-    return (a > b) ? 1 : 0;
-}
-
-__attribute__((noinline))
-static uint32_t jit_helper_cmp_le_i64(int64_t a, int64_t b) {
-    return (a <= b) ? 1 : 0;
-}
-
-__attribute__((noinline))
-static uint32_t jit_helper_cmp_ge_i64(int64_t a, int64_t b) {
-    return (a >= b) ? 1 : 0;
-}
-
-__attribute__((noinline))
-static uint32_t jit_helper_cmp_ltu_i64(uint64_t a, uint64_t b) {
-    return (a < b) ? 1 : 0;
-}
-
-__attribute__((noinline))
-static uint32_t jit_helper_cmp_gtu_i64(uint64_t a, uint64_t b) {
-    return (a > b) ? 1 : 0;
-}
-
-__attribute__((noinline))
-static uint32_t jit_helper_cmp_leu_i64(uint64_t a, uint64_t b) {
-    return (a <= b) ? 1 : 0;
-}
-
-__attribute__((noinline))
-static uint32_t jit_helper_cmp_geu_i64(uint64_t a, uint64_t b) {
-    return (a >= b) ? 1 : 0;
-}
-
+#if !JIT_RV_HW_FPU
 // ===== F32 comparison helpers (operate on raw bits) =====
 __attribute__((noinline))
 static uint32_t jit_helper_cmp_eq_f32(uint32_t a_bits, uint32_t b_bits) {
@@ -578,6 +557,7 @@ static uint32_t jit_helper_cmp_ge_f32(uint32_t a_bits, uint32_t b_bits) {
     memcpy(&b, &b_bits, sizeof(b));
     return (a >= b) ? 1 : 0;
 }
+#endif
 
 // ===== F64 comparison helpers (operate on raw bits) =====
 __attribute__((noinline))
@@ -928,6 +908,7 @@ typedef struct {
     uint8_t* buffer;
     size_t   capacity;
     size_t   offset;
+    bool     overflow;  // Код не влез в capacity: функция отклоняется (ESPB_ERR_JIT_CODE_TOO_LARGE)
     // Для отложенной фиксации переходов
     JitPatchpoint* patchpoints;
     size_t num_patchpoints;
@@ -937,14 +918,68 @@ typedef struct {
     size_t num_labels;
     size_t labels_capacity;
 
-#ifdef JIT_STATS
+#if CONFIG_ESPB_JIT_STATS
     size_t helper_call_count;
     size_t helper_call_fallback_abs_count;
+    size_t spill_count;            // Сбросы закреплённых vreg в v_regs перед барьерами
 #endif
 
     // CMP+BR_IF ОПТИМИЗАЦИЯ: отслеживание последнего CMP
     uint8_t last_cmp_result_reg;  // Регистр с результатом последнего CMP (0xFF = нет)
     bool last_cmp_in_t0;           // Результат CMP находится в t0 (не сохранён в память)
+
+    // Компилируемое тело без 64-битных значений (EspbFunctionBody::regs32): MOV копирует
+    // только младшее слово v_regs[]. Во встроенном теле - флаг callee.
+    bool regs32;
+
+#if JIT_RV_RELOCS
+    // PC-relative вызовы helper'ов: нужны, чтобы перенести код по другому адресу
+    EspbJitReloc* relocs;
+    size_t num_relocs;
+    size_t relocs_capacity;
+#endif
+
+#if CONFIG_ESPB_JIT_REGALLOC
+    // Распределение vreg по s-регистрам (NULL = все vreg в памяти v_regs[])
+    struct JitRegAlloc* ra;
+    uint32_t ra_pos;          // Индекс текущей инструкции байткода
+    uint32_t ra_reads[8];     // Vreg, которые текущая инструкция объявленно читает
+    uint32_t ra_touch[8];     // Объявленные чтения и записи
+    bool ra_barrier;          // Текущая инструкция обращается к v_regs[] в обход emit_lw/sw_phys
+    bool ra_bypass;           // Доступы к v_regs[] идут в память как есть
+    uint8_t ra_sanction;      // >0: s2 используется внутри emit_lw/sw_phys
+    bool ra_failed;           // Неучтённый доступ к v_regs[] — компилируем заново без аллокатора
+#endif
+
+#if CONFIG_ESPB_SANDBOX_MASKED
+    // Линейная память песочницы: адреса маскируются как memory_data | (ptr & sb_mask)
+    uint32_t sb_mask;
+#endif
+
+#if CONFIG_ESPB_JIT_OSR
+    // OSR: заголовки циклов (NULL - точки входа не собираются) и найденные точки
+    uint32_t* osr_headers;
+    size_t osr_num_headers;
+    size_t osr_next;          // Первый заголовок с bc_offset >= текущего
+    EspbJitOsrPoint* osr_points;
+    uint32_t* osr_ra_pos;     // ra_pos точки: какие закреплённые vreg живы на входе
+    size_t osr_num_points;
+#endif
+#if CONFIG_ESPB_FUEL
+    // Заголовки циклов, где списывается топливо (espb_fuel.h)
+    uint32_t* fuel_headers;
+    size_t fuel_num_headers;
+    size_t fuel_next;
+#endif
+#if JIT_RV_HW_LOOPS
+    // Аппаратные циклы (jit_hwloop_scan) и открытый цикл: setup выдан, LAST ещё нет
+    struct JitHwLoop* hwloops;
+    size_t hwl_count;
+    size_t hwl_next;
+    const struct JitHwLoop* hwl_open;
+    size_t hwl_setup;         // Заглушка esp.lp.setup
+    size_t hwl_body;          // Начало тела (адрес возврата аппаратного цикла)
+#endif
 } JitContext;
 
 // Forward decls for peephole helpers (emit_* defined later)
@@ -1393,6 +1428,12 @@ void jit_call_espb_function(EspbInstance* instance, uint32_t local_func_idx, Val
     
     // ИНТЕГРАЦИЯ HOT: Проверяем флаг HOT перед попыткой компиляции
     bool is_hot = (callee_body->header.flags & ESPB_FUNC_FLAG_HOT) != 0;
+#if CONFIG_ESPB_JIT_TIERED
+    is_hot = is_hot || callee_body->tier_up_hot;
+    if (!is_hot && espb_jit_tier_up_tick(callee_body, 1)) {
+        is_hot = espb_jit_tier_up(instance, local_func_idx);
+    }
+#endif
     
     if (!is_hot) {
         // Не-HOT функция - сразу вызываем через интерпретатор (не пытаемся компилировать)
@@ -1415,6 +1456,7 @@ void jit_call_espb_function(EspbInstance* instance, uint32_t local_func_idx, Val
     if (callee_body->is_jit_compiled && callee_body->jit_code != NULL) {
         typedef void (*JitFunc)(EspbInstance*, Value*);
         JitFunc jit_func = (JitFunc)callee_body->jit_code;
+        espb_jit_note_call(instance, global_func_idx);
 
         // Локальный регистровый фрейм для вызываемой функции (семантика CALL)
         // КРИТИЧНО: нельзя выделять 256 Value на каждый рекурсивный вызов (переполнит стек)
@@ -1427,19 +1469,22 @@ void jit_call_espb_function(EspbInstance* instance, uint32_t local_func_idx, Val
             goto slow_path;
         }
 
-        // ОПТИМИЗАЦИЯ: не всегда нужно занулять все num_virtual_regs.
-        uint16_t max_used = (uint16_t)callee_body->header.max_reg_used + 1;
+        // ОПТИМИЗАЦИЯ: не всегда нужно занулять все num_virtual_regs - только регистры,
+        // которые могут читаться до записи (zero_init_regs), и не те, что займут аргументы.
+        uint16_t init_regs = ESPB_FRAME_ZERO_INIT_REGS(callee_body);
         uint16_t zero_regs = needed_regs;
-        if (max_used > 0 && max_used < zero_regs) zero_regs = max_used;
-        if (zero_regs < num_args) zero_regs = num_args;
-        if (zero_regs == 0) zero_regs = 1;
-
-        memset(callee_regs, 0, (size_t)zero_regs * sizeof(Value));
+        if (init_regs > 0 && init_regs < zero_regs) zero_regs = init_regs;
+        if (zero_regs > num_args) {
+            memset(callee_regs + num_args, 0, (size_t)(zero_regs - num_args) * sizeof(Value));
+        }
         for (uint8_t i = 0; i < num_args; i++) {
             callee_regs[i] = v_regs[i];
         }
 
+        // ALLOCA callee освобождается при его возврате, как END в интерпретаторе
+        uint32_t alloca_mark = espb_jit_alloca_mark();
         jit_func(instance, callee_regs);
+        espb_jit_alloca_restore(alloca_mark);
 
         if (sig->num_returns > 0) {
             v_regs[0] = callee_regs[0];
@@ -1496,11 +1541,69 @@ static inline void jit_icache_sync(void* addr, size_t size) {
     esp_cache_msync(addr, size, ESP_CACHE_MSYNC_FLAG_DIR_C2M | ESP_CACHE_MSYNC_FLAG_DIR_M2C);
 }
 
+#if CONFIG_ESPB_JIT_REGALLOC
+// Страховка аллокатора: вне барьеров s2 (указатель на v_regs[]) может использоваться
+// только внутри emit_lw/sw_phys, где доступ перехватывается. Любое другое упоминание
+// s2 означает обращение к v_regs[] мимо аллокатора — функция компилируется заново без него.
+static inline void jit_ra_guard(JitContext* ctx, uint32_t instr) {
+    if (!ctx->ra || ctx->ra_bypass || ctx->ra_sanction != 0) return;
+    uint32_t rd = (instr >> 7) & 0x1F;
+    uint32_t rs1 = (instr >> 15) & 0x1F;
+    uint32_t rs2 = (instr >> 20) & 0x1F;
+    bool hit;
+    switch (instr & 0x7F) {
+        case 0b0110011: // R-type
+        case 0b0101111: // AMO
+            hit = (rd == 18 || rs1 == 18 || rs2 == 18);
+            break;
+        case 0b0100011: // Store
+        case 0b0100111: // FP store
+        case 0b1100011: // Branch
+            hit = (rs1 == 18 || rs2 == 18);
+            break;
+        case 0b0110111: // LUI
+        case 0b0010111: // AUIPC
+        case 0b1101111: // JAL
+            hit = (rd == 18);
+            break;
+        default:        // I-type: load, OP-IMM, JALR, SYSTEM
+            hit = (rd == 18 || rs1 == 18);
+            break;
+    }
+    if (hit) ctx->ra_failed = true;
+}
+
+static inline void jit_ra_guard16(JitContext* ctx, uint16_t instr) {
+    if (!ctx->ra || ctx->ra_bypass || ctx->ra_sanction != 0) return;
+    uint32_t funct3 = (instr >> 13) & 0x7;
+    uint32_t r_hi = (instr >> 7) & 0x1F;
+    uint32_t r_lo = (instr >> 2) & 0x1F;
+    bool hit = false;
+    switch (instr & 0x3) {
+        case 0b01: // c.addi / c.li / c.lui
+            hit = (funct3 == 0 || funct3 == 2 || funct3 == 3) && r_hi == 18;
+            break;
+        case 0b10: // c.slli / c.lwsp / c.mv / c.add / c.jr / c.swsp
+            if (funct3 == 0 || funct3 == 2) hit = (r_hi == 18);
+            else if (funct3 == 4) hit = (r_hi == 18 || r_lo == 18);
+            else if (funct3 == 6) hit = (r_lo == 18);
+            break;
+        default:   // квадрант 0 адресует только x8..x15
+            break;
+    }
+    if (hit) ctx->ra_failed = true;
+}
+#endif
+
 static void emit_instr(JitContext* ctx, uint32_t instr) {
     if (ctx->offset + 4 > ctx->capacity) {
-        printf("JIT ERROR: Buffer overflow at offset %zu!\n", ctx->offset);
+        if (!ctx->overflow) printf("JIT ERROR: Buffer overflow at offset %zu!\n", ctx->offset);
+        ctx->overflow = true;
         return;
     }
+#if CONFIG_ESPB_JIT_REGALLOC
+    jit_ra_guard(ctx, instr);
+#endif
     
     // Валидация RISC-V инструкции
     uint32_t opcode = instr & 0x7F;
@@ -1537,9 +1640,13 @@ static void emit_instr(JitContext* ctx, uint32_t instr) {
 
 static void emit_instr16(JitContext* ctx, uint16_t instr) {
     if (ctx->offset + 2 > ctx->capacity) {
-        printf("JIT ERROR: Buffer overflow at offset %zu!\n", ctx->offset);
+        if (!ctx->overflow) printf("JIT ERROR: Buffer overflow at offset %zu!\n", ctx->offset);
+        ctx->overflow = true;
         return;
     }
+#if CONFIG_ESPB_JIT_REGALLOC
+    jit_ra_guard16(ctx, instr);
+#endif
     memcpy(ctx->buffer + ctx->offset, &instr, sizeof(instr));
     ctx->offset += sizeof(instr);
 }
@@ -1809,7 +1916,22 @@ static void emit_addi_phys(JitContext* ctx, uint8_t rd, uint8_t rs1, int16_t imm
 static void emit_lui_phys(JitContext* ctx, uint8_t rd, uint32_t imm);
 static void emit_add_phys(JitContext* ctx, uint8_t rd, uint8_t rs1, uint8_t rs2);
 
+#if CONFIG_ESPB_JIT_REGALLOC
+static bool jit_ra_intercept_lw(JitContext* ctx, uint8_t rd, int16_t offset);
+static bool jit_ra_intercept_sw(JitContext* ctx, uint8_t rs2, int16_t offset);
+#endif
+
 static void emit_sw_phys(JitContext* ctx, uint8_t rs2, int16_t offset, uint8_t rs1) {
+#if CONFIG_ESPB_JIT_REGALLOC
+    if (rs1 == 18 && ctx->ra && ctx->ra_sanction == 0) {
+        // v_regs[vreg].lo, закреплённый за s-регистром, превращается в mv
+        if (jit_ra_intercept_sw(ctx, rs2, offset)) return;
+        ctx->ra_sanction++;
+        emit_sw_phys(ctx, rs2, offset, rs1);
+        ctx->ra_sanction--;
+        return;
+    }
+#endif
     if (offset < -2048 || offset > 2047) {
         uint32_t abs_off = (offset < 0) ? -offset : offset;
         emit_lui_phys(ctx, 28, (abs_off + 0x800) & 0xFFFFF000);
@@ -1844,7 +1966,23 @@ static void emit_sb_phys(JitContext* ctx, uint8_t rs2, int16_t offset, uint8_t r
     emit_instr(ctx, (imm11_5 << 25) | (rs2 << 20) | (rs1 << 15) | (0b000 << 12) | (imm4_0 << 7) | 0b0100011);
 }
 
+static void emit_sh_phys(JitContext* ctx, uint8_t rs2, int16_t offset, uint8_t rs1) {
+    uint32_t off = (uint32_t)offset & 0xFFF;
+    uint32_t imm11_5 = (off >> 5) & 0x7F;
+    uint32_t imm4_0 = off & 0x1F;
+    emit_instr(ctx, (imm11_5 << 25) | (rs2 << 20) | (rs1 << 15) | (0b001 << 12) | (imm4_0 << 7) | 0b0100011);
+}
+
 static void emit_lw_phys(JitContext* ctx, uint8_t rd, int16_t offset, uint8_t rs1) {
+#if CONFIG_ESPB_JIT_REGALLOC
+    if (rs1 == 18 && ctx->ra && ctx->ra_sanction == 0) {
+        if (jit_ra_intercept_lw(ctx, rd, offset)) return;
+        ctx->ra_sanction++;
+        emit_lw_phys(ctx, rd, offset, rs1);
+        ctx->ra_sanction--;
+        return;
+    }
+#endif
     if (offset < -2048 || offset > 2047) {
         uint32_t abs_off = (offset < 0) ? -offset : offset;
         emit_lui_phys(ctx, 28, (abs_off + 0x800) & 0xFFFFF000);
@@ -1915,11 +2053,31 @@ static void emit_jalr_phys(JitContext* ctx, uint8_t rd, uint8_t rs1, int16_t imm
     emit_instr(ctx, imm_bits | (rs1 << 15) | (0b000 << 12) | (rd << 7) | 0b1100111);
 }
 
+#if JIT_RV_RELOCS
+static void jit_context_add_reloc(JitContext* ctx, size_t native_offset, uintptr_t target) {
+    if (ctx->relocs_capacity == SIZE_MAX) return;  // Список уже неполный
+    if (ctx->num_relocs >= ctx->relocs_capacity) {
+        size_t new_capacity = ctx->relocs_capacity == 0 ? 16 : ctx->relocs_capacity * 2;
+        EspbJitReloc* new_relocs = (EspbJitReloc*)realloc(ctx->relocs, new_capacity * sizeof(EspbJitReloc));
+        if (!new_relocs) {
+            // Без полного списка релокаций код нельзя сохранять в снимок и переносить в новый модуль
+            ctx->relocs_capacity = SIZE_MAX;
+            return;
+        }
+        ctx->relocs = new_relocs;
+        ctx->relocs_capacity = new_capacity;
+    }
+    ctx->relocs[ctx->num_relocs].native_offset = (uint32_t)native_offset;
+    ctx->relocs[ctx->num_relocs].target = (uint32_t)target;
+    ctx->num_relocs++;
+}
+#endif
+
 static void emit_call_helper(JitContext* ctx, uintptr_t func_addr) {
     // NOTE: s1(x9) and s2(x18) are callee-saved by ABI, so helper should preserve them.
     // We rely on this instead of manually saving/restoring, which was causing issues.
 
-#ifdef JIT_STATS
+#if CONFIG_ESPB_JIT_STATS
     ctx->helper_call_count++;
 #endif
 
@@ -1929,7 +2087,7 @@ static void emit_call_helper(JitContext* ctx, uintptr_t func_addr) {
     int64_t rel = (int64_t)func_addr - (int64_t)call_pc;
 
     if (rel > (int64_t)INT32_MAX || rel < (int64_t)INT32_MIN) {
-#ifdef JIT_STATS
+#if CONFIG_ESPB_JIT_STATS
         ctx->helper_call_fallback_abs_count++;
 #endif
         uint32_t hi20 = (uint32_t)((func_addr + 0x800) >> 12);
@@ -1943,8 +2101,15 @@ static void emit_call_helper(JitContext* ctx, uintptr_t func_addr) {
         int64_t hi20 = (rel + 0x800) >> 12;
         int64_t lo12 = rel - (hi20 << 12);
         uint32_t auipc_imm = ((uint32_t)hi20 & 0xFFFFF) << 12;
+#if JIT_RV_RELOCS
+        jit_context_add_reloc(ctx, ctx->offset, func_addr);
+        emit_instr(ctx, auipc_imm | (5u << 7) | 0b0010111);
+        // Без c.jalr: при переносе кода lo12 может стать ненулевым, пара должна остаться 8 байт
+        emit_instr(ctx, (((uint32_t)lo12 & 0xFFF) << 20) | (5u << 15) | (1u << 7) | 0b1100111);
+#else
         emit_instr(ctx, auipc_imm | (5u << 7) | 0b0010111);
         emit_jalr_phys(ctx, 1, 5, (int16_t)lo12);
+#endif
     }
 
     // s1/s2 preserved by callee (ABI), no need to restore
@@ -2078,12 +2243,186 @@ static void emit_or_phys(JitContext* ctx, uint8_t rd, uint8_t rs1, uint8_t rs2)
     emit_instr(ctx, (0b0000000 << 25) | (rs2 << 20) | (rs1 << 15) | (0b110 << 12) | (rd << 7) | 0b0110011);
 }
 
+#if CONFIG_ESPB_SANDBOX_MASKED
+// Загрузка 32-битной константы в rd (lui + addi)
+static void jit_sandbox_li(JitContext* ctx, uint8_t rd, uint32_t value) {
+    uint32_t hi = (value + 0x800) & 0xFFFFF000u;
+    int16_t lo = (int16_t)(int32_t)(value - hi);
+    if (hi == 0) {
+        emit_addi_phys(ctx, rd, 0, lo);
+        return;
+    }
+    emit_lui_phys(ctx, rd, hi);
+    if (lo != 0) emit_addi_phys(ctx, rd, rd, lo);
+}
+
+_Static_assert(offsetof(EspbInstance, memory_data) < 2048, "EspbInstance.memory_data must be reachable with lw imm12");
+
+// Маскирование адреса песочницы: dst = instance->memory_data | ((base + *offset) & sb_mask).
+// Смещение включается в маску, поэтому *offset обнуляется. x31 — временный.
+// База всегда читается через s1: код не содержит адреса памяти экземпляра и остаётся
+// пригодным для разделяемого модуля, снимка во flash и переноса при перезагрузке.
+static uint8_t jit_sandbox_addr(JitContext* ctx, uint8_t dst, uint8_t base, int16_t* offset) {
+    int16_t off = offset ? *offset : 0;
+    if (off >= -2048 && off <= 2047) {
+        if (off != 0) {
+            emit_addi_phys(ctx, dst, base, off);
+            base = dst;
+        }
+    } else {
+        jit_sandbox_li(ctx, 31, (uint32_t)(int32_t)off);
+        emit_add_phys(ctx, dst, base, 31);
+        base = dst;
+    }
+    if (ctx->sb_mask < 2048) {
+        // ANDI dst, base, mask
+        emit_instr(ctx, (ctx->sb_mask << 20) | ((uint32_t)base << 15) | (0b111 << 12) | ((uint32_t)dst << 7) | 0b0010011);
+    } else {
+        jit_sandbox_li(ctx, 31, ctx->sb_mask);
+        emit_and_phys(ctx, dst, base, 31);
+    }
+    emit_lw_phys(ctx, 31, (int16_t)offsetof(EspbInstance, memory_data), 9);
+    emit_or_phys(ctx, dst, dst, 31);
+    if (offset) *offset = 0;
+    return dst;
+}
+
+#define JIT_SANDBOX_ADDR(ctx, reg, off) ((reg) = jit_sandbox_addr((ctx), 5, (reg), (off)))
+#define JIT_SANDBOX_ADDR_T0(ctx, off)   ((void)jit_sandbox_addr((ctx), 5, 5, (off)))
+#define JIT_SANDBOX_ARG(ctx, reg)       ((void)jit_sandbox_addr((ctx), (reg), (reg), NULL))
+#else
+#define JIT_SANDBOX_ADDR(ctx, reg, off) ((void)0)
+#define JIT_SANDBOX_ADDR_T0(ctx, off)   ((void)0)
+#define JIT_SANDBOX_ARG(ctx, reg)       ((void)0)
+#endif
+
 // SLTU: Set Less Than Unsigned
 static void emit_sltu_phys(JitContext* ctx, uint8_t rd, uint8_t rs1, uint8_t rs2) {
     // SLTU rd, rs1, rs2: opcode=0110011, funct3=011, funct7=0000000
     emit_instr(ctx, (0b0000000 << 25) | (rs2 << 20) | (rs1 << 15) | (0b011 << 12) | (rd << 7) | 0b0110011);
 }
 
+// SLT: Set Less Than (signed)
+static void emit_slt_phys(JitContext* ctx, uint8_t rd, uint8_t rs1, uint8_t rs2) {
+    // SLT rd, rs1, rs2: opcode=0110011, funct3=010, funct7=0000000
+    emit_instr(ctx, (0b0000000 << 25) | (rs2 << 20) | (rs1 << 15) | (0b010 << 12) | (rd << 7) | 0b0110011);
+}
+
+static void emit_xor_phys(JitContext* ctx, uint8_t rd, uint8_t rs1, uint8_t rs2) {
+    // XOR rd, rs1, rs2: opcode=0110011, funct3=100, funct7=0000000
+    emit_instr(ctx, (0b0000000 << 25) | (rs2 << 20) | (rs1 << 15) | (0b100 << 12) | (rd << 7) | 0b0110011);
+}
+
+static void emit_sltiu_phys(JitContext* ctx, uint8_t rd, uint8_t rs1, int16_t imm) {
+    // SLTIU rd, rs1, imm: opcode=0010011, funct3=011
+    emit_instr(ctx, (((uint32_t)imm & 0xFFF) << 20) | (rs1 << 15) | (0b011 << 12) | (rd << 7) | 0b0010011);
+}
+
+static void emit_xori_phys(JitContext* ctx, uint8_t rd, uint8_t rs1, int16_t imm) {
+    // XORI rd, rs1, imm: opcode=0010011, funct3=100
+    emit_instr(ctx, (((uint32_t)imm & 0xFFF) << 20) | (rs1 << 15) | (0b100 << 12) | (rd << 7) | 0b0010011);
+}
+
+// MUL / MULHU (расширение M): младшие и старшие (unsigned) 32 бита произведения
+static void emit_mul_phys(JitContext* ctx, uint8_t rd, uint8_t rs1, uint8_t rs2) {
+    // MUL rd, rs1, rs2: opcode=0110011, funct3=000, funct7=0000001
+    emit_instr(ctx, (0b0000001 << 25) | (rs2 << 20) | (rs1 << 15) | (0b000 << 12) | (rd << 7) | 0b0110011);
+}
+
+static void emit_mulhu_phys(JitContext* ctx, uint8_t rd, uint8_t rs1, uint8_t rs2) {
+    // MULHU rd, rs1, rs2: opcode=0110011, funct3=011, funct7=0000001
+    emit_instr(ctx, (0b0000001 << 25) | (rs2 << 20) | (rs1 << 15) | (0b011 << 12) | (rd << 7) | 0b0110011);
+}
+
+#if JIT_RV_HW_FPU
+// Расширение F: f0..f2 используются как scratch, между инструкциями ESPB значения
+// в FPU-регистрах не живут (VCACHE/кадр хранят биты в целочисленных регистрах).
+// funct7 для OP-FP (opcode=1010011), формат S.
+#define RV_FADD_S   0x00
+#define RV_FSUB_S   0x04
+#define RV_FMUL_S   0x08
+#define RV_FDIV_S   0x0C
+#define RV_FMINMAX_S 0x14
+#define RV_FSQRT_S  0x2C
+#define RV_FCVT_W_S 0x60
+#define RV_FCMP_S   0x50
+#define RV_FCVT_S_W 0x68
+#define RV_FMV_X_W  0x70
+#define RV_FMV_W_X  0x78
+// rm: 0b111 = динамический режим из frm (как у скомпилированных helper'ов), 0b001 = RTZ
+#define RV_RM_DYN   0b111
+#define RV_RM_RTZ   0b001
+
+static void emit_fp_op(JitContext* ctx, uint8_t funct7, uint8_t rd, uint8_t rs1, uint8_t rs2, uint8_t funct3) {
+    emit_instr(ctx, ((uint32_t)funct7 << 25) | ((uint32_t)rs2 << 20) | ((uint32_t)rs1 << 15) |
+                    ((uint32_t)funct3 << 12) | ((uint32_t)rd << 7) | 0b1010011u);
+}
+
+// fmv.w.x fd, xs — биты целочисленного регистра в FPU
+static void emit_fmv_w_x(JitContext* ctx, uint8_t fd, uint8_t xs) {
+    emit_fp_op(ctx, RV_FMV_W_X, fd, xs, 0, 0b000);
+}
+
+// fmv.x.w xd, fs — биты FPU-регистра обратно в целочисленный
+static void emit_fmv_x_w(JitContext* ctx, uint8_t xd, uint8_t fs) {
+    emit_fp_op(ctx, RV_FMV_X_W, xd, fs, 0, 0b000);
+}
+
+// a0 = a0 <op> a1 (F32-биты); заменяет вызов jit_helper_*_f32_bits.
+// Для FSQRT.S rs2 = 0 и a1 не читается.
+static void emit_f32_binop_a0_a1(JitContext* ctx, uint8_t funct7, uint8_t funct3, bool unary) {
+    emit_fmv_w_x(ctx, 0, 10);
+    if (!unary) emit_fmv_w_x(ctx, 1, 11);
+    emit_fp_op(ctx, funct7, 0, 0, unary ? 0 : 1, funct3);
+    emit_fmv_x_w(ctx, 10, 0);
+}
+#endif
+
+// I64 = пары x5:x6 (a) и x7:x28 (b). Результат в x5:x6:
+// lo = a_lo*b_lo, hi = mulhu(a_lo, b_lo) + a_lo*b_hi + a_hi*b_lo
+static void emit_mul_i64_pairs(JitContext* ctx) {
+    emit_mulhu_phys(ctx, 29, 5, 7);
+    emit_mul_phys(ctx, 30, 5, 28);
+    emit_mul_phys(ctx, 31, 6, 7);
+    emit_mul_phys(ctx, 5, 5, 7);
+    emit_add_phys(ctx, 6, 29, 30);
+    emit_add_phys(ctx, 6, 6, 31);
+}
+
+// CMP.I64 без helper'а: a < b  <=>  a_hi < b_hi || (a_hi == b_hi && a_lo <u b_lo).
+// GT/LE/GE сводятся к LT перестановкой операндов (swap) и/или инверсией результата.
+static void emit_cmp_i64_inline(JitContext* ctx, uint8_t rd, uint8_t r1, uint8_t r2,
+                                bool is_signed, bool swap, bool invert) {
+    uint8_t a = swap ? r2 : r1;
+    uint8_t b = swap ? r1 : r2;
+    emit_lw_phys(ctx, 5, a * 8, 18);
+    emit_lw_phys(ctx, 6, a * 8 + 4, 18);
+    emit_lw_phys(ctx, 7, b * 8, 18);
+    emit_lw_phys(ctx, 28, b * 8 + 4, 18);
+    if (is_signed) {
+        emit_slt_phys(ctx, 29, 6, 28);   // t4 = a_hi < b_hi
+    } else {
+        emit_sltu_phys(ctx, 29, 6, 28);
+    }
+    emit_xor_phys(ctx, 30, 6, 28);
+    emit_sltiu_phys(ctx, 30, 30, 1);     // t5 = a_hi == b_hi
+    emit_sltu_phys(ctx, 31, 5, 7);       // t6 = a_lo <u b_lo
+    emit_and_phys(ctx, 30, 30, 31);
+    emit_or_phys(ctx, 5, 29, 30);
+    if (invert) {
+        emit_xori_phys(ctx, 5, 5, 1);
+    }
+    emit_sw_phys(ctx, 5, rd * 8, 18);
+    emit_sw_phys(ctx, 0, rd * 8 + 4, 18);
+}
+
+// LBU: Load Byte Unsigned
+static void emit_lbu_phys(JitContext* ctx, uint8_t rd, int16_t offset, uint8_t rs1) {
+    // LBU rd, offset(rs1): opcode=0000011, funct3=100
+    uint32_t imm_bits = ((uint32_t)offset & 0xFFF) << 20;
+    emit_instr(ctx, imm_bits | (rs1 << 15) | (0b100 << 12) | (rd << 7) | 0b0000011);
+}
+
 // LHU: Load Halfword Unsigned
 static void emit_lhu_phys(JitContext* ctx, uint8_t rd, int16_t offset, uint8_t rs1) {
     // LHU rd, offset(rs1): opcode=0000011, funct3=101
@@ -2160,20 +2499,57 @@ static void jit_context_init(JitContext* ctx, uint8_t* buffer, size_t capacity)
     ctx->buffer = buffer;
     ctx->capacity = capacity;
     ctx->offset = 0;
+    ctx->overflow = false;
     ctx->patchpoints = NULL;
     ctx->num_patchpoints = 0;
     ctx->patchpoints_capacity = 0;
     ctx->labels = NULL;
     ctx->num_labels = 0;
     ctx->labels_capacity = 0;
+#if CONFIG_ESPB_JIT_OSR
+    ctx->osr_headers = NULL;
+    ctx->osr_num_headers = 0;
+    ctx->osr_next = 0;
+    ctx->osr_points = NULL;
+    ctx->osr_ra_pos = NULL;
+    ctx->osr_num_points = 0;
+#endif
+#if CONFIG_ESPB_FUEL
+    ctx->fuel_headers = NULL;
+    ctx->fuel_num_headers = 0;
+    ctx->fuel_next = 0;
+#endif
+#if JIT_RV_HW_LOOPS
+    ctx->hwloops = NULL;
+    ctx->hwl_count = 0;
+    ctx->hwl_next = 0;
+    ctx->hwl_open = NULL;
+    ctx->hwl_setup = 0;
+    ctx->hwl_body = 0;
+#endif
+#if JIT_RV_RELOCS
+    ctx->relocs = NULL;
+    ctx->num_relocs = 0;
+    ctx->relocs_capacity = 0;
+#endif
 
-#ifdef JIT_STATS
+#if CONFIG_ESPB_JIT_STATS
     ctx->helper_call_count = 0;
     ctx->helper_call_fallback_abs_count = 0;
+    ctx->spill_count = 0;
 #endif
 
     ctx->last_cmp_result_reg = 0xFF;
     ctx->last_cmp_in_t0 = false;
+
+#if CONFIG_ESPB_JIT_REGALLOC
+    ctx->ra = NULL;
+    ctx->ra_pos = 0;
+    ctx->ra_barrier = false;
+    ctx->ra_bypass = false;
+    ctx->ra_sanction = 0;
+    ctx->ra_failed = false;
+#endif
 }
 
 static void jit_context_add_label(JitContext* ctx, size_t bytecode_offset) {
@@ -2407,141 +2783,1807 @@ static void jit_context_patch_branches(JitContext* ctx, const uint8_t* bytecode,
     }
 }
 
-static void jit_context_free(JitContext* ctx) {
-    if (ctx->patchpoints) {
-        free(ctx->patchpoints);
-        ctx->patchpoints = NULL;
+#define JIT_BR_TABLE_CHAIN_MAX      8    // BR_TABLE: до стольких целей - цепочка сравнений, больше - таблица переходов
+#define JIT_INLINE_MEMCOPY_MAX      8    // MEMORY.COPY константного размера: до стольких байт - inline lbu/sb
+#define JIT_INLINE_MEMFILL_MAX      16   // MEMORY.FILL константного размера: до стольких байт - inline sb
+
+// Константа в rd: addi от x0 или lui + addi
+static void jit_emit_li(JitContext* ctx, uint8_t rd, int32_t imm) {
+    if (imm >= -2048 && imm < 2048) {
+        emit_addi_phys(ctx, rd, 0, (int16_t)imm);
+        return;
     }
-    if (ctx->labels) {
-        free(ctx->labels);
-        ctx->labels = NULL;
+    uint32_t hi = ((uint32_t)imm + 0x800) & 0xFFFFF000;
+    int32_t lo = imm - (int32_t)hi;
+    emit_lui_phys(ctx, rd, hi);
+    if (lo != 0) emit_addi_phys(ctx, rd, rd, (int16_t)lo);
+}
+
+// V128 (0xFD): векторы - пары v_regs[], ядра espb_simd.c получают их адреса в a0..a2.
+// Инструкция - барьер распределителя, поэтому v_regs[] в памяти актуальны.
+// false - форма не поддерживается, функция остаётся интерпретатору.
+static bool jit_emit_v128(JitContext* ctx, uint8_t sub_op, const uint8_t* a) {
+    switch (sub_op) {
+        case ESPB_V128_LOAD:
+        case ESPB_V128_STORE: { // V, Ra, offset16
+#if CONFIG_ESPB_SANDBOX_MASKED
+            // Запас песочницы за памятью рассчитан на доступы до 8 байт
+            return false;
+#else
+            int16_t offset;
+            memcpy(&offset, a + 2, sizeof(offset));
+            if (a[0] > 254) return false;
+            emit_addi_phys(ctx, 10, 18, a[0] * 8);
+            emit_lw_phys(ctx, 11, a[1] * 8, 18);
+            if (offset >= -2048 && offset < 2048) {
+                if (offset != 0) emit_addi_phys(ctx, 11, 11, offset);
+            } else {
+                jit_emit_li(ctx, 5, offset);
+                emit_add_phys(ctx, 11, 11, 5);
+            }
+            emit_call_helper(ctx, sub_op == ESPB_V128_LOAD ? (uintptr_t)espb_v128_load
+                                                           : (uintptr_t)espb_v128_store);
+            return true;
+#endif
+        }
+        case ESPB_V128_CONST: { // Vd, imm[16]
+            if (a[0] > 254) return false;
+            for (int w = 0; w < 4; w++) {
+                uint32_t word;
+                memcpy(&word, a + 1 + 4 * w, sizeof(word));
+                uint8_t src = 0;
+                if (word != 0) {
+                    jit_emit_li(ctx, 5, (int32_t)word);
+                    src = 5;
+                }
+                emit_sw_phys(ctx, src, a[0] * 8 + 4 * w, 18);
+            }
+            return true;
+        }
+        case ESPB_V128_I8X16_SPLAT:
+        case ESPB_V128_I16X8_SPLAT:
+        case ESPB_V128_I32X4_SPLAT: // Vd, Rs
+            if (a[0] > 254) return false;
+            emit_addi_phys(ctx, 10, 18, a[0] * 8);
+            emit_lw_phys(ctx, 11, a[1] * 8, 18);
+            emit_call_helper(ctx, (uintptr_t)espb_v128_splat_op(sub_op));
+            return true;
+        case ESPB_V128_I16X8_EXTRACT_LANE_S: // Rd, Vs, lane
+            if (a[1] > 254 || a[2] >= 8) return false;
+            emit_lw_phys(ctx, 5, a[1] * 8 + (a[2] >> 1) * 4, 18);
+            if ((a[2] & 1) == 0) emit_slli_phys(ctx, 5, 5, 16);
+            emit_srai_phys(ctx, 5, 5, 16);
+            emit_sw_phys(ctx, 5, a[0] * 8, 18);
+            return true;
+        case ESPB_V128_I32X4_EXTRACT_LANE: // Rd, Vs, lane
+            if (a[1] > 254 || a[2] >= 4) return false;
+            emit_lw_phys(ctx, 5, a[1] * 8 + a[2] * 4, 18);
+            emit_sw_phys(ctx, 5, a[0] * 8, 18);
+            return true;
+        case ESPB_V128_I32X4_REPLACE_LANE: { // Vd, Va, Rs, lane
+            // Va и Rs читаются целиком до записи: Vd может их перекрывать
+            static const uint8_t tmp[4] = { 5, 6, 7, 29 };
+            if (a[0] > 254 || a[1] > 254 || a[3] >= 4) return false;
+            emit_lw_phys(ctx, 30, a[2] * 8, 18);
+            for (int w = 0; w < 4; w++) emit_lw_phys(ctx, tmp[w], a[1] * 8 + 4 * w, 18);
+            for (int w = 0; w < 4; w++) {
+                emit_sw_phys(ctx, w == a[3] ? 30 : tmp[w], a[0] * 8 + 4 * w, 18);
+            }
+            return true;
+        }
+        case ESPB_V128_I8X16_SHUFFLE: { // Vd, Va, Vb, lanes[16]
+            uint32_t w[3];
+            if (a[0] > 254 || a[1] > 254 || a[2] > 254) return false;
+            for (int i = 0; i < 16; i++) {
+                if (a[3 + i] >= 32) return false;
+            }
+            espb_v128_shuffle_pack(a + 3, w);
+            emit_addi_phys(ctx, 10, 18, a[0] * 8);
+            emit_addi_phys(ctx, 11, 18, a[1] * 8);
+            emit_addi_phys(ctx, 12, 18, a[2] * 8);
+            for (int i = 0; i < 3; i++) jit_emit_li(ctx, (uint8_t)(13 + i), (int32_t)w[i]);
+            emit_call_helper(ctx, (uintptr_t)espb_v128_shuffle_packed);
+            return true;
+        }
+        default: { // Vd, Va[, Vb]
+            EspbV128Op fn = espb_v128_op(sub_op);
+            uint8_t vb = espb_v128_is_unary(sub_op) ? a[1] : a[2];
+            if (!fn || a[0] > 254 || a[1] > 254 || vb > 254) return false;
+            emit_addi_phys(ctx, 10, 18, a[0] * 8);
+            emit_addi_phys(ctx, 11, 18, a[1] * 8);
+            emit_addi_phys(ctx, 12, 18, vb * 8);
+            emit_call_helper(ctx, (uintptr_t)fn);
+            return true;
+        }
     }
 }
 
-EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx, const EspbFunctionBody *body, void **out_code, size_t *out_size) {
-    if (!instance || !body || !out_code || !out_size) {
-        return ESPB_ERR_INVALID_OPERAND;
+#if CONFIG_ESPB_JIT_DIRECT_CALLS || CONFIG_ESPB_JIT_DIRECT_IMPORTS
+// Число инструкций opcode в теле: запас буфера под прямые пути (CALL/CALL_IMPORT),
+// наличие ALLOCA у callee прямого вызова
+static size_t jit_count_call_sites(const EspbFunctionBody* body, uint8_t opcode) {
+    const uint8_t* pc = body->code;
+    const uint8_t* end = body->code + body->code_size;
+    size_t count = 0;
+    while (pc < end) {
+        size_t len = (*pc == 0x16) ? 4 : espb_instruction_length(pc, end);
+        if (len == 0) break;
+        if (*pc == opcode) count++;
+        pc += len;
     }
+    return count;
+}
+#endif
 
-    if (body->is_jit_compiled) {
-        *out_code = body->jit_code;
-        *out_size = body->jit_code_size;
-        return ESPB_OK;
+#if CONFIG_ESPB_JIT_INLINE
+// ===== Встраивание небольших leaf-функций =====
+// CALL функции из линейного кода (без переходов, вызовов, импортов, ALLOCA и 0xFC/0xFD)
+// не длиннее CONFIG_ESPB_JIT_INLINE_MAX_BYTES компилируется на месте: её регистры живут в
+// области кадра вызывающей функции (s0 + inline_base), s2 на время тела указывает туда.
+// Вызов jit_call_espb_function, alloca кадра и копирование через C не нужны.
+#define JIT_INLINE_MAX_REGS 32
+
+static bool jit_inline_opcode_ok(uint8_t op) {
+    return op <= 0x01 || (op >= 0x10 && op <= 0x13) || (op >= 0x18 && op <= 0x1F) ||
+           (op >= 0x20 && op <= 0x6F) || (op >= 0x70 && op <= 0x89) ||
+           (op >= 0x90 && op <= 0xD6) || (op >= 0xE0 && op <= 0xEB);
+}
+
+// Тело callee, если CALL local_idx из функции func_idx можно встроить, иначе NULL
+static const EspbFunctionBody* jit_inline_callee(EspbInstance* instance, uint32_t func_idx, uint16_t local_idx) {
+    const EspbModule* module = instance->module;
+    if (local_idx >= module->num_functions || local_idx + module->num_imported_funcs == func_idx) return NULL;
+    const EspbFunctionBody* callee = &module->function_bodies[local_idx];
+    if (callee->code_size > CONFIG_ESPB_JIT_INLINE_MAX_BYTES ||
+        callee->header.num_virtual_regs > JIT_INLINE_MAX_REGS) {
+        return NULL;
     }
+    if (espb_ensure_function_ready(module, local_idx) != ESPB_OK) return NULL;
 
-    const uint8_t* bytecode = body->code;
-    const uint8_t* end = bytecode + body->code_size;
-    
-    // Reduce to 20x and cap at 32KB to avoid heap exhaustion on large functions
-    size_t jit_buffer_size = body->code_size * 20;
-    const size_t MAX_JIT_BUFFER = 32 * 1024;
-    if (jit_buffer_size > MAX_JIT_BUFFER) jit_buffer_size = MAX_JIT_BUFFER;
-    if (jit_buffer_size == 0) {
-        *out_code = NULL;
-        *out_size = 0;
-        return ESPB_OK;
+    const uint8_t* pc = callee->code;
+    const uint8_t* end = pc + callee->code_size;
+    while (pc < end) {
+        if (*pc == 0x0F) return callee; // Код после первого END недостижим
+        size_t len = espb_instruction_length(pc, end);
+        if (len == 0 || !jit_inline_opcode_ok(*pc)) return NULL;
+        pc += len;
     }
+    return NULL;
+}
 
-    uint8_t* exec_buffer = (uint8_t*)espb_exec_alloc(jit_buffer_size);
-    if (!exec_buffer) {
-        printf("JIT ERROR: Failed to allocate %zu bytes of executable memory\n", jit_buffer_size);
-        return ESPB_ERR_MEMORY_ALLOC;
+// Запас буфера под встроенные тела; *out_max_regs - наибольшее число регистров callee
+static size_t jit_inline_scan(EspbInstance* instance, uint32_t func_idx, const EspbFunctionBody* body,
+                              uint16_t* out_max_regs) {
+    const uint8_t* pc = body->code;
+    const uint8_t* end = body->code + body->code_size;
+    size_t extra = 0;
+    *out_max_regs = 0;
+    while (pc < end) {
+        size_t len = (*pc == 0x16) ? 4 : espb_instruction_length(pc, end);
+        if (len == 0) break;
+        if (*pc == 0x0A) {
+            uint16_t local_idx;
+            memcpy(&local_idx, pc + 1, sizeof(local_idx));
+            const EspbFunctionBody* callee = jit_inline_callee(instance, func_idx, local_idx);
+            if (callee) {
+                uint16_t regs = callee->header.num_virtual_regs;
+                if (regs > *out_max_regs) *out_max_regs = regs;
+                // Тело, копирование аргументов и обнуление кадра, возврат результата
+                extra += callee->code_size * 20 + (size_t)regs * 16 + 32;
+            }
+        }
+        pc += len;
     }
-    
-    // Проверяем, что память действительно в IRAM/ROM.
-    // На ESP32-C6 esp_ptr_in_dram() может возвращать true даже для IRAM-адресов,
-    // поэтому запрещаем только если адрес НЕ в IRAM и НЕ в ROM.
-    if (!esp_ptr_in_iram(exec_buffer) && !esp_ptr_in_rom(exec_buffer)) {
-        printf("JIT: exec_buffer not in IRAM/ROM: %p\n", exec_buffer);
-        heap_caps_free(exec_buffer);
-        return ESPB_ERR_MEMORY_ALLOC;
+    return extra;
+}
+#endif
+
+#if CONFIG_ESPB_JIT_DIRECT_CALLS
+// ===== Прямые вызовы JIT -> JIT =====
+// CALL читает function_bodies[idx].jit_code во время выполнения (через s1, без абсолютных
+// адресов — код остаётся пригодным для снимка). Если callee уже скомпилирован, кадр его
+// регистров строится прямо на стеке и управление передаётся jalr на его вход; иначе
+// выполняется обычный jit_call_espb_function, который компилирует или интерпретирует callee.
+// Следующий вызов после публикации кода пойдёт напрямую — отдельного патчинга не нужно.
+// Если в callee есть ALLOCA, вызов обрамляется espb_jit_alloca_mark/restore (метка лежит
+// в кадре за регистрами), как быстрый путь jit_call_espb_function: иначе блоки callee
+// копились бы на стеке ALLOCA задачи до выхода из самого внешнего JIT-вызова.
+
+#define JIT_DIRECT_CALL_MAX_ZERO    8    // Регистров callee, обнуляемых inline (сверх аргументов)
+#define JIT_DIRECT_CALL_MAX_BYTES   320  // Верхняя оценка кода прямого пути одного CALL
+
+// Код прямого пути CALL. Возвращает false, если callee ему не подходит (тогда остаётся
+// только вызов через helper). При true *out_done_jump — переход в обход helper-пути,
+// который нужно направить за него через jit_finish_direct_call().
+static bool jit_emit_direct_call(JitContext* ctx, const EspbModule* module, uint16_t local_idx,
+                                 size_t* out_done_jump) {
+#if ESPB_JIT_EVICTION
+    // LRU-метку вызова ставит jit_call_espb_function
+    (void)ctx; (void)module; (void)local_idx; (void)out_done_jump;
+    return false;
+#else
+    if (local_idx >= module->num_functions) return false;
+    const EspbFunctionBody* callee = &module->function_bodies[local_idx];
+    const EspbFuncSignature* sig = &module->signatures[module->function_signature_indices[local_idx]];
+
+    // Та же семантика кадра, что у jit_call_espb_function
+    uint32_t num_args = sig->num_params > 8 ? 8 : sig->num_params;
+    uint32_t needed_regs = callee->header.num_virtual_regs;
+    if (needed_regs == 0 || needed_regs > 256) needed_regs = 256;
+    uint32_t zero_regs = needed_regs;
+    uint32_t init_regs = ESPB_FRAME_ZERO_INIT_REGS(callee);
+    if (init_regs > 0 && init_regs < zero_regs) zero_regs = init_regs;
+    if (zero_regs < num_args) zero_regs = num_args;
+
+    // Тело callee нужно целиком: ALLOCA в нём требует метки стека ALLOCA вокруг вызова
+    if (espb_ensure_function_ready(module, local_idx) != ESPB_OK) return false;
+    bool callee_alloca = jit_count_call_sites(callee, 0x8F) > 0;
+
+    uint32_t mark_off = needed_regs * (uint32_t)sizeof(Value);
+    uint32_t frame = (mark_off + (callee_alloca ? 8u : 0u) + 15) & ~15u;
+    size_t entry_off = (size_t)local_idx * sizeof(EspbFunctionBody) + offsetof(EspbFunctionBody, jit_code);
+    if (frame > 2032 || zero_regs - num_args > JIT_DIRECT_CALL_MAX_ZERO || entry_off > INT16_MAX) {
+        return false;
     }
-    
-    // Проверяем выравнивание (RISC-V требует 4-byte alignment)
-    if (((uintptr_t)exec_buffer & 0x3) != 0) {
-        printf("JIT WARNING: exec_buffer not 4-byte aligned: %p\n", exec_buffer);
+
+    // t0 = instance->module->function_bodies[local_idx].jit_code
+    emit_lw_phys(ctx, 5, (int16_t)offsetof(EspbInstance, module), 9);
+    emit_lw_phys(ctx, 5, (int16_t)offsetof(EspbModule, function_bodies), 5);
+    emit_lw_phys(ctx, 5, (int16_t)entry_off, 5);
+    size_t slow_branch = ctx->offset;
+    emit_beq_phys(ctx, 5, 0, 0);
+
+    // Кадр регистров callee: аргументы из v_regs[0..n), затем обнуление
+    emit_addi_phys(ctx, 2, 2, -(int16_t)frame);
+    if (callee_alloca) {
+        // Helper затирает t0: вход callee переживает вызов в кадре рядом с меткой
+        emit_sw_phys(ctx, 5, (int16_t)(mark_off + 4), 2);
+        emit_call_helper(ctx, (uintptr_t)&espb_jit_alloca_mark);
+        emit_sw_phys(ctx, 10, (int16_t)mark_off, 2);
+        emit_lw_phys(ctx, 5, (int16_t)(mark_off + 4), 2);
+    }
+    for (uint32_t i = 0; i < num_args; i++) {
+        emit_lw_phys(ctx, 6, (int16_t)(i * 8), 18);
+        emit_sw_phys(ctx, 6, (int16_t)(i * 8), 2);
+        emit_lw_phys(ctx, 6, (int16_t)(i * 8 + 4), 18);
+        emit_sw_phys(ctx, 6, (int16_t)(i * 8 + 4), 2);
+    }
+    for (uint32_t i = num_args; i < zero_regs; i++) {
+        emit_sw_phys(ctx, 0, (int16_t)(i * 8), 2);
+        emit_sw_phys(ctx, 0, (int16_t)(i * 8 + 4), 2);
     }
 
-    JitContext ctx;
-    jit_context_init(&ctx, exec_buffer, jit_buffer_size);
-    
-    // CMP+BR_IF: Инициализация трекера
-    ctx.last_cmp_result_reg = 0xFF;  // Нет последнего CMP
-    ctx.last_cmp_in_t0 = false;
+    emit_addi_phys(ctx, 10, 9, 0); // a0 = instance
+    emit_addi_phys(ctx, 11, 2, 0); // a1 = кадр callee
+    emit_jalr_phys(ctx, 1, 5, 0);  // jalr ra, t0
 
-    // ✅ Извлекаем JIT метаданные из заголовка
-    const EspbFuncHeader *header = &body->header;
-    uint8_t flags = header->flags;
-    uint8_t max_reg_used = header->max_reg_used;
-    uint16_t frame_size = header->frame_size;
-    uint16_t num_virtual_regs = header->num_virtual_regs;
-    
-    
-    // ✅ Вычисляем размер стек фрейма с учетом spill area и saved registers
-    // Базовый размер: ra(4) + fp(4) + s1(4) + s2(4) + s9(4) + frame_size (spill area)
-    bool is_leaf = (flags & ESPB_FUNC_FLAG_IS_LEAF) != 0;
-    bool no_spill = (flags & ESPB_FUNC_FLAG_NO_SPILL) != 0;  // 🔥 регистры без spill
+    if (sig->num_returns > 0) {
+        emit_lw_phys(ctx, 6, 0, 2);
+        emit_sw_phys(ctx, 6, 0, 18);
+        emit_lw_phys(ctx, 6, 4, 2);
+        emit_sw_phys(ctx, 6, 4, 18);
+    }
+    if (callee_alloca) {
+        emit_lw_phys(ctx, 10, (int16_t)mark_off, 2);
+        emit_call_helper(ctx, (uintptr_t)&espb_jit_alloca_restore);
+    }
+    emit_addi_phys(ctx, 2, 2, (int16_t)frame);
 
-    // NO_SPILL fast-path eligibility: only for leaf + i32-only + small vreg count
-    bool i32_only = true;
-    if (no_spill) {
-        // быстрый скан байткода на наличие 64-bit/F64 опкодов
-        const uint8_t* scan = body->code;
-        const uint8_t* scan_end = body->code + body->code_size;
-        while (scan < scan_end) {
-            uint8_t op = *scan++;
-            switch (op) {
-                case 0x85: // LOAD.I64
-                case 0x76: // STORE.I64
-                case 0x19: // LDC.I64.IMM
-                case 0x1B: // LDC.F64.IMM
-                case 0x30: // ADD.I64
-                case 0x31: // SUB.I64
-                case 0x32: // MUL.I64
-                case 0x33: // DIVS.I64
-                case 0x34: // REMS.I64
-                case 0x36: // DIVU.I64
-                case 0x37: // REMU.I64
-                case 0x38: // AND.I64
-                case 0x39: // OR.I64
-                case 0x3A: // XOR.I64
-                case 0x3B: // SHL.I64
-                case 0x3C: // SHR.I64
-                case 0x3D: // USHR.I64
-                case 0x3E: // NOT.I64
-                case 0x68: // ADD.F64
-                case 0x69: // SUB.F64
-                case 0x6A: // MUL.F64
-                case 0x6B: // DIV.F64
-                case 0xAF: // CVT.U32.F64
-                case 0xB1: // CVT.U64.F64
-                case 0x9B: // ZEXT.I32.I64
-                case 0xA0: // SEXT.I32.I64
-                case 0xA1:
-                case 0x90: // TRUNC.I64.I32
-                    i32_only = false;
-                    scan = scan_end;
-                    break;
-                default:
-                    // skip immediate payloads (minimal, only handle known immediate-length ops)
-                    if (op == 0x18) { // LDC.I32.IMM: op, rd, imm32
-                        scan += 1 + 4;
-                    } else if (op == 0x02) { // BR: op, off16
-                        scan += 2;
-                    } else if (op == 0x03) { // BR_IF: op, r, off16
-                        scan += 1 + 2;
-                    } else if (op == 0x0A) { // CALL: op, u16
-                        scan += 2;
-                    } else if (op == 0x0F) { // END
-                        // no payload
-                    } else {
-                        // fallback: most ops are 3-reg (rd,rs1,rs2)
-                        scan += 3;
-                    }
-                    break;
+    *out_done_jump = ctx->offset;
+    emit_jal_phys(ctx, 0, 0);
+
+    // beqz t0 -> helper-путь, который начинается здесь
+    uint32_t ins = encode_branch_instr(0b000, 5, 0, (int16_t)(ctx->offset - slow_branch));
+    memcpy(ctx->buffer + slow_branch, &ins, 4);
+    return true;
+#endif
+}
+
+static void jit_finish_direct_call(JitContext* ctx, size_t done_jump) {
+    uint32_t ins = encode_jal_instr(0, (int32_t)(ctx->offset - done_jump));
+    memcpy(ctx->buffer + done_jump, &ins, 4);
+}
+
+#endif
+
+#if CONFIG_ESPB_JIT_DIRECT_IMPORTS
+// ===== Прямой вызов импорта по известной сигнатуре =====
+// Аргументы грузятся из v_regs прямо в a0..a7 по ilp32, затем jalr на
+// resolved_import_funcs[idx] (адрес читается из instance в рантайме, код остаётся
+// пригодным для snapshot). Без libffi и без tmp-массивов espb_jit_call_import.
+// Аргументы, не помещающиеся в a0..a7, и FP-типы при hard-float ABI (ilp32f: float
+// идёт в fa0..) оставляем generic helper'у.
+
+// Сколько a-регистров занимает значение типа t; 0 — тип прямому пути не подходит
+#define JIT_DIRECT_IMPORT_MAX_BYTES 160  // 8 узких аргументов + кадр + вызов
+
+static uint8_t jit_import_abi_words(EspbValueType t) {
+    switch (t) {
+        case ESPB_TYPE_I8: case ESPB_TYPE_U8: case ESPB_TYPE_I16: case ESPB_TYPE_U16:
+        case ESPB_TYPE_I32: case ESPB_TYPE_U32: case ESPB_TYPE_BOOL: case ESPB_TYPE_PTR:
+            return 1;
+        case ESPB_TYPE_I64: case ESPB_TYPE_U64:
+            return 2;
+#if defined(__riscv_float_abi_soft)
+        case ESPB_TYPE_F32: return 1;
+        case ESPB_TYPE_F64: return 2;
+#endif
+        default:
+            return 0;
+    }
+}
+
+static bool jit_emit_direct_import_call(JitContext* ctx, const EspbInstance* instance, uint16_t import_idx) {
+    const EspbFuncSignature* sig = NULL;
+    if (!espb_jit_import_can_call_direct(instance, import_idx, &sig, NULL)) return false;
+    if ((uint32_t)import_idx * 4u > 2047u) return false;
+    if (sig->num_returns > 1) return false;
+
+    uint8_t words = 0;
+    for (uint8_t i = 0; i < sig->num_params; i++) {
+        uint8_t w = jit_import_abi_words(sig->param_types[i]);
+        if (w == 0) return false;
+        words += w;
+        if (words > 8) return false;
+    }
+    EspbValueType ret_t = sig->num_returns ? sig->return_types[0] : ESPB_TYPE_VOID;
+    if (ret_t != ESPB_TYPE_VOID && jit_import_abi_words(ret_t) == 0) return false;
+
+    // Тот же мини-кадр, что у helper-пути: ra не сохранён прологом leaf-функции
+    emit_addi_phys(ctx, 2, 2, -16);
+    emit_sw_phys(ctx, 18, 0, 2);
+    emit_sw_phys(ctx, 1, 4, 2);
+
+    // t0 = instance->resolved_import_funcs[import_idx]
+    emit_lw_phys(ctx, 5, (int16_t)offsetof(EspbInstance, resolved_import_funcs), 9);
+    emit_lw_phys(ctx, 5, (int16_t)(import_idx * 4), 5);
+
+    uint8_t a = 10;
+    for (uint8_t i = 0; i < sig->num_params; i++) {
+        EspbValueType t = sig->param_types[i];
+        emit_lw_phys(ctx, a, (int16_t)(i * 8), 18);
+        switch (t) {
+            // ABI: узкие целые расширяются до XLEN вызывающей стороной
+            case ESPB_TYPE_I8:  emit_slli_phys(ctx, a, a, 24); emit_srai_phys(ctx, a, a, 24); break;
+            case ESPB_TYPE_U8:  emit_slli_phys(ctx, a, a, 24); emit_srli_phys(ctx, a, a, 24); break;
+            case ESPB_TYPE_I16: emit_slli_phys(ctx, a, a, 16); emit_srai_phys(ctx, a, a, 16); break;
+            case ESPB_TYPE_U16: emit_slli_phys(ctx, a, a, 16); emit_srli_phys(ctx, a, a, 16); break;
+            default: break;
+        }
+        a++;
+        if (jit_import_abi_words(t) == 2) {
+            emit_lw_phys(ctx, a, (int16_t)(i * 8 + 4), 18);
+            a++;
+        }
+    }
+
+    emit_jalr_phys(ctx, 1, 5, 0);
+
+    // Результат в v_regs[0], как espb_runtime_store_ffi_ret
+    if (ret_t != ESPB_TYPE_VOID) {
+        emit_sw_phys(ctx, 10, 0, 18);
+        if (jit_import_abi_words(ret_t) == 2) emit_sw_phys(ctx, 11, 4, 18);
+    }
+
+    emit_lw_phys(ctx, 18, 0, 2);
+    emit_lw_phys(ctx, 1, 4, 2);
+    emit_addi_phys(ctx, 2, 2, 16);
+    return true;
+}
+#endif
+
+#if CONFIG_ESPB_JIT_REGALLOC
+// ===== Linear-scan распределение регистров =====
+// Горячие vreg держим в callee-saved s3, s8..s11 (s0/s1/s2 — fp/instance/v_regs,
+// s4..s7 — stable-кеш F32/F64). В регистре живёт только младшее слово Value,
+// старшее всегда остаётся в v_regs[].
+//
+// Интервал vreg — оболочка всех точек, где он жив, на линеаризованном CFG
+// (live-in/live-out блоков плюс вхождения). Закрепление vreg -> s-регистр общее
+// на всю функцию, поэтому переходы и границы блоков не требуют перестановок.
+// Барьеры (вызовы, ALLOCA, CMPXCHG, глобалы, END) работают с v_regs[] через указатель:
+// перед ними живые значения сбрасываются в память, после — перечитываются.
+//
+// Кодогенерация опкодов не меняется: emit_lw/sw_phys по базе s2 для закреплённого vreg
+// превращаются в mv. Доступ к vreg, не объявленный разбором инструкции, или любое другое
+// использование s2 помечают компиляцию неудачной — функция компилируется заново без аллокатора.
+
+#define JIT_RA_NUM_PHYS     5
+#define JIT_RA_MAX_BLOCKS   256
+#define JIT_RA_SET_WORDS    8   // 256-битное множество vreg
+#define JIT_RA_MAX_READS    16
+#define JIT_RA_MAX_DEPTH    4   // Вес вхождения: 8^глубина цикла
+
+static const uint8_t s_jit_ra_pool[JIT_RA_NUM_PHYS] = { 19, 24, 25, 26, 27 }; // s3, s8..s11
+
+struct JitRegAlloc {
+    uint8_t phys[256];                      // vreg -> s-регистр (0 = только в памяти)
+    uint32_t start[256];                    // Интервал vreg в индексах инструкций
+    uint32_t end[256];
+    uint32_t entry_live[JIT_RA_SET_WORDS];  // Закреплённые vreg, живые на входе функции
+    uint32_t* insn_off;                     // Индекс инструкции -> смещение в байткоде
+    uint32_t num_insns;
+    uint8_t used_mask;                      // Бит k: задействован s_jit_ra_pool[k]
+};
+typedef struct JitRegAlloc JitRegAlloc;
+
+typedef enum {
+    JIT_RA_FLOW_NEXT = 0,
+    JIT_RA_FLOW_BR,
+    JIT_RA_FLOW_BR_IF,
+    JIT_RA_FLOW_BR_TABLE,
+    JIT_RA_FLOW_STOP,       // END / UNREACHABLE
+} JitRaFlow;
+
+typedef struct {
+    size_t len;
+    uint8_t flow;
+    bool barrier;
+    uint8_t num_reads;
+    uint8_t reads[JIT_RA_MAX_READS];    // Явно читаемые vreg (допускается надмножество)
+    uint8_t implicit_reads;             // Барьер читает R0..R(n-1): аргументы вызова, результат END
+    int16_t write;                      // Гарантированно записываемый vreg (-1 = нет)
+    size_t target;                      // BR/BR_IF: смещение цели
+    const uint8_t* table;               // BR_TABLE: смещения целей и default
+    uint32_t table_len;
+} JitRaInsn;
+
+static inline void jit_ra_set_add(uint32_t* set, uint32_t v) {
+    set[v >> 5] |= 1u << (v & 31);
+}
+
+static inline bool jit_ra_set_has(const uint32_t* set, uint32_t v) {
+    return ((set[v >> 5] >> (v & 31)) & 1u) != 0;
+}
+
+static uint8_t jit_ra_sig_params(const EspbModule* module, uint32_t sig_idx, uint8_t cap) {
+    if (sig_idx >= module->num_signatures) return cap;
+    uint32_t n = module->signatures[sig_idx].num_params;
+    return (uint8_t)(n < cap ? n : cap);
+}
+
+// Операнды инструкции для анализа живости. Чтения — консервативное надмножество,
+// запись указывается только там, где опкод всегда записывает младшее слово rd.
+static bool jit_ra_decode(const EspbModule* module, const uint8_t* code, size_t code_size,
+                          size_t off, JitRaInsn* d) {
+    const uint8_t* pc = code + off;
+    const uint8_t* a = pc + 1;
+    uint8_t op = pc[0];
+    // LDC.I16.IMM нет в таблице длин интерпретатора, JIT разбирает его как Rd, imm16
+    size_t len = (op == 0x16) ? 4 : espb_instruction_length(pc, code + code_size);
+    if (len == 0 || len > code_size - off) return false;
+
+    memset(d, 0, sizeof(*d));
+    d->len = len;
+    d->write = -1;
+
+    switch (op) {
+        case 0x00: case 0x01: case 0xEE: // NOP, ATOMIC.FENCE
+            break;
+        case 0x05: // UNREACHABLE
+            d->flow = JIT_RA_FLOW_STOP;
+            break;
+        case 0x0F: // END: результат берётся из v_regs[0]
+            d->flow = JIT_RA_FLOW_STOP;
+            d->barrier = true;
+            d->implicit_reads = 1;
+            break;
+        case 0x02: { // BR offset16 (от начала инструкции)
+            int16_t rel;
+            memcpy(&rel, a, sizeof(rel));
+            d->flow = JIT_RA_FLOW_BR;
+            d->target = (size_t)((ptrdiff_t)off + rel);
+            break;
+        }
+        case 0x03: { // BR_IF Rcond, offset16
+            int16_t rel;
+            memcpy(&rel, a + 1, sizeof(rel));
+            d->reads[d->num_reads++] = a[0];
+            d->flow = JIT_RA_FLOW_BR_IF;
+            d->target = (size_t)((ptrdiff_t)off + rel);
+            break;
+        }
+        case 0x04: { // BR_TABLE Ridx, num_targets(u16), targets[], default (от конца инструкции)
+            uint16_t num_targets;
+            memcpy(&num_targets, a + 1, sizeof(num_targets));
+            d->reads[d->num_reads++] = a[0];
+            d->flow = JIT_RA_FLOW_BR_TABLE;
+            d->table = a + 3;
+            d->table_len = (uint32_t)num_targets + 1;
+            break;
+        }
+        case 0x09: { // CALL_IMPORT import_idx(u16) [0xAA num_args types[]]
+            uint16_t import_idx;
+            memcpy(&import_idx, a, sizeof(import_idx));
+            d->barrier = true;
+            if (len > 4 && a[2] == 0xAA) {
+                d->implicit_reads = a[3] < 16 ? a[3] : 16;
+            } else if (import_idx < module->num_imports &&
+                       module->imports[import_idx].kind == ESPB_IMPORT_KIND_FUNC) {
+                d->implicit_reads = jit_ra_sig_params(module, module->imports[import_idx].desc.func.type_idx, 16);
+            } else {
+                d->implicit_reads = 16;
+            }
+            break;
+        }
+        case 0x0A: { // CALL local_func_idx(u16): jit_call_espb_function передаёт до 8 аргументов
+            uint16_t local_idx;
+            memcpy(&local_idx, a, sizeof(local_idx));
+            d->barrier = true;
+            d->implicit_reads = (local_idx < module->num_functions)
+                ? jit_ra_sig_params(module, module->function_signature_indices[local_idx], 8)
+                : 8;
+            break;
+        }
+        case 0x0B: case 0x0D: { // CALL_INDIRECT / CALL_INDIRECT_PTR Rfunc, type_idx(u16)
+            uint16_t type_idx;
+            memcpy(&type_idx, a + 1, sizeof(type_idx));
+            d->barrier = true;
+            d->reads[d->num_reads++] = a[0];
+            d->implicit_reads = jit_ra_sig_params(module, type_idx, 32);
+            break;
+        }
+        case 0x1D: case 0x1E: { // LD_GLOBAL_ADDR / LD_GLOBAL Rd, idx(u16)
+            uint16_t idx;
+            memcpy(&idx, a + 1, sizeof(idx));
+            bool direct = (op == 0x1E || !(idx & 0x8000)) && espb_jit_global_direct_size(module, idx, false) != 0;
+            if (direct) d->write = a[0];
+            else d->barrier = true; // helper пишет &v_regs[rd]
+            break;
+        }
+        case 0x1F: { // ST_GLOBAL idx(u16), Rs
+            uint16_t idx;
+            memcpy(&idx, a, sizeof(idx));
+            d->barrier = espb_jit_global_direct_size(module, idx, true) == 0;
+            d->reads[d->num_reads++] = a[2];
+            break;
+        }
+        case 0x8F: // ALLOCA Rd, Rs, align
+            d->barrier = true;
+            d->reads[d->num_reads++] = a[0];
+            d->reads[d->num_reads++] = a[1];
+            break;
+        case 0xDD: case 0xF6: // ATOMIC.RMW.CMPXCHG Rd, Ra, Rexp, Rdes
+            d->barrier = true;
+            for (int i = 0; i < 4; i++) d->reads[d->num_reads++] = a[i];
+            break;
+        case 0xFD: // V128: ядра работают с парами в v_regs[]; приёмник не помечен записью,
+                   // поэтому он остаётся живым через барьер и перечитывается после него
+            d->barrier = true;
+            d->num_reads = (uint8_t)espb_v128_reads(a[0], a + 1, d->reads);
+            break;
+
+        // Rd, imm
+        case 0x16: case 0x18: case 0x19: case 0x1A: case 0x1B: case 0x1C:
+            d->write = a[0];
+            break;
+
+        // Rd, Rs (+ imm8 / offset16)
+        case 0x10: case 0x11: case 0x12: case 0x13:
+        case 0x2E: case 0x3E: case 0x66: case 0x67: case 0x6E: case 0x6F:
+        case 0x90: case 0x92: case 0x93: case 0x94: case 0x95: case 0x96: case 0x97: case 0x98: case 0x99:
+        case 0x9B: case 0x9C: case 0x9D: case 0x9E: case 0x9F: case 0xA0: case 0xA1:
+        case 0xA4: case 0xA5: case 0xA6: case 0xA7: case 0xA8: case 0xA9: case 0xAA: case 0xAB:
+        case 0xAC: case 0xAD: case 0xAE: case 0xAF: case 0xB0: case 0xB1: case 0xB2: case 0xB3:
+        case 0xB4: case 0xB5: case 0xBC: case 0xBD:
+        case 0x40: case 0x41: case 0x42: case 0x43: case 0x44: case 0x45: case 0x46: case 0x47:
+        case 0x48: case 0x49: case 0x4A: case 0x4B:
+        case 0x50: case 0x51: case 0x52: case 0x53: case 0x54: case 0x55: case 0x56: case 0x58:
+        case 0x80: case 0x81: case 0x82: case 0x83: case 0x84: case 0x85: case 0x86: case 0x87:
+        case 0x88: case 0x89:
+            d->write = a[0];
+            d->reads[d->num_reads++] = a[1];
+            break;
+
+        // Rd, Rs1, Rs2
+        case 0x20: case 0x21: case 0x22: case 0x23: case 0x24: case 0x26: case 0x27:
+        case 0x28: case 0x29: case 0x2A: case 0x2B: case 0x2C: case 0x2D:
+        case 0x30: case 0x31: case 0x32: case 0x33: case 0x34: case 0x36: case 0x37:
+        case 0x38: case 0x39: case 0x3A: case 0x3B: case 0x3C: case 0x3D:
+        case 0x60: case 0x61: case 0x62: case 0x63: case 0x64: case 0x65:
+        case 0x68: case 0x69: case 0x6A: case 0x6B: case 0x6C: case 0x6D:
+        case 0xC0: case 0xC1: case 0xC2: case 0xC3: case 0xC4: case 0xC5: case 0xC6: case 0xC7:
+        case 0xC8: case 0xC9: case 0xCA: case 0xCB: case 0xCC: case 0xCD: case 0xCE: case 0xCF:
+        case 0xD0: case 0xD1: case 0xD2: case 0xD3:
+        case 0xE0: case 0xE1: case 0xE2: case 0xE3: case 0xE4: case 0xE5:
+        case 0xE6: case 0xE7: case 0xE8: case 0xE9: case 0xEA: case 0xEB:
+            d->write = a[0];
+            d->reads[d->num_reads++] = a[1];
+            d->reads[d->num_reads++] = a[2];
+            break;
+
+        // Rs, Ra, offset16
+        case 0x70: case 0x71: case 0x72: case 0x73: case 0x74: case 0x76:
+        case 0x78: case 0x79: case 0x7A: case 0x7B:
+            d->reads[d->num_reads++] = a[0];
+            d->reads[d->num_reads++] = a[1];
+            break;
+
+        // Rd, Rcond, Rtrue, Rfalse
+        case 0xBE: case 0xBF: case 0xD4: case 0xD5: case 0xD6:
+            d->write = a[0];
+            d->reads[d->num_reads++] = a[1];
+            d->reads[d->num_reads++] = a[2];
+            d->reads[d->num_reads++] = a[3];
+            break;
+
+        default:
+            // Остальные (атомики, 0xFC): каждый байт операндов считаем возможным чтением
+            if (len - 1 > JIT_RA_MAX_READS) return false;
+            for (size_t i = 1; i < len; i++) d->reads[d->num_reads++] = pc[i];
+            break;
+    }
+    return true;
+}
+
+static uint32_t jit_ra_num_succ(const JitRaInsn* d) {
+    switch (d->flow) {
+        case JIT_RA_FLOW_BR:       return 1;
+        case JIT_RA_FLOW_BR_IF:    return 2;
+        case JIT_RA_FLOW_BR_TABLE: return d->table_len;
+        case JIT_RA_FLOW_STOP:     return 0;
+        default:                   return 1;
+    }
+}
+
+// k-й преемник инструкции по смещению off (смещение в байткоде)
+static size_t jit_ra_succ(const JitRaInsn* d, size_t off, uint32_t k) {
+    size_t next = off + d->len;
+    switch (d->flow) {
+        case JIT_RA_FLOW_BR:
+            return d->target;
+        case JIT_RA_FLOW_BR_IF:
+            return k == 0 ? d->target : next;
+        case JIT_RA_FLOW_BR_TABLE: {
+            int16_t rel;
+            memcpy(&rel, d->table + (size_t)k * sizeof(int16_t), sizeof(rel));
+            return (size_t)((ptrdiff_t)next + rel);
+        }
+        default:
+            return next;
+    }
+}
+
+// Индекс инструкции, начинающейся по смещению off (UINT32_MAX — нет такой)
+static uint32_t jit_ra_insn_at(const uint32_t* insn_off, uint32_t n, size_t off) {
+    uint32_t lo = 0, hi = n;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (insn_off[mid] < off) lo = mid + 1; else hi = mid;
+    }
+    return (lo < n && insn_off[lo] == off) ? lo : UINT32_MAX;
+}
+
+// Блок, содержащий инструкцию insn (blk_first отсортирован, blk_first[0] == 0)
+static uint32_t jit_ra_block_at(const uint32_t* blk_first, uint32_t num_blocks, uint32_t insn) {
+    uint32_t lo = 0, hi = num_blocks;
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (blk_first[mid] <= insn) lo = mid; else hi = mid;
+    }
+    return lo;
+}
+
+static inline void jit_ra_extend(JitRegAlloc* ra, uint32_t v, uint32_t pos) {
+    if (pos < ra->start[v]) ra->start[v] = pos;
+    if (pos > ra->end[v]) ra->end[v] = pos;
+}
+
+static void jit_ra_free(JitRegAlloc* ra) {
+    if (!ra) return;
+    free(ra->insn_off);
+    free(ra);
+}
+
+// Анализ функции и распределение s-регистров. NULL — аллокатор не применяется
+// (неизвестный опкод, слишком много блоков, нечего закреплять или нет памяти).
+static JitRegAlloc* jit_ra_build(const EspbInstance* instance, const EspbFunctionBody* body) {
+    const EspbModule* module = instance->module;
+    const uint8_t* code = body->code;
+    size_t code_size = body->code_size;
+    if (!module || !code || code_size == 0) return NULL;
+
+    // Размер v_regs[] у вызывающего: num_virtual_regs, 0 означает 256
+    uint32_t limit = body->header.num_virtual_regs;
+    if (limit == 0 || limit > 256) limit = 256;
+
+    JitRaInsn d;
+    uint32_t n = 0;
+    for (size_t off = 0; off < code_size; off += d.len) {
+        if (!jit_ra_decode(module, code, code_size, off, &d)) return NULL;
+        n++;
+    }
+
+    JitRegAlloc* ra = (JitRegAlloc*)calloc(1, sizeof(JitRegAlloc));
+    uint32_t* insn_off = (uint32_t*)malloc((size_t)n * sizeof(uint32_t));
+    uint8_t* leader = (uint8_t*)calloc(n, 1);
+    int16_t* depth_delta = (int16_t*)calloc((size_t)n + 1, sizeof(int16_t));
+    uint32_t* weight = (uint32_t*)calloc(256, sizeof(uint32_t));
+    uint32_t* blk_first = NULL;
+    uint32_t* sets = NULL;
+    if (!ra || !insn_off || !leader || !depth_delta || !weight) goto fail;
+    ra->insn_off = insn_off;
+    ra->num_insns = n;
+
+    uint32_t i = 0;
+    for (size_t off = 0; off < code_size; off += d.len) {
+        jit_ra_decode(module, code, code_size, off, &d);
+        insn_off[i++] = (uint32_t)off;
+    }
+
+    // Границы блоков и обратные дуги (тело цикла — [цель, ветвление])
+    leader[0] = 1;
+    for (i = 0; i < n; i++) {
+        jit_ra_decode(module, code, code_size, insn_off[i], &d);
+        if (d.flow == JIT_RA_FLOW_NEXT) continue;
+        if (i + 1 < n) leader[i + 1] = 1;
+        uint32_t num_succ = jit_ra_num_succ(&d);
+        for (uint32_t k = 0; k < num_succ; k++) {
+            size_t target = jit_ra_succ(&d, insn_off[i], k);
+            if (target == code_size) continue;
+            uint32_t ti = jit_ra_insn_at(insn_off, n, target);
+            if (ti == UINT32_MAX) goto fail;
+            leader[ti] = 1;
+            if (ti <= i) {
+                depth_delta[ti]++;
+                depth_delta[i + 1]--;
+            }
+        }
+    }
+
+    uint32_t num_blocks = 0;
+    for (i = 0; i < n; i++) num_blocks += leader[i];
+    if (num_blocks > JIT_RA_MAX_BLOCKS) goto fail;
+
+    // На блок: gen, kill, live-in, live-out
+    blk_first = (uint32_t*)malloc((size_t)num_blocks * sizeof(uint32_t));
+    sets = (uint32_t*)calloc((size_t)num_blocks * 4 * JIT_RA_SET_WORDS, sizeof(uint32_t));
+    if (!blk_first || !sets) goto fail;
+    #define RA_GEN(b)  (sets + ((size_t)(b) * 4 + 0) * JIT_RA_SET_WORDS)
+    #define RA_KILL(b) (sets + ((size_t)(b) * 4 + 1) * JIT_RA_SET_WORDS)
+    #define RA_IN(b)   (sets + ((size_t)(b) * 4 + 2) * JIT_RA_SET_WORDS)
+    #define RA_OUT(b)  (sets + ((size_t)(b) * 4 + 3) * JIT_RA_SET_WORDS)
+    #define RA_LAST(b) (((b) + 1 < num_blocks ? blk_first[(b) + 1] : n) - 1)
+
+    for (i = 0, num_blocks = 0; i < n; i++) {
+        if (leader[i]) blk_first[num_blocks++] = i;
+    }
+
+    for (uint32_t b = 0; b < num_blocks; b++) {
+        uint32_t* gen = RA_GEN(b);
+        uint32_t* kill = RA_KILL(b);
+        for (i = blk_first[b]; i <= RA_LAST(b); i++) {
+            jit_ra_decode(module, code, code_size, insn_off[i], &d);
+            for (uint32_t r = 0; r < d.num_reads; r++) {
+                if (!jit_ra_set_has(kill, d.reads[r])) jit_ra_set_add(gen, d.reads[r]);
+            }
+            for (uint32_t r = 0; r < d.implicit_reads; r++) {
+                if (!jit_ra_set_has(kill, r)) jit_ra_set_add(gen, r);
             }
+            if (d.write >= 0) jit_ra_set_add(kill, (uint32_t)d.write);
+        }
+    }
+
+    // Живость: итерации до неподвижной точки в обратном порядке блоков
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (uint32_t b = num_blocks; b-- > 0;) {
+            uint32_t last = RA_LAST(b);
+            uint32_t out[JIT_RA_SET_WORDS] = {0};
+            jit_ra_decode(module, code, code_size, insn_off[last], &d);
+            uint32_t num_succ = jit_ra_num_succ(&d);
+            for (uint32_t k = 0; k < num_succ; k++) {
+                size_t target = jit_ra_succ(&d, insn_off[last], k);
+                if (target == code_size) continue;
+                uint32_t sb = jit_ra_block_at(blk_first, num_blocks, jit_ra_insn_at(insn_off, n, target));
+                const uint32_t* succ_in = RA_IN(sb);
+                for (int w = 0; w < JIT_RA_SET_WORDS; w++) out[w] |= succ_in[w];
+            }
+            uint32_t* in = RA_IN(b);
+            const uint32_t* gen = RA_GEN(b);
+            const uint32_t* kill = RA_KILL(b);
+            for (int w = 0; w < JIT_RA_SET_WORDS; w++) {
+                uint32_t nin = gen[w] | (out[w] & ~kill[w]);
+                if (nin != in[w]) {
+                    in[w] = nin;
+                    changed = true;
+                }
+            }
+            memcpy(RA_OUT(b), out, sizeof(out));
+        }
+    }
+
+    // Интервалы: live-in/out на краях блоков плюс все вхождения; вес растёт с глубиной цикла
+    for (uint32_t v = 0; v < 256; v++) ra->start[v] = UINT32_MAX;
+    for (uint32_t b = 0; b < num_blocks; b++) {
+        for (uint32_t v = 0; v < 256; v++) {
+            if (jit_ra_set_has(RA_IN(b), v)) jit_ra_extend(ra, v, blk_first[b]);
+            if (jit_ra_set_has(RA_OUT(b), v)) jit_ra_extend(ra, v, RA_LAST(b));
+        }
+    }
+    int depth = 0;
+    for (i = 0; i < n; i++) {
+        depth += depth_delta[i];
+        uint32_t w = 1u << (3 * (depth < JIT_RA_MAX_DEPTH ? depth : JIT_RA_MAX_DEPTH));
+        jit_ra_decode(module, code, code_size, insn_off[i], &d);
+        for (uint32_t r = 0; r < d.num_reads; r++) {
+            jit_ra_extend(ra, d.reads[r], i);
+            weight[d.reads[r]] += w;
+        }
+        for (uint32_t r = 0; r < d.implicit_reads; r++) jit_ra_extend(ra, r, i);
+        if (d.write >= 0) {
+            jit_ra_extend(ra, (uint32_t)d.write, i);
+            weight[d.write] += w;
+        }
+    }
+
+    // Linear scan по возрастанию начала интервала; при нехватке регистров
+    // вытесняется активный интервал с меньшим весом
+    uint8_t order[256];
+    uint32_t num_cand = 0;
+    for (uint32_t v = 0; v < limit; v++) {
+        if (ra->start[v] == UINT32_MAX || weight[v] < 2) continue;
+        uint32_t j = num_cand++;
+        while (j > 0 && ra->start[order[j - 1]] > ra->start[v]) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = (uint8_t)v;
+    }
+
+    uint8_t owner[JIT_RA_NUM_PHYS];
+    bool busy[JIT_RA_NUM_PHYS] = {0};
+    for (uint32_t c = 0; c < num_cand; c++) {
+        uint8_t v = order[c];
+        int slot = -1;
+        for (int k = 0; k < JIT_RA_NUM_PHYS; k++) {
+            if (busy[k] && ra->end[owner[k]] < ra->start[v]) busy[k] = false;
+            if (!busy[k] && slot < 0) slot = k;
+        }
+        if (slot < 0) {
+            int victim = 0;
+            for (int k = 1; k < JIT_RA_NUM_PHYS; k++) {
+                if (weight[owner[k]] < weight[owner[victim]]) victim = k;
+            }
+            if (weight[owner[victim]] >= weight[v]) continue;
+            ra->phys[owner[victim]] = 0;
+            slot = victim;
+        }
+        busy[slot] = true;
+        owner[slot] = v;
+        ra->phys[v] = s_jit_ra_pool[slot];
+    }
+
+    for (uint32_t v = 0; v < 256; v++) {
+        if (ra->phys[v] == 0) continue;
+        for (int k = 0; k < JIT_RA_NUM_PHYS; k++) {
+            if (s_jit_ra_pool[k] == ra->phys[v]) ra->used_mask |= (uint8_t)(1u << k);
         }
+        if (jit_ra_set_has(RA_IN(0), v)) jit_ra_set_add(ra->entry_live, v);
+    }
+
+    #undef RA_GEN
+    #undef RA_KILL
+    #undef RA_IN
+    #undef RA_OUT
+    #undef RA_LAST
+
+    free(sets);
+    free(blk_first);
+    free(weight);
+    free(depth_delta);
+    free(leader);
+    if (ra->used_mask == 0) {
+        jit_ra_free(ra);
+        return NULL;
+    }
+    return ra;
+
+fail:
+    free(sets);
+    free(blk_first);
+    free(weight);
+    free(depth_delta);
+    free(leader);
+    if (ra) {
+        ra->insn_off = insn_off;
+        jit_ra_free(ra);
+    } else {
+        free(insn_off);
+    }
+    return NULL;
+}
+
+// Закреплённый s-регистр для доступа к v_regs[] по смещению (0 — доступ идёт в память)
+static uint8_t jit_ra_phys_for_access(JitContext* ctx, int16_t offset, const uint32_t* declared) {
+    if (ctx->ra_bypass || offset < 0 || (offset & 7) != 0) return 0;
+    uint32_t v = (uint32_t)offset >> 3;
+    if (v > 255) return 0;
+    uint8_t phys = ctx->ra->phys[v];
+    if (phys == 0) return 0;
+    if (!jit_ra_set_has(declared, v)) {
+        ctx->ra_failed = true;
+        return 0;
     }
+    return phys;
+}
+
+static bool jit_ra_intercept_lw(JitContext* ctx, uint8_t rd, int16_t offset) {
+    uint8_t phys = jit_ra_phys_for_access(ctx, offset, ctx->ra_reads);
+    if (phys == 0) return false;
+    if (rd != phys) emit_addi_phys(ctx, rd, phys, 0);
+    return true;
+}
+
+static bool jit_ra_intercept_sw(JitContext* ctx, uint8_t rs2, int16_t offset) {
+    uint8_t phys = jit_ra_phys_for_access(ctx, offset, ctx->ra_touch);
+    if (phys == 0) return false;
+    if (rs2 != phys) emit_addi_phys(ctx, phys, rs2, 0);
+    return true;
+}
+
+// Сброс (store) или перечитывание закреплённых vreg, живых в текущей инструкции
+static void jit_ra_sync(JitContext* ctx, bool store, bool only_v0) {
+    const JitRegAlloc* ra = ctx->ra;
+    uint32_t pos = ctx->ra_pos;
+    uint32_t count = only_v0 ? 1 : 256;
+    for (uint32_t v = 0; v < count; v++) {
+        uint8_t phys = ra->phys[v];
+        if (phys == 0 || pos < ra->start[v] || pos > ra->end[v]) continue;
+        if (store) {
+            emit_sw_phys(ctx, phys, (int16_t)(v * 8), 18);
+#if CONFIG_ESPB_JIT_STATS
+            ctx->spill_count++;
+#endif
+        } else {
+            emit_lw_phys(ctx, phys, (int16_t)(v * 8), 18);
+        }
+    }
+}
+
+static void jit_ra_begin_insn(JitContext* ctx, const EspbModule* module,
+                              const uint8_t* code, size_t code_size, size_t off) {
+    const JitRegAlloc* ra = ctx->ra;
+    JitRaInsn d;
+
+    memset(ctx->ra_reads, 0, sizeof(ctx->ra_reads));
+    memset(ctx->ra_touch, 0, sizeof(ctx->ra_touch));
+    ctx->ra_barrier = false;
+    ctx->ra_bypass = false;
+    if (ctx->ra_pos >= ra->num_insns || ra->insn_off[ctx->ra_pos] != off ||
+        !jit_ra_decode(module, code, code_size, off, &d)) {
+        ctx->ra_failed = true;
+        return;
+    }
+    for (uint32_t r = 0; r < d.num_reads; r++) {
+        jit_ra_set_add(ctx->ra_reads, d.reads[r]);
+        jit_ra_set_add(ctx->ra_touch, d.reads[r]);
+    }
+    if (d.write >= 0) jit_ra_set_add(ctx->ra_touch, (uint32_t)d.write);
+
+    if (d.barrier) {
+        ctx->ra_barrier = true;
+        ctx->ra_bypass = true;
+        // END читает только v_regs[0], остальные значения после возврата не нужны
+        jit_ra_sync(ctx, true, code[off] == 0x0F);
+    }
+}
+
+static void jit_ra_end_insn(JitContext* ctx, uint8_t opcode) {
+    if (ctx->ra_barrier && opcode != 0x0F) {
+        jit_ra_sync(ctx, false, false);
+    }
+    ctx->ra_barrier = false;
+    ctx->ra_bypass = false;
+    ctx->ra_pos++;
+}
+
+// Сохранение/восстановление задействованных s-регистров в кадре (offset идёт вниз)
+static void jit_ra_save_regs(JitContext* ctx, const JitRegAlloc* ra, int* offset, bool restore) {
+    for (int k = 0; k < JIT_RA_NUM_PHYS; k++) {
+        if (!(ra->used_mask & (1u << k))) continue;
+        *offset -= 4;
+        if (restore) {
+            emit_lw_phys(ctx, s_jit_ra_pool[k], (int16_t)*offset, 2);
+        } else {
+            emit_sw_phys(ctx, s_jit_ra_pool[k], (int16_t)*offset, 2);
+        }
+    }
+}
+
+static uint32_t jit_ra_saved_size(const JitRegAlloc* ra) {
+    uint32_t size = 0;
+    for (int k = 0; k < JIT_RA_NUM_PHYS; k++) {
+        if (ra->used_mask & (1u << k)) size += 4;
+    }
+    return size;
+}
+
+// Пролог: закреплённые vreg, живые на входе (аргументы, zero-init), читаются из v_regs[]
+static void jit_ra_load_entry(JitContext* ctx, const JitRegAlloc* ra) {
+    for (uint32_t v = 0; v < 256; v++) {
+        if (jit_ra_set_has(ra->entry_live, v)) {
+            emit_lw_phys(ctx, ra->phys[v], (int16_t)(v * 8), 18);
+        }
+    }
+}
+
+static inline void jit_ra_emit_r(JitContext* ctx, uint32_t funct7, uint32_t funct3,
+                                 uint8_t rd, uint8_t rs1, uint8_t rs2) {
+    emit_instr(ctx, (funct7 << 25) | ((uint32_t)rs2 << 20) | ((uint32_t)rs1 << 15) |
+                    (funct3 << 12) | ((uint32_t)rd << 7) | 0b0110011);
+}
+
+static inline void jit_ra_emit_i(JitContext* ctx, uint32_t funct3, uint8_t rd, uint8_t rs1, int32_t imm) {
+    emit_instr(ctx, (((uint32_t)imm & 0xFFF) << 20) | ((uint32_t)rs1 << 15) |
+                    (funct3 << 12) | ((uint32_t)rd << 7) | 0b0010011);
+}
+
+// Операнд-источник: закреплённый s-регистр или загрузка во временный
+static uint8_t jit_ra_src(JitContext* ctx, uint8_t vreg, uint8_t tmp) {
+    uint8_t phys = ctx->ra->phys[vreg];
+    if (phys != 0) return phys;
+    emit_lw_phys(ctx, tmp, (int16_t)(vreg * 8), 18);
+    return tmp;
+}
+
+// Запись результата, вычисленного в reg, в vreg (для незакреплённого — в память)
+static void jit_ra_commit(JitContext* ctx, uint8_t vreg, uint8_t reg) {
+    if (ctx->ra->phys[vreg] != reg) emit_sw_phys(ctx, reg, (int16_t)(vreg * 8), 18);
+}
+
+static inline uint8_t jit_ra_dst(const JitContext* ctx, uint8_t vreg, uint8_t tmp) {
+    uint8_t phys = ctx->ra->phys[vreg];
+    return phys != 0 ? phys : tmp;
+}
+
+// Прямая кодогенерация частых i32-опкодов по закреплённым регистрам.
+// Возвращает число прочитанных байт операндов (0 — опкод обрабатывает общий switch).
+static size_t jit_ra_try_emit(JitContext* ctx, uint8_t opcode, const uint8_t* pc) {
+    const uint8_t* phys = ctx->ra->phys;
+    if (ctx->ra_bypass) return 0;
+
+    switch (opcode) {
+        case 0x20: case 0x21: case 0x22: case 0x28: case 0x29: // ADD/SUB/MUL/AND/OR.I32
+        case 0x2A: case 0x2B: case 0x2C: case 0x2D: {          // XOR/SHL/SHRS/SHRU.I32
+            uint8_t rd = pc[0], rs1 = pc[1], rs2 = pc[2];
+            if (!phys[rd] && !phys[rs1] && !phys[rs2]) return 0;
+            uint32_t funct7 = 0, funct3 = 0;
+            switch (opcode) {
+                case 0x21: funct7 = 0x20; break;                 // sub
+                case 0x22: funct7 = 0x01; break;                 // mul
+                case 0x28: funct3 = 0b111; break;                // and
+                case 0x29: funct3 = 0b110; break;                // or
+                case 0x2A: funct3 = 0b100; break;                // xor
+                case 0x2B: funct3 = 0b001; break;                // sll
+                case 0x2C: funct7 = 0x20; funct3 = 0b101; break; // sra
+                case 0x2D: funct3 = 0b101; break;                // srl
+                default: break;                                  // add
+            }
+            uint8_t a = jit_ra_src(ctx, rs1, 5);
+            uint8_t b = jit_ra_src(ctx, rs2, 6);
+            uint8_t dst = jit_ra_dst(ctx, rd, 5);
+            jit_ra_emit_r(ctx, funct7, funct3, dst, a, b);
+            jit_ra_commit(ctx, rd, dst);
+            ctx->last_cmp_result_reg = 0xFF;
+            return 3;
+        }
+
+        case 0x40: case 0x41: case 0x47: case 0x48: // ADD/SUB/SHRS/SHRU.I32.IMM8
+        case 0x49: case 0x4A: case 0x4B: {          // AND/OR/XOR.I32.IMM8
+            uint8_t rd = pc[0], rs = pc[1];
+            int8_t imm = (int8_t)pc[2];
+            if (!phys[rd] && !phys[rs]) return 0;
+            uint8_t src = jit_ra_src(ctx, rs, 5);
+            uint8_t dst = jit_ra_dst(ctx, rd, 5);
+            switch (opcode) {
+                case 0x40: emit_addi_phys(ctx, dst, src, imm); break;
+                case 0x41: emit_addi_phys(ctx, dst, src, (int16_t)-imm); break;
+                case 0x47: jit_ra_emit_i(ctx, 0b101, dst, src, 0x400 | (pc[2] & 0x1F)); break; // srai
+                case 0x48: jit_ra_emit_i(ctx, 0b101, dst, src, pc[2] & 0x1F); break;          // srli
+                case 0x49: jit_ra_emit_i(ctx, 0b111, dst, src, imm); break;                   // andi
+                case 0x4A: jit_ra_emit_i(ctx, 0b110, dst, src, imm); break;                   // ori
+                default:   jit_ra_emit_i(ctx, 0b100, dst, src, imm); break;                   // xori
+            }
+            jit_ra_commit(ctx, rd, dst);
+            ctx->last_cmp_result_reg = 0xFF;
+            return 3;
+        }
+
+        case 0x12: { // MOV.32 Rd, Rs
+            uint8_t rd = pc[0], rs = pc[1];
+            if (!phys[rd] && !phys[rs]) return 0;
+            if (rd != rs) {
+                uint8_t src = jit_ra_src(ctx, rs, 5);
+                if (phys[rd]) {
+                    if (phys[rd] != src) emit_addi_phys(ctx, phys[rd], src, 0);
+                } else {
+                    emit_sw_phys(ctx, src, (int16_t)(rd * 8), 18);
+                }
+                // MOV.32 переносит Value целиком: старшее слово копируем через память
+                if (!ctx->regs32) {
+                    emit_lw_phys(ctx, 5, (int16_t)(rs * 8 + 4), 18);
+                    emit_sw_phys(ctx, 5, (int16_t)(rd * 8 + 4), 18);
+                }
+            }
+            return 2;
+        }
+
+        case 0x18: case 0x1C: { // LDC.I32.IMM / LDC.PTR.IMM Rd, imm32
+            uint8_t rd = pc[0];
+            if (!phys[rd]) return 0;
+            int32_t imm;
+            memcpy(&imm, pc + 1, sizeof(imm));
+            if (imm >= -2048 && imm < 2048) {
+                emit_addi_phys(ctx, phys[rd], 0, (int16_t)imm);
+            } else {
+                uint32_t hi = (((uint32_t)imm + 0x800) & 0xFFFFF000);
+                int16_t lo = (int16_t)(imm - (int32_t)hi);
+                emit_lui_phys(ctx, phys[rd], hi);
+                if (lo != 0) emit_addi_phys(ctx, phys[rd], phys[rd], lo);
+            }
+            return 5;
+        }
+
+        case 0x84: case 0x88: { // LOAD.I32 / LOAD.PTR Rd, Ra, offset16
+            uint8_t rd = pc[0], ra = pc[1];
+            if (!phys[rd] && !phys[ra]) return 0;
+            int16_t offset;
+            memcpy(&offset, pc + 2, sizeof(offset));
+            uint8_t base = jit_ra_src(ctx, ra, 5);
+            JIT_SANDBOX_ADDR(ctx, base, &offset);
+            uint8_t dst = jit_ra_dst(ctx, rd, 6);
+            emit_lw_phys(ctx, dst, offset, base);
+            jit_ra_commit(ctx, rd, dst);
+            if (opcode == 0x88) emit_sw_phys(ctx, 0, (int16_t)(rd * 8 + 4), 18); // ptr: hi = 0
+            return 4;
+        }
+
+        case 0x74: case 0x7A: { // STORE.I32 / STORE.PTR Rs, Ra, offset16
+            uint8_t rs = pc[0], ra = pc[1];
+            if (!phys[rs] && !phys[ra]) return 0;
+            int16_t offset;
+            memcpy(&offset, pc + 2, sizeof(offset));
+            uint8_t val = jit_ra_src(ctx, rs, 6);
+            uint8_t base = jit_ra_src(ctx, ra, 5);
+            JIT_SANDBOX_ADDR(ctx, base, &offset);
+            emit_sw_phys(ctx, val, offset, base);
+            return 4;
+        }
+
+        default:
+            return 0;
+    }
+}
+#endif
+
+static void jit_context_free(JitContext* ctx) {
+    if (ctx->patchpoints) {
+        free(ctx->patchpoints);
+        ctx->patchpoints = NULL;
+    }
+    if (ctx->labels) {
+        free(ctx->labels);
+        ctx->labels = NULL;
+    }
+#if CONFIG_ESPB_JIT_OSR
+    free(ctx->osr_headers);
+    free(ctx->osr_points);
+    free(ctx->osr_ra_pos);
+    ctx->osr_headers = NULL;
+    ctx->osr_points = NULL;
+    ctx->osr_ra_pos = NULL;
+#endif
+#if CONFIG_ESPB_FUEL
+    free(ctx->fuel_headers);
+    ctx->fuel_headers = NULL;
+#endif
+#if JIT_RV_HW_LOOPS
+    free(ctx->hwloops);
+    ctx->hwloops = NULL;
+#endif
+}
+
+#if CONFIG_ESPB_FUEL
+#define JIT_FUEL_CHECK_MAX_BYTES    48   // Верхняя оценка кода jit_emit_fuel_check
+
+_Static_assert(offsetof(EspbInstance, fuel) < 2048, "EspbInstance.fuel must be reachable with lw/sw imm12");
+
+// --instance->fuel; при <= 0 - espb_fuel_refill(instance). Портит ra (сохраняется здесь),
+// t0-t6 и a0-a7: вставляется только там, где в них ничего не кешировано.
+static void jit_emit_fuel_check(JitContext* ctx) {
+    const int16_t fuel_off = (int16_t)offsetof(EspbInstance, fuel);
+    emit_lw_phys(ctx, 5, fuel_off, 9);
+    emit_addi_phys(ctx, 5, 5, -1);
+    emit_sw_phys(ctx, 5, fuel_off, 9);
+    size_t skip_branch = ctx->offset;
+    emit_instr(ctx, encode_branch_instr(0b100, 0, 5, 0)); // blt zero, t0 -> топливо есть
+
+    // ra не сохранён прологом leaf-функции
+    emit_addi_phys(ctx, 2, 2, -16);
+    emit_sw_phys(ctx, 1, 12, 2);
+    emit_addi_phys(ctx, 10, 9, 0);
+    emit_call_helper(ctx, (uintptr_t)&espb_fuel_refill);
+    emit_lw_phys(ctx, 1, 12, 2);
+    emit_addi_phys(ctx, 2, 2, 16);
+
+    uint32_t ins = encode_branch_instr(0b100, 0, 5, (int16_t)(ctx->offset - skip_branch));
+    memcpy(ctx->buffer + skip_branch, &ins, 4);
+}
+
+// Списание на заголовке цикла bc_offset; clean - как у jit_osr_mark
+static void jit_fuel_mark(JitContext* ctx, size_t bc_offset, bool clean) {
+    while (ctx->fuel_next < ctx->fuel_num_headers && ctx->fuel_headers[ctx->fuel_next] < bc_offset) {
+        ctx->fuel_next++;
+    }
+    if (!clean || ctx->fuel_next == ctx->fuel_num_headers || ctx->fuel_headers[ctx->fuel_next] != bc_offset) return;
+    jit_emit_fuel_check(ctx);
+}
+#endif
+
+#if JIT_RV_HW_LOOPS
+// Эталонные esp.lp.setup, собранные тулчейном (только данные, не исполняются):
+//  [0..5] - rs1 = x0, x1, x2, x4, x8, x16 при d = 4 (d - расстояние до последней
+//  инструкции тела); далее rs1 = x0 и d = 516, 508, 260, 132, 68, 36, 28, 20, 12, 8
+//  до общей метки, слово с расстоянием d лежит в [(540 - d) / 4].
+__asm__(
+    ".pushsection .rodata.espb_jit_lp_ref, \"a\"\n"
+    ".option push\n"
+    ".option norelax\n"
+    ".balign 4\n"
+    ".type espb_jit_lp_ref, @object\n"
+    "espb_jit_lp_ref:\n"
+    "esp.lp.setup 0, x0, 1f\n1:\n"
+    "esp.lp.setup 0, x1, 1f\n1:\n"
+    "esp.lp.setup 0, x2, 1f\n1:\n"
+    "esp.lp.setup 0, x4, 1f\n1:\n"
+    "esp.lp.setup 0, x8, 1f\n1:\n"
+    "esp.lp.setup 0, x16, 1f\n1:\n"
+    "esp.lp.setup 0, x0, 2f\n.skip 4\n"
+    "esp.lp.setup 0, x0, 2f\n.skip 244\n"
+    "esp.lp.setup 0, x0, 2f\n.skip 124\n"
+    "esp.lp.setup 0, x0, 2f\n.skip 60\n"
+    "esp.lp.setup 0, x0, 2f\n.skip 28\n"
+    "esp.lp.setup 0, x0, 2f\n.skip 4\n"
+    "esp.lp.setup 0, x0, 2f\n.skip 4\n"
+    "esp.lp.setup 0, x0, 2f\n.skip 4\n"
+    "esp.lp.setup 0, x0, 2f\n"
+    "esp.lp.setup 0, x0, 2f\n.skip 4\n"
+    "2:\n"
+    ".size espb_jit_lp_ref, . - espb_jit_lp_ref\n"
+    ".option pop\n"
+    ".popsection\n");
+extern const uint32_t espb_jit_lp_ref[135];
+
+#define JIT_LP_REF(d)           espb_jit_lp_ref[(540u - (d)) / 4u]
+#define JIT_LP_MAX_DIST         1020 // d кратно 4: биты 2..9
+#define JIT_HWLOOP_MAX_BYTES    48   // Верхняя оценка setup + выравнивания + LAST
+
+// Поля инструкции, выведенные из эталонов: вклад каждого бита номера rs1 и d
+typedef struct {
+    uint32_t base;      // rs1 = x0, d = 0
+    uint32_t rs[5];
+    uint32_t d[8];      // d[k] - бит 2 + k
+} JitLpEncoding;
+
+static JitLpEncoding s_jit_lp_enc;
+static int8_t s_jit_lp_state;   // 0 - не проверено, 1 - годно, -1 - аппаратные циклы выключены
+
+static uint32_t jit_lp_encode(const JitLpEncoding* enc, uint8_t rs1, uint32_t d) {
+    uint32_t w = enc->base;
+    for (int j = 0; j < 5; j++) {
+        if (rs1 & (1u << j)) w ^= enc->rs[j];
+    }
+    for (int k = 0; k < 8; k++) {
+        if (d & (4u << k)) w ^= enc->d[k];
+    }
+    return w;
+}
+
+// Поля должны быть непустыми, непересекающимися и не задевать биты [1:0]
+// (32-битная инструкция), а составные расстояния - совпасть с эталонами
+static bool jit_lp_learn(JitLpEncoding* enc) {
+    const uint32_t* ref = espb_jit_lp_ref;
+    for (int j = 0; j < 5; j++) enc->rs[j] = ref[0] ^ ref[1 + j];
+    enc->d[0] = JIT_LP_REF(8) ^ JIT_LP_REF(12);
+    for (int k = 1; k < 8; k++) enc->d[k] = ref[0] ^ JIT_LP_REF(4u + (4u << k));
+    enc->base = ref[0] ^ enc->d[0];
+
+    uint32_t seen = 0;
+    for (int i = 0; i < 13; i++) {
+        uint32_t m = i < 5 ? enc->rs[i] : enc->d[i - 5];
+        if (m == 0 || (m & seen) || (m & 3u)) return false;
+        seen |= m;
+    }
+    return (enc->base & 3u) == 3u &&
+           jit_lp_encode(enc, 0, 28) == JIT_LP_REF(28) &&
+           jit_lp_encode(enc, 0, 508) == JIT_LP_REF(508) &&
+           jit_lp_encode(enc, 0, 4) == ref[0];
+}
+
+static bool jit_lp_ready(void) {
+    if (s_jit_lp_state == 0) {
+        bool ok = jit_lp_learn(&s_jit_lp_enc);
+        if (!ok) printf("JIT: esp.lp.setup references do not decode, hardware loops disabled\n");
+        s_jit_lp_state = ok ? 1 : -1;
+    }
+    return s_jit_lp_state > 0;
+}
+
+// Счётный внутренний цикл, те же формы, что у ESPB_JIT_XTENSA_HW_LOOPS:
+//   H: <тело без ветвлений> CMP Rc, Ri, Rn; BR_IF Rc, H            (продолжение, пока CMP)
+//   H: <тело без ветвлений> CMP Rc, Ri, Rn; BR_IF Rc, EXIT; BR H   (выход, когда CMP)
+// Ri шагает один раз ADD.I32.IMM8 Ri, Ri, 1, Rn не пишется или перезагружается тем же
+// LDC.I32.IMM, поэтому число проходов известно на H: n - i для NE (по модулю 2^32),
+// max(n - i, 1) для LT (do-while: хотя бы один проход).
+typedef struct JitHwLoop {
+    uint32_t header;
+    uint32_t br_if;     // Замыкающий BR_IF: перед ним - последняя инструкция тела (LAST)
+    uint32_t bound;     // n при bound_imm
+    uint8_t ri;
+    uint8_t rn;
+    uint8_t cmp;        // Условие продолжения: 0xC1 NE, 0xC2 LT.S, 0xC6 LT.U
+    bool bound_imm;
+} JitHwLoop;
+
+// Опкоды, которые генерируются без вызовов хелперов, patchpoint'ов и переходов за
+// пределы своего кода: C-код может сам использовать аппаратный цикл 0.
+static bool jit_hwloop_op_ok(uint8_t op) {
+    if (op >= 0x10 && op <= 0x12) return true;  // MOV
+    if (op >= 0x20 && op <= 0x22) return true;  // ADD/SUB/MUL.I32
+    if (op >= 0x28 && op <= 0x2E) return true;  // I32 bitwise/shifts
+    if (op >= 0x40 && op <= 0x4B) return true;  // I32 IMM8
+    if (op >= 0x70 && op <= 0x74) return true;  // STORE.I8..I32
+    if (op >= 0x80 && op <= 0x84) return true;  // LOAD.I8..I32
+    if (op >= 0xC0 && op <= 0xC9) return true;  // CMP.*.I32
+    return op == 0x00 || op == 0x01 || op == 0x18 || op == 0x7A || op == 0x7B ||
+           op == 0x88 || op == 0x89 || op == 0xBC || op == 0xBD;
+}
+
+// Битовая карта смещений байткода, на которые есть переходы. NULL - ADDR_OF
+// (запись по указателю может изменить Ri/Rn) или байткод не разбирается.
+static uint8_t* jit_hwloop_scan_targets(const uint8_t* code, size_t code_size) {
+    size_t bytes = (code_size >> 3) + 1;
+    uint8_t* targets = (uint8_t*)calloc(bytes, 1);
+    if (!targets) return NULL;
+
+    const uint8_t* end = code + code_size;
+    const uint8_t* p = code;
+    while (p < end) {
+        uint8_t op = *p;
+        size_t len = (op == 0x16) ? 4 : espb_instruction_length(p, end);
+        if (len == 0 || op == 0x8E) {
+            free(targets);
+            return NULL;
+        }
+        int32_t off = (int32_t)(p - code);
+        int16_t rel;
+        // BR/BR_IF - от начала инструкции, BR_TABLE - от её конца
+        if (op == 0x02 || op == 0x03) {
+            memcpy(&rel, p + (op == 0x02 ? 1 : 2), sizeof(rel));
+            int32_t t = off + rel;
+            if (t >= 0 && t <= (int32_t)code_size) targets[t >> 3] |= (uint8_t)(1u << (t & 7));
+        } else if (op == 0x04) {
+            uint16_t n;
+            memcpy(&n, p + 2, sizeof(n));
+            for (uint32_t i = 0; i <= n; i++) {
+                memcpy(&rel, p + 4 + i * 2, sizeof(rel));
+                int32_t t = off + (int32_t)len + rel;
+                if (t >= 0 && t <= (int32_t)code_size) targets[t >> 3] |= (uint8_t)(1u << (t & 7));
+            }
+        }
+        p += len;
+    }
+    return targets;
+}
+
+// Записи в Ri и Rn на [p, cmp): все допустимые опкоды, кроме STORE, пишут только первый операнд
+static bool jit_hwloop_check_regs(const uint8_t* p, const uint8_t* cmp, JitHwLoop* loop) {
+    bool stepped = false;
+    loop->bound_imm = false;
+    while (p < cmp) {
+        uint8_t op = p[0];
+        if (op < 0x70 || op > 0x7B) {
+            if (p[1] == loop->rn) {
+                if (loop->bound_imm || op != 0x18) return false;
+                memcpy(&loop->bound, p + 2, sizeof(loop->bound));
+                loop->bound_imm = true;
+            } else if (p[1] == loop->ri) {
+                if (stepped || op != 0x40 || p[2] != loop->ri || (int8_t)p[3] != 1) return false;
+                stepped = true;
+            }
+        }
+        p += espb_instruction_length(p, cmp);
+    }
+    return stepped;
+}
+
+static bool jit_hwloop_match(const uint8_t* code, size_t code_size, const uint8_t* targets,
+                             uint32_t header, uint32_t br_if, bool leave_on_cmp, JitHwLoop* out) {
+    const uint8_t* end = code + code_size;
+    const uint8_t* p = code + header;
+    const uint8_t* cmp = NULL;
+    while (p < code + br_if) {
+        uint32_t off = (uint32_t)(p - code);
+        // Вход в тело не через H миновал бы esp.lp.setup
+        if (off != header && (targets[off >> 3] & (1u << (off & 7)))) return false;
+        if (!jit_hwloop_op_ok(*p)) return false;
+        cmp = p;
+        p += espb_instruction_length(p, end);
+    }
+    if (p != code + br_if || !cmp || (targets[br_if >> 3] & (1u << (br_if & 7)))) return false;
+    if (leave_on_cmp) {
+        uint32_t br = br_if + 4;
+        if (targets[br >> 3] & (1u << (br & 7))) return false;
+    }
+
+    // Условие продолжения как CMP (Ri или Rn, Rn или Ri); вторая форма продолжает,
+    // пока её сравнение ложно
+    uint8_t op = cmp[0];
+    uint8_t rc = cmp[1], ra = cmp[2], rb = cmp[3];
+    if (rc != code[br_if + 1]) return false;
+    if (leave_on_cmp) {
+        switch (op) {
+            case 0xC0: op = 0xC1; break;                 // !(i == n): i != n
+            case 0xC4: op = 0xC3; break;                 // !(n <= i): n > i
+            case 0xC5: op = 0xC2; break;                 // !(i >= n): i < n
+            case 0xC8: op = 0xC7; break;
+            case 0xC9: op = 0xC6; break;
+            default: return false;
+        }
+    }
+    if (op == 0xC3 || op == 0xC7) {  // GT (n, i) == LT (i, n)
+        uint8_t t = ra; ra = rb; rb = t;
+        op = (uint8_t)(op - 1);
+    }
+    if (op != 0xC1 && op != 0xC2 && op != 0xC6) return false;
+    if (ra == rb || rc == ra || rc == rb) return false;
+
+    for (int swap = 0; swap < (op == 0xC1 ? 2 : 1); swap++) {
+        *out = (JitHwLoop){ .header = header, .br_if = br_if,
+                            .ri = swap ? rb : ra, .rn = swap ? ra : rb, .cmp = op };
+        if (jit_hwloop_check_regs(code + header, cmp, out)) return true;
+    }
+    return false;
+}
+
+// Циклы в порядке байткода (не пересекаются: в тело нет переходов).
+// NULL - циклов нет или кодирование esp.lp.setup не подтвердилось.
+static JitHwLoop* jit_hwloop_scan(const uint8_t* code, size_t code_size, size_t* out_count) {
+    *out_count = 0;
+    if (!jit_lp_ready()) return NULL;
+    uint8_t* targets = jit_hwloop_scan_targets(code, code_size);
+    if (!targets) return NULL;
+
+    const uint8_t* end = code + code_size;
+    size_t back_edges = 0;
+    for (const uint8_t* p = code; p < end; p += (*p == 0x16) ? 4 : espb_instruction_length(p, end)) {
+        if ((*p == 0x02 && (int8_t)p[2] < 0) || (*p == 0x03 && (int8_t)p[3] < 0)) back_edges++;
+    }
+    JitHwLoop* loops = back_edges ? (JitHwLoop*)malloc(back_edges * sizeof(JitHwLoop)) : NULL;
+    size_t count = 0;
+    for (const uint8_t* p = code; loops && p < end; p += (*p == 0x16) ? 4 : espb_instruction_length(p, end)) {
+        if (*p != 0x03) continue;
+        int32_t br_if = (int32_t)(p - code);
+        int16_t rel;
+        memcpy(&rel, p + 2, sizeof(rel));
+        int32_t target = br_if + rel;
+        if (target < 0 || target > (int32_t)code_size) continue;
+        if (rel < 0 && jit_hwloop_match(code, code_size, targets, (uint32_t)target, (uint32_t)br_if,
+                                        false, &loops[count])) {
+            count++;
+            continue;
+        }
+        // BR_IF Rc, EXIT; BR H
+        if (end - p < 7 || p[4] != 0x02) continue;
+        memcpy(&rel, p + 5, sizeof(rel));
+        int32_t header = br_if + 4 + rel;
+        if (rel >= 0 || header < 0 || (target >= header && target <= br_if + 4)) continue;
+        if (jit_hwloop_match(code, code_size, targets, (uint32_t)header, (uint32_t)br_if, true, &loops[count])) {
+            count++;
+        }
+    }
+    free(targets);
+    if (loops && count == 0) {
+        free(loops);
+        loops = NULL;
+    }
+    *out_count = count;
+    return loops;
+}
+
+static uint8_t jit_hwloop_src(JitContext* ctx, uint8_t vreg, uint8_t tmp) {
+#if CONFIG_ESPB_JIT_REGALLOC
+    if (ctx->ra && ctx->ra->phys[vreg] != 0) return ctx->ra->phys[vreg];
+#endif
+    emit_lw_phys(ctx, tmp, (int16_t)(vreg * 8), 18);
+    return tmp;
+}
+
+// На H (всё состояние в v_regs[] и закреплённых регистрах): t0 = число проходов,
+// затем esp.lp.setup 0, t0, LAST - пока заглушка nop, LAST ещё не известен.
+// t0 == 0 (NE при i == n: 2^32 проходов) оставляет обычный цикл.
+static void jit_hwloop_start(JitContext* ctx, const JitHwLoop* loop) {
+    uint8_t rn = 6;
+    if (loop->bound_imm) {
+        jit_emit_li(ctx, 6, (int32_t)loop->bound);
+    } else {
+        rn = jit_hwloop_src(ctx, loop->rn, 6);
+    }
+    uint8_t ri = jit_hwloop_src(ctx, loop->ri, 7);
+    emit_sub_phys(ctx, 5, rn, ri);
+    if (loop->cmp != 0xC1) {
+        // blt/bltu i, n: n - i, иначе тело всё равно проходится один раз
+        emit_instr(ctx, encode_branch_instr(loop->cmp == 0xC2 ? 0b100 : 0b110, ri, rn, 8));
+        emit_addi_phys(ctx, 5, 0, 1);
+    }
+    if (ctx->offset & 2) emit_instr16(ctx, 0x0001); // c.nop: setup по границе слова
+    emit_beq_phys(ctx, 5, 0, 8);
+    ctx->hwl_setup = ctx->offset;
+    emit_instr(ctx, 0x00000013);
+    ctx->hwl_body = ctx->offset;
+    ctx->last_cmp_result_reg = 0xFF;
+}
+
+// Перед замыкающим BR_IF: LAST - nop, по которому аппаратура возвращается в начало тела.
+// Сравнение и переход после него выполняются после последнего прохода (или всегда, если
+// цикл не запущен) и остаются страховкой. Тело длиннее JIT_LP_MAX_DIST - setup остаётся
+// nop, а переходы на H ведут сразу в тело.
+static void jit_hwloop_end(JitContext* ctx, const JitHwLoop* loop) {
+    if (ctx->offset & 2) emit_instr16(ctx, 0x0001);
+    size_t last = ctx->offset;
+    emit_instr(ctx, 0x00000013);
+    if (ctx->overflow) return;
+    size_t d = last - ctx->hwl_setup;
+    if (d <= JIT_LP_MAX_DIST) {
+        uint32_t ins = jit_lp_encode(&s_jit_lp_enc, 5, (uint32_t)d);
+        memcpy(ctx->buffer + ctx->hwl_setup, &ins, 4);
+        return;
+    }
+    for (size_t i = 0; i < ctx->num_labels; i++) {
+        if (ctx->labels[i].bytecode_offset == loop->header) ctx->labels[i].native_offset = ctx->hwl_body;
+    }
+}
+#endif
+
+struct JitRegAlloc;
+
+#if CONFIG_ESPB_JIT_OSR
+// Собирает заголовки циклов; без них (или без памяти) функция компилируется без OSR
+static void jit_osr_begin(JitContext* ctx, const uint8_t* code, size_t code_size) {
+    size_t count = 0;
+    uint32_t* headers = espb_jit_osr_scan_headers(code, code_size, &count);
+    if (!headers) return;
+    ctx->osr_points = (EspbJitOsrPoint*)malloc(count * sizeof(EspbJitOsrPoint));
+    ctx->osr_ra_pos = (uint32_t*)malloc(count * sizeof(uint32_t));
+    if (!ctx->osr_points || !ctx->osr_ra_pos) {
+        free(headers);
+        return;
+    }
+    ctx->osr_headers = headers;
+    ctx->osr_num_headers = count;
+}
+
+// Точка входа на заголовке bc_offset. clean: ни одно vreg не кешировано в регистрах
+// (кроме закреплённых аллокатором), т.е. состояние полностью лежит в v_regs[].
+static void jit_osr_mark(JitContext* ctx, size_t bc_offset, bool clean) {
+    while (ctx->osr_next < ctx->osr_num_headers && ctx->osr_headers[ctx->osr_next] < bc_offset) {
+        ctx->osr_next++;
+    }
+    if (!clean || ctx->osr_next == ctx->osr_num_headers || ctx->osr_headers[ctx->osr_next] != bc_offset) return;
+    EspbJitOsrPoint* point = &ctx->osr_points[ctx->osr_num_points];
+    point->bc_offset = (uint32_t)bc_offset;
+    point->native_offset = (uint32_t)ctx->offset;
+#if CONFIG_ESPB_JIT_REGALLOC
+    ctx->osr_ra_pos[ctx->osr_num_points] = ctx->ra ? ctx->ra_pos : 0;
+#else
+    ctx->osr_ra_pos[ctx->osr_num_points] = 0;
+#endif
+    ctx->osr_num_points++;
+}
+
+// Закреплённые vreg, живые в инструкции pos (как jit_ra_sync)
+static uint32_t jit_osr_count_live(const struct JitRegAlloc* ra, uint32_t pos) {
+    uint32_t n = 0;
+#if CONFIG_ESPB_JIT_REGALLOC
+    for (uint32_t v = 0; ra && v < 256; v++) {
+        if (ra->phys[v] != 0 && pos >= ra->start[v] && pos <= ra->end[v]) n++;
+    }
+#else
+    (void)ra;
+    (void)pos;
+#endif
+    return n;
+}
+
+// Вход-трамплин void stub(instance, v_regs, target) после тела функции:
+// копия пролога [prologue_start, prologue_end), затем jalr x0, 0(a2).
+// С аллокатором каждая точка получает трамплин, загружающий живые закреплённые vreg.
+static EspbJitOsrInfo* jit_osr_emit_stub(JitContext* ctx, const struct JitRegAlloc* ra,
+                                         size_t prologue_start, size_t prologue_end) {
+    size_t prologue_len = prologue_end - prologue_start;
+    size_t need = prologue_len + 4;
+    for (size_t i = 0; ra && i < ctx->osr_num_points; i++) {
+        need += 4 * ((size_t)jit_osr_count_live(ra, ctx->osr_ra_pos[i]) + 1);
+    }
+    if (ctx->offset + need > ctx->capacity) return NULL; // emit_instr только печатает переполнение
+
+#if CONFIG_ESPB_JIT_REGALLOC
+    for (size_t i = 0; ra && i < ctx->osr_num_points; i++) {
+        uint32_t pos = ctx->osr_ra_pos[i];
+        uint32_t target = ctx->osr_points[i].native_offset;
+        ctx->osr_points[i].native_offset = (uint32_t)ctx->offset;
+        for (uint32_t v = 0; v < 256; v++) {
+            if (ra->phys[v] == 0 || pos < ra->start[v] || pos > ra->end[v]) continue;
+            emit_lw_phys(ctx, ra->phys[v], (int16_t)(v * 8), 18);
+        }
+        emit_jal_phys(ctx, 0, (int32_t)target - (int32_t)ctx->offset);
+    }
+#endif
+
+    uint32_t stub_offset = (uint32_t)ctx->offset;
+    memcpy(ctx->buffer + ctx->offset, ctx->buffer + prologue_start, prologue_len);
+    ctx->offset += prologue_len;
+    emit_jalr_phys(ctx, 0, 12, 0); // jr a2
+    return espb_jit_osr_info_create(stub_offset, ctx->osr_points, ctx->osr_num_points);
+}
+#endif
+
+_Static_assert(offsetof(EspbInstance, globals_data) < 2048, "EspbInstance.globals_data must be reachable with lw imm12");
+
+// t2 + (возвращаемое смещение) = адрес глобала CONST/ZERO (espb_jit_global_direct_size).
+// База читается из экземпляра (s1), смещение - константа. Портит t2, t3.
+static int16_t jit_emit_global_base(JitContext* ctx, const EspbInstance* instance, uint16_t global_idx) {
+    uint32_t off = instance->global_offsets[global_idx];
+    emit_lw_phys(ctx, 7, (int16_t)offsetof(EspbInstance, globals_data), 9);
+    if (off + 8 <= 2048) return (int16_t)off;
+    uint32_t hi = (off + 0x800) & 0xFFFFF000;
+    int16_t lo = (int16_t)(off - hi);
+    emit_lui_phys(ctx, 28, hi);
+    if (lo != 0) emit_addi_phys(ctx, 28, 28, lo);
+    emit_add_phys(ctx, 7, 7, 28);
+    return 0;
+}
+
+// ra != NULL: закреплённые vreg живут в s-регистрах. Если кодогенерация обошла аллокатор,
+// *ra_failed = true и вызывающий компилирует функцию заново без него.
+static EspbResult jit_compile_function_impl(EspbInstance* instance, uint32_t func_idx, const EspbFunctionBody *body,
+                                            void **out_code, size_t *out_size, EspbJitOsrInfo **out_osr,
+                                            EspbJitPcMap **out_pc_map, EspbJitRelocs **out_relocs,
+                                            struct JitRegAlloc* ra, bool* ra_failed, int64_t deadline,
+                                            bool inline_calls) {
+#if !CONFIG_ESPB_JIT_REGALLOC
+    (void)ra;
+    (void)ra_failed;
+#endif
+#if !CONFIG_ESPB_JIT_INLINE
+    (void)inline_calls;
+#endif
+#if !CONFIG_ESPB_JIT_OSR
+    (void)out_osr;
+#endif
+    const uint8_t* bytecode = body->code;
+    const uint8_t* end = bytecode + body->code_size;
+    
+    // Reduce to 20x and cap at 32KB to avoid heap exhaustion on large functions
+    size_t jit_buffer_size = body->code_size * 20;
+#if CONFIG_ESPB_JIT_DIRECT_CALLS
+    jit_buffer_size += jit_count_call_sites(body, 0x0A) * JIT_DIRECT_CALL_MAX_BYTES;
+#endif
+#if CONFIG_ESPB_JIT_DIRECT_IMPORTS
+    jit_buffer_size += jit_count_call_sites(body, 0x09) * JIT_DIRECT_IMPORT_MAX_BYTES;
+#endif
+#if CONFIG_ESPB_JIT_INLINE
+    uint16_t inline_regs = 0;
+    size_t inline_extra = inline_calls ? jit_inline_scan(instance, func_idx, body, &inline_regs) : 0;
+    jit_buffer_size += inline_extra;
+#endif
+#if CONFIG_ESPB_FUEL
+    // Проверки топлива: по одной на заголовок цикла и в прологе
+    size_t fuel_num_headers = 0;
+    uint32_t* fuel_headers = espb_jit_osr_scan_headers(bytecode, body->code_size, &fuel_num_headers);
+    jit_buffer_size += (fuel_num_headers + 1) * JIT_FUEL_CHECK_MAX_BYTES;
+#endif
+#if JIT_RV_HW_LOOPS
+    size_t hwl_count = 0;
+    JitHwLoop* hwloops = jit_hwloop_scan(bytecode, body->code_size, &hwl_count);
+    jit_buffer_size += hwl_count * JIT_HWLOOP_MAX_BYTES;
+#endif
+    const size_t MAX_JIT_BUFFER = 32 * 1024;
+    if (jit_buffer_size > MAX_JIT_BUFFER) jit_buffer_size = MAX_JIT_BUFFER;
+    if (jit_buffer_size == 0) {
+#if CONFIG_ESPB_FUEL
+        free(fuel_headers);
+#endif
+#if JIT_RV_HW_LOOPS
+        free(hwloops);
+#endif
+        *out_code = NULL;
+        *out_size = 0;
+        return ESPB_OK;
+    }
+    // Бюджет нативного кода и остаток квоты IRAM (espb_jit_budget.h): что не влезло - отклоняется
+    size_t native_limit = espb_jit_native_limit(instance, NULL);
+    if (jit_buffer_size > native_limit) jit_buffer_size = native_limit;
+    if (jit_buffer_size == 0) {
+#if CONFIG_ESPB_FUEL
+        free(fuel_headers);
+#endif
+#if JIT_RV_HW_LOOPS
+        free(hwloops);
+#endif
+        return ESPB_ERR_JIT_CODE_TOO_LARGE;
+    }
+
+    // Буфер резервируется под худший случай в арене экземпляра; после компиляции
+    // фиксируется только ctx.offset, остаток достаётся следующей функции.
+    EspbJitArenaReservation code_res;
+    uint8_t* exec_buffer = espb_jit_code_reserve(instance, jit_buffer_size, NULL, 0, &code_res)
+        ? (uint8_t*)code_res.code : NULL;
+    if (!exec_buffer) {
+        printf("JIT ERROR: Failed to allocate %zu bytes of executable memory\n", jit_buffer_size);
+#if CONFIG_ESPB_FUEL
+        free(fuel_headers);
+#endif
+#if JIT_RV_HW_LOOPS
+        free(hwloops);
+#endif
+        return ESPB_ERR_MEMORY_ALLOC;
+    }
+    
+    // Проверяем, что память действительно в IRAM/ROM.
+    // На ESP32-C6 esp_ptr_in_dram() может возвращать true даже для IRAM-адресов,
+    // поэтому запрещаем только если адрес НЕ в IRAM и НЕ в ROM.
+    if (!esp_ptr_in_iram(exec_buffer) && !esp_ptr_in_rom(exec_buffer)) {
+        printf("JIT: exec_buffer not in IRAM/ROM: %p\n", exec_buffer);
+        espb_jit_code_abort(instance, exec_buffer);
+#if CONFIG_ESPB_FUEL
+        free(fuel_headers);
+#endif
+#if JIT_RV_HW_LOOPS
+        free(hwloops);
+#endif
+        return ESPB_ERR_MEMORY_ALLOC;
+    }
+    
+    // Проверяем выравнивание (RISC-V требует 4-byte alignment)
+    if (((uintptr_t)exec_buffer & 0x3) != 0) {
+        printf("JIT WARNING: exec_buffer not 4-byte aligned: %p\n", exec_buffer);
+    }
+
+    JitContext ctx;
+    jit_context_init(&ctx, exec_buffer, jit_buffer_size);
+#if CONFIG_ESPB_FUEL
+    ctx.fuel_headers = fuel_headers;
+    ctx.fuel_num_headers = fuel_num_headers;
+#endif
+#if JIT_RV_HW_LOOPS
+    ctx.hwloops = hwloops;
+    ctx.hwl_count = hwl_count;
+#endif
+#if CONFIG_ESPB_SANDBOX_MASKED
+    ctx.sb_mask = instance->memory_mask; // Маска зависит только от модуля, база - от экземпляра
+#endif
+    
+    // CMP+BR_IF: Инициализация трекера
+    ctx.last_cmp_result_reg = 0xFF;  // Нет последнего CMP
+    ctx.last_cmp_in_t0 = false;
+    ctx.regs32 = body->regs32;
+
+    // ✅ Извлекаем JIT метаданные из заголовка
+    const EspbFuncHeader *header = &body->header;
+    uint8_t flags = header->flags;
+    uint8_t max_reg_used = header->max_reg_used;
+    uint16_t frame_size = header->frame_size;
+    uint16_t num_virtual_regs = header->num_virtual_regs;
+    
+    
+    // ✅ Вычисляем размер стек фрейма с учетом spill area и saved registers
+    // Базовый размер: ra(4) + fp(4) + s1(4) + s2(4) + s9(4) + frame_size (spill area)
+    bool is_leaf = (flags & ESPB_FUNC_FLAG_IS_LEAF) != 0;
+    // NO_SPILL fast-path eligibility: only for leaf + i32-only + small vreg count
+    bool i32_only = body->regs32;
 
     // КРИТИЧНО: Проверяем max_reg_used, а не num_virtual_regs!
     // После компакции max_reg_used показывает реально используемые регистры (например, R8-R11),
@@ -2555,6 +4597,7 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
     bool no_spill_fastpath = false;  // DISABLED - causes Store access fault on RISC-V
     (void)i32_only; // suppress unused warning when NO_SPILL disabled
 #if 0  // TEMPORARILY DISABLED
+    bool no_spill = (flags & ESPB_FUNC_FLAG_NO_SPILL) != 0;  // 🔥 регистры без spill
     if (i32_only) {
         no_spill_fastpath = (no_spill && is_leaf && max_reg_used <= 15);
         if (no_spill_fastpath) {
@@ -2590,11 +4633,19 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
     // 3. frame_size для spills
     // 4. Временное пространство для CALL_IMPORT (до 60 байт!)
     bool stable_cache_enabled = !no_spill_fastpath;
+#if CONFIG_ESPB_JIT_REGALLOC
+    if (no_spill_fastpath) ra = NULL; // fast-path сам раскладывает vreg по s3..s10
+#endif
 
     uint16_t saved_regs_size = 12; // s0, s1, s2
     if (stable_cache_enabled) {
         saved_regs_size += 16; // s4..s7 (stable cache regs, 2-entry cache)
     }
+#if CONFIG_ESPB_JIT_REGALLOC
+    if (ra) {
+        saved_regs_size += jit_ra_saved_size(ra); // s3, s8..s11 под закреплённые vreg
+    }
+#endif
     if (!is_leaf) {
         saved_regs_size += 4; // +4 для ra
     }
@@ -2612,12 +4663,22 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
     uint16_t temp_space = (flags & ESPB_FUNC_FLAG_HAS_CALLS) ? 64 : 48;
     
     uint16_t total_frame_size = saved_regs_size + frame_size + temp_space;
+#if CONFIG_ESPB_JIT_INLINE
+    // Над spill-областью: сохранённый s2 (v_regs) и регистры встроенного callee с inline_base + 8
+    uint16_t inline_base = temp_space + frame_size;
+    if (inline_extra > 0) total_frame_size += 8 + inline_regs * 8;
+#endif
     
     // Выравниваем до 16 байт (RISC-V ABI требует)
     total_frame_size = (total_frame_size + 15) & ~15;
     
 
     // --- PROLOGUE ---
+#if CONFIG_ESPB_JIT_OSR
+    // Без NO_SPILL fast-path (он держит vreg в регистрах) пролог переиспользует вход-трамплин OSR
+    if (out_osr && !no_spill_fastpath) jit_osr_begin(&ctx, bytecode, body->code_size);
+    size_t osr_prologue_start = ctx.offset;
+#endif
     // Сохраняем стек фрейм
     emit_addi_phys(&ctx, 2, 2, -(int16_t)total_frame_size); // sp -= frame_size
 
@@ -2666,9 +4727,28 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
         offset -= 4;
         emit_sw_phys(&ctx, 23, offset, 2);
     }
+#if CONFIG_ESPB_JIT_REGALLOC
+    if (ra) {
+        jit_ra_save_regs(&ctx, ra, &offset, false);
+    }
+#endif
     
     emit_addi_phys(&ctx, 9, 10, 0);  // s1 = a0 (instance)
     emit_addi_phys(&ctx, 18, 11, 0); // s2 = a1 (v_regs)
+#if CONFIG_ESPB_JIT_OSR
+    size_t osr_prologue_end = ctx.offset;
+#endif
+    // Сюда переходит хвостовой самовызов: кадр и s1/s2 те же, топливо и закреплённые vreg - заново
+    size_t tail_entry = ctx.offset;
+#if CONFIG_ESPB_FUEL
+    // Вызов тратит топливо только в не-leaf функциях: leaf без циклов завершается сам
+    if (!is_leaf) jit_emit_fuel_check(&ctx);
+#endif
+#if CONFIG_ESPB_JIT_REGALLOC
+    if (ra) {
+        jit_ra_load_entry(&ctx, ra);
+    }
+#endif
 
     // NO_SPILL fast-path: загружаем v0..max_reg_used из v_regs[] один раз в физические регистры
     // КРИТИЧНО: После компакции используемые регистры могут быть в диапазоне R8-R15,
@@ -2828,11 +4908,39 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
         VCACHE_FLUSH_SLOT(vcache1, 22, 23); \
     } while(0)
 
+#if CONFIG_ESPB_JIT_REGALLOC
+    ctx.ra = ra;
+#endif
+#if CONFIG_ESPB_JIT_INLINE
+    // Компилируется встроенное тело: pc/end указывают в код callee до его END
+    struct {
+        bool active;
+        bool has_result;
+        const uint8_t* ret_pc;
+        const uint8_t* ret_end;
+        struct JitRegAlloc* ra;
+        bool regs32;
+    } inl = {0};
+#endif
+
     // Генерируем код и создаем метки на лету
+    uint32_t insn_count = 0;
+    bool timed_out = false;
     while (pc < end) {
+        if (ctx.overflow) break;
+        if (espb_jit_deadline_passed(deadline, ++insn_count)) {
+            timed_out = true;
+            break;
+        }
         size_t bytecode_offset = pc - bytecode_start;
+#if CONFIG_ESPB_JIT_INLINE
+        // Смещения встроенного тела не относятся к байт-коду функции: ни меток, ни OSR/топлива
+        bool in_caller = !inl.active;
+#else
+        const bool in_caller = true;
+#endif
         // Создаем/обновляем метку для текущей позиции в байт-коде
-        jit_context_add_label(&ctx, bytecode_offset);
+        if (in_caller) jit_context_add_label(&ctx, bytecode_offset);
         
         uint8_t opcode = *pc++;
 
@@ -2865,13 +4973,70 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
             // Flush stable cache
             VCACHE_FLUSH_ALL();
         }
+
+#if JIT_RV_HW_LOOPS
+        // Setup - до синхронизации аллокатора на H: она уже выполняется в каждом проходе
+        size_t hwl_entry = SIZE_MAX;
+        if (ctx.hwloops && in_caller && !no_spill_fastpath) {
+            while (ctx.hwl_next < ctx.hwl_count && ctx.hwloops[ctx.hwl_next].header < bytecode_offset) {
+                ctx.hwl_next++;
+            }
+            if (!ctx.hwl_open && ctx.hwl_next < ctx.hwl_count && ctx.hwloops[ctx.hwl_next].header == bytecode_offset &&
+                !ph.x5_valid && !ph.x6_valid && !ph.i64_valid &&
+                vcache0.kind == VC_NONE && vcache1.kind == VC_NONE) {
+                ctx.hwl_open = &ctx.hwloops[ctx.hwl_next];
+                hwl_entry = ctx.offset;
+                jit_hwloop_start(&ctx, ctx.hwl_open);
+            }
+        }
+#if !CONFIG_ESPB_JIT_OSR
+        (void)hwl_entry;
+#endif
+#endif
+
+#if CONFIG_ESPB_JIT_REGALLOC
+        if (ctx.ra) {
+            jit_ra_begin_insn(&ctx, instance->module, bytecode_start, body->code_size, bytecode_offset);
+            if (ctx.ra_failed) break;
+        }
+#endif
+#if CONFIG_ESPB_JIT_OSR || CONFIG_ESPB_FUEL
+        // Всё состояние в v_regs[] и закреплённых регистрах: на заголовке цикла можно
+        // войти по OSR и вызвать хелпер топлива
+        bool header_clean = !ph.x5_valid && !ph.x6_valid && !ph.i64_valid &&
+                            vcache0.kind == VC_NONE && vcache1.kind == VC_NONE &&
+                            (ctx.last_cmp_result_reg == 0xFF || opcode != 0x03);
+#endif
+#if CONFIG_ESPB_JIT_OSR
+        if (ctx.osr_headers && in_caller) {
+            size_t osr_points = ctx.osr_num_points;
+            jit_osr_mark(&ctx, bytecode_offset, header_clean);
+#if JIT_RV_HW_LOOPS
+            // Вход по OSR тоже пересчитывает число проходов от текущего Ri
+            if (hwl_entry != SIZE_MAX && ctx.osr_num_points > osr_points) {
+                ctx.osr_points[osr_points].native_offset = (uint32_t)hwl_entry;
+            }
+#endif
+        }
+#endif
+#if CONFIG_ESPB_FUEL
+        if (ctx.fuel_headers && in_caller) {
+            jit_fuel_mark(&ctx, bytecode_offset, header_clean);
+        }
+#endif
         
         // if (bytecode_offset > 350) {
         //    printf("[jit-trace] offset: %zu opcode: 0x%02X\n", bytecode_offset, opcode);
         // }
         
         // Отладка опкодов отключена (можно включить для диагностики)
-        
+
+#if CONFIG_ESPB_JIT_REGALLOC
+        // Частые i32-опкоды по закреплённым регистрам генерируются напрямую
+        size_t ra_len = ctx.ra ? jit_ra_try_emit(&ctx, opcode, pc) : 0;
+        pc += ra_len;
+        if (ra_len == 0)
+#endif
         switch (opcode) {
             case 0x00: { // NOP - No operation (padding)
                 // Ничего не делаем, просто продолжаем
@@ -2919,98 +5084,73 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 // Загружаем индекс из v_regs[ridx]
                 emit_lw_phys(&ctx, 5, ridx * 8, 18);  // t0 = v_regs[ridx] (index)
                 
-                // Проверка: если index >= num_targets, используем default
-                // Загружаем num_targets в t1
-                if (num_targets < 2048) {
-                    emit_addi_phys(&ctx, 6, 0, (int16_t)num_targets);
-                } else {
-                    uint32_t hi = ((num_targets + 0x800) & 0xFFFFF000);
-                    int16_t lo = (int16_t)(num_targets - hi);
-                    emit_lui_phys(&ctx, 6, hi);
-                    if (lo != 0) emit_addi_phys(&ctx, 6, 6, lo);
-                }
-                
-                // НЕ делаем проверку BGEU - просто пропустим, если индекс вне диапазона
-                // Проверка будет неявной: если ни один BEQ не сработает, перейдем на default
-                
-                // Вычисляем адрес в таблице: table_start + index * 2
-                // Используем таблицу переходов в JIT коде - сложный вариант
-                // Упрощенный вариант: генерируем цепочку сравнений (для малого num_targets)
-                // Или используем computed goto через таблицу адресов
-                
-                // ОПТИМИЗАЦИЯ: Для небольших таблиц (< 8 элементов) генерируем цепочку if-else
-                // Для больших таблиц - используем jump table
-                
-                if (num_targets <= 8) {
-                    // Простая цепочка сравнений для малых таблиц
+                size_t default_target_bytecode_offset = source_bytecode_offset + default_offset;
+
+                if (num_targets <= JIT_BR_TABLE_CHAIN_MAX) {
+                    // Малые таблицы: цепочка сравнений, выход за диапазон - на default после неё
                     for (uint16_t i = 0; i < num_targets; i++) {
                         int16_t target_offset;
                         memcpy(&target_offset, table_start + i * sizeof(int16_t), sizeof(int16_t));
                         size_t target_bytecode_offset = source_bytecode_offset + target_offset;
-                        
-                        // Сравниваем index с i
-                        if (i < 2047) {
-                            emit_addi_phys(&ctx, 6, 0, (int16_t)i);
-                        } else {
-                            uint32_t hi = ((i + 0x800) & 0xFFFFF000);
-                            int16_t lo = (int16_t)(i - hi);
-                            emit_lui_phys(&ctx, 6, hi);
-                            if (lo != 0) emit_addi_phys(&ctx, 6, 6, lo);
-                        }
-                        
-                        // Если index != i, пропускаем (переходим на следующую проверку)
-                        size_t skip_patch_location = ctx.offset;
-                        emit_bne_phys(&ctx, 5, 6, 8); // BNE t0, t1, +8 (пропустить следующий JAL)
-                        
-                        // Если index == i, делаем безусловный переход на target
+
+                        emit_addi_phys(&ctx, 6, 0, (int16_t)i); // t1 = i
+
+                        // Если index != i, пропускаем следующий JAL
+                        emit_bne_phys(&ctx, 5, 6, 8); // BNE t0, t1, +8
+
                         size_t patch_location = ctx.offset;
                         emit_jal_phys(&ctx, 0, 0); // JAL x0, <target> (временный offset)
-                        jit_context_add_patchpoint(&ctx, patch_location, source_bytecode_offset, 
+                        jit_context_add_patchpoint(&ctx, patch_location, source_bytecode_offset,
                                                   target_bytecode_offset, false, 0);
-                        
-                        // ВАЖНО: Не добавляем code между BEQ - если BEQ не сработал, 
-                        // продолжаем со следующей проверкой
                     }
+
+                    size_t fallthrough_patch_location = ctx.offset;
+                    emit_jal_phys(&ctx, 0, 0); // Безусловный переход на default
+                    jit_context_add_patchpoint(&ctx, fallthrough_patch_location, source_bytecode_offset,
+                                              default_target_bytecode_offset, false, 0);
                 } else {
-                    // Для больших таблиц используем более эффективный подход
-                    // Генерируем jump через вычисляемый адрес
-                    // Сохраняем таблицу адресов в памяти и делаем indirect jump
-                    
-                    // Упрощенная реализация: используем цепочку для любого размера
+                    // Большие таблицы: проверка границы и переход по таблице JAL в буфере кода.
+                    // Адрес таблицы считается от auipc, поэтому код остаётся позиционно-независимым
+                    // (перемещение при shrink, снимок во flash).
+                    //   bltu  t0, t1, +8
+                    //   jal   x0, <default>
+                    //   slli  t0, t0, 2
+                    //   auipc t1, 0
+                    //   add   t1, t1, t0
+                    //   jalr  x0, table-auipc(t1)
+                    // table:
+                    //   jal   x0, <target[i]>   ; ровно 4 байта на запись
+                    if (num_targets < 2048) {
+                        emit_addi_phys(&ctx, 6, 0, (int16_t)num_targets); // t1 = num_targets
+                    } else {
+                        uint32_t hi = ((num_targets + 0x800) & 0xFFFFF000);
+                        int16_t lo = (int16_t)(num_targets - hi);
+                        emit_lui_phys(&ctx, 6, hi);
+                        if (lo != 0) emit_addi_phys(&ctx, 6, 6, lo);
+                    }
+                    emit_bltu_phys(&ctx, 5, 6, 8);
+                    size_t default_patch_location = ctx.offset;
+                    emit_jal_phys(&ctx, 0, 0);
+                    jit_context_add_patchpoint(&ctx, default_patch_location, source_bytecode_offset,
+                                              default_target_bytecode_offset, false, 0);
+
+                    emit_slli_phys(&ctx, 5, 5, 2);
+                    size_t auipc_location = ctx.offset;
+                    emit_instr(&ctx, (6u << 7) | 0b0010111); // AUIPC t1, 0
+                    emit_add_phys(&ctx, 6, 6, 5);
+                    // jalr с ненулевым смещением не сжимается - 4 байта
+                    emit_jalr_phys(&ctx, 0, 6, (int16_t)(ctx.offset + 4 - auipc_location));
+
                     for (uint16_t i = 0; i < num_targets; i++) {
                         int16_t target_offset;
                         memcpy(&target_offset, table_start + i * sizeof(int16_t), sizeof(int16_t));
-                        size_t target_bytecode_offset = source_bytecode_offset + target_offset;
-                        
-                        if (i < 2047) {
-                            emit_addi_phys(&ctx, 6, 0, (int16_t)i);
-                        } else {
-                            uint32_t hi = ((i + 0x800) & 0xFFFFF000);
-                            int16_t lo = (int16_t)(i - hi);
-                            emit_lui_phys(&ctx, 6, hi);
-                            if (lo != 0) emit_addi_phys(&ctx, 6, 6, lo);
-                        }
-                        
-                        // Если index != i, пропускаем
-                        emit_bne_phys(&ctx, 5, 6, 8); // BNE t0, t1, +8
-                        
-                        // Если index == i, переходим на target
                         size_t patch_location = ctx.offset;
                         emit_jal_phys(&ctx, 0, 0);
-                        jit_context_add_patchpoint(&ctx, patch_location, source_bytecode_offset, 
-                                                  target_bytecode_offset, false, 0);
+                        jit_context_add_patchpoint(&ctx, patch_location, source_bytecode_offset,
+                                                  source_bytecode_offset + target_offset, false, 0);
                     }
                 }
                 
-                // После всех проверок, если ни один BEQ не сработал, делаем безусловный переход на default
-                size_t fallthrough_patch_location = ctx.offset;
-                emit_jal_phys(&ctx, 0, 0); // Безусловный переход на default
-                
-                // Патчим fall-through переход на default
-                size_t default_target_bytecode_offset = source_bytecode_offset + default_offset;
-                jit_context_add_patchpoint(&ctx, fallthrough_patch_location, source_bytecode_offset,
-                                          default_target_bytecode_offset, false, 0);
-                
                 break;
             }
             
@@ -3079,24 +5219,38 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
 
                 ph_flush_selective_for_branch(&ctx, &ph, bytecode_start, end, target_bytecode_offset, fallthrough_bytecode_offset);
                 ph_reset(&ph);
+#if JIT_RV_HW_LOOPS
+                if (ctx.hwl_open && in_caller && source_bytecode_offset == ctx.hwl_open->br_if) {
+                    jit_hwloop_end(&ctx, ctx.hwl_open);
+                    ctx.hwl_open = NULL;
+                }
+#endif
 
                 // Целевой offset в байт-коде
                 
                 // CMP+BR_IF ОПТИМИЗАЦИЯ: Если rcond == last_cmp_result_reg и результат в t0
                 // то не нужен load!
                 // Для корректности: всегда загружаем условие из памяти
-                emit_lw_phys(&ctx, 5, rcond * 8, 18);  // t0 = v_regs[rcond]
+                uint8_t cond_reg = 5;
+#if CONFIG_ESPB_JIT_REGALLOC
+                if (ctx.ra && ctx.ra->phys[rcond] != 0) {
+                    cond_reg = ctx.ra->phys[rcond]; // условие уже в закреплённом s-регистре
+                }
+#endif
+                if (cond_reg == 5) {
+                    emit_lw_phys(&ctx, 5, rcond * 8, 18);  // t0 = v_regs[rcond]
+                }
                 ctx.last_cmp_result_reg = 0xFF;  // сброс трекера
                 
                 // Генерируем BNE с временным offset (будет исправлен позже)
-                // BNE t0, x0, target (если t0 != 0, прыгаем)
+                // BNE cond, x0, target (если cond != 0, прыгаем)
                 size_t patch_location = ctx.offset;
-                emit_bne_phys(&ctx, 5, 0, 0); // offset=0 (временно)
+                emit_bne_phys(&ctx, cond_reg, 0, 0); // offset=0 (временно)
                 
                 // Добавляем patchpoint для отложенной фиксации
-                // ВАЖНО: условие реально в регистре t0 (x5), не в виртуальном rcond
+                // ВАЖНО: условие реально в физическом регистре (t0 или s-регистр), не в виртуальном rcond
                 jit_context_add_patchpoint(&ctx, patch_location, source_bytecode_offset, 
-                                          target_bytecode_offset, true, 5);
+                                          target_bytecode_offset, true, cond_reg);
                 
                 break;
             }
@@ -3118,7 +5272,7 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                     num_args = *pc++;
                     if (num_args > 16) {
                         printf("[JIT ERROR] CALL_IMPORT with num_args=%u > 16 in func_idx=%u\n", num_args, func_idx);
-                        free(exec_buffer);
+                        espb_jit_code_abort(instance, exec_buffer);
                         *out_code = NULL;
                         *out_size = 0;
                         return ESPB_ERR_JIT_UNSUPPORTED_OPCODE;
@@ -3140,6 +5294,12 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                     }
                 }
 
+#if CONFIG_ESPB_JIT_DIRECT_IMPORTS
+                if (!has_variadic_info && jit_emit_direct_import_call(&ctx, instance, import_idx)) {
+                    break;
+                }
+#endif
+
                 // OPTIMIZED: Minimal frame + space for arg_types[16] if variadic
                 int frame_size_import = has_variadic_info ? 32 : 16;
                 emit_addi_phys(&ctx, 2, 2, (int16_t)(-frame_size_import));
@@ -3239,10 +5399,75 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 uint16_t local_func_idx;
                 memcpy(&local_func_idx, pc, sizeof(local_func_idx)); pc += sizeof(local_func_idx);
 
+                // Хвостовой самовызов (CALL self; END): v_regs[] уже синхронизирован барьером,
+                // аргументы на месте - обнуляем хвост кадра и переходим на начало тела
+                uint32_t tail_zero_from, tail_zero_to;
+                if (!no_spill_fastpath &&
+                    espb_jit_self_tail_call(instance->module, func_idx, local_func_idx, pc, end, 8,
+                                            &tail_zero_from, &tail_zero_to)) {
+                    for (uint32_t r = tail_zero_from; r < tail_zero_to; r++) {
+                        emit_sw_phys(&ctx, 0, (int16_t)(r * 8), 18);
+                        emit_sw_phys(&ctx, 0, (int16_t)(r * 8 + 4), 18);
+                    }
+                    emit_jal_phys(&ctx, 0, (int32_t)tail_entry - (int32_t)ctx.offset);
+                    break;
+                }
+
+#if CONFIG_ESPB_JIT_INLINE
+                const EspbFunctionBody* inl_body = inline_calls
+                    ? jit_inline_callee(instance, func_idx, local_func_idx) : NULL;
+                if (inl_body) {
+                    // v_regs[] синхронизирован барьером CALL. Кадр callee собирается так же, как
+                    // в jit_call_espb_function: до 8 аргументов, затем обнуление zero_init_regs.
+                    const EspbFuncSignature* inl_sig =
+                        &instance->module->signatures[instance->module->function_signature_indices[local_func_idx]];
+                    uint16_t inl_regs = inl_body->header.num_virtual_regs;
+                    uint16_t inl_args = inl_sig->num_params < 8 ? inl_sig->num_params : 8;
+                    if (inl_args > inl_regs) inl_args = inl_regs;
+                    uint16_t inl_zero = ESPB_FRAME_ZERO_INIT_REGS(inl_body);
+                    if (inl_zero > inl_regs) inl_zero = inl_regs;
+                    int16_t inl_frame = (int16_t)(inline_base + 8);
+
+                    for (uint16_t r = 0; r < inl_args; r++) {
+                        emit_lw_phys(&ctx, 5, (int16_t)(r * 8), 18);
+                        emit_lw_phys(&ctx, 6, (int16_t)(r * 8 + 4), 18);
+                        emit_sw_phys(&ctx, 5, (int16_t)(inl_frame + r * 8), 8);
+                        emit_sw_phys(&ctx, 6, (int16_t)(inl_frame + r * 8 + 4), 8);
+                    }
+                    for (uint16_t r = inl_args; r < inl_zero; r++) {
+                        emit_sw_phys(&ctx, 0, (int16_t)(inl_frame + r * 8), 8);
+                        emit_sw_phys(&ctx, 0, (int16_t)(inl_frame + r * 8 + 4), 8);
+                    }
+                    emit_sw_phys(&ctx, 18, (int16_t)inline_base, 8); // v_regs вызывающей функции
+                    emit_addi_phys(&ctx, 18, 8, inl_frame);          // s2 = регистры callee
+
+                    inl.active = true;
+                    inl.has_result = inl_sig->num_returns > 0;
+                    inl.ret_pc = pc;
+                    inl.ret_end = end;
+                    inl.regs32 = ctx.regs32;
+                    ctx.regs32 = inl_body->regs32;
+                    pc = inl_body->code;
+                    end = inl_body->code + inl_body->code_size;
+#if CONFIG_ESPB_JIT_REGALLOC
+                    // Тело работает с памятью кадра callee; закреплённые регистры вызывающей
+                    // функции не трогаются и перечитываются после возврата, как после CALL
+                    inl.ra = ctx.ra;
+                    ctx.ra = NULL;
+#endif
+                    break;
+                }
+#endif
+
                 // ОПТИМИЗАЦИЯ: минимальный overhead вызова.
                 // jit_call_espb_function() — обычная C функция и по ABI НЕ должна портить s1/s2.
                 // Поэтому не сохраняем a0-a7/t0-t6/s2 на каждый CALL.
 
+#if CONFIG_ESPB_JIT_DIRECT_CALLS
+                size_t direct_done_jump = 0;
+                bool direct_call = jit_emit_direct_call(&ctx, instance->module, local_func_idx, &direct_done_jump);
+#endif
+
                 // a0 = instance (s1)
                 emit_addi_phys(&ctx, 10, 9, 0);
 
@@ -3261,6 +5486,11 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
 
                 // Call helper directly (emit_call_helper uses t0=x5)
                 emit_call_helper(&ctx, (uintptr_t)&jit_call_espb_function);
+#if CONFIG_ESPB_JIT_DIRECT_CALLS
+                if (direct_call) {
+                    jit_finish_direct_call(&ctx, direct_done_jump);
+                }
+#endif
 
                 break;
             }
@@ -3365,6 +5595,7 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 memcpy(&offset, pc, sizeof(offset)); pc += sizeof(offset);
                 
                 emit_lw_phys(&ctx, 5, ra * 8, 18);
+                JIT_SANDBOX_ADDR_T0(&ctx, &offset);
                 if (offset >= -2048 && offset < 2048) {
                     emit_lw_phys(&ctx, 5, offset, 5);
                 } else {
@@ -3383,6 +5614,7 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 memcpy(&offset, pc, sizeof(offset)); pc += sizeof(offset);
 
                 emit_lw_phys(&ctx, 5, ra * 8, 18);
+                JIT_SANDBOX_ADDR_T0(&ctx, &offset);
                 if (offset >= -2048 && offset < 2048) {
                     emit_lw_phys(&ctx, 5, offset, 5);
                 } else {
@@ -3401,6 +5633,7 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 memcpy(&offset, pc, sizeof(offset)); pc += sizeof(offset);
                 
                 emit_lw_phys(&ctx, 5, ra * 8, 18);
+                JIT_SANDBOX_ADDR_T0(&ctx, &offset);
                 if (offset >= -2048 && offset < 2048) {
                     emit_lw_phys(&ctx, 6, offset, 5);
                 } else {
@@ -3440,6 +5673,7 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 emit_lw_phys(&ctx, 5, ra * 8, 18);
 
                 // low word
+                JIT_SANDBOX_ADDR_T0(&ctx, &offset);
                 if (offset >= -2048 && offset < 2048) {
                     emit_lw_phys(&ctx, 6, offset, 5);
                 } else {
@@ -3490,6 +5724,7 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 }
 
                 // load pointer-sized value (RV32 => 4 bytes)
+                JIT_SANDBOX_ADDR(&ctx, addr_reg, &offset);
                 if (offset >= -2048 && offset < 2048) {
                     emit_lw_phys(&ctx, 6, offset, addr_reg);
                 } else {
@@ -3530,6 +5765,7 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 emit_lw_phys(&ctx, 5, ra * 8, 18);  // t0 = v_regs[ra]
                 
                 // Сохраняем в память
+                JIT_SANDBOX_ADDR_T0(&ctx, &offset);
                 if (offset >= -2048 && offset < 2048) {
                     emit_sw_phys(&ctx, 6, offset, 5);  // *(t0 + offset) = t1
                 } else {
@@ -3554,6 +5790,7 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 emit_lw_phys(&ctx, 6, rs * 8, 18);
                 emit_lw_phys(&ctx, 5, ra * 8, 18);
 
+                JIT_SANDBOX_ADDR_T0(&ctx, &offset);
                 if (offset >= -2048 && offset < 2048) {
                     emit_sw_phys(&ctx, 6, offset, 5);
                 } else {
@@ -3579,6 +5816,7 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 emit_lw_phys(&ctx, 7, rs * 8 + 4, 18);  // t2 = hi
                 emit_lw_phys(&ctx, 5, ra * 8, 18);      // t0 = base
 
+                JIT_SANDBOX_ADDR_T0(&ctx, &offset);
                 if (offset >= -2048 && offset < 2048) {
                     emit_sw_phys(&ctx, 6, offset, 5);
                     emit_sw_phys(&ctx, 7, offset + 4, 5);
@@ -3608,6 +5846,7 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 emit_lw_phys(&ctx, 6, rs * 8, 18);
                 
                 // Сохраняем младшие 32 бита
+                JIT_SANDBOX_ADDR_T0(&ctx, &offset);
                 if (offset >= -2048 && offset < 2048) {
                     emit_sw_phys(&ctx, 6, offset, 5);
                 } else {
@@ -3934,7 +6173,11 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                     emit_lw_phys(&ctx, 11, r2 * 8, 18);
                 }
 
+#if JIT_RV_HW_FPU
+                emit_f32_binop_a0_a1(&ctx, RV_FADD_S, RV_RM_DYN, false);
+#else
                 emit_call_helper(&ctx, (uintptr_t)&jit_helper_fadd_f32_bits);
+#endif
 
                 // evict old cached value if dirty
                 if (vcache.kind == VC_F32 && vcache.dirty && vcache.vreg != rd) {
@@ -3959,7 +6202,11 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 if (vcache.kind == VC_F32 && vcache.vreg == r2) emit_addi_phys(&ctx, 11, 20, 0);
                 else emit_lw_phys(&ctx, 11, r2 * 8, 18);
 
+#if JIT_RV_HW_FPU
+                emit_f32_binop_a0_a1(&ctx, RV_FSUB_S, RV_RM_DYN, false);
+#else
                 emit_call_helper(&ctx, (uintptr_t)&jit_helper_fsub_f32_bits);
+#endif
 
                 if (vcache.kind == VC_F32 && vcache.dirty && vcache.vreg != rd) {
                     emit_sw_phys(&ctx, 20, vcache.vreg * 8, 18);
@@ -3981,7 +6228,11 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 if (vcache.kind == VC_F32 && vcache.vreg == r2) emit_addi_phys(&ctx, 11, 20, 0);
                 else emit_lw_phys(&ctx, 11, r2 * 8, 18);
 
+#if JIT_RV_HW_FPU
+                emit_f32_binop_a0_a1(&ctx, RV_FMUL_S, RV_RM_DYN, false);
+#else
                 emit_call_helper(&ctx, (uintptr_t)&jit_helper_fmul_f32_bits);
+#endif
 
                 if (vcache.kind == VC_F32 && vcache.dirty && vcache.vreg != rd) {
                     emit_sw_phys(&ctx, 20, vcache.vreg * 8, 18);
@@ -4003,7 +6254,11 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 if (vcache.kind == VC_F32 && vcache.vreg == r2) emit_addi_phys(&ctx, 11, 20, 0);
                 else emit_lw_phys(&ctx, 11, r2 * 8, 18);
 
+#if JIT_RV_HW_FPU
+                emit_f32_binop_a0_a1(&ctx, RV_FDIV_S, RV_RM_DYN, false);
+#else
                 emit_call_helper(&ctx, (uintptr_t)&jit_helper_fdiv_f32_bits);
+#endif
 
                 if (vcache.kind == VC_F32 && vcache.dirty && vcache.vreg != rd) {
                     emit_sw_phys(&ctx, 20, vcache.vreg * 8, 18);
@@ -4025,7 +6280,11 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 if (vcache.kind == VC_F32 && vcache.vreg == r2) emit_addi_phys(&ctx, 11, 20, 0);
                 else emit_lw_phys(&ctx, 11, r2 * 8, 18);
 
+#if JIT_RV_HW_FPU
+                emit_f32_binop_a0_a1(&ctx, RV_FMINMAX_S, 0b000, false);
+#else
                 emit_call_helper(&ctx, (uintptr_t)&jit_helper_fmin_f32_bits);
+#endif
 
                 if (vcache.kind == VC_F32 && vcache.dirty && vcache.vreg != rd) {
                     emit_sw_phys(&ctx, 20, vcache.vreg * 8, 18);
@@ -4047,7 +6306,11 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 if (vcache.kind == VC_F32 && vcache.vreg == r2) emit_addi_phys(&ctx, 11, 20, 0);
                 else emit_lw_phys(&ctx, 11, r2 * 8, 18);
 
+#if JIT_RV_HW_FPU
+                emit_f32_binop_a0_a1(&ctx, RV_FMINMAX_S, 0b001, false);
+#else
                 emit_call_helper(&ctx, (uintptr_t)&jit_helper_fmax_f32_bits);
+#endif
 
                 if (vcache.kind == VC_F32 && vcache.dirty && vcache.vreg != rd) {
                     emit_sw_phys(&ctx, 20, vcache.vreg * 8, 18);
@@ -4080,7 +6343,11 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 if (vcache.kind == VC_F32 && vcache.vreg == rs) emit_addi_phys(&ctx, 10, 20, 0);
                 else emit_lw_phys(&ctx, 10, rs * 8, 18);
 
+#if JIT_RV_HW_FPU
+                emit_f32_binop_a0_a1(&ctx, RV_FSQRT_S, RV_RM_DYN, true);
+#else
                 emit_call_helper(&ctx, (uintptr_t)&jit_helper_fsqrt_f32_bits);
+#endif
 
                 if (vcache.kind == VC_F32 && vcache.dirty && vcache.vreg != rd) {
                     emit_sw_phys(&ctx, 20, vcache.vreg * 8, 18);
@@ -4303,7 +6570,12 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 uint8_t rs = *pc++;
 
                 emit_lw_phys(&ctx, 10, rs * 8, 18);
+#if JIT_RV_HW_FPU
+                emit_fmv_w_x(&ctx, 0, 10);
+                emit_fp_op(&ctx, RV_FCVT_W_S, 10, 0, 1, RV_RM_RTZ);  // fcvt.wu.s a0, f0, rtz
+#else
                 emit_call_helper(&ctx, (uintptr_t)&jit_helper_cvt_f32_u32);
+#endif
 
                 emit_sw_phys(&ctx, 10, rd * 8, 18);
                 emit_sw_phys(&ctx, 0, rd * 8 + 4, 18);
@@ -4357,7 +6629,12 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 uint8_t rs = *pc++;
 
                 emit_lw_phys(&ctx, 10, rs * 8, 18);
+#if JIT_RV_HW_FPU
+                emit_fmv_w_x(&ctx, 0, 10);
+                emit_fp_op(&ctx, RV_FCVT_W_S, 10, 0, 0, RV_RM_RTZ);  // fcvt.w.s a0, f0, rtz
+#else
                 emit_call_helper(&ctx, (uintptr_t)&jit_helper_cvt_f32_i32);
+#endif
 
                 emit_sw_phys(&ctx, 10, rd * 8, 18);
                 emit_srai_phys(&ctx, 11, 10, 31);
@@ -4398,7 +6675,12 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 uint8_t rs = *pc++;
 
                 emit_lw_phys(&ctx, 10, rs * 8, 18);
+#if JIT_RV_HW_FPU
+                emit_fp_op(&ctx, RV_FCVT_S_W, 0, 10, 1, RV_RM_DYN);  // fcvt.s.wu f0, a0
+                emit_fmv_x_w(&ctx, 10, 0);
+#else
                 emit_call_helper(&ctx, (uintptr_t)&jit_helper_cvt_u32_f32_bits);
+#endif
 
                 emit_sw_phys(&ctx, 10, rd * 8, 18);
                 emit_sw_phys(&ctx, 0, rd * 8 + 4, 18);
@@ -4425,7 +6707,12 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 uint8_t rs = *pc++;
 
                 emit_lw_phys(&ctx, 10, rs * 8, 18);
+#if JIT_RV_HW_FPU
+                emit_fp_op(&ctx, RV_FCVT_S_W, 0, 10, 0, RV_RM_DYN);  // fcvt.s.w f0, a0
+                emit_fmv_x_w(&ctx, 10, 0);
+#else
                 emit_call_helper(&ctx, (uintptr_t)&jit_helper_cvt_i32_f32_bits);
+#endif
 
                 emit_sw_phys(&ctx, 10, rd * 8, 18);
                 emit_sw_phys(&ctx, 0, rd * 8 + 4, 18);
@@ -4450,13 +6737,13 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
             case 0xA2: case 0xA3: {  // (remaining unsupported conversions)
 
                 printf("[JIT ERROR] Float/unsupported opcode 0x%02X in func_idx=%u at offset %zu\n", opcode, func_idx, bytecode_offset);
-                free(exec_buffer);
+                espb_jit_code_abort(instance, exec_buffer);
                 *out_code = NULL;
                 *out_size = 0;
                 return ESPB_ERR_JIT_UNSUPPORTED_OPCODE;
             }
             
-            case 0x8F: { // ALLOCA Rd, Rs, align - HEAP-BASED через helper
+            case 0x8F: { // ALLOCA Rd, Rs, align - стек ALLOCA через helper
                 uint8_t rd = *pc++;
                 uint8_t rs = *pc++;
                 uint8_t align_param = *pc++;
@@ -4465,7 +6752,7 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 // printf("[JIT-COMPILE] ALLOCA at offset %ld: rd=%u, rs=%u, align=%u\n", 
                 //        (long)(pc - bytecode - 3), rd, rs, align_param);
                 
-                // Генерируем вызов helper: void espb_jit_alloca_ex(EspbInstance*, Value* v_regs, u16 num_regs_allocated, u8 rd, u8 rs, u8 align)
+                // Генерируем вызов helper: EspbResult espb_jit_alloca_ex(EspbInstance*, Value* v_regs, u16 num_regs_allocated, u8 rd, u8 rs, u8 align)
                 // Сохраняем caller-saved регистры t0-t6 и ra в pre-allocated temp area (s0+0..s0+31).
                 // КРИТИЧНО: нельзя делать sp-=32 — это перекроет v_regs на стеке вызывающей функции.
                 // Используем 48-байтный temp_space в нижней части JIT-фрейма (s0 = fp = sp в прологе).
@@ -4508,6 +6795,11 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 for (int i = 0; i < 7; ++i) emit_lw_phys(&ctx, t_regs[i], i * 4, 8); // lw tX, i*4(s0)
                 emit_lw_phys(&ctx, 1, 28, 8); // lw ra, 28(s0)
                 // s1(x9) и s2(x18) callee-saved — хелпер их сохранил сам, восстанавливать не нужно
+
+                // Переполнение стека ALLOCA (или чужой экземпляр на нём) — trap, как UNREACHABLE:
+                // beqz a0, +8; ebreak
+                emit_beq_phys(&ctx, 10, 0, 8);
+                emit_instr(&ctx, 0x00100073);
                 
                 break;
             }
@@ -4598,6 +6890,7 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 // Prepare arguments: a0 = address (ptr), a1 = value
                 // a0 = v_regs[ra].ptr (address)
                 emit_lw_phys(&ctx, 10, ra * 8, 18);  // a0 = v_regs[ra]
+                JIT_SANDBOX_ARG(&ctx, 10);
                 // a1 = v_regs[rv].i32 (value)
                 emit_lw_phys(&ctx, 11, rv * 8, 18);  // a1 = v_regs[rv]
                 
@@ -4620,6 +6913,7 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 // ESP32-C3: Use helper function instead of LR.W
                 // a0 = address
                 emit_lw_phys(&ctx, 10, ra * 8, 18);
+                JIT_SANDBOX_ARG(&ctx, 10);
                 
                 // Call jit_atomic_load_4
                 emit_call_helper(&ctx, (uintptr_t)&jit_atomic_load_4);
@@ -4640,6 +6934,7 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 // ESP32-C3: Use helper function instead of AMOSWAP
                 // a0 = address
                 emit_lw_phys(&ctx, 10, ra * 8, 18);
+                JIT_SANDBOX_ARG(&ctx, 10);
                 // a1 = value
                 emit_lw_phys(&ctx, 11, rs * 8, 18);
                 
@@ -4661,6 +6956,7 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 
                 // a0 = address (v_regs[ra].ptr)
                 emit_lw_phys(&ctx, 10, ra * 8, 18);
+                JIT_SANDBOX_ARG(&ctx, 10);
                 
                 // a1 = &v_regs[rexp].i32 (pointer to expected value)
                 // s2 (x18) contains v_regs base address
@@ -4751,6 +7047,7 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 
                 // a0 = адрес из v_regs[ra]
                 emit_lw_phys(&ctx, 10, ra * 8, 18);
+                JIT_SANDBOX_ARG(&ctx, 10);
                 
                 // a1 = v_regs[rv] low, a2 = v_regs[rv] high (64-битное значение для операции)
                 emit_lw_phys(&ctx, 11, rv * 8, 18);
@@ -4784,6 +7081,7 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 // Для 64-битной атомарной загрузки используем wrapper
                 // a0 = адрес
                 emit_lw_phys(&ctx, 10, ra * 8, 18);
+                JIT_SANDBOX_ARG(&ctx, 10);
                 
                 // Вызов __atomic_load_n для 64-бит
                 emit_call_helper(&ctx, (uintptr_t)&jit_atomic_load_8);
@@ -4801,6 +7099,7 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 
                 // a0 = адрес
                 emit_lw_phys(&ctx, 10, ra * 8, 18);
+                JIT_SANDBOX_ARG(&ctx, 10);
                 
                 // a1 = value_low, a2 = value_high
                 emit_lw_phys(&ctx, 11, rs * 8, 18);
@@ -4830,6 +7129,7 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 // CAS для 64-битных значений
                 // a0 = адрес
                 emit_lw_phys(&ctx, 10, ra * 8, 18);
+                JIT_SANDBOX_ARG(&ctx, 10);
                 
                 // a1 = &expected (указатель на v_regs[rexp])
                 emit_addi_phys(&ctx, 11, 18, rexp * 8);
@@ -4933,22 +7233,18 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 uint8_t rs = *pc++;
                 int8_t imm = (int8_t)*pc++;
                 
-                // 64-битное умножение на immediate
-                // Вызываем helper функцию для 64-bit multiplication
-                // a0:a1 = multiplicand (from v_regs[rs])
-                emit_lw_phys(&ctx, 10, rs * 8, 18);      // a0 = low
-                emit_lw_phys(&ctx, 11, rs * 8 + 4, 18);  // a1 = high
+                // 64-битное умножение на immediate (inline mul/mulhu)
+                emit_lw_phys(&ctx, 5, rs * 8, 18);      // t0 = low
+                emit_lw_phys(&ctx, 6, rs * 8 + 4, 18);  // t1 = high
                 
-                // a2:a3 = multiplier (sign-extended imm8)
-                emit_addi_phys(&ctx, 12, 0, (int16_t)imm);  // a2 = imm (sign-extended)
-                emit_srai_phys(&ctx, 13, 12, 31);  // a3 = sign extension of imm
+                // t2:t3 = multiplier (sign-extended imm8)
+                emit_addi_phys(&ctx, 7, 0, (int16_t)imm);
+                emit_srai_phys(&ctx, 28, 7, 31);
                 
-                // Вызываем helper для 64-bit multiplication
-                emit_call_helper(&ctx, (uintptr_t)&jit_helper_mul64);
+                emit_mul_i64_pairs(&ctx);
                 
-                // Результат в a0:a1, сохраняем в v_regs[rd]
-                emit_sw_phys(&ctx, 10, rd * 8, 18);      // low
-                emit_sw_phys(&ctx, 11, rd * 8 + 4, 18);  // high
+                emit_sw_phys(&ctx, 5, rd * 8, 18);      // low
+                emit_sw_phys(&ctx, 6, rd * 8 + 4, 18);  // high
                 
                 break;
             }
@@ -4962,6 +7258,7 @@ EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx,
                 // Проверяем деление на 0 и overflow во время компиляции
                 if (imm == 0) {
                     printf("[JIT ERROR] DIVS.I64.IMM8: Division by zero at compile time\n");
+                    espb_jit_code_abort(instance, exec_buffer);
                     *out_code = NULL;
                     *out_size = 0;
                     return ESPB_ERR_JIT_UNSUPPORTED_OPCODE;
@@ -5067,6 +7364,7 @@ divs_i64_general_case:
                 // Проверка деления на 0
                 if (imm == 0) {
                     printf("[JIT ERROR] DIVU.I64.IMM8: Division by zero at compile time\n");
+                    espb_jit_code_abort(instance, exec_buffer);
                     *out_code = NULL;
                     *out_size = 0;
                     return ESPB_ERR_JIT_UNSUPPORTED_OPCODE;
@@ -5130,6 +7428,7 @@ divs_i64_general_case:
                 // Проверка деления на 0
                 if (imm == 0) {
                     printf("[JIT ERROR] REMU.I64.IMM8: Division by zero at compile time\n");
+                    espb_jit_code_abort(instance, exec_buffer);
                     *out_code = NULL;
                     *out_size = 0;
                     return ESPB_ERR_JIT_UNSUPPORTED_OPCODE;
@@ -5167,6 +7466,7 @@ divs_i64_general_case:
                 emit_lw_phys(&ctx, 6, rs * 8, 18);  // t1 = v_regs[rs] (pointer value)
                 
                 // Вычисляем эффективный адрес и сохраняем
+                JIT_SANDBOX_ADDR_T0(&ctx, &offset);
                 if (offset >= -2048 && offset < 2048) {
                     // SW t1, offset(t0)
                     uint32_t imm_bits = ((uint32_t)offset & 0xFFF);
@@ -5212,6 +7512,7 @@ divs_i64_general_case:
                 
                 // Загружаем байт со знаковым расширением: LB (Load Byte signed)
                 // LB rd, offset(rs1): opcode=0000011, funct3=000
+                JIT_SANDBOX_ADDR(&ctx, addr_reg, &offset);
                 if (offset >= -2048 && offset < 2048) {
                     uint32_t imm_bits = ((uint32_t)offset & 0xFFF) << 20;
                     emit_instr(&ctx, imm_bits | (addr_reg << 15) | (0b000 << 12) | (6 << 7) | 0b0000011);  // lb t1, offset(addr_reg)
@@ -5259,6 +7560,7 @@ divs_i64_general_case:
                 
                 // Загружаем байт с нулевым расширением: LBU (Load Byte Unsigned)
                 // LBU rd, offset(rs1): opcode=0000011, funct3=100
+                JIT_SANDBOX_ADDR_T0(&ctx, &offset);
                 if (offset >= -2048 && offset < 2048) {
                     uint32_t imm_bits = ((uint32_t)offset & 0xFFF) << 20;
                     emit_instr(&ctx, imm_bits | (5 << 15) | (0b100 << 12) | (6 << 7) | 0b0000011);  // lbu t1, offset(t0)
@@ -5304,6 +7606,7 @@ divs_i64_general_case:
                 
                 // Загружаем halfword со знаковым расширением: LH (Load Halfword signed)
                 // LH rd, offset(rs1): opcode=0000011, funct3=001
+                JIT_SANDBOX_ADDR(&ctx, addr_reg, &offset);
                 if (offset >= -2048 && offset < 2048) {
                     uint32_t imm_bits = ((uint32_t)offset & 0xFFF) << 20;
                     emit_instr(&ctx, imm_bits | (addr_reg << 15) | (0b001 << 12) | (6 << 7) | 0b0000011);  // lh t1, offset(addr_reg)
@@ -5348,6 +7651,7 @@ divs_i64_general_case:
                 
                 // Загружаем halfword с нулевым расширением: LHU (Load Halfword Unsigned)
                 // LHU rd, offset(rs1): opcode=0000011, funct3=101
+                JIT_SANDBOX_ADDR_T0(&ctx, &offset);
                 if (offset >= -2048 && offset < 2048) {
                     uint32_t imm_bits = ((uint32_t)offset & 0xFFF) << 20;
                     emit_instr(&ctx, imm_bits | (5 << 15) | (0b101 << 12) | (6 << 7) | 0b0000011);  // lhu t1, offset(t0)
@@ -5381,6 +7685,7 @@ divs_i64_general_case:
                 emit_lw_phys(&ctx, 5, ra * 8, 18);  // t0 = v_regs[ra] (address)
                 
                 // Загружаем байт с нулевым расширением: LBU
+                JIT_SANDBOX_ADDR_T0(&ctx, &offset);
                 if (offset >= -2048 && offset < 2048) {
                     uint32_t imm_bits = ((uint32_t)offset & 0xFFF) << 20;
                     emit_instr(&ctx, imm_bits | (5 << 15) | (0b100 << 12) | (6 << 7) | 0b0000011);  // lbu t1, offset(t0)
@@ -5436,6 +7741,7 @@ divs_i64_general_case:
                 }
                 
                 // Сохраняем байт (SB - Store Byte)
+                JIT_SANDBOX_ADDR(&ctx, addr_reg, &offset);
                 if (offset >= -2048 && offset < 2048) {
                     // SB val_reg, offset(addr_reg)
                     uint32_t imm_bits = ((uint32_t)offset & 0xFFF);
@@ -5464,6 +7770,7 @@ divs_i64_general_case:
                 emit_lw_phys(&ctx, 6, rs * 8, 18);  // t1 = v_regs[rs] (value)
                 
                 // SB - Store Byte (unsigned same as signed at byte level)
+                JIT_SANDBOX_ADDR_T0(&ctx, &offset);
                 if (offset >= -2048 && offset < 2048) {
                     uint32_t imm_bits = ((uint32_t)offset & 0xFFF);
                     uint32_t imm_11_5 = (imm_bits >> 5) << 25;
@@ -5510,6 +7817,7 @@ divs_i64_general_case:
                 }
                 
                 // SH - Store Halfword (16-bit, funct3=0b001)
+                JIT_SANDBOX_ADDR(&ctx, addr_reg, &offset);
                 if (offset >= -2048 && offset < 2048) {
                     uint32_t imm_bits = ((uint32_t)offset & 0xFFF);
                     uint32_t imm_11_5 = (imm_bits >> 5) << 25;
@@ -5540,6 +7848,7 @@ divs_i64_general_case:
                 emit_instr(&ctx, (0 << 25) | (6 << 20) | (0 << 15) | (0b011 << 12) | (6 << 7) | 0b0110011);
                 
                 // SB - Store Byte
+                JIT_SANDBOX_ADDR_T0(&ctx, &offset);
                 if (offset >= -2048 && offset < 2048) {
                     uint32_t imm_bits = ((uint32_t)offset & 0xFFF);
                     uint32_t imm_11_5 = (imm_bits >> 5) << 25;
@@ -5563,6 +7872,7 @@ divs_i64_general_case:
                 // Проверка деления на 0
                 if (imm == 0) {
                     printf("[JIT ERROR] REMS.I64.IMM8: Division by zero at compile time\n");
+                    espb_jit_code_abort(instance, exec_buffer);
                     *out_code = NULL;
                     *out_size = 0;
                     return ESPB_ERR_JIT_UNSUPPORTED_OPCODE;
@@ -5591,6 +7901,21 @@ divs_i64_general_case:
                 break;
             }
             
+            case 0xFD: { // PREFIX: V128 sub_op, операнды по espb_v128_operand_len
+                uint8_t sub_op = *pc++;
+                size_t v128_len = espb_v128_operand_len(sub_op);
+                if (v128_len == 0 || (size_t)(pc - bytecode_start) + v128_len > body->code_size ||
+                    !jit_emit_v128(&ctx, sub_op, pc)) {
+                    printf("[JIT ERROR] V128 opcode 0xFD 0x%02X not supported\n", sub_op);
+                    espb_jit_code_abort(instance, exec_buffer);
+                    *out_code = NULL;
+                    *out_size = 0;
+                    return ESPB_ERR_JIT_UNSUPPORTED_OPCODE;
+                }
+                pc += v128_len;
+                break;
+            }
+
             case 0xFC: { // PREFIX: Extended Ops
                 // Читаем второй байт - реальный опкод
                 uint8_t ext_opcode = *pc++;
@@ -5713,18 +8038,25 @@ divs_i64_general_case:
                         uint8_t rval = *pc++; // fill value (byte)
                         uint8_t rn = *pc++;   // size in bytes
                         
-                        // memset(dst, val, size)
+                        // espb_memory_fill(dst, val, size)
                         // a0 = dst из v_regs[rd]
                         emit_lw_phys(&ctx, 10, rd * 8, 18);
                         
                         // a1 = val из v_regs[rval] (только младший байт)
                         emit_lw_phys(&ctx, 11, rval * 8, 18);
                         
+                        // Размер из соседнего LDC.I32 - побайтовые sb без вызова
+                        uint32_t const_size;
+                        if (espb_bulk_const_size(bytecode_start, body->code_size, bytecode_offset, rn, &const_size) &&
+                            const_size <= JIT_INLINE_MEMFILL_MAX) {
+                            for (uint32_t i = 0; i < const_size; ++i) emit_sb_phys(&ctx, 11, (int16_t)i, 10);
+                            break;
+                        }
+                        
                         // a2 = size из v_regs[rn]
                         emit_lw_phys(&ctx, 12, rn * 8, 18);
                         
-                        // Вызываем memset
-                        emit_call_helper(&ctx, (uintptr_t)&memset);
+                        emit_call_helper(&ctx, (uintptr_t)&espb_memory_fill);
                         
                         break;
                     }
@@ -5734,18 +8066,27 @@ divs_i64_general_case:
                         uint8_t rs = *pc++;  // source address
                         uint8_t rn = *pc++;  // size in bytes
                         
-                        // memcpy(dst, src, size)
+                        // espb_memory_copy(dst, src, size), семантика memmove
                         // a0 = dst из v_regs[rd]
                         emit_lw_phys(&ctx, 10, rd * 8, 18);
                         
                         // a1 = src из v_regs[rs]
                         emit_lw_phys(&ctx, 11, rs * 8, 18);
                         
+                        // Размер из соседнего LDC.I32: все lbu до первого sb, перекрытие безопасно
+                        uint32_t const_size;
+                        if (espb_bulk_const_size(bytecode_start, body->code_size, bytecode_offset, rn, &const_size) &&
+                            const_size <= JIT_INLINE_MEMCOPY_MAX) {
+                            static const uint8_t tmp[JIT_INLINE_MEMCOPY_MAX] = { 12, 13, 14, 15, 16, 17, 5, 6 };
+                            for (uint32_t i = 0; i < const_size; ++i) emit_lbu_phys(&ctx, tmp[i], (int16_t)i, 11);
+                            for (uint32_t i = 0; i < const_size; ++i) emit_sb_phys(&ctx, tmp[i], (int16_t)i, 10);
+                            break;
+                        }
+                        
                         // a2 = size из v_regs[rn]
                         emit_lw_phys(&ctx, 12, rn * 8, 18);
                         
-                        // Вызываем memcpy
-                        emit_call_helper(&ctx, (uintptr_t)&memcpy);
+                        emit_call_helper(&ctx, (uintptr_t)&espb_memory_copy);
                         
                         break;
                     }
@@ -5978,9 +8319,30 @@ divs_i64_general_case:
                         
                         break;
                     }
+
+                    case 0x0C: { // MEMORY.SIZE Rd(u8)
+                        uint8_t rd = *pc++;
+                        emit_addi_phys(&ctx, 10, 9, 0);  // a0 = instance
+                        emit_call_helper(&ctx, (uintptr_t)&espb_memory_size);
+                        emit_sw_phys(&ctx, 10, rd * 8, 18);
+                        emit_sw_phys(&ctx, 0, rd * 8 + 4, 18);
+                        break;
+                    }
+
+                    case 0x0D: { // MEMORY.GROW Rd(u8), Rs(u8)
+                        uint8_t rd = *pc++;
+                        uint8_t rs = *pc++;
+                        emit_addi_phys(&ctx, 10, 9, 0);  // a0 = instance
+                        emit_lw_phys(&ctx, 11, rs * 8, 18);  // a1 = delta_pages
+                        emit_call_helper(&ctx, (uintptr_t)&espb_memory_grow);
+                        emit_sw_phys(&ctx, 10, rd * 8, 18);
+                        emit_sw_phys(&ctx, 0, rd * 8 + 4, 18);
+                        break;
+                    }
                     
                     default:
                         printf("[JIT] Extended opcode 0xFC 0x%02X not yet implemented\n", ext_opcode);
+                        espb_jit_code_abort(instance, exec_buffer);
                         *out_code = NULL;
                         *out_size = 0;
                         return ESPB_ERR_JIT_UNSUPPORTED_OPCODE;
@@ -6014,13 +8376,16 @@ divs_i64_general_case:
 
                 // IMPORTANT: interpreter MOV copies the whole Value (8 bytes).
                 // LLVM/translator may emit MOV.32 even when register holds I64/U64/F64.
-                // So we copy full 8 bytes to avoid losing high word.
+                // So we copy full 8 bytes to avoid losing high word - unless the body
+                // holds no 64-bit values at all (regs32).
 
                 emit_lw_phys(&ctx, 5, rs * 8, 18);
                 emit_sw_phys(&ctx, 5, rd * 8, 18);
 
-                emit_lw_phys(&ctx, 5, rs * 8 + 4, 18);
-                emit_sw_phys(&ctx, 5, rd * 8 + 4, 18);
+                if (!ctx.regs32) {
+                    emit_lw_phys(&ctx, 5, rs * 8 + 4, 18);
+                    emit_sw_phys(&ctx, 5, rd * 8 + 4, 18);
+                }
 
                 break;
             }
@@ -6238,6 +8603,15 @@ divs_i64_general_case:
                 uint16_t symbol_idx;
                 memcpy(&symbol_idx, pc, sizeof(symbol_idx)); pc += sizeof(symbol_idx);
 
+                // Глобал в globals_data: адрес считается на месте
+                if (!(symbol_idx & 0x8000) && espb_jit_global_direct_size(instance->module, symbol_idx, false) != 0) {
+                    int16_t goff = jit_emit_global_base(&ctx, instance, symbol_idx);
+                    emit_addi_phys(&ctx, 5, 7, goff);
+                    emit_sw_phys(&ctx, 5, rd * 8, 18);
+                    emit_sw_phys(&ctx, 0, rd * 8 + 4, 18);
+                    break;
+                }
+
                 // a0 = instance
                 emit_addi_phys(&ctx, 10, 9, 0);
                 // a1 = symbol_idx
@@ -6272,6 +8646,20 @@ divs_i64_general_case:
                 uint16_t global_idx;
                 memcpy(&global_idx, pc, sizeof(global_idx)); pc += sizeof(global_idx);
 
+                // Глобал в globals_data: одна загрузка вместо вызова espb_jit_ld_global.
+                // Как и helper, значения до 32 бит расширяются нулями на весь Value.
+                uint8_t gsize = espb_jit_global_direct_size(instance->module, global_idx, false);
+                if (gsize != 0) {
+                    int16_t goff = jit_emit_global_base(&ctx, instance, global_idx);
+                    if (gsize == 1) emit_lbu_phys(&ctx, 5, goff, 7);
+                    else if (gsize == 2) emit_lhu_phys(&ctx, 5, goff, 7);
+                    else emit_lw_phys(&ctx, 5, goff, 7);
+                    if (gsize == 8) emit_lw_phys(&ctx, 6, (int16_t)(goff + 4), 7);
+                    emit_sw_phys(&ctx, 5, rd * 8, 18);
+                    emit_sw_phys(&ctx, gsize == 8 ? 6 : 0, rd * 8 + 4, 18);
+                    break;
+                }
+
                 // a0 = instance
                 emit_addi_phys(&ctx, 10, 9, 0);
                 // a1 = global_idx
@@ -6306,6 +8694,19 @@ divs_i64_general_case:
                 memcpy(&global_idx, pc, sizeof(global_idx)); pc += sizeof(global_idx);
                 uint8_t rs = *pc++;
 
+                // Глобал в globals_data: одна запись вместо вызова espb_jit_st_global
+                uint8_t gsize = espb_jit_global_direct_size(instance->module, global_idx, true);
+                if (gsize != 0) {
+                    emit_lw_phys(&ctx, 5, rs * 8, 18);
+                    if (gsize == 8) emit_lw_phys(&ctx, 6, rs * 8 + 4, 18);
+                    int16_t goff = jit_emit_global_base(&ctx, instance, global_idx);
+                    if (gsize == 1) emit_sb_phys(&ctx, 5, goff, 7);
+                    else if (gsize == 2) emit_sh_phys(&ctx, 5, goff, 7);
+                    else emit_sw_phys(&ctx, 5, goff, 7);
+                    if (gsize == 8) emit_sw_phys(&ctx, 6, (int16_t)(goff + 4), 7);
+                    break;
+                }
+
                 // a0 = instance
                 emit_addi_phys(&ctx, 10, 9, 0);
                 // a1 = global_idx
@@ -7069,13 +9470,13 @@ divs_i64_general_case:
                 uint8_t rd = *pc++;
                 uint8_t rs1 = *pc++;
                 uint8_t rs2 = *pc++;
-                emit_lw_phys(&ctx, 10, rs1 * 8, 18);
-                emit_lw_phys(&ctx, 11, rs1 * 8 + 4, 18);
-                emit_lw_phys(&ctx, 12, rs2 * 8, 18);
-                emit_lw_phys(&ctx, 13, rs2 * 8 + 4, 18);
-                emit_call_helper(&ctx, (uintptr_t)&jit_helper_mul64);
-                emit_sw_phys(&ctx, 10, rd * 8, 18);
-                emit_sw_phys(&ctx, 11, rd * 8 + 4, 18);
+                emit_lw_phys(&ctx, 5, rs1 * 8, 18);
+                emit_lw_phys(&ctx, 6, rs1 * 8 + 4, 18);
+                emit_lw_phys(&ctx, 7, rs2 * 8, 18);
+                emit_lw_phys(&ctx, 28, rs2 * 8 + 4, 18);
+                emit_mul_i64_pairs(&ctx);
+                emit_sw_phys(&ctx, 5, rd * 8, 18);
+                emit_sw_phys(&ctx, 6, rd * 8 + 4, 18);
                 break;
             }
 
@@ -7960,6 +10361,31 @@ divs_i64_general_case:
             }
             
             case 0x0F: { // END - генерируем эпилог и возврат
+#if CONFIG_ESPB_JIT_INLINE
+                if (inl.active) {
+                    // Конец встроенного тела (ph/stable-кеш уже сброшены в его кадр):
+                    // R0 callee -> R0 вызывающей функции, s2 и разбор байт-кода - обратно
+                    if (inl.has_result) {
+                        emit_lw_phys(&ctx, 5, 0, 18);
+                        emit_lw_phys(&ctx, 6, 4, 18);
+                    }
+                    emit_lw_phys(&ctx, 18, (int16_t)inline_base, 8);
+                    if (inl.has_result) {
+                        emit_sw_phys(&ctx, 5, 0, 18);
+                        emit_sw_phys(&ctx, 6, 4, 18);
+                    }
+                    ctx.last_cmp_result_reg = 0xFF;
+                    pc = inl.ret_pc;
+                    end = inl.ret_end;
+                    ctx.regs32 = inl.regs32;
+                    inl.active = false;
+#if CONFIG_ESPB_JIT_REGALLOC
+                    ctx.ra = inl.ra;
+                    if (ctx.ra) jit_ra_sync(&ctx, false, false); // Конец барьера CALL
+#endif
+                    break;
+                }
+#endif
                 // peephole: убедимся что dirty значения записаны в v_regs
                 ph_flush(&ctx, &ph);
                 // Flush stable vcache
@@ -8056,6 +10482,11 @@ divs_i64_general_case:
                     restore_offset -= 4;
                     emit_lw_phys(&ctx, 23, restore_offset, 2);
                 }
+#if CONFIG_ESPB_JIT_REGALLOC
+                if (ra) {
+                    jit_ra_save_regs(&ctx, ra, &restore_offset, true);
+                }
+#endif
                 
                 // Освобождаем стек фрейм
                 emit_addi_phys(&ctx, 2, 2, (int16_t)total_frame_size); // sp += frame_size
@@ -8073,33 +10504,29 @@ divs_i64_general_case:
             }
             
             // ===== I64 Signed/Unsigned Comparisons & FP Comparisons & SELECT =====
-            case 0xCC: case 0xCD: case 0xCE: case 0xCF: { // CMP.I64 signed
-                uint8_t rd = *pc++; uint8_t r1 = *pc++; uint8_t r2 = *pc++;
-                emit_lw_phys(&ctx, 10, r1 * 8, 18); emit_lw_phys(&ctx, 11, r1 * 8 + 4, 18);
-                emit_lw_phys(&ctx, 12, r2 * 8, 18); emit_lw_phys(&ctx, 13, r2 * 8 + 4, 18);
-                uintptr_t helper = (opcode == 0xCC) ? (uintptr_t)&jit_helper_cmp_lts_i64 :
-                                   (opcode == 0xCD) ? (uintptr_t)&jit_helper_cmp_gt_i64 :
-                                   (opcode == 0xCE) ? (uintptr_t)&jit_helper_cmp_le_i64 :
-                                                      (uintptr_t)&jit_helper_cmp_ge_i64;
-                emit_call_helper(&ctx, helper);
-                emit_sw_phys(&ctx, 10, rd * 8, 18); emit_sw_phys(&ctx, 0, rd * 8 + 4, 18);
-                break;
-            }
+            case 0xCC: case 0xCD: case 0xCE: case 0xCF:   // CMP.I64 signed: LT, GT, LE, GE
             case 0xD0: case 0xD1: case 0xD2: case 0xD3: { // CMP.I64 unsigned
                 uint8_t rd = *pc++; uint8_t r1 = *pc++; uint8_t r2 = *pc++;
-                emit_lw_phys(&ctx, 10, r1 * 8, 18); emit_lw_phys(&ctx, 11, r1 * 8 + 4, 18);
-                emit_lw_phys(&ctx, 12, r2 * 8, 18); emit_lw_phys(&ctx, 13, r2 * 8 + 4, 18);
-                uintptr_t helper = (opcode == 0xD0) ? (uintptr_t)&jit_helper_cmp_ltu_i64 :
-                                   (opcode == 0xD1) ? (uintptr_t)&jit_helper_cmp_gtu_i64 :
-                                   (opcode == 0xD2) ? (uintptr_t)&jit_helper_cmp_leu_i64 :
-                                                      (uintptr_t)&jit_helper_cmp_geu_i64;
-                emit_call_helper(&ctx, helper);
-                emit_sw_phys(&ctx, 10, rd * 8, 18); emit_sw_phys(&ctx, 0, rd * 8 + 4, 18);
+                uint8_t cond = (opcode - 0xCC) & 3;  // 0=LT 1=GT 2=LE 3=GE
+                ctx.last_cmp_result_reg = 0xFF;
+                emit_cmp_i64_inline(&ctx, rd, r1, r2, opcode <= 0xCF,
+                                    cond == 1 || cond == 2,   // GT, LE: b < a
+                                    cond >= 2);               // LE, GE: !(...)
                 break;
             }
             case 0xE0: case 0xE1: case 0xE2: case 0xE3: case 0xE4: case 0xE5: { // CMP.F32
                 uint8_t rd = *pc++; uint8_t r1 = *pc++; uint8_t r2 = *pc++;
                 emit_lw_phys(&ctx, 10, r1 * 8, 18); emit_lw_phys(&ctx, 11, r2 * 8, 18);
+#if JIT_RV_HW_FPU
+                // feq/flt/fle дают 0 для NaN, как и C-сравнения; NE = !feq.
+                // GT/GE - это flt/fle с переставленными операндами.
+                bool swap = (opcode == 0xE3 || opcode == 0xE5);
+                uint8_t f3 = (opcode <= 0xE1) ? 0b010 : (opcode <= 0xE3) ? 0b001 : 0b000;
+                emit_fmv_w_x(&ctx, 0, 10);
+                emit_fmv_w_x(&ctx, 1, 11);
+                emit_fp_op(&ctx, RV_FCMP_S, 10, swap ? 1 : 0, swap ? 0 : 1, f3);
+                if (opcode == 0xE1) emit_xori_phys(&ctx, 10, 10, 1);
+#else
                 uintptr_t helper = (opcode == 0xE0) ? (uintptr_t)&jit_helper_cmp_eq_f32 :
                                    (opcode == 0xE1) ? (uintptr_t)&jit_helper_cmp_ne_f32 :
                                    (opcode == 0xE2) ? (uintptr_t)&jit_helper_cmp_lt_f32 :
@@ -8107,6 +10534,7 @@ divs_i64_general_case:
                                    (opcode == 0xE4) ? (uintptr_t)&jit_helper_cmp_le_f32 :
                                                       (uintptr_t)&jit_helper_cmp_ge_f32;
                 emit_call_helper(&ctx, helper);
+#endif
                 emit_sw_phys(&ctx, 10, rd * 8, 18); emit_sw_phys(&ctx, 0, rd * 8 + 4, 18);
                 break;
             }
@@ -8147,12 +10575,48 @@ divs_i64_general_case:
 
             default:
                 printf("[JIT ERROR] Unsupported opcode 0x%02X at bytecode offset %zu in func_idx=%u\n", opcode, bytecode_offset, func_idx);
-                free(exec_buffer);
+                espb_jit_code_abort(instance, exec_buffer);
                 *out_code = NULL;
                 *out_size = 0;
                 return ESPB_ERR_JIT_UNSUPPORTED_OPCODE;
         }
+
+#if CONFIG_ESPB_JIT_REGALLOC
+        if (ctx.ra) {
+            // Граница инструкции: t0/t1 и stable-кеш не переживают её, иначе закреплённые
+            // значения и кешированные копии в памяти разойдутся
+            ph_flush(&ctx, &ph);
+            ph_reset(&ph);
+            VCACHE_FLUSH_ALL();
+            jit_ra_end_insn(&ctx, opcode);
+        }
+#endif
+    }
+
+    // Бюджет исчерпан: код не влез в буфер или вышло время компиляции
+    if (ctx.overflow || timed_out) {
+        jit_context_free(&ctx);
+#if JIT_RV_RELOCS
+        free(ctx.relocs);
+#endif
+        espb_jit_code_abort(instance, exec_buffer);
+        *out_code = NULL;
+        *out_size = 0;
+        return timed_out ? ESPB_ERR_JIT_TIMEOUT : ESPB_ERR_JIT_CODE_TOO_LARGE;
+    }
+
+#if CONFIG_ESPB_JIT_REGALLOC
+    if (ctx.ra_failed) {
+        jit_context_free(&ctx);
+#if JIT_RV_RELOCS
+        free(ctx.relocs);
+#endif
+        espb_jit_code_abort(instance, exec_buffer);
+        *ra_failed = true;
+        return ESPB_ERR_JIT_UNSUPPORTED_OPCODE;
     }
+    ctx.ra = NULL; // Эпилог ниже работает с v_regs[] и s-регистрами напрямую
+#endif
     
     // Если мы дошли до конца без явного END, добавим эпилог автоматически
     // peephole: на всякий случай сбросить dirty значения
@@ -8192,6 +10656,11 @@ divs_i64_general_case:
             restore_offset -= 4;
             emit_lw_phys(&ctx, 23, restore_offset, 2);
         }
+#if CONFIG_ESPB_JIT_REGALLOC
+        if (ra) {
+            jit_ra_save_regs(&ctx, ra, &restore_offset, true);
+        }
+#endif
         
         emit_addi_phys(&ctx, 2, 2, (int16_t)total_frame_size);
         emit_jalr_phys(&ctx, 0, 1, 0);
@@ -8199,6 +10668,33 @@ divs_i64_general_case:
     
     // Фиксируем все переходы (теперь вызывается всегда в конце)
     jit_context_patch_branches(&ctx, bytecode, body->code_size);
+
+#if CONFIG_ESPB_JIT_OSR
+    EspbJitOsrInfo* osr = NULL;
+    if (ctx.osr_num_points > 0) {
+#if CONFIG_ESPB_JIT_REGALLOC
+        osr = jit_osr_emit_stub(&ctx, ra, osr_prologue_start, osr_prologue_end);
+#else
+        osr = jit_osr_emit_stub(&ctx, NULL, osr_prologue_start, osr_prologue_end);
+#endif
+    }
+#endif
+
+    EspbJitPcMap* pc_map = NULL;
+#if ESPB_JIT_PC_MAPS
+    // Метки ставятся в начале каждой инструкции - это и есть карта кода (сэмплер, карта JIT-кода)
+    if (out_pc_map && ctx.num_labels > 0) {
+        EspbJitPcMapEntry* entries = (EspbJitPcMapEntry*)malloc(ctx.num_labels * sizeof(EspbJitPcMapEntry));
+        if (entries) {
+            for (size_t i = 0; i < ctx.num_labels; i++) {
+                entries[i].native_offset = (uint32_t)ctx.labels[i].native_offset;
+                entries[i].bc_offset = (uint32_t)ctx.labels[i].bytecode_offset;
+            }
+            pc_map = espb_jit_pc_map_create(entries, ctx.num_labels);
+            free(entries);
+        }
+    }
+#endif
     
     // Освобождаем ресурсы
     jit_context_free(&ctx);
@@ -8235,13 +10731,35 @@ divs_i64_general_case:
     //            instr[0], instr[1], instr[2], instr[3]);
     // }
     
+    // Эпилог или OSR-заглушка не влезли в буфер
+    if (ctx.overflow) {
+#if JIT_RV_RELOCS
+        free(ctx.relocs);
+#endif
+#if CONFIG_ESPB_JIT_OSR
+        free(osr);
+#endif
+        free(pc_map);
+        espb_jit_code_abort(instance, exec_buffer);
+        *out_code = NULL;
+        *out_size = 0;
+        return ESPB_ERR_JIT_CODE_TOO_LARGE;
+    }
+
     // Проверяем что код не начинается с нулей или 0xFF
     if (ctx.offset >= 4) {
         uint32_t first_instr;
         memcpy(&first_instr, exec_buffer, 4);
         if (first_instr == 0 || first_instr == 0xFFFFFFFF) {
             printf("JIT ERROR: Invalid first instruction 0x%08x!\n", first_instr);
-            free(exec_buffer);
+#if JIT_RV_RELOCS
+            free(ctx.relocs);
+#endif
+#if CONFIG_ESPB_JIT_OSR
+            free(osr);
+#endif
+            free(pc_map);
+            espb_jit_code_abort(instance, exec_buffer);
             *out_code = NULL;
             *out_size = 0;
             return ESPB_ERR_JIT_UNSUPPORTED_OPCODE;
@@ -8259,11 +10777,31 @@ divs_i64_general_case:
 #define JIT_TRIM_EXEC_BUFFER 0
 #endif
 
+#if CONFIG_ESPB_JIT_SNAPSHOT
+    if (ctx.relocs_capacity != SIZE_MAX) {
+        espb_jit_snapshot_store(instance, func_idx, exec_buffer, ctx.offset, ctx.relocs, ctx.num_relocs);
+    }
+#endif
+#if CONFIG_ESPB_JIT_RELOAD
+    // Неполный список: код нельзя перенести, при замене модуля функция компилируется заново
+    if (out_relocs && ctx.relocs_capacity != SIZE_MAX) {
+        *out_relocs = espb_jit_relocs_create(ctx.relocs, ctx.num_relocs);
+    }
+#else
+    (void)out_relocs;
+#endif
+#if JIT_RV_RELOCS
+    free(ctx.relocs);
+#endif
+
+    bool in_arena = espb_jit_code_commit(instance, exec_buffer, ctx.offset);
+    (void)in_arena;
+
 #if JIT_TRIM_EXEC_BUFFER
     // Trim unused executable heap.
     // WARNING: With PC-relative helper calls (auipc+jalr), moving the code buffer breaks call targets.
     // Therefore, trimming is disabled by default.
-    uint8_t* trimmed = (uint8_t*)espb_exec_realloc(exec_buffer, ctx.offset);
+    uint8_t* trimmed = in_arena ? NULL : (uint8_t*)espb_exec_realloc(exec_buffer, ctx.offset);
     if (trimmed) {
         exec_buffer = trimmed;
         jit_icache_sync(exec_buffer, ctx.offset);
@@ -8272,15 +10810,79 @@ divs_i64_general_case:
 
     *out_code = exec_buffer;
     *out_size = ctx.offset;
+#if CONFIG_ESPB_JIT_OSR
+    if (out_osr) *out_osr = osr;
+#endif
+    if (out_pc_map) *out_pc_map = pc_map;
     
     // JIT compilation successful (silent mode)
 
-#ifdef JIT_STATS
-    printf("[JIT_STATS] func=%u helper_calls=%u abs_fallback=%u\n",
-           (unsigned)func_idx,
-           (unsigned)ctx.helper_call_count,
-           (unsigned)ctx.helper_call_fallback_abs_count);
-#endif
+    espb_jit_stats_codegen(instance, func_idx, (uint32_t)ctx.helper_call_count,
+                           (uint32_t)ctx.helper_call_fallback_abs_count, (uint32_t)ctx.spill_count);
 
     return ESPB_OK;
 }
+
+EspbResult espb_jit_compile_function(EspbInstance* instance, uint32_t func_idx, const EspbFunctionBody *body, void **out_code, size_t *out_size) {
+    return espb_jit_compile_function_ex(instance, func_idx, body, out_code, out_size, NULL, NULL, NULL);
+}
+
+static EspbResult jit_compile_function_attempt(EspbInstance* instance, uint32_t func_idx,
+                                               const EspbFunctionBody *body, void **out_code, size_t *out_size,
+                                               EspbJitOsrInfo **out_osr, EspbJitPcMap **out_pc_map,
+                                               EspbJitRelocs **out_relocs, int64_t deadline, bool inline_calls) {
+#if CONFIG_ESPB_JIT_REGALLOC
+    JitRegAlloc* ra = jit_ra_build(instance, body);
+    if (ra) {
+        bool ra_failed = false;
+        EspbResult res = jit_compile_function_impl(instance, func_idx, body, out_code, out_size, out_osr, out_pc_map,
+                                                   out_relocs, ra, &ra_failed, deadline, inline_calls);
+        jit_ra_free(ra);
+        if (!ra_failed) {
+            return res;
+        }
+        // Какой-то опкод обратился к v_regs[] в обход аллокатора: компилируем без него
+    }
+#endif
+
+    return jit_compile_function_impl(instance, func_idx, body, out_code, out_size, out_osr, out_pc_map, out_relocs,
+                                     NULL, NULL, deadline, inline_calls);
+}
+
+EspbResult espb_jit_compile_function_ex(EspbInstance* instance, uint32_t func_idx, const EspbFunctionBody *body,
+                                        void **out_code, size_t *out_size, EspbJitOsrInfo **out_osr,
+                                        EspbJitPcMap **out_pc_map, EspbJitRelocs **out_relocs) {
+    if (out_osr) *out_osr = NULL;
+    if (out_pc_map) *out_pc_map = NULL;
+    if (out_relocs) *out_relocs = NULL;
+    if (!instance || !body || !out_code || !out_size) {
+        return ESPB_ERR_INVALID_OPERAND;
+    }
+
+    if (body->is_jit_compiled) {
+        *out_code = body->jit_code;
+        *out_size = body->jit_code_size;
+        return ESPB_OK;
+    }
+
+#if CONFIG_ESPB_JIT_SNAPSHOT
+    // Код из снимка во flash: копируется в исполняемую память и перелинковывается без компиляции
+    if (espb_jit_snapshot_load(instance, func_idx, out_code, out_size, out_relocs) == ESPB_OK) {
+        return ESPB_OK;
+    }
+#endif
+
+    // Срок общий для всех попыток (с аллокатором регистров и без, со встраиванием и без)
+    int64_t deadline = espb_jit_deadline_start();
+
+    EspbResult res = jit_compile_function_attempt(instance, func_idx, body, out_code, out_size, out_osr, out_pc_map,
+                                                  out_relocs, deadline, true);
+#if CONFIG_ESPB_JIT_INLINE
+    // Встроенное тело содержит опкод, который бэкенд не компилирует: callee вызывается обычно
+    if (res == ESPB_ERR_JIT_UNSUPPORTED_OPCODE) {
+        res = jit_compile_function_attempt(instance, func_idx, body, out_code, out_size, out_osr, out_pc_map,
+                                           out_relocs, deadline, false);
+    }
+#endif
+    return res;
+}
@@ -576,7 +576,9 @@ EspbResult espb_jit_compile_function_xtensa_inline(
     uint32_t func_idx,
     const EspbFunctionBody* body,
     void** out_code,
-    size_t* out_size
+    size_t* out_size,
+    EspbJitOsrInfo** out_osr,
+    EspbJitPcMap** out_pc_map
 );
 
 EspbResult espb_jit_compile_function(EspbInstance *instance,
@@ -585,13 +587,29 @@ EspbResult espb_jit_compile_function(EspbInstance *instance,
                                     void **out_code,
                                     size_t *out_size)
 {
+    return espb_jit_compile_function_ex(instance, func_idx, body, out_code, out_size, NULL, NULL, NULL);
+}
+
+EspbResult espb_jit_compile_function_ex(EspbInstance *instance,
+                                    uint32_t func_idx,
+                                    const EspbFunctionBody *body,
+                                    void **out_code,
+                                    size_t *out_size,
+                                    EspbJitOsrInfo **out_osr,
+                                    EspbJitPcMap **out_pc_map,
+                                    EspbJitRelocs **out_relocs)
+{
+    if (out_osr) *out_osr = NULL;
+    if (out_pc_map) *out_pc_map = NULL;
+    // l32r-литералы в островах арены не переносятся: при замене модуля код компилируется заново
+    if (out_relocs) *out_relocs = NULL;
     if (!instance || !body || !out_code || !out_size) {
         return ESPB_ERR_INVALID_OPERAND;
     }
 
     // Switch to inline JIT (no ops-trampoline)
     JIT_LOGI(TAG, "Redirecting to inline Xtensa JIT for func_idx=%u", (unsigned)func_idx);
-    return espb_jit_compile_function_xtensa_inline(instance, func_idx, body, out_code, out_size);
+    return espb_jit_compile_function_xtensa_inline(instance, func_idx, body, out_code, out_size, out_osr, out_pc_map);
 
     // Old ops-trampoline code below (kept for reference, not executed)
 #if 0
@@ -47,12 +47,20 @@
 // Based on RISC-V JIT architecture
 
 #include "espb_jit.h"
+#include "espb_jit_budget.h"
+#include "espb_jit_osr.h"
+#include "espb_jit_code_map.h"
+#include "espb_fuel.h"
 #include "espb_interpreter_common_types.h"
 #include "espb_jit_dispatcher.h"
 #include "espb_jit_import_call.h"
 #include "espb_jit_globals.h"
 #include "espb_jit_helpers.h"
 #include "espb_jit_indirect_ptr.h"
+#include "espb_interpreter_threaded.h"
+#include "espb_sandbox.h"
+#include "espb_bulk_memory.h"
+#include "espb_simd.h"
 #include "espb_runtime_alloca.h"
 #include "espb_heap_manager.h"
 #include "esp_heap_caps.h"
@@ -60,42 +68,22 @@
 #include "esp_log.h"
 #include "espb_exec_memory.h"
 #include "esp_rom_sys.h"
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <math.h>
+#if CONFIG_ESPB_JIT_XTENSA_HW_LOOPS
+#include "xtensa/config/core-isa.h"
+#define XTENSA_HW_LOOPS XCHAL_HAVE_LOOPS
+#else
+#define XTENSA_HW_LOOPS 0
+#endif
 
 static const char* TAG = "espb_jit_xtensa_inline";
 
 // ===== Debug helpers (called from JIT code) =====
 // ===== C helpers for complex ops (called from JIT code) =====
-// Keep these helpers in C to avoid relying on uncalibrated Xtensa encodings for address arithmetic
-// and unaligned 64-bit stores.
-__attribute__((noinline))
-static void espb_jit_xtensa_store_i64(Value* v_regs, uint8_t rs, uint8_t ra, int32_t offset) {
-    // Semantics match interpreter op_0x76 (STORE.I64):
-    //   *( (uint8_t*)V_PTR(v_regs[ra]) + offset ) = V_I64(v_regs[rs])
-    if (!v_regs) return;
-    void* base = V_PTR(v_regs[ra]);
-    if (!base) return;
-    // Safety check: validate pointer looks like a valid ESP32 address
-    if ((uintptr_t)base < 0x3F000000 || (uintptr_t)base > 0x60100000) return;
-    int64_t v = V_I64(v_regs[rs]);
-    memcpy((uint8_t*)base + (intptr_t)offset, &v, sizeof(v));
-}
-
-__attribute__((noinline))
-static void espb_jit_xtensa_store_i32(Value* v_regs, uint8_t rs, uint8_t ra, int32_t offset) {
-    // Semantics match interpreter op_0x74 (STORE.I32):
-    //   *( (uint8_t*)V_PTR(v_regs[ra]) + offset ) = V_I32(v_regs[rs])
-    if (!v_regs) return;
-    void* base = V_PTR(v_regs[ra]);
-    if (!base) return;
-    // Safety check: validate pointer looks like a valid ESP32 address
-    if ((uintptr_t)base < 0x3F000000 || (uintptr_t)base > 0x60100000) return;
-    int32_t v = V_I32(v_regs[rs]);
-    memcpy((uint8_t*)base + (intptr_t)offset, &v, sizeof(v));
-}
-
+// Keep these helpers in C to avoid relying on uncalibrated Xtensa encodings for address arithmetic.
 __attribute__((noinline))
 static void espb_jit_xtensa_store_i16(Value* v_regs, uint8_t rs, uint8_t ra, int32_t offset) {
     // Semantics match interpreter op_0x72/0x73 (STORE.I16/U16):
@@ -135,36 +123,6 @@ static void espb_jit_xtensa_store_bool(Value* v_regs, uint8_t rs, uint8_t ra, in
     memcpy((uint8_t*)base + (intptr_t)offset, &v, sizeof(v));
 }
 
-__attribute__((noinline))
-static void espb_jit_xtensa_load_i32(Value* v_regs, uint8_t rd, uint8_t ra, int32_t offset) {
-    // Semantics match interpreter op_0x84 (LOAD.I32):
-    //   v_regs[rd] = *(int32_t*)(V_PTR(v_regs[ra]) + offset)
-    if (!v_regs) return;
-    void* base = V_PTR(v_regs[ra]);
-    if (!base) return;
-    // Safety check: validate pointer looks like a valid ESP32 address
-    if ((uintptr_t)base < 0x3F000000 || (uintptr_t)base > 0x60100000) return;
-    int32_t v;
-    memcpy(&v, (uint8_t*)base + (intptr_t)offset, sizeof(v));
-    SET_TYPE(v_regs[rd], ESPB_TYPE_I32);
-    V_I32(v_regs[rd]) = v;
-}
-
-__attribute__((noinline))
-static void espb_jit_xtensa_load_i64(Value* v_regs, uint8_t rd, uint8_t ra, int32_t offset) {
-    // Semantics match interpreter op_0x85 (LOAD.I64):
-    //   v_regs[rd] = *(int64_t*)(V_PTR(v_regs[ra]) + offset)
-    if (!v_regs) return;
-    void* base = V_PTR(v_regs[ra]);
-    if (!base) return;
-    // Safety check: validate pointer looks like a valid ESP32 address
-    if ((uintptr_t)base < 0x3F000000 || (uintptr_t)base > 0x60100000) return;
-    int64_t v;
-    memcpy(&v, (uint8_t*)base + (intptr_t)offset, sizeof(v));
-    SET_TYPE(v_regs[rd], ESPB_TYPE_I64);
-    V_I64(v_regs[rd]) = v;
-}
-
 // Helper: free pointer directly (ptr passed from JIT)
 // Wrapper needed to add NULL checks before calling espb_heap_free
 __attribute__((noinline))
@@ -770,6 +728,7 @@ static void jit_call_espb_function_xtensa(EspbInstance* instance, uint32_t local
         // ESP_LOGI(TAG, "[CALL] FAST PATH: func_idx=%u is JIT-compiled", (unsigned)local_func_idx);
         typedef void (*JitFunc)(EspbInstance*, Value*);
         JitFunc jit_func = (JitFunc)callee_body->jit_code;
+        espb_jit_note_call(instance, global_func_idx);
         
         uint16_t needed_regs = callee_body->header.num_virtual_regs;
         if (needed_regs == 0 || needed_regs > 256) needed_regs = 256;
@@ -777,9 +736,9 @@ static void jit_call_espb_function_xtensa(EspbInstance* instance, uint32_t local
         Value *callee_regs = (Value*)alloca((size_t)needed_regs * sizeof(Value));
         if (!callee_regs) goto slow_path;
         
-        uint16_t max_used = (uint16_t)callee_body->header.max_reg_used + 1;
+        uint16_t init_regs = ESPB_FRAME_ZERO_INIT_REGS(callee_body);
         uint16_t zero_regs = needed_regs;
-        if (max_used > 0 && max_used < zero_regs) zero_regs = max_used;
+        if (init_regs > 0 && init_regs < zero_regs) zero_regs = init_regs;
         if (zero_regs < num_args) zero_regs = num_args;
         if (zero_regs == 0) zero_regs = 1;
         
@@ -794,7 +753,10 @@ static void jit_call_espb_function_xtensa(EspbInstance* instance, uint32_t local
             callee_regs[i] = v_regs[i];
         }
         
+        // The callee's ALLOCA blocks are freed when it returns, as END does in the interpreter
+        uint32_t alloca_mark = espb_jit_alloca_mark();
         jit_func(instance, callee_regs);
+        espb_jit_alloca_restore(alloca_mark);
         
         // Copy return value back
         if (sig->num_returns > 0) {
@@ -1342,11 +1304,18 @@ static int32_t jit_helper_cvt_f64_i32_bits(uint64_t a_bits) {
 // Caller-saved: a2-a7 (arguments), a8 (scratch), a11 (scratch)
 
 // ===== JIT Context =====
+#ifndef CONFIG_ESPB_JIT_XTENSA_VCACHE
+#define CONFIG_ESPB_JIT_XTENSA_VCACHE 0
+#endif
+#define XTENSA_VC_SLOTS 4
+#define XTENSA_VC_FIRST_REG 2
+
 typedef struct {
     uint8_t* buffer;
     size_t capacity;   // bytes
     size_t offset;     // logical byte offset
     bool error;
+    bool overflow;     // error was set because the code did not fit into capacity
 
     // Physical write buffer for IRAM (word-only writes)
     uint32_t word_buf;
@@ -1356,8 +1325,44 @@ typedef struct {
     uint32_t* bc_to_native;
     size_t current_bc_off;
     size_t code_size;
+
+    // Write-through cache of v_regs words in a2..a5 (free after the prologue,
+    // preserved by call8/callx8 window rotation). See xtensa_vc_* below.
+    bool vc_active;        // cache may be used by the current bytecode instruction
+    bool vc_linear_mem;    // foreign-base stores of this instruction target linear memory
+    uint8_t vc_next;       // round-robin victim slot
+    int32_t vc_off[XTENSA_VC_SLOTS]; // cached v_regs byte offset per slot, -1 = empty
+
+#if CONFIG_ESPB_SANDBOX_MASKED
+    // Sandboxed linear memory: every guest address becomes memory_data | (addr & sb_mask)
+    uint32_t sb_mask;
+#endif
+
+#if CONFIG_ESPB_JIT_STATS
+    uint32_t helper_call_count; // Helper call sites; all are absolute (literal + callx8)
+#endif
 } XtensaJitContext;
 
+static void xtensa_vc_invalidate(XtensaJitContext* ctx) {
+    for (int i = 0; i < XTENSA_VC_SLOTS; i++) ctx->vc_off[i] = -1;
+}
+
+static int xtensa_vc_find(const XtensaJitContext* ctx, uint16_t off) {
+    if (!ctx->vc_active) return -1;
+    for (int i = 0; i < XTENSA_VC_SLOTS; i++) {
+        if (ctx->vc_off[i] == (int32_t)off) return i;
+    }
+    return -1;
+}
+
+// Drop the cached word containing byte offset `off` (narrow stores into v_regs).
+static void xtensa_vc_forget(XtensaJitContext* ctx, uint16_t off) {
+    int32_t word = (int32_t)(off & ~3u);
+    for (int i = 0; i < XTENSA_VC_SLOTS; i++) {
+        if (ctx->vc_off[i] == word) ctx->vc_off[i] = -1;
+    }
+}
+
 // ===== Low-level Xtensa Emitters =====
 
 // Forward declarations (some emitters call others defined later)
@@ -1371,6 +1376,7 @@ static inline void emit_u8(XtensaJitContext* ctx, uint8_t byte) {
     if (ctx->error) return;
     if (ctx->offset >= ctx->capacity) {
         ctx->error = true;
+        ctx->overflow = true;
         return;
     }
 
@@ -1400,6 +1406,7 @@ static inline void emit_u8(XtensaJitContext* ctx, uint8_t byte) {
         size_t word_start = ctx->offset - 4;
         if (word_start + 4 > ctx->capacity) {
             ctx->error = true;
+            ctx->overflow = true;
             return;
         }
         // CRITICAL FIX: If we didn't fill all 4 bytes of the word (word_fill < 4),
@@ -1442,6 +1449,7 @@ static inline void emit_flush_words(XtensaJitContext* ctx) {
     
     if (word_start + 4 > ctx->capacity) {
         ctx->error = true;
+        ctx->overflow = true;
         return;
     }
 
@@ -1572,6 +1580,15 @@ static void emit_l32i_raw(XtensaJitContext* ctx, uint8_t at, uint8_t as, uint16_
 static void emit_l32i(XtensaJitContext* ctx, uint8_t at, uint8_t as, uint16_t offset_bytes) {
     if (ctx->error) return;
 
+    // v_regs word already held in a cache register => register move instead of a load
+    if (as == 6 || as == 11) {
+        int slot = xtensa_vc_find(ctx, offset_bytes);
+        if (slot >= 0) {
+            emit_mov_n(ctx, at, (uint8_t)(XTENSA_VC_FIRST_REG + slot));
+            return;
+        }
+    }
+
     if ((offset_bytes % 4) == 0) {
         uint32_t offw = (uint32_t)(offset_bytes / 4);
         if (offw <= 0xFFu) {
@@ -1644,7 +1661,33 @@ static void emit_s32i_raw(XtensaJitContext* ctx, uint8_t at, uint8_t as, uint16_
     ctx->error = true;
 }
 
+static void emit_s32i_mem(XtensaJitContext* ctx, uint8_t at, uint8_t as, uint16_t offset_bytes);
+
+// Store + cache bookkeeping: v_regs stores (base a6/a11) are written through and
+// mirrored into a cache register; other stores may alias v_regs unless the
+// current instruction is known to write linear memory.
 static void emit_s32i(XtensaJitContext* ctx, uint8_t at, uint8_t as, uint16_t offset_bytes) {
+    emit_s32i_mem(ctx, at, as, offset_bytes);
+    if (ctx->error) return;
+
+    if (as == 6 || as == 11) {
+        if (!ctx->vc_active) {
+            xtensa_vc_forget(ctx, offset_bytes);
+            return;
+        }
+        int slot = xtensa_vc_find(ctx, offset_bytes);
+        if (slot < 0) {
+            slot = ctx->vc_next;
+            ctx->vc_next = (uint8_t)((ctx->vc_next + 1u) % XTENSA_VC_SLOTS);
+        }
+        emit_mov_n(ctx, (uint8_t)(XTENSA_VC_FIRST_REG + slot), at);
+        ctx->vc_off[slot] = (int32_t)offset_bytes;
+    } else if (as != 1 && !ctx->vc_linear_mem) {
+        xtensa_vc_invalidate(ctx);
+    }
+}
+
+static void emit_s32i_mem(XtensaJitContext* ctx, uint8_t at, uint8_t as, uint16_t offset_bytes) {
     if (ctx->error) return;
 
     if ((offset_bytes % 4) == 0) {
@@ -1703,6 +1746,9 @@ static void emit_s8i_raw(XtensaJitContext* ctx, uint8_t at, uint8_t as, uint16_t
 static void emit_s8i(XtensaJitContext* ctx, uint8_t at, uint8_t as, uint16_t offset_bytes) {
     if (ctx->error) return;
 
+    if (as == 6 || as == 11) xtensa_vc_forget(ctx, offset_bytes);
+    else if (as != 1 && !ctx->vc_linear_mem) xtensa_vc_invalidate(ctx);
+
     if (offset_bytes <= 0xFFu) {
         emit_s8i_raw(ctx, at, as, offset_bytes);
         return;
@@ -1747,6 +1793,9 @@ static void emit_s16i_raw(XtensaJitContext* ctx, uint8_t at, uint8_t as, uint16_
 static void emit_s16i(XtensaJitContext* ctx, uint8_t at, uint8_t as, uint16_t offset_bytes) {
     if (ctx->error) return;
 
+    if (as == 6 || as == 11) xtensa_vc_forget(ctx, offset_bytes);
+    else if (as != 1 && !ctx->vc_linear_mem) xtensa_vc_invalidate(ctx);
+
     if ((offset_bytes % 2) == 0) {
         uint32_t offh = (uint32_t)(offset_bytes / 2);
         if (offh <= 0xFFu) {
@@ -1963,6 +2012,16 @@ static void emit_sub_a8_a8_a9(XtensaJitContext* ctx) {
     emit_u8(ctx, 0xC0);
 }
 
+#if XTENSA_HW_LOOPS
+// SUB aR, aS, aT (3-byte), same layout as emit_sub_a8_a8_a9:
+//   byte0 = (at << 4), byte1 = (as << 4) | ar, byte2 = 0xC0
+static void emit_sub(XtensaJitContext* ctx, uint8_t ar, uint8_t as, uint8_t at) {
+    emit_u8(ctx, (uint8_t)((at & 0xF) << 4));
+    emit_u8(ctx, (uint8_t)(((as & 0xF) << 4) | (ar & 0xF)));
+    emit_u8(ctx, 0xC0);
+}
+#endif
+
 // ADD.N aR, aS, aT (2-byte)
 // Verified by objdump:
 //   add.n a8,  a8, a9  => bytes 88 9A
@@ -2003,6 +2062,19 @@ static void emit_or(XtensaJitContext* ctx, uint8_t ar, uint8_t as, uint8_t at) {
     emit_u8(ctx, b2);
 }
 
+// AND aR, aS, aT (3-byte) - bitwise AND
+// Encoding: same as OR with byte2 = 0x10
+static void emit_and(XtensaJitContext* ctx, uint8_t ar, uint8_t as, uint8_t at) {
+    if ((ar | as | at) & 0xF0) {
+        ESP_LOGE(TAG, "emit_and: regs out of range ar=%u as=%u at=%u", (unsigned)ar, (unsigned)as, (unsigned)at);
+        ctx->error = true;
+        return;
+    }
+    emit_u8(ctx, (uint8_t)((at & 0xF) << 4));
+    emit_u8(ctx, (uint8_t)(((as & 0xF) << 4) | (ar & 0xF)));
+    emit_u8(ctx, 0x10u);
+}
+
 // EXTUI aR, aS, shift, width (3-byte) - extract unsigned immediate
 // Verified by objdump (big-endian display, little-endian memory):
 //   extui a10, a9, 8, 8   => 74a890 => bytes: a0 98 74 (shift=8, width=8)
@@ -2197,6 +2269,38 @@ static void emit_jx_a8(XtensaJitContext* ctx) {
     emit_u8(ctx, 0x00);
 }
 
+// ADDX2 aR, aS, aT: aR = (aS << 1) + aT (3-byte RRR, op2=9, op1=0)
+// Same field layout as SUB above (sub a8, a8, a9 => bytes 90 88 C0):
+//   byte0 = at << 4
+//   byte1 = (ar << 4) | as
+//   byte2 = (op2 << 4) | op1
+static void emit_addx2(XtensaJitContext* ctx, uint8_t ar, uint8_t as, uint8_t at) {
+    emit_u8(ctx, (uint8_t)((at & 0xF) << 4));
+    emit_u8(ctx, (uint8_t)(((ar & 0xF) << 4) | (as & 0xF)));
+    emit_u8(ctx, 0x90);
+}
+
+// CALL0 to the very next instruction, used to read PC into a0 (a0 = PC + 3).
+// CALL format: op0=0101, n=00, offset18 in bits [23:6]; target = (PC & ~3) + (offset << 2) + 4,
+// so offset 0 lands on PC + 3 only when PC % 4 == 1 (caller pads with NOPs).
+static void emit_call0_next(XtensaJitContext* ctx) {
+    if ((ctx->offset & 3u) != 1u) {
+        ESP_LOGE(TAG, "emit_call0_next: misaligned call0 at %u", (unsigned)ctx->offset);
+        ctx->error = true;
+        return;
+    }
+    emit_u8(ctx, 0x05);
+    emit_u8(ctx, 0x00);
+    emit_u8(ctx, 0x00);
+}
+
+// BR_TABLE with at most this many targets is lowered to a compare chain, larger ones to a jump table.
+#define XTENSA_BR_TABLE_CHAIN_MAX 8
+
+// MEMORY.COPY / MEMORY.FILL with a size from an adjacent LDC.I32 up to these bounds is emitted inline as byte loads/stores.
+#define XTENSA_INLINE_MEMCOPY_MAX 6
+#define XTENSA_INLINE_MEMFILL_MAX 16
+
 // BEQZ.N a8, target (2-byte) -- patchable
 // Encoding derived from multiple objdump samples (a8 only):
 //   word = 0x?88C / 0x?89C, where immediate imm5 encodes delta_bytes.
@@ -2296,6 +2400,8 @@ static void emit_retw(XtensaJitContext* ctx) {
 
 // CALL8 offset (windowed call, offset in words, PC-relative)
 static void emit_call8(XtensaJitContext* ctx, int32_t offset_bytes) {
+    // Callee may write v_regs through its own pointer
+    xtensa_vc_invalidate(ctx);
     // Format: CALL8 = 0x000015 | ((offset_words & 0x3FFFF) << 6)
     int32_t offset_words = offset_bytes / 4;
     uint32_t instr = 0x000015 | (((uint32_t)offset_words & 0x3FFFF) << 6);
@@ -2333,6 +2439,7 @@ static void emit_l32r_a8_back_to(XtensaJitContext* ctx, uintptr_t pc_abs, uintpt
 // CALLX8 a8
 // Verified by objdump (.text bytes) for callx8 a8: 0008e0 => bytes E0 08 00
 static void emit_callx8_a8(XtensaJitContext* ctx) {
+    xtensa_vc_invalidate(ctx);
     emit_u8(ctx, 0xE0);
     emit_u8(ctx, 0x08);
     emit_u8(ctx, 0x00);
@@ -2350,6 +2457,11 @@ typedef struct XtensaLiteralPool {
     XtensaLitEntry entries[XTENSA_LIT_MAX];
     uint32_t count;
     bool has_pool; // whether we have emitted at least one pool
+    // Shared island at the start of the arena chunk (see espb_jit_arena.h).
+    // island_vals is the DRAM template, island_abs the copy in exec memory.
+    const uint32_t* island_vals;
+    uintptr_t island_abs;
+    uint32_t island_count;
 } XtensaLiteralPool;
 
 static int lit_find(const XtensaLiteralPool* pool, uint32_t value) {
@@ -2755,6 +2867,18 @@ static void flush_literal_pool(XtensaJitContext* ctx, XtensaLiteralPool* pool) {
 }
 
 static void emit_load_u32_to_a8(XtensaJitContext* ctx, XtensaLiteralPool* pool, uint32_t value) {
+    // Helper addresses shared by the whole chunk: l32r straight to the island, no per-function pool.
+    for (uint32_t i = 0; i < pool->island_count; i++) {
+        if (pool->island_vals[i] != value) continue;
+        uintptr_t pc_abs = (uintptr_t)(ctx->buffer + ctx->offset);
+        uintptr_t lit_abs = pool->island_abs + i * 4u;
+        if (((pc_abs + 3u) & ~3u) - lit_abs <= 32768u * 4u) {
+            emit_l32r_a8_back_to(ctx, pc_abs, lit_abs);
+            return;
+        }
+        break;
+    }
+
     int idx = lit_find(pool, value);
     if (idx < 0) {
         idx = lit_add(pool, value);
@@ -2812,6 +2936,9 @@ static void emit_call8_rel(XtensaJitContext* ctx, uintptr_t pc_abs, uintptr_t ta
 }
 
 static void emit_call_helper(XtensaJitContext* ctx, XtensaLiteralPool* pool, void* helper_func) {
+#if CONFIG_ESPB_JIT_STATS
+    ctx->helper_call_count++;
+#endif
     uintptr_t pc_abs = (uintptr_t)(ctx->buffer + ctx->offset);
     uintptr_t tgt_abs = (uintptr_t)helper_func;
     emit_call8_rel(ctx, pc_abs, tgt_abs);
@@ -2823,6 +2950,30 @@ static void emit_call_helper(XtensaJitContext* ctx, XtensaLiteralPool* pool, voi
     emit_callx8_a8(ctx);
 }
 
+#if CONFIG_ESPB_FUEL
+#define XTENSA_FUEL_CHECK_MAX_BYTES 40  // Upper bound of xtensa_emit_fuel_check
+
+_Static_assert(offsetof(EspbInstance, fuel) < 1024, "EspbInstance.fuel must be reachable with l32i");
+
+// --instance->fuel; at <= 0 call espb_fuel_refill(instance).
+// Clobbers a8..a15 (a11 = v_regs is reloaded): only where no vreg is cached in registers.
+static void xtensa_emit_fuel_check(XtensaJitContext* ctx, XtensaLiteralPool* pool) {
+    const uint16_t fuel_off = (uint16_t)offsetof(EspbInstance, fuel);
+    emit_l32i(ctx, 8, 1, 4);                  // a8 = instance
+    emit_l32i(ctx, 9, 8, fuel_off);
+    emit_addi(ctx, 9, 9, -1);
+    emit_s32i(ctx, 9, 8, fuel_off);
+    emit_movi_n(ctx, 8, 0);
+    uint32_t skip_pos = emit_bcc_a8_a9_placeholder(ctx, 0x2);  // blt a8, a9: fuel left
+
+    emit_l32i(ctx, 10, 1, 4);                 // a10 -> callee a2 = instance
+    emit_call_helper(ctx, pool, (void*)&espb_fuel_refill);
+    emit_l32i(ctx, 11, 1, 8);                 // a11 = v_regs
+    emit_align4_with_nops(ctx);
+    patch_bcc_a8_a9_at(ctx->buffer, skip_pos, (int32_t)ctx->offset);
+}
+#endif
+
 // ===== Helper: Sync code cache =====
 static void xtensa_sync_code(void* code, size_t size) {
     esp_cache_msync(code, size, ESP_CACHE_MSYNC_FLAG_DIR_C2M | ESP_CACHE_MSYNC_FLAG_INVALIDATE);
@@ -2859,6 +3010,552 @@ static void emit_store_vreg(XtensaJitContext* ctx, uint8_t ar, uint8_t rd) {
     emit_s32i(ctx, ar, 11, offset);  // a11 = v_regs base
 }
 
+// ===== Linear memory access (LOAD/STORE .I32/.I64/.F32/.F64) =====
+#if CONFIG_ESPB_SANDBOX_MASKED
+// ar = instance->memory_data | (ar & sb_mask). Clobbers a8; for ar == a8 also clobbers a7.
+// The base is always loaded through the instance so the code embeds no heap address
+// (shared modules, flash snapshots and reload carry-over all rely on that).
+static void xtensa_emit_sandbox_addr(XtensaJitContext* ctx, XtensaLiteralPool* pool, uint8_t ar) {
+    uint8_t at = ar;
+    if (ar == 8) {
+        emit_mov_n(ctx, 7, 8);
+        at = 7;
+    }
+    emit_load_u32_to_a8(ctx, pool, ctx->sb_mask);
+    emit_and(ctx, at, at, 8);
+    emit_l32i(ctx, 8, 1, 4);  // a8 = instance (saved by the prologue)
+    emit_l32i(ctx, 8, 8, (uint16_t)offsetof(EspbInstance, memory_data));
+    emit_or(ctx, ar, at, 8);
+}
+#define XTENSA_SANDBOX_ADDR(ctx, pool, ar) xtensa_emit_sandbox_addr((ctx), (pool), (ar))
+#else
+#define XTENSA_SANDBOX_ADDR(ctx, pool, ar) ((void)0)
+#endif
+
+_Static_assert(offsetof(EspbInstance, globals_data) < 1024, "EspbInstance.globals_data must be reachable with l32i");
+
+// a8 + (returned offset) = address of a CONST/ZERO global (espb_jit_global_direct_size).
+// The base is read from the instance, the offset is a constant. Clobbers a9.
+static uint16_t xtensa_emit_global_base(XtensaJitContext* ctx, XtensaLiteralPool* pool, const EspbInstance* instance,
+                                        uint16_t global_idx) {
+    uint32_t off = instance->global_offsets[global_idx];
+    bool near = off + 8 <= 256;  // l8ui/s8i reach 255 bytes
+    if (!near) {
+        emit_load_u32_to_a8(ctx, pool, off);
+        emit_mov_n(ctx, 9, 8);
+    }
+    emit_l32i(ctx, 8, 1, 4);  // a8 = instance (saved by the prologue)
+    emit_l32i(ctx, 8, 8, (uint16_t)offsetof(EspbInstance, globals_data));
+    if (near) return (uint16_t)off;
+    emit_add_n(ctx, 8, 8, 9);
+    return 0;
+}
+
+// a6 = v_regs, a8 = V_PTR(v_regs[ra]) + off16. Caller restores a11 from a6. Clobbers a7.
+static void xtensa_emit_mem_addr(XtensaJitContext* ctx, XtensaLiteralPool* pool, uint8_t ra, int16_t off16) {
+    emit_mov_n(ctx, 6, 11);
+    emit_l32i(ctx, 8, 6, (uint16_t)(ra * 8));
+    if (off16 >= -128 && off16 <= 127) {
+        if (off16 != 0) emit_addi(ctx, 8, 8, (int8_t)off16);
+    } else {
+        emit_mov_n(ctx, 7, 8);  // a7 = base (l32r below overwrites a8)
+        emit_load_u32_to_a8(ctx, pool, (uint32_t)(int32_t)off16);
+        emit_add_n(ctx, 8, 7, 8);
+    }
+    XTENSA_SANDBOX_ADDR(ctx, pool, 8);
+}
+
+// at = *(uint32_t*)(a8 + disp). Interpreter uses memcpy semantics, so unaligned
+// offsets are assembled from bytes (little-endian) with a7 as scratch.
+static void xtensa_emit_mem_load_u32(XtensaJitContext* ctx, uint8_t at, uint8_t disp, bool aligned) {
+    if (aligned) {
+        emit_l32i(ctx, at, 8, disp);
+        return;
+    }
+    emit_l8ui(ctx, at, 8, disp);
+    for (uint8_t i = 1; i < 4; i++) {
+        emit_l8ui(ctx, 7, 8, (uint16_t)(disp + i));
+        emit_slli(ctx, 7, 7, (uint8_t)(i * 8));
+        emit_or(ctx, at, at, 7);
+    }
+}
+
+// *(uint32_t*)(a8 + disp) = as_val; byte-wise for unaligned offsets (a7 scratch).
+static void xtensa_emit_mem_store_u32(XtensaJitContext* ctx, uint8_t as_val, uint8_t disp, bool aligned) {
+    if (aligned) {
+        emit_s32i(ctx, as_val, 8, disp);
+        return;
+    }
+    emit_s8i(ctx, as_val, 8, disp);
+    for (uint8_t i = 1; i < 4; i++) {
+        emit_srli(ctx, 7, as_val, (uint8_t)(i * 8));
+        emit_s8i(ctx, 7, 8, (uint16_t)(disp + i));
+    }
+}
+
+#if CONFIG_ESPB_JIT_XTENSA_VCACHE || XTENSA_HW_LOOPS
+// Bitmap of bytecode offsets that are branch targets (cache is dropped there).
+// NULL => no cache for this function: ADDR_OF lets pointer stores alias v_regs,
+// or the bytecode does not decode cleanly.
+static uint8_t* xtensa_vc_scan_targets(const uint8_t* code, size_t code_size) {
+    size_t bytes = (code_size >> 3) + 1;
+    uint8_t* targets = (uint8_t*)heap_caps_malloc(bytes, MALLOC_CAP_8BIT);
+    if (!targets) return NULL;
+    memset(targets, 0, bytes);
+
+    const uint8_t* end = code + code_size;
+    const uint8_t* p = code;
+    while (p < end) {
+        uint8_t op = *p;
+        size_t len = (op == 0x16) ? 4 : espb_instruction_length(p, end);
+        if (len == 0 || op == 0x8E) {
+            heap_caps_free(targets);
+            return NULL;
+        }
+        int32_t off = (int32_t)(p - code);
+        int16_t rel;
+        // BR/BR_IF: relative to the instruction start; BR_TABLE: relative to its end
+        if (op == 0x02 || op == 0x03) {
+            memcpy(&rel, p + (op == 0x02 ? 1 : 2), sizeof(rel));
+            int32_t t = off + rel;
+            if (t >= 0 && t <= (int32_t)code_size) targets[t >> 3] |= (uint8_t)(1u << (t & 7));
+        } else if (op == 0x04) {
+            uint16_t n;
+            memcpy(&n, p + 2, sizeof(n));
+            for (uint32_t i = 0; i <= n; i++) {
+                memcpy(&rel, p + 4 + i * 2, sizeof(rel));
+                int32_t t = off + (int32_t)len + rel;
+                if (t >= 0 && t <= (int32_t)code_size) targets[t >> 3] |= (uint8_t)(1u << (t & 7));
+            }
+        }
+        p += len;
+    }
+    return targets;
+}
+#endif
+
+#if XTENSA_HW_LOOPS
+// Counted innermost loop lowered to a zero-overhead LOOP (LBEG/LEND/LCOUNT). Two shapes:
+//   H: <straight-line body> CMP Rc, Ri, Rn; BR_IF Rc, H              (continue while CMP)
+//   H: <straight-line body> CMP Rc, Ri, Rn; BR_IF Rc, EXIT; BR H     (leave when CMP)
+// Ri is written once in the body, by ADD.I32.IMM8 Ri, Ri, 1, and Rn is either not
+// written or reloaded with the same LDC.I32.IMM, so the trip count is known at H:
+// n - i for NE (modulo 2^32) and max(n - i, 1) for LT (do-while: one pass at least).
+#define XTENSA_HWLOOP_NO_EXIT 0xFFFFFFFFu
+typedef struct {
+    uint32_t header;  // Trip count setup, LBEG follows
+    uint32_t br_if;   // Closing BR_IF, replaced by LEND
+    uint32_t exit;    // EXIT of the second shape (j EXIT after LEND), else XTENSA_HWLOOP_NO_EXIT
+    uint32_t bound;   // n when bound_imm
+    uint8_t ri;       // Induction variable
+    uint8_t rn;       // Bound register
+    uint8_t cmp;      // Continue condition: 0xC1 NE, 0xC2 LT.S, 0xC6 LT.U
+    bool bound_imm;   // Rn is an LDC.I32.IMM in the body
+} XtensaHwLoop;
+
+// Opcodes lowered inline with branches only inside their own code. Helper calls are
+// excluded: C code is free to use LOOP itself and clobber LBEG/LEND/LCOUNT.
+static bool xtensa_hwloop_op_ok(uint8_t op) {
+    if (op >= 0x10 && op <= 0x13) return true;  // MOV
+    if (op >= 0x18 && op <= 0x1C) return true;  // LDC
+    if (op >= 0x20 && op <= 0x22) return true;  // ADD/SUB/MUL.I32
+    if (op >= 0x28 && op <= 0x2E) return true;  // I32 bitwise/shifts
+    if (op >= 0x40 && op <= 0x42) return true;  // ADD/SUB/MUL.I32.IMM8
+    if (op >= 0x47 && op <= 0x4B) return true;  // I32 shifts/bitwise IMM8
+    if (op >= 0x70 && op <= 0x7B) return true;  // STORE.*
+    if (op >= 0x80 && op <= 0x89) return true;  // LOAD.*
+    if (op >= 0x90 && op <= 0xA1) return op != 0x91 && op != 0x9A;  // TRUNC/ZEXT/SEXT
+    if (op >= 0xC0 && op <= 0xC9) return true;  // CMP.*.I32
+    return op == 0x00 || op == 0x01 || op == 0x50 || op == 0x58 || op == 0xBC || op == 0xBD;
+}
+
+// Checks the writes to Ri and Rn in [p, cmp). Every allowed opcode except the stores
+// writes its first operand only.
+static bool xtensa_hwloop_check_regs(const uint8_t* p, const uint8_t* cmp, XtensaHwLoop* loop) {
+    bool stepped = false;
+    loop->bound_imm = false;
+    while (p < cmp) {
+        uint8_t op = p[0];
+        if (op < 0x70 || op > 0x7B) {
+            if (p[1] == loop->rn) {
+                if (loop->bound_imm || op != 0x18) return false;
+                memcpy(&loop->bound, p + 2, sizeof(loop->bound));
+                loop->bound_imm = true;
+            } else if (p[1] == loop->ri) {
+                if (stepped || op != 0x40 || p[2] != loop->ri || (int8_t)p[3] != 1) return false;
+                stepped = true;
+            }
+        }
+        p += espb_instruction_length(p, cmp);
+    }
+    return stepped;
+}
+
+static bool xtensa_hwloop_match(const uint8_t* code, size_t code_size, const uint8_t* targets,
+                                uint32_t header, uint32_t br_if, uint32_t exit, XtensaHwLoop* out) {
+    const uint8_t* end = code + code_size;
+    const uint8_t* p = code + header;
+    const uint8_t* cmp = NULL;
+    while (p < code + br_if) {
+        uint32_t off = (uint32_t)(p - code);
+        // Entering the body anywhere but H would skip the LOOP setup
+        if (off != header && (targets[off >> 3] & (1u << (off & 7)))) return false;
+        if (!xtensa_hwloop_op_ok(*p)) return false;
+        cmp = p;
+        p += espb_instruction_length(p, end);
+    }
+    if (p != code + br_if || !cmp || (targets[br_if >> 3] & (1u << (br_if & 7)))) return false;
+    if (exit != XTENSA_HWLOOP_NO_EXIT) {
+        uint32_t br = br_if + 4;
+        if ((targets[br >> 3] & (1u << (br & 7))) || (exit >= header && exit <= br)) return false;
+    }
+
+    // Continue condition as CMP (Ri-or-Rn, Rn-or-Ri): the second shape continues
+    // while its compare is false
+    uint8_t op = cmp[0];
+    uint8_t rc = cmp[1], ra = cmp[2], rb = cmp[3];
+    if (rc != code[br_if + 1]) return false;
+    if (exit != XTENSA_HWLOOP_NO_EXIT) {
+        switch (op) {
+            case 0xC0: op = 0xC1; break;                 // !(i == n): i != n
+            case 0xC4: op = 0xC3; break;                 // !(n <= i): n > i
+            case 0xC5: op = 0xC2; break;                 // !(i >= n): i < n
+            case 0xC8: op = 0xC7; break;
+            case 0xC9: op = 0xC6; break;
+            default: return false;
+        }
+    }
+    if (op == 0xC3 || op == 0xC7) {  // GT (n, i) == LT (i, n)
+        uint8_t t = ra; ra = rb; rb = t;
+        op = (uint8_t)(op - 1);
+    }
+    if (op != 0xC1 && op != 0xC2 && op != 0xC6) return false;
+    if (ra == rb || rc == ra || rc == rb) return false;
+
+    for (int swap = 0; swap < (op == 0xC1 ? 2 : 1); swap++) {
+        *out = (XtensaHwLoop){ .header = header, .br_if = br_if, .exit = exit,
+                               .ri = swap ? rb : ra, .rn = swap ? ra : rb, .cmp = op };
+        if (xtensa_hwloop_check_regs(code + header, cmp, out)) return true;
+    }
+    return false;
+}
+
+// Loops in bytecode order (they cannot overlap: no branch enters a loop body).
+// NULL when there are none or the function uses ADDR_OF (stores may then write Ri/Rn).
+static XtensaHwLoop* xtensa_hwloop_scan(const uint8_t* code, size_t code_size, size_t* out_count) {
+    *out_count = 0;
+    uint8_t* targets = xtensa_vc_scan_targets(code, code_size);
+    if (!targets) return NULL;
+
+    const uint8_t* end = code + code_size;
+    size_t back_edges = 0;
+    for (const uint8_t* p = code; p < end; p += (*p == 0x16) ? 4 : espb_instruction_length(p, end)) {
+        if ((*p == 0x02 && (int8_t)p[2] < 0) || (*p == 0x03 && (int8_t)p[3] < 0)) back_edges++;
+    }
+    XtensaHwLoop* loops = back_edges
+        ? (XtensaHwLoop*)heap_caps_malloc(back_edges * sizeof(XtensaHwLoop), MALLOC_CAP_8BIT) : NULL;
+    size_t count = 0;
+    for (const uint8_t* p = code; loops && p < end; p += (*p == 0x16) ? 4 : espb_instruction_length(p, end)) {
+        if (*p != 0x03) continue;
+        int32_t br_if = (int32_t)(p - code);
+        int16_t rel;
+        memcpy(&rel, p + 2, sizeof(rel));
+        int32_t target = br_if + rel;
+        if (target < 0 || target > (int32_t)code_size) continue;
+        if (rel < 0 && xtensa_hwloop_match(code, code_size, targets, (uint32_t)target, (uint32_t)br_if,
+                                           XTENSA_HWLOOP_NO_EXIT, &loops[count])) {
+            count++;
+            continue;
+        }
+        // BR_IF Rc, EXIT; BR H
+        if (end - p < 7 || p[4] != 0x02) continue;
+        memcpy(&rel, p + 5, sizeof(rel));
+        int32_t header = br_if + 4 + rel;
+        if (rel >= 0 || header < 0) continue;
+        if (xtensa_hwloop_match(code, code_size, targets, (uint32_t)header, (uint32_t)br_if, (uint32_t)target,
+                                &loops[count])) {
+            count++;
+        }
+    }
+    heap_caps_free(targets);
+    if (loops && count == 0) {
+        heap_caps_free(loops);
+        loops = NULL;
+    }
+    *out_count = count;
+    return loops;
+}
+
+// Trip count into a10, then LOOP a10 with LBEG 4-byte aligned (the first body instruction
+// must not straddle a fetch word). Returns the position of the LOOP for xtensa_emit_hwloop_end.
+static uint32_t xtensa_emit_hwloop_start(XtensaJitContext* ctx, XtensaLiteralPool* pool, const XtensaHwLoop* loop) {
+    if (loop->bound_imm) {
+        emit_load_imm32(ctx, pool, 9, loop->bound);    // a9 = n
+    } else {
+        emit_l32i(ctx, 9, 11, (uint16_t)(loop->rn * 8));
+    }
+    emit_l32i(ctx, 8, 11, (uint16_t)(loop->ri * 8));  // a8 = i
+    emit_sub(ctx, 10, 9, 8);                           // a10 = n - i
+    if (loop->cmp != 0xC1) {
+        // blt/bltu a8, a9: i < n keeps n - i, otherwise the body still runs once
+        uint32_t br_pos = emit_bcc_a8_a9_placeholder(ctx, loop->cmp == 0xC2 ? 0x2 : 0x3);
+        emit_movi_n(ctx, 10, 1);
+        emit_flush_words(ctx);
+        patch_bcc_a8_a9_at(ctx->buffer, br_pos, (int32_t)ctx->offset);
+    }
+    // LOOP at offset % 4 == 1 puts LBEG on a word boundary
+    uint32_t pad = (1u - (uint32_t)ctx->offset) & 3u;
+    if (pad == 1) {
+        emit_nop3(ctx);
+        emit_nop_n(ctx);
+    } else if (pad == 2) {
+        emit_nop_n(ctx);
+    } else if (pad == 3) {
+        emit_nop3(ctx);
+    }
+    // loop a10, LEND: bytes 76 8A imm8, LEND = PC + 4 + imm8 (patched at the back edge)
+    uint32_t loop_pos = (uint32_t)ctx->offset;
+    emit_u8(ctx, 0x76);
+    emit_u8(ctx, 0x8A);
+    emit_u8(ctx, 0x00);
+    return loop_pos;
+}
+
+// Closes the loop at the back edge. The hardware loops back only when execution falls
+// through to LEND (a taken branch landing there exits), so the body ends with a NOP
+// after the internal jumps of the compare. False if the body is beyond LOOP's 8-bit
+// reach: the LOOP becomes a NOP and the caller emits an ordinary back edge.
+static bool xtensa_emit_hwloop_end(XtensaJitContext* ctx, uint32_t loop_pos) {
+    emit_nop_n(ctx);
+    emit_flush_words(ctx);
+    if (ctx->error) return false;
+    int32_t imm = (int32_t)ctx->offset - (int32_t)(loop_pos + 4u);
+    if (imm < 0 || imm > 0xFF) {
+        store_u8_exec(ctx->buffer, loop_pos + 0, 0xF0);  // nop => bytes F0 20 00
+        store_u8_exec(ctx->buffer, loop_pos + 1, 0x20);
+        store_u8_exec(ctx->buffer, loop_pos + 2, 0x00);
+        return false;
+    }
+    store_u8_exec(ctx->buffer, loop_pos + 2, (uint8_t)imm);
+    return true;
+}
+#endif
+
+// ar = a6 + v_regs byte offset (a pointer to a V128 register pair for the SIMD kernels)
+static void emit_v128_reg_addr(XtensaJitContext* ctx, XtensaLiteralPool* pool, uint8_t ar, uint8_t vreg) {
+    uint32_t off = (uint32_t)vreg * 8u;
+    if (off <= 127) {
+        emit_addi(ctx, ar, 6, (int8_t)off);
+        return;
+    }
+    emit_load_imm32(ctx, pool, ar, off);
+    emit_add_n(ctx, ar, ar, 6);
+}
+
+// V128 (0xFD) sub_op with operands at a. Vectors live in register pairs of v_regs;
+// lane moves are inline, arithmetic goes through the espb_simd.c kernels.
+// Returns false for forms the JIT leaves to the interpreter.
+static bool emit_v128(XtensaJitContext* ctx, XtensaLiteralPool* pool, uint8_t sub_op, const uint8_t* a) {
+    switch (sub_op) {
+        case ESPB_V128_LOAD:
+        case ESPB_V128_STORE: { // V, Ra, offset16
+#if CONFIG_ESPB_SANDBOX_MASKED
+            // The sandbox guard area only covers accesses of up to 8 bytes
+            return false;
+#else
+            int16_t offset;
+            memcpy(&offset, a + 2, sizeof(offset));
+            if (a[0] > 254) return false;
+            emit_mov_n(ctx, 6, 11);
+            emit_v128_reg_addr(ctx, pool, 10, a[0]);
+            emit_l32i(ctx, 11, 6, (uint16_t)(a[1] * 8));
+            if (offset >= -128 && offset <= 127) {
+                if (offset != 0) emit_addi(ctx, 11, 11, (int8_t)offset);
+            } else {
+                emit_load_u32_to_a8(ctx, pool, (uint32_t)(int32_t)offset);
+                emit_add_n(ctx, 11, 11, 8);
+            }
+            emit_call_helper(ctx, pool, sub_op == ESPB_V128_LOAD ? (void*)&espb_v128_load : (void*)&espb_v128_store);
+            emit_mov_n(ctx, 11, 6);
+            return true;
+#endif
+        }
+        case ESPB_V128_CONST: { // Vd, imm[16]
+            if (a[0] > 254) return false;
+            for (int w = 0; w < 4; w++) {
+                uint32_t word;
+                memcpy(&word, a + 1 + 4 * w, sizeof(word));
+                emit_load_imm32(ctx, pool, 8, word);
+                emit_s32i(ctx, 8, 11, (uint16_t)(a[0] * 8 + 4 * w));
+            }
+            return true;
+        }
+        case ESPB_V128_I8X16_SPLAT:
+        case ESPB_V128_I16X8_SPLAT:
+        case ESPB_V128_I32X4_SPLAT: // Vd, Rs
+            if (a[0] > 254) return false;
+            emit_mov_n(ctx, 6, 11);
+            emit_v128_reg_addr(ctx, pool, 10, a[0]);
+            emit_l32i(ctx, 11, 6, (uint16_t)(a[1] * 8));
+            emit_call_helper(ctx, pool, (void*)espb_v128_splat_op(sub_op));
+            emit_mov_n(ctx, 11, 6);
+            return true;
+        case ESPB_V128_I16X8_EXTRACT_LANE_S: // Rd, Vs, lane
+            if (a[1] > 254 || a[2] >= 8) return false;
+            emit_l16si(ctx, 8, 11, (uint16_t)(a[1] * 8 + a[2] * 2));
+            emit_s32i(ctx, 8, 11, (uint16_t)(a[0] * 8));
+            return true;
+        case ESPB_V128_I32X4_EXTRACT_LANE: // Rd, Vs, lane
+            if (a[1] > 254 || a[2] >= 4) return false;
+            emit_l32i(ctx, 8, 11, (uint16_t)(a[1] * 8 + a[2] * 4));
+            emit_s32i(ctx, 8, 11, (uint16_t)(a[0] * 8));
+            return true;
+        case ESPB_V128_I32X4_REPLACE_LANE: { // Vd, Va, Rs, lane
+            // Va and Rs are fully loaded before the first store: Vd may overlap them.
+            // a7 stays free as the large-offset scratch of l32i/s32i.
+            static const uint8_t tmp[4] = { 8, 10, 12, 13 };
+            if (a[0] > 254 || a[1] > 254 || a[3] >= 4) return false;
+            emit_l32i(ctx, 9, 11, (uint16_t)(a[2] * 8));
+            for (int w = 0; w < 4; w++) emit_l32i(ctx, tmp[w], 11, (uint16_t)(a[1] * 8 + 4 * w));
+            for (int w = 0; w < 4; w++) {
+                emit_s32i(ctx, w == a[3] ? 9 : tmp[w], 11, (uint16_t)(a[0] * 8 + 4 * w));
+            }
+            return true;
+        }
+        case ESPB_V128_I8X16_SHUFFLE: { // Vd, Va, Vb, lanes[16]
+            uint32_t w[3];
+            if (a[0] > 254 || a[1] > 254 || a[2] > 254) return false;
+            for (int i = 0; i < 16; i++) {
+                if (a[3 + i] >= 32) return false;
+            }
+            espb_v128_shuffle_pack(a + 3, w);
+            emit_mov_n(ctx, 6, 11);
+            emit_v128_reg_addr(ctx, pool, 10, a[0]);
+            emit_v128_reg_addr(ctx, pool, 11, a[1]);
+            emit_v128_reg_addr(ctx, pool, 12, a[2]);
+            for (int i = 0; i < 3; i++) emit_load_imm32(ctx, pool, (uint8_t)(13 + i), w[i]);
+            emit_call_helper(ctx, pool, (void*)&espb_v128_shuffle_packed);
+            emit_mov_n(ctx, 11, 6);
+            return true;
+        }
+        default: { // Vd, Va[, Vb]
+            EspbV128Op fn = espb_v128_op(sub_op);
+            uint8_t vb = espb_v128_is_unary(sub_op) ? a[1] : a[2];
+            if (!fn || a[0] > 254 || a[1] > 254 || vb > 254) return false;
+            emit_mov_n(ctx, 6, 11);
+            emit_v128_reg_addr(ctx, pool, 10, a[0]);
+            emit_v128_reg_addr(ctx, pool, 11, a[1]);
+            emit_v128_reg_addr(ctx, pool, 12, vb);
+            emit_call_helper(ctx, pool, (void*)fn);
+            emit_mov_n(ctx, 11, 6);
+            return true;
+        }
+    }
+}
+
+#if CONFIG_ESPB_JIT_XTENSA_VCACHE
+// Opcodes whose v_regs stores are on every path through the emitted code
+// (internal branches only select values before the final stores).
+static bool xtensa_vc_op_allowed(uint8_t op) {
+    if (op >= 0x10 && op <= 0x13) return true;  // MOV
+    if (op >= 0x20 && op <= 0x2E) return true;  // I32 arith/bitwise/shifts
+    if (op >= 0x40 && op <= 0x4B) return true;  // I32 IMM8
+    if (op >= 0x70 && op <= 0x7B) return true;  // STORE.*
+    if (op >= 0x80 && op <= 0x89) return true;  // LOAD.*
+    if (op >= 0xC0 && op <= 0xC9) return true;  // CMP.*.I32
+    return op == 0x03 || op == 0x18 || op == 0x19 || op == 0x1C;
+}
+#endif
+
+#if CONFIG_ESPB_JIT_DIRECT_IMPORTS
+// ===== Прямой вызов импорта по известной сигнатуре =====
+// Аргументы из v_regs кладутся прямо в окно call8 (caller a10..a15 = callee a2..a7),
+// затем callx8 на resolved_import_funcs[idx]. Xtensa ABI: 64-битные значения в чётной
+// паре (a10/a12/a14), float/double — в a-регистрах (soft-float соглашение ESP32/S3).
+// Больше 6 слов аргументов или узкий тип результата — generic espb_jit_call_import.
+static uint8_t xtensa_import_abi_words(EspbValueType t) {
+    switch (t) {
+        case ESPB_TYPE_I8: case ESPB_TYPE_U8: case ESPB_TYPE_I16: case ESPB_TYPE_U16:
+        case ESPB_TYPE_I32: case ESPB_TYPE_U32: case ESPB_TYPE_BOOL: case ESPB_TYPE_PTR:
+        case ESPB_TYPE_F32:
+            return 1;
+        case ESPB_TYPE_I64: case ESPB_TYPE_U64: case ESPB_TYPE_F64:
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+static bool xtensa_emit_direct_import_call(XtensaJitContext* ctx, const EspbInstance* instance,
+                                           uint16_t import_idx) {
+    const EspbFuncSignature* sig = NULL;
+    if (!espb_jit_import_can_call_direct(instance, import_idx, &sig, NULL)) return false;
+    if ((uint32_t)import_idx * 4u > 0xFFFFu) return false;
+    if (sig->num_returns > 1) return false;
+
+    EspbValueType ret_t = sig->num_returns ? sig->return_types[0] : ESPB_TYPE_VOID;
+    if (ret_t != ESPB_TYPE_VOID) {
+        // Расширение узкого результата до 32 бит на стороне callee не гарантировано
+        if (ret_t == ESPB_TYPE_I8 || ret_t == ESPB_TYPE_U8 ||
+            ret_t == ESPB_TYPE_I16 || ret_t == ESPB_TYPE_U16) return false;
+        if (xtensa_import_abi_words(ret_t) == 0) return false;
+    }
+
+    // Раскладка: arg_reg[i] — первый регистр аргумента i (a10..a15)
+    uint8_t arg_reg[6];
+    uint8_t slot = 0;
+    if (sig->num_params > 6) return false;
+    for (uint8_t i = 0; i < sig->num_params; i++) {
+        uint8_t w = xtensa_import_abi_words(sig->param_types[i]);
+        if (w == 0) return false;
+        if (w == 2) slot = (uint8_t)((slot + 1) & ~1u);
+        if (slot + w > 6) return false;
+        arg_reg[i] = (uint8_t)(10 + slot);
+        slot += w;
+    }
+
+    // a8 = instance->resolved_import_funcs[import_idx]: без литерала на каждый импорт
+    emit_l32i(ctx, 8, 1, 4);
+    emit_l32i(ctx, 8, 8, (uint16_t)offsetof(EspbInstance, resolved_import_funcs));
+    emit_l32i(ctx, 8, 8, (uint16_t)(import_idx * 4));
+
+    // a11 = v_regs — грузим его слово последним
+    for (int pass = 0; pass < 2; pass++) {
+        for (uint8_t i = 0; i < sig->num_params; i++) {
+            EspbValueType t = sig->param_types[i];
+            uint8_t r = arg_reg[i];
+            uint8_t w = xtensa_import_abi_words(t);
+            for (uint8_t k = 0; k < w; k++) {
+                if (((r + k) == 11) != (pass == 1)) continue;
+                emit_l32i(ctx, (uint8_t)(r + k), 11, (uint16_t)(i * 8 + k * 4));
+            }
+        }
+    }
+    // Узкие целые расширяет вызывающая сторона
+    for (uint8_t i = 0; i < sig->num_params; i++) {
+        uint8_t r = arg_reg[i];
+        switch (sig->param_types[i]) {
+            case ESPB_TYPE_I8:  emit_sext_i8(ctx, r, r); break;
+            case ESPB_TYPE_U8:  emit_extui(ctx, r, r, 0, 8); break;
+            case ESPB_TYPE_I16: emit_slli(ctx, r, r, 16); emit_srai(ctx, r, r, 16); break;
+            case ESPB_TYPE_U16: emit_extui(ctx, r, r, 0, 16); break;
+            default: break;
+        }
+    }
+
+    emit_callx8_a8(ctx);
+
+    // Результат (a10[:a11]) в v_regs[0]; a11 после call8 не сохраняется — берём из кадра
+    if (ret_t != ESPB_TYPE_VOID) {
+        emit_l32i(ctx, 8, 1, 8);
+        emit_s32i(ctx, 10, 8, 0);
+        if (xtensa_import_abi_words(ret_t) == 2) emit_s32i(ctx, 11, 8, 4);
+    }
+    emit_l32i(ctx, 11, 1, 8);  // a11 = v_regs
+    return true;
+}
+#endif
+
 // ===== Debug helpers (opcode profiler) =====
 #if ESPB_JIT_DUMP_USED_OPCODES
 static uint32_t espb_jit_xtensa_debug_op_len(uint8_t o, const uint8_t* p, const uint8_t* e) {
@@ -2978,13 +3675,104 @@ static uint32_t espb_jit_xtensa_debug_op_len(uint8_t o, const uint8_t* p, const
 #endif
 
 // ===== Main compile function =====
+// Helper addresses referenced by almost every function. They form the literal island at the
+// start of each arena chunk; without the arena they pre-seed the per-function pool instead.
+#define XTENSA_ISLAND_MAX 16
+
+static uint32_t xtensa_fill_island(uint32_t* out) {
+    uint32_t n = 0;
+    out[n++] = (uint32_t)(uintptr_t)&espb_jit_call_import;
+    out[n++] = (uint32_t)(uintptr_t)&espb_jit_ld_global_addr;
+    out[n++] = (uint32_t)(uintptr_t)&espb_jit_ld_global;
+    out[n++] = (uint32_t)(uintptr_t)&espb_runtime_alloca;
+    out[n++] = (uint32_t)(uintptr_t)&espb_jit_xtensa_store_i16;
+    out[n++] = (uint32_t)(uintptr_t)&espb_jit_xtensa_store_i8;
+    out[n++] = (uint32_t)(uintptr_t)&espb_jit_xtensa_store_bool;
+    out[n++] = (uint32_t)(uintptr_t)&espb_jit_xtensa_load_i8_s;
+    out[n++] = (uint32_t)(uintptr_t)&espb_jit_xtensa_load_i8_u;
+    out[n++] = (uint32_t)(uintptr_t)&espb_jit_xtensa_load_i16_s;
+    out[n++] = (uint32_t)(uintptr_t)&espb_jit_xtensa_load_i16_u;
+    out[n++] = (uint32_t)(uintptr_t)&espb_jit_xtensa_load_bool;
+    out[n++] = (uint32_t)(uintptr_t)&espb_jit_xtensa_sext_i8_i32;
+    return n;
+}
+
+// Prologue: Windowed ABI. Shared by the function entry and the OSR entry stub,
+// so both build the same frame and leave through the same retw.
+static void xtensa_emit_prologue(XtensaJitContext* ctx) {
+    emit_entry(ctx, 1, 64);
+
+    // Save incoming args (caller passes in a2/a3 under windowed ABI)
+    // After CALL8 + entry, caller's outgoing a10/a11 appear as our a2/a3.
+    // a2 = instance, a3 = v_regs
+    // Windowed ABI uses a1+0 for outgoing stack args (7th+).
+    // Reserve a1+0 for outgoing args; save locals at a1+4 and a1+8.
+    emit_mov_n(ctx, 8, 2);      // a8 = instance
+    emit_s32i(ctx, 8, 1, 4);    // [a1+4] = instance
+    emit_mov_n(ctx, 8, 3);      // a8 = v_regs
+    emit_s32i(ctx, 8, 1, 8);    // [a1+8] = v_regs
+
+    // CRITICAL: the rest of the JIT assumes a11 == v_regs base for vreg load/store.
+    // If we don't initialize it, vreg stores may go to a garbage address and crash (PIF addr error).
+    emit_mov_n(ctx, 11, 3);     // a11 = v_regs
+
+    // Preserve callee-saved registers expected by the C caller (windowed ABI).
+    // Our JIT freely uses a12-a15 (and may alias a14 via window rotation), so restore them before retw.
+    // IMPORTANT: a1+16.. is used by CALL_IMPORT to build variadic arg types.
+    // Keep our callee-saved spill above that region.
+    emit_s32i(ctx, 12, 1, 32);  // save a12
+    emit_s32i(ctx, 13, 1, 36);  // save a13
+    emit_s32i(ctx, 14, 1, 40);  // save a14
+    emit_s32i(ctx, 15, 1, 44);  // save a15
+}
+
+#if CONFIG_ESPB_JIT_OSR
+// OSR entry stub: void stub(EspbInstance*, Value* v_regs, void* target).
+// Builds the regular frame and jumps to a loop header. All vregs are in v_regs[] there:
+// headers are backward-branch targets, where the vreg cache is already invalidated.
+static EspbJitOsrInfo* xtensa_emit_osr_stub(XtensaJitContext* ctx, const uint8_t* code, size_t code_size,
+                                            const uint32_t* bc_to_native) {
+    size_t num_headers = 0;
+    uint32_t* headers = espb_jit_osr_scan_headers(code, code_size, &num_headers);
+    if (!headers) return NULL;
+
+    EspbJitOsrPoint* points = (EspbJitOsrPoint*)heap_caps_malloc(num_headers * sizeof(EspbJitOsrPoint), MALLOC_CAP_8BIT);
+    size_t num_points = 0;
+    for (size_t i = 0; points && i < num_headers; i++) {
+        if (bc_to_native[headers[i]] == 0xFFFFFFFFu) continue;
+        points[num_points].bc_offset = headers[i];
+        points[num_points].native_offset = bc_to_native[headers[i]];
+        num_points++;
+    }
+    free(headers);
+
+    EspbJitOsrInfo* osr = NULL;
+    // Alignment + prologue + mov.n + jx stay well below 48 bytes
+    if (num_points > 0 && ctx->offset + 48 <= ctx->capacity) {
+        emit_align4_with_nops(ctx);
+        uint32_t stub_offset = (uint32_t)ctx->offset;
+        xtensa_emit_prologue(ctx);
+        emit_mov_n(ctx, 8, 4);  // a8 = target
+        emit_jx_a8(ctx);
+        emit_flush_words(ctx);
+        if (!ctx->error) osr = espb_jit_osr_info_create(stub_offset, points, num_points);
+    }
+    heap_caps_free(points);
+    return osr;
+}
+#endif
+
 EspbResult espb_jit_compile_function_xtensa_inline(
     EspbInstance* instance,
     uint32_t func_idx,
     const EspbFunctionBody* body,
     void** out_code,
-    size_t* out_size
+    size_t* out_size,
+    EspbJitOsrInfo** out_osr,
+    EspbJitPcMap** out_pc_map
 ) {
+    if (out_osr) *out_osr = NULL;
+    if (out_pc_map) *out_pc_map = NULL;
     if (!instance || !body || !out_code || !out_size) {
         ESP_LOGE(TAG, "Invalid parameters");
         return ESPB_ERR_INVALID_OPERAND;
@@ -3099,12 +3887,35 @@ EspbResult espb_jit_compile_function_xtensa_inline(
     // Empirically, Xtensa native code is usually within ~10-20x of bytecode size,
     // plus literal pools and fixup tables.
     size_t max_size = (size_t)code_size * 24u + 4096u;
+#if CONFIG_ESPB_FUEL
+    // Fuel checks: one per loop header and one in the prologue
+    size_t fuel_num_headers = 0;
+    uint32_t* fuel_headers = espb_jit_osr_scan_headers(code, code_size, &fuel_num_headers);
+    size_t fuel_next = 0;
+    max_size += (fuel_num_headers + 1) * XTENSA_FUEL_CHECK_MAX_BYTES;
+#endif
     if (max_size < 4096u) max_size = 4096u;
     if (max_size > (64u * 1024u)) max_size = (64u * 1024u);
+    // Native code budget and what is left of the instance IRAM quota (espb_jit_budget.h)
+    size_t native_limit = espb_jit_native_limit(instance, NULL);
+    if (max_size > native_limit) max_size = native_limit;
+    if (max_size < 16u) {
+#if CONFIG_ESPB_FUEL
+        free(fuel_headers);
+#endif
+        return ESPB_ERR_JIT_CODE_TOO_LARGE;
+    }
 
-    uint8_t* buffer = (uint8_t*)espb_exec_alloc(max_size);
+    uint32_t island[XTENSA_ISLAND_MAX];
+    uint32_t island_count = xtensa_fill_island(island);
+    EspbJitArenaReservation code_res;
+    uint8_t* buffer = espb_jit_code_reserve(instance, max_size, island, island_count, &code_res)
+        ? (uint8_t*)code_res.code : NULL;
     if (!buffer) {
         ESP_LOGE(TAG, "Failed to allocate JIT buffer");
+#if CONFIG_ESPB_FUEL
+        free(fuel_headers);
+#endif
         return ESPB_ERR_OUT_OF_MEMORY;
     }
     
@@ -3118,62 +3929,45 @@ EspbResult espb_jit_compile_function_xtensa_inline(
         .capacity = max_size,
         .offset = 0,
         .error = false,
+        .overflow = false,
         .word_buf = 0,
         .word_fill = 0,
         .bc_to_native = NULL,  // Will be set later after bc_to_native allocation
         .current_bc_off = 0,
         .code_size = code_size
     };
+#if CONFIG_ESPB_SANDBOX_MASKED
+    ctx.sb_mask = instance->memory_mask;  // the mask is per module, the base per instance
+#endif
 
-    XtensaLiteralPool litpool = {0};
-
-    // Prologue: Windowed ABI
-    emit_entry(&ctx, 1, 64);
-
-    // Pre-seed literal pool with common helper addresses to avoid frequent flushes
-    // (dedup will keep them unique). This typically reduces pool flushes to 1 per function.
-    lit_add(&litpool, (uint32_t)(uintptr_t)&espb_jit_call_import);
-    lit_add(&litpool, (uint32_t)(uintptr_t)&espb_jit_ld_global_addr);
-    lit_add(&litpool, (uint32_t)(uintptr_t)&espb_jit_ld_global);
-    lit_add(&litpool, (uint32_t)(uintptr_t)&espb_runtime_alloca);
-    lit_add(&litpool, (uint32_t)(uintptr_t)&espb_jit_xtensa_store_i64);
-    lit_add(&litpool, (uint32_t)(uintptr_t)&espb_jit_xtensa_store_i32);
-    lit_add(&litpool, (uint32_t)(uintptr_t)&espb_jit_xtensa_store_i16);
-    lit_add(&litpool, (uint32_t)(uintptr_t)&espb_jit_xtensa_store_i8);
-    lit_add(&litpool, (uint32_t)(uintptr_t)&espb_jit_xtensa_store_bool);
-    lit_add(&litpool, (uint32_t)(uintptr_t)&espb_jit_xtensa_load_i8_s);
-    lit_add(&litpool, (uint32_t)(uintptr_t)&espb_jit_xtensa_load_i8_u);
-    lit_add(&litpool, (uint32_t)(uintptr_t)&espb_jit_xtensa_load_i16_s);
-    lit_add(&litpool, (uint32_t)(uintptr_t)&espb_jit_xtensa_load_i16_u);
-    lit_add(&litpool, (uint32_t)(uintptr_t)&espb_jit_xtensa_load_bool);
-    lit_add(&litpool, (uint32_t)(uintptr_t)&espb_jit_xtensa_sext_i8_i32);
+    xtensa_vc_invalidate(&ctx);
 
-    // Save incoming args (caller passes in a2/a3 under windowed ABI)
-    // After CALL8 + entry, caller's outgoing a10/a11 appear as our a2/a3.
-    // a2 = instance, a3 = v_regs
-    // Windowed ABI uses a1+0 for outgoing stack args (7th+).
-    // Reserve a1+0 for outgoing args; save locals at a1+4 and a1+8.
-    emit_mov_n(&ctx, 8, 2);      // a8 = instance
-    emit_s32i(&ctx, 8, 1, 4);    // [a1+4] = instance
-    emit_mov_n(&ctx, 8, 3);      // a8 = v_regs
-    emit_s32i(&ctx, 8, 1, 8);    // [a1+8] = v_regs
+    XtensaLiteralPool litpool = {0};
 
-    // CRITICAL: the rest of the JIT assumes a11 == v_regs base for vreg load/store.
-    // If we don't initialize it, vreg stores may go to a garbage address and crash (PIF addr error).
-    emit_mov_n(&ctx, 11, 3);     // a11 = v_regs
+    if (code_res.island) {
+        litpool.island_vals = island;
+        litpool.island_abs = (uintptr_t)code_res.island;
+        litpool.island_count = code_res.island_count;
+    } else {
+        // Pre-seed literal pool with common helper addresses to avoid frequent flushes
+        // (dedup will keep them unique). This typically reduces pool flushes to 1 per function.
+        for (uint32_t i = 0; i < island_count; i++) lit_add(&litpool, island[i]);
+    }
 
-    // Preserve callee-saved registers expected by the C caller (windowed ABI).
-    // Our JIT freely uses a12-a15 (and may alias a14 via window rotation), so restore them before retw.
-    // IMPORTANT: a1+16.. is used by CALL_IMPORT to build variadic arg types.
-    // Keep our callee-saved spill above that region.
-    emit_s32i(&ctx, 12, 1, 32);  // save a12
-    emit_s32i(&ctx, 13, 1, 36);  // save a13
-    emit_s32i(&ctx, 14, 1, 40);  // save a14
-    emit_s32i(&ctx, 15, 1, 44);  // save a15
+    xtensa_emit_prologue(&ctx);
 
     // Emit initial pool now (jump+pool) so subsequent helper calls can use backward l32r without extra flushes.
+    // With the chunk island the pool is empty here and this emits nothing.
     flush_literal_pool(&ctx, &litpool);
 
+    // Self tail calls jump back here: same frame, a11 = v_regs, fuel is charged again
+    uint32_t tail_entry = (uint32_t)ctx.offset;
+
+#if CONFIG_ESPB_FUEL
+    // A call costs fuel only in non-leaf functions: a leaf without loops finishes on its own
+    if (!(header->flags & ESPB_FUNC_FLAG_IS_LEAF)) xtensa_emit_fuel_check(&ctx, &litpool);
+#endif
+
     (void)num_vregs;  // Will use later for bounds checks
 
     // Compile bytecode
@@ -3186,7 +3980,10 @@ EspbResult espb_jit_compile_function_xtensa_inline(
     #define XTENSA_BC_UNSET 0xFFFFFFFFu
     uint32_t* bc_to_native = (uint32_t*)heap_caps_malloc((code_size + 1) * sizeof(uint32_t), MALLOC_CAP_8BIT);
     if (!bc_to_native) {
-        heap_caps_free(buffer);
+        espb_jit_code_abort(instance, buffer);
+#if CONFIG_ESPB_FUEL
+        free(fuel_headers);
+#endif
         return ESPB_ERR_OUT_OF_MEMORY;
     }
     for (size_t i = 0; i <= code_size; i++) bc_to_native[i] = XTENSA_BC_UNSET;
@@ -3201,14 +3998,37 @@ EspbResult espb_jit_compile_function_xtensa_inline(
     uint32_t fixup_count = 0;
     if (!fixups) {
         heap_caps_free(bc_to_native);
-        heap_caps_free(buffer);
+        espb_jit_code_abort(instance, buffer);
+#if CONFIG_ESPB_FUEL
+        free(fuel_headers);
+#endif
         return ESPB_ERR_OUT_OF_MEMORY;
     }
 
     uint8_t last_op = 0x00;
     size_t last_off = 0;
 
-    while (pc < end && !ctx.error) {
+#if CONFIG_ESPB_JIT_XTENSA_VCACHE
+    uint8_t* vc_targets = xtensa_vc_scan_targets(code, code_size);
+#endif
+#if XTENSA_HW_LOOPS
+    size_t hwl_count = 0;
+    size_t hwl_next = 0;
+    XtensaHwLoop* hwloops = xtensa_hwloop_scan(code, code_size, &hwl_count);
+    const XtensaHwLoop* hwl_open = NULL;  // Loop whose LOOP is emitted and LEND is not yet known
+    uint32_t hwl_loop_pos = 0;
+    uint32_t hwl_lbeg = 0;
+#endif
+
+    int64_t deadline = espb_jit_deadline_start();
+    uint32_t insn_count = 0;
+    bool timed_out = false;
+    while (pc < end && !ctx.error) {
+        if (espb_jit_deadline_passed(deadline, ++insn_count)) {
+            timed_out = true;
+            ctx.error = true;
+            break;
+        }
         last_op = *pc;
         last_off = (size_t)(pc - start);
         uint8_t op = *pc++;
@@ -3228,6 +4048,34 @@ EspbResult espb_jit_compile_function_xtensa_inline(
 
         // (runtime trace disabled)
 
+#if CONFIG_ESPB_JIT_XTENSA_VCACHE
+        if (vc_targets) {
+            bool is_target = (vc_targets[last_off >> 3] & (1u << (last_off & 7))) != 0;
+            ctx.vc_active = xtensa_vc_op_allowed(op);
+            ctx.vc_linear_mem = (op >= 0x70 && op <= 0x7B);
+            if (is_target || !ctx.vc_active) xtensa_vc_invalidate(&ctx);
+        }
+#endif
+
+#if CONFIG_ESPB_FUEL
+        // Loop headers are backward-branch targets: every vreg is in v_regs[] here (as for OSR)
+        while (fuel_next < fuel_num_headers && fuel_headers[fuel_next] < last_off) fuel_next++;
+        if (fuel_next < fuel_num_headers && fuel_headers[fuel_next] == last_off) {
+            xtensa_emit_fuel_check(&ctx, &litpool);
+        }
+#endif
+
+#if XTENSA_HW_LOOPS
+        // bc_to_native[H] stays on the trip-count setup: OSR entries and forward branches to H
+        // recompute the remaining count from the current Ri
+        while (hwl_next < hwl_count && hwloops[hwl_next].header < last_off) hwl_next++;
+        if (!hwl_open && hwl_next < hwl_count && hwloops[hwl_next].header == last_off) {
+            hwl_open = &hwloops[hwl_next];
+            hwl_loop_pos = xtensa_emit_hwloop_start(&ctx, &litpool, hwl_open);
+            hwl_lbeg = (uint32_t)ctx.offset;
+        }
+#endif
+
         switch (op) {
             case 0x00: // NOP
             case 0x01: // NOP
@@ -3258,6 +4106,7 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                         emit_add_n(&ctx, 8, 8, 10);
                     }
                 }
+                XTENSA_SANDBOX_ADDR(&ctx, &litpool, 8);
 
                 // Load 32-bit pointer value
                 // Check alignment for optimal code path
@@ -3417,6 +4266,29 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                 // DEBUG: trace branch targets (helps verify loop back-edges)
 
                 if (pc + 3 > end) { ctx.error = true; break; }
+#if XTENSA_HW_LOOPS
+                if (hwl_open && last_off == hwl_open->br_if) {
+                    const XtensaHwLoop* loop = hwl_open;
+                    hwl_open = NULL;
+                    if (!xtensa_emit_hwloop_end(&ctx, hwl_loop_pos)) {
+                        // Too long for LOOP: the back edge skips the (now useless) setup
+                        bc_to_native[loop->header] = hwl_lbeg;
+                    } else if (loop->exit == XTENSA_HWLOOP_NO_EXIT) {
+                        pc += 3;
+                        break;
+                    } else {
+                        // BR_IF Rc, EXIT; BR H after the last pass: j EXIT
+                        if (bc_to_native[loop->exit] != XTENSA_BC_UNSET) {
+                            emit_jump_to_target(&ctx, &litpool, bc_to_native[loop->exit], true);
+                        } else {
+                            uint32_t j_pos = emit_j_placeholder(&ctx);
+                            fixups[fixup_count++] = (XtensaBranchFixup){ .j_pos_native = j_pos, .target_bc_off = loop->exit };
+                        }
+                        pc += 3 + 3;
+                        break;
+                    }
+                }
+#endif
                 uint8_t cond_reg = *pc++;
                 int16_t off16;
                 memcpy(&off16, pc, sizeof(off16));
@@ -3578,6 +4450,55 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                         uint32_t j_pos = emit_j_placeholder(&ctx);
                         fixups[fixup_count++] = (XtensaBranchFixup){ .j_pos_native = j_pos, .target_bc_off = default_target };
                     }
+                } else if (num_targets > XTENSA_BR_TABLE_CHAIN_MAX) {
+                    // Jump table: bounds check, then an indexed jump into a table of 3-byte 'j'.
+                    // The table address is taken PC-relative through call0 (a0 is parked in a9),
+                    // so the code stays position-independent across the shrink realloc.
+                    //       mov.n a8, a10 ; bltu a8, a9, 1f ; j <default>
+                    //   1:  mov.n a9, a0 ; [nops] ; call0 2f
+                    //   2:  addx2 a8, a10, a10 ; add.n a8, a8, a0 ; mov.n a0, a9
+                    //       addi a8, a8, table - 2b ; jx a8
+                    //   table: j <target[0]> ; j <target[1]> ; ...
+                    emit_load_imm32(&ctx, &litpool, 9, (uint32_t)num_targets);
+                    emit_mov_n(&ctx, 8, 10);
+                    uint32_t bltu_pos = emit_bcc_a8_a9_placeholder(&ctx, 0x3);
+
+                    int32_t default_target_signed = (int32_t)source_bc + (int32_t)default_off;
+                    uint32_t default_target = (uint32_t)default_target_signed;
+                    if (bc_to_native[default_target] != XTENSA_BC_UNSET) {
+                        uint32_t target_native = bc_to_native[default_target];
+                        emit_jump_to_target(&ctx, &litpool, target_native, target_native < (uint32_t)ctx.offset);
+                    } else {
+                        uint32_t j_pos = emit_j_placeholder(&ctx);
+                        fixups[fixup_count++] = (XtensaBranchFixup){ .j_pos_native = j_pos, .target_bc_off = default_target };
+                    }
+                    patch_bcc_a8_a9_at(ctx.buffer, bltu_pos, (int32_t)ctx.offset);
+
+                    emit_mov_n(&ctx, 9, 0);
+                    while ((ctx.offset & 3u) != 1u) {
+                        if ((ctx.offset & 3u) == 3u) emit_nop_n(&ctx); else emit_nop3(&ctx);
+                    }
+                    emit_call0_next(&ctx);
+                    uint32_t base_pos = (uint32_t)ctx.offset; // == a0
+                    emit_addx2(&ctx, 8, 10, 10);    // a8 = index * 3
+                    emit_add_n(&ctx, 8, 8, 0);
+                    emit_mov_n(&ctx, 0, 9);
+                    // table follows addi (3 bytes) and jx (3 bytes)
+                    emit_addi(&ctx, 8, 8, (int8_t)((uint32_t)ctx.offset + 6u - base_pos));
+                    emit_jx_a8(&ctx);
+
+                    for (uint16_t i = 0; i < num_targets; i++) {
+                        int16_t tgt_off;
+                        memcpy(&tgt_off, targets_ptr + i * 2, 2);
+                        uint32_t target_bc_off = (uint32_t)((int32_t)source_bc + (int32_t)tgt_off);
+                        if (bc_to_native[target_bc_off] != XTENSA_BC_UNSET) {
+                            uint32_t target_native = bc_to_native[target_bc_off];
+                            emit_jump_to_target(&ctx, &litpool, target_native, target_native < (uint32_t)ctx.offset);
+                        } else {
+                            uint32_t j_pos = emit_j_placeholder(&ctx);
+                            fixups[fixup_count++] = (XtensaBranchFixup){ .j_pos_native = j_pos, .target_bc_off = target_bc_off };
+                        }
+                    }
                 } else {
                     // Generate comparison chain for each case
                     // For each case i:
@@ -3760,9 +4681,11 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                 emit_l32i(&ctx, 8, 11, rs_off);
                 emit_s32i(&ctx, 8, 11, rd_off);
 
-                // high 32
-                emit_l32i(&ctx, 8, 11, (uint16_t)(rs_off + 4));
-                emit_s32i(&ctx, 8, 11, (uint16_t)(rd_off + 4));
+                // high 32 (never read in a body without 64-bit values)
+                if (!body->regs32) {
+                    emit_l32i(&ctx, 8, 11, (uint16_t)(rs_off + 4));
+                    emit_s32i(&ctx, 8, 11, (uint16_t)(rd_off + 4));
+                }
                 break;
             }
 
@@ -5718,74 +6641,7 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                 break;
             }
 
-            case 0x74: { // STORE.I32 Rs(u8), Ra(u8), offset(i16)
-                if (pc + 4 > end) { ctx.error = true; break; }
-                uint8_t rs = *pc++;
-                uint8_t ra = *pc++;
-                int16_t off16;
-                memcpy(&off16, pc, sizeof(off16));
-                pc += sizeof(off16);
-
-                // Fast inline path for aligned 32-bit store.
-                // NOTE: interpreter uses memcpy (supports unaligned). Xtensa s32i requires word alignment.
-                // Keep helper fallback for unaligned offsets.
-                if ((off16 & 3) == 0) {
-                    // a6 = v_regs (save for restore)
-                    emit_mov_n(&ctx, 6, 11);
-
-                    // a8 = base pointer (low32) from v_regs[ra]
-                    emit_l32i(&ctx, 8, 6, (uint16_t)(ra * 8));
-
-                    // a8 += off16
-                    if (off16 != 0) {
-                        if (off16 >= -128 && off16 <= 127) {
-                            emit_addi(&ctx, 8, 8, (int8_t)off16);
-                        } else {
-                            // FIX: save base address before loading offset
-                            emit_mov_n(&ctx, 7, 8);  // a7 = base address
-                            emit_load_u32_to_a8(&ctx, &litpool, (uint32_t)(int32_t)off16);
-                            emit_add_n(&ctx, 8, 7, 8);  // a8 = base + offset
-                        }
-                    }
-
-                    // value = v_regs[rs].lo
-                    emit_l32i(&ctx, 9, 6, (uint16_t)(rs * 8));
-
-                    // *(uint32_t*)a8 = value
-                    emit_s32i(&ctx, 9, 8, 0);
-
-                    // restore v_regs pointer
-                    emit_mov_n(&ctx, 11, 6);
-                    break;
-                }
-
-                // Fallback: unaligned offset -> helper (memcpy semantics)
-                // Call helper: espb_jit_xtensa_store_i32(v_regs, rs, ra, offset)
-                // Windowed ABI mapping: callee a2..a7 <= caller a10..a15
-                // a10 = v_regs
-                emit_l32i(&ctx, 8, 1, 8);
-                emit_mov_n(&ctx, 10, 8);
-
-                // a11 = rs
-                if (rs <= 15) emit_movi_n(&ctx, 11, (int8_t)rs);
-                else { emit_load_u32_to_a8(&ctx, &litpool, rs); emit_mov_n(&ctx, 11, 8); }
-
-                // a12 = ra
-                if (ra <= 15) emit_movi_n(&ctx, 12, (int8_t)ra);
-                else { emit_load_u32_to_a8(&ctx, &litpool, ra); emit_mov_n(&ctx, 12, 8); }
-
-                // a13 = offset (sign-extended i16)
-                emit_load_u32_to_a8(&ctx, &litpool, (uint32_t)(int32_t)off16);
-                emit_mov_n(&ctx, 13, 8);
-
-                emit_call_helper(&ctx, &litpool, (void*)&espb_jit_xtensa_store_i32);
-
-                // Restore a11 back to v_regs pointer (ABI for rest of JIT assumes a11=v_regs)
-                emit_l32i(&ctx, 8, 1, 8);
-                emit_mov_n(&ctx, 11, 8);
-                break;
-            }
-
+            case 0x74:   // STORE.I32 Rs(u8), Ra(u8), offset(i16)
             case 0x78: { // STORE.F32 Rs(u8), Ra(u8), offset(i16) (store raw f32 bits)
                 if (pc + 4 > end) { ctx.error = true; break; }
                 uint8_t rs = *pc++;
@@ -5794,113 +6650,13 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                 memcpy(&off16, pc, sizeof(off16));
                 pc += sizeof(off16);
 
-                // Same implementation strategy as STORE.I32:
-                // - aligned => inline s32i
-                // - unaligned => helper memcpy semantics
-                if ((off16 & 3) == 0) {
-                    emit_mov_n(&ctx, 6, 11); // a6 = v_regs (save for restore)
-
-                    // a8 = base pointer from v_regs[ra]
-                    emit_l32i(&ctx, 8, 6, (uint16_t)(ra * 8));
-
-                    // a8 += off16
-                    if (off16 != 0) {
-                        if (off16 >= -128 && off16 <= 127) {
-                            emit_addi(&ctx, 8, 8, (int8_t)off16);
-                        } else {
-                            // FIX: save base address before loading offset
-                            emit_mov_n(&ctx, 7, 8);  // a7 = base address
-                            emit_load_u32_to_a8(&ctx, &litpool, (uint32_t)(int32_t)off16);
-                            emit_add_n(&ctx, 8, 7, 8);  // a8 = base + offset
-                        }
-                    }
-
-                    // f32 is stored in low 32 bits of v_regs[rs]
-                    emit_l32i(&ctx, 9, 6, (uint16_t)(rs * 8));
-                    emit_s32i(&ctx, 9, 8, 0);
-
-                    emit_mov_n(&ctx, 11, 6);
-                    break;
-                }
+                // Aligned offset => s32i, unaligned => byte-wise s8i (memcpy semantics).
+                bool aligned = (off16 & 3) == 0;
+                xtensa_emit_mem_addr(&ctx, &litpool, ra, off16);
+                emit_l32i(&ctx, 9, 6, (uint16_t)(rs * 8));  // a9 = v_regs[rs].lo
+                xtensa_emit_mem_store_u32(&ctx, 9, 0, aligned);
 
-                // Unaligned -> same helper as STORE.I32
-                emit_l32i(&ctx, 8, 1, 8);
-                emit_mov_n(&ctx, 10, 8);
-
-                if (rs <= 15) emit_movi_n(&ctx, 11, (int8_t)rs);
-                else { emit_load_u32_to_a8(&ctx, &litpool, rs); emit_mov_n(&ctx, 11, 8); }
-
-                if (ra <= 15) emit_movi_n(&ctx, 12, (int8_t)ra);
-                else { emit_load_u32_to_a8(&ctx, &litpool, ra); emit_mov_n(&ctx, 12, 8); }
-
-                emit_load_u32_to_a8(&ctx, &litpool, (uint32_t)(int32_t)off16);
-                emit_mov_n(&ctx, 13, 8);
-
-                emit_call_helper(&ctx, &litpool, (void*)&espb_jit_xtensa_store_i32);
-
-                emit_l32i(&ctx, 8, 1, 8);
-                emit_mov_n(&ctx, 11, 8);
-                break;
-            }
-
-            case 0x79: { // STORE.F64 Rs(u8), Ra(u8), offset(i16) (store raw f64 bits)
-                if (pc + 4 > end) { ctx.error = true; break; }
-                uint8_t rs = *pc++;
-                uint8_t ra = *pc++;
-                int16_t off16;
-                memcpy(&off16, pc, sizeof(off16));
-                pc += sizeof(off16);
-
-                // Same strategy as STORE.I64:
-                // - aligned => inline two s32i
-                // - unaligned => helper memcpy semantics (reuse store_i64)
-                if ((off16 & 3) == 0) {
-                    emit_mov_n(&ctx, 6, 11); // a6 = v_regs (save for restore)
-
-                    // a8 = base pointer
-                    emit_l32i(&ctx, 8, 6, (uint16_t)(ra * 8));
-
-                    // a8 += off16
-                    if (off16 != 0) {
-                        if (off16 >= -128 && off16 <= 127) {
-                            emit_addi(&ctx, 8, 8, (int8_t)off16);
-                        } else {
-                            // FIX: save base address before loading offset
-                            emit_mov_n(&ctx, 7, 8);  // a7 = base address
-                            emit_load_u32_to_a8(&ctx, &litpool, (uint32_t)(int32_t)off16);
-                            emit_add_n(&ctx, 8, 7, 8);  // a8 = base + offset
-                        }
-                    }
-
-                    // load raw f64 bits (lo/hi)
-                    emit_l32i(&ctx, 9, 6, (uint16_t)(rs * 8));
-                    emit_l32i(&ctx, 10, 6, (uint16_t)(rs * 8 + 4));
-
-                    // store two words
-                    emit_s32i(&ctx, 9, 8, 0);
-                    emit_s32i(&ctx, 10, 8, 4);
-
-                    emit_mov_n(&ctx, 11, 6);
-                    break;
-                }
-
-                // Fallback to memcpy semantics via store_i64 helper
-                emit_l32i(&ctx, 8, 1, 8);
-                emit_mov_n(&ctx, 10, 8);
-
-                if (rs <= 15) emit_movi_n(&ctx, 11, (int8_t)rs);
-                else { emit_load_u32_to_a8(&ctx, &litpool, rs); emit_mov_n(&ctx, 11, 8); }
-
-                if (ra <= 15) emit_movi_n(&ctx, 12, (int8_t)ra);
-                else { emit_load_u32_to_a8(&ctx, &litpool, ra); emit_mov_n(&ctx, 12, 8); }
-
-                emit_load_u32_to_a8(&ctx, &litpool, (uint32_t)(int32_t)off16);
-                emit_mov_n(&ctx, 13, 8);
-
-                emit_call_helper(&ctx, &litpool, (void*)&espb_jit_xtensa_store_i64);
-
-                emit_l32i(&ctx, 8, 1, 8);
-                emit_mov_n(&ctx, 11, 8);
+                emit_mov_n(&ctx, 11, 6);  // restore v_regs pointer
                 break;
             }
 
@@ -5931,6 +6687,7 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                         emit_add_n(&ctx, 8, 8, 10);
                     }
                 }
+                XTENSA_SANDBOX_ADDR(&ctx, &litpool, 8);
 
                 // a9 = v_regs[rs].ptr (value to store)
                 emit_l32i(&ctx, 9, 6, (uint16_t)(rs * 8));
@@ -5978,6 +6735,7 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                     emit_l32i(&ctx, 8, 6, (uint16_t)(ra * 8));  // reload base
                     emit_add_n(&ctx, 8, 8, 10);
                 }
+                XTENSA_SANDBOX_ADDR(&ctx, &litpool, 8);
 
                 // Load unsigned byte
                 emit_l8ui(&ctx, 9, 8, 0);  // a9 = *(uint8_t*)(a8)
@@ -6018,6 +6776,7 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                         emit_add_n(&ctx, 8, 8, 10);
                     }
                 }
+                XTENSA_SANDBOX_ADDR(&ctx, &litpool, 8);
 
                 // Load unsigned byte (already zero-extended by L8UI)
                 emit_l8ui(&ctx, 9, 8, 0);  // a9 = *(uint8_t*)(a8)
@@ -6055,6 +6814,7 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                         emit_add_n(&ctx, 8, 8, 10);
                     }
                 }
+                XTENSA_SANDBOX_ADDR(&ctx, &litpool, 8);
 
                 // Load signed 16-bit using byte loads (unaligned-safe)
                 // l8ui a9, a8, 0   - load low byte (unsigned)
@@ -6102,6 +6862,7 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                         emit_add_n(&ctx, 8, 8, 10);
                     }
                 }
+                XTENSA_SANDBOX_ADDR(&ctx, &litpool, 8);
 
                 // Load unsigned 16-bit using byte loads (unaligned-safe)
                 // l8ui a9, a8, 0   - load low byte (unsigned)
@@ -6148,6 +6909,7 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                     emit_l32i(&ctx, 8, 6, (uint16_t)(ra * 8));  // reload base
                     emit_add_n(&ctx, 8, 8, 10);
                 }
+                XTENSA_SANDBOX_ADDR(&ctx, &litpool, 8);
 
                 // Load unsigned byte
                 emit_l8ui(&ctx, 9, 8, 0);  // a9 = *(uint8_t*)(a8)
@@ -6177,7 +6939,8 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                 break;
             }
 
-            case 0x76: { // STORE.I64 Rs(u8), Ra(u8), offset(i16)
+            case 0x76:   // STORE.I64 Rs(u8), Ra(u8), offset(i16)
+            case 0x79: { // STORE.F64 Rs(u8), Ra(u8), offset(i16) (store raw f64 bits)
                 if (pc + 4 > end) { ctx.error = true; break; }
                 uint8_t rs = *pc++;
                 uint8_t ra = *pc++;
@@ -6185,138 +6948,19 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                 memcpy(&off16, pc, sizeof(off16));
                 pc += sizeof(off16);
 
-                // Fast inline path for aligned 64-bit store.
-                // NOTE: interpreter uses memcpy (supports unaligned). Xtensa s32i requires word alignment.
-                // Keep helper fallback for unaligned offsets.
-                if ((off16 & 3) == 0) {
-                    // a6 = v_regs (save for restore)
-                    emit_mov_n(&ctx, 6, 11);
-
-                    // a8 = base pointer (low32) from v_regs[ra]
-                    emit_l32i(&ctx, 8, 6, (uint16_t)(ra * 8));
-
-                    // a8 += off16
-                    if (off16 != 0) {
-                        if (off16 >= -128 && off16 <= 127) {
-                            emit_addi(&ctx, 8, 8, (int8_t)off16);
-                        } else {
-                            // FIX: save base address before loading offset
-                            emit_mov_n(&ctx, 7, 8);  // a7 = base address
-                            emit_load_u32_to_a8(&ctx, &litpool, (uint32_t)(int32_t)off16);
-                            emit_add_n(&ctx, 8, 7, 8);  // a8 = base + offset
-                        }
-                    }
-
-                    // load value lo/hi from v_regs[rs]
-                    emit_l32i(&ctx, 9, 6, (uint16_t)(rs * 8));
-                    emit_l32i(&ctx, 10, 6, (uint16_t)(rs * 8 + 4));
-
-                    // store to *(uint64_t*)a8 as two words
-                    emit_s32i(&ctx, 9, 8, 0);
-                    emit_s32i(&ctx, 10, 8, 4);
-
-                    // restore v_regs pointer
-                    emit_mov_n(&ctx, 11, 6);
-                    break;
-                }
-
-                // Fallback: unaligned offset -> helper (memcpy semantics)
-                // Call helper: espb_jit_xtensa_store_i64(v_regs, rs, ra, offset)
-                // Windowed ABI mapping: callee a2..a7 <= caller a10..a15
-                // a10 = v_regs
-                emit_l32i(&ctx, 8, 1, 8);
-                emit_mov_n(&ctx, 10, 8);
-
-                // a11 = rs
-                if (rs <= 15) emit_movi_n(&ctx, 11, (int8_t)rs);
-                else { emit_load_u32_to_a8(&ctx, &litpool, rs); emit_mov_n(&ctx, 11, 8); }
-
-                // a12 = ra
-                if (ra <= 15) emit_movi_n(&ctx, 12, (int8_t)ra);
-                else { emit_load_u32_to_a8(&ctx, &litpool, ra); emit_mov_n(&ctx, 12, 8); }
-
-                // a13 = offset (sign-extended i16)
-                emit_load_u32_to_a8(&ctx, &litpool, (uint32_t)(int32_t)off16);
-                emit_mov_n(&ctx, 13, 8);
-
-                emit_call_helper(&ctx, &litpool, (void*)&espb_jit_xtensa_store_i64);
-
-                // Restore a11 back to v_regs pointer (ABI for rest of JIT assumes a11=v_regs)
-                emit_l32i(&ctx, 8, 1, 8);
-                emit_mov_n(&ctx, 11, 8);
-                break;
-            }
-
-            case 0x84: { // LOAD.I32 Rd(u8), Ra(u8), offset(i16)
-                if (pc + 4 > end) { ctx.error = true; break; }
-                uint8_t rd = *pc++;
-                uint8_t ra = *pc++;
-                int16_t off16;
-                memcpy(&off16, pc, sizeof(off16));
-                pc += sizeof(off16);
-
-                // Fast inline path (aligned 32-bit load). NOTE: interpreter uses memcpy (supports unaligned),
-                // but Xtensa l32i requires word alignment. Keep helper fallback for unaligned offsets.
-                if ((off16 & 3) == 0) {
-                    // a6 = v_regs (callee-saved across windowed calls)
-                    emit_mov_n(&ctx, 6, 11);
-
-                    // a8 = V_PTR(v_regs[ra]) (low32)
-                    emit_l32i(&ctx, 8, 6, (uint16_t)(ra * 8));
-
-                    // a8 = a8 + off16
-                    if (off16 != 0) {
-                        if (off16 >= -128 && off16 <= 127) {
-                            emit_addi(&ctx, 8, 8, (int8_t)off16);
-                        } else {
-                            // a10 = (int32)off16
-                            emit_load_u32_to_a8(&ctx, &litpool, (uint32_t)(int32_t)off16);
-                            emit_mov_n(&ctx, 10, 8);
-                            emit_add_n(&ctx, 8, 8, 10);
-                        }
-                    }
-
-                    // a9 = *(int32_t*)a8
-                    emit_l32i(&ctx, 9, 8, 0);
-
-                    // v_regs[rd].lo = a9; v_regs[rd].hi = 0
-                    uint16_t rd_off = (uint16_t)(rd * 8);
-                    emit_s32i(&ctx, 9, 6, rd_off);
-                    emit_movi_n(&ctx, 9, 0);
-                    emit_s32i(&ctx, 9, 6, (uint16_t)(rd_off + 4));
-
-                    // restore v_regs pointer
-                    emit_mov_n(&ctx, 11, 6);
-                    break;
-                }
-
-                // Fallback: unaligned offset -> helper (memcpy semantics)
-                // Call helper: espb_jit_xtensa_load_i32(v_regs, rd, ra, offset)
-                // Windowed ABI mapping: callee a2..a7 <= caller a10..a15
-                // a10 = v_regs
-                emit_l32i(&ctx, 8, 1, 8);
-                emit_mov_n(&ctx, 10, 8);
-
-                // a11 = rd
-                if (rd <= 15) emit_movi_n(&ctx, 11, (int8_t)rd);
-                else { emit_load_u32_to_a8(&ctx, &litpool, rd); emit_mov_n(&ctx, 11, 8); }
-
-                // a12 = ra
-                if (ra <= 15) emit_movi_n(&ctx, 12, (int8_t)ra);
-                else { emit_load_u32_to_a8(&ctx, &litpool, ra); emit_mov_n(&ctx, 12, 8); }
+                // Two words; unaligned offsets are stored byte-wise (memcpy semantics).
+                bool aligned = (off16 & 3) == 0;
+                xtensa_emit_mem_addr(&ctx, &litpool, ra, off16);
+                emit_l32i(&ctx, 9, 6, (uint16_t)(rs * 8));       // lo
+                emit_l32i(&ctx, 10, 6, (uint16_t)(rs * 8 + 4));  // hi
+                xtensa_emit_mem_store_u32(&ctx, 9, 0, aligned);
+                xtensa_emit_mem_store_u32(&ctx, 10, 4, aligned);
 
-                // a13 = offset (sign-extended i16)
-                emit_load_u32_to_a8(&ctx, &litpool, (uint32_t)(int32_t)off16);
-                emit_mov_n(&ctx, 13, 8);
-
-                emit_call_helper(&ctx, &litpool, (void*)&espb_jit_xtensa_load_i32);
-
-                // Restore a11 back to v_regs pointer (ABI for rest of JIT assumes a11=v_regs)
-                emit_l32i(&ctx, 8, 1, 8);
-                emit_mov_n(&ctx, 11, 8);
+                emit_mov_n(&ctx, 11, 6);
                 break;
             }
 
+            case 0x84:   // LOAD.I32 Rd(u8), Ra(u8), offset(i16)
             case 0x86: { // LOAD.F32 Rd(u8), Ra(u8), offset(i16) (load raw f32 bits)
                 if (pc + 4 > end) { ctx.error = true; break; }
                 uint8_t rd = *pc++;
@@ -6325,124 +6969,22 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                 memcpy(&off16, pc, sizeof(off16));
                 pc += sizeof(off16);
 
-                // Same strategy as LOAD.I32:
-                // - aligned => inline l32i
-                // - unaligned => helper memcpy semantics
-                if ((off16 & 3) == 0) {
-                    emit_mov_n(&ctx, 6, 11); // a6 = v_regs
-                    emit_l32i(&ctx, 8, 6, (uint16_t)(ra * 8)); // a8 = base pointer
-
-                    if (off16 != 0) {
-                        if (off16 >= -128 && off16 <= 127) {
-                            emit_addi(&ctx, 8, 8, (int8_t)off16);
-                        } else {
-                            emit_load_u32_to_a8(&ctx, &litpool, (uint32_t)(int32_t)off16);
-                            emit_mov_n(&ctx, 10, 8);
-                            emit_add_n(&ctx, 8, 8, 10);
-                        }
-                    }
-
-                    emit_l32i(&ctx, 9, 8, 0); // raw bits
-
-                    uint16_t rd_off = (uint16_t)(rd * 8);
-                    emit_s32i(&ctx, 9, 6, rd_off); // store to low32
-                    emit_movi_n(&ctx, 9, 0);
-                    emit_s32i(&ctx, 9, 6, (uint16_t)(rd_off + 4));
-
-                    emit_mov_n(&ctx, 11, 6);
-                    break;
-                }
-
-                // Unaligned => reuse the same helper as LOAD.I32
-                emit_l32i(&ctx, 8, 1, 8);
-                emit_mov_n(&ctx, 10, 8);
-
-                if (rd <= 15) emit_movi_n(&ctx, 11, (int8_t)rd);
-                else { emit_load_u32_to_a8(&ctx, &litpool, rd); emit_mov_n(&ctx, 11, 8); }
-
-                if (ra <= 15) emit_movi_n(&ctx, 12, (int8_t)ra);
-                else { emit_load_u32_to_a8(&ctx, &litpool, ra); emit_mov_n(&ctx, 12, 8); }
-
-                emit_load_u32_to_a8(&ctx, &litpool, (uint32_t)(int32_t)off16);
-                emit_mov_n(&ctx, 13, 8);
-
-                emit_call_helper(&ctx, &litpool, (void*)&espb_jit_xtensa_load_i32);
-
-                emit_l32i(&ctx, 8, 1, 8);
-                emit_mov_n(&ctx, 11, 8);
-                break;
-            }
-
-            case 0x85: { // LOAD.I64 Rd(u8), Ra(u8), offset(i16)
-                if (pc + 4 > end) { ctx.error = true; break; }
-                uint8_t rd = *pc++;
-                uint8_t ra = *pc++;
-                int16_t off16;
-                memcpy(&off16, pc, sizeof(off16));
-                pc += sizeof(off16);
-
-                // Fast inline path for aligned 64-bit load.
-                // NOTE: interpreter uses memcpy (supports unaligned). Xtensa l32i requires word alignment.
-                // We keep helper fallback for unaligned offsets.
-                if ((off16 & 3) == 0) {
-                    // a6 = v_regs
-                    emit_mov_n(&ctx, 6, 11);
-
-                    // a8 = base pointer (low32) from v_regs[ra]
-                    emit_l32i(&ctx, 8, 6, (uint16_t)(ra * 8));
-
-                    // a8 += off16
-                    if (off16 != 0) {
-                        if (off16 >= -128 && off16 <= 127) {
-                            emit_addi(&ctx, 8, 8, (int8_t)off16);
-                        } else {
-                            emit_load_u32_to_a8(&ctx, &litpool, (uint32_t)(int32_t)off16);
-                            emit_mov_n(&ctx, 10, 8);
-                            emit_add_n(&ctx, 8, 8, 10);
-                        }
-                    }
-
-                    // load lo/hi
-                    emit_l32i(&ctx, 9, 8, 0);
-                    emit_l32i(&ctx, 10, 8, 4);
-
-                    // store into v_regs[rd]
-                    uint16_t rd_off = (uint16_t)(rd * 8);
-                    emit_s32i(&ctx, 9, 6, rd_off);
-                    emit_s32i(&ctx, 10, 6, (uint16_t)(rd_off + 4));
-
-                    // restore v_regs pointer
-                    emit_mov_n(&ctx, 11, 6);
-                    break;
-                }
-
-                // Fallback: unaligned offset -> helper (memcpy semantics)
-                // Call helper: espb_jit_xtensa_load_i64(v_regs, rd, ra, offset)
-                // Windowed ABI mapping: callee a2..a7 <= caller a10..a15
-                // a10 = v_regs
-                emit_l32i(&ctx, 8, 1, 8);
-                emit_mov_n(&ctx, 10, 8);
-
-                // a11 = rd
-                if (rd <= 15) emit_movi_n(&ctx, 11, (int8_t)rd);
-                else { emit_load_u32_to_a8(&ctx, &litpool, rd); emit_mov_n(&ctx, 11, 8); }
-
-                // a12 = ra
-                if (ra <= 15) emit_movi_n(&ctx, 12, (int8_t)ra);
-                else { emit_load_u32_to_a8(&ctx, &litpool, ra); emit_mov_n(&ctx, 12, 8); }
+                // Aligned offset => l32i, unaligned => byte-wise l8ui (memcpy semantics).
+                bool aligned = (off16 & 3) == 0;
+                xtensa_emit_mem_addr(&ctx, &litpool, ra, off16);
+                xtensa_emit_mem_load_u32(&ctx, 9, 0, aligned);
 
-                // a13 = offset (sign-extended i16)
-                emit_load_u32_to_a8(&ctx, &litpool, (uint32_t)(int32_t)off16);
-                emit_mov_n(&ctx, 13, 8);
-
-                emit_call_helper(&ctx, &litpool, (void*)&espb_jit_xtensa_load_i64);
+                // v_regs[rd].lo = a9; v_regs[rd].hi = 0
+                uint16_t rd_off = (uint16_t)(rd * 8);
+                emit_s32i(&ctx, 9, 6, rd_off);
+                emit_movi_n(&ctx, 9, 0);
+                emit_s32i(&ctx, 9, 6, (uint16_t)(rd_off + 4));
 
-                // Restore a11 back to v_regs pointer (ABI for rest of JIT assumes a11=v_regs)
-                emit_l32i(&ctx, 8, 1, 8);
-                emit_mov_n(&ctx, 11, 8);
+                emit_mov_n(&ctx, 11, 6);
                 break;
             }
 
+            case 0x85:   // LOAD.I64 Rd(u8), Ra(u8), offset(i16)
             case 0x87: { // LOAD.F64 Rd(u8), Ra(u8), offset(i16) (load raw f64 bits)
                 if (pc + 4 > end) { ctx.error = true; break; }
                 uint8_t rd = *pc++;
@@ -6451,52 +6993,16 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                 memcpy(&off16, pc, sizeof(off16));
                 pc += sizeof(off16);
 
-                // Same strategy as LOAD.I64:
-                // - aligned => inline two l32i
-                // - unaligned => helper memcpy semantics (reuse load_i64)
-                if ((off16 & 3) == 0) {
-                    emit_mov_n(&ctx, 6, 11); // a6 = v_regs
-
-                    emit_l32i(&ctx, 8, 6, (uint16_t)(ra * 8));
-
-                    if (off16 != 0) {
-                        if (off16 >= -128 && off16 <= 127) {
-                            emit_addi(&ctx, 8, 8, (int8_t)off16);
-                        } else {
-                            emit_load_u32_to_a8(&ctx, &litpool, (uint32_t)(int32_t)off16);
-                            emit_mov_n(&ctx, 10, 8);
-                            emit_add_n(&ctx, 8, 8, 10);
-                        }
-                    }
-
-                    emit_l32i(&ctx, 9, 8, 0);
-                    emit_l32i(&ctx, 10, 8, 4);
-
-                    uint16_t rd_off = (uint16_t)(rd * 8);
-                    emit_s32i(&ctx, 9, 6, rd_off);
-                    emit_s32i(&ctx, 10, 6, (uint16_t)(rd_off + 4));
+                bool aligned = (off16 & 3) == 0;
+                xtensa_emit_mem_addr(&ctx, &litpool, ra, off16);
+                xtensa_emit_mem_load_u32(&ctx, 9, 0, aligned);
+                xtensa_emit_mem_load_u32(&ctx, 10, 4, aligned);
 
-                    emit_mov_n(&ctx, 11, 6);
-                    break;
-                }
-
-                // Unaligned -> reuse load_i64 helper (memcpy 8 bytes)
-                emit_l32i(&ctx, 8, 1, 8);
-                emit_mov_n(&ctx, 10, 8);
-
-                if (rd <= 15) emit_movi_n(&ctx, 11, (int8_t)rd);
-                else { emit_load_u32_to_a8(&ctx, &litpool, rd); emit_mov_n(&ctx, 11, 8); }
-
-                if (ra <= 15) emit_movi_n(&ctx, 12, (int8_t)ra);
-                else { emit_load_u32_to_a8(&ctx, &litpool, ra); emit_mov_n(&ctx, 12, 8); }
-
-                emit_load_u32_to_a8(&ctx, &litpool, (uint32_t)(int32_t)off16);
-                emit_mov_n(&ctx, 13, 8);
-
-                emit_call_helper(&ctx, &litpool, (void*)&espb_jit_xtensa_load_i64);
+                uint16_t rd_off = (uint16_t)(rd * 8);
+                emit_s32i(&ctx, 9, 6, rd_off);
+                emit_s32i(&ctx, 10, 6, (uint16_t)(rd_off + 4));
 
-                emit_l32i(&ctx, 8, 1, 8);
-                emit_mov_n(&ctx, 11, 8);
+                emit_mov_n(&ctx, 11, 6);
                 break;
             }
 
@@ -6799,6 +7305,20 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                 JIT_LOGI(TAG, "[CALL] Generating call to local_func_idx=%u at bc_off=%zu", 
                          (unsigned)local_func_idx, (size_t)(pc - start - 3));
 
+                // Self tail call (CALL self; END): the arguments are already in place, so
+                // clear the rest of the frame like a fresh call would and restart the body
+                uint32_t tail_zero_from, tail_zero_to;
+                if (espb_jit_self_tail_call(instance->module, func_idx, local_func_idx, pc, end, UINT8_MAX,
+                                            &tail_zero_from, &tail_zero_to)) {
+                    if (tail_zero_to > tail_zero_from) emit_movi_n(&ctx, 8, 0);
+                    for (uint32_t r = tail_zero_from; r < tail_zero_to; r++) {
+                        emit_s32i(&ctx, 8, 11, (uint16_t)(r * 8));
+                        emit_s32i(&ctx, 8, 11, (uint16_t)(r * 8 + 4));
+                    }
+                    emit_j_to_target(&ctx, tail_entry);
+                    break;
+                }
+
                 // Call helper: jit_call_espb_function_xtensa(instance, local_func_idx, v_regs)
                 // Windowed ABI: callee a2..a7 <= caller a10..a15
                 
@@ -6944,6 +7464,19 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                 JIT_LOGI(TAG, "[0x1D] LD_GLOBAL_ADDR: rd=%u symbol_idx=%u num_vregs=%u", 
                          (unsigned)rd, (unsigned)symbol_idx, (unsigned)num_vregs);
 
+                // Global in globals_data: the address is computed in place
+                if (!(symbol_idx & 0x8000) && espb_jit_global_direct_size(instance->module, symbol_idx, false) != 0) {
+                    uint16_t goff = xtensa_emit_global_base(&ctx, &litpool, instance, symbol_idx);
+                    if (goff != 0) {
+                        emit_movi(&ctx, 9, (int16_t)goff);
+                        emit_add_n(&ctx, 8, 8, 9);
+                    }
+                    emit_s32i(&ctx, 8, 11, (uint16_t)(rd * 8));
+                    emit_movi_n(&ctx, 9, 0);
+                    emit_s32i(&ctx, 9, 11, (uint16_t)(rd * 8 + 4));
+                    break;
+                }
+
                 // Landing-zone (4 bytes): two NOP.N instructions.
                 // If a branch lands at entry it executes NOPs then body.
                 // If it lands at entry+4 it enters body directly.
@@ -7013,6 +7546,21 @@ EspbResult espb_jit_compile_function_xtensa_inline(
 
                 pc += 2;
 
+                // Global in globals_data: a single load instead of calling espb_jit_ld_global.
+                // Like the helper, values up to 32 bits are zero-extended to the whole Value.
+                uint8_t gsize = espb_jit_global_direct_size(instance->module, global_idx, false);
+                if (gsize != 0) {
+                    uint16_t goff = xtensa_emit_global_base(&ctx, &litpool, instance, global_idx);
+                    if (gsize == 1) emit_l8ui(&ctx, 9, 8, goff);
+                    else if (gsize == 2) emit_l16ui(&ctx, 9, 8, goff);
+                    else emit_l32i(&ctx, 9, 8, goff);
+                    emit_s32i(&ctx, 9, 11, (uint16_t)(rd * 8));
+                    if (gsize == 8) emit_l32i(&ctx, 9, 8, (uint16_t)(goff + 4));
+                    else emit_movi_n(&ctx, 9, 0);
+                    emit_s32i(&ctx, 9, 11, (uint16_t)(rd * 8 + 4));
+                    break;
+                }
+
 
 
                 // Landing-zone (4 bytes): two NOP.N instructions.
@@ -7086,6 +7634,22 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                 pc += 2;
                 uint8_t rs = *pc++;
 
+                // Global in globals_data: a single store instead of calling espb_jit_st_global.
+                // Word stores go through emit_s32i_mem: globals never alias v_regs, the cache stays valid.
+                uint8_t gsize = espb_jit_global_direct_size(instance->module, global_idx, true);
+                if (gsize != 0) {
+                    uint16_t goff = xtensa_emit_global_base(&ctx, &litpool, instance, global_idx);
+                    emit_l32i(&ctx, 9, 11, (uint16_t)(rs * 8));
+                    if (gsize == 1) emit_s8i(&ctx, 9, 8, goff);
+                    else if (gsize == 2) emit_s16i(&ctx, 9, 8, goff);
+                    else emit_s32i_mem(&ctx, 9, 8, goff);
+                    if (gsize == 8) {
+                        emit_l32i(&ctx, 9, 11, (uint16_t)(rs * 8 + 4));
+                        emit_s32i_mem(&ctx, 9, 8, (uint16_t)(goff + 4));
+                    }
+                    break;
+                }
+
                 // Landing-zone (4 bytes): two NOP.N instructions.
                 emit_nop_n(&ctx);
                 emit_nop_n(&ctx);
@@ -7202,6 +7766,12 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                 if (pc + 2 > end) { ctx.error = true; break; }
                 uint8_t rd = *pc++;
                 uint8_t rs = *pc++;
+#if CONFIG_ESPB_SANDBOX_MASKED
+                // v_regs live outside the sandboxed linear memory
+                (void)rd; (void)rs;
+                ctx.error = true;
+                break;
+#endif
                 
                 // v_regs[rd].ptr = &v_regs[rs]
                 // a11 = v_regs pointer
@@ -7234,7 +7804,8 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                 uint8_t align = *pc++;
 
                 // Call helper: espb_runtime_alloca(instance, exec_ctx, regs, num_vregs, rd, rs_size, align)
-                // NOTE: current JIT entrypoint signature doesn't provide ExecutionContext, so we pass NULL.
+                // NOTE: current JIT entrypoint signature doesn't provide ExecutionContext, so we pass NULL
+                // and the block comes from the task's JIT ALLOCA stack (unwound by execute_jit_code).
 
                 // a10 = instance
                 emit_l32i(&ctx, 8, 1, 4);
@@ -7270,6 +7841,12 @@ EspbResult espb_jit_compile_function_xtensa_inline(
 
                 emit_call_helper(&ctx, &litpool, (void*)&espb_runtime_alloca);
 
+                // ALLOCA stack overflow (or another instance on it): trap, rd is NULL.
+                // a8 = result; beqz.n a8, +3 (imm=1) over a 3-byte ILL
+                emit_mov_n(&ctx, 8, 10);
+                emit_u16(&ctx, 0x188C);
+                emit_u24(&ctx, 0x000000);
+
                 // Restore a11 back to v_regs pointer from stack
                 // NOTE: Cannot use a12 here because CALL8 rotates window and a12 becomes
                 // callee's a4 which may be clobbered by the callee function.
@@ -7313,6 +7890,12 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                     }
                 }
 
+#if CONFIG_ESPB_JIT_DIRECT_IMPORTS
+                if (!has_var && xtensa_emit_direct_import_call(&ctx, instance, import_idx)) {
+                    break;
+                }
+#endif
+
                 // Prepare args for callx8 mapping (callee a2..a7 <= caller a10..a15)
                 // espb_jit_call_import(instance, import_idx, v_regs, num_vregs, has_var, num_args, arg_types_ptr)
 
@@ -7560,6 +8143,7 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                         emit_add_n(&ctx, 8, 7, 8);  // a8 = base + offset
                     }
                 }
+                XTENSA_SANDBOX_ADDR(&ctx, &litpool, 8);
 
                 // a9 = value from v_regs[rs]
                 emit_l32i(&ctx, 9, 6, (uint16_t)(rs * 8));
@@ -7596,6 +8180,7 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                         emit_add_n(&ctx, 8, 8, 10);
                     }
                 }
+                XTENSA_SANDBOX_ADDR(&ctx, &litpool, 8);
 
                 // a9 = value from v_regs[rs]
                 emit_l32i(&ctx, 9, 6, (uint16_t)(rs * 8));
@@ -7633,6 +8218,7 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                         emit_add_n(&ctx, 7, 7, 8);  // a7 = base + offset
                     }
                 }
+                XTENSA_SANDBOX_ADDR(&ctx, &litpool, 7);
 
                 // a9 = value from v_regs[rs]
                 emit_l32i(&ctx, 9, 6, (uint16_t)(rs * 8));
@@ -7657,6 +8243,18 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                 break;
             }
 
+            case 0xFD: { // PREFIX: V128 sub_op, operands per espb_v128_operand_len
+                if (pc >= end) { ctx.error = true; break; }
+                uint8_t sub_op = *pc++;
+                size_t v128_len = espb_v128_operand_len(sub_op);
+                if (v128_len == 0 || (size_t)(end - pc) < v128_len || !emit_v128(&ctx, &litpool, sub_op, pc)) {
+                    ctx.error = true;
+                    break;
+                }
+                pc += v128_len;
+                break;
+            }
+
             case 0xFC: { // PREFIX: Extended Ops
                 if (pc >= end) { ctx.error = true; break; }
                 uint8_t ext_opcode = *pc++;
@@ -7749,12 +8347,21 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                         uint8_t rval = *pc++;
                         uint8_t rn = *pc++;
 
+                        uint32_t const_size;
+                        if (espb_bulk_const_size(code, (uint32_t)code_size, (uint32_t)last_off, rn, &const_size) &&
+                            const_size <= XTENSA_INLINE_MEMFILL_MAX) {
+                            emit_l32i(&ctx, 8, 11, (uint16_t)(rd * 8));
+                            emit_l32i(&ctx, 9, 11, (uint16_t)(rval * 8));
+                            for (uint32_t i = 0; i < const_size; ++i) emit_s8i(&ctx, 9, 8, (uint16_t)i);
+                            break;
+                        }
+
                         emit_mov_n(&ctx, 6, 11);
                         emit_l32i(&ctx, 10, 6, (uint16_t)(rd * 8));
                         emit_l32i(&ctx, 11, 6, (uint16_t)(rval * 8));
                         emit_l32i(&ctx, 12, 6, (uint16_t)(rn * 8));
 
-                        emit_call_helper(&ctx, &litpool, (void*)&memset);
+                        emit_call_helper(&ctx, &litpool, (void*)&espb_memory_fill);
                         emit_mov_n(&ctx, 11, 6);
                         break;
                     }
@@ -7765,12 +8372,24 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                         uint8_t rs = *pc++;
                         uint8_t rn = *pc++;
 
+                        // Every byte is loaded before the first store, so overlapping blocks keep memmove semantics.
+                        uint32_t const_size;
+                        if (espb_bulk_const_size(code, (uint32_t)code_size, (uint32_t)last_off, rn, &const_size) &&
+                            const_size <= XTENSA_INLINE_MEMCOPY_MAX) {
+                            static const uint8_t tmp[XTENSA_INLINE_MEMCOPY_MAX] = { 10, 12, 13, 14, 15, 7 };
+                            emit_l32i(&ctx, 8, 11, (uint16_t)(rd * 8));
+                            emit_l32i(&ctx, 9, 11, (uint16_t)(rs * 8));
+                            for (uint32_t i = 0; i < const_size; ++i) emit_l8ui(&ctx, tmp[i], 9, (uint16_t)i);
+                            for (uint32_t i = 0; i < const_size; ++i) emit_s8i(&ctx, tmp[i], 8, (uint16_t)i);
+                            break;
+                        }
+
                         emit_mov_n(&ctx, 6, 11);
                         emit_l32i(&ctx, 10, 6, (uint16_t)(rd * 8));
                         emit_l32i(&ctx, 11, 6, (uint16_t)(rs * 8));
                         emit_l32i(&ctx, 12, 6, (uint16_t)(rn * 8));
 
-                        emit_call_helper(&ctx, &litpool, (void*)&memmove);
+                        emit_call_helper(&ctx, &litpool, (void*)&espb_memory_copy);
                         emit_mov_n(&ctx, 11, 6);
                         break;
                     }
@@ -7964,6 +8583,34 @@ EspbResult espb_jit_compile_function_xtensa_inline(
                         break;
                     }
 
+                    case 0x0C: { // MEMORY.SIZE Rd(u8)
+                        if (pc + 1 > end) { ctx.error = true; break; }
+                        uint8_t rd = *pc++;
+
+                        emit_mov_n(&ctx, 6, 11);
+                        emit_l32i(&ctx, 10, 1, 4);
+                        emit_call_helper(&ctx, &litpool, (void*)&espb_memory_size);
+
+                        emit_s32i(&ctx, 10, 6, (uint16_t)(rd * 8));
+                        emit_mov_n(&ctx, 11, 6);
+                        break;
+                    }
+
+                    case 0x0D: { // MEMORY.GROW Rd(u8), Rs(u8)
+                        if (pc + 2 > end) { ctx.error = true; break; }
+                        uint8_t rd = *pc++;
+                        uint8_t rs = *pc++;
+
+                        emit_mov_n(&ctx, 6, 11);
+                        emit_l32i(&ctx, 10, 1, 4);
+                        emit_l32i(&ctx, 11, 6, (uint16_t)(rs * 8));
+                        emit_call_helper(&ctx, &litpool, (void*)&espb_memory_grow);
+
+                        emit_s32i(&ctx, 10, 6, (uint16_t)(rd * 8));
+                        emit_mov_n(&ctx, 11, 6);
+                        break;
+                    }
+
                     default:
                         ESP_LOGW(TAG, "Unsupported extended opcode 0xFC 0x%02X at offset %zu", ext_opcode, (size_t)(pc - start - 2));
                         ctx.error = true;
@@ -8017,6 +8664,7 @@ EspbResult espb_jit_compile_function_xtensa_inline(
 
                 // a10 = address (v_regs[ra].ptr)
                 emit_l32i(&ctx, 10, 6, (uint16_t)(ra * 8));
+                XTENSA_SANDBOX_ADDR(&ctx, &litpool, 10);
                 // a11 = value (v_regs[rv].i32)
                 emit_l32i(&ctx, 11, 6, (uint16_t)(rv * 8));
 
@@ -8049,6 +8697,7 @@ EspbResult espb_jit_compile_function_xtensa_inline(
 
                 // a10 = address (v_regs[ra].ptr)
                 emit_l32i(&ctx, 10, 6, (uint16_t)(ra * 8));
+                XTENSA_SANDBOX_ADDR(&ctx, &litpool, 10);
                 // a11 = pointer to expected on stack
                 emit_mov_n(&ctx, 11, 1);
                 // a12 = desired (v_regs[rdes].i32)
@@ -8076,6 +8725,7 @@ EspbResult espb_jit_compile_function_xtensa_inline(
 
                 // a10 = address (v_regs[ra].ptr)
                 emit_l32i(&ctx, 10, 6, (uint16_t)(ra * 8));
+                XTENSA_SANDBOX_ADDR(&ctx, &litpool, 10);
 
                 emit_call_helper(&ctx, &litpool, (void*)jit_xtensa_atomic_load_4);
 
@@ -8097,6 +8747,7 @@ EspbResult espb_jit_compile_function_xtensa_inline(
 
                 // a10 = address (v_regs[ra].ptr)
                 emit_l32i(&ctx, 10, 6, (uint16_t)(ra * 8));
+                XTENSA_SANDBOX_ADDR(&ctx, &litpool, 10);
                 // a11 = value (v_regs[rs].i32)
                 emit_l32i(&ctx, 11, 6, (uint16_t)(rs * 8));
 
@@ -8116,6 +8767,7 @@ EspbResult espb_jit_compile_function_xtensa_inline(
 
                 // a10 = address (v_regs[ra].ptr)
                 emit_l32i(&ctx, 10, 6, (uint16_t)(ra * 8));
+                XTENSA_SANDBOX_ADDR(&ctx, &litpool, 10);
 
                 // Call wrapper: uint64_t jit_xtensa_atomic_load_8(volatile void* ptr)
                 emit_call_helper(&ctx, &litpool, (void*)jit_xtensa_atomic_load_8);
@@ -8137,6 +8789,7 @@ EspbResult espb_jit_compile_function_xtensa_inline(
 
                 // a10 = address (v_regs[ra].ptr)
                 emit_l32i(&ctx, 10, 6, (uint16_t)(ra * 8));
+                XTENSA_SANDBOX_ADDR(&ctx, &litpool, 10);
                 // For Xtensa windowed ABI, 64-bit arg after 32-bit ptr must be aligned to even register pair
                 // Since addr is in a10, the 64-bit value goes in a12:a13 (skipping a11)
                 emit_l32i(&ctx, 12, 6, (uint16_t)(rs * 8));      // low 32
@@ -8182,6 +8835,7 @@ EspbResult espb_jit_compile_function_xtensa_inline(
 
                 // a10 = address (v_regs[ra].ptr)
                 emit_l32i(&ctx, 10, 6, (uint16_t)(ra * 8));
+                XTENSA_SANDBOX_ADDR(&ctx, &litpool, 10);
                 // For Xtensa windowed ABI, 64-bit arg after 32-bit ptr must be aligned to even register pair
                 // Since addr is in a10, the 64-bit value goes in a12:a13 (skipping a11)
                 emit_l32i(&ctx, 12, 6, (uint16_t)(rv * 8));
@@ -8217,6 +8871,7 @@ EspbResult espb_jit_compile_function_xtensa_inline(
 
                 // a10 = address (v_regs[ra].ptr)
                 emit_l32i(&ctx, 10, 6, (uint16_t)(ra * 8));
+                XTENSA_SANDBOX_ADDR(&ctx, &litpool, 10);
                 // a11 = pointer to expected on stack
                 emit_mov_n(&ctx, 11, 1);  // a11 = sp (points to expected)
                 // For Xtensa windowed ABI, 64-bit arg must be aligned to even register pair
@@ -8245,6 +8900,18 @@ EspbResult espb_jit_compile_function_xtensa_inline(
         }
     }
 
+#if CONFIG_ESPB_JIT_XTENSA_VCACHE
+    heap_caps_free(vc_targets);
+    ctx.vc_active = false;
+    xtensa_vc_invalidate(&ctx);
+#endif
+#if XTENSA_HW_LOOPS
+    heap_caps_free(hwloops);
+#endif
+#if CONFIG_ESPB_FUEL
+    free(fuel_headers);
+#endif
+
     // Ensure all bytes are committed before final fixups
     emit_flush_words(&ctx);
 
@@ -8301,6 +8968,10 @@ EspbResult espb_jit_compile_function_xtensa_inline(
     // Ensure any buffered bytes are committed to memory
     emit_flush_words(&ctx);
 
+#if CONFIG_ESPB_JIT_OSR
+    EspbJitOsrInfo* osr = (out_osr && !ctx.error) ? xtensa_emit_osr_stub(&ctx, code, code_size, bc_to_native) : NULL;
+#endif
+
 #if ESPB_JIT_DEBUG_OPTOCODES
     // Debug (BR_TABLE): dump bc_to_native mapping for selected targets
     ESP_LOGI(TAG, "bc_to_native for BR_TABLE targets:");
@@ -8345,10 +9016,16 @@ EspbResult espb_jit_compile_function_xtensa_inline(
 #endif
 
     if (ctx.error) {
-        ESP_LOGE(TAG, "Inline JIT failed at bytecode offset %u (opcode 0x%02X)", (unsigned)last_off, (unsigned)last_op);
         heap_caps_free(fixups);
         heap_caps_free(bc_to_native);
-        espb_exec_free(buffer);
+#if CONFIG_ESPB_JIT_OSR
+        free(osr);
+#endif
+        espb_jit_code_abort(instance, buffer);
+        // Budget rejections are reported by the dispatcher
+        if (timed_out) return ESPB_ERR_JIT_TIMEOUT;
+        if (ctx.overflow) return ESPB_ERR_JIT_CODE_TOO_LARGE;
+        ESP_LOGE(TAG, "Inline JIT failed at bytecode offset %u (opcode 0x%02X)", (unsigned)last_off, (unsigned)last_op);
         return ESPB_ERR_INVALID_STATE;
     }
 
@@ -8366,9 +9043,10 @@ EspbResult espb_jit_compile_function_xtensa_inline(
     }
 
     // Shrink-to-fit: release unused EXEC heap to avoid fragmentation.
-    // Keep alignment to 4 bytes for safety.
+    // Keep alignment to 4 bytes for safety. Arena code must stay in place: its l32r reach back to the chunk island.
     size_t used_size = (ctx.offset + 3u) & ~3u;
-    if (used_size > 0 && used_size < ctx.capacity) {
+    bool in_arena = espb_jit_code_commit(instance, buffer, ctx.offset);
+    if (!in_arena && used_size > 0 && used_size < ctx.capacity) {
         uint8_t *shrunk = (uint8_t*)espb_exec_realloc(buffer, used_size);
         if (shrunk) {
             buffer = shrunk;
@@ -8379,11 +9057,38 @@ EspbResult espb_jit_compile_function_xtensa_inline(
         }
     }
 
+#if ESPB_JIT_PC_MAPS
+    // Code map for the sampler and the JIT code map: every bytecode offset that starts emitted code
+    if (out_pc_map) {
+        size_t num_entries = 0;
+        for (size_t i = 0; i < code_size; i++) {
+            if (bc_to_native[i] != XTENSA_BC_UNSET) num_entries++;
+        }
+        EspbJitPcMapEntry* entries = num_entries ? (EspbJitPcMapEntry*)malloc(num_entries * sizeof(EspbJitPcMapEntry)) : NULL;
+        if (entries) {
+            size_t n = 0;
+            for (size_t i = 0; i < code_size; i++) {
+                if (bc_to_native[i] == XTENSA_BC_UNSET) continue;
+                entries[n].native_offset = bc_to_native[i];
+                entries[n].bc_offset = (uint32_t)i;
+                n++;
+            }
+            *out_pc_map = espb_jit_pc_map_create(entries, n);
+            free(entries);
+        }
+    }
+#endif
+
     heap_caps_free(fixups);
     heap_caps_free(bc_to_native);
 
     *out_code = buffer;
     *out_size = ctx.offset;
+    // The v_regs cache is write-through, so the Xtensa backend never spills
+    espb_jit_stats_codegen(instance, func_idx, ctx.helper_call_count, ctx.helper_call_count, 0);
+#if CONFIG_ESPB_JIT_OSR
+    if (out_osr) *out_osr = osr;
+#endif
 
 #if ESPB_JIT_DEBUG
     ESP_LOGI(TAG, "Inline JIT compiled: %zu bytes at %p", ctx.offset, (void*)buffer);
@@ -21,7 +21,19 @@
 #include "espb_host_symbols.h"
 #include "espb_callback_system.h"
 #include "espb_jit_dispatcher.h"
+#include "espb_jit_reload.h"
+#include "espb_profiler.h"
+#include "espb_import_profile.h"
+#include "espb_jit_stats.h"
+#include "espb_sampler.h"
+#include "espb_jit_code_map.h"
+#include "espb_memory_stats.h"
+#include "esp_heap_caps.h"
+#include "esp_partition.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 // Внешние обертки для iram_pool
@@ -35,23 +47,18 @@ struct espb_module_handle_t {
 };
 
 
-EspbResult espb_load_module(const uint8_t *espb_data, size_t espb_size, espb_handle_t *out_handle) {
-    printf("--- ESPB Loading Module ---\n");
-
+static EspbResult espb_runtime_init(void) {
     iram_pool_init_wrapper();
     if (espb_callback_system_init() != ESPB_OK) return ESPB_ERR_INVALID_STATE;
     init_cpp_symbols();
+    return ESPB_OK;
+}
 
-    EspbModule *module = NULL;
-    EspbResult result = espb_parse_module(&module, espb_data, espb_size);
-    if (result != ESPB_OK) return result;
-
+// Экземпляр держит ссылку на модуль: ссылку вызывающей стороны это не затрагивает
+static EspbResult espb_new_handle(EspbModule *module, espb_handle_t *out_handle) {
     EspbInstance *instance = NULL;
-    result = espb_instantiate(&instance, module);
-    if (result != ESPB_OK) {
-        espb_free_module(module);
-        return result;
-    }
+    EspbResult result = espb_instantiate(&instance, module);
+    if (result != ESPB_OK) return result;
 
     espb_handle_t handle = (espb_handle_t)malloc(sizeof(struct espb_module_handle_t));
     if (!handle) {
@@ -62,52 +69,724 @@ EspbResult espb_load_module(const uint8_t *espb_data, size_t espb_size, espb_han
     handle->module = module;
     handle->instance = instance;
     *out_handle = handle;
+    return ESPB_OK;
+}
+
+EspbResult espb_load_module(const uint8_t *espb_data, size_t espb_size, espb_handle_t *out_handle) {
+    printf("--- ESPB Loading Module ---\n");
+
+    EspbResult result = espb_runtime_init();
+    if (result != ESPB_OK) return result;
+
+    EspbModule *module = NULL;
+    result = espb_parse_module(&module, espb_data, espb_size);
+    if (result != ESPB_OK) return result;
+
+    result = espb_new_handle(module, out_handle);
+    // Дальше модулем владеет экземпляр
+    espb_module_release(module);
+    if (result != ESPB_OK) return result;
 
     printf("--- ESPB Module Loaded ---\n");
     return ESPB_OK;
 }
 
+// Размер модуля в разделе: конец самой дальней секции по таблице секций
+static EspbResult espb_partition_module_size(const esp_partition_t *part, size_t *out_size) {
+    uint8_t hdr[18];
+    if (esp_partition_read(part, 0, hdr, sizeof(hdr)) != ESP_OK) return ESPB_ERR_INVALID_HEADER;
+    uint32_t magic;
+    uint16_t num_sections;
+    memcpy(&magic, hdr, sizeof(magic));
+    memcpy(&num_sections, hdr + 16, sizeof(num_sections));
+    if (magic != ESPB_MAGIC_NUMBER) return ESPB_ERR_INVALID_MAGIC;
+    if (num_sections == 0 || num_sections > 256) return ESPB_ERR_INVALID_SECTION_TABLE;
+
+    size_t end = sizeof(hdr) + (size_t)num_sections * 12;
+    for (uint16_t i = 0; i < num_sections; i++) {
+        uint8_t entry[12];
+        if (esp_partition_read(part, sizeof(hdr) + (size_t)i * sizeof(entry), entry, sizeof(entry)) != ESP_OK) {
+            return ESPB_ERR_INVALID_SECTION_TABLE;
+        }
+        uint32_t off, size;
+        memcpy(&off, entry + 4, sizeof(off));
+        memcpy(&size, entry + 8, sizeof(size));
+        if ((size_t)off + size > end) end = (size_t)off + size;
+    }
+    if (end > part->size) return ESPB_ERR_BUFFER_TOO_SMALL;
+    *out_size = end;
+    return ESPB_OK;
+}
+
+// Отображает модуль из раздела и разбирает его на месте: байт-код, сегменты данных и
+// имена читаются через кэш flash, в DRAM попадают только таблицы парсера
+static EspbResult espb_parse_partition_module(const char *partition_label, EspbModule **out_module) {
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                                           partition_label);
+    if (!part) {
+        printf("ESPB: partition '%s' not found\n", partition_label ? partition_label : "(null)");
+        return ESPB_ERR_INVALID_STATE;
+    }
+
+    size_t size = 0;
+    EspbResult result = espb_partition_module_size(part, &size);
+    if (result != ESPB_OK) return result;
+
+    const void *data = NULL;
+    esp_partition_mmap_handle_t mmap_handle;
+    if (esp_partition_mmap(part, 0, size, ESP_PARTITION_MMAP_DATA, &data, &mmap_handle) != ESP_OK) {
+        return ESPB_ERR_MEMORY_ALLOC;
+    }
+
+    result = espb_parse_module(out_module, (const uint8_t *)data, size);
+    if (result != ESPB_OK) {
+        esp_partition_munmap(mmap_handle);
+        return result;
+    }
+    (*out_module)->buffer_mmapped = true;
+    (*out_module)->buffer_mmap_handle = (uint32_t)mmap_handle;
+    return ESPB_OK;
+}
+
+EspbResult espb_load_module_from_partition(const char *partition_label, espb_handle_t *out_handle) {
+    if (!out_handle) return ESPB_ERR_INVALID_STATE;
+
+    EspbResult result = espb_runtime_init();
+    if (result != ESPB_OK) return result;
+
+    EspbModule *module = NULL;
+    result = espb_parse_partition_module(partition_label, &module);
+    if (result != ESPB_OK) return result;
+
+    result = espb_new_handle(module, out_handle);
+    espb_module_release(module);
+    return result;
+}
+
+EspbResult espb_create_module_from_partition(const char *partition_label, espb_module_t *out_module) {
+    if (!out_module) return ESPB_ERR_INVALID_STATE;
+    *out_module = NULL;
+
+    EspbResult result = espb_runtime_init();
+    if (result != ESPB_OK) return result;
+
+    EspbModule *module = NULL;
+    result = espb_parse_partition_module(partition_label, &module);
+    if (result != ESPB_OK) return result;
+
+    result = espb_module_make_shared(module);
+    if (result != ESPB_OK) {
+        espb_module_release(module);
+        return result;
+    }
+
+    *out_module = module;
+    return ESPB_OK;
+}
+
+EspbResult espb_create_module(const uint8_t *espb_data, size_t espb_size, espb_module_t *out_module) {
+    if (!out_module) return ESPB_ERR_INVALID_STATE;
+    *out_module = NULL;
+
+    EspbResult result = espb_runtime_init();
+    if (result != ESPB_OK) return result;
+
+    EspbModule *module = NULL;
+    result = espb_parse_module(&module, espb_data, espb_size);
+    if (result != ESPB_OK) return result;
+
+    result = espb_module_make_shared(module);
+    if (result != ESPB_OK) {
+        espb_module_release(module);
+        return result;
+    }
+
+    *out_module = module;
+    return ESPB_OK;
+}
+
+EspbResult espb_loader_finish(espb_loader_t loader, espb_handle_t *out_handle) {
+    if (!out_handle) {
+        espb_loader_abort(loader);
+        return ESPB_ERR_INVALID_STATE;
+    }
+
+    EspbResult result = espb_runtime_init();
+    if (result != ESPB_OK) {
+        espb_loader_abort(loader);
+        return result;
+    }
+
+    EspbModule *module = NULL;
+    result = espb_loader_take_module(loader, &module);
+    if (result != ESPB_OK) return result;
+
+    result = espb_new_handle(module, out_handle);
+    espb_module_release(module);
+    return result;
+}
+
+EspbResult espb_loader_finish_module(espb_loader_t loader, espb_module_t *out_module) {
+    if (!out_module) {
+        espb_loader_abort(loader);
+        return ESPB_ERR_INVALID_STATE;
+    }
+    *out_module = NULL;
+
+    EspbResult result = espb_runtime_init();
+    if (result != ESPB_OK) {
+        espb_loader_abort(loader);
+        return result;
+    }
+
+    EspbModule *module = NULL;
+    result = espb_loader_take_module(loader, &module);
+    if (result != ESPB_OK) return result;
+
+    result = espb_module_make_shared(module);
+    if (result != ESPB_OK) {
+        espb_module_release(module);
+        return result;
+    }
+
+    *out_module = module;
+    return ESPB_OK;
+}
+
+EspbResult espb_instantiate_module(espb_module_t module, espb_handle_t *out_handle) {
+    if (!module || !module->shared || !out_handle) return ESPB_ERR_INVALID_STATE;
+    return espb_new_handle(module, out_handle);
+}
+
+void espb_release_module(espb_module_t module) {
+    espb_module_release(module);
+}
+
 void espb_unload_module(espb_handle_t handle) {
     if (handle) {
         printf("--- ESPB Unloading Module ---\n");
         espb_free_instance(handle->instance);
-        // espb_free_module вызывается внутри espb_free_instance
+        // Модуль освобождается внутри espb_free_instance вместе с последним экземпляром
         free(handle);
         printf("--- ESPB Module Unloaded ---\n");
     }
 }
 
+EspbResult espb_reload_module(espb_handle_t handle, const uint8_t *espb_data, size_t espb_size,
+                              espb_handle_t *out_handle) {
+    if (!handle || !out_handle) return ESPB_ERR_INVALID_STATE;
 
-__attribute__((noinline, optimize("O0")))
-EspbResult espb_call_function_sync(espb_handle_t handle, const char* function_name, const Value *args, uint32_t num_args, Value *results) {
+    espb_handle_t new_handle = NULL;
+    EspbResult result = espb_load_module(espb_data, espb_size, &new_handle);
+    if (result != ESPB_OK) return result;
+#if CONFIG_ESPB_JIT_RELOAD
+    // Нехватка исполняемой памяти не мешает замене: не перенесённое компилируется при вызове
+    espb_jit_reload_carry(handle->instance, new_handle->instance, NULL);
+#endif
+    espb_unload_module(handle);
+    *out_handle = new_handle;
+    return ESPB_OK;
+}
+
+
+EspbResult espb_get_function(espb_handle_t handle, const char* function_name, espb_func_t *out_func) {
+    if (!handle || !out_func) return ESPB_ERR_INVALID_STATE;
+    *out_func = ESPB_INVALID_FUNC;
+
+    uint32_t export_idx;
+    if (!espb_find_export(handle->module, function_name, ESPB_IMPORT_KIND_FUNC, &export_idx)) {
+        return ESPB_ERR_INVALID_FUNC_INDEX;
+    }
+
+    *out_func = handle->module->exports[export_idx].index + handle->module->num_imported_funcs;
+    return ESPB_OK;
+}
+
+EspbResult espb_create_exec_ctx(espb_exec_ctx_t *out_ctx) {
+    if (!out_ctx) return ESPB_ERR_INVALID_STATE;
+    *out_ctx = init_execution_context();
+    return *out_ctx ? ESPB_OK : ESPB_ERR_MEMORY_ALLOC;
+}
+
+void espb_destroy_exec_ctx(espb_exec_ctx_t ctx) {
+    free_execution_context(ctx);
+}
+
+EspbResult espb_call_function_with_ctx(espb_handle_t handle, espb_exec_ctx_t ctx, espb_func_t func, const Value *args, uint32_t num_args, Value *results) {
+    (void)num_args;
+    if (!handle || !ctx) return ESPB_ERR_INVALID_STATE;
+    if (func == ESPB_INVALID_FUNC) return ESPB_ERR_INVALID_FUNC_INDEX;
+
+    reset_execution_context(ctx, handle->instance);
+    EspbResult result = espb_execute_function(handle->instance, ctx, func, args, results);
+    // Ловушка могла оставить кадры с ALLOCA - освобождаем сразу, а не при следующем вызове
+    if (result != ESPB_OK) {
+        reset_execution_context(ctx, handle->instance);
+    }
+    return result;
+}
+
+void espb_release_task_exec_ctx(void) {
+    free_task_execution_context();
+}
+
+EspbResult espb_profile_snapshot(espb_handle_t handle, uint64_t *opcode_counts, espb_func_profile_t *funcs, uint32_t max_funcs, uint32_t *out_num_funcs) {
     if (!handle) return ESPB_ERR_INVALID_STATE;
+    const EspbProfile *prof = handle->instance->profile;
+    if (!prof) return ESPB_ERR_UNSUPPORTED;
 
-    // Поиск функции
-    uint32_t func_idx_to_call = 0;
-    bool found_func = false;
-    for (uint32_t i = 0; i < handle->module->num_exports; ++i) {
-        if (handle->module->exports[i].kind == ESPB_IMPORT_KIND_FUNC &&
-            strcmp(handle->module->exports[i].name, function_name) == 0) {
-            uint32_t num_func_imports = 0;
-            for (uint32_t j = 0; j < handle->module->num_imports; ++j) {
-                if (handle->module->imports[j].kind == ESPB_IMPORT_KIND_FUNC) num_func_imports++;
-            }
-            func_idx_to_call = handle->module->exports[i].index + num_func_imports;
-            found_func = true;
-            break;
+    if (opcode_counts) {
+        memcpy(opcode_counts, prof->opcode_counts, sizeof(prof->opcode_counts));
+    }
+    uint32_t n = prof->num_functions < max_funcs ? prof->num_functions : max_funcs;
+    for (uint32_t i = 0; funcs && i < n; i++) {
+        funcs[i].func = i + handle->module->num_imported_funcs;
+        funcs[i].calls = prof->funcs[i].calls;
+        funcs[i].inclusive_cycles = prof->funcs[i].inclusive_cycles;
+        funcs[i].exclusive_cycles = prof->funcs[i].exclusive_cycles;
+    }
+    if (out_num_funcs) *out_num_funcs = prof->num_functions;
+    return ESPB_OK;
+}
+
+EspbResult espb_profile_reset(espb_handle_t handle) {
+    if (!handle) return ESPB_ERR_INVALID_STATE;
+    if (!handle->instance->profile) return ESPB_ERR_UNSUPPORTED;
+    espb_profile_clear(handle->instance->profile);
+    return ESPB_OK;
+}
+
+EspbResult espb_import_profile_snapshot(espb_handle_t handle, espb_import_stats_t *out, uint32_t max_imports,
+                                        uint32_t *out_num_imports) {
+    if (!handle) return ESPB_ERR_INVALID_STATE;
+    const EspbImportProfile *prof = handle->instance->import_profile;
+    if (!prof) return ESPB_ERR_UNSUPPORTED;
+
+    uint32_t n = prof->num_imports < max_imports ? prof->num_imports : max_imports;
+    for (uint32_t i = 0; out && i < n; i++) {
+        const EspbImportStat *st = &prof->imports[i];
+        out[i].import_idx = i;
+        out[i].name = handle->module->imports[i].entity_name;
+        out[i].calls = st->calls;
+        out[i].max_cycles = st->max_cycles;
+        out[i].total_cycles = st->total_cycles;
+        out[i].marshal_cycles = st->marshal_cycles;
+        out[i].native_cycles = st->native_cycles;
+        out[i].copyback_cycles = st->copyback_cycles;
+    }
+    if (out_num_imports) *out_num_imports = prof->num_imports;
+    return ESPB_OK;
+}
+
+EspbResult espb_import_profile_reset(espb_handle_t handle) {
+    if (!handle) return ESPB_ERR_INVALID_STATE;
+    if (!handle->instance->import_profile) return ESPB_ERR_UNSUPPORTED;
+    espb_import_profile_clear(handle->instance->import_profile);
+    return ESPB_OK;
+}
+
+EspbResult espb_jit_stats_snapshot(espb_handle_t handle, espb_jit_stats_t *totals, espb_jit_func_stats_t *funcs,
+                                   uint32_t max_funcs, uint32_t *out_num_funcs) {
+    if (!handle) return ESPB_ERR_INVALID_STATE;
+    const EspbJitStats *stats = handle->instance->jit_stats;
+    if (!stats) return ESPB_ERR_UNSUPPORTED;
+
+    const EspbModule *module = handle->instance->module;
+    espb_jit_stats_t sum = {0};
+    sum.num_functions = stats->num_functions;
+    sum.compile_failures = stats->compile_failures;
+    sum.evictions = stats->evictions;
+    sum.compile_time_us = stats->compile_time_us;
+    for (uint32_t i = 0; i < stats->num_functions; i++) {
+        const EspbFunctionBody *body = &module->function_bodies[i];
+        const EspbJitFuncStats *fs = &stats->funcs[i];
+        bool compiled = body->is_jit_compiled && body->jit_code != NULL;
+        if (body->header.flags & ESPB_FUNC_FLAG_HOT) sum.num_hot++;
+        if (compiled) {
+            sum.num_compiled++;
+            sum.jit_code_bytes += (uint32_t)body->jit_code_size;
+        }
+        sum.exec_count += fs->exec_count;
+        sum.fallbacks += fs->fallbacks;
+        if (funcs && i < max_funcs) {
+            funcs[i].func = i + module->num_imported_funcs;
+            funcs[i].bytecode_size = body->code_size;
+            funcs[i].native_size = compiled ? (uint32_t)body->jit_code_size : 0;
+            funcs[i].compile_time_us = fs->compile_time_us;
+            funcs[i].compiles = fs->compiles;
+            funcs[i].helper_calls = fs->helper_calls;
+            funcs[i].abs_helper_calls = fs->abs_helper_calls;
+            funcs[i].spills = fs->spills;
+            funcs[i].fallbacks = fs->fallbacks;
+            funcs[i].exec_count = fs->exec_count;
+            funcs[i].jit_reject = body->jit_reject;
         }
     }
+    if (totals) {
+        sum.iram_free = (uint32_t)heap_caps_get_free_size(MALLOC_CAP_EXEC);
+        sum.iram_largest_block = (uint32_t)heap_caps_get_largest_free_block(MALLOC_CAP_EXEC);
+        *totals = sum;
+    }
+    if (out_num_funcs) *out_num_funcs = stats->num_functions;
+    return ESPB_OK;
+}
 
-    if (!found_func) return ESPB_ERR_INVALID_FUNC_INDEX;
+EspbResult espb_jit_stats_reset(espb_handle_t handle) {
+    if (!handle) return ESPB_ERR_INVALID_STATE;
+    if (!handle->instance->jit_stats) return ESPB_ERR_UNSUPPORTED;
+    espb_jit_stats_clear(handle->instance->jit_stats);
+    return ESPB_OK;
+}
 
-    ExecutionContext *exec_ctx = init_execution_context();
+EspbResult espb_jit_get_reject_reason(espb_handle_t handle, espb_func_t func, uint8_t *out_reason) {
+    if (!handle || !out_reason) return ESPB_ERR_INVALID_STATE;
+#if CONFIG_ESPB_JIT_ENABLED
+    const EspbModule *module = handle->instance->module;
+    if (func < module->num_imported_funcs || func - module->num_imported_funcs >= module->num_functions) {
+        return ESPB_ERR_INVALID_FUNC_INDEX;
+    }
+    *out_reason = module->function_bodies[func - module->num_imported_funcs].jit_reject;
+    return ESPB_OK;
+#else
+    (void)func;
+    return ESPB_ERR_UNSUPPORTED;
+#endif
+}
+
+EspbResult espb_sampler_start(espb_handle_t handle, TaskHandle_t task, uint32_t period_us) {
+    if (!handle) return ESPB_ERR_INVALID_STATE;
+#if CONFIG_ESPB_SAMPLER
+    return espb_sampler_start_instance(handle->instance, task, period_us);
+#else
+    (void)task;
+    (void)period_us;
+    return ESPB_ERR_UNSUPPORTED;
+#endif
+}
+
+EspbResult espb_sampler_stop(espb_handle_t handle) {
+    if (!handle) return ESPB_ERR_INVALID_STATE;
+#if CONFIG_ESPB_SAMPLER
+    return espb_sampler_stop_instance(handle->instance);
+#else
+    return ESPB_ERR_UNSUPPORTED;
+#endif
+}
+
+EspbResult espb_sampler_snapshot(espb_handle_t handle, espb_sampler_totals_t *totals, espb_sample_func_t *funcs,
+                                 uint32_t max_funcs, uint32_t *out_num_funcs) {
+    if (!handle) return ESPB_ERR_INVALID_STATE;
+#if CONFIG_ESPB_SAMPLER
+    if (!handle->instance->sampler) return ESPB_ERR_INVALID_STATE;
+    return espb_sampler_read_totals(handle->instance->sampler, totals, funcs, max_funcs, out_num_funcs);
+#else
+    (void)totals; (void)funcs; (void)max_funcs; (void)out_num_funcs;
+    return ESPB_ERR_UNSUPPORTED;
+#endif
+}
+
+EspbResult espb_sampler_offsets(espb_handle_t handle, espb_sample_offset_t *out, uint32_t max_entries,
+                                uint32_t *out_num_entries) {
+    if (!handle) return ESPB_ERR_INVALID_STATE;
+#if CONFIG_ESPB_SAMPLER
+    if (!handle->instance->sampler) return ESPB_ERR_INVALID_STATE;
+    return espb_sampler_read_offsets(handle->instance->sampler, out, max_entries, out_num_entries);
+#else
+    (void)out; (void)max_entries; (void)out_num_entries;
+    return ESPB_ERR_UNSUPPORTED;
+#endif
+}
+
+EspbResult espb_sampler_write_folded(espb_handle_t handle, espb_sampler_write_t write, void *user_data) {
+    if (!handle || !write) return ESPB_ERR_INVALID_STATE;
+#if CONFIG_ESPB_SAMPLER
+    if (!handle->instance->sampler) return ESPB_ERR_INVALID_STATE;
+    return espb_sampler_write_folded_stacks(handle->instance->sampler, write, user_data);
+#else
+    (void)user_data;
+    return ESPB_ERR_UNSUPPORTED;
+#endif
+}
+
+EspbResult espb_sampler_reset(espb_handle_t handle) {
+    if (!handle) return ESPB_ERR_INVALID_STATE;
+#if CONFIG_ESPB_SAMPLER
+    if (!handle->instance->sampler) return ESPB_ERR_INVALID_STATE;
+    espb_sampler_clear(handle->instance->sampler);
+    return ESPB_OK;
+#else
+    return ESPB_ERR_UNSUPPORTED;
+#endif
+}
+
+bool espb_jit_code_lookup(uintptr_t pc, espb_jit_code_info_t *out) {
+#if CONFIG_ESPB_JIT_CODE_MAP
+    return espb_jit_code_map_lookup(pc, out);
+#else
+    (void)pc;
+    (void)out;
+    return false;
+#endif
+}
+
+EspbResult espb_jit_code_map_write(espb_sampler_write_t write, void *user_data, bool with_offsets) {
+    if (!write) return ESPB_ERR_INVALID_OPERAND;
+#if CONFIG_ESPB_JIT_CODE_MAP
+    espb_jit_code_map_write_all(write, user_data, with_offsets);
+    return ESPB_OK;
+#else
+    (void)user_data;
+    (void)with_offsets;
+    return ESPB_ERR_UNSUPPORTED;
+#endif
+}
+
+EspbResult espb_get_memory_stats(espb_handle_t handle, espb_memory_stats_t *stats) {
+    if (!handle) return ESPB_ERR_INVALID_STATE;
+    if (!stats) return ESPB_ERR_INVALID_OPERAND;
+    EspbInstance *instance = handle->instance;
+
+    size_t usage[ESPB_MEM_NUM_KINDS];
+    espb_memory_usage(instance, usage);
+    for (int k = 0; k < ESPB_MEM_NUM_KINDS; k++) {
+        if (usage[k] > instance->mem_peak[k]) instance->mem_peak[k] = usage[k];
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    stats->internal.current = usage[ESPB_MEM_INTERNAL];
+    stats->internal.peak = instance->mem_peak[ESPB_MEM_INTERNAL];
+    stats->psram.current = usage[ESPB_MEM_PSRAM];
+    stats->psram.peak = instance->mem_peak[ESPB_MEM_PSRAM];
+    stats->exec.current = usage[ESPB_MEM_EXEC];
+    stats->exec.peak = instance->mem_peak[ESPB_MEM_EXEC];
+    espb_memory_heap_usage(instance, &stats->heap_used, &stats->heap_free, &stats->heap_peak);
+    stats->shadow_stack_peak = instance->shadow_stack_peak;
+    if (!espb_callback_get_iram_pool_stats(&stats->iram_pool_total, &stats->iram_pool_used, NULL)) {
+        stats->iram_pool_total = 0;
+        stats->iram_pool_used = 0;
+    }
+    return ESPB_OK;
+}
+
+EspbResult espb_set_fuel(espb_handle_t handle, uint32_t slice) {
+    if (!handle) return ESPB_ERR_INVALID_STATE;
+#if CONFIG_ESPB_FUEL
+    if (slice == 0 || slice > INT32_MAX) return ESPB_ERR_INVALID_OPERAND;
+    handle->instance->fuel_slice = (int32_t)slice;
+    handle->instance->fuel = (int32_t)slice;
+    return ESPB_OK;
+#else
+    (void)slice;
+    return ESPB_ERR_UNSUPPORTED;
+#endif
+}
+
+EspbResult espb_set_fuel_handler(espb_handle_t handle, EspbFuelHandler handler, void *user_data) {
+    if (!handle) return ESPB_ERR_INVALID_STATE;
+#if CONFIG_ESPB_FUEL
+    handle->instance->fuel_user_data = user_data;
+    handle->instance->fuel_handler = handler;
+    return ESPB_OK;
+#else
+    (void)handler; (void)user_data;
+    return ESPB_ERR_UNSUPPORTED;
+#endif
+}
+
+EspbResult espb_call(espb_handle_t handle, espb_func_t func, const Value *args, uint32_t num_args, Value *results) {
+    if (!handle) return ESPB_ERR_INVALID_STATE;
+    if (func == ESPB_INVALID_FUNC) return ESPB_ERR_INVALID_FUNC_INDEX;
+
+    ExecutionContext *exec_ctx = acquire_execution_context();
     if (!exec_ctx) {
         return ESPB_ERR_MEMORY_ALLOC;
     }
 
-    EspbResult result = espb_execute_function(handle->instance, exec_ctx, func_idx_to_call, args, results);
+    EspbResult result = espb_call_function_with_ctx(handle, exec_ctx, func, args, num_args, results);
 
-    free_execution_context(exec_ctx);
+    release_execution_context(exec_ctx, handle->instance);
 
     return result;
 }
+
+EspbResult espb_call_function_batch(espb_handle_t handle, espb_func_t func, const Value *args, size_t stride,
+                                    size_t count, Value *results) {
+    if (!handle) return ESPB_ERR_INVALID_STATE;
+    if (func == ESPB_INVALID_FUNC) return ESPB_ERR_INVALID_FUNC_INDEX;
+    if (count == 0) return ESPB_OK;
+
+    ExecutionContext *exec_ctx = acquire_execution_context();
+    if (!exec_ctx) {
+        return ESPB_ERR_MEMORY_ALLOC;
+    }
+
+    reset_execution_context(exec_ctx, handle->instance);
+    EspbResult result = espb_execute_function_batch(handle->instance, exec_ctx, func, args, stride, count, results);
+    if (result != ESPB_OK) {
+        reset_execution_context(exec_ctx, handle->instance);
+    }
+
+    release_execution_context(exec_ctx, handle->instance);
+    return result;
+}
+
+__attribute__((noinline, optimize("O0")))
+EspbResult espb_call_function_sync(espb_handle_t handle, const char* function_name, const Value *args, uint32_t num_args, Value *results) {
+    if (!handle) return ESPB_ERR_INVALID_STATE;
+
+    espb_func_t func;
+    EspbResult result = espb_get_function(handle, function_name, &func);
+    if (result != ESPB_OK) return result;
+
+    return espb_call(handle, func, args, num_args, results);
+}
+
+// --- Асинхронные вызовы: пул исполнителей по ядрам ---
+
+#if CONFIG_ESPB_ASYNC_CALLS
+
+#if CONFIG_FREERTOS_UNICORE
+#define ESPB_ASYNC_CORES 1
+#else
+#define ESPB_ASYNC_CORES portNUM_PROCESSORS
+#endif
+#define ESPB_ASYNC_WORKERS (ESPB_ASYNC_CORES * CONFIG_ESPB_ASYNC_WORKERS_PER_CORE)
+
+typedef struct {
+    espb_handle_t handle;                   // NULL - запрос остановки исполнителя
+    espb_func_t func;
+    uint32_t num_args;
+    Value args[ESPB_ASYNC_MAX_ARGS];
+    espb_async_done_t done;
+    QueueHandle_t result_queue;
+    void *user_data;
+} EspbAsyncJob;
+
+static struct {
+    QueueHandle_t jobs;
+    SemaphoreHandle_t stopped;              // Отдаётся каждым исполнителем перед самоудалением
+    uint32_t num_workers;
+} s_async;
+
+static void espb_async_worker(void *arg) {
+    ExecutionContext *ctx = (ExecutionContext *)arg;
+    EspbAsyncJob job;
+
+    for (;;) {
+        if (xQueueReceive(s_async.jobs, &job, portMAX_DELAY) != pdTRUE) continue;
+        if (!job.handle) break;
+
+        espb_async_result_t res;
+        memset(&res, 0, sizeof(res));
+        res.handle = job.handle;
+        res.func = job.func;
+        res.user_data = job.user_data;
+        res.result = espb_call_function_with_ctx(job.handle, ctx, job.func, job.args, job.num_args, res.results);
+
+        if (job.done) job.done(&res);
+        if (job.result_queue) xQueueSend(job.result_queue, &res, portMAX_DELAY);
+    }
+
+    free_execution_context(ctx);
+    xSemaphoreGive(s_async.stopped);
+    vTaskDelete(NULL);
+}
+
+EspbResult espb_async_start(void) {
+    if (s_async.jobs) return ESPB_OK;
+
+    s_async.jobs = xQueueCreate(CONFIG_ESPB_ASYNC_QUEUE_LENGTH, sizeof(EspbAsyncJob));
+    s_async.stopped = xSemaphoreCreateCounting(ESPB_ASYNC_WORKERS, 0);
+    if (!s_async.jobs || !s_async.stopped) goto fail;
+
+    for (uint32_t core = 0; core < ESPB_ASYNC_CORES; core++) {
+        for (uint32_t i = 0; i < CONFIG_ESPB_ASYNC_WORKERS_PER_CORE; i++) {
+            ExecutionContext *ctx = init_execution_context();
+            if (!ctx) goto fail;
+            if (xTaskCreatePinnedToCore(espb_async_worker, "espb_async", CONFIG_ESPB_ASYNC_TASK_STACK_SIZE, ctx,
+                                        CONFIG_ESPB_ASYNC_TASK_PRIORITY, NULL, (BaseType_t)core) != pdPASS) {
+                free_execution_context(ctx);
+                goto fail;
+            }
+            s_async.num_workers++;
+        }
+    }
+    return ESPB_OK;
+
+fail:
+    if (s_async.jobs && s_async.stopped) {
+        espb_async_stop();
+        return ESPB_ERR_MEMORY_ALLOC;
+    }
+    if (s_async.jobs) vQueueDelete(s_async.jobs);
+    if (s_async.stopped) vSemaphoreDelete(s_async.stopped);
+    s_async.jobs = NULL;
+    s_async.stopped = NULL;
+    return ESPB_ERR_MEMORY_ALLOC;
+}
+
+void espb_async_stop(void) {
+    if (!s_async.jobs) return;
+
+    // Запросы остановки идут в конец очереди: поставленные раньше вызовы исполняются
+    EspbAsyncJob stop;
+    memset(&stop, 0, sizeof(stop));
+    for (uint32_t i = 0; i < s_async.num_workers; i++) {
+        xQueueSend(s_async.jobs, &stop, portMAX_DELAY);
+    }
+    for (uint32_t i = 0; i < s_async.num_workers; i++) {
+        xSemaphoreTake(s_async.stopped, portMAX_DELAY);
+    }
+
+    vQueueDelete(s_async.jobs);
+    vSemaphoreDelete(s_async.stopped);
+    s_async.jobs = NULL;
+    s_async.stopped = NULL;
+    s_async.num_workers = 0;
+}
+
+EspbResult espb_call_function_async(espb_handle_t handle, espb_func_t func, const Value *args, uint32_t num_args,
+                                    espb_async_done_t done, QueueHandle_t result_queue, void *user_data) {
+    if (!handle) return ESPB_ERR_INVALID_STATE;
+    if (!s_async.jobs) return ESPB_ERR_INVALID_STATE;
+
+    const EspbModule *module = handle->module;
+    if (func < module->num_imported_funcs || func >= module->num_imported_funcs + module->num_functions) {
+        return ESPB_ERR_INVALID_FUNC_INDEX;
+    }
+    // Результаты пишутся в espb_async_result_t, поэтому их число проверяется заранее
+    uint32_t local_idx = func - module->num_imported_funcs;
+    const EspbFuncSignature *sig = &module->signatures[module->function_signature_indices[local_idx]];
+    if (num_args > ESPB_ASYNC_MAX_ARGS || sig->num_params > num_args || sig->num_returns > ESPB_ASYNC_MAX_RESULTS ||
+        (num_args > 0 && !args)) {
+        return ESPB_ERR_INVALID_OPERAND;
+    }
+
+    EspbAsyncJob job;
+    job.handle = handle;
+    job.func = func;
+    job.num_args = num_args;
+    if (num_args > 0) memcpy(job.args, args, num_args * sizeof(Value));
+    job.done = done;
+    job.result_queue = result_queue;
+    job.user_data = user_data;
+
+    return xQueueSend(s_async.jobs, &job, 0) == pdTRUE ? ESPB_OK : ESPB_ERR_QUEUE_FULL;
+}
+
+#else
+
+EspbResult espb_async_start(void) {
+    return ESPB_ERR_UNSUPPORTED;
+}
+
+void espb_async_stop(void) {
+}
+
+EspbResult espb_call_function_async(espb_handle_t handle, espb_func_t func, const Value *args, uint32_t num_args,
+                                    espb_async_done_t done, QueueHandle_t result_queue, void *user_data) {
+    (void)handle; (void)func; (void)args; (void)num_args; (void)done; (void)result_queue; (void)user_data;
+    return ESPB_ERR_UNSUPPORTED;
+}
+
+#endif // CONFIG_ESPB_ASYNC_CALLS
@@ -0,0 +1,326 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "espb_bulk_memory.h"
+#include "espb_interpreter_threaded.h" // espb_instruction_length
+
+#include <string.h>
+
+#if CONFIG_ESPB_BULK_MEMORY_DMA
+#include "esp_log.h"
+#include "esp_async_memcpy.h"
+#include "esp_memory_utils.h"
+#include "esp_attr.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "espb_bulk";
+#endif
+
+#define BULK_MIN_WORDS      32      // Короче - memmove/memset: разгон словного цикла не окупается
+#define BULK_PIE_MIN        80      // Блок 64 байта + выравнивание до 16
+
+// Слово, которому разрешено алиасить байтовые буферы
+typedef uint32_t __attribute__((may_alias)) bulk_word_t;
+
+#if CONFIG_ESPB_BULK_MEMORY_PIE && CONFIG_IDF_TARGET_ESP32P4
+// ESP32-P4: те же ядра на Xesppie, счётчик блоков - аппаратный цикл esp.lp.setup
+// (тело - до метки 2 включительно, без addi/bnez на итерацию).
+static inline void bulk_pie_copy64(uint8_t *d, const uint8_t *s, size_t blocks) {
+    __asm__ volatile(
+        "esp.lp.setup 0, %[n], 2f\n"
+        "esp.vld.128.ip q0, %[s], 16\n"
+        "esp.vld.128.ip q1, %[s], 16\n"
+        "esp.vld.128.ip q2, %[s], 16\n"
+        "esp.vld.128.ip q3, %[s], 16\n"
+        "esp.vst.128.ip q0, %[d], 16\n"
+        "esp.vst.128.ip q1, %[d], 16\n"
+        "esp.vst.128.ip q2, %[d], 16\n"
+        "2: esp.vst.128.ip q3, %[d], 16\n"
+        : [d] "+r"(d), [s] "+r"(s)
+        : [n] "r"(blocks)
+        : "memory");
+}
+
+static inline void bulk_pie_fill64(uint8_t *d, const uint32_t *pattern, size_t blocks) {
+    __asm__ volatile(
+        "esp.vldbc.32.ip q0, %[p], 0\n"
+        "esp.lp.setup 0, %[n], 2f\n"
+        "esp.vst.128.ip q0, %[d], 16\n"
+        "esp.vst.128.ip q0, %[d], 16\n"
+        "esp.vst.128.ip q0, %[d], 16\n"
+        "2: esp.vst.128.ip q0, %[d], 16\n"
+        : [d] "+r"(d), [p] "+r"(pattern)
+        : [n] "r"(blocks)
+        : "memory");
+}
+#elif CONFIG_ESPB_BULK_MEMORY_PIE
+// blocks > 0 блоков по 64 байта; d и s выровнены на 16 (младшие биты адреса PIE игнорирует).
+static inline void bulk_pie_copy64(uint8_t *d, const uint8_t *s, size_t blocks) {
+    __asm__ volatile(
+        "1:\n"
+        "ee.vld.128.ip q0, %[s], 16\n"
+        "ee.vld.128.ip q1, %[s], 16\n"
+        "ee.vld.128.ip q2, %[s], 16\n"
+        "ee.vld.128.ip q3, %[s], 16\n"
+        "ee.vst.128.ip q0, %[d], 16\n"
+        "ee.vst.128.ip q1, %[d], 16\n"
+        "ee.vst.128.ip q2, %[d], 16\n"
+        "ee.vst.128.ip q3, %[d], 16\n"
+        "addi %[n], %[n], -1\n"
+        "bnez %[n], 1b\n"
+        : [d] "+r"(d), [s] "+r"(s), [n] "+r"(blocks)
+        :
+        : "memory");
+}
+
+static inline void bulk_pie_fill64(uint8_t *d, const uint32_t *pattern, size_t blocks) {
+    __asm__ volatile(
+        "ee.vldbc.32 q0, %[p]\n"
+        "1:\n"
+        "ee.vst.128.ip q0, %[d], 16\n"
+        "ee.vst.128.ip q0, %[d], 16\n"
+        "ee.vst.128.ip q0, %[d], 16\n"
+        "ee.vst.128.ip q0, %[d], 16\n"
+        "addi %[n], %[n], -1\n"
+        "bnez %[n], 1b\n"
+        : [d] "+r"(d), [n] "+r"(blocks)
+        : [p] "r"(pattern)
+        : "memory");
+}
+#endif
+
+#if CONFIG_ESPB_BULK_MEMORY_DMA
+enum { BULK_DMA_UNINIT = 0, BULK_DMA_INSTALLING, BULK_DMA_READY, BULK_DMA_FAILED };
+
+static struct {
+    uint32_t state;
+    async_memcpy_handle_t handle;
+    SemaphoreHandle_t lock;     // Одна DMA-копия за раз; занято - копирует процессор
+    SemaphoreHandle_t done;
+} s_dma;
+
+static IRAM_ATTR bool bulk_dma_done_cb(async_memcpy_handle_t handle, async_memcpy_event_t *event, void *arg) {
+    (void)handle;
+    (void)event;
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR((SemaphoreHandle_t)arg, &woken);
+    return woken == pdTRUE;
+}
+
+// Драйвер ставится при первой большой копии; проигравшие гонку копируют процессором.
+static __attribute__((noinline, cold)) bool bulk_dma_install(void) {
+    uint32_t expected = BULK_DMA_UNINIT;
+    if (!__atomic_compare_exchange_n(&s_dma.state, &expected, BULK_DMA_INSTALLING, false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return false;
+    }
+    async_memcpy_config_t cfg = ASYNC_MEMCPY_DEFAULT_CONFIG();
+    s_dma.lock = xSemaphoreCreateMutex();
+    s_dma.done = xSemaphoreCreateBinary();
+    if (!s_dma.lock || !s_dma.done || esp_async_memcpy_install(&cfg, &s_dma.handle) != ESP_OK) {
+        ESP_LOGW(TAG, "Async memcpy unavailable, MEMORY.COPY stays on CPU");
+        if (s_dma.lock) vSemaphoreDelete(s_dma.lock);
+        if (s_dma.done) vSemaphoreDelete(s_dma.done);
+        s_dma.lock = NULL;
+        s_dma.done = NULL;
+        __atomic_store_n(&s_dma.state, BULK_DMA_FAILED, __ATOMIC_RELEASE);
+        return false;
+    }
+    __atomic_store_n(&s_dma.state, BULK_DMA_READY, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Синхронная копия через GDMA; false - копировать процессором.
+static bool bulk_dma_copy(uint8_t *d, const uint8_t *s, size_t n) {
+    if ((((uintptr_t)d | (uintptr_t)s | n) & 3u) != 0) return false;
+    if (!esp_ptr_dma_capable(d) || !esp_ptr_dma_capable(s) || xPortInIsrContext()) return false;
+    uint32_t state = __atomic_load_n(&s_dma.state, __ATOMIC_ACQUIRE);
+    if (state != BULK_DMA_READY && !(state == BULK_DMA_UNINIT && bulk_dma_install())) return false;
+    if (xSemaphoreTake(s_dma.lock, 0) != pdTRUE) return false;
+    bool ok = esp_async_memcpy(s_dma.handle, d, (void *)s, n, bulk_dma_done_cb, s_dma.done) == ESP_OK;
+    if (ok) xSemaphoreTake(s_dma.done, portMAX_DELAY);
+    xSemaphoreGive(s_dma.lock);
+    return ok;
+}
+#endif
+
+// Прямое копирование; допустимо и перекрытие с d < s: каждый блок сперва читается целиком.
+static void bulk_copy_forward(uint8_t *d, const uint8_t *s, size_t n) {
+    while ((uintptr_t)d & 3u) {
+        *d++ = *s++;
+        n--;
+    }
+#if CONFIG_ESPB_BULK_MEMORY_PIE
+    if (n >= BULK_PIE_MIN && (((uintptr_t)d ^ (uintptr_t)s) & 15u) == 0) {
+        while ((uintptr_t)d & 15u) {
+            *(bulk_word_t *)d = *(const bulk_word_t *)s;
+            d += 4;
+            s += 4;
+            n -= 4;
+        }
+        const size_t bytes = n & ~(size_t)63u;
+        bulk_pie_copy64(d, s, bytes / 64);
+        d += bytes;
+        s += bytes;
+        n -= bytes;
+    }
+#endif
+    bulk_word_t *dw = (bulk_word_t *)d;
+    const bulk_word_t *sw = (const bulk_word_t *)s;
+    for (; n >= 16; n -= 16, dw += 4, sw += 4) {
+        uint32_t w0 = sw[0], w1 = sw[1], w2 = sw[2], w3 = sw[3];
+        dw[0] = w0; dw[1] = w1; dw[2] = w2; dw[3] = w3;
+    }
+    for (; n >= 4; n -= 4) *dw++ = *sw++;
+    d = (uint8_t *)dw;
+    s = (const uint8_t *)sw;
+    while (n--) *d++ = *s++;
+}
+
+// Обратное копирование для перекрытия с d > s.
+static void bulk_copy_backward(uint8_t *d, const uint8_t *s, size_t n) {
+    d += n;
+    s += n;
+    while ((uintptr_t)d & 3u) {
+        *--d = *--s;
+        n--;
+    }
+    bulk_word_t *dw = (bulk_word_t *)d;
+    const bulk_word_t *sw = (const bulk_word_t *)s;
+    for (; n >= 16; n -= 16) {
+        dw -= 4;
+        sw -= 4;
+        uint32_t w0 = sw[0], w1 = sw[1], w2 = sw[2], w3 = sw[3];
+        dw[0] = w0; dw[1] = w1; dw[2] = w2; dw[3] = w3;
+    }
+    for (; n >= 4; n -= 4) *--dw = *--sw;
+    d = (uint8_t *)dw;
+    s = (const uint8_t *)sw;
+    while (n--) *--d = *--s;
+}
+
+void *espb_memory_copy(void *dst, const void *src, size_t n) {
+    uint8_t *d = (uint8_t *)dst;
+    const uint8_t *s = (const uint8_t *)src;
+    if (d == s || n == 0) return dst;
+    if (n < BULK_MIN_WORDS || (((uintptr_t)d ^ (uintptr_t)s) & 3u) != 0) {
+        return memmove(dst, src, n);
+    }
+    if (d > s && d < s + n) {
+        bulk_copy_backward(d, s, n);
+        return dst;
+    }
+#if CONFIG_ESPB_BULK_MEMORY_DMA
+    if (n >= CONFIG_ESPB_BULK_MEMORY_DMA_THRESHOLD && (s + n <= d || d + n <= s) && bulk_dma_copy(d, s, n)) {
+        return dst;
+    }
+#endif
+    bulk_copy_forward(d, s, n);
+    return dst;
+}
+
+void *espb_memory_fill(void *dst, int val, size_t n) {
+    uint8_t *d = (uint8_t *)dst;
+    const uint8_t b = (uint8_t)val;
+    if (n < BULK_MIN_WORDS) return memset(dst, val, n);
+
+    while ((uintptr_t)d & 3u) {
+        *d++ = b;
+        n--;
+    }
+    const uint32_t pattern = 0x01010101u * b;
+#if CONFIG_ESPB_BULK_MEMORY_PIE
+    if (n >= BULK_PIE_MIN) {
+        while ((uintptr_t)d & 15u) {
+            *(bulk_word_t *)d = pattern;
+            d += 4;
+            n -= 4;
+        }
+        const size_t bytes = n & ~(size_t)63u;
+        bulk_pie_fill64(d, &pattern, bytes / 64);
+        d += bytes;
+        n -= bytes;
+    }
+#endif
+    bulk_word_t *dw = (bulk_word_t *)d;
+    for (; n >= 16; n -= 16, dw += 4) {
+        dw[0] = pattern; dw[1] = pattern; dw[2] = pattern; dw[3] = pattern;
+    }
+    for (; n >= 4; n -= 4) *dw++ = pattern;
+    d = (uint8_t *)dw;
+    while (n--) *d++ = b;
+    return dst;
+}
+
+// Длина инструкции так же, как в кодогенераторах JIT (LDC.I16.IMM 0x16 нет в таблице интерпретатора).
+static size_t bulk_insn_length(const uint8_t *insn, const uint8_t *end) {
+    return (insn[0] == 0x16) ? ((end - insn) >= 4 ? 4 : 0) : espb_instruction_length(insn, end);
+}
+
+bool espb_bulk_const_size(const uint8_t *code, uint32_t code_size, uint32_t insn_off,
+                          uint8_t rn, uint32_t *out_size) {
+    if (!code || insn_off >= code_size) return false;
+    const uint8_t *end = code + code_size;
+
+    // Последняя не-NOP инструкция перед insn_off должна быть LDC.I32 rn, imm
+    uint32_t ldc_off = UINT32_MAX;
+    uint32_t off = 0;
+    while (off < insn_off) {
+        size_t len = bulk_insn_length(code + off, end);
+        if (len == 0) return false;
+        const uint8_t op = code[off];
+        if (op != 0x00 && op != 0x01) {
+            ldc_off = (op == 0x18 && code[off + 1] == rn) ? off : UINT32_MAX;
+        }
+        off += (uint32_t)len;
+    }
+    if (off != insn_off || ldc_off == UINT32_MAX) return false;
+
+    // Переход внутрь (ldc_off, insn_off] приносит неизвестный rn
+    for (off = 0; off < code_size; ) {
+        const uint8_t *insn = code + off;
+        size_t len = bulk_insn_length(insn, end);
+        if (len == 0) return false;
+        uint32_t num_targets = 0;
+        int64_t base = off;
+        const uint8_t *rel_at = NULL;
+        if (insn[0] == 0x02) {
+            num_targets = 1;
+            rel_at = insn + 1;
+        } else if (insn[0] == 0x03) {
+            num_targets = 1;
+            rel_at = insn + 2;
+        } else if (insn[0] == 0x04) {
+            uint16_t n;
+            memcpy(&n, insn + 2, sizeof(n));
+            num_targets = (uint32_t)n + 1;  // + default
+            base = (int64_t)off + (int64_t)len;
+            rel_at = insn + 4;
+        }
+        for (uint32_t i = 0; i < num_targets; ++i) {
+            int16_t rel;
+            memcpy(&rel, rel_at + i * 2, sizeof(rel));
+            const int64_t t = base + rel;
+            if (t > (int64_t)ldc_off && t <= (int64_t)insn_off) return false;
+        }
+        off += (uint32_t)len;
+    }
+
+    memcpy(out_size, code + ldc_off + 2, sizeof(*out_size));
+    return true;
+}
@@ -0,0 +1,683 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "espb_bytecode_opt.h"
+
+#if CONFIG_ESPB_BYTECODE_OPT
+
+#include "espb_interpreter_threaded.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "esp_log.h"
+
+static const char *TAG = "espb_bcopt";
+
+#define OPT_MAX_ROUNDS      4       // Повторы проходов до неподвижной точки
+#define OPT_MAX_BR_CHAIN    8       // Звеньев BR -> BR при протягивании перехода
+#define OPT_NO_COPY         0xFF    // copy_of[r]: r не является копией (регистр 255 не адресуется)
+
+// Формат регистровых операндов; смещения - от байта опкода.
+enum {
+    OPT_FMT_BARRIER = 0,    // Вызовы, 0xFC, атомики, ALLOCA: читают и портят любые регистры
+    OPT_FMT_NONE,           // NOP
+    OPT_FMT_BR,             // BR offset(i16) от начала инструкции
+    OPT_FMT_BR_IF,          // BR_IF Rcond@1, offset(i16) от начала инструкции
+    OPT_FMT_BR_TABLE,       // BR_TABLE Ridx@1, n(u16), targets(i16)[n], default(i16) от конца инструкции
+    OPT_FMT_END,            // END: возвращает R0
+    OPT_FMT_TRAP,           // UNREACHABLE
+    OPT_FMT_D,              // Rd@1, imm
+    OPT_FMT_DS,             // Rd@1, Rs@2 [, imm8 / offset(i16)]
+    OPT_FMT_DSS,            // Rd@1, R1@2, R2@3
+    OPT_FMT_SELECT,         // Rd@1, Rcond@2, Rtrue@3, Rfalse@4
+    OPT_FMT_SS,             // STORE Rs@1, Ra@2, offset(i16)
+    OPT_FMT_S3,             // ST_GLOBAL global_idx(u16), Rs@3
+    OPT_FMT_ADDR_OF,        // ADDR_OF: регистры адресуемы, функцию не трогаем
+};
+
+static const uint8_t s_opt_fmt[256] = {
+    [0x00 ... 0x01] = OPT_FMT_NONE,
+    [0x02] = OPT_FMT_BR,
+    [0x03] = OPT_FMT_BR_IF,
+    [0x04] = OPT_FMT_BR_TABLE,
+    [0x05] = OPT_FMT_TRAP,
+    [0x0F] = OPT_FMT_END,
+    [0x10 ... 0x13] = OPT_FMT_DS,       // MOV.*
+    [0x18 ... 0x1E] = OPT_FMT_D,        // LDC.*, LD_GLOBAL_ADDR, LD_GLOBAL
+    [0x1F] = OPT_FMT_S3,                // ST_GLOBAL
+    [0x20 ... 0x2D] = OPT_FMT_DSS,
+    [0x2E] = OPT_FMT_DS,
+    [0x30 ... 0x3D] = OPT_FMT_DSS,
+    [0x3E] = OPT_FMT_DS,
+    [0x40 ... 0x4B] = OPT_FMT_DS,       // *.I32.IMM8
+    [0x50 ... 0x58] = OPT_FMT_DS,       // *.I64.IMM8
+    [0x60 ... 0x65] = OPT_FMT_DSS,
+    [0x66 ... 0x67] = OPT_FMT_DS,
+    [0x68 ... 0x6D] = OPT_FMT_DSS,
+    [0x6E ... 0x6F] = OPT_FMT_DS,
+    [0x70 ... 0x7B] = OPT_FMT_SS,       // STORE.*
+    [0x80 ... 0x89] = OPT_FMT_DS,       // LOAD.*
+    [0x8E] = OPT_FMT_ADDR_OF,
+    [0x90 ... 0xBD] = OPT_FMT_DS,       // преобразования
+    [0xBE ... 0xBF] = OPT_FMT_SELECT,
+    [0xC0 ... 0xD3] = OPT_FMT_DSS,      // сравнения
+    [0xD4 ... 0xD6] = OPT_FMT_SELECT,
+    [0xE0 ... 0xEB] = OPT_FMT_DSS,      // сравнения
+};
+
+#define OPT_PURE    0x01    // Без побочных эффектов и ловушек: удаляется, если записанное не читается
+#define OPT_USE32   0x02    // Читает только младшие 32 бита регистров-источников
+#define OPT_KILL64  0x04    // Перезаписывает Value целиком; иначе - только младшие 32 бита
+#define OPT_COPY    0x08    // Rd = Rs побитово
+
+static const uint8_t s_opt_flags[256] = {
+    [0x03 ... 0x04] = OPT_USE32,                        // BR_IF / BR_TABLE
+    [0x10] = OPT_PURE | OPT_USE32,                      // MOV.I8
+    [0x11] = 0,                                         // MOV.I16: побитовый у интерпретатора, но не у JIT
+    [0x12 ... 0x13] = OPT_PURE | OPT_KILL64 | OPT_COPY, // MOV.I32 / MOV.I64
+    [0x18] = OPT_PURE,
+    [0x19] = OPT_PURE | OPT_KILL64,
+    [0x1A] = OPT_PURE,
+    [0x1B] = OPT_PURE | OPT_KILL64,                     // LDC.PTR (0x1C) проверяет границы - не PURE
+    [0x20 ... 0x21] = OPT_PURE | OPT_USE32,
+    [0x22 ... 0x27] = OPT_USE32,                        // MUL (переполнение), DIV/REM - ловушки
+    [0x28 ... 0x2E] = OPT_PURE | OPT_USE32,
+    [0x30 ... 0x32] = OPT_PURE | OPT_KILL64,
+    [0x33 ... 0x37] = OPT_KILL64,
+    [0x38 ... 0x3E] = OPT_PURE | OPT_KILL64,
+    [0x40 ... 0x41] = OPT_PURE | OPT_USE32,
+    [0x42 ... 0x46] = OPT_USE32,
+    [0x47 ... 0x4B] = OPT_PURE | OPT_USE32,
+    [0x50 ... 0x52] = OPT_PURE | OPT_KILL64,
+    [0x53 ... 0x56] = OPT_KILL64,
+    [0x58] = OPT_PURE | OPT_KILL64,
+    [0x60 ... 0x67] = OPT_PURE | OPT_USE32,
+    [0x68 ... 0x6F] = OPT_PURE | OPT_KILL64,
+    [0xBE ... 0xBF] = OPT_PURE | OPT_KILL64,
+    [0xC0 ... 0xC9] = OPT_PURE | OPT_USE32,
+    [0xCA ... 0xD3] = OPT_PURE,
+    [0xD4 ... 0xD6] = OPT_PURE | OPT_KILL64,
+    [0xE0 ... 0xE5] = OPT_PURE | OPT_USE32,
+    [0xE6 ... 0xEB] = OPT_PURE,
+};
+
+// Регистровые операнды одной инструкции
+typedef struct {
+    uint8_t num_uses;
+    uint8_t use_pos[3];     // Смещения байтов регистров-источников
+    uint8_t use_lo_mask;    // Бит i: источник i читает только младшие 32 бита
+    int16_t def;            // Регистр-приёмник, -1 - нет
+} OptOperands;
+
+typedef struct {
+    uint8_t *code;          // Рабочая копия тела
+    uint32_t code_size;
+    uint32_t n;             // Число инструкций исходного тела
+    uint32_t *off;          // off[i] - смещение i-й инструкции, off[n] = code_size
+    uint8_t *is_target;     // Инструкция - цель перехода (начало блока)
+    uint32_t nregs;         // max_reg_used + 1
+    uint32_t words;         // Слов в половине множества регистров
+    uint32_t *live_in;      // n множеств: [младшие половины][старшие половины]
+} OptFunc;
+
+typedef struct {
+    uint32_t copies;
+    uint32_t dead;
+    uint32_t folded;
+    uint32_t branches;
+} OptStats;
+
+static void opt_operands(const uint8_t *insn, OptOperands *ops) {
+    const uint8_t op = insn[0];
+    const bool lo = (s_opt_flags[op] & OPT_USE32) != 0;
+    ops->num_uses = 0;
+    ops->use_lo_mask = 0;
+    ops->def = -1;
+    switch (s_opt_fmt[op]) {
+        case OPT_FMT_BR_IF:
+        case OPT_FMT_BR_TABLE:
+            ops->use_pos[ops->num_uses++] = 1;
+            break;
+        case OPT_FMT_D:
+            ops->def = insn[1];
+            break;
+        case OPT_FMT_DS:
+            ops->def = insn[1];
+            ops->use_pos[ops->num_uses++] = 2;
+            break;
+        case OPT_FMT_DSS:
+            ops->def = insn[1];
+            ops->use_pos[ops->num_uses++] = 2;
+            ops->use_pos[ops->num_uses++] = 3;
+            break;
+        case OPT_FMT_SELECT:
+            ops->def = insn[1];
+            ops->use_pos[ops->num_uses++] = 2; // условие - всегда I32
+            ops->use_pos[ops->num_uses++] = 3;
+            ops->use_pos[ops->num_uses++] = 4;
+            ops->use_lo_mask = 0x01;
+            return;
+        case OPT_FMT_SS:
+            ops->use_pos[ops->num_uses++] = 1;
+            ops->use_pos[ops->num_uses++] = 2;
+            break;
+        case OPT_FMT_S3:
+            ops->use_pos[ops->num_uses++] = 3;
+            break;
+        default:
+            break;
+    }
+    if (lo) ops->use_lo_mask = (uint8_t)((1u << ops->num_uses) - 1);
+}
+
+static inline bool opt_is_nop(const OptFunc *f, uint32_t i) {
+    return s_opt_fmt[f->code[f->off[i]]] == OPT_FMT_NONE;
+}
+
+static void opt_fill_nop(OptFunc *f, uint32_t i) {
+    memset(f->code + f->off[i], 0x00, f->off[i + 1] - f->off[i]);
+}
+
+// Индекс инструкции по смещению; target == code_size даёт n.
+static bool opt_entry_at(const OptFunc *f, int64_t target, uint32_t *out_idx) {
+    if (target < 0 || target > (int64_t)f->code_size) return false;
+    uint32_t lo = 0, hi = f->n;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (f->off[mid] < (uint32_t)target) lo = mid + 1; else hi = mid;
+    }
+    if (f->off[lo] != (uint32_t)target) return false; // Переход в середину инструкции
+    *out_idx = lo;
+    return true;
+}
+
+static inline int16_t opt_read_i16(const uint8_t *p) {
+    int16_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void opt_write_i16(uint8_t *p, int16_t v) {
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline uint16_t opt_br_table_count(const uint8_t *insn) {
+    uint16_t num_targets;
+    memcpy(&num_targets, insn + 2, sizeof(num_targets));
+    return num_targets;
+}
+
+// Абсолютное смещение i-го перехода инструкции (BR_TABLE: i == n - default).
+static int64_t opt_branch_target(const OptFunc *f, uint32_t idx, uint32_t i) {
+    const uint8_t *insn = f->code + f->off[idx];
+    switch (s_opt_fmt[insn[0]]) {
+        case OPT_FMT_BR:    return (int64_t)f->off[idx] + opt_read_i16(insn + 1);
+        case OPT_FMT_BR_IF: return (int64_t)f->off[idx] + opt_read_i16(insn + 2);
+        default:            return (int64_t)f->off[idx + 1] + opt_read_i16(insn + 4 + i * 2);
+    }
+}
+
+static uint32_t opt_branch_count(const OptFunc *f, uint32_t idx) {
+    const uint8_t *insn = f->code + f->off[idx];
+    switch (s_opt_fmt[insn[0]]) {
+        case OPT_FMT_BR:
+        case OPT_FMT_BR_IF:    return 1;
+        case OPT_FMT_BR_TABLE: return (uint32_t)opt_br_table_count(insn) + 1;
+        default:               return 0;
+    }
+}
+
+// Разбор тела: границы инструкций, проверка регистров и целей переходов.
+static bool opt_decode(OptFunc *f, uint8_t max_reg) {
+    const uint8_t *end = f->code + f->code_size;
+    uint32_t n = 0;
+    for (uint32_t off = 0; off < f->code_size; ++n) {
+        size_t len = espb_instruction_length(f->code + off, end);
+        if (len == 0 || s_opt_fmt[f->code[off]] == OPT_FMT_ADDR_OF) return false;
+        off += (uint32_t)len;
+    }
+    f->n = n;
+    f->off = (uint32_t *)malloc(((size_t)n + 1) * sizeof(uint32_t));
+    f->is_target = (uint8_t *)calloc((size_t)n + 1, 1);
+    if (!f->off || !f->is_target) return false;
+
+    uint32_t off = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        f->off[i] = off;
+        off += (uint32_t)espb_instruction_length(f->code + off, end);
+    }
+    f->off[n] = f->code_size;
+
+    for (uint32_t i = 0; i < n; ++i) {
+        OptOperands ops;
+        opt_operands(f->code + f->off[i], &ops);
+        if (ops.def > max_reg) return false;
+        for (uint32_t u = 0; u < ops.num_uses; ++u) {
+            if (f->code[f->off[i] + ops.use_pos[u]] > max_reg) return false;
+        }
+        const uint32_t nb = opt_branch_count(f, i);
+        for (uint32_t b = 0; b < nb; ++b) {
+            uint32_t t;
+            if (!opt_entry_at(f, opt_branch_target(f, i, b), &t)) return false;
+        }
+    }
+    return true;
+}
+
+static void opt_mark_targets(OptFunc *f) {
+    memset(f->is_target, 0, (size_t)f->n + 1);
+    for (uint32_t i = 0; i < f->n; ++i) {
+        const uint32_t nb = opt_branch_count(f, i);
+        for (uint32_t b = 0; b < nb; ++b) {
+            uint32_t t;
+            if (opt_entry_at(f, opt_branch_target(f, i, b), &t)) f->is_target[t] = 1;
+        }
+    }
+}
+
+// --- Протягивание переходов ---
+
+static uint32_t opt_skip_nops(const OptFunc *f, uint32_t idx) {
+    while (idx < f->n && opt_is_nop(f, idx)) idx++;
+    return idx;
+}
+
+// Конечная цель цепочки BR -> BR, начиная с target.
+static int64_t opt_thread_target(const OptFunc *f, int64_t target) {
+    for (uint32_t hop = 0; hop < OPT_MAX_BR_CHAIN; ++hop) {
+        uint32_t t;
+        if (!opt_entry_at(f, target, &t)) break;
+        t = opt_skip_nops(f, t);
+        if (t >= f->n || f->code[f->off[t]] != 0x02) break;
+        target = opt_branch_target(f, t, 0);
+    }
+    return target;
+}
+
+static bool opt_retarget(OptFunc *f, uint32_t idx, uint32_t b, int64_t base, uint8_t *field) {
+    const int64_t old_target = opt_branch_target(f, idx, b);
+    const int64_t target = opt_thread_target(f, old_target);
+    const int64_t rel = target - base;
+    if (target == old_target || rel < INT16_MIN || rel > INT16_MAX) return false;
+    opt_write_i16(field, (int16_t)rel);
+    return true;
+}
+
+static uint32_t opt_thread_branches(OptFunc *f) {
+    uint32_t changed = 0;
+    for (uint32_t i = 0; i < f->n; ++i) {
+        uint8_t *insn = f->code + f->off[i];
+        const uint8_t fmt = s_opt_fmt[insn[0]];
+        if (fmt == OPT_FMT_BR || fmt == OPT_FMT_BR_IF) {
+            uint8_t *field = insn + (fmt == OPT_FMT_BR ? 1 : 2);
+            if (opt_retarget(f, i, 0, f->off[i], field)) changed++;
+            // Переход на следующую инструкцию ничего не делает (чтение условия без эффектов)
+            uint32_t t;
+            if (opt_entry_at(f, opt_branch_target(f, i, 0), &t) &&
+                opt_skip_nops(f, t) == opt_skip_nops(f, i + 1)) {
+                opt_fill_nop(f, i);
+                changed++;
+            }
+        } else if (fmt == OPT_FMT_BR_TABLE) {
+            const uint32_t nb = opt_branch_count(f, i);
+            for (uint32_t b = 0; b < nb; ++b) {
+                if (opt_retarget(f, i, b, f->off[i + 1], insn + 4 + b * 2)) changed++;
+            }
+        }
+    }
+    return changed;
+}
+
+// --- Копирующее распространение (в пределах линейного участка) ---
+
+static uint32_t opt_propagate_copies(OptFunc *f) {
+    uint8_t copy_of[256];
+    uint32_t changed = 0;
+    memset(copy_of, OPT_NO_COPY, sizeof(copy_of));
+
+    for (uint32_t i = 0; i < f->n; ++i) {
+        uint8_t *insn = f->code + f->off[i];
+        const uint8_t fmt = s_opt_fmt[insn[0]];
+        if (f->is_target[i] || fmt == OPT_FMT_BARRIER) {
+            memset(copy_of, OPT_NO_COPY, f->nregs);
+            if (fmt == OPT_FMT_BARRIER) continue;
+        }
+
+        OptOperands ops;
+        opt_operands(insn, &ops);
+        for (uint32_t u = 0; u < ops.num_uses; ++u) {
+            const uint8_t src = copy_of[insn[ops.use_pos[u]]];
+            if (src != OPT_NO_COPY) {
+                insn[ops.use_pos[u]] = src;
+                changed++;
+            }
+        }
+        if (ops.def >= 0) {
+            const uint8_t rd = (uint8_t)ops.def;
+            copy_of[rd] = OPT_NO_COPY;
+            for (uint32_t r = 0; r < f->nregs; ++r) {
+                if (copy_of[r] == rd) copy_of[r] = OPT_NO_COPY;
+            }
+            if (s_opt_flags[insn[0]] & OPT_COPY) {
+                if (insn[2] == rd) {
+                    opt_fill_nop(f, i); // MOV Rd, Rd
+                    changed++;
+                } else {
+                    copy_of[rd] = insn[2];
+                }
+            }
+        }
+        if (fmt == OPT_FMT_BR || fmt == OPT_FMT_BR_TABLE || fmt == OPT_FMT_END || fmt == OPT_FMT_TRAP) {
+            memset(copy_of, OPT_NO_COPY, f->nregs);
+        }
+    }
+    return changed;
+}
+
+// --- Живость регистров: младшая и старшая половины Value отдельно ---
+
+static inline uint32_t *opt_live(const OptFunc *f, uint32_t i) {
+    return f->live_in + (size_t)i * 2 * f->words;
+}
+
+static inline void opt_set(uint32_t *s, uint32_t bit) { s[bit >> 5] |= 1u << (bit & 31); }
+static inline void opt_clr(uint32_t *s, uint32_t bit) { s[bit >> 5] &= ~(1u << (bit & 31)); }
+static inline bool opt_get(const uint32_t *s, uint32_t bit) { return (s[bit >> 5] >> (bit & 31)) & 1u; }
+
+static void opt_set_all(const OptFunc *f, uint32_t *s) {
+    memset(s, 0, 2 * f->words * sizeof(uint32_t));
+    for (uint32_t r = 0; r < f->nregs; ++r) {
+        opt_set(s, r);
+        opt_set(s + f->words, r);
+    }
+}
+
+static void opt_or_entry(const OptFunc *f, uint32_t *out, uint32_t idx) {
+    if (idx >= f->n) { // Выход за конец кода - считаем живым всё
+        opt_set_all(f, out);
+        return;
+    }
+    const uint32_t *in = opt_live(f, idx);
+    for (uint32_t w = 0; w < 2 * f->words; ++w) out[w] |= in[w];
+}
+
+static void opt_live_out(const OptFunc *f, uint32_t i, uint32_t *out) {
+    memset(out, 0, 2 * f->words * sizeof(uint32_t));
+    const uint8_t fmt = s_opt_fmt[f->code[f->off[i]]];
+    if (fmt != OPT_FMT_BR && fmt != OPT_FMT_BR_TABLE && fmt != OPT_FMT_END && fmt != OPT_FMT_TRAP) {
+        opt_or_entry(f, out, i + 1);
+    }
+    const uint32_t nb = opt_branch_count(f, i);
+    for (uint32_t b = 0; b < nb; ++b) {
+        uint32_t t;
+        if (opt_entry_at(f, opt_branch_target(f, i, b), &t)) opt_or_entry(f, out, t);
+    }
+}
+
+// live_in = uses ∪ (live_out \ defs)
+static void opt_transfer(const OptFunc *f, uint32_t i, uint32_t *set) {
+    const uint8_t *insn = f->code + f->off[i];
+    const uint8_t fmt = s_opt_fmt[insn[0]];
+    if (fmt == OPT_FMT_BARRIER) {
+        opt_set_all(f, set);
+        return;
+    }
+    if (fmt == OPT_FMT_END) {
+        opt_set(set, 0);
+        opt_set(set + f->words, 0);
+        return;
+    }
+    OptOperands ops;
+    opt_operands(insn, &ops);
+    if (ops.def >= 0) {
+        opt_clr(set, (uint32_t)ops.def);
+        if (s_opt_flags[insn[0]] & OPT_KILL64) opt_clr(set + f->words, (uint32_t)ops.def);
+    }
+    for (uint32_t u = 0; u < ops.num_uses; ++u) {
+        const uint8_t r = insn[ops.use_pos[u]];
+        opt_set(set, r);
+        if (!(ops.use_lo_mask & (1u << u))) opt_set(set + f->words, r);
+    }
+}
+
+static void opt_liveness(OptFunc *f, uint32_t *tmp) {
+    memset(f->live_in, 0, (size_t)f->n * 2 * f->words * sizeof(uint32_t));
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (uint32_t i = f->n; i-- > 0; ) {
+            opt_live_out(f, i, tmp);
+            opt_transfer(f, i, tmp);
+            uint32_t *in = opt_live(f, i);
+            if (memcmp(in, tmp, 2 * f->words * sizeof(uint32_t)) != 0) {
+                memcpy(in, tmp, 2 * f->words * sizeof(uint32_t));
+                changed = true;
+            }
+        }
+    }
+}
+
+// --- Удаление мёртвых записей ---
+
+static uint32_t opt_eliminate_dead(OptFunc *f, uint32_t *tmp) {
+    uint32_t changed = 0;
+    for (uint32_t i = 0; i < f->n; ++i) {
+        const uint8_t *insn = f->code + f->off[i];
+        if (!(s_opt_flags[insn[0]] & OPT_PURE)) continue;
+        OptOperands ops;
+        opt_operands(insn, &ops);
+        if (ops.def < 0) continue;
+        opt_live_out(f, i, tmp);
+        const bool hi_written = (s_opt_flags[insn[0]] & OPT_KILL64) != 0;
+        if (!opt_get(tmp, (uint32_t)ops.def) && !(hi_written && opt_get(tmp + f->words, (uint32_t)ops.def))) {
+            opt_fill_nop(f, i);
+            changed++;
+        }
+    }
+    return changed;
+}
+
+// --- Свёртка LDC.I32 R1, c ; OP.I32.IMM8 Rd, R1, k  ->  LDC.I32 Rd, c OP k ---
+
+static bool opt_fold_imm8(uint8_t op, uint32_t c, uint8_t k, uint32_t *out) {
+    const uint32_t sk = (uint32_t)(int32_t)(int8_t)k;
+    switch (op) {
+        case 0x40: *out = c + sk; return true;                         // ADD.I32.IMM8
+        case 0x41: *out = c - sk; return true;                         // SUB.I32.IMM8
+        case 0x47: *out = (uint32_t)((int32_t)c >> (k & 31u)); return true; // SHRS.I32.IMM8
+        case 0x48: *out = c >> (k & 31u); return true;                 // SHRU.I32.IMM8
+        case 0x49: *out = c & sk; return true;                         // AND.I32.IMM8
+        case 0x4A: *out = c | sk; return true;                         // OR.I32.IMM8
+        case 0x4B: *out = c ^ sk; return true;                         // XOR.I32.IMM8
+        default:   return false;                                       // MUL/DIV/REM ловят переполнение
+    }
+}
+
+static uint32_t opt_fold_constants(OptFunc *f, uint32_t *tmp) {
+    uint32_t changed = 0;
+    for (uint32_t i = 0; i < f->n; ++i) {
+        uint8_t *ldc = f->code + f->off[i];
+        if (ldc[0] != 0x18) continue;
+        // Следующая инструкция того же блока (NOP пропускаются)
+        uint32_t j = i + 1;
+        while (j < f->n && !f->is_target[j] && opt_is_nop(f, j)) j++;
+        if (j >= f->n || f->is_target[j]) continue;
+
+        uint8_t *insn = f->code + f->off[j];
+        if (insn[0] < 0x40 || insn[0] > 0x4B) continue; // *.I32.IMM8 Rd, R1, imm8
+        const uint8_t r1 = ldc[1];
+        const uint8_t rd = insn[1];
+        uint32_t c, folded;
+        memcpy(&c, ldc + 2, sizeof(c));
+        if (insn[2] != r1 || !opt_fold_imm8(insn[0], c, insn[3], &folded)) continue;
+        if (rd != r1) { // LDC.I32 писал только младшую половину R1
+            opt_live_out(f, j, tmp);
+            if (opt_get(tmp, r1)) continue;
+        }
+        ldc[1] = rd;
+        memcpy(ldc + 2, &folded, sizeof(folded));
+        opt_fill_nop(f, j);
+        changed++;
+    }
+    return changed;
+}
+
+#if CONFIG_ESPB_BYTECODE_OPT_VERIFY
+// Повторный разбор результата: границы исходных инструкций сохранены, каждая либо
+// заполнена NOP, либо имеет прежние опкод и длину; цели переходов - на границах;
+// регистры, читаемые до записи при входе, - подмножество исходных.
+static bool opt_verify(const OptFunc *f, const uint8_t *orig, uint8_t max_reg,
+                       const uint32_t *orig_entry_live, const char **why) {
+    const uint8_t *end = f->code + f->code_size;
+    for (uint32_t i = 0; i < f->n; ++i) {
+        const uint32_t off = f->off[i];
+        const uint32_t len = f->off[i + 1] - off;
+        if (f->code[off] == 0x00) {
+            for (uint32_t k = 1; k < len; ++k) {
+                if (f->code[off + k] != 0x00) { *why = "partial NOP fill"; return false; }
+            }
+            continue;
+        }
+        if (f->code[off] != orig[off] || espb_instruction_length(f->code + off, end) != len) {
+            *why = "instruction boundary moved";
+            return false;
+        }
+    }
+
+    // NOP-заполненные инструкции распадаются на однобайтовые, поэтому разбираем заново
+    OptFunc v = *f;
+    v.off = NULL;
+    v.is_target = NULL;
+    bool ok = opt_decode(&v, max_reg);
+    if (!ok) *why = "invalid register or branch target";
+
+    if (ok && orig_entry_live && v.n > 0) {
+        v.live_in = (uint32_t *)calloc((size_t)v.n * 2 * v.words + 2 * v.words, sizeof(uint32_t));
+        if (v.live_in) {
+            uint32_t *tmp = v.live_in + (size_t)v.n * 2 * v.words;
+            opt_liveness(&v, tmp);
+            const uint32_t *entry = opt_live(&v, 0);
+            for (uint32_t w = 0; w < 2 * v.words; ++w) {
+                if (entry[w] & ~orig_entry_live[w]) { ok = false; *why = "new read before write"; break; }
+            }
+            free(v.live_in);
+        }
+    }
+    free(v.off);
+    free(v.is_target);
+    return ok;
+}
+#endif
+
+bool espb_bytecode_optimize_function(EspbFunctionBody *body) {
+    if (!body || !body->code || body->code_size == 0 || body->optimized_code) return false;
+    if (body->header.num_virtual_regs == 0) return false;
+
+    OptFunc f = {0};
+    OptStats stats = {0};
+    bool applied = false;
+    uint32_t *tmp = NULL;
+    uint32_t *orig_entry_live = NULL;
+    f.code_size = body->code_size;
+    f.nregs = (uint32_t)body->header.max_reg_used + 1;
+    f.words = (f.nregs + 31) / 32;
+    f.code = (uint8_t *)malloc(f.code_size);
+    if (!f.code) return false;
+    memcpy(f.code, body->code, f.code_size);
+
+    if (!opt_decode(&f, body->header.max_reg_used) || f.n == 0) goto cleanup;
+    const size_t set_words = 2 * (size_t)f.words;
+    f.live_in = (uint32_t *)malloc((size_t)f.n * set_words * sizeof(uint32_t));
+    tmp = (uint32_t *)malloc(2 * set_words * sizeof(uint32_t));
+    if (!f.live_in || !tmp) goto cleanup;
+
+#if CONFIG_ESPB_BYTECODE_OPT_VERIFY
+    orig_entry_live = tmp + set_words;
+    opt_mark_targets(&f);
+    opt_liveness(&f, tmp);
+    memcpy(orig_entry_live, opt_live(&f, 0), set_words * sizeof(uint32_t));
+#endif
+
+    for (uint32_t round = 0; round < OPT_MAX_ROUNDS; ++round) {
+        uint32_t changed = 0;
+        uint32_t n;
+
+        n = opt_thread_branches(&f);
+        stats.branches += n;
+        changed += n;
+
+        opt_mark_targets(&f);
+        n = opt_propagate_copies(&f);
+        stats.copies += n;
+        changed += n;
+
+        // Удаление и свёртка только убирают чтения, поэтому живость этого раунда остаётся
+        // корректной (избыточной) до его конца
+        opt_liveness(&f, tmp);
+        n = opt_eliminate_dead(&f, tmp);
+        stats.dead += n;
+        changed += n;
+        n = opt_fold_constants(&f, tmp);
+        stats.folded += n;
+        changed += n;
+
+        if (changed == 0) break;
+    }
+    if (stats.branches + stats.copies + stats.dead + stats.folded == 0) goto cleanup;
+
+#if CONFIG_ESPB_BYTECODE_OPT_VERIFY
+    const char *why = NULL;
+    if (!opt_verify(&f, body->code, body->header.max_reg_used, orig_entry_live, &why)) {
+        ESP_LOGE(TAG, "Optimized body failed verification (%s), keeping original bytecode", why);
+        goto cleanup;
+    }
+#else
+    (void)orig_entry_live;
+#endif
+
+    ESP_LOGD(TAG, "%" PRIu32 " bytes: %" PRIu32 " copies, %" PRIu32 " dead, %" PRIu32 " folded, %" PRIu32 " branches",
+             f.code_size, stats.copies, stats.dead, stats.folded, stats.branches);
+    body->optimized_code = f.code;
+    body->code = f.code;
+    f.code = NULL;
+    applied = true;
+
+cleanup:
+    free(tmp);
+    free(f.live_in);
+    free(f.is_target);
+    free(f.off);
+    free(f.code);
+    return applied;
+}
+
+void espb_bytecode_optimize_module(EspbModule *module) {
+    if (!module || !module->function_bodies) return;
+    uint32_t optimized = 0;
+    for (uint32_t i = 0; i < module->num_functions; ++i) {
+        if (espb_bytecode_optimize_function(&module->function_bodies[i])) {
+            optimized++;
+        } else {
+            ESP_LOGD(TAG, "Func[%" PRIu32 "] left as is", i);
+        }
+    }
+    ESP_LOGI(TAG, "Bytecode optimizer: %" PRIu32 "/%" PRIu32 " functions rewritten",
+             optimized, module->num_functions);
+}
+
+#endif // CONFIG_ESPB_BYTECODE_OPT
@@ -0,0 +1,60 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "espb_call_ic.h"
+
+#include <stdlib.h>
+
+#if CONFIG_ESPB_CALL_IC_ENTRIES > 0
+
+void espb_call_ic_update(EspbInstance *instance, uintptr_t site, uintptr_t target,
+                         uint16_t type_idx, uint32_t func_idx) {
+    EspbCallIcEntry *ic = instance->call_ic;
+    if (!ic) return;
+    EspbCallIcEntry *e = &ic[espb_call_ic_hash(site, target) & instance->call_ic_mask];
+
+    // Запись занята другим писателем - не ждём: кэш лишь ускоряет вызов.
+    uint32_t seq = __atomic_load_n(&e->seq, __ATOMIC_RELAXED);
+    if ((seq & 1u) ||
+        !__atomic_compare_exchange_n(&e->seq, &seq, seq + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return;
+    }
+    __atomic_store_n(&e->site, site, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->target, target, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->type_idx, type_idx, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->func_idx, func_idx, __ATOMIC_RELAXED);
+    __atomic_store_n(&e->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+EspbResult espb_call_ic_init(EspbInstance *instance) {
+    uint32_t n = 1;
+    while (n < (uint32_t)CONFIG_ESPB_CALL_IC_ENTRIES) n <<= 1;
+
+    // site == 0 не встречается ни у pc, ни у адреса возврата, поэтому нулевая запись - пустая.
+    instance->call_ic = (EspbCallIcEntry *)calloc(n, sizeof(EspbCallIcEntry));
+    if (!instance->call_ic) return ESPB_ERR_MEMORY_ALLOC;
+    instance->call_ic_mask = n - 1;
+    return ESPB_OK;
+}
+
+void espb_call_ic_free(EspbInstance *instance) {
+    free(instance->call_ic);
+    instance->call_ic = NULL;
+    instance->call_ic_mask = 0;
+}
+
+#endif // CONFIG_ESPB_CALL_IC_ENTRIES > 0
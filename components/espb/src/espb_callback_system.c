@@ -20,6 +20,9 @@
 #include "espb_interpreter_runtime_oc.h"
 #include "esp_log.h"
 #include "espb_jit_dispatcher.h"
+#if CONFIG_ESPB_JIT_ENABLED
+#include "espb_jit.h"
+#endif
 #include <string.h>
 #include <stdlib.h>
 #include "esp_system.h"
@@ -33,12 +36,21 @@
 
 static const char *TAG = "espb_callback";
 
+#ifndef CONFIG_ESPB_CALLBACK_POOL_SIZE
+#define CONFIG_ESPB_CALLBACK_POOL_SIZE 4
+#endif
+#ifndef CONFIG_ESPB_CALLBACK_MAX_CLOSURES
+#define CONFIG_ESPB_CALLBACK_MAX_CLOSURES 32
+#endif
+
 // Глобальная callback система
 static EspbCallbackSystem g_callback_system = {0};
 
+#if CONFIG_ESPB_CALLBACK_DIAGNOSTICS
 // Счетчик вызовов callback для отладки
 static uint32_t g_callback_invocation_count = 0;
 static TickType_t g_last_callback_tick = 0;
+#endif
 
 // Вспомогательная функция для преобразования ESPB типа в FFI тип
 // КРИТИЧНАЯ ФУНКЦИЯ: часто вызывается, размещаем в IRAM
@@ -62,6 +74,103 @@ static ffi_type* espb_type_to_ffi_type_internal(EspbValueType es_type) {
     }
 }
 
+// Новое замыкание libffi: исполняемая память берётся из iram_pool (CONFIG_LIBFFI_USE_IRAM_POOL)
+__attribute__((noinline, cold))
+static EspbCallbackClosure *callback_closure_alloc(void) {
+    EspbCallbackClosure *closure = (EspbCallbackClosure*)calloc(1, sizeof(EspbCallbackClosure));
+    if (!closure) {
+        ESP_LOGE(TAG, "Failed to allocate callback closure");
+        return NULL;
+    }
+    closure->callback_info = &closure->info;
+
+    closure->closure_ptr = ffi_closure_alloc(sizeof(ffi_closure), &closure->executable_code);
+    if (!closure->closure_ptr || !closure->executable_code) {
+        ESP_LOGE(TAG, "ffi_closure_alloc failed - likely out of executable memory");
+        // Проверяем, не вернул ли аллокатор неисполняемую память (критично для C3)
+        if (closure->executable_code && !esp_ptr_executable(closure->executable_code)) {
+            ESP_LOGE(TAG, "FATAL: ffi_closure_alloc returned non-executable memory (%p)!", closure->executable_code);
+        }
+        if (closure->closure_ptr) ffi_closure_free(closure->closure_ptr);
+        free(closure);
+        return NULL;
+    }
+
+    // Диагностика успешного выделения с проверкой на исполняемость
+    if (esp_ptr_in_iram(closure->executable_code)) {
+       ESP_LOGD(TAG, "Successfully allocated closure from IRAM pool: closure=%p, exec=%p", closure->closure_ptr, closure->executable_code);
+    } else if (esp_ptr_executable(closure->executable_code)) {
+        ESP_LOGW(TAG, "Allocated closure from executable DRAM (fallback): closure=%p, exec=%p", closure->closure_ptr, closure->executable_code);
+    } else {
+        ESP_LOGE(TAG, "FATAL: Allocated closure in NON-EXECUTABLE memory: closure=%p, exec=%p", closure->closure_ptr, closure->executable_code);
+    }
+    return closure;
+}
+
+static void callback_closure_release(EspbCallbackClosure *closure) {
+    if (closure->closure_ptr) ffi_closure_free(closure->closure_ptr);
+    free(closure);
+}
+
+#define CALLBACK_FREE_TAG_STEP 0x10000u
+
+// Стек свободных слотов без блокировок: тег в старших 16 битах головы защищает от ABA
+static uint32_t callback_slot_pop(void) {
+    uint32_t head = __atomic_load_n(&g_callback_system.free_head, __ATOMIC_ACQUIRE);
+    for (;;) {
+        uint32_t idx = head & 0xFFFFu;
+        if (idx == ESPB_CALLBACK_SLOT_NONE) return ESPB_CALLBACK_SLOT_NONE;
+        uint32_t next = __atomic_load_n(&g_callback_system.slots[idx].next_free, __ATOMIC_RELAXED);
+        uint32_t new_head = next | ((head + CALLBACK_FREE_TAG_STEP) & ~0xFFFFu);
+        if (__atomic_compare_exchange_n(&g_callback_system.free_head, &head, new_head, true,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            return idx;
+        }
+    }
+}
+
+static void callback_slot_push(uint32_t idx) {
+    uint32_t head = __atomic_load_n(&g_callback_system.free_head, __ATOMIC_RELAXED);
+    for (;;) {
+        __atomic_store_n(&g_callback_system.slots[idx].next_free, head & 0xFFFFu, __ATOMIC_RELAXED);
+        uint32_t new_head = idx | ((head + CALLBACK_FREE_TAG_STEP) & ~0xFFFFu);
+        if (__atomic_compare_exchange_n(&g_callback_system.free_head, &head, new_head, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            return;
+        }
+    }
+}
+
+static inline uint32_t callback_exec_hash(const void *exec) {
+    return (uint32_t)(((uintptr_t)exec >> 2) * 2654435761u);
+}
+
+// Исполняемый адрес замыкания не меняется, пока оно лежит в слоте, поэтому запись
+// индекса добавляется один раз при первом выделении и не удаляется до deinit
+static void callback_exec_index_insert(uint32_t idx) {
+    const void *exec = g_callback_system.slots[idx].closure->executable_code;
+    uint32_t pos = callback_exec_hash(exec) & g_callback_system.exec_index_mask;
+    for (;;) {
+        uint32_t expected = 0;
+        if (__atomic_compare_exchange_n(&g_callback_system.exec_index[pos], &expected, idx + 1, false,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            return;
+        }
+        pos = (pos + 1) & g_callback_system.exec_index_mask;
+    }
+}
+
+static uint32_t callback_exec_index_find(const void *exec) {
+    uint32_t pos = callback_exec_hash(exec) & g_callback_system.exec_index_mask;
+    for (uint32_t probes = 0; probes <= g_callback_system.exec_index_mask; ++probes) {
+        uint32_t entry = __atomic_load_n(&g_callback_system.exec_index[pos], __ATOMIC_ACQUIRE);
+        if (entry == 0) break;
+        if (g_callback_system.slots[entry - 1].closure->executable_code == exec) return entry - 1;
+        pos = (pos + 1) & g_callback_system.exec_index_mask;
+    }
+    return ESPB_CALLBACK_SLOT_NONE;
+}
+
 EspbResult espb_callback_system_init(void) {
     if (g_callback_system.initialized) {
         return ESPB_OK; // Уже инициализирована
@@ -73,7 +182,36 @@ EspbResult espb_callback_system_init(void) {
         return ESPB_ERR_MEMORY_ALLOC;
     }
 
-    g_callback_system.active_closures = NULL;
+    uint32_t capacity = CONFIG_ESPB_CALLBACK_MAX_CLOSURES;
+    uint32_t index_size = 1;
+    while (index_size < capacity * 2) index_size <<= 1;
+    g_callback_system.slots = (EspbCallbackSlot*)calloc(capacity, sizeof(EspbCallbackSlot));
+    g_callback_system.exec_index = (uint32_t*)calloc(index_size, sizeof(uint32_t));
+    if (!g_callback_system.slots || !g_callback_system.exec_index) {
+        ESP_LOGE(TAG, "Failed to allocate callback registry");
+        free(g_callback_system.slots);
+        free(g_callback_system.exec_index);
+        g_callback_system.slots = NULL;
+        g_callback_system.exec_index = NULL;
+        vSemaphoreDelete(g_callback_system.mutex);
+        g_callback_system.mutex = NULL;
+        return ESPB_ERR_MEMORY_ALLOC;
+    }
+    g_callback_system.capacity = capacity;
+    g_callback_system.exec_index_mask = index_size - 1;
+    g_callback_system.free_head = ESPB_CALLBACK_SLOT_NONE;
+    for (uint32_t i = capacity; i-- > 0;) {
+        callback_slot_push(i);
+    }
+
+    // Первые слоты сразу получают замыкания, чтобы типичные регистрации не ходили
+    // в аллокатор исполняемой памяти
+    for (uint32_t i = 0; i < CONFIG_ESPB_CALLBACK_POOL_SIZE && i < capacity; ++i) {
+        EspbCallbackClosure *closure = callback_closure_alloc();
+        if (!closure) break; // Недостающие замыкания выделятся по требованию
+        g_callback_system.slots[i].closure = closure;
+        callback_exec_index_insert(i);
+    }
     g_callback_system.initialized = true;
 
     // IRAM pool уже инициализирован в app_main(), просто выводим статус
@@ -93,7 +231,13 @@ EspbResult espb_callback_system_init(void) {
 
 EspbResult espb_get_active_closures(EspbClosureCtx **out_active_closures) {
     if (out_active_closures) {
-        *out_active_closures = (EspbClosureCtx*)g_callback_system.active_closures;
+        *out_active_closures = NULL;
+        for (uint32_t i = 0; i < g_callback_system.capacity; ++i) {
+            if (__atomic_load_n(&g_callback_system.slots[i].state, __ATOMIC_ACQUIRE) == ESPB_CALLBACK_SLOT_ACTIVE) {
+                *out_active_closures = (EspbClosureCtx*)g_callback_system.slots[i].closure;
+                break;
+            }
+        }
     }
 
     return ESPB_OK;
@@ -104,27 +248,17 @@ void espb_callback_system_deinit(void) {
         return;
     }
 
-    // Освобождаем все активные замыкания
-    if (xSemaphoreTake(g_callback_system.mutex, portMAX_DELAY) == pdTRUE) {
-        EspbCallbackClosure *current = g_callback_system.active_closures;
-        while (current) {
-            EspbCallbackClosure *next = current->next;
-            
-            if (current->closure_ptr) {
-                ffi_closure_free(current->closure_ptr);
-            }
-            
-            if (current->callback_info) {
-                free(current->callback_info);
-            }
-            
-            free(current);
-            current = next;
+    // Освобождаем все замыкания реестра, в том числе активные
+    for (uint32_t i = 0; i < g_callback_system.capacity; ++i) {
+        if (g_callback_system.slots[i].closure) {
+            callback_closure_release(g_callback_system.slots[i].closure);
         }
-        
-        g_callback_system.active_closures = NULL;
-        xSemaphoreGive(g_callback_system.mutex);
     }
+    free(g_callback_system.slots);
+    free(g_callback_system.exec_index);
+    g_callback_system.slots = NULL;
+    g_callback_system.exec_index = NULL;
+    g_callback_system.capacity = 0;
 
     if (g_callback_system.mutex) {
         vSemaphoreDelete(g_callback_system.mutex);
@@ -177,6 +311,162 @@ bool espb_callback_get_iram_pool_stats(size_t *out_total_size, size_t *out_used_
 #endif
 }
 
+static EspbCallbackCif *callback_cif_prepare(EspbFuncSignature *espb_sig, EspbResult *out_result) {
+    // ИСПРАВЛЕНИЕ: ESPB сигнатура неправильная (0 параметров), но timer callback должен иметь 1 параметр
+    uint32_t num_params = espb_sig->num_params;
+    if (num_params == 0) {
+        ESP_LOGW(TAG, "ESPB signature has 0 params, but timer callback needs 1 param - fixing");
+        num_params = 1; // Принудительно устанавливаем 1 параметр для timer callback
+    }
+
+    if (num_params > ESPB_CALLBACK_MAX_PARAMS) {
+        ESP_LOGE(TAG, "Too many callback parameters: %lu", (unsigned long)num_params);
+        *out_result = ESPB_ERR_INVALID_OPERAND;
+        return NULL;
+    }
+
+    EspbCallbackCif *entry = (EspbCallbackCif*)calloc(1, sizeof(EspbCallbackCif));
+    if (!entry) {
+        ESP_LOGE(TAG, "Failed to allocate callback CIF");
+        *out_result = ESPB_ERR_MEMORY_ALLOC;
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < num_params; ++i) {
+        if (i < espb_sig->num_params) {
+            entry->arg_types[i] = espb_type_to_ffi_type_internal(espb_sig->param_types[i]);
+        } else {
+            // Для дополнительных параметров (timer callback) используем PTR
+            entry->arg_types[i] = espb_type_to_ffi_type_internal(ESPB_TYPE_PTR);
+        }
+
+        if (!entry->arg_types[i]) {
+            ESP_LOGE(TAG, "Unsupported parameter type for param %lu", (unsigned long)i);
+            free(entry);
+            *out_result = ESPB_ERR_INVALID_OPERAND;
+            return NULL;
+        }
+    }
+
+    // Определяем тип возвращаемого значения
+    ffi_type *ret_type = &ffi_type_void;
+    if (espb_sig->num_returns > 0) {
+        ret_type = espb_type_to_ffi_type_internal(espb_sig->return_types[0]);
+        if (!ret_type) {
+            ESP_LOGE(TAG, "Unsupported return type: %d", espb_sig->return_types[0]);
+            free(entry);
+            *out_result = ESPB_ERR_INVALID_OPERAND;
+            return NULL;
+        }
+    }
+
+    ffi_status status = ffi_prep_cif(&entry->cif, FFI_DEFAULT_ABI, num_params, ret_type, entry->arg_types);
+    if (status != FFI_OK) {
+        ESP_LOGE(TAG, "ffi_prep_cif failed: %d", status);
+        free(entry);
+        *out_result = ESPB_ERR_RUNTIME_ERROR;
+        return NULL;
+    }
+
+    entry->num_args = (uint8_t)num_params;
+    entry->words_only = true;
+    for (uint32_t i = 0; i < num_params; ++i) {
+        EspbValueType t = i < espb_sig->num_params ? espb_sig->param_types[i] : ESPB_TYPE_PTR;
+        entry->arg_types_espb[i] = (uint8_t)t;
+        bool word = t == ESPB_TYPE_I32 || t == ESPB_TYPE_U32 || t == ESPB_TYPE_BOOL ||
+                    (t == ESPB_TYPE_PTR && sizeof(void*) == sizeof(uint32_t));
+        if (!word) entry->words_only = false;
+    }
+    entry->ret_type_espb = espb_sig->num_returns > 0 ? (uint8_t)espb_sig->return_types[0] : (uint8_t)ESPB_TYPE_VOID;
+
+    entry->espb_signature = espb_sig;
+    return entry;
+}
+
+static EspbCallbackCif *callback_cif_find(const EspbInstance *instance, const EspbFuncSignature *espb_sig) {
+    for (EspbCallbackCif *c = __atomic_load_n(&instance->callback_cifs, __ATOMIC_ACQUIRE); c; c = c->next) {
+        if (c->espb_signature == espb_sig) return c;
+    }
+    return NULL;
+}
+
+// Промах кэша CIF: единственное место, где создание колбэка берёт мьютекс.
+// Читатели обходят список без блокировки, новая запись публикуется release-записью головы.
+__attribute__((noinline, cold))
+static EspbCallbackCif *callback_cif_create(EspbInstance *instance, EspbFuncSignature *espb_sig, EspbResult *out_result) {
+    if (xSemaphoreTake(g_callback_system.mutex, portMAX_DELAY) != pdTRUE) {
+        *out_result = ESPB_ERR_RUNTIME_ERROR;
+        return NULL;
+    }
+    EspbCallbackCif *entry = callback_cif_find(instance, espb_sig);
+    if (!entry) {
+        entry = callback_cif_prepare(espb_sig, out_result);
+        if (entry) {
+            entry->next = instance->callback_cifs;
+            __atomic_store_n(&instance->callback_cifs, entry, __ATOMIC_RELEASE);
+        }
+    }
+    xSemaphoreGive(g_callback_system.mutex);
+    return entry;
+}
+
+void espb_callback_release_instance(EspbInstance *instance) {
+    if (!instance) {
+        return;
+    }
+    if (g_callback_system.initialized) {
+        for (uint32_t i = 0; i < g_callback_system.capacity; ++i) {
+            EspbCallbackSlot *slot = &g_callback_system.slots[i];
+            uint32_t expected = ESPB_CALLBACK_SLOT_ACTIVE;
+            if (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) == ESPB_CALLBACK_SLOT_ACTIVE &&
+                slot->closure->instance == instance &&
+                __atomic_compare_exchange_n(&slot->state, &expected, ESPB_CALLBACK_SLOT_FREE, false,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+                callback_slot_push(i);
+            }
+        }
+    }
+    while (instance->callback_cifs) {
+        EspbCallbackCif *next = instance->callback_cifs->next;
+        free(instance->callback_cifs);
+        instance->callback_cifs = next;
+    }
+}
+
+uint32_t espb_callback_instance_closures(const EspbInstance *instance) {
+    uint32_t count = 0;
+    if (!instance || !g_callback_system.initialized) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < g_callback_system.capacity; ++i) {
+        const EspbCallbackSlot *slot = &g_callback_system.slots[i];
+        if (__atomic_load_n(&slot->state, __ATOMIC_ACQUIRE) == ESPB_CALLBACK_SLOT_ACTIVE &&
+            slot->closure->instance == instance) {
+            count++;
+        }
+    }
+    return count;
+}
+
+static inline void callback_store_result(EspbValueType ret_type, void *ret_value, const Value *result_ptr) {
+    Value result = *result_ptr;
+    switch (ret_type) {
+        case ESPB_TYPE_I8:   *(int8_t*)ret_value   = (int8_t)V_I32(result); break;
+        case ESPB_TYPE_U8:   *(uint8_t*)ret_value  = (uint8_t)V_I32(result); break;
+        case ESPB_TYPE_I16:  *(int16_t*)ret_value  = (int16_t)V_I32(result); break;
+        case ESPB_TYPE_U16:  *(uint16_t*)ret_value = (uint16_t)V_I32(result); break;
+        case ESPB_TYPE_I32:  *(int32_t*)ret_value  = V_I32(result); break;
+        case ESPB_TYPE_U32:  *(uint32_t*)ret_value = (uint32_t)V_I32(result); break;
+        case ESPB_TYPE_I64:  *(int64_t*)ret_value  = V_I64(result); break;
+        case ESPB_TYPE_U64:  *(uint64_t*)ret_value = (uint64_t)V_I64(result); break;
+        case ESPB_TYPE_F32:  *(float*)ret_value    = V_F32(result); break;
+        case ESPB_TYPE_F64:  *(double*)ret_value   = V_F64(result); break;
+        case ESPB_TYPE_PTR:  *(void**)ret_value    = V_PTR(result); break;
+        case ESPB_TYPE_BOOL: *(int32_t*)ret_value  = V_I32(result); break;
+        default: break;
+    }
+}
+
 ESPB_CALLBACK_CRITICAL
 void espb_universal_callback_handler(ffi_cif *cif, void *ret_value, void **ffi_args, void *user_data) {
     EspbCallbackClosure *closure = (EspbCallbackClosure*)user_data;
@@ -188,6 +478,7 @@ void espb_universal_callback_handler(ffi_cif *cif, void *ret_value, void **ffi_a
     EspbCallbackInfo *info = closure->callback_info;
     EspbInstance *instance = closure->instance;
     
+#if CONFIG_ESPB_CALLBACK_DIAGNOSTICS
     // Увеличиваем счетчик вызовов и измеряем время
     g_callback_invocation_count++;
     TickType_t current_tick = xTaskGetTickCount();
@@ -209,9 +500,11 @@ void espb_universal_callback_handler(ffi_cif *cif, void *ret_value, void **ffi_a
              instance ? instance->memory_data : NULL);
     
     g_last_callback_tick = current_tick;
+#endif
 
-    // СОЗДАТЬ ЛОКАЛЬНЫЙ КОНТЕКСТ
-    ExecutionContext *callback_exec_ctx = init_execution_context();
+    // Контекст задачи, в которой сработал колбэк (таймерная задача, GPIO-задача и т.п.).
+    // После первого вызова в задаче память не выделяется.
+    ExecutionContext *callback_exec_ctx = acquire_execution_context();
     if (!callback_exec_ctx) {
         ESP_LOGE(TAG, "Failed to create execution context for callback");
         return;
@@ -229,8 +522,10 @@ void espb_universal_callback_handler(ffi_cif *cif, void *ret_value, void **ffi_a
         copy_limit = ESPB_CALLBACK_MAX_PARAMS;
     }
     
+#if CONFIG_ESPB_CALLBACK_DIAGNOSTICS
    ESP_LOGD(TAG, "ESPB signature expects %u params, native provides %u args, will pass %u args", 
              num_params, native_nargs, actual_params_to_pass);
+#endif
 
     // Конвертируем аргументы из FFI в ESPB формат
     for (uint32_t i = 0; i < copy_limit; ++i) {
@@ -273,8 +568,6 @@ void espb_universal_callback_handler(ffi_cif *cif, void *ret_value, void **ffi_a
                 SET_TYPE(espb_args[i], ESPB_TYPE_I32);
                 break;
         }
-
-        ESP_LOGD(TAG, "Callback arg[%lu] type=%d converted", (unsigned long)i, es_type);
     }
 
     // Синхронизация больше не нужна - используем разделяемый контекст выполнения
@@ -282,7 +575,8 @@ void espb_universal_callback_handler(ffi_cif *cif, void *ret_value, void **ffi_a
     // Вызываем ESPB функцию
     Value result = {0};
     Value *result_ptr = (info->espb_signature->num_returns > 0) ? &result : NULL;
-    
+
+#if CONFIG_ESPB_CALLBACK_DIAGNOSTICS
    ESP_LOGD(TAG, "Calling ESPB function %lu with %u parameters (actual_params_to_pass=%u)", 
              (unsigned long)info->espb_func_idx, num_params, actual_params_to_pass);
     
@@ -293,10 +587,10 @@ void espb_universal_callback_handler(ffi_cif *cif, void *ret_value, void **ffi_a
                  (unsigned long)V_I32(espb_args[i]));
     }
     
-  
     // КРИТИЧЕСКАЯ ПРОВЕРКА: убеждаемся что передаем правильные аргументы
    ESP_LOGD(TAG, "Calling espb_call_function(instance=%p, exec_ctx=%p, func_idx=%lu, args=%p, result=%p)",
              instance, callback_exec_ctx, (unsigned long)info->espb_func_idx, espb_args, result_ptr);
+#endif
     
     // Проверяем, что у нас есть хотя бы один аргумент для передачи
     const Value *args_to_pass = (copy_limit > 0) ? espb_args : NULL;
@@ -304,56 +598,117 @@ void espb_universal_callback_handler(ffi_cif *cif, void *ret_value, void **ffi_a
     EspbResult call_result = espb_execute_function(instance, callback_exec_ctx,
                                                  info->espb_func_idx, args_to_pass, result_ptr);
     
-   ESP_LOGD(TAG, "*** espb_call_function RETURNED: result=%d ***", call_result);
-    
-    // Синхронизация больше не нужна - состояние автоматически разделяется
-    
-    // КРИТИЧЕСКАЯ ДИАГНОСТИКА: детальный анализ результата
-    if (call_result == ESPB_OK) {
-       ESP_LOGD(TAG, "*** SUCCESS: ESPB function executed successfully ***");
-    } else {
-        ESP_LOGE(TAG, "*** FAILURE: ESPB function failed with code %d ***", call_result);
-        ESP_LOGE(TAG, "*** This explains why printf doesn't appear ***");
-    }
-
     if (call_result != ESPB_OK) {
         ESP_LOGE(TAG, "Callback ESPB function call failed: %d", call_result);
-    } else {
-       ESP_LOGD(TAG, "Callback ESPB function executed successfully");
-        if (result_ptr && info->espb_signature->num_returns > 0) {
-           ESP_LOGD(TAG, "  Return value: value=0x%08lx",
-                     (unsigned long)V_I32(result));
-        }
-        
-        // Симуляция больше не нужна - реальная ESPB функция должна работать с разделяемым контекстом
     }
+#if CONFIG_ESPB_CALLBACK_DIAGNOSTICS
+    else if (result_ptr && info->espb_signature->num_returns > 0) {
+       ESP_LOGD(TAG, "Callback ESPB function executed successfully, return value: 0x%08lx",
+                 (unsigned long)V_I32(result));
+    }
+#endif
 
     // Обрабатываем возвращаемое значение, если есть
     if (ret_value && result_ptr && info->espb_signature->num_returns > 0) {
-        EspbValueType ret_type = info->espb_signature->return_types[0];
-        switch (ret_type) {
-            case ESPB_TYPE_I8:   *(int8_t*)ret_value   = (int8_t)V_I32(result); break;
-            case ESPB_TYPE_U8:   *(uint8_t*)ret_value  = (uint8_t)V_I32(result); break;
-            case ESPB_TYPE_I16:  *(int16_t*)ret_value  = (int16_t)V_I32(result); break;
-            case ESPB_TYPE_U16:  *(uint16_t*)ret_value = (uint16_t)V_I32(result); break;
-            case ESPB_TYPE_I32:  *(int32_t*)ret_value  = V_I32(result); break;
-            case ESPB_TYPE_U32:  *(uint32_t*)ret_value = (uint32_t)V_I32(result); break;
-            case ESPB_TYPE_I64:  *(int64_t*)ret_value  = V_I64(result); break;
-            case ESPB_TYPE_U64:  *(uint64_t*)ret_value = (uint64_t)V_I64(result); break;
-            case ESPB_TYPE_F32:  *(float*)ret_value    = V_F32(result); break;
-            case ESPB_TYPE_F64:  *(double*)ret_value   = V_F64(result); break;
-            case ESPB_TYPE_PTR:  *(void**)ret_value    = V_PTR(result); break;
-            case ESPB_TYPE_BOOL: *(int32_t*)ret_value  = V_I32(result); break;
-            default: break;
-        }
+        callback_store_result(info->espb_signature->return_types[0], ret_value, &result);
     }
 
-    // Принудительный вывод больше не нужен - реальная ESPB функция должна работать
-    
-    // УНИЧТОЖИТЬ ЛОКАЛЬНЫЙ КОНТЕКСТ
-    free_execution_context(callback_exec_ctx);
-    
+    release_execution_context(callback_exec_ctx, instance);
+
+#if CONFIG_ESPB_CALLBACK_DIAGNOSTICS
    ESP_LOGD(TAG, "=== TIMER CALLBACK COMPLETED ===");
+#endif
+}
+
+// --- Специализированные thunk'и ---
+// План аргументов (EspbCallbackCif) и подстановка user_data известны при создании замыкания,
+// поэтому thunk не разбирает сигнатуру на каждом вызове. Если цель уже скомпилирована JIT,
+// аргументы уходят прямо в execute_jit_code без контекста исполнения интерпретатора.
+
+static inline void callback_thunk_invoke(EspbCallbackClosure *closure, const EspbCallbackCif *plan,
+                                         Value *args, void *ret_value) {
+    EspbCallbackInfo *info = closure->callback_info;
+    EspbInstance *instance = closure->instance;
+    if (info->user_data_arg >= 0) {
+        V_PTR(args[info->user_data_arg]) = info->original_user_data;
+    }
+
+    Value result = {0};
+    Value *result_ptr = plan->ret_type_espb != ESPB_TYPE_VOID ? &result : NULL;
+    const Value *args_to_pass = plan->num_args > 0 ? args : NULL;
+    EspbResult call_result;
+#if CONFIG_ESPB_JIT_ENABLED
+    EspbFunctionBody *body = info->body;
+    void *jit_code = __atomic_load_n(&body->jit_code, __ATOMIC_ACQUIRE);
+    if (jit_code) {
+        espb_jit_note_call(instance, info->espb_func_idx);
+        // Как и диспетчер, JIT-коду передаём только объявленные параметры
+        uint8_t num_args = plan->num_args < info->espb_signature->num_params ? plan->num_args
+                                                                             : info->espb_signature->num_params;
+        call_result = execute_jit_code(instance, jit_code, args_to_pass, num_args, result_ptr,
+                                       body->header.num_virtual_regs, ESPB_FRAME_ZERO_INIT_REGS(body));
+    } else
+#endif
+    {
+        ExecutionContext *callback_exec_ctx = acquire_execution_context();
+        if (!callback_exec_ctx) {
+            ESP_LOGE(TAG, "Failed to create execution context for callback");
+            return;
+        }
+        call_result = espb_execute_function(instance, callback_exec_ctx, info->espb_func_idx, args_to_pass, result_ptr);
+        release_execution_context(callback_exec_ctx, instance);
+    }
+
+    if (call_result != ESPB_OK) {
+        ESP_LOGE(TAG, "Callback ESPB function call failed: %d", call_result);
+    }
+    if (ret_value && result_ptr) {
+        callback_store_result((EspbValueType)plan->ret_type_espb, ret_value, &result);
+    }
+}
+
+// Все аргументы - 32-битные слова (I32/U32/BOOL, PTR на 32-битной архитектуре)
+static void callback_thunk_words(ffi_cif *cif, void *ret_value, void **ffi_args, void *user_data) {
+    (void)cif;
+    EspbCallbackClosure *closure = (EspbCallbackClosure*)user_data;
+    const EspbCallbackCif *plan = closure->callback_info->native_cif;
+    Value args[ESPB_CALLBACK_MAX_PARAMS];
+    for (uint32_t i = 0; i < plan->num_args; ++i) {
+        V_I32(args[i]) = *(int32_t*)ffi_args[i];
+    }
+    callback_thunk_invoke(closure, plan, args, ret_value);
+}
+
+static void callback_thunk_typed(ffi_cif *cif, void *ret_value, void **ffi_args, void *user_data) {
+    (void)cif;
+    EspbCallbackClosure *closure = (EspbCallbackClosure*)user_data;
+    const EspbCallbackCif *plan = closure->callback_info->native_cif;
+    Value args[ESPB_CALLBACK_MAX_PARAMS];
+    for (uint32_t i = 0; i < plan->num_args; ++i) {
+        switch (plan->arg_types_espb[i]) {
+            case ESPB_TYPE_I8:   V_I32(args[i]) = *(int8_t*)ffi_args[i]; break;
+            case ESPB_TYPE_U8:   V_I32(args[i]) = *(uint8_t*)ffi_args[i]; break;
+            case ESPB_TYPE_I16:  V_I32(args[i]) = *(int16_t*)ffi_args[i]; break;
+            case ESPB_TYPE_U16:  V_I32(args[i]) = *(uint16_t*)ffi_args[i]; break;
+            case ESPB_TYPE_I64:
+            case ESPB_TYPE_U64:  V_I64(args[i]) = *(int64_t*)ffi_args[i]; break;
+            case ESPB_TYPE_F32:  V_F32(args[i]) = *(float*)ffi_args[i]; break;
+            case ESPB_TYPE_F64:  V_F64(args[i]) = *(double*)ffi_args[i]; break;
+            case ESPB_TYPE_PTR:  V_PTR(args[i]) = *(void**)ffi_args[i]; break;
+            default:             V_I32(args[i]) = *(int32_t*)ffi_args[i]; break;
+        }
+    }
+    callback_thunk_invoke(closure, plan, args, ret_value);
+}
+
+// Выбор обработчика для замыкания. С диагностикой остаётся универсальный обработчик.
+static void (*callback_select_thunk(const EspbCallbackCif *plan))(ffi_cif *, void *, void **, void *) {
+#if CONFIG_ESPB_CALLBACK_DIAGNOSTICS
+    (void)plan;
+    return espb_universal_callback_handler;
+#else
+    return plan->words_only ? callback_thunk_words : callback_thunk_typed;
+#endif
 }
 
 EspbResult espb_create_callback_closure(
@@ -429,129 +784,55 @@ EspbResult espb_create_callback_closure(
              (unsigned long)global_func_idx, (unsigned long)local_func_idx, espb_sig_idx, 
              espb_sig->num_params, espb_sig->num_returns);
 
-    // Создаем структуру информации о callback
-    EspbCallbackInfo *callback_info = (EspbCallbackInfo*)calloc(1, sizeof(EspbCallbackInfo));
-    if (!callback_info) {
-        ESP_LOGE(TAG, "Failed to allocate callback info");
-        return ESPB_ERR_MEMORY_ALLOC;
-    }
-
-    callback_info->espb_func_idx = global_func_idx;
-    callback_info->espb_signature = espb_sig;
-    callback_info->user_data_param_index = user_data_param_idx;
-    callback_info->original_user_data = original_user_data;
-
-    // ИСПРАВЛЕНИЕ: ESPB сигнатура неправильная (0 параметров), но timer callback должен иметь 1 параметр
-    uint32_t num_params = espb_sig->num_params;
-    if (num_params == 0) {
-        ESP_LOGW(TAG, "ESPB signature has 0 params, but timer callback needs 1 param - fixing");
-        num_params = 1; // Принудительно устанавливаем 1 параметр для timer callback
-    }
-    
-    if (num_params > ESPB_CALLBACK_MAX_PARAMS) {
-        ESP_LOGE(TAG, "Too many callback parameters: %lu", (unsigned long)num_params);
-        free(callback_info);
-        return ESPB_ERR_INVALID_OPERAND;
-    }
-
-    for (uint32_t i = 0; i < num_params; ++i) {
-        if (i < espb_sig->num_params) {
-            callback_info->native_arg_types[i] = espb_type_to_ffi_type_internal(espb_sig->param_types[i]);
-        } else {
-            // Для дополнительных параметров (timer callback) используем PTR
-            callback_info->native_arg_types[i] = espb_type_to_ffi_type_internal(ESPB_TYPE_PTR);
-        }
-        
-        if (!callback_info->native_arg_types[i]) {
-            ESP_LOGE(TAG, "Unsupported parameter type for param %lu", (unsigned long)i);
-            free(callback_info);
-            return ESPB_ERR_INVALID_OPERAND;
-        }
-    }
-
-    // Определяем тип возвращаемого значения
-    ffi_type *ret_type = &ffi_type_void;
-    if (espb_sig->num_returns > 0) {
-        ret_type = espb_type_to_ffi_type_internal(espb_sig->return_types[0]);
-        if (!ret_type) {
-            ESP_LOGE(TAG, "Unsupported return type: %d", espb_sig->return_types[0]);
-            free(callback_info);
-            return ESPB_ERR_INVALID_OPERAND;
+    EspbResult result = ESPB_OK;
+    EspbCallbackCif *cif = callback_cif_find(instance, espb_sig);
+    if (!cif) {
+        cif = callback_cif_create(instance, espb_sig, &result);
+        if (!cif) {
+            return result;
         }
     }
 
-    // Подготавливаем FFI CIF
-    ffi_status status = ffi_prep_cif(&callback_info->native_cif, FFI_DEFAULT_ABI,
-                                     num_params, ret_type, callback_info->native_arg_types);
-    if (status != FFI_OK) {
-        ESP_LOGE(TAG, "ffi_prep_cif failed: %d", status);
-        free(callback_info);
-        return ESPB_ERR_RUNTIME_ERROR;
-    }
-
-    // Создаем замыкание
-    EspbCallbackClosure *closure = (EspbCallbackClosure*)calloc(1, sizeof(EspbCallbackClosure));
-    if (!closure) {
-        ESP_LOGE(TAG, "Failed to allocate callback closure");
-        free(callback_info);
+    uint32_t slot_idx = callback_slot_pop();
+    if (slot_idx == ESPB_CALLBACK_SLOT_NONE) {
+        ESP_LOGE(TAG, "Callback registry is full (%lu closures)", (unsigned long)g_callback_system.capacity);
         return ESPB_ERR_MEMORY_ALLOC;
     }
-
-    closure->callback_info = callback_info;
-    closure->instance = instance;
-    // closure->exec_ctx = exec_ctx; // БОЛЬШЕ НЕ СОХРАНЯЕМ КОНТЕКСТ
-    
-   ESP_LOGD(TAG, "Callback closure created (will use its own exec_ctx)");
-
-    // Выделяем память для FFI замыкания
-    closure->closure_ptr = ffi_closure_alloc(sizeof(ffi_closure), &closure->executable_code);
-    
-    if (!closure->closure_ptr || !closure->executable_code) {
-        ESP_LOGE(TAG, "ffi_closure_alloc failed - likely out of executable memory");
-        
-#if defined(CONFIG_LIBFFI_USE_IRAM_POOL)
-        // Выводим диагностику IRAM pool при ошибке выделения
-        // extern void iram_pool_debug(void);
-        // ESP_LOGW(TAG, "IRAM pool status after allocation failure:");
-        // iram_pool_debug();
-#endif
-        // Проверяем, не вернул ли аллокатор неисполняемую память (критично для C3)
-        if (closure->executable_code && !esp_ptr_executable(closure->executable_code)) {
-            ESP_LOGE(TAG, "FATAL: ffi_closure_alloc returned non-executable memory (%p)!", closure->executable_code);
+    // Снятый со стека слот принадлежит только этому потоку до публикации ACTIVE
+    EspbCallbackSlot *slot = &g_callback_system.slots[slot_idx];
+    EspbCallbackClosure *closure = slot->closure;
+    if (!closure) {
+        closure = callback_closure_alloc();
+        if (!closure) {
+            callback_slot_push(slot_idx);
+            return ESPB_ERR_MEMORY_ALLOC;
         }
-        
-        free(callback_info);
-        free(closure);
-        return ESPB_ERR_MEMORY_ALLOC;
+        slot->closure = closure;
+        callback_exec_index_insert(slot_idx);
     }
 
-    // Диагностика успешного выделения с проверкой на исполняемость
-    if (esp_ptr_in_iram(closure->executable_code)) {
-       ESP_LOGD(TAG, "Successfully allocated closure from IRAM pool: closure=%p, exec=%p", closure->closure_ptr, closure->executable_code);
-    } else if (esp_ptr_executable(closure->executable_code)) {
-        ESP_LOGW(TAG, "Allocated closure from executable DRAM (fallback): closure=%p, exec=%p", closure->closure_ptr, closure->executable_code);
-    } else {
-        ESP_LOGE(TAG, "FATAL: Allocated closure in NON-EXECUTABLE memory: closure=%p, exec=%p", closure->closure_ptr, closure->executable_code);
-        // Здесь можно добавить обработку критической ошибки, например, панику
-    }
-
-    // Подготавливаем замыкание
-    status = ffi_prep_closure_loc(closure->closure_ptr, &callback_info->native_cif,
-                                  espb_universal_callback_handler, closure, closure->executable_code);
+    closure->instance = instance;
+    EspbCallbackInfo *callback_info = closure->callback_info;
+    callback_info->espb_func_idx = global_func_idx;
+    callback_info->espb_signature = espb_sig;
+    callback_info->native_cif = cif;
+    callback_info->user_data_param_index = user_data_param_idx;
+    callback_info->original_user_data = original_user_data;
+    // Подстановка user_data действует только для PTR-аргумента, который копируется в функцию
+    callback_info->user_data_arg = (user_data_param_idx >= 0 && user_data_param_idx < cif->num_args &&
+                                    cif->arg_types_espb[user_data_param_idx] == ESPB_TYPE_PTR)
+                                       ? user_data_param_idx : -1;
+    callback_info->body = &module->function_bodies[local_func_idx];
+
+    // Замыкание слота перепривязывается к CIF, thunk'у сигнатуры и контексту без повторного выделения
+    ffi_status status = ffi_prep_closure_loc(closure->closure_ptr, &cif->cif,
+                                             callback_select_thunk(cif), closure, closure->executable_code);
     if (status != FFI_OK) {
         ESP_LOGE(TAG, "ffi_prep_closure_loc failed: %d", status);
-        ffi_closure_free(closure->closure_ptr);
-        free(callback_info);
-        free(closure);
+        callback_slot_push(slot_idx);
         return ESPB_ERR_RUNTIME_ERROR;
     }
-
-    // Добавляем замыкание в список активных (потокобезопасно)
-    if (xSemaphoreTake(g_callback_system.mutex, portMAX_DELAY) == pdTRUE) {
-        closure->next = g_callback_system.active_closures;
-        g_callback_system.active_closures = closure;
-        xSemaphoreGive(g_callback_system.mutex);
-    }
+    __atomic_store_n(&slot->state, ESPB_CALLBACK_SLOT_ACTIVE, __ATOMIC_RELEASE);
 
     *out_closure_ptr = closure->executable_code;
     
@@ -566,56 +847,16 @@ EspbResult espb_free_callback_closure(void *closure_ptr) {
         return ESPB_ERR_INVALID_OPERAND;
     }
 
-    EspbCallbackClosure *found_closure = NULL;
-    EspbCallbackClosure *prev_closure = NULL;
-
-    // Ищем замыкание в списке активных (потокобезопасно)
-    if (xSemaphoreTake(g_callback_system.mutex, portMAX_DELAY) == pdTRUE) {
-        EspbCallbackClosure *current = g_callback_system.active_closures;
-        
-        while (current) {
-            if (current->executable_code == closure_ptr) {
-                found_closure = current;
-                
-                // Удаляем из списка
-                if (prev_closure) {
-                    prev_closure->next = current->next;
-                } else {
-                    g_callback_system.active_closures = current->next;
-                }
-                break;
-            }
-            prev_closure = current;
-            current = current->next;
-        }
-        
-        xSemaphoreGive(g_callback_system.mutex);
-    }
-
-    if (!found_closure) {
+    // Слот находится по исполняемому адресу; CAS ACTIVE -> FREE отсекает повторное освобождение
+    uint32_t slot_idx = callback_exec_index_find(closure_ptr);
+    uint32_t expected = ESPB_CALLBACK_SLOT_ACTIVE;
+    if (slot_idx == ESPB_CALLBACK_SLOT_NONE ||
+        !__atomic_compare_exchange_n(&g_callback_system.slots[slot_idx].state, &expected, ESPB_CALLBACK_SLOT_FREE,
+                                     false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
         ESP_LOGW(TAG, "Callback closure not found: %p", closure_ptr);
         return ESPB_ERR_INVALID_OPERAND;
     }
-
-    // Освобождаем ресурсы
-    if (found_closure->closure_ptr) {
-       ESP_LOGD(TAG, "Freeing closure: closure=%p, exec=%p", 
-                 found_closure->closure_ptr, found_closure->executable_code);
-        ffi_closure_free(found_closure->closure_ptr);
-        
-        // Диагностика состояния IRAM pool после освобождения
-#if defined(CONFIG_LIBFFI_USE_IRAM_POOL)
-        extern void iram_pool_debug(void);
-        // ESP_LOGD(TAG, "IRAM pool status after freeing closure:");
-        // iram_pool_debug();
-#endif
-    }
-    
-    if (found_closure->callback_info) {
-        free(found_closure->callback_info);
-    }
-    
-    free(found_closure);
+    callback_slot_push(slot_idx);
 
    ESP_LOGD(TAG, "Freed callback closure: %p", closure_ptr);
     return ESPB_OK;
@@ -22,6 +22,15 @@
 #include "esp_memory_utils.h"
 #include <string.h>
 
+#ifndef CONFIG_ESPB_JIT_CODE_REGION_SIZE
+#define CONFIG_ESPB_JIT_CODE_REGION_SIZE 0
+#endif
+
+#if CONFIG_ESPB_JIT_CODE_REGION_SIZE > 0
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#endif
+
 static const char *TAG = "espb_exec_mem";
 
 static inline void log_ptr_region(const void *p)
@@ -74,8 +83,153 @@ static void *alloc_checked(size_t size, uint32_t caps, const char *caps_name)
     return p;
 }
 
+#if CONFIG_ESPB_JIT_CODE_REGION_SIZE > 0
+// JIT code region: one executable block taken early and carved into 64-byte pages.
+// JIT arena chunks, Xtensa templates and libffi closures all come from here, so module
+// load/unload cycles churn the region instead of fragmenting the executable heap.
+// Allocation is first-fit over a page bitmap; a freed run merges with its free neighbours.
+#define REGION_PAGE  64u
+#define REGION_PAGES (CONFIG_ESPB_JIT_CODE_REGION_SIZE / REGION_PAGE)
+
+enum { REGION_UNINIT = 0, REGION_INSTALLING, REGION_READY, REGION_FAILED };
+
+static struct {
+    uint32_t state;
+    SemaphoreHandle_t lock;
+    uint8_t *base;
+    uint32_t used_map[(REGION_PAGES + 31) / 32];
+    uint16_t run[REGION_PAGES];     // Pages of the allocation starting at this page
+} s_region;
+
+static inline bool region_page_used(size_t page)
+{
+    return (s_region.used_map[page / 32] >> (page % 32)) & 1u;
+}
+
+static void region_mark(size_t first, size_t count, bool used)
+{
+    for (size_t page = first; page < first + count; page++) {
+        if (used) {
+            s_region.used_map[page / 32] |= 1u << (page % 32);
+        } else {
+            s_region.used_map[page / 32] &= ~(1u << (page % 32));
+        }
+    }
+}
+
+static inline bool region_ready(void)
+{
+    return __atomic_load_n(&s_region.state, __ATOMIC_ACQUIRE) == REGION_READY;
+}
+
+static inline bool region_owns(const void *p)
+{
+    return region_ready() && (const uint8_t *)p >= s_region.base &&
+           (const uint8_t *)p < s_region.base + REGION_PAGES * REGION_PAGE;
+}
+
+// Losers of the install race and callers after a failure use the heap.
+void espb_exec_region_init(void)
+{
+    uint32_t expected = REGION_UNINIT;
+    if (!__atomic_compare_exchange_n(&s_region.state, &expected, REGION_INSTALLING, false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return;
+    }
+    s_region.lock = xSemaphoreCreateMutex();
+    s_region.base = (uint8_t *)alloc_checked(REGION_PAGES * REGION_PAGE,
+                                             MALLOC_CAP_EXEC | MALLOC_CAP_INTERNAL | MALLOC_CAP_32BIT,
+                                             "EXEC|INTERNAL|32BIT");
+    if (!s_region.lock || !s_region.base) {
+        ESP_LOGW(TAG, "JIT code region (%u bytes) unavailable, using the exec heap",
+                 (unsigned)(REGION_PAGES * REGION_PAGE));
+        if (s_region.lock) vSemaphoreDelete(s_region.lock);
+        if (s_region.base) heap_caps_free(s_region.base);
+        s_region.lock = NULL;
+        s_region.base = NULL;
+        __atomic_store_n(&s_region.state, REGION_FAILED, __ATOMIC_RELEASE);
+        return;
+    }
+    __atomic_store_n(&s_region.state, REGION_READY, __ATOMIC_RELEASE);
+}
+
+static void *region_alloc(size_t size)
+{
+    size_t need = (size + REGION_PAGE - 1) / REGION_PAGE;
+    if (!region_ready() || need == 0 || need > REGION_PAGES) return NULL;
+
+    void *p = NULL;
+    xSemaphoreTake(s_region.lock, portMAX_DELAY);
+    size_t free_run = 0;
+    for (size_t page = 0; page < REGION_PAGES; page++) {
+        if (region_page_used(page)) {
+            free_run = 0;
+        } else if (++free_run == need) {
+            size_t first = page + 1 - need;
+            region_mark(first, need, true);
+            s_region.run[first] = (uint16_t)need;
+            p = s_region.base + first * REGION_PAGE;
+            break;
+        }
+    }
+    xSemaphoreGive(s_region.lock);
+    return p;
+}
+
+// Keeps the first keep_pages of the allocation at p, returns the rest to the region.
+static void region_trim(void *p, size_t keep_pages)
+{
+    size_t first = ((uint8_t *)p - s_region.base) / REGION_PAGE;
+    xSemaphoreTake(s_region.lock, portMAX_DELAY);
+    size_t count = s_region.run[first];
+    if (keep_pages < count) {
+        region_mark(first + keep_pages, count - keep_pages, false);
+        s_region.run[first] = (uint16_t)keep_pages;
+    }
+    xSemaphoreGive(s_region.lock);
+}
+
+bool espb_exec_region_stats(size_t *out_total, size_t *out_free, size_t *out_largest_free)
+{
+    if (!region_ready()) return false;
+    size_t free_pages = 0, largest = 0, run = 0;
+    xSemaphoreTake(s_region.lock, portMAX_DELAY);
+    for (size_t page = 0; page < REGION_PAGES; page++) {
+        if (region_page_used(page)) {
+            run = 0;
+            continue;
+        }
+        free_pages++;
+        if (++run > largest) largest = run;
+    }
+    xSemaphoreGive(s_region.lock);
+    if (out_total) *out_total = REGION_PAGES * REGION_PAGE;
+    if (out_free) *out_free = free_pages * REGION_PAGE;
+    if (out_largest_free) *out_largest_free = largest * REGION_PAGE;
+    return true;
+}
+#else
+void espb_exec_region_init(void)
+{
+}
+
+bool espb_exec_region_stats(size_t *out_total, size_t *out_free, size_t *out_largest_free)
+{
+    (void)out_total;
+    (void)out_free;
+    (void)out_largest_free;
+    return false;
+}
+#endif // CONFIG_ESPB_JIT_CODE_REGION_SIZE
+
 void *espb_exec_alloc(size_t size)
 {
+#if CONFIG_ESPB_JIT_CODE_REGION_SIZE > 0
+    if (__atomic_load_n(&s_region.state, __ATOMIC_ACQUIRE) == REGION_UNINIT) espb_exec_region_init();
+    void *r = region_alloc(size);
+    if (r) return r;
+#endif
+
     // Preferred: internal, 32-bit addressable executable memory (IRAM).
     void *p = alloc_checked(size, MALLOC_CAP_EXEC | MALLOC_CAP_INTERNAL | MALLOC_CAP_32BIT,
                             "EXEC|INTERNAL|32BIT");
@@ -103,6 +257,23 @@ void *espb_exec_alloc(size_t size)
 
 void *espb_exec_realloc(void *ptr, size_t size)
 {
+#if CONFIG_ESPB_JIT_CODE_REGION_SIZE > 0
+    if (ptr && region_owns(ptr)) {
+        size_t first = ((uint8_t *)ptr - s_region.base) / REGION_PAGE;
+        size_t old_size = (size_t)s_region.run[first] * REGION_PAGE;
+        size_t keep = (size + REGION_PAGE - 1) / REGION_PAGE;
+        if (keep > 0 && keep * REGION_PAGE <= old_size) {
+            // Shrinks stay in place: code that is already emitted keeps its address
+            region_trim(ptr, keep);
+            return ptr;
+        }
+        void *p = espb_exec_alloc(size);
+        if (!p) return NULL;
+        memcpy(p, ptr, old_size < size ? old_size : size);
+        espb_exec_free(ptr);
+        return p;
+    }
+#endif
     void *p = heap_caps_realloc(ptr, size, MALLOC_CAP_EXEC | MALLOC_CAP_INTERNAL | MALLOC_CAP_32BIT);
     if (!p) {
         p = espb_exec_alloc(size);
@@ -117,6 +288,12 @@ void *espb_exec_realloc(void *ptr, size_t size)
 
 void espb_exec_free(void *ptr)
 {
+#if CONFIG_ESPB_JIT_CODE_REGION_SIZE > 0
+    if (ptr && region_owns(ptr)) {
+        region_trim(ptr, 0);
+        return;
+    }
+#endif
     if (ptr)
         heap_caps_free(ptr);
 }
@@ -0,0 +1,41 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "espb_fuel.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#if CONFIG_ESPB_FUEL
+
+__attribute__((noinline, cold))
+bool espb_fuel_refill(EspbInstance *instance) {
+    EspbFuelHandler handler = instance->fuel_handler;
+    if (handler) {
+        if (!handler(instance, instance->fuel_user_data)) {
+            instance->fuel = 0;
+            return false;
+        }
+    } else {
+        taskYIELD();
+    }
+    // Обработчик мог сменить порцию через espb_set_fuel
+    instance->fuel = instance->fuel_slice;
+    return true;
+}
+
+#endif // CONFIG_ESPB_FUEL
@@ -0,0 +1,405 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "espb_green.h"
+#include "espb_interpreter_runtime.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if CONFIG_ESPB_GREEN_THREADS
+
+static const char *TAG = "espb_green";
+
+#define GREEN_SPARE_CTX 4   // Контексты завершённых потоков, оставляемые для следующих
+
+struct EspbGreenThread {
+    EspbGreenThread *next;
+    EspbInstance *instance;
+    ExecutionContext *ctx;
+    uint32_t func_idx;
+    bool started;
+    uint8_t priority;
+    uint32_t slice;                // Квант топлива на запуск (0 - порция экземпляра)
+    uint32_t pass;                 // Проход espb_green_run_once, в котором поток встал в очередь
+    TickType_t wake_tick;
+    EspbGreenDoneFn done;
+    void *user_data;
+    Value args[ESPB_GREEN_MAX_ARGS];
+};
+
+typedef struct EspbGreenModule {
+    struct EspbGreenModule *next;
+    const EspbInstance *instance;
+    uint8_t priority;
+    uint32_t slice;
+} EspbGreenModule;
+
+struct EspbGreenScheduler {
+    EspbGreenThread *ready_head[CONFIG_ESPB_GREEN_PRIORITIES]; // FIFO готовых потоков по приоритетам
+    EspbGreenThread *ready_tail[CONFIG_ESPB_GREEN_PRIORITIES];
+    EspbGreenThread *sleeping;     // Спящие, по возрастанию wake_tick
+    EspbGreenModule *modules;      // Настройки espb_green_set_module
+    uint32_t num_threads;
+    uint32_t pass;
+    ExecutionContext *spare_ctx[GREEN_SPARE_CTX];
+    uint32_t num_spare_ctx;
+    SemaphoreHandle_t lock;        // Очереди, модули и счётчики: spawn из других задач и исполнители
+    SemaphoreHandle_t work;        // Будит исполнителя: появился готовый поток, сменился первый спящий
+    SemaphoreHandle_t stopped;     // Отдаётся каждым исполнителем перед самоудалением
+    uint32_t num_workers;
+    bool stopping;
+};
+
+#define GREEN_LOCK(sched) xSemaphoreTake((sched)->lock, portMAX_DELAY)
+#define GREEN_UNLOCK(sched) xSemaphoreGive((sched)->lock)
+
+// Сравнение тиков с учётом переполнения счётчика
+static inline bool tick_reached(TickType_t now, TickType_t tick) {
+    return (int32_t)(now - tick) >= 0;
+}
+
+static inline void green_notify(EspbGreenScheduler *sched) {
+    if (sched->num_workers > 0) xSemaphoreGive(sched->work);
+}
+
+static void green_push_ready(EspbGreenScheduler *sched, EspbGreenThread *thread) {
+    uint8_t level = thread->priority;
+    thread->next = NULL;
+    thread->pass = sched->pass;
+    if (sched->ready_tail[level]) sched->ready_tail[level]->next = thread;
+    else sched->ready_head[level] = thread;
+    sched->ready_tail[level] = thread;
+}
+
+static void green_push_sleeping(EspbGreenScheduler *sched, EspbGreenThread *thread) {
+    EspbGreenThread **link = &sched->sleeping;
+    while (*link && tick_reached(thread->wake_tick, (*link)->wake_tick)) link = &(*link)->next;
+    thread->next = *link;
+    *link = thread;
+}
+
+static void green_wake_due(EspbGreenScheduler *sched, TickType_t now) {
+    while (sched->sleeping && tick_reached(now, sched->sleeping->wake_tick)) {
+        EspbGreenThread *thread = sched->sleeping;
+        sched->sleeping = thread->next;
+        green_push_ready(sched, thread);
+    }
+}
+
+// Самый приоритетный уровень с готовыми потоками, -1 - готовых нет
+static int green_top_level(const EspbGreenScheduler *sched) {
+    for (int level = CONFIG_ESPB_GREEN_PRIORITIES - 1; level >= 0; level--) {
+        if (sched->ready_head[level]) return level;
+    }
+    return -1;
+}
+
+static EspbGreenThread *green_pop_ready(EspbGreenScheduler *sched, int level) {
+    EspbGreenThread *thread = sched->ready_head[level];
+    sched->ready_head[level] = thread->next;
+    if (!thread->next) sched->ready_tail[level] = NULL;
+    return thread;
+}
+
+static uint32_t green_wait_ticks(const EspbGreenScheduler *sched, TickType_t now) {
+    if (green_top_level(sched) >= 0) return 0;
+    if (!sched->sleeping) return portMAX_DELAY;
+    TickType_t wake = sched->sleeping->wake_tick;
+    return tick_reached(now, wake) ? 0 : (uint32_t)(wake - now);
+}
+
+static void green_free_list(EspbGreenThread *thread) {
+    while (thread) {
+        EspbGreenThread *next = thread->next;
+        free_execution_context(thread->ctx);
+        free(thread);
+        thread = next;
+    }
+}
+
+EspbResult espb_green_scheduler_create(EspbGreenScheduler **out_sched) {
+    if (!out_sched) return ESPB_ERR_INVALID_OPERAND;
+    EspbGreenScheduler *sched = (EspbGreenScheduler *)calloc(1, sizeof(*sched));
+    if (!sched) return ESPB_ERR_MEMORY_ALLOC;
+    sched->lock = xSemaphoreCreateMutex();
+    if (!sched->lock) {
+        free(sched);
+        return ESPB_ERR_MEMORY_ALLOC;
+    }
+    *out_sched = sched;
+    return ESPB_OK;
+}
+
+void espb_green_scheduler_free(EspbGreenScheduler *sched) {
+    if (!sched) return;
+    espb_green_stop_workers(sched);
+    for (int level = 0; level < CONFIG_ESPB_GREEN_PRIORITIES; level++) {
+        green_free_list(sched->ready_head[level]);
+    }
+    green_free_list(sched->sleeping);
+    while (sched->modules) {
+        EspbGreenModule *next = sched->modules->next;
+        free(sched->modules);
+        sched->modules = next;
+    }
+    for (uint32_t i = 0; i < sched->num_spare_ctx; i++) free_execution_context(sched->spare_ctx[i]);
+    vSemaphoreDelete(sched->lock);
+    free(sched);
+}
+
+EspbResult espb_green_set_module(EspbGreenScheduler *sched, const EspbInstance *instance,
+                                 uint8_t priority, uint32_t slice) {
+    if (!sched || !instance || priority >= CONFIG_ESPB_GREEN_PRIORITIES || slice > INT32_MAX) {
+        return ESPB_ERR_INVALID_OPERAND;
+    }
+    EspbResult res = ESPB_OK;
+    GREEN_LOCK(sched);
+    EspbGreenModule *mod = sched->modules;
+    while (mod && mod->instance != instance) mod = mod->next;
+    if (!mod) {
+        mod = (EspbGreenModule *)calloc(1, sizeof(*mod));
+        if (mod) {
+            mod->instance = instance;
+            mod->next = sched->modules;
+            sched->modules = mod;
+        } else {
+            res = ESPB_ERR_MEMORY_ALLOC;
+        }
+    }
+    if (mod) {
+        mod->priority = priority;
+        mod->slice = slice;
+    }
+    GREEN_UNLOCK(sched);
+    return res;
+}
+
+EspbResult espb_green_spawn(EspbGreenScheduler *sched, EspbInstance *instance, uint32_t func_idx,
+                            const Value *args, EspbGreenDoneFn done, void *user_data,
+                            EspbGreenThread **out_thread) {
+    if (!sched || !instance || !instance->module) return ESPB_ERR_INVALID_OPERAND;
+    const EspbModule *module = instance->module;
+    if (func_idx < module->num_imported_funcs || func_idx >= module->num_imported_funcs + module->num_functions) {
+        return ESPB_ERR_INVALID_FUNC_INDEX;
+    }
+    uint32_t local_idx = func_idx - module->num_imported_funcs;
+    const EspbFuncSignature *sig = &module->signatures[module->function_signature_indices[local_idx]];
+    if (sig->num_params > ESPB_GREEN_MAX_ARGS || (sig->num_params > 0 && !args)) {
+        return ESPB_ERR_INVALID_OPERAND;
+    }
+
+    EspbGreenThread *thread = (EspbGreenThread *)calloc(1, sizeof(*thread));
+    if (!thread) return ESPB_ERR_MEMORY_ALLOC;
+
+    GREEN_LOCK(sched);
+    if (sched->num_spare_ctx > 0) thread->ctx = sched->spare_ctx[--sched->num_spare_ctx];
+    for (const EspbGreenModule *mod = sched->modules; mod; mod = mod->next) {
+        if (mod->instance == instance) {
+            thread->priority = mod->priority;
+            thread->slice = mod->slice;
+            break;
+        }
+    }
+    GREEN_UNLOCK(sched);
+
+    if (!thread->ctx) thread->ctx = init_execution_context();
+    if (!thread->ctx) {
+        free(thread);
+        return ESPB_ERR_MEMORY_ALLOC;
+    }
+    thread->ctx->green = true;
+    thread->instance = instance;
+    thread->func_idx = func_idx;
+    thread->done = done;
+    thread->user_data = user_data;
+    if (sig->num_params > 0) memcpy(thread->args, args, sig->num_params * sizeof(Value));
+    if (out_thread) *out_thread = thread;
+
+    GREEN_LOCK(sched);
+    green_push_ready(sched, thread);
+    sched->num_threads++;
+    green_notify(sched);
+    GREEN_UNLOCK(sched);
+    return ESPB_OK;
+}
+
+// Исполняет поток до остановки или завершения; завершённый поток освобождается.
+// Вызывается без блокировки планировщика.
+static void green_step(EspbGreenScheduler *sched, EspbGreenThread *thread) {
+#if CONFIG_ESPB_FUEL
+    thread->instance->fuel = thread->slice ? (int32_t)thread->slice : thread->instance->fuel_slice;
+#endif
+    Value ret = {0};
+    EspbResult res = espb_call_function(thread->instance, thread->ctx, thread->func_idx,
+                                        thread->started ? NULL : thread->args, &ret);
+    thread->started = true;
+
+    if (res == ESPB_SUSPENDED) {
+        uint32_t ticks = thread->ctx->green_wait_ticks;
+        GREEN_LOCK(sched);
+        if (ticks == 0) {
+            // vTaskDelay(0) или исчерпан квант - в конец очереди своего приоритета
+            green_push_ready(sched, thread);
+        } else {
+            thread->wake_tick = xTaskGetTickCount() + (TickType_t)ticks;
+            green_push_sleeping(sched, thread);
+        }
+        green_notify(sched);
+        GREEN_UNLOCK(sched);
+        return;
+    }
+
+    if (res != ESPB_OK) {
+        ESP_LOGE(TAG, "Green thread func_idx=%" PRIu32 " failed: %d", thread->func_idx, (int)res);
+    }
+    if (thread->done) thread->done(thread, res, &ret, thread->user_data);
+
+    // Контекст переживает поток: следующий spawn не выделяет теневой стек заново
+    reset_execution_context(thread->ctx, thread->instance);
+    thread->ctx->green_suspended = false;
+    GREEN_LOCK(sched);
+    sched->num_threads--;
+    if (sched->num_spare_ctx < GREEN_SPARE_CTX) {
+        sched->spare_ctx[sched->num_spare_ctx++] = thread->ctx;
+        thread->ctx = NULL;
+    }
+    GREEN_UNLOCK(sched);
+    if (thread->ctx) free_execution_context(thread->ctx);
+    free(thread);
+}
+
+uint32_t espb_green_run_once(EspbGreenScheduler *sched, uint32_t *out_wait_ticks) {
+    if (!sched) return 0;
+    GREEN_LOCK(sched);
+    green_wake_due(sched, xTaskGetTickCount());
+
+    // Исполняется только верхний уровень с готовыми потоками; потоки, вставшие в очередь
+    // за этот проход, исполняются в следующем
+    int level = green_top_level(sched);
+    uint32_t pass = ++sched->pass;
+    while (level >= 0 && sched->ready_head[level] && sched->ready_head[level]->pass != pass) {
+        EspbGreenThread *thread = green_pop_ready(sched, level);
+        GREEN_UNLOCK(sched);
+        green_step(sched, thread);
+        GREEN_LOCK(sched);
+    }
+
+    if (out_wait_ticks) *out_wait_ticks = green_wait_ticks(sched, xTaskGetTickCount());
+    uint32_t num_threads = sched->num_threads;
+    GREEN_UNLOCK(sched);
+    return num_threads;
+}
+
+void espb_green_run(EspbGreenScheduler *sched) {
+    uint32_t wait_ticks;
+    while (espb_green_run_once(sched, &wait_ticks) > 0) {
+        // Все потоки ждут: единственное настоящее ожидание на задачу
+        if (wait_ticks > 0) vTaskDelay((TickType_t)wait_ticks);
+    }
+}
+
+static void green_worker(void *arg) {
+    EspbGreenScheduler *sched = (EspbGreenScheduler *)arg;
+
+    GREEN_LOCK(sched);
+    while (!sched->stopping) {
+        TickType_t now = xTaskGetTickCount();
+        green_wake_due(sched, now);
+        int level = green_top_level(sched);
+        if (level < 0) {
+            uint32_t wait_ticks = green_wait_ticks(sched, now);
+            GREEN_UNLOCK(sched);
+            xSemaphoreTake(sched->work, (TickType_t)wait_ticks);
+            GREEN_LOCK(sched);
+            continue;
+        }
+        EspbGreenThread *thread = green_pop_ready(sched, level);
+        // Готовые потоки остались - будим следующего исполнителя
+        if (green_top_level(sched) >= 0) xSemaphoreGive(sched->work);
+        GREEN_UNLOCK(sched);
+        green_step(sched, thread);
+        GREEN_LOCK(sched);
+    }
+    GREEN_UNLOCK(sched);
+
+    // Остановку передаём по цепочке следующему исполнителю
+    xSemaphoreGive(sched->work);
+    xSemaphoreGive(sched->stopped);
+    vTaskDelete(NULL);
+}
+
+EspbResult espb_green_start_workers(EspbGreenScheduler *sched, uint32_t num_workers,
+                                    uint32_t stack_size, UBaseType_t priority) {
+    if (!sched || num_workers == 0) return ESPB_ERR_INVALID_OPERAND;
+    if (sched->num_workers > 0) return ESPB_ERR_INVALID_STATE;
+
+    sched->work = xSemaphoreCreateBinary();
+    sched->stopped = xSemaphoreCreateCounting(num_workers, 0);
+    if (!sched->work || !sched->stopped) goto fail;
+    sched->stopping = false;
+
+    for (uint32_t i = 0; i < num_workers; i++) {
+        if (xTaskCreatePinnedToCore(green_worker, "espb_green", stack_size, sched, priority, NULL,
+                                    tskNO_AFFINITY) != pdPASS) {
+            goto fail;
+        }
+        GREEN_LOCK(sched);
+        sched->num_workers++;
+        GREEN_UNLOCK(sched);
+    }
+    // Потоки, поставленные до запуска
+    xSemaphoreGive(sched->work);
+    return ESPB_OK;
+
+fail:
+    if (sched->num_workers > 0) {
+        espb_green_stop_workers(sched);
+        return ESPB_ERR_MEMORY_ALLOC;
+    }
+    if (sched->work) vSemaphoreDelete(sched->work);
+    if (sched->stopped) vSemaphoreDelete(sched->stopped);
+    sched->work = NULL;
+    sched->stopped = NULL;
+    return ESPB_ERR_MEMORY_ALLOC;
+}
+
+void espb_green_stop_workers(EspbGreenScheduler *sched) {
+    if (!sched || sched->num_workers == 0) return;
+
+    GREEN_LOCK(sched);
+    sched->stopping = true;
+    GREEN_UNLOCK(sched);
+    xSemaphoreGive(sched->work);
+    for (uint32_t i = 0; i < sched->num_workers; i++) {
+        xSemaphoreTake(sched->stopped, portMAX_DELAY);
+    }
+
+    vSemaphoreDelete(sched->work);
+    vSemaphoreDelete(sched->stopped);
+    sched->work = NULL;
+    sched->stopped = NULL;
+    sched->num_workers = 0;
+    sched->stopping = false;
+}
+
+#endif // CONFIG_ESPB_GREEN_THREADS
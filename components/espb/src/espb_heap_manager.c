@@ -16,14 +16,213 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include "espb_heap_manager.h"
+#include "espb_memory_stats.h"
 #include "esp_log.h"
+#include "esp_heap_caps.h"
+#include <stdlib.h>
 #include <string.h>
 
 static const char *TAG = "espb_heap";
 
+// Путь malloc/free гостя горячий: отладочные логи и самопроверки собираются только
+// с ESPB_HEAP_DEBUG=1.
+#ifndef ESPB_HEAP_DEBUG
+#define ESPB_HEAP_DEBUG 0
+#endif
+#if ESPB_HEAP_DEBUG
+#define HEAP_LOGD ESP_LOGD
+#else
+#define HEAP_LOGD(tag, fmt, ...) ((void)0)
+#endif
+
+#ifndef CONFIG_ESPB_HEAP_GROW_STEP
+#define CONFIG_ESPB_HEAP_GROW_STEP 4096
+#endif
+
+// CONFIG_ESPB_CONCURRENT_CALLS: куча гостя общая для всех задач, исполняющих экземпляр.
+// Публичные функции берут heap_mutex экземпляра, внутренние (heap_*) вызываются под ним.
+#if CONFIG_ESPB_CONCURRENT_CALLS
+#define HEAP_LOCK(inst)   do { if ((inst)->heap_mutex) xSemaphoreTake((inst)->heap_mutex, portMAX_DELAY); } while (0)
+#define HEAP_UNLOCK(inst) do { if ((inst)->heap_mutex) xSemaphoreGive((inst)->heap_mutex); } while (0)
+#else
+#define HEAP_LOCK(inst)   ((void)(inst))
+#define HEAP_UNLOCK(inst) ((void)(inst))
+#endif
+
+// Служебные структуры multi_heap в начале каждого региона
+#define HEAP_REGION_OVERHEAD 512u
+
+uint32_t espb_memory_caps(size_t bytes) {
+#if CONFIG_ESPB_LINEAR_MEMORY_PSRAM_THRESHOLD > 0
+    if (bytes >= CONFIG_ESPB_LINEAR_MEMORY_PSRAM_THRESHOLD) return MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT;
+    return MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT;
+#else
+    (void)bytes;
+    return MALLOC_CAP_8BIT;
+#endif
+}
+
+static inline EspbHeapRegion *heap_region_of(EspbInstance *instance, const void *ptr) {
+    EspbHeapContext *heap = &instance->heap_ctx;
+    uintptr_t p = (uintptr_t)ptr;
+    for (uint32_t i = 0; i < heap->num_regions; i++) {
+        EspbHeapRegion *r = &heap->regions[i];
+        if (p - (uintptr_t)r->base < r->size) return r;
+    }
+    return NULL;
+}
+
+// Регионы перебираются по порядку: нулевой (за статическими данными) - самый горячий
+static void *heap_regions_malloc(EspbInstance *instance, size_t size) {
+    EspbHeapContext *heap = &instance->heap_ctx;
+    for (uint32_t i = 0; i < heap->num_regions; i++) {
+        void *p = multi_heap_malloc(heap->regions[i].handle, size);
+        if (p) return p;
+    }
+    return NULL;
+}
+
+static bool heap_add_region(EspbInstance *instance, uint8_t *base, size_t size, bool owned) {
+    EspbHeapContext *heap = &instance->heap_ctx;
+    multi_heap_handle_t handle = multi_heap_register(base, size);
+    if (!handle) {
+        ESP_LOGE(TAG, "multi_heap_register failed for region at %p, size %zu", (void*)base, size);
+        return false;
+    }
+    EspbHeapRegion *r = &heap->regions[heap->num_regions];
+    r->handle = handle;
+    r->base = base;
+    r->size = (uint32_t)size;
+    r->owned = owned;
+    // Проверки границ читают регионы без heap_mutex: запись видна до нового счётчика
+    __atomic_store_n(&heap->num_regions, (uint8_t)(heap->num_regions + 1), __ATOMIC_RELEASE);
+    HEAP_LOGD(TAG, "Heap region %u: %p, %zu bytes%s", (unsigned)(heap->num_regions - 1), (void *)base, size,
+              owned ? " (separate chunk)" : "");
+    return true;
+}
+
+static int32_t memory_grow(EspbInstance *instance, uint32_t delta_pages);
+
+// Куча исчерпана: новый регион не меньше need байт полезного места. Сначала линейная
+// память растёт на месте (регион остаётся внутри memory_data), иначе берётся отдельный
+// блок. Указатели гостя нативные, поэтому разрыв адресов между регионами допустим.
+__attribute__((noinline, cold))
+static bool heap_expand(EspbInstance *instance, size_t need) {
+    EspbHeapContext *heap = &instance->heap_ctx;
+    if (heap->num_regions >= ESPB_HEAP_MAX_REGIONS) return false;
+
+    size_t want = need + HEAP_REGION_OVERHEAD;
+    if (want < CONFIG_ESPB_HEAP_GROW_STEP) want = CONFIG_ESPB_HEAP_GROW_STEP;
+    want = (want + ESPB_MEMORY_PAGE_SIZE - 1) & ~(size_t)(ESPB_MEMORY_PAGE_SIZE - 1);
+
+    uint32_t old_size = instance->memory_size_bytes;
+    if (instance->memory_data && memory_grow(instance, (uint32_t)(want / ESPB_MEMORY_PAGE_SIZE)) >= 0) {
+        if (heap_add_region(instance, instance->memory_data + old_size, want, false)) return true;
+        return false; // Страницы остаются памятью гостя
+    }
+
+#if CONFIG_ESPB_SANDBOX_MASKED
+    return false; // Всё, что вне маски, гостю недоступно
+#else
+    uint32_t caps = espb_memory_caps(want);
+    uint8_t *chunk = (uint8_t *)heap_caps_malloc(want, caps);
+    if (!chunk && caps != MALLOC_CAP_8BIT) chunk = (uint8_t *)heap_caps_malloc(want, MALLOC_CAP_8BIT);
+    if (!chunk) return false;
+    if (!heap_add_region(instance, chunk, want, true)) {
+        heap_caps_free(chunk);
+        return false;
+    }
+    espb_memory_note_peak(instance);
+    return true;
+#endif
+}
+
+bool espb_heap_chunk_contains(const EspbInstance *instance, uintptr_t addr, uint32_t size) {
+    const EspbHeapContext *heap = &instance->heap_ctx;
+    uint32_t num_regions = __atomic_load_n(&heap->num_regions, __ATOMIC_ACQUIRE);
+    for (uint32_t i = 0; i < num_regions; i++) {
+        const EspbHeapRegion *r = &heap->regions[i];
+        if (r->owned && addr - (uintptr_t)r->base < r->size &&
+            (uint64_t)(addr - (uintptr_t)r->base) + size <= r->size) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#if CONFIG_ESPB_HEAP_SLABS
+// Индекс страницы slab по абсолютному адресу: страницы выровнены на свой размер, поэтому
+// каждая целиком попадает в одну ячейку slab_map, даже если memory_data не выровнена.
+#define SLAB_SHIFT 10
+_Static_assert((1u << SLAB_SHIFT) == ESPB_HEAP_SLAB_SIZE, "SLAB_SHIFT must match ESPB_HEAP_SLAB_SIZE");
+
+static inline uint32_t slab_page_index(const EspbInstance *instance, const void *ptr) {
+    return (uint32_t)(((uintptr_t)ptr >> SLAB_SHIFT) - ((uintptr_t)instance->memory_data >> SLAB_SHIFT));
+}
+
+// Класс размера: 0 - 8 байт, 1 - 16, ... ESPB_HEAP_SLAB_CLASSES-1 - ESPB_HEAP_SLAB_MAX; -1 - крупный
+static inline int slab_class(size_t size) {
+    if (size > ESPB_HEAP_SLAB_MAX) return -1;
+    if (size <= 8) return 0;
+    return 29 - __builtin_clz((uint32_t)size - 1);
+}
+
+// Новая страница класса cls из multi_heap, нарезанная в список свободных блоков.
+// Страницы в multi_heap не возвращаются: освобождённые блоки ждут следующего malloc.
+__attribute__((noinline, cold))
+static bool slab_refill(EspbInstance *instance, int cls) {
+    EspbHeapContext *heap = &instance->heap_ctx;
+    uint8_t *page = NULL;
+    uint32_t idx = 0;
+    // Карта покрывает только линейную память: отдельные блоки под страницы не идут
+    for (uint32_t i = 0; i < heap->num_regions && !page; i++) {
+        if (heap->regions[i].owned) continue;
+        page = (uint8_t *)multi_heap_aligned_alloc(heap->regions[i].handle, ESPB_HEAP_SLAB_SIZE, ESPB_HEAP_SLAB_SIZE);
+        if (!page) continue;
+        idx = slab_page_index(instance, page);
+        if (idx >= heap->slab_map_pages) {
+            multi_heap_aligned_free(heap->regions[i].handle, page);
+            page = NULL;
+        }
+    }
+    if (!page) return false;
+    heap->slab_map[idx] = (uint8_t)(cls + 1);
+
+    size_t block = (size_t)8 << cls;
+    void *head = heap->slab_free[cls];
+    for (size_t off = ESPB_HEAP_SLAB_SIZE; off >= block; ) {
+        off -= block;
+        *(void **)(page + off) = head;
+        head = page + off;
+    }
+    heap->slab_free[cls] = head;
+    HEAP_LOGD(TAG, "Slab page %p for %u-byte blocks", (void *)page, (unsigned)block);
+    return true;
+}
+
+static inline void *slab_alloc(EspbInstance *instance, int cls) {
+    EspbHeapContext *heap = &instance->heap_ctx;
+    void *p = heap->slab_free[cls];
+    if (!p) {
+        if (!slab_refill(instance, cls)) return NULL;
+        p = heap->slab_free[cls];
+    }
+    heap->slab_free[cls] = *(void **)p;
+    return p;
+}
+
+// Класс блока slab по указателю или -1, если блок выделен multi_heap
+static inline int slab_owner_class(const EspbInstance *instance, const void *ptr) {
+    const EspbHeapContext *heap = &instance->heap_ctx;
+    uint32_t idx = slab_page_index(instance, ptr);
+    if (idx >= heap->slab_map_pages) return -1;
+    return (int)heap->slab_map[idx] - 1;
+}
+#endif // CONFIG_ESPB_HEAP_SLABS
+
 EspbResult espb_heap_init(EspbInstance *instance, uint32_t heap_start_offset) {
-    ESP_LOGD(TAG, "=== HEAP_INIT DEBUG === offset=%u", heap_start_offset);
-    ESP_LOGD(TAG, "instance=%p, memory_size=%u", instance, instance ? instance->memory_size_bytes : 0);
+    HEAP_LOGD(TAG, "=== HEAP_INIT DEBUG === offset=%u", heap_start_offset);
+    HEAP_LOGD(TAG, "instance=%p, memory_size=%u", instance, instance ? instance->memory_size_bytes : 0);
     
     if (!instance || instance->heap_ctx.initialized) {
         ESP_LOGE(TAG, "HEAP_INIT FAILED: invalid state");
@@ -31,89 +230,76 @@ EspbResult espb_heap_init(EspbInstance *instance, uint32_t heap_start_offset) {
     }
 
     uint32_t aligned_offset = (heap_start_offset + 7) & ~7;
+    instance->heap_ctx.num_regions = 0;
     
-    if (aligned_offset >= instance->memory_size_bytes) {
+    if (aligned_offset + HEAP_REGION_OVERHEAD >= instance->memory_size_bytes) {
+         // Пустая куча: первый malloc вырастит её (heap_expand)
          ESP_LOGW(TAG, "No space available for heap after static data.");
-         instance->heap_ctx.heap_handle = NULL;
-         instance->heap_ctx.initialized = true; // Mark as initialized (but empty)
-         return ESPB_OK;
+    } else {
+        uint8_t *heap_base = instance->memory_data + aligned_offset;
+        size_t heap_size = instance->memory_size_bytes - aligned_offset;
+        if (!heap_add_region(instance, heap_base, heap_size, false)) {
+            return ESPB_ERR_RUNTIME_ERROR;
+        }
     }
 
-    uint8_t *heap_base = instance->memory_data + aligned_offset;
-    size_t heap_size = instance->memory_size_bytes - aligned_offset;
-
-    instance->heap_ctx.heap_handle = multi_heap_register(heap_base, heap_size);
-    if (!instance->heap_ctx.heap_handle) {
-        ESP_LOGE(TAG, "multi_heap_register failed for region at %p, size %zu", (void*)heap_base, heap_size);
-        return ESPB_ERR_RUNTIME_ERROR;
+#if CONFIG_ESPB_HEAP_SLABS
+    // Карта страниц покрывает всю линейную память вместе с запасом под MEMORY.GROW
+    uintptr_t mem_begin = (uintptr_t)instance->memory_data;
+    uintptr_t mem_end = mem_begin + instance->memory_capacity_bytes;
+    instance->heap_ctx.slab_map_pages =
+        (uint32_t)(((mem_end + ESPB_HEAP_SLAB_SIZE - 1) >> SLAB_SHIFT) - (mem_begin >> SLAB_SHIFT));
+    instance->heap_ctx.slab_map = (uint8_t *)calloc(instance->heap_ctx.slab_map_pages, 1);
+    if (!instance->heap_ctx.slab_map) {
+        instance->heap_ctx.slab_map_pages = 0; // Без карты всё идёт через multi_heap
     }
+#endif
 
     instance->heap_ctx.initialized = true;
-    ESP_LOGD(TAG, "Heap initialized. Base: %p, Size: %zu bytes", (void*)heap_base, heap_size);
+    HEAP_LOGD(TAG, "Heap initialized at offset %u", (unsigned)aligned_offset);
     return ESPB_OK;
 }
 
-void* espb_heap_malloc(EspbInstance *instance, size_t size) {
-    ESP_LOGD(TAG, "=== HEAP_MALLOC DEBUG === size=%zu", size);
-    ESP_LOGD(TAG, "initialized=%d, handle=%p", instance ? instance->heap_ctx.initialized : -1, instance ? instance->heap_ctx.heap_handle : NULL);
-    
-    ESP_LOGD(TAG, "Checking conditions: initialized=%d, size=%zu, handle=%p", 
-             instance->heap_ctx.initialized, size, instance->heap_ctx.heap_handle);
-    
-    if (!instance->heap_ctx.initialized) {
-        ESP_LOGE(TAG, "HEAP_MALLOC FAILED: heap not initialized");
-        return NULL;
-    }
-    if (size == 0) {
-        ESP_LOGE(TAG, "HEAP_MALLOC FAILED: size is 0");
+static void *heap_malloc(EspbInstance *instance, size_t size) {
+    if (size == 0 || !instance->heap_ctx.initialized) {
+        HEAP_LOGD(TAG, "HEAP_MALLOC refused: size=%zu initialized=%d", size, instance->heap_ctx.initialized);
         return NULL;
     }
-    if (!instance->heap_ctx.heap_handle) {
-        ESP_LOGE(TAG, "HEAP_MALLOC FAILED: handle is NULL");
-        return NULL;
+
+#if CONFIG_ESPB_HEAP_SLABS
+    int cls = slab_class(size);
+    if (cls >= 0) {
+        void *p = slab_alloc(instance, cls);
+        if (p) return p;
+        // Под новую страницу места нет: пробуем точный размер в multi_heap
     }
+#endif
 
-    ESP_LOGD(TAG, "About to call multi_heap_malloc with handle=%p, size=%zu", instance->heap_ctx.heap_handle, size);
-    
-    void *ptr = multi_heap_malloc(instance->heap_ctx.heap_handle, size);
-    
-    ESP_LOGD(TAG, "multi_heap_malloc returned: %p", ptr);
-    
+    void *ptr = heap_regions_malloc(instance, size);
     if (ptr == NULL) {
-        ESP_LOGW(TAG, "Malloc failed: size=%zu. Heap may be full.", size);
-        // NOTE: Dynamic expansion is not implemented in this version for simplicity.
-        // It would require a more complex memory management with multiple regions.
-        return NULL;
+        if (!heap_expand(instance, size)) {
+            HEAP_LOGD(TAG, "Malloc failed: size=%zu. Heap is full and cannot grow.", size);
+            return NULL;
+        }
+        ptr = heap_regions_malloc(instance, size);
     }
-    
-    // ИСПРАВЛЕНИЕ: Проверяем что указатель находится внутри линейной памяти
-    uintptr_t abs_ptr = (uintptr_t)ptr;
-    uintptr_t memory_base = (uintptr_t)instance->memory_data;
-    
-    if (abs_ptr < memory_base || abs_ptr >= memory_base + instance->memory_size_bytes) {
-        ESP_LOGE(TAG, "Heap malloc returned pointer outside linear memory! ptr=%p, memory_base=%p, memory_size=%u", 
-                 ptr, (void*)memory_base, instance->memory_size_bytes);
-        multi_heap_free(instance->heap_ctx.heap_handle, ptr);
+
+#if ESPB_HEAP_DEBUG
+    // multi_heap раздаёт только свои регионы
+    if (ptr && !heap_region_of(instance, ptr)) {
+        ESP_LOGE(TAG, "Heap malloc returned pointer outside heap regions! ptr=%p", ptr);
         return NULL;
     }
-    
-    ESP_LOGD(TAG, "SUCCESS: malloc size=%zu -> ptr=%p (offset=%u)", size, ptr, (uint32_t)(abs_ptr - memory_base));
+    HEAP_LOGD(TAG, "SUCCESS: malloc size=%zu -> ptr=%p", size, ptr);
+#endif
     return ptr;
 }
 
-void* espb_heap_malloc_aligned(EspbInstance *instance, size_t size, size_t alignment) {
-    ESP_LOGD(TAG, "=== HEAP_MALLOC_ALIGNED DEBUG === size=%zu, alignment=%zu", size, alignment);
+static void *heap_malloc_aligned(EspbInstance *instance, size_t size, size_t alignment) {
+    HEAP_LOGD(TAG, "=== HEAP_MALLOC_ALIGNED DEBUG === size=%zu, alignment=%zu", size, alignment);
     
-    if (!instance->heap_ctx.initialized) {
-        ESP_LOGE(TAG, "HEAP_MALLOC_ALIGNED FAILED: heap not initialized");
-        return NULL;
-    }
-    if (size == 0) {
-        ESP_LOGE(TAG, "HEAP_MALLOC_ALIGNED FAILED: size is 0");
-        return NULL;
-    }
-    if (!instance->heap_ctx.heap_handle) {
-        ESP_LOGE(TAG, "HEAP_MALLOC_ALIGNED FAILED: handle is NULL");
+    if (!instance->heap_ctx.initialized || size == 0) {
+        HEAP_LOGD(TAG, "HEAP_MALLOC_ALIGNED refused: size=%zu", size);
         return NULL;
     }
     
@@ -125,15 +311,26 @@ void* espb_heap_malloc_aligned(EspbInstance *instance, size_t size, size_t align
     
     // Если alignment <= 4, используем обычный malloc (multi_heap дает выравнивание по 4 байта)
     if (alignment <= 4) {
-        return espb_heap_malloc(instance, size);
+        return heap_malloc(instance, size);
     }
+
+#if CONFIG_ESPB_HEAP_SLABS
+    // Блок slab выровнен на размер своего класса (страница выровнена на ESPB_HEAP_SLAB_SIZE)
+    if (size <= ESPB_HEAP_SLAB_MAX && alignment <= ESPB_HEAP_SLAB_MAX) {
+        void *p = slab_alloc(instance, slab_class(size > alignment ? size : alignment));
+        if (p) return p;
+    }
+#endif
     
     // Для большего выравнивания выделяем память с запасом
     size_t total_size = size + alignment - 1 + sizeof(void*);
-    void *raw_ptr = multi_heap_malloc(instance->heap_ctx.heap_handle, total_size);
+    void *raw_ptr = heap_regions_malloc(instance, total_size);
+    if (raw_ptr == NULL && heap_expand(instance, total_size)) {
+        raw_ptr = heap_regions_malloc(instance, total_size);
+    }
     
     if (raw_ptr == NULL) {
-        ESP_LOGW(TAG, "Aligned malloc failed: size=%zu, alignment=%zu", size, alignment);
+        HEAP_LOGD(TAG, "Aligned malloc failed: size=%zu, alignment=%zu", size, alignment);
         return NULL;
     }
     
@@ -147,78 +344,179 @@ void* espb_heap_malloc_aligned(EspbInstance *instance, size_t size, size_t align
     
     void *aligned_ptr = (void*)aligned_addr;
     
-    // Проверяем что указатель находится в пределах линейной памяти
-    uintptr_t memory_base = (uintptr_t)instance->memory_data;
-    if (aligned_addr < memory_base || aligned_addr >= memory_base + instance->memory_size_bytes) {
-        ESP_LOGE(TAG, "Aligned malloc returned pointer outside linear memory!");
-        multi_heap_free(instance->heap_ctx.heap_handle, raw_ptr);
-        return NULL;
-    }
-    
-    ESP_LOGD(TAG, "SUCCESS: aligned malloc size=%zu align=%zu -> raw=%p aligned=%p", 
+    HEAP_LOGD(TAG, "SUCCESS: aligned malloc size=%zu align=%zu -> raw=%p aligned=%p", 
              size, alignment, raw_ptr, aligned_ptr);
     return aligned_ptr;
 }
 
-void espb_heap_free(EspbInstance *instance, void* ptr) {
-    ESP_LOGD(TAG, "[HEAP_FREE] instance=%p ptr=%p", (void*)instance, ptr);
-    if (!instance->heap_ctx.initialized || ptr == NULL || !instance->heap_ctx.heap_handle) {
-        ESP_LOGD(TAG, "[HEAP_FREE] early return: init=%d ptr=%p handle=%p", 
-                 instance->heap_ctx.initialized, ptr, instance->heap_ctx.heap_handle);
+static void heap_free(EspbInstance *instance, void* ptr) {
+    HEAP_LOGD(TAG, "[HEAP_FREE] instance=%p ptr=%p", (void*)instance, ptr);
+    if (!instance->heap_ctx.initialized || ptr == NULL) {
+        HEAP_LOGD(TAG, "[HEAP_FREE] early return: init=%d ptr=%p", instance->heap_ctx.initialized, ptr);
         return;
     }
+
+#if CONFIG_ESPB_HEAP_SLABS
+    int cls = slab_owner_class(instance, ptr);
+    if (cls >= 0) {
+        *(void **)ptr = instance->heap_ctx.slab_free[cls];
+        instance->heap_ctx.slab_free[cls] = ptr;
+        return;
+    }
+#endif
     
+    EspbHeapRegion *region = heap_region_of(instance, ptr);
+    if (!region) {
+        ESP_LOGE(TAG, "[HEAP_FREE] %p is not a guest heap pointer", ptr);
+        return;
+    }
+
     // Проверяем, является ли это выровненным указателем
     uintptr_t ptr_addr = (uintptr_t)ptr;
-    uintptr_t memory_base = (uintptr_t)instance->memory_data;
-    uintptr_t heap_start = memory_base + instance->static_data_end_offset;
+    uintptr_t heap_start = (uintptr_t)region->base;
     
     // Если указатель выровнен по границе > 4 байт, возможно это aligned allocation
-    if ((ptr_addr & 7) == 0 && ptr_addr >= heap_start) {
+    if ((ptr_addr & 7) == 0 && ptr_addr >= heap_start + sizeof(void*)) {
         // Пытаемся получить оригинальный указатель
         void **orig_storage = (void**)(ptr_addr - sizeof(void*));
         uintptr_t orig_addr = (uintptr_t)(*orig_storage);
         
-        // Проверяем что оригинальный указатель выглядит разумно (в пределах heap области)
-        if (orig_addr >= heap_start && orig_addr < memory_base + instance->memory_size_bytes && 
-            orig_addr < ptr_addr) {
+        // Проверяем что оригинальный указатель выглядит разумно (в том же регионе кучи)
+        if (orig_addr >= heap_start && orig_addr < ptr_addr) {
             // Это похоже на aligned allocation - освобождаем оригинальный указатель
-            ESP_LOGD(TAG, "Free aligned: ptr=%p -> original=%p", ptr, *orig_storage);
-            multi_heap_free(instance->heap_ctx.heap_handle, *orig_storage);
+            HEAP_LOGD(TAG, "Free aligned: ptr=%p -> original=%p", ptr, *orig_storage);
+            multi_heap_free(region->handle, *orig_storage);
             return;
         }
     }
     
     // Обычное освобождение
-    ESP_LOGD(TAG, "Free: ptr=%p", ptr);
-    multi_heap_free(instance->heap_ctx.heap_handle, ptr);
+    HEAP_LOGD(TAG, "Free: ptr=%p", ptr);
+    multi_heap_free(region->handle, ptr);
 }
 
-void* espb_heap_realloc(EspbInstance *instance, void* ptr, size_t new_size) {
-    if (!instance->heap_ctx.initialized || !instance->heap_ctx.heap_handle) {
+static void *heap_realloc(EspbInstance *instance, void* ptr, size_t new_size) {
+    if (!instance->heap_ctx.initialized) {
         return NULL;
     }
     if (ptr == NULL) {
-        return espb_heap_malloc(instance, new_size);
+        return heap_malloc(instance, new_size);
     }
     if (new_size == 0) {
-        espb_heap_free(instance, ptr);
+        heap_free(instance, ptr);
         return NULL;
     }
 
-    void *new_ptr = multi_heap_realloc(instance->heap_ctx.heap_handle, ptr, new_size);
+#if CONFIG_ESPB_HEAP_SLABS
+    int cls = slab_owner_class(instance, ptr);
+    if (cls >= 0) {
+        size_t block = (size_t)8 << cls;
+        if (new_size <= block) return ptr;
+        void *grown = heap_malloc(instance, new_size);
+        if (grown) {
+            memcpy(grown, ptr, block);
+            heap_free(instance, ptr);
+        }
+        return grown;
+    }
+#endif
+
+    EspbHeapRegion *region = heap_region_of(instance, ptr);
+    if (!region) {
+        ESP_LOGE(TAG, "Realloc of %p, which is not a guest heap pointer", ptr);
+        return NULL;
+    }
+    void *new_ptr = multi_heap_realloc(region->handle, ptr, new_size);
     if (new_ptr == NULL) {
-        ESP_LOGW(TAG, "Realloc failed: ptr=%p, new_size=%zu. Heap may be full.", ptr, new_size);
+        // В своём регионе места нет: переносим в другой (или в выросшую кучу)
+        size_t old_size = multi_heap_get_allocated_size(region->handle, ptr);
+        new_ptr = heap_malloc(instance, new_size);
+        if (new_ptr) {
+            memcpy(new_ptr, ptr, old_size < new_size ? old_size : new_size);
+            multi_heap_free(region->handle, ptr);
+        } else {
+            HEAP_LOGD(TAG, "Realloc failed: ptr=%p, new_size=%zu. Heap is full.", ptr, new_size);
+        }
     }
 
-    ESP_LOGD(TAG, "Realloc: ptr=%p, new_size=%zu -> new_ptr=%p", ptr, new_size, new_ptr);
+    HEAP_LOGD(TAG, "Realloc: ptr=%p, new_size=%zu -> new_ptr=%p", ptr, new_size, new_ptr);
+    return new_ptr;
+}
+
+void *espb_heap_malloc(EspbInstance *instance, size_t size) {
+    HEAP_LOCK(instance);
+    void *ptr = heap_malloc(instance, size);
+    HEAP_UNLOCK(instance);
+    return ptr;
+}
+
+void *espb_heap_malloc_aligned(EspbInstance *instance, size_t size, size_t alignment) {
+    HEAP_LOCK(instance);
+    void *ptr = heap_malloc_aligned(instance, size, alignment);
+    HEAP_UNLOCK(instance);
+    return ptr;
+}
+
+void espb_heap_free(EspbInstance *instance, void *ptr) {
+    if (ptr == NULL) return;
+    HEAP_LOCK(instance);
+    heap_free(instance, ptr);
+    HEAP_UNLOCK(instance);
+}
+
+void *espb_heap_realloc(EspbInstance *instance, void *ptr, size_t new_size) {
+    HEAP_LOCK(instance);
+    void *new_ptr = heap_realloc(instance, ptr, new_size);
+    HEAP_UNLOCK(instance);
     return new_ptr;
 }
 
 void espb_heap_deinit(EspbInstance *instance) {
     if (instance && instance->heap_ctx.initialized) {
         instance->heap_ctx.initialized = false;
-        // multi_heap_unregister is not public. The memory will be freed with the instance->memory_data block.
-        ESP_LOGD(TAG, "Heap deinitialized.");
+#if CONFIG_ESPB_HEAP_SLABS
+        free(instance->heap_ctx.slab_map);
+        instance->heap_ctx.slab_map = NULL;
+        instance->heap_ctx.slab_map_pages = 0;
+        memset(instance->heap_ctx.slab_free, 0, sizeof(instance->heap_ctx.slab_free));
+#endif
+        // multi_heap_unregister is not public. Regions inside linear memory are freed with the
+        // instance->memory_data block; separate chunks are freed here.
+        for (uint32_t i = 0; i < instance->heap_ctx.num_regions; i++) {
+            if (instance->heap_ctx.regions[i].owned) heap_caps_free(instance->heap_ctx.regions[i].base);
+        }
+        instance->heap_ctx.num_regions = 0;
+        HEAP_LOGD(TAG, "Heap deinitialized.");
     }
-}
\ No newline at end of file
+}
+
+uint32_t espb_memory_size(const EspbInstance *instance) {
+    return instance->memory_size_bytes / ESPB_MEMORY_PAGE_SIZE;
+}
+
+static int32_t memory_grow(EspbInstance *instance, uint32_t delta_pages) {
+    uint32_t old_pages = instance->memory_size_bytes / ESPB_MEMORY_PAGE_SIZE;
+    if (delta_pages == 0) return (int32_t)old_pages;
+#if CONFIG_ESPB_SANDBOX_MASKED
+    // Маска задаёт размер памяти; хвост за memory_size_bytes занят глобалами
+    return -1;
+#else
+    uint64_t new_size = (uint64_t)instance->memory_size_bytes + (uint64_t)delta_pages * ESPB_MEMORY_PAGE_SIZE;
+    if (new_size > instance->memory_capacity_bytes || new_size > instance->memory_max_size_bytes) {
+        HEAP_LOGD(TAG, "MEMORY.GROW by %u pages refused: size=%u capacity=%u max=%u", (unsigned)delta_pages,
+                 (unsigned)instance->memory_size_bytes, (unsigned)instance->memory_capacity_bytes,
+                 (unsigned)instance->memory_max_size_bytes);
+        return -1;
+    }
+    // Запас обнулён при выделении и до роста гостю не виден
+    __atomic_store_n(&instance->memory_size_bytes, (uint32_t)new_size, __ATOMIC_RELEASE);
+    return (int32_t)old_pages;
+#endif
+}
+
+int32_t espb_memory_grow(EspbInstance *instance, uint32_t delta_pages) {
+    HEAP_LOCK(instance);
+    int32_t old_pages = memory_grow(instance, delta_pages);
+    HEAP_UNLOCK(instance);
+    return old_pages;
+}
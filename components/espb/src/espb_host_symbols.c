@@ -18,6 +18,7 @@
 #include "espb_host_symbols.h"
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include "esp_log.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -29,6 +30,10 @@ static const char *TAG = "espb_symbols";
 typedef struct {
     uint8_t module_num;
     const EspbSymbol *symbols;  // NULL-terminated array (для именованных символов)
+    // Хэш-индекс имён: открытая адресация, слот = индекс символа + 1 (0 - пусто).
+    // NULL - индекс не построен (нет памяти), поиск линейный.
+    uint16_t *name_index;
+    uint32_t name_mask;
     // Fast (index-based) table support
     const EspbSymbolFast *fast_symbols;  // NULL if not used
     uint32_t fast_count;
@@ -49,9 +54,70 @@ static const EspbSymbolFast *g_custom_fast_symbols = NULL;
 static uint32_t g_custom_fast_count = 0;
 
 
+// FNV-1a: имена символов короткие, хэш считается за один проход без strlen
+static inline uint32_t symbol_name_hash(const char *name) {
+    uint32_t h = 2166136261u;
+    while (*name) {
+        h ^= (uint8_t)*name++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Строит индекс имён таблицы при регистрации: поиск при импорте - один хэш и,
+// как правило, одно strcmp вместо прохода по всей таблице.
+static void symbol_table_build_index(ModuleSymbolTable *table) {
+    free(table->name_index);
+    table->name_index = NULL;
+    table->name_mask = 0;
+
+    uint32_t count = 0;
+    while (table->symbols[count].name) count++;
+    if (count == 0 || count >= UINT16_MAX) return;
+
+    uint32_t capacity = 8;
+    while (capacity < count * 2) capacity <<= 1;
+    uint16_t *index = (uint16_t *)calloc(capacity, sizeof(uint16_t));
+    if (!index) {
+        ESP_LOGW(TAG, "No memory for symbol index (%u entries), using linear lookup", (unsigned)count);
+        return;
+    }
+
+    uint32_t mask = capacity - 1;
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t slot = symbol_name_hash(table->symbols[i].name) & mask;
+        while (index[slot]) {
+            // Дубликат имени: как и при линейном поиске, побеждает первая запись
+            if (strcmp(table->symbols[index[slot] - 1].name, table->symbols[i].name) == 0) break;
+            slot = (slot + 1) & mask;
+        }
+        if (!index[slot]) index[slot] = (uint16_t)(i + 1);
+    }
+    table->name_index = index;
+    table->name_mask = mask;
+}
+
+static const void *symbol_table_lookup(const ModuleSymbolTable *table, const char *name) {
+    if (!table->name_index) return espb_lookup_symbol_in_table(table->symbols, name);
+
+    uint32_t slot = symbol_name_hash(name) & table->name_mask;
+    for (uint16_t entry; (entry = table->name_index[slot]) != 0; slot = (slot + 1) & table->name_mask) {
+        const EspbSymbol *sym = &table->symbols[entry - 1];
+        if (strcmp(sym->name, name) == 0) return sym->address;
+    }
+    return NULL;
+}
+
 const void* espb_lookup_symbol_in_table(const EspbSymbol *symbols, const char *name) {
     if (!symbols || !name) return NULL;
-    
+
+    // Зарегистрированная таблица ищется через её индекс
+    for (int i = 0; i < g_num_symbol_tables; i++) {
+        if (g_symbol_tables[i].symbols == symbols && g_symbol_tables[i].name_index) {
+            return symbol_table_lookup(&g_symbol_tables[i], name);
+        }
+    }
+
     for (const EspbSymbol *sym = symbols; sym->name != NULL; sym++) {
         if (strcmp(sym->name, name) == 0) {
             return sym->address;
@@ -74,12 +140,14 @@ void espb_register_symbol_table(uint8_t module_num, const EspbSymbol *symbols) {
         if (g_symbol_tables[i].module_num == module_num) {
             ESP_LOGW(TAG, "Symbol table for module_num %u already registered, replacing", (unsigned)module_num);
             g_symbol_tables[i].symbols = symbols;
+            symbol_table_build_index(&g_symbol_tables[i]);
             return;
         }
     }
 
     g_symbol_tables[g_num_symbol_tables].module_num = module_num;
     g_symbol_tables[g_num_symbol_tables].symbols = symbols;
+    symbol_table_build_index(&g_symbol_tables[g_num_symbol_tables]);
     g_num_symbol_tables++;
 
     ESP_LOGI(TAG, "Registered symbol table for module_num %u", (unsigned)module_num);
@@ -122,7 +190,8 @@ const void* espb_lookup_host_symbol(uint8_t module_num, const char *entity_name)
     // 1) Search exact module_num table first
     for (int i = 0; i < g_num_symbol_tables; i++) {
         if (g_symbol_tables[i].module_num == module_num) {
-            return espb_lookup_symbol_in_table(g_symbol_tables[i].symbols, entity_name);
+            if (!g_symbol_tables[i].symbols) return NULL;
+            return symbol_table_lookup(&g_symbol_tables[i], entity_name);
         }
     }
 
@@ -131,7 +200,8 @@ const void* espb_lookup_host_symbol(uint8_t module_num, const char *entity_name)
         for (uint16_t m = 1; m < 256; m++) {
             for (int i = 0; i < g_num_symbol_tables; i++) {
                 if (g_symbol_tables[i].module_num != (uint8_t)m) continue;
-                const void *addr = espb_lookup_symbol_in_table(g_symbol_tables[i].symbols, entity_name);
+                if (!g_symbol_tables[i].symbols) break;
+                const void *addr = symbol_table_lookup(&g_symbol_tables[i], entity_name);
                 if (addr) return addr;
                 break;
             }
@@ -0,0 +1,51 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "espb_import_profile.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+EspbResult espb_import_profile_init(EspbInstance *instance) {
+    if (!instance || !instance->module) return ESPB_ERR_INVALID_OPERAND;
+#if CONFIG_ESPB_IMPORT_PROFILE
+    EspbImportProfile *prof = (EspbImportProfile *)calloc(1, sizeof(EspbImportProfile));
+    if (!prof) return ESPB_ERR_MEMORY_ALLOC;
+    prof->num_imports = instance->module->num_imports;
+    if (prof->num_imports > 0) {
+        prof->imports = (EspbImportStat *)calloc(prof->num_imports, sizeof(EspbImportStat));
+        if (!prof->imports) {
+            free(prof);
+            return ESPB_ERR_MEMORY_ALLOC;
+        }
+    }
+    instance->import_profile = prof;
+#endif
+    return ESPB_OK;
+}
+
+void espb_import_profile_free(EspbInstance *instance) {
+    if (!instance || !instance->import_profile) return;
+    free(instance->import_profile->imports);
+    free(instance->import_profile);
+    instance->import_profile = NULL;
+}
+
+void espb_import_profile_clear(EspbImportProfile *profile) {
+    if (!profile || !profile->imports) return;
+    memset(profile->imports, 0, profile->num_imports * sizeof(EspbImportStat));
+}
@@ -19,9 +19,10 @@
 #include "espb_interpreter_parser.h"
 #include "espb_host_symbols.h" // import flags (IMPORT_FLAG_*)
 #include "espb_interpreter_reader.h" // Для функций чтения read_u32 и т.д.
+#include "espb_interpreter_threaded.h" // espb_threaded_free_function
+#include "espb_bytecode_opt.h"
 
 #include <stdlib.h> // для malloc, free, calloc
-#include "safe_memory.h"
 #include <string.h> // для memcpy, strdup
 #include <stdio.h>  // для printf (отладка)
 #include <inttypes.h> // для PRIx32 и т.д. (может понадобиться для отладки)
@@ -30,98 +31,50 @@
 // #include "esp_log.h"
 // static const char *TAG = "espb_parser"; 
 
-// Вспомогательная функция для очистки полей EspbModule, связанных с секциями
+// Таблицы модуля живут в его арене (espb_module_arena.h) и по отдельности не освобождаются
+#define MODULE_NEW(module, region, count, type) \
+    ((type *)espb_module_arena_alloc(&(module)->arena, ESPB_MODULE_ARENA_##region, (size_t)(count) * sizeof(type)))
+
+// Вспомогательная функция для очистки полей EspbModule, связанных с секциями.
+// Освобождает только то, что выделяется вне арены (трансляции и оптимизированные тела),
+// сами таблицы уходят вместе с ареной в espb_free_module.
 static void espb_clear_module_sections(EspbModule *module) {
     if (!module) return;
 
-    if (module->section_table) {
-        free(module->section_table);
-        module->section_table = NULL;
-    }
-    if (module->signatures) {
-        for (uint32_t i = 0; i < module->num_signatures; ++i) {
-            if (module->signatures[i].param_types) free(module->signatures[i].param_types);
-            if (module->signatures[i].return_types) free(module->signatures[i].return_types);
-        }
-        free(module->signatures);
-        module->signatures = NULL;
-    }
-    if (module->function_signature_indices) {
-        free(module->function_signature_indices);
-        module->function_signature_indices = NULL;
-    }
     if (module->function_bodies) {
-        // const uint8_t *code указывает на исходный буфер, не освобождаем
-        free(module->function_bodies);
-        module->function_bodies = NULL;
-    }
-    if (module->memories) {
-        free(module->memories);
-        module->memories = NULL;
-    }
-    if (module->globals) {
-        // Данные инициализатора (если init_kind=CONST) являются частью исходного буфера
-        free(module->globals);
-        module->globals = NULL;
-    }
-    if (module->data_segments) {
-        // const uint8_t *offset_expr и const uint8_t *data указывают на исходный буфер
-        free(module->data_segments);
-        module->data_segments = NULL;
-    }
-    if (module->imports) {
-        for (uint32_t i = 0; i < module->num_imports; ++i) {
-            if (module->imports[i].entity_name) free(module->imports[i].entity_name);
-        }
-        free(module->imports);
-        module->imports = NULL;
-    }
-    if (module->exports) {
-        for (uint32_t i = 0; i < module->num_exports; ++i) {
-            if (module->exports[i].name) free(module->exports[i].name);
-        }
-        free(module->exports);
-        module->exports = NULL;
-    }
-    if (module->relocations) {
-        free(module->relocations);
-        module->relocations = NULL;
-    }
-    if (module->tables) {
-        free(module->tables);
-        module->tables = NULL;
-    }
-    if (module->element_segments) {
-        for (uint32_t i = 0; i < module->num_element_segments; ++i) {
-            // const uint8_t* offset_expr указывает на исходный буфер
-            if (module->element_segments[i].function_indices) free(module->element_segments[i].function_indices);
-        }
-        free(module->element_segments);
-        module->element_segments = NULL;
-    }
-    // Очистка cbmeta
-    if (module->cbmeta.signatures) {
-        free(module->cbmeta.signatures);
-        module->cbmeta.signatures = NULL;
-    }
-    if (module->cbmeta.imports) {
-        free(module->cbmeta.imports);
-        module->cbmeta.imports = NULL;
-    }
-    
-    // Очистка immeta данных
-    if (module->immeta.imports) {
-        for (uint16_t i = 0; i < module->immeta.num_imports_with_meta; ++i) {
-            if (module->immeta.imports[i].args) {
-                free(module->immeta.imports[i].args);
-            }
-        }
-        free(module->immeta.imports);
-        module->immeta.imports = NULL;
-    }
-    module->immeta.num_imports_with_meta = 0;
-    module->cbmeta.num_signatures = 0;
-    module->cbmeta.num_imports_with_cb = 0;
+        // const uint8_t *code указывает на исходный буфер или на optimized_code
+        for (uint32_t i = 0; i < module->num_functions; ++i) {
+            espb_threaded_free_function(&module->function_bodies[i]);
+            free(module->function_bodies[i].jit_osr);
+            free(module->function_bodies[i].jit_pc_map);
+            free(module->function_bodies[i].jit_relocs);
+            free(module->function_bodies[i].optimized_code);
+        }
+    }
+
+    module->section_table = NULL;
+    module->signatures = NULL;
+    module->function_signature_indices = NULL;
+    module->function_bodies = NULL;
+    module->memories = NULL;
+    module->globals = NULL;
+    module->data_segments = NULL;
+    module->imports = NULL;
+    module->exports = NULL;
+    module->export_name_hashes = NULL;
+    module->export_hash_slots = NULL;
+    module->export_hash_mask = 0;
+    module->relocations = NULL;
+    module->tables = NULL;
+    module->element_segments = NULL;
+    memset(&module->cbmeta, 0, sizeof(module->cbmeta));
+    memset(&module->immeta, 0, sizeof(module->immeta));
+    module->func_ptr_map = NULL;
+    module->func_ptr_map_by_index = NULL;
+    module->func_ptr_map_by_index_size = 0;
+    module->func_ptr_hash_slots = NULL;
+    module->func_ptr_hash_mask = 0;
+    module->num_func_ptr_map_entries = 0;
     // Обнуляем счетчики
     module->num_signatures = 0;
     module->num_functions = 0;
@@ -245,7 +198,7 @@ EspbResult espb_parse_header_and_sections(EspbModule *module, const uint8_t *buf
     }
 
     // 4. Выделение памяти для таблицы секций
-    module->section_table = (SectionHeaderEntry *)SAFE_CALLOC(module->header.num_sections, sizeof(SectionHeaderEntry));
+    module->section_table = MODULE_NEW(module, COLD, module->header.num_sections, SectionHeaderEntry);
     if (!module->section_table) {
         // ESP_LOGE(TAG, "Failed to allocate memory for section table");
         fprintf(stderr, "Failed to allocate memory for section table\n");
@@ -262,7 +215,6 @@ EspbResult espb_parse_header_and_sections(EspbModule *module, const uint8_t *buf
             !read_u8(&ptr, end_ptr, &reserve_byte) ||
             !read_u16(&ptr, end_ptr, &reserve_ushort)) {
             fprintf(stderr, "Failed to read section header part for entry %hu\n", i);
-            free(module->section_table);
             module->section_table = NULL;
             return ESPB_ERR_INVALID_SECTION_TABLE;
         }
@@ -283,7 +235,6 @@ EspbResult espb_parse_header_and_sections(EspbModule *module, const uint8_t *buf
 
         if (!read_u32(&ptr, end_ptr, &sec_offset)) {
             fprintf(stderr, "Failed to read section offset for entry %hu\n", i);
-            free(module->section_table);
             module->section_table = NULL;
             return ESPB_ERR_INVALID_SECTION_TABLE;
         }
@@ -298,7 +249,6 @@ EspbResult espb_parse_header_and_sections(EspbModule *module, const uint8_t *buf
         
         if (!read_u32(&ptr, end_ptr, &sec_size)) {
             fprintf(stderr, "Failed to read section size for entry %hu\n", i);
-            free(module->section_table);
             module->section_table = NULL;
             return ESPB_ERR_INVALID_SECTION_TABLE;
         }
@@ -343,7 +293,6 @@ EspbResult espb_parse_header_and_sections(EspbModule *module, const uint8_t *buf
                     (unsigned int)module->section_table[i].section_offset,
                     (unsigned int)module->section_table[i].section_size,
                     buffer_size);
-            free(module->section_table);
             module->section_table = NULL;
             return ESPB_ERR_INVALID_SECTION_TABLE;
         }
@@ -401,7 +350,7 @@ EspbResult espb_parse_types_section(EspbModule *module) {
         return ESPB_ERR_MEMORY_ALLOC; // Или другой код
     }
 
-    module->signatures = (EspbFuncSignature *)calloc(module->num_signatures, sizeof(EspbFuncSignature));
+    module->signatures = MODULE_NEW(module, HOT, module->num_signatures, EspbFuncSignature);
     if (!module->signatures) {
         // ESP_LOGE(TAG, "Failed to allocate memory for signatures");
         fprintf(stderr, "Failed to allocate memory for signatures\n");
@@ -420,7 +369,7 @@ EspbResult espb_parse_types_section(EspbModule *module) {
         sig->num_params = num_params;
 
         if (sig->num_params > 0) {
-            sig->param_types = (EspbValueType *)malloc(sig->num_params * sizeof(EspbValueType));
+            sig->param_types = MODULE_NEW(module, HOT, sig->num_params, EspbValueType);
             if (!sig->param_types) {
                 // ESP_LOGE(TAG, "Failed to allocate param_types for signature %u", i);
                 fprintf(stderr, "Failed to allocate param_types for signature %" PRIu32 "\n", i);
@@ -454,7 +403,7 @@ EspbResult espb_parse_types_section(EspbModule *module) {
         }
 
         if (sig->num_returns > 0) {
-            sig->return_types = (EspbValueType *)malloc(sig->num_returns * sizeof(EspbValueType));
+            sig->return_types = MODULE_NEW(module, HOT, sig->num_returns, EspbValueType);
             if (!sig->return_types) {
                 // ESP_LOGE(TAG, "Failed to allocate return_types for signature %u", i);
                 fprintf(stderr, "Failed to allocate return_types for signature %" PRIu32 "\n", i);
@@ -533,7 +482,7 @@ EspbResult espb_parse_functions_section(EspbModule *module) {
         return ESPB_ERR_MEMORY_ALLOC;
     }
 
-    module->function_signature_indices = (uint16_t *)malloc(module->num_functions * sizeof(uint16_t));
+    module->function_signature_indices = MODULE_NEW(module, HOT, module->num_functions, uint16_t);
     if (!module->function_signature_indices) {
         // ESP_LOGE(TAG, "Failed to allocate memory for function_signature_indices");
         fprintf(stderr, "Failed to allocate memory for function_signature_indices\n");
@@ -546,7 +495,6 @@ EspbResult espb_parse_functions_section(EspbModule *module) {
         if (!read_u16(&ptr, end_ptr, &sig_idx)) {
             // ESP_LOGE(TAG, "Failed to read signature index for function %u", i);
             fprintf(stderr, "Failed to read signature index for function %" PRIu32 "\n", i);
-            free(module->function_signature_indices);
             module->function_signature_indices = NULL;
             module->num_functions = 0;
             return ESPB_ERR_INVALID_FUNCTION_SECTION;
@@ -557,7 +505,6 @@ EspbResult espb_parse_functions_section(EspbModule *module) {
                     (unsigned int)sig_idx,
                     (unsigned int)i,
                     (unsigned int)module->num_signatures);
-            free(module->function_signature_indices);
             module->function_signature_indices = NULL;
             module->num_functions = 0;
             return ESPB_ERR_SIGNATURE_OUT_OF_RANGE;
@@ -572,6 +519,41 @@ EspbResult espb_parse_functions_section(EspbModule *module) {
     return ESPB_OK;
 }
 
+// Проверка согласованности метаданных тела функции.
+// Это единственная валидация тела - runtime проверки отключены в релизе. С
+// CONFIG_ESPB_LAZY_FUNCTIONS выполняется при первом вызове (espb_prepare_function).
+EspbResult espb_validate_function_body(const EspbFunctionBody *body, uint32_t i) {
+    if (body->code_size > 0 && body->header.num_virtual_regs == 0) {
+        fprintf(stderr, "ERROR: Func[%" PRIu32 "] validation failed: code_size=%" PRIu32 " but num_virtual_regs=0\n",
+                i, body->code_size);
+        return ESPB_ERR_INVALID_CODE_SECTION;
+    }
+
+    if (body->header.num_virtual_regs > 0 && body->header.max_reg_used >= body->header.num_virtual_regs) {
+        fprintf(stderr, "ERROR: Func[%" PRIu32 "] validation failed: max_reg_used=%u >= num_virtual_regs=%u\n",
+                i, body->header.max_reg_used, body->header.num_virtual_regs);
+        fprintf(stderr, "       This bytecode was generated by an incompatible translator.\n");
+        fprintf(stderr, "       Expected: max_reg_used < num_virtual_regs (max_reg is 0-based index)\n");
+        return ESPB_ERR_INVALID_CODE_SECTION;
+    }
+    
+    // Проверка разумности количества регистров
+    if (body->header.num_virtual_regs > 255) {
+        fprintf(stderr, "ERROR: Func[%" PRIu32 "] has too many virtual registers: %u (max 255)\n",
+                i, body->header.num_virtual_regs);
+        return ESPB_ERR_INVALID_CODE_SECTION;
+    }
+
+    // Если функция использует R7 (stack pointer register), то num_virtual_regs должен быть >= 8
+    // (иначе интерпретатор не может корректно инициализировать locals[7])
+    if (body->header.max_reg_used >= 7 && body->header.num_virtual_regs < 8) {
+        fprintf(stderr, "ERROR: Func[%" PRIu32 "] validation failed: max_reg_used=%u implies R7 usage but num_virtual_regs=%u < 8\n",
+                i, body->header.max_reg_used, body->header.num_virtual_regs);
+        return ESPB_ERR_INVALID_CODE_SECTION;
+    }
+    return ESPB_OK;
+}
+
 EspbResult espb_parse_code_section(EspbModule *module) {
     const uint8_t *section_data = NULL;
     uint32_t section_size = 0;
@@ -623,7 +605,7 @@ EspbResult espb_parse_code_section(EspbModule *module) {
         return ESPB_OK;
     }
 
-    module->function_bodies = (EspbFunctionBody *)calloc(module->num_functions, sizeof(EspbFunctionBody));
+    module->function_bodies = MODULE_NEW(module, HOT, module->num_functions, EspbFunctionBody);
     if (!module->function_bodies) {
         // ESP_LOGE(TAG, "Failed to allocate memory for function_bodies");
         fprintf(stderr, "Failed to allocate memory for function_bodies\n");
@@ -672,45 +654,44 @@ EspbResult espb_parse_code_section(EspbModule *module) {
         body->jit_code = NULL;
         body->jit_code_size = 0;
         body->is_jit_compiled = false;
-        
-        // ВАЛИДАЦИЯ: Проверяем согласованность метаданных
-        // Это единственная валидация при загрузке - runtime проверки отключены в релизе
-        if (body->code_size > 0 && body->header.num_virtual_regs == 0) {
-            fprintf(stderr, "ERROR: Func[%" PRIu32 "] validation failed: code_size=%" PRIu32 " but num_virtual_regs=0\n",
-                    i, body->code_size);
-            goto error_cleanup_code;
+        body->jit_state = ESPB_JIT_STATE_NONE;
+        body->jit_reject = ESPB_JIT_REJECT_NONE;
+        body->tier_up_blocked = false;
+        body->tier_up_counter = 0;
+        body->tier_up_hot = false;
+        body->jit_bg_queued = false;
+        body->jit_osr = NULL;
+        body->jit_pc_map = NULL;
+        body->jit_relocs = NULL;
+
+        // Регистры, обнуляемые при входе: подсказка транслятора, иначе все до max_reg_used.
+        // Регистры выше max_reg_used байт-код не адресует, их обнулять не нужно.
+        if (body->header.flags & ESPB_FUNC_FLAG_ZERO_INIT) {
+            body->zero_init_regs = MIN(body->header.reserved, body->header.num_virtual_regs);
+        } else {
+            body->zero_init_regs = MIN((uint16_t)(body->header.max_reg_used + 1), body->header.num_virtual_regs);
         }
 
-        if (body->header.num_virtual_regs > 0 && body->header.max_reg_used >= body->header.num_virtual_regs) {
-            fprintf(stderr, "ERROR: Func[%" PRIu32 "] validation failed: max_reg_used=%u >= num_virtual_regs=%u\n",
-                    i, body->header.max_reg_used, body->header.num_virtual_regs);
-            fprintf(stderr, "       This bytecode was generated by an incompatible translator.\n");
-            fprintf(stderr, "       Expected: max_reg_used < num_virtual_regs (max_reg is 0-based index)\n");
-            goto error_cleanup_code;
-        }
+        body->regs32 = false; // После оптимизатора байт-кода (espb_parse_code_and_optimize)
+
+        // Прошитый код строится при инстанцировании (espb_threaded_translate_module)
+        body->threaded_code_buffer = NULL;
+        body->threaded_code_size_bytes = 0;
+        body->is_threaded = false;
         
-        // Проверка разумности количества регистров
-        if (body->header.num_virtual_regs > 255) {
-            fprintf(stderr, "ERROR: Func[%" PRIu32 "] has too many virtual registers: %u (max 255)\n",
-                    i, body->header.num_virtual_regs);
+#if !CONFIG_ESPB_LAZY_FUNCTIONS
+        if (espb_validate_function_body(body, i) != ESPB_OK) {
             goto error_cleanup_code;
         }
+#endif
 
-        // Если функция использует R7 (stack pointer register), то num_virtual_regs должен быть >= 8
-        // (иначе интерпретатор не может корректно инициализировать locals[7])
-        if (body->header.max_reg_used >= 7 && body->header.num_virtual_regs < 8) {
-            fprintf(stderr, "ERROR: Func[%" PRIu32 "] validation failed: max_reg_used=%u implies R7 usage but num_virtual_regs=%u < 8\n",
-                    i, body->header.max_reg_used, body->header.num_virtual_regs);
-            goto error_cleanup_code;
-        }
-        
         // Проверка, что мы не вышли за пределы body_size
         if ((size_t)(ptr - body_start_ptr) != body_size) {
             fprintf(stderr, "Mismatch in parsed body size for func %" PRIu32 ": expected %" PRIu32 ", got %zu\n", i, body_size, (size_t)(ptr - body_start_ptr));
             goto error_cleanup_code;
         }
         
-        fprintf(stderr, "DEBUG: Func[%" PRIu32 "]: flags=0x%02X, max_reg=%u, frame_size=%u, num_vregs=%u, code_size=%" PRIu32 " [VALIDATED]\n",
+        fprintf(stderr, "DEBUG: Func[%" PRIu32 "]: flags=0x%02X, max_reg=%u, frame_size=%u, num_vregs=%u, code_size=%" PRIu32 "\n",
                 i, body->header.flags, body->header.max_reg_used, body->header.frame_size, 
                 body->header.num_virtual_regs, body->code_size);
     }
@@ -722,10 +703,7 @@ EspbResult espb_parse_code_section(EspbModule *module) {
     return ESPB_OK;
 
 error_cleanup_code:
-    if (module->function_bodies) {
-        free(module->function_bodies);
-        module->function_bodies = NULL;
-    }
+    module->function_bodies = NULL;
     // num_functions остается, т.к. проблема в Code, а не в Functions
     return ESPB_ERR_INVALID_CODE_SECTION;
 }
@@ -749,7 +727,7 @@ EspbResult espb_parse_memory_section(EspbModule *module) {
     }
 
     if (module->num_memories > 0) {
-        module->memories = (EspbMemoryDesc *)calloc(module->num_memories, sizeof(EspbMemoryDesc));
+        module->memories = MODULE_NEW(module, COLD, module->num_memories, EspbMemoryDesc);
         if (!module->memories) {
             fprintf(stderr, "Failed to allocate memory for memories\n");
             module->num_memories = 0;
@@ -780,11 +758,8 @@ EspbResult espb_parse_memory_section(EspbModule *module) {
     return ESPB_OK;
 
 error_cleanup_mem:
-    if (module->memories) free(module->memories);
+    module->memories = NULL;
     module->num_memories = 0;
-    if (module->cbmeta.signatures) free(module->cbmeta.signatures);
-    if (module->cbmeta.imports) free(module->cbmeta.imports);
-    memset(&module->cbmeta, 0, sizeof(module->cbmeta));
     return ESPB_ERR_INVALID_MEMORY_SECTION;
 }
 EspbResult espb_parse_cbmeta_section(EspbModule *module) {
@@ -815,7 +790,7 @@ EspbResult espb_parse_cbmeta_section(EspbModule *module) {
 
     if (num_sigs > 0) {
         // Поддержка для будущих версий, где могут быть сигнатуры
-        module->cbmeta.signatures = (EspbCbmetaSignature*)calloc(num_sigs, sizeof(EspbCbmetaSignature));
+        module->cbmeta.signatures = MODULE_NEW(module, COLD, num_sigs, EspbCbmetaSignature);
         if (!module->cbmeta.signatures) {
             fprintf(stderr, "Failed to allocate memory for cbmeta signatures\n");
             return ESPB_ERR_MEMORY_ALLOC;
@@ -837,7 +812,7 @@ EspbResult espb_parse_cbmeta_section(EspbModule *module) {
     module->cbmeta.num_imports_with_cb = num_imports_with_cb;
 
     if (num_imports_with_cb > 0) {
-        module->cbmeta.imports = (EspbCbmetaImportEntry*)calloc(num_imports_with_cb, sizeof(EspbCbmetaImportEntry));
+        module->cbmeta.imports = MODULE_NEW(module, COLD, num_imports_with_cb, EspbCbmetaImportEntry);
         if (!module->cbmeta.imports) {
             fprintf(stderr, "Failed to allocate memory for cbmeta imports\n");
             goto error_cleanup_cbmeta;
@@ -878,8 +853,6 @@ EspbResult espb_parse_cbmeta_section(EspbModule *module) {
     return ESPB_OK;
 
 error_cleanup_cbmeta:
-    if (module->cbmeta.signatures) free(module->cbmeta.signatures);
-    if (module->cbmeta.imports) free(module->cbmeta.imports);
     memset(&module->cbmeta, 0, sizeof(module->cbmeta));
     return ESPB_ERR_INVALID_CBMETA_SECTION;
 }
@@ -973,7 +946,7 @@ EspbResult espb_parse_globals_section(EspbModule *module) {
         return ESPB_ERR_MEMORY_ALLOC;
     }
 
-    module->globals = (EspbGlobalDesc *)calloc(module->num_globals, sizeof(EspbGlobalDesc));
+    module->globals = MODULE_NEW(module, HOT, module->num_globals, EspbGlobalDesc);
     if (!module->globals) {
         // ESP_LOGE(TAG, "Failed to allocate memory for globals");
         fprintf(stderr, "Failed to allocate memory for globals\n");
@@ -1054,10 +1027,7 @@ error_cleanup_globals_msg:
     // ESP_LOGE(TAG, "Invalid field value in global descriptor %u", (unsigned int)(i)); // i может быть не инициализировано, если ошибка на первом элементе
     fprintf(stderr, "Invalid field value in global descriptor\n");
 error_cleanup_globals:
-    if (module->globals) {
-        free(module->globals);
-        module->globals = NULL;
-    }
+    module->globals = NULL;
     module->num_globals = 0;
     return ESPB_ERR_INVALID_GLOBAL_SECTION;
 }
@@ -1098,7 +1068,7 @@ EspbResult espb_parse_data_section(EspbModule *module) {
         return ESPB_ERR_MEMORY_ALLOC;
     }
 
-    module->data_segments = (EspbDataSegment *)calloc(module->num_data_segments, sizeof(EspbDataSegment));
+    module->data_segments = MODULE_NEW(module, COLD, module->num_data_segments, EspbDataSegment);
     if (!module->data_segments) {
         // ESP_LOGE(TAG, "Failed to allocate memory for data_segments");
         fprintf(stderr, "Failed to allocate memory for data_segments\n");
@@ -1115,7 +1085,8 @@ EspbResult espb_parse_data_section(EspbModule *module) {
             fprintf(stderr, "Failed to read segment_type for data segment %" PRIu32 "\n", i);
             goto error_cleanup_data;
         }
-        seg->segment_type = seg_type;
+        seg->segment_type = seg_type & (uint8_t)~ESPB_DATA_SEGMENT_READONLY;
+        seg->read_only = (seg_type & ESPB_DATA_SEGMENT_READONLY) != 0;
 
         if (seg->segment_type == 0) { // Active segment
             if (!read_u32(&ptr, end_ptr, &seg->memory_index)) {
@@ -1177,17 +1148,17 @@ EspbResult espb_parse_data_section(EspbModule *module) {
     return ESPB_OK;
 
 error_cleanup_data:
-    if (module->data_segments) {
-        free(module->data_segments);
-        module->data_segments = NULL;
-    }
+    module->data_segments = NULL;
     module->num_data_segments = 0;
     return ESPB_ERR_INVALID_DATA_SECTION;
 }
 
 // Вспомогательная функция для чтения строки (длина u16 + данные)
-// Выделяет память для строки, которую нужно будет освободить.
-static char* read_string(const uint8_t **ptr, const uint8_t *end) {
+// Если за строкой в буфере уже стоит нулевой байт (так бывает почти всегда: дальше идёт
+// kind = FUNC или module_num = 0), возвращает указатель прямо в буфер модуля - для модуля
+// из flash (espb_load_module_from_partition) имя остаётся в flash. Иначе выделяет копию,
+// в холодной области арены модуля.
+static char* read_string(EspbModule *module, const uint8_t **ptr, const uint8_t *end) {
     uint16_t len;
     if (!read_u16(ptr, end, &len)) {
         return NULL;
@@ -1195,10 +1166,15 @@ static char* read_string(const uint8_t **ptr, const uint8_t *end) {
     if (*ptr + len > end) {
         return NULL;
     }
+    if (*ptr + len < end && (*ptr)[len] == '\0') {
+        char *in_place = (char *)*ptr;
+        *ptr += len;
+        return in_place;
+    }
     // Wasm строки не обязательно null-terminated в файле, но strdup создаст null-terminated копию.
     // Если строка может содержать нулевые байты внутри, strndup или memcpy + ручное добавление \0 безопаснее.
     // Для имен модулей/сущностей обычно это не проблема.
-    char *str = (char *)malloc(len + 1); 
+    char *str = MODULE_NEW(module, COLD, len + 1, char);
     if (!str) {
         return NULL;
     }
@@ -1246,7 +1222,7 @@ EspbResult espb_parse_imports_section(EspbModule *module) {
         return ESPB_ERR_MEMORY_ALLOC;
     }
 
-    module->imports = (EspbImportDesc *)calloc(module->num_imports, sizeof(EspbImportDesc));
+    module->imports = MODULE_NEW(module, COLD, module->num_imports, EspbImportDesc);
     if (!module->imports) {
         // ESP_LOGE(TAG, "Failed to allocate memory for imports");
         fprintf(stderr, "Failed to allocate memory for imports\n");
@@ -1286,7 +1262,7 @@ EspbResult espb_parse_imports_section(EspbModule *module) {
                     imp->entity_name = NULL;
                 } else {
                     imp->desc.func.symbol_index = 0;
-                    imp->entity_name = read_string(&ptr, end_ptr);
+                    imp->entity_name = read_string(module, &ptr, end_ptr);
                     if (!imp->entity_name) {
                         fprintf(stderr, "Failed to read entity_name for import %" PRIu32 "\n", i);
                         goto error_cleanup_imports;
@@ -1380,6 +1356,80 @@ error_cleanup_imports:
     return ESPB_ERR_INVALID_IMPORT_SECTION;
 }
 
+// FNV-1a: дешёвый хэш для коротких имён экспортов
+static uint32_t espb_hash_name(const char *name) {
+    uint32_t h = 2166136261u;
+    while (*name) {
+        h ^= (uint8_t)*name++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Строит хэш-индекс имён экспортов (open addressing, linear probing).
+// Таблица заполнена не более чем наполовину, поэтому цепочки проб короткие.
+static EspbResult espb_build_export_index(EspbModule *module) {
+    if (module->num_exports == 0) {
+        return ESPB_OK;
+    }
+
+    uint32_t table_size = 4;
+    while (table_size < module->num_exports * 2) {
+        table_size <<= 1;
+    }
+
+    module->export_name_hashes = MODULE_NEW(module, COLD, module->num_exports, uint32_t);
+    module->export_hash_slots = MODULE_NEW(module, COLD, table_size, uint32_t);
+    if (!module->export_name_hashes || !module->export_hash_slots) {
+        fprintf(stderr, "Failed to allocate export hash index\n");
+        return ESPB_ERR_MEMORY_ALLOC;
+    }
+    memset(module->export_hash_slots, 0xFF, table_size * sizeof(uint32_t)); // UINT32_MAX = пустой слот
+    module->export_hash_mask = table_size - 1;
+
+    for (uint32_t i = 0; i < module->num_exports; ++i) {
+        uint32_t h = espb_hash_name(module->exports[i].name);
+        module->export_name_hashes[i] = h;
+        uint32_t slot = h & module->export_hash_mask;
+        while (module->export_hash_slots[slot] != UINT32_MAX) {
+            slot = (slot + 1) & module->export_hash_mask;
+        }
+        module->export_hash_slots[slot] = i;
+    }
+    return ESPB_OK;
+}
+
+bool espb_find_export(const EspbModule *module, const char *name, EspbExportKind kind, uint32_t *out_export_idx) {
+    if (!module || !name || !out_export_idx) {
+        return false;
+    }
+
+    if (!module->export_hash_slots) {
+        // Индекс не построен (нет экспортов) - линейный поиск как запасной путь
+        for (uint32_t i = 0; i < module->num_exports; ++i) {
+            if (module->exports[i].kind == kind && strcmp(module->exports[i].name, name) == 0) {
+                *out_export_idx = i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    uint32_t h = espb_hash_name(name);
+    uint32_t slot = h & module->export_hash_mask;
+    uint32_t idx;
+    while ((idx = module->export_hash_slots[slot]) != UINT32_MAX) {
+        if (module->export_name_hashes[idx] == h &&
+            module->exports[idx].kind == kind &&
+            strcmp(module->exports[idx].name, name) == 0) {
+            *out_export_idx = idx;
+            return true;
+        }
+        slot = (slot + 1) & module->export_hash_mask;
+    }
+    return false;
+}
+
 EspbResult espb_parse_exports_section(EspbModule *module) {
     const uint8_t *section_data = NULL;
     uint32_t section_size = 0;
@@ -1416,7 +1466,7 @@ EspbResult espb_parse_exports_section(EspbModule *module) {
         return ESPB_ERR_MEMORY_ALLOC;
     }
 
-    module->exports = (EspbExportDesc *)calloc(module->num_exports, sizeof(EspbExportDesc));
+    module->exports = MODULE_NEW(module, COLD, module->num_exports, EspbExportDesc);
     if (!module->exports) {
         // ESP_LOGE(TAG, "Failed to allocate memory for exports");
         fprintf(stderr, "Failed to allocate memory for exports\n");
@@ -1426,7 +1476,7 @@ EspbResult espb_parse_exports_section(EspbModule *module) {
 
     for (uint32_t i = 0; i < module->num_exports; ++i) {
         EspbExportDesc *exp = &module->exports[i];
-        exp->name = read_string(&ptr, end_ptr);
+        exp->name = read_string(module, &ptr, end_ptr);
         if (!exp->name) {
             // ESP_LOGE(TAG, "Failed to read name for export %u", i);
             fprintf(stderr, "Failed to read name for export %" PRIu32 "\n", i);
@@ -1457,7 +1507,7 @@ EspbResult espb_parse_exports_section(EspbModule *module) {
         // ESP_LOGW(TAG, "Extra data at the end of Exports section (%zu bytes)", (size_t)(end_ptr - ptr));
         fprintf(stderr, "Warning: Extra data at the end of Exports section (%zu bytes)\n", (size_t)(end_ptr - ptr));
     }
-    return ESPB_OK;
+    return espb_build_export_index(module);
 
 error_cleanup_exports:
     // espb_free_module позаботится об очистке
@@ -1509,7 +1559,7 @@ EspbResult espb_parse_relocations_section(EspbModule *module) {
         return ESPB_ERR_MEMORY_ALLOC;
     }
 
-    module->relocations = (EspbRelocationEntry *)calloc(module->num_relocations, sizeof(EspbRelocationEntry));
+    module->relocations = MODULE_NEW(module, COLD, module->num_relocations, EspbRelocationEntry);
     if (!module->relocations) {
         // ESP_LOGE(TAG, "Failed to allocate memory for relocations");
         fprintf(stderr, "Failed to allocate memory for relocations\n");
@@ -1550,10 +1600,7 @@ EspbResult espb_parse_relocations_section(EspbModule *module) {
     return ESPB_OK;
 
 error_cleanup_relocs:
-    if (module->relocations) {
-        free(module->relocations);
-        module->relocations = NULL;
-    }
+    module->relocations = NULL;
     module->num_relocations = 0;
     return ESPB_ERR_INVALID_RELOCATION_SECTION;
 }
@@ -1596,7 +1643,7 @@ EspbResult espb_parse_tables_section(EspbModule *module) {
         // Можно вернуть ошибку или просто парсить все, а использовать первую.
     }
 
-    module->tables = (EspbTableDesc *)calloc(module->num_tables, sizeof(EspbTableDesc));
+    module->tables = MODULE_NEW(module, COLD, module->num_tables, EspbTableDesc);
     if (!module->tables) {
         // ESP_LOGE(TAG, "Failed to allocate memory for tables");
         fprintf(stderr, "Failed to allocate memory for tables\n");
@@ -1650,10 +1697,7 @@ EspbResult espb_parse_tables_section(EspbModule *module) {
     return ESPB_OK;
 
 error_cleanup_tables:
-    if (module->tables) {
-        free(module->tables);
-        module->tables = NULL;
-    }
+    module->tables = NULL;
     module->num_tables = 0;
     return ESPB_ERR_INVALID_TABLE_SECTION;
 }
@@ -1695,7 +1739,7 @@ EspbResult espb_parse_element_section(EspbModule *module) {
         return ESPB_ERR_MEMORY_ALLOC;
     }
 
-    module->element_segments = (EspbElementSegment *)calloc(module->num_element_segments, sizeof(EspbElementSegment));
+    module->element_segments = MODULE_NEW(module, COLD, module->num_element_segments, EspbElementSegment);
     if (!module->element_segments) {
         // ESP_LOGE(TAG, "Failed to allocate memory for element_segments");
         fprintf(stderr, "Failed to allocate memory for element_segments\n");
@@ -1788,7 +1832,7 @@ EspbResult espb_parse_element_section(EspbModule *module) {
                 fprintf(stderr, "Too many elements in segment %" PRIu32 ": %" PRIu32 "\n", i, seg->num_elements);
                 goto error_cleanup_elem;
             }
-            seg->function_indices = (uint32_t *)malloc(seg->num_elements * sizeof(uint32_t));
+            seg->function_indices = MODULE_NEW(module, COLD, seg->num_elements, uint32_t);
             if (!seg->function_indices) {
                 // ESP_LOGE(TAG, "Failed to allocate function_indices for element segment %u", i);
                 fprintf(stderr, "Failed to allocate function_indices for element segment %" PRIu32 "\n", i);
@@ -1798,8 +1842,6 @@ EspbResult espb_parse_element_section(EspbModule *module) {
                 if (!read_u32(&ptr, end_ptr, &seg->function_indices[j])) {
                     // ESP_LOGE(TAG, "Failed to read function_index %u for element segment %u", j, i);
                     fprintf(stderr, "Failed to read function_index %" PRIu32 " for element segment %" PRIu32 "\n", j, i);
-                    // free(seg->function_indices); // Освободить частично выделенное
-                    // seg->function_indices = NULL;
                     goto error_cleanup_elem;
                 }
                 // TODO: Валидация function_indices[j] (должен быть < общего числа функций, включая импорты)
@@ -1882,7 +1924,7 @@ EspbResult espb_parse_immeta_section(EspbModule *module) {
     printf("Immeta section: %u imports with marshalling metadata\n", num_imports_with_meta);
 
     if (num_imports_with_meta > 0) {
-        module->immeta.imports = (EspbImmetaImportEntry*)SAFE_CALLOC(num_imports_with_meta, sizeof(EspbImmetaImportEntry));
+        module->immeta.imports = MODULE_NEW(module, COLD, num_imports_with_meta, EspbImmetaImportEntry);
         if (!module->immeta.imports) {
             fprintf(stderr, "Failed to allocate memory for immeta imports\n");
             return ESPB_ERR_MEMORY_ALLOC;
@@ -1907,7 +1949,7 @@ EspbResult espb_parse_immeta_section(EspbModule *module) {
 
             // Выделяем память для args (num_marshalled_args * 5 байт)
             if (entry->num_marshalled_args > 0) {
-                entry->args = (EspbImmetaArgEntry*)SAFE_CALLOC(entry->num_marshalled_args, sizeof(EspbImmetaArgEntry));
+                entry->args = MODULE_NEW(module, COLD, entry->num_marshalled_args, EspbImmetaArgEntry);
                 if (!entry->args) {
                     fprintf(stderr, "Failed to allocate memory for immeta args in entry %" PRIu16 "\n", mi);
                     goto error_cleanup_immeta;
@@ -1970,25 +2012,41 @@ EspbResult espb_parse_immeta_section(EspbModule *module) {
     return ESPB_OK;
 
 error_cleanup_immeta:
-    if (module->immeta.imports) {
-        for (uint16_t i = 0; i < num_imports_with_meta; ++i) {
-            if (module->immeta.imports[i].args) {
-                free(module->immeta.imports[i].args);
-            }
-        }
-        free(module->immeta.imports);
-    }
     memset(&module->immeta, 0, sizeof(module->immeta));
     return ESPB_ERR_INVALID_IMMETA_SECTION;
 }
 
-// Comparator for qsort on EspbFuncPtrMapEntry
-static int compare_func_ptr_map_entries(const void *a, const void *b) {
-    const EspbFuncPtrMapEntry *entry_a = (const EspbFuncPtrMapEntry *)a;
-    const EspbFuncPtrMapEntry *entry_b = (const EspbFuncPtrMapEntry *)b;
-    if (entry_a->data_offset < entry_b->data_offset) return -1;
-    if (entry_a->data_offset > entry_b->data_offset) return 1;
-    return 0;
+// Строит обратный индекс func_ptr_map: data_offset -> запись (open addressing, linear probing).
+// Как и у индекса экспортов, таблица заполнена не более чем наполовину.
+// При повторе смещения используется первая запись.
+static EspbResult espb_build_func_ptr_index(EspbModule *module) {
+    uint32_t num_entries = module->num_func_ptr_map_entries;
+    uint32_t table_size = 4;
+    while (table_size < num_entries * 2) {
+        table_size <<= 1;
+    }
+
+    module->func_ptr_hash_slots = MODULE_NEW(module, HOT, table_size, uint32_t);
+    if (!module->func_ptr_hash_slots) {
+        fprintf(stderr, "Failed to allocate function pointer hash index\n");
+        return ESPB_ERR_MEMORY_ALLOC;
+    }
+    memset(module->func_ptr_hash_slots, 0xFF, table_size * sizeof(uint32_t)); // UINT32_MAX = пустой слот
+    module->func_ptr_hash_mask = table_size - 1;
+
+    for (uint32_t i = 0; i < num_entries; ++i) {
+        uint32_t data_offset = module->func_ptr_map[i].data_offset;
+        uint32_t slot = espb_func_ptr_hash(data_offset) & module->func_ptr_hash_mask;
+        uint32_t e;
+        while ((e = module->func_ptr_hash_slots[slot]) != UINT32_MAX &&
+               module->func_ptr_map[e].data_offset != data_offset) {
+            slot = (slot + 1) & module->func_ptr_hash_mask;
+        }
+        if (e == UINT32_MAX) {
+            module->func_ptr_hash_slots[slot] = i;
+        }
+    }
+    return ESPB_OK;
 }
 
 EspbResult espb_parse_func_ptr_map_section(EspbModule *module) {
@@ -2001,6 +2059,8 @@ EspbResult espb_parse_func_ptr_map_section(EspbModule *module) {
         module->func_ptr_map = NULL;
         module->func_ptr_map_by_index = NULL;
         module->func_ptr_map_by_index_size = 0;
+        module->func_ptr_hash_slots = NULL;
+        module->func_ptr_hash_mask = 0;
         return ESPB_OK;
     }
 
@@ -2027,7 +2087,7 @@ EspbResult espb_parse_func_ptr_map_section(EspbModule *module) {
         return ESPB_ERR_INVALID_DATA_SECTION;
     }
 
-    module->func_ptr_map = (EspbFuncPtrMapEntry *)SAFE_MALLOC(expected_size);
+    module->func_ptr_map = MODULE_NEW(module, HOT, num_entries, EspbFuncPtrMapEntry);
     if (!module->func_ptr_map) {
         fprintf(stderr, "Failed to allocate memory for function pointer map\n");
         module->num_func_ptr_map_entries = 0;
@@ -2039,23 +2099,22 @@ EspbResult espb_parse_func_ptr_map_section(EspbModule *module) {
         if (!read_u32(&ptr, end_ptr, &module->func_ptr_map[i].data_offset) ||
             !read_u16(&ptr, end_ptr, &module->func_ptr_map[i].function_index)) {
             fprintf(stderr, "Failed to read entry %u from Function Pointer Map section.\n", i);
-            free(module->func_ptr_map);
             module->func_ptr_map = NULL;
             module->num_func_ptr_map_entries = 0;
             return ESPB_ERR_INVALID_DATA_SECTION;
         }
     }
     
-    // Сортируем массив для бинарного поиска в рантайме
-    if (num_entries > 0) {
-        qsort(module->func_ptr_map, num_entries, sizeof(EspbFuncPtrMapEntry), compare_func_ptr_map_entries);
-        fprintf(stderr, "DEBUG: Function Pointer Map sorted by data_offset.\n");
+    // Хэш-индекс для поиска функции по указателю в рантайме (CALL_INDIRECT*, JIT helpers)
+    EspbResult index_res = espb_build_func_ptr_index(module);
+    if (index_res != ESPB_OK) {
+        return index_res;
     }
 
     // Build O(1) lookup table: function_index -> data_offset
     if (module->num_functions > 0) {
         module->func_ptr_map_by_index_size = module->num_functions;
-        module->func_ptr_map_by_index = (uint32_t *)SAFE_MALLOC(sizeof(uint32_t) * module->func_ptr_map_by_index_size);
+        module->func_ptr_map_by_index = MODULE_NEW(module, HOT, module->func_ptr_map_by_index_size, uint32_t);
         if (!module->func_ptr_map_by_index) {
             fprintf(stderr, "Failed to allocate func_ptr_map_by_index\n");
             return ESPB_ERR_MEMORY_ALLOC;
@@ -2081,6 +2140,112 @@ EspbResult espb_parse_func_ptr_map_section(EspbModule *module) {
 
     return ESPB_OK;
 }
+// Оценка арены модуля по таблице секций, до разбора. Таблицы с известным счётчиком
+// считаются точно, переменные части (типы сигнатур, копии имён, индексы элементов,
+// аргументы immeta) - сверху по размеру своей секции. Недобор арена покрывает
+// дополнительным блоком, перебор ограничен размером секций.
+#define ARENA_EST(bytes) ((((size_t)(bytes)) + 7u) & ~(size_t)7u)
+
+static void espb_estimate_module_arena(const uint8_t *buffer, size_t buffer_size, size_t *out_hot, size_t *out_cold) {
+    size_t hot = 0, cold = 0;
+    uint32_t num_functions = 0;
+    bool has_func_ptr_map = false;
+    *out_hot = 0;
+    *out_cold = 0;
+
+    const uint8_t *ptr = buffer + 16; // magic, version, flags, features
+    const uint8_t *end_ptr = buffer + buffer_size;
+    uint16_t num_sections;
+    if (buffer_size < 18 || !read_u16(&ptr, end_ptr, &num_sections)) return;
+    cold += ARENA_EST(num_sections * sizeof(SectionHeaderEntry));
+
+    for (uint16_t i = 0; i < num_sections; ++i) {
+        uint8_t sec_id, reserve_byte;
+        uint16_t reserve_ushort;
+        uint32_t off, size;
+        if (!read_u8(&ptr, end_ptr, &sec_id) || !read_u8(&ptr, end_ptr, &reserve_byte) ||
+            !read_u16(&ptr, end_ptr, &reserve_ushort) || !read_u32(&ptr, end_ptr, &off) ||
+            !read_u32(&ptr, end_ptr, &size)) {
+            break;
+        }
+        if (size == 0 || off > buffer_size || size > buffer_size - off) continue;
+
+        const uint8_t *sp = buffer + off;
+        const uint8_t *se = sp + size;
+        uint32_t n = 0;
+        if (sec_id == 10) {
+            uint8_t num_sigs;
+            uint16_t num_cb;
+            if (read_u8(&sp, se, &num_sigs) && read_u16(&sp, se, &num_cb)) {
+                cold += ARENA_EST(num_sigs * sizeof(EspbCbmetaSignature)) + ARENA_EST(num_cb * sizeof(EspbCbmetaImportEntry));
+            }
+            continue;
+        }
+        if (sec_id == 17) {
+            uint16_t num_meta;
+            if (read_u16(&sp, se, &num_meta)) {
+                cold += ARENA_EST(num_meta * sizeof(EspbImmetaImportEntry)) +
+                        (size / 5) * sizeof(EspbImmetaArgEntry) + (size_t)num_meta * 8;
+            }
+            continue;
+        }
+        if (!read_u32(&sp, se, &n)) continue;
+        if (n > size) n = size; // Запись занимает хотя бы байт: счётчик больше секции парсер отвергнет
+
+        switch (sec_id) {
+            case 1: // Types: сигнатуры + по два массива типов
+                hot += ARENA_EST(n * sizeof(EspbFuncSignature)) + size * sizeof(EspbValueType) + (size_t)n * 16;
+                break;
+            case 2: // Imports: копия имени не длиннее своей записи
+                cold += ARENA_EST(n * sizeof(EspbImportDesc)) + size + (size_t)n * 8;
+                break;
+            case 3: // Functions: индексы сигнатур и тела из секции Code
+                num_functions = n;
+                hot += ARENA_EST(n * sizeof(uint16_t)) + ARENA_EST(n * sizeof(EspbFunctionBody));
+                break;
+            case 4:
+                hot += ARENA_EST(n * sizeof(EspbGlobalDesc));
+                break;
+            case 5: { // Exports + хэш-индекс имён
+                uint32_t table_size = 4;
+                while (table_size < n * 2) table_size <<= 1;
+                cold += ARENA_EST(n * sizeof(EspbExportDesc)) + size + (size_t)n * 8 +
+                        ARENA_EST(n * sizeof(uint32_t)) + ARENA_EST(table_size * sizeof(uint32_t));
+                break;
+            }
+            case 8:
+                cold += ARENA_EST(n * sizeof(EspbDataSegment));
+                break;
+            case 9:
+                cold += ARENA_EST(n * sizeof(EspbRelocationEntry));
+                break;
+            case 11:
+                cold += ARENA_EST(n * sizeof(EspbTableDesc));
+                break;
+            case 12: // Element: индексы функций по u32 из самой секции
+                cold += ARENA_EST(n * sizeof(EspbElementSegment)) + size + (size_t)n * 8;
+                break;
+            case 14:
+                cold += ARENA_EST(n * sizeof(EspbMemoryDesc));
+                break;
+            case 18: { // Function Pointer Map + хэш-индекс
+                uint32_t table_size = 4;
+                while (table_size < n * 2) table_size <<= 1;
+                hot += ARENA_EST(n * sizeof(EspbFuncPtrMapEntry)) + ARENA_EST(table_size * sizeof(uint32_t));
+                has_func_ptr_map = true;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    if (has_func_ptr_map) {
+        hot += ARENA_EST(num_functions * sizeof(uint32_t)); // func_ptr_map_by_index
+    }
+    *out_hot = hot;
+    *out_cold = cold;
+}
+
 void espb_free_module(EspbModule *module) {
     if (!module) {
         return;
@@ -2088,17 +2253,65 @@ void espb_free_module(EspbModule *module) {
     // Вызываем вспомогательную функцию для очистки всех полей, связанных с секциями
     espb_clear_module_sections(module);
 
-    if (module->func_ptr_map_by_index) {
-        free(module->func_ptr_map_by_index);
-        module->func_ptr_map_by_index = NULL;
-        module->func_ptr_map_by_index_size = 0;
+    // Таблицы и сама структура модуля лежат в его арене: арена копируется до освобождения
+    EspbModuleArena arena = module->arena;
+    espb_module_arena_destroy(&arena);
+}
+
+static EspbResult espb_parse_code_and_optimize(EspbModule *module) {
+    EspbResult result = espb_parse_code_section(module);
+#if !CONFIG_ESPB_LAZY_FUNCTIONS
+    // С ленивой подготовкой тело оптимизируется при первом вызове
+    if (result == ESPB_OK) {
+        espb_bytecode_optimize_module(module); // Не фатально: неоптимизированные тела остаются как есть
+        for (uint32_t i = 0; i < module->num_functions; ++i) {
+            module->function_bodies[i].regs32 = espb_function_regs32(module, i);
+        }
     }
+#endif
+    return result;
+}
 
-    // Освобождаем саму структуру модуля
-    free(module);
+// Последовательный парсинг всех известных секций.
+// Порядок важен, так как некоторые секции зависят от данных, распарсенных в предыдущих
+// (например, Functions зависит от Types, Code зависит от Functions и т.д.).
+// Каждый шаг читает только свою секцию: потоковый загрузчик выполняет шаг, как только
+// секция получена целиком.
+static const struct {
+    uint8_t section_id;
+    EspbResult (*parse)(EspbModule *module);
+} s_parse_steps[] = {
+    { 1,  espb_parse_types_section },
+    { 2,  espb_parse_imports_section },      // Imports могут ссылаться на Types
+    { 3,  espb_parse_functions_section },
+    { 11, espb_parse_tables_section },
+    { 14, espb_parse_memory_section },
+    { 10, espb_parse_cbmeta_section },
+    { 17, espb_parse_immeta_section },
+    { 4,  espb_parse_globals_section },
+    { 5,  espb_parse_exports_section },
+    { 15, espb_parse_start_section },
+    { 12, espb_parse_element_section },      // Element зависит от Tables и Functions/Imports
+    { 6,  espb_parse_code_and_optimize },
+    { 8,  espb_parse_data_section },         // Data зависит от Memory
+    { 18, espb_parse_func_ptr_map_section },
+    { 9,  espb_parse_relocations_section },
+};
+
+// Секция получена, если все её записи таблицы лежат в первых available байтах.
+// Отсутствующая секция готова сразу.
+static bool espb_section_available(const EspbModule *module, uint8_t section_id, size_t available) {
+    for (uint16_t i = 0; i < module->header.num_sections; ++i) {
+        const SectionHeaderEntry *e = &module->section_table[i];
+        if (e->section_id == section_id && e->section_size > 0 &&
+            (size_t)e->section_offset + e->section_size > available) {
+            return false;
+        }
+    }
+    return true;
 }
 
-EspbResult espb_parse_module(EspbModule **out_module, const uint8_t *buffer, size_t buffer_size) {
+EspbResult espb_parse_module_begin(EspbModule **out_module, const uint8_t *buffer, size_t buffer_size, size_t available) {
     if (!out_module || !buffer) {
         // ESP_LOGE(TAG, "espb_parse_module: Invalid arguments (out_module or buffer is NULL)");
         fprintf(stderr, "espb_parse_module: Invalid arguments (out_module or buffer is NULL)\n");
@@ -2106,55 +2319,71 @@ EspbResult espb_parse_module(EspbModule **out_module, const uint8_t *buffer, siz
     }
 
     *out_module = NULL;
-    EspbModule *module = (EspbModule *)SAFE_CALLOC(1, sizeof(EspbModule));
-    if (!module) {
+    // Размер → заполнение: арена выделяется одним блоком под оценку, дальше парсер
+    // только нарезает её. Ещё не полученные секции в оценку не входят и добираются
+    // дополнительными блоками арены.
+    size_t hot_bytes, cold_bytes;
+    espb_estimate_module_arena(buffer, available, &hot_bytes, &cold_bytes);
+    EspbModuleArena arena;
+    if (!espb_module_arena_init(&arena, ARENA_EST(sizeof(EspbModule)) + hot_bytes, cold_bytes)) {
         // ESP_LOGE(TAG, "Failed to allocate memory for EspbModule");
-        fprintf(stderr, "Failed to allocate memory for EspbModule\n");
+        fprintf(stderr, "Failed to allocate module arena (%zu + %zu bytes)\n", hot_bytes, cold_bytes);
         return ESPB_ERR_MEMORY_ALLOC;
     }
+    EspbModule *module = (EspbModule *)espb_module_arena_alloc(&arena, ESPB_MODULE_ARENA_HOT, sizeof(EspbModule));
+    module->arena = arena; // Дальше арена живёт в самом модуле
 
-    EspbResult result;
-
-    // 1. Парсинг заголовка и таблицы секций
-    result = espb_parse_header_and_sections(module, buffer, buffer_size);
+    // Парсинг заголовка и таблицы секций
+    EspbResult result = espb_parse_header_and_sections(module, buffer, buffer_size);
     if (result != ESPB_OK) {
         // ESP_LOGE(TAG, "Failed to parse header and sections: %d", result);
         fprintf(stderr, "Failed to parse header and sections: %d\n", result);
         espb_free_module(module); // Очистка в случае ошибки
         return result;
     }
+    module->parse_step = 0;
+    *out_module = module;
+    return ESPB_OK;
+}
 
-    // 2. Последовательный парсинг всех известных секций
-    // Порядок важен, так как некоторые секции зависят от данных, распарсенных в предыдущих
-    // (например, Functions зависит от Types, Code зависит от Functions и т.д.)
-
-    if ((result = espb_parse_types_section(module)) != ESPB_OK) goto cleanup_error;
-    if ((result = espb_parse_imports_section(module)) != ESPB_OK) goto cleanup_error; // Imports могут ссылаться на Types
-    if ((result = espb_parse_functions_section(module)) != ESPB_OK) goto cleanup_error;
-    if ((result = espb_parse_tables_section(module)) != ESPB_OK) goto cleanup_error;
-    if ((result = espb_parse_memory_section(module)) != ESPB_OK) goto cleanup_error;
-    if ((result = espb_parse_cbmeta_section(module)) != ESPB_OK) goto cleanup_error;
-    if ((result = espb_parse_immeta_section(module)) != ESPB_OK) goto cleanup_error;
-    if ((result = espb_parse_globals_section(module)) != ESPB_OK) goto cleanup_error;
-    if ((result = espb_parse_exports_section(module)) != ESPB_OK) goto cleanup_error;
-    if ((result = espb_parse_start_section(module)) != ESPB_OK) goto cleanup_error;
-    if ((result = espb_parse_element_section(module)) != ESPB_OK) goto cleanup_error; // Element зависит от Tables и Functions/Imports
-    if ((result = espb_parse_code_section(module)) != ESPB_OK) goto cleanup_error;
-    if ((result = espb_parse_data_section(module)) != ESPB_OK) goto cleanup_error;     // Data зависит от Memory
-    if ((result = espb_parse_func_ptr_map_section(module)) != ESPB_OK) goto cleanup_error;
-    if ((result = espb_parse_relocations_section(module)) != ESPB_OK) goto cleanup_error;
+EspbResult espb_parse_module_advance(EspbModule *module, size_t available, bool *out_done) {
+    const uint8_t num_steps = sizeof(s_parse_steps) / sizeof(s_parse_steps[0]);
+    while (module->parse_step < num_steps) {
+        if (!espb_section_available(module, s_parse_steps[module->parse_step].section_id, available)) {
+            *out_done = false;
+            return ESPB_OK;
+        }
+        EspbResult result = s_parse_steps[module->parse_step].parse(module);
+        if (result != ESPB_OK) {
+            // ESP_LOGE(TAG, "Failed to parse module section: %d", result);
+            fprintf(stderr, "Failed to parse module section %u: %d\n",
+                    (unsigned)s_parse_steps[module->parse_step].section_id, result);
+            return result;
+        }
+        module->parse_step++;
+    }
 
     // TODO: Возможно, здесь нужны дополнительные проверки целостности модуля после парсинга всех секций.
 
-    *out_module = module;
+    fprintf(stderr, "DEBUG: Module arena: %zu bytes\n", module->arena.total);
+    module->refcount = 1; // Ссылка вызывающей стороны; снимается espb_module_release
+    *out_done = true;
     return ESPB_OK;
+}
 
-cleanup_error:
-    // ESP_LOGE(TAG, "Failed to parse module section: %d", result);
-    fprintf(stderr, "Failed to parse module section: %d\n", result);
-    espb_free_module(module);
-    *out_module = NULL;
-    return result;
+EspbResult espb_parse_module(EspbModule **out_module, const uint8_t *buffer, size_t buffer_size) {
+    EspbModule *module = NULL;
+    EspbResult result = espb_parse_module_begin(&module, buffer, buffer_size, buffer_size);
+    if (result != ESPB_OK) return result;
+
+    bool done = false;
+    result = espb_parse_module_advance(module, buffer_size, &done);
+    if (result != ESPB_OK || !done) {
+        espb_free_module(module);
+        return result != ESPB_OK ? result : ESPB_ERR_PARSE_ERROR;
+    }
+    *out_module = module;
+    return ESPB_OK;
 }
 
 // Конец файла main/espb_interpreter_parser.c
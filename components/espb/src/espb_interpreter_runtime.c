@@ -33,17 +33,33 @@
 #include "espb_interpreter_runtime.h"
 #include "safe_memory.h"
 #include "esp_log.h"
+#include "esp_partition.h"
 #include "espb_interpreter_parser.h"
 #include "espb_host_symbols.h"
 #include "sdkconfig.h"
 #include "espb_interpreter.h"
 #include "espb_jit_dispatcher.h"
+#include "espb_profiler.h"
+#include "espb_import_profile.h"
+#include "espb_sampler.h"
+#include "espb_jit_background.h"
+#include "espb_jit_snapshot.h"
 #include "espb_jit.h"
+#include "espb_jit_stats.h"
 #include "espb_jit_precompile.h"
+#include "espb_sandbox.h"
+#include "espb_rodata.h"
+#include "espb_call_ic.h"
+#include "espb_fuel.h"
+#include "espb_marshal_plan.h"
+#include "espb_runtime_ffi_call.h"
+#include "espb_callback_system.h"
+#include "espb_memory_stats.h"
 // espb_interpreter.h должен включать espb_interpreter_common_types.h
 
 // ВКЛЮЧАЕМ ЗАГОЛОВОК ДЛЯ ПЕРЕНЕСЕННОЙ ФУНКЦИИ
 #include "espb_interpreter_runtime_oc.h"
+#include "espb_runtime_ffi_types.h"
 
 
 #include <stdio.h>
@@ -86,20 +102,165 @@ static const char *TAG __attribute__((unused)) = "espb_runtime";
 // espb_lookup_host_symbol is declared in espb_host_symbols.h
 
 
+#ifndef CONFIG_ESPB_LINEAR_MEMORY_HEAP_SIZE
+#define CONFIG_ESPB_LINEAR_MEMORY_HEAP_SIZE 16384
+#endif
+#ifndef CONFIG_ESPB_LINEAR_MEMORY_GROW_RESERVE
+#define CONFIG_ESPB_LINEAR_MEMORY_GROW_RESERVE 0
+#endif
+
+#define MEMORY_PAGE_ROUND(x) \
+    (((uint64_t)(x) + ESPB_MEMORY_PAGE_SIZE - 1) & ~(uint64_t)(ESPB_MEMORY_PAGE_SIZE - 1))
+
+#if CONFIG_ESPB_RODATA_IN_PLACE
+// Сегмент .rodata остаётся в образе модуля, если лежит по константному смещению и не
+// содержит ни цели релокации (её пришлось бы записать), ни адреса из func_ptr_map (по
+// смещению в memory_data распознаются указатели на функции).
+static bool rodata_segment_in_place(const EspbModule *module, const EspbDataSegment *seg, uint32_t *out_start) {
+    if (!seg->read_only || seg->segment_type != 0 || seg->data_size == 0) return false;
+    const uint8_t *expr = seg->offset_expr;
+    if (!expr || seg->offset_expr_len < 5 || expr[0] != 0x01) return false;
+
+    uint32_t start;
+    memcpy(&start, expr + 1, sizeof(start));
+    uint64_t end = (uint64_t)start + seg->data_size;
+    if (end > UINT32_MAX) return false;
+
+    for (uint32_t i = 0; i < module->num_relocations; ++i) {
+        const EspbRelocationEntry *reloc = &module->relocations[i];
+        if (reloc->target_section_id == 7 && (uint64_t)reloc->offset + sizeof(uint32_t) > start && reloc->offset < end) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < module->num_func_ptr_map_entries; ++i) {
+        uint32_t off = module->func_ptr_map[i].data_offset;
+        if (off >= start && off < end) return false;
+    }
+    *out_start = start;
+    return true;
+}
+
+// Заполняет instance->rodata до релокаций: адреса DATA_OFFSET-глобалов уже указывают в flash.
+static EspbResult map_rodata_segments(EspbInstance *instance) {
+    const EspbModule *module = instance->module;
+    uint32_t start;
+    uint32_t count = 0;
+
+    instance->rodata = NULL;
+    instance->num_rodata = 0;
+    for (uint32_t i = 0; i < module->num_data_segments; ++i) {
+        if (rodata_segment_in_place(module, &module->data_segments[i], &start)) count++;
+    }
+    if (count == 0) return ESPB_OK;
+
+    instance->rodata = (EspbRodataSpan *)calloc(count, sizeof(EspbRodataSpan));
+    if (!instance->rodata) return ESPB_ERR_MEMORY_ALLOC;
+    for (uint32_t i = 0; i < module->num_data_segments; ++i) {
+        const EspbDataSegment *seg = &module->data_segments[i];
+        if (!rodata_segment_in_place(module, seg, &start)) continue;
+        EspbRodataSpan *span = &instance->rodata[instance->num_rodata++];
+        span->start = start;
+        span->end = start + seg->data_size;
+        span->data = seg->data;
+        ESPB_RLOG("Runtime: Data segment %lu (%lu bytes at offset %lu) stays in the module image at %p\n",
+               (unsigned long)i, (unsigned long)seg->data_size, (unsigned long)start, (const void *)seg->data);
+    }
+    return ESPB_OK;
+}
+#endif
+
+// Конец статических данных: активные сегменты с константным смещением (I32.CONST) и
+// первый пассивный сегмент, который копируется в смещение 0. Смещение через global.get
+// до выделения глобалов не вычислить - такие сегменты считаются лежащими за остальными.
+static uint64_t linear_memory_static_end(const EspbModule *module) {
+    uint64_t end = 0;
+    uint64_t unplaced = 0;
+    bool passive_seen = false;
+
+    for (uint32_t i = 0; i < module->num_data_segments; ++i) {
+        const EspbDataSegment *seg = &module->data_segments[i];
+#if CONFIG_ESPB_RODATA_IN_PLACE
+        uint32_t rodata_start;
+        if (rodata_segment_in_place(module, seg, &rodata_start)) continue; // Места в памяти не занимает
+#endif
+        if (seg->segment_type == 0) {
+            const uint8_t *expr = seg->offset_expr;
+            if (expr && seg->offset_expr_len >= 5 && expr[0] == 0x01) {
+                uint32_t offset;
+                memcpy(&offset, expr + 1, sizeof(offset));
+                uint64_t seg_end = (uint64_t)offset + seg->data_size;
+                if (seg_end > end) end = seg_end;
+            } else {
+                unplaced += seg->data_size;
+            }
+        } else if (seg->segment_type == 1 && !passive_seen) {
+            passive_seen = true;
+            if (seg->data_size > end) end = seg->data_size;
+        }
+    }
+    return end + unplaced;
+}
+
+// Начальный размер линейной памяти: статические данные плюс куча (в песочнице ещё и
+// глобалы в хвосте), с округлением до страницы. Объявленный в модуле initial_size не
+// используется: транслятор пишет его страницами Wasm по 64 KB.
+static uint64_t linear_memory_required(const EspbModule *module) {
+    uint64_t need = linear_memory_static_end(module) + CONFIG_ESPB_LINEAR_MEMORY_HEAP_SIZE;
+#if CONFIG_ESPB_SANDBOX_MASKED
+    need += (uint64_t)module->num_globals * 16u + 8u;
+    uint64_t size = ESPB_MEMORY_PAGE_SIZE;
+    while (size < need) size <<= 1;
+    return size;
+#else
+    return MEMORY_PAGE_ROUND(need);
+#endif
+}
+
+// Линейная память экземпляра: size байт видимы гостю, capacity - выделено (запас под
+// MEMORY.GROW на месте). В режиме песочницы это 2^n байт, выровненные на свой размер
+// (плюс ESPB_SANDBOX_SLACK), чтобы espb_sandbox_addr() сводился к AND/OR; запаса нет.
+static uint8_t *alloc_linear_memory(EspbInstance *instance, uint32_t size, uint32_t capacity) {
+    uint32_t caps = espb_memory_caps(capacity);
+#if CONFIG_ESPB_SANDBOX_MASKED
+    (void)capacity;
+    if ((size & (size - 1)) != 0) {
+        fprintf(stderr, "Error: CONFIG_ESPB_SANDBOX_MASKED requires a power-of-two linear memory size (got %" PRIu32 ").\n", size);
+        return NULL;
+    }
+    uint8_t *mem = (uint8_t *)heap_caps_aligned_alloc(size, size + ESPB_SANDBOX_SLACK, caps);
+    if (!mem && caps != MALLOC_CAP_8BIT) {
+        mem = (uint8_t *)heap_caps_aligned_alloc(size, size + ESPB_SANDBOX_SLACK, MALLOC_CAP_8BIT);
+    }
+    if (mem) {
+        memset(mem, 0, size + ESPB_SANDBOX_SLACK);
+        instance->memory_mask = size - 1;
+        instance->memory_capacity_bytes = size;
+    }
+    return mem;
+#else
+    uint8_t *mem = (uint8_t *)heap_caps_calloc(1, capacity, caps);
+    if (!mem && caps != MALLOC_CAP_8BIT) {
+        mem = (uint8_t *)SAFE_CALLOC(capacity, 1);
+    }
+    if (mem) instance->memory_capacity_bytes = capacity;
+    (void)size;
+    return mem;
+#endif
+}
+
 static EspbResult allocate_linear_memory(EspbInstance *instance) {
-    // ESP_LOGI(TAG, "Allocating linear memory..."); 
+    // ESP_LOGI(TAG, "Allocating linear memory...");
     ESPB_RLOG("Runtime: Allocating linear memory...\n");
     const EspbModule *module = instance->module;
-    
-    uint32_t initial_pages = 0;
-    uint32_t max_pages = 0; 
+
+    uint32_t max_pages = 0;
     bool has_max = false;
 
     instance->memory_data = NULL;
     instance->memory_size_bytes = 0;
-    // Wasm spec implies it can grow up to 2^16 pages (4GiB for Wasm32) if no max.
-    // Or, implementation can choose a smaller practical limit.
-    instance->memory_max_size_bytes = 0; 
+    instance->memory_capacity_bytes = 0;
+    // Без объявленного максимума память растёт до CONFIG_ESPB_LINEAR_MEMORY_SIZE.
+    instance->memory_max_size_bytes = 0;
 
     const EspbImportDesc *imported_mem_desc = NULL;
     for (uint32_t i = 0; i < module->num_imports; i++) {
@@ -108,7 +269,7 @@ static EspbResult allocate_linear_memory(EspbInstance *instance) {
             if (module->imports[i].module_num == 0 &&
                 module->imports[i].entity_name && strcmp(module->imports[i].entity_name, "memory") == 0) {
                 imported_mem_desc = &module->imports[i];
-                break; 
+                break;
             }
             // Fallback to the first found memory import if "env.memory" is not specifically named.
             if (!imported_mem_desc) {
@@ -120,33 +281,21 @@ static EspbResult allocate_linear_memory(EspbInstance *instance) {
     if (imported_mem_desc) {
         ESPB_RLOG("Runtime: Found imported memory module_num=%u name=%s. Prioritizing it.\n",
                (unsigned)imported_mem_desc->module_num, imported_mem_desc->entity_name);
-        initial_pages = imported_mem_desc->desc.memory.initial_size;
-        if (imported_mem_desc->desc.memory.flags & 0x01) { // has_max
-            max_pages = imported_mem_desc->desc.memory.max_size;
-            has_max = true;
-        }
-        
-        // ESPB Page Size is 1024 bytes
-        uint64_t initial_bytes = (uint64_t)initial_pages * 65536ULL; 
+        uint32_t initial_pages = imported_mem_desc->desc.memory.initial_size;
+        uint64_t initial_bytes = (uint64_t)initial_pages * ESPB_WASM_PAGE_SIZE;
         if (initial_bytes > UINT32_MAX) { // Check against Wasm32 limit for memory size
              fprintf(stderr, "Error: Initial memory size (%" PRIu64 ") bytes for import module_num=%u name=%s exceeds Wasm32 addressable space (UINT32_MAX).\n",
                      initial_bytes, (unsigned)imported_mem_desc->module_num, imported_mem_desc->entity_name);
              return ESPB_ERR_MEMORY_ALLOC;
         }
-        // Используем значение из конфигурации, если оно больше запрошенного размера
+        // Размер памяти хоста рантайму неизвестен: считаем, что это CONFIG_ESPB_LINEAR_MEMORY_SIZE.
+        // Чужой блок не растёт.
         uint32_t configured_size = CONFIG_ESPB_LINEAR_MEMORY_SIZE;
-        // Всегда используем значение из конфигурации
         ESPB_RLOG("Runtime: Using configured linear memory size (%" PRIu32 " bytes) instead of declared size (%" PRIu64 " bytes).\n",
                configured_size, initial_bytes);
         instance->memory_size_bytes = configured_size;
-
-        if (has_max) {
-            uint64_t max_bytes = (uint64_t)max_pages * 65536ULL;
-            instance->memory_max_size_bytes = (max_bytes > UINT32_MAX) ? UINT32_MAX : (uint32_t)max_bytes;
-        } else {
-            // Default Wasm32 max (e.g., 4GiB) if no explicit max, or a practical implementation limit.
-            instance->memory_max_size_bytes = UINT32_MAX; 
-        }
+        instance->memory_capacity_bytes = configured_size;
+        instance->memory_max_size_bytes = configured_size;
 
         if (instance->memory_size_bytes > 0) {
             void* host_mem_ptr = (void*)espb_lookup_host_symbol(imported_mem_desc->module_num, imported_mem_desc->entity_name);
@@ -155,6 +304,15 @@ static EspbResult allocate_linear_memory(EspbInstance *instance) {
                         (unsigned)imported_mem_desc->module_num, imported_mem_desc->entity_name, initial_pages);
                 return ESPB_ERR_IMPORT_RESOLUTION_FAILED;
             }
+#if CONFIG_ESPB_SANDBOX_MASKED
+            uint32_t sz = instance->memory_size_bytes;
+            if ((sz & (sz - 1)) != 0 || ((uintptr_t)host_mem_ptr & (sz - 1)) != 0) {
+                fprintf(stderr, "Error: CONFIG_ESPB_SANDBOX_MASKED requires host memory of 2^n bytes aligned to its size (%p, %" PRIu32 " bytes).\n",
+                        host_mem_ptr, sz);
+                return ESPB_ERR_INSTANTIATION_FAILED;
+            }
+            instance->memory_mask = sz - 1;
+#endif
             instance->memory_data = (uint8_t*)host_mem_ptr;
             // Ensure host memory is at least the initial size.
             // This check might be better done by the host or via a specific host API for memory size.
@@ -166,123 +324,61 @@ static EspbResult allocate_linear_memory(EspbInstance *instance) {
                    (unsigned)imported_mem_desc->module_num, imported_mem_desc->entity_name);
             instance->memory_data = NULL; // memory_size_bytes is already 0
         }
+        return ESPB_OK;
+    }
 
-    } else if (module->num_memories > 0) {
-        if (module->num_memories > 1) {
-            // Current simple interpreter supports only one declared memory (at index 0) if no "env.memory" is imported.
-            fprintf(stderr, "Error: Multiple declared memories found (%" PRIu32 "), but only one (index 0) is supported when 'env.memory' is not imported.\n", module->num_memories);
-            return ESPB_ERR_INSTANTIATION_FAILED; // Or ESPB_ERR_FEATURE_NOT_SUPPORTED
-        }
+    if (module->num_memories > 1) {
+        // Current simple interpreter supports only one declared memory (at index 0) if no "env.memory" is imported.
+        fprintf(stderr, "Error: Multiple declared memories found (%" PRIu32 "), but only one (index 0) is supported when 'env.memory' is not imported.\n", module->num_memories);
+        return ESPB_ERR_INSTANTIATION_FAILED; // Or ESPB_ERR_FEATURE_NOT_SUPPORTED
+    }
+    if (module->num_memories == 1) {
         const EspbMemoryDesc *mem_desc = &module->memories[0]; // Use declared memory at index 0
-        ESPB_RLOG("Runtime: No 'env.memory' import found. Using module's declared memory (index 0).\n");
-        
-        initial_pages = mem_desc->limits.initial_size;
         if (mem_desc->limits.flags & 0x01) { // has_max
             max_pages = mem_desc->limits.max_size;
             has_max = true;
         }
-        ESPB_RLOG("Runtime: Declared memory details: initial_pages=%" PRIu32 ", max_pages=%" PRIu32 ", has_max=%d\n",
-               initial_pages, max_pages, has_max);
-
-        uint64_t initial_bytes = (uint64_t)initial_pages * 65536ULL; // ESPB Page Size
-        if (initial_bytes > UINT32_MAX) {
-             fprintf(stderr, "Error: Initial declared memory size (%" PRIu64 ") bytes exceeds Wasm32 addressable space (UINT32_MAX).\n", initial_bytes);
-             return ESPB_ERR_MEMORY_ALLOC;
-        }
-        
-        // Используем значение из конфигурации, если оно больше запрошенного размера
-        uint32_t configured_size = CONFIG_ESPB_LINEAR_MEMORY_SIZE;
-        // Всегда используем значение из конфигурации
-        ESPB_RLOG("Runtime: Using configured linear memory size (%" PRIu32 " bytes) instead of declared size (%" PRIu64 " bytes).\n",
-               configured_size, initial_bytes);
-        instance->memory_size_bytes = configured_size;
-
-        if (has_max) {
-            uint64_t max_bytes = (uint64_t)max_pages * 65536ULL;
-            instance->memory_max_size_bytes = (max_bytes > UINT32_MAX) ? UINT32_MAX : (uint32_t)max_bytes;
-        } else {
-            instance->memory_max_size_bytes = UINT32_MAX; 
-        }
-        
-        if (instance->memory_size_bytes > 0) {
-             instance->memory_data = (uint8_t *)SAFE_CALLOC(instance->memory_size_bytes, 1);
-             if (!instance->memory_data) {
-                 fprintf(stderr, "Error: Failed to allocate %" PRIu32 " bytes for declared linear memory.\\n", instance->memory_size_bytes);
-                 return ESPB_ERR_MEMORY_ALLOC;
-             }
-             ESPB_RLOG("Runtime: Allocated %" PRIu32 " bytes for declared linear memory (max: %" PRIu32 " bytes).\n",
-                    instance->memory_size_bytes, instance->memory_max_size_bytes);
-        } else {
-             ESPB_RLOG("Runtime: Declared linear memory initial size is 0 pages.\n");
-             instance->memory_data = NULL; // memory_size_bytes is already 0
-        }
+        ESPB_RLOG("Runtime: Declared memory: initial_pages=%" PRIu32 ", max_pages=%" PRIu32 ", has_max=%d\n",
+               mem_desc->limits.initial_size, max_pages, has_max);
     } else {
         ESPB_RLOG("Runtime: No memory defined (neither imported 'env.memory' nor declared in module).\n");
-        // Если есть пассивные сегменты данных, автоматически выделяем память для них
-        instance->memory_data = NULL; // временно NULL
-        if (module->num_data_segments > 0) {
-            // Ищем максимальный размер пассивного сегмента
-            uint32_t max_passive_size = 0;
-            for (uint32_t di = 0; di < module->num_data_segments; ++di) {
-                const EspbDataSegment *dseg = &module->data_segments[di];
-                if (dseg->segment_type == 1 && dseg->data_size > max_passive_size) {
-                    max_passive_size = dseg->data_size;
-                }
-            }
-            if (max_passive_size > 0) {
-                // Выделяем минимум одну страницу (1024 байта), покрывающую все пассивные данные
-                const uint32_t page_size = 65536;
-                uint32_t pages = (max_passive_size + page_size - 1) / page_size;
-                if (pages == 0) pages = 1;
-                
-                // Используем значение из конфигурации, если оно больше расчетного размера
-                uint32_t alloc_size = pages * page_size;
-                uint32_t configured_size = CONFIG_ESPB_LINEAR_MEMORY_SIZE;
-                // Всегда используем значение из конфигурации
-                ESPB_RLOG("Runtime: Using configured linear memory size (%" PRIu32 " bytes) instead of calculated size (%" PRIu32 " bytes).\n",
-                       configured_size, alloc_size);
-                alloc_size = configured_size;
-                
-                instance->memory_size_bytes = alloc_size;
-                instance->memory_max_size_bytes = alloc_size;
-                instance->memory_data = (uint8_t*)calloc(alloc_size, 1);
-                if (!instance->memory_data) {
-                    fprintf(stderr, "Error: Auto-allocation of %" PRIu32 " bytes for passive data failed.\n", alloc_size);
-                    return ESPB_ERR_MEMORY_ALLOC;
-                }
-                ESPB_RLOG("Runtime: Auto-allocated %" PRIu32 " bytes (%" PRIu32 " pages) for passive data segments.\n", alloc_size, pages);
-            } else {
-                // Если нет пассивных сегментов данных, но нужна память, выделяем минимальный размер из конфигурации
-                uint32_t configured_size = CONFIG_ESPB_LINEAR_MEMORY_SIZE;
-                if (configured_size > 0) {
-                    instance->memory_size_bytes = configured_size;
-                    instance->memory_max_size_bytes = configured_size;
-                    instance->memory_data = (uint8_t*)calloc(configured_size, 1);
-                    if (!instance->memory_data) {
-                        fprintf(stderr, "Error: Auto-allocation of %" PRIu32 " bytes for linear memory failed.\n", configured_size);
-                        return ESPB_ERR_MEMORY_ALLOC;
-                    }
-                    ESPB_RLOG("Runtime: Auto-allocated %" PRIu32 " bytes for linear memory from configuration.\n", configured_size);
-                }
-            }
-        } else {
-            // Если нет сегментов данных, но нужна память, выделяем минимальный размер из конфигурации
-            uint32_t configured_size = CONFIG_ESPB_LINEAR_MEMORY_SIZE;
-            if (configured_size > 0) {
-                instance->memory_size_bytes = configured_size;
-                instance->memory_max_size_bytes = configured_size;
-                instance->memory_data = (uint8_t*)calloc(configured_size, 1);
-                if (!instance->memory_data) {
-                    fprintf(stderr, "Error: Auto-allocation of %" PRIu32 " bytes for linear memory failed.\n", configured_size);
-                    return ESPB_ERR_MEMORY_ALLOC;
-                }
-                ESPB_RLOG("Runtime: Auto-allocated %" PRIu32 " bytes for linear memory from configuration.\n", configured_size);
-            } else {
-                instance->memory_data = NULL;
-            }
+    }
+
+    uint64_t limit = CONFIG_ESPB_LINEAR_MEMORY_SIZE;
+    if (has_max) {
+        uint64_t max_bytes = (uint64_t)max_pages * ESPB_WASM_PAGE_SIZE;
+        if (max_bytes < limit) limit = max_bytes;
+    }
+
+    uint64_t size = linear_memory_required(module);
+    if (size > limit) {
+        if (has_max && size > (uint64_t)max_pages * ESPB_WASM_PAGE_SIZE) {
+            fprintf(stderr, "Error: Static data and heap need %" PRIu64 " bytes, above the declared memory maximum (%" PRIu32 " pages).\n",
+                    size, max_pages);
+            return ESPB_ERR_INSTANTIATION_FAILED;
         }
+        // Данные модуля важнее настройки: лимит поднимается до необходимого
+        limit = size;
     }
-    
+    if (size > UINT32_MAX) {
+        fprintf(stderr, "Error: Linear memory size (%" PRIu64 ") bytes exceeds Wasm32 addressable space (UINT32_MAX).\n", size);
+        return ESPB_ERR_MEMORY_ALLOC;
+    }
+
+    uint64_t capacity = size + MEMORY_PAGE_ROUND(CONFIG_ESPB_LINEAR_MEMORY_GROW_RESERVE);
+    if (capacity > limit) capacity = limit;
+
+    instance->memory_size_bytes = (uint32_t)size;
+    instance->memory_max_size_bytes = (uint32_t)limit;
+    instance->memory_data = alloc_linear_memory(instance, (uint32_t)size, (uint32_t)capacity);
+    if (!instance->memory_data) {
+        fprintf(stderr, "Error: Failed to allocate %" PRIu64 " bytes for linear memory.\n", capacity);
+        instance->memory_size_bytes = 0;
+        return ESPB_ERR_MEMORY_ALLOC;
+    }
+    ESPB_RLOG("Runtime: Allocated linear memory at %p: %" PRIu32 " bytes (capacity %" PRIu32 ", max %" PRIu32 ").\n",
+           instance->memory_data, instance->memory_size_bytes, instance->memory_capacity_bytes,
+           instance->memory_max_size_bytes);
     return ESPB_OK;
 }
 
@@ -339,6 +435,20 @@ static EspbResult allocate_globals(EspbInstance *instance) {
     ESPB_RLOG("Runtime: Total size for %lu globals: %zu bytes (max align: %zu).\n", (unsigned long)module->num_globals, instance->globals_data_size, max_align);
 
     if (instance->globals_data_size > 0) {
+#if CONFIG_ESPB_SANDBOX_MASKED
+        // LD_GLOBAL_ADDR отдаёт указатели на глобалы, поэтому в песочнице они живут в хвосте
+        // линейной памяти (уже обнулённом), а не в отдельном блоке вне маски.
+        uint32_t tail = (uint32_t)((instance->globals_data_size + 7u) & ~(size_t)7u);
+        if (!instance->memory_data || tail >= instance->memory_size_bytes) {
+            fprintf(stderr, "Error: No room for %zu bytes of globals in sandboxed linear memory.\n", instance->globals_data_size);
+            instance->globals_data_size = 0;
+            free(instance->global_offsets);
+            instance->global_offsets = NULL;
+            return ESPB_ERR_MEMORY_ALLOC;
+        }
+        instance->memory_size_bytes -= tail;
+        instance->globals_data = instance->memory_data + instance->memory_size_bytes;
+#else
         instance->globals_data = (uint8_t*)calloc(instance->globals_data_size, 1); // calloc initializes to zero
         if (!instance->globals_data) {
             // ESP_LOGE(TAG, "Failed to allocate %zu bytes for globals.", instance->globals_data_size);
@@ -348,6 +458,7 @@ static EspbResult allocate_globals(EspbInstance *instance) {
             instance->global_offsets = NULL;
             return ESPB_ERR_MEMORY_ALLOC;
         }
+#endif
         // ESP_LOGI(TAG, "  Allocated %zu bytes for globals.", instance->globals_data_size);
         ESPB_RLOG("Runtime: Allocated %zu bytes for globals.\n", instance->globals_data_size);
          
@@ -409,6 +520,73 @@ static EspbResult allocate_tables(EspbInstance *instance) {
     return ESPB_OK;
 }
 
+// Размер пула import_cif_arg_types: параметры всех функциональных импортов
+static size_t import_cif_param_count(const EspbModule *module) {
+    size_t total_params = 0;
+    for (uint32_t i = 0; i < module->num_imports; ++i) {
+        const EspbImportDesc *imp = &module->imports[i];
+        if (imp->kind == ESPB_IMPORT_KIND_FUNC && imp->desc.func.type_idx < module->num_signatures) {
+            total_params += module->signatures[imp->desc.func.type_idx].num_params;
+        }
+    }
+    return total_params;
+}
+
+// Готовит ffi_cif для фиксированной сигнатуры каждого функционального импорта,
+// чтобы CALL_IMPORT (интерпретатор и JIT) не вызывал ffi_prep_cif на каждом вызове.
+// Импорты с неподдерживаемыми типами остаются неподготовленными - для них
+// вызывающий путь готовит CIF сам и сообщает об ошибке как раньше.
+static EspbResult prepare_import_cifs(EspbInstance *instance) {
+    const EspbModule *module = instance->module;
+    uint32_t num_imports = module->num_imports;
+
+    instance->import_cifs = NULL;
+    instance->import_cif_arg_types = NULL;
+    if (num_imports == 0) return ESPB_OK;
+
+    size_t total_params = import_cif_param_count(module);
+
+    instance->import_cifs = (ffi_cif*)calloc(num_imports, sizeof(ffi_cif));
+    if (total_params > 0) {
+        instance->import_cif_arg_types = (ffi_type**)calloc(total_params, sizeof(ffi_type*));
+    }
+    if (!instance->import_cifs || (total_params > 0 && !instance->import_cif_arg_types)) {
+        fprintf(stderr, "Error: Failed to allocate prepared import CIF table.\n");
+        return ESPB_ERR_MEMORY_ALLOC;
+    }
+
+    ffi_type **types_pool = instance->import_cif_arg_types;
+    uint32_t prepared = 0;
+    for (uint32_t i = 0; i < num_imports; ++i) {
+        const EspbImportDesc *imp = &module->imports[i];
+        if (imp->kind != ESPB_IMPORT_KIND_FUNC || imp->desc.func.type_idx >= module->num_signatures) continue;
+
+        const EspbFuncSignature *sig = &module->signatures[imp->desc.func.type_idx];
+        ffi_type **arg_types = types_pool;
+        types_pool += sig->num_params;
+
+        bool supported = true;
+        for (uint32_t p = 0; p < sig->num_params; ++p) {
+            arg_types[p] = espb_runtime_type_to_ffi_type(sig->param_types[p]);
+            if (!arg_types[p]) { supported = false; break; }
+        }
+        EspbValueType ret_t = (sig->num_returns > 0) ? sig->return_types[0] : ESPB_TYPE_VOID;
+        ffi_type *ret_type = espb_runtime_type_to_ffi_type(ret_t);
+        if (!supported || !ret_type) continue;
+
+        if (ffi_prep_cif(&instance->import_cifs[i], FFI_DEFAULT_ABI, sig->num_params, ret_type,
+                         sig->num_params > 0 ? arg_types : NULL) != FFI_OK) {
+            memset(&instance->import_cifs[i], 0, sizeof(ffi_cif));
+            continue;
+        }
+        prepared++;
+    }
+
+    ESPB_RLOG("Runtime: Prepared %lu/%lu import CIFs.\n", (unsigned long)prepared, (unsigned long)num_imports);
+    (void)prepared;
+    return ESPB_OK;
+}
+
 static EspbResult resolve_imports(EspbInstance *instance) {
     // ESP_LOGI(TAG, "Resolving imports...");
     ESPB_RLOG("Runtime: Resolving imports...\n");
@@ -532,6 +710,103 @@ static EspbResult resolve_imports(EspbInstance *instance) {
     return ESPB_OK;
 }
 
+// JIT cache, direct-threaded code и профиль: общая часть espb_instantiate и
+// espb_instance_clone, выполняется до первого исполнения кода модуля.
+static EspbResult instance_prepare_execution(EspbInstance *instance) {
+    const EspbModule *module = instance->module;
+
+    // До JIT: пока профиль импортов есть, JIT вызывает импорты только через helper
+    EspbResult import_prof_res = espb_import_profile_init(instance);
+    if (import_prof_res != ESPB_OK) return import_prof_res;
+
+#if CONFIG_ESPB_JIT_ENABLED
+    EspbResult res;
+    // Инициализируем JIT cache
+    instance->jit_hot_function_count = 0;
+    if (module->shared_jit_cache) {
+        // Разделяемый модуль: код уже скомпилированных функций используется как есть
+        instance->jit_cache = module->shared_jit_cache;
+    } else {
+        instance->jit_cache = (EspbJitCache*)SAFE_CALLOC(1, sizeof(EspbJitCache));
+    }
+    if (!instance->jit_cache) {
+        fprintf(stderr, "Runtime: Failed to allocate JIT cache.\n");
+        return ESPB_ERR_MEMORY_ALLOC;
+    }
+    
+    // Подсчитываем количество HOT функций (если 0 — JIT не нужен вообще)
+    uint32_t hot_function_count = 0;
+    for (uint32_t i = 0; i < module->num_functions; i++) {
+        if (module->function_bodies[i].header.flags & ESPB_FUNC_FLAG_HOT) {
+            hot_function_count++;
+        }
+    }
+    
+    // Сохраняем для fast-path в диспетчере/интерпретаторе
+    instance->jit_hot_function_count = hot_function_count;
+
+    // Cache индексируется локальным индексом функции: слот на каждую функцию модуля
+    // (tier-up может скомпилировать любую, не только помеченные HOT)
+    if (instance->jit_cache != module->shared_jit_cache) {
+        res = espb_jit_cache_init(instance->jit_cache, module);
+        if (res != ESPB_OK) {
+            fprintf(stderr, "Runtime: Failed to initialize JIT cache.\n");
+            return res;
+        }
+    }
+    ESP_LOGI(TAG, "JIT cache initialized with %u slots for %u HOT functions", 
+             (unsigned)module->num_functions, hot_function_count);
+
+    // До прекомпиляции, чтобы учитывалось и время компиляции HOT функций при загрузке
+    res = espb_jit_stats_init(instance);
+    if (res != ESPB_OK) return res;
+
+#if CONFIG_ESPB_JIT_SNAPSHOT
+    // До прекомпиляции: HOT функции из снимка загружаются без компиляции
+    if (espb_jit_snapshot_open(instance) != ESPB_OK) {
+        ESP_LOGW(TAG, "JIT snapshot unavailable, compiling from bytecode");
+    }
+#endif
+    
+    // Предварительная компиляция HOT функций
+    if (hot_function_count > 0) {
+        ESP_LOGI(TAG, "Starting precompilation of %u HOT functions...", hot_function_count);
+        res = espb_jit_precompile_hot_functions(instance, NULL);
+        if (res != ESPB_OK) {
+            ESP_LOGW(TAG, "Some HOT functions failed to precompile (error %d), continuing...", res);
+            // Не прерываем загрузку модуля, даже если некоторые функции не скомпилировались
+        } else {
+            ESP_LOGI(TAG, "All HOT functions precompiled successfully");
+        }
+        
+        // Выводим статистику
+        uint32_t total, hot, compiled;
+        size_t jit_size;
+        if (espb_jit_get_stats(instance, &total, &hot, &compiled, &jit_size) == ESPB_OK) {
+            ESP_LOGI(TAG, "JIT Stats: %u/%u HOT functions compiled, total size: %zu bytes", 
+                     compiled, hot, jit_size);
+        }
+    }
+
+#if CONFIG_ESPB_JIT_BACKGROUND
+    // Без фоновой задачи компиляция просто остаётся синхронной
+    if (espb_jit_bg_start(instance) != ESPB_OK) {
+        ESP_LOGW(TAG, "Background JIT unavailable, compiling synchronously");
+    }
+#endif
+#else
+    instance->jit_cache = NULL;
+    instance->jit_hot_function_count = 0;
+#endif
+
+    // Direct-threaded code строится после JIT-прекомпиляции (скомпилированные функции
+    // пропускаются) и до первого исполнения кода модуля (start function).
+    espb_interpreter_prepare_threaded_code((EspbModule *)module);
+
+    // Профиль создаётся до start function, чтобы её исполнение тоже учитывалось
+    return espb_profile_init(instance);
+}
+
 EspbResult espb_instantiate(EspbInstance **out_instance, const EspbModule *module) {
     ESPB_RLOG("Runtime: Instantiating module...\n");
     EspbResult res;
@@ -547,6 +822,7 @@ EspbResult espb_instantiate(EspbInstance **out_instance, const EspbModule *modul
          return ESPB_ERR_MEMORY_ALLOC;
     }
     instance->module = module;
+    espb_module_retain((EspbModule *)module); // Экземпляр держит ссылку, espb_free_instance её снимает
     instance->passive_data_at_offset_zero_size = 0; // Initialize new field
     
     // Initialize async wrapper system
@@ -559,6 +835,15 @@ EspbResult espb_instantiate(EspbInstance **out_instance, const EspbModule *modul
         espb_free_instance(instance);
         return ESPB_ERR_MEMORY_ALLOC;
     }
+#if CONFIG_ESPB_CONCURRENT_CALLS
+    instance->heap_mutex = xSemaphoreCreateMutex();
+    instance->async_mutex = xSemaphoreCreateRecursiveMutex();
+    if (instance->heap_mutex == NULL || instance->async_mutex == NULL) {
+        fprintf(stderr, "Error: Failed to create instance heap/async mutex.\n");
+        espb_free_instance(instance);
+        return ESPB_ERR_MEMORY_ALLOC;
+    }
+#endif
 
     res = allocate_linear_memory(instance);
     if (res != ESPB_OK) goto instantiate_error;
@@ -572,6 +857,19 @@ EspbResult espb_instantiate(EspbInstance **out_instance, const EspbModule *modul
     res = resolve_imports(instance);
     if (res != ESPB_OK) goto instantiate_error;
 
+    res = prepare_import_cifs(instance);
+    if (res != ESPB_OK) goto instantiate_error;
+
+    res = espb_marshal_plans_init(instance);
+    if (res != ESPB_OK) goto instantiate_error;
+
+    res = espb_call_ic_init(instance);
+    if (res != ESPB_OK) goto instantiate_error;
+    espb_fuel_init(instance);
+
+    res = espb_runtime_var_cifs_init(instance);
+    if (res != ESPB_OK) goto instantiate_error;
+
     // ОПТИМИЗАЦИЯ: Кэшируем флаги для блокирующих вызовов
     if (module->num_imports > 0) {
         instance->import_is_blocking = (bool*)calloc(module->num_imports, sizeof(bool));
@@ -590,6 +888,11 @@ EspbResult espb_instantiate(EspbInstance **out_instance, const EspbModule *modul
         }
     }
 
+#if CONFIG_ESPB_RODATA_IN_PLACE
+    res = map_rodata_segments(instance);
+    if (res != ESPB_OK) goto instantiate_error;
+#endif
+
     res = espb_apply_relocations(instance);
     if (res != ESPB_OK) goto instantiate_error;
 
@@ -604,62 +907,8 @@ EspbResult espb_instantiate(EspbInstance **out_instance, const EspbModule *modul
     }
     // --- КОНЕЦ ДОБАВЛЕНИЯ ---
 
-#if CONFIG_ESPB_JIT_ENABLED
-    // Инициализируем JIT cache
-    instance->jit_hot_function_count = 0;
-    instance->jit_cache = (EspbJitCache*)SAFE_CALLOC(1, sizeof(EspbJitCache));
-    if (!instance->jit_cache) {
-        fprintf(stderr, "Runtime: Failed to allocate JIT cache.\n");
-        res = ESPB_ERR_MEMORY_ALLOC;
-        goto instantiate_error;
-    }
-    
-    // Подсчитываем количество HOT функций (если 0 — JIT не нужен вообще)
-    uint32_t hot_function_count = 0;
-    for (uint32_t i = 0; i < module->num_functions; i++) {
-        if (module->function_bodies[i].header.flags & ESPB_FUNC_FLAG_HOT) {
-            hot_function_count++;
-        }
-    }
-    
-    // Сохраняем для fast-path в диспетчере/интерпретаторе
-    instance->jit_hot_function_count = hot_function_count;
-
-    // Инициализируем cache с размером = количество HOT функций (минимум 1, максимум 64)
-    size_t cache_capacity = hot_function_count > 0 ? hot_function_count : 1;
-    if (cache_capacity > 64) cache_capacity = 64; // Ограничиваем максимум
-    
-    res = espb_jit_cache_init(instance->jit_cache, cache_capacity);
-    if (res != ESPB_OK) {
-        fprintf(stderr, "Runtime: Failed to initialize JIT cache.\n");
-        goto instantiate_error;
-    }
-    ESP_LOGI(TAG, "JIT cache initialized with capacity=%zu for %u HOT functions", 
-             cache_capacity, hot_function_count);
-    
-    // Предварительная компиляция HOT функций
-    if (hot_function_count > 0) {
-        ESP_LOGI(TAG, "Starting precompilation of %u HOT functions...", hot_function_count);
-        res = espb_jit_precompile_hot_functions(instance, NULL);
-        if (res != ESPB_OK) {
-            ESP_LOGW(TAG, "Some HOT functions failed to precompile (error %d), continuing...", res);
-            // Не прерываем загрузку модуля, даже если некоторые функции не скомпилировались
-        } else {
-            ESP_LOGI(TAG, "All HOT functions precompiled successfully");
-        }
-        
-        // Выводим статистику
-        uint32_t total, hot, compiled;
-        size_t jit_size;
-        if (espb_jit_get_stats(instance, &total, &hot, &compiled, &jit_size) == ESPB_OK) {
-            ESP_LOGI(TAG, "JIT Stats: %u/%u HOT functions compiled, total size: %zu bytes", 
-                     compiled, hot, jit_size);
-        }
-    }
-#else
-    instance->jit_cache = NULL;
-    instance->jit_hot_function_count = 0;
-#endif
+    res = instance_prepare_execution(instance);
+    if (res != ESPB_OK) goto instantiate_error;
 
     // Initialize next_alloc_offset for the bump allocator (ALLOCA)
     // to start after any data placed at offset 0 by passive segments.
@@ -681,6 +930,8 @@ EspbResult espb_instantiate(EspbInstance **out_instance, const EspbModule *modul
     }
 
     ESPB_RLOG("Runtime: Module instantiated successfully.\n");
+    espb_memory_note_shadow_stack(instance, exec_ctx);
+    espb_memory_note_peak(instance);
     *out_instance = instance;
     free_execution_context(exec_ctx);
     return ESPB_OK;
@@ -697,15 +948,30 @@ void espb_free_instance(EspbInstance *instance) {
         espb_heap_deinit(instance); // <-- ДОБАВИТЬ ВЫЗОВ
         ESPB_RLOG("Runtime: Freeing instance...\n");
 
+        // Таймер сэмплера читает JIT-код и тела функций
+        espb_sampler_free(instance);
+
 #if CONFIG_ESPB_JIT_ENABLED
-        // Освобождаем JIT cache
-        if (instance->jit_cache) {
+#if CONFIG_ESPB_JIT_BACKGROUND
+        // Фоновая задача пишет в JIT cache и тела функций - останавливаем её первой
+        espb_jit_bg_stop(instance);
+#endif
+#if CONFIG_ESPB_JIT_SNAPSHOT
+        espb_jit_snapshot_close(instance);
+#endif
+        // Освобождаем JIT cache (общий cache разделяемого модуля освобождает espb_module_release)
+        if (instance->jit_cache && instance->jit_cache != instance->module->shared_jit_cache) {
             espb_jit_cache_free(instance->jit_cache);
             free(instance->jit_cache);
             ESP_LOGI(TAG, "JIT cache freed");
         }
+        instance->jit_cache = NULL;
 #endif
 
+        espb_profile_free(instance);
+        espb_import_profile_free(instance);
+        espb_jit_stats_free(instance);
+
         // === CLEANUP ASYNC WRAPPER SYSTEM ===
         if (instance->async_wrappers) {
             ESP_LOGI(TAG, "ESPB ASYNC WRAPPER CLEANUP: Cleaning up async wrapper system");
@@ -737,19 +1003,38 @@ void espb_free_instance(EspbInstance *instance) {
             ESP_LOGI(TAG, "ESPB ASYNC WRAPPER CLEANUP: Async wrapper cleanup completed");
         }
 
-        // Замыкания теперь освобождаются централизованно через espb_callback_system_deinit()
+        // Callback-замыкания экземпляра возвращаются в реестр, кэш CIF освобождается
+        espb_callback_release_instance(instance);
+
         if (instance->instance_mutex) {
             vSemaphoreDelete(instance->instance_mutex);
             instance->instance_mutex = NULL;
         }
+#if CONFIG_ESPB_CONCURRENT_CALLS
+        if (instance->heap_mutex) {
+            vSemaphoreDelete(instance->heap_mutex);
+            instance->heap_mutex = NULL;
+        }
+        if (instance->async_mutex) {
+            vSemaphoreDelete(instance->async_mutex);
+            instance->async_mutex = NULL;
+        }
+#endif
         if (instance->memory_data) {
             free(instance->memory_data);
             instance->memory_data = NULL;
         }
         if (instance->globals_data) {
-            free(instance->globals_data);
+#if !CONFIG_ESPB_SANDBOX_MASKED
+            free(instance->globals_data); // в песочнице глобалы - часть memory_data
+#endif
             instance->globals_data = NULL;
         }
+#if CONFIG_ESPB_RODATA_IN_PLACE
+        free(instance->rodata);
+        instance->rodata = NULL;
+        instance->num_rodata = 0;
+#endif
         if (instance->global_offsets) { 
             free(instance->global_offsets);
             instance->global_offsets = NULL;
@@ -774,10 +1059,527 @@ void espb_free_instance(EspbInstance *instance) {
             free(instance->import_is_blocking);
             instance->import_is_blocking = NULL;
         }
+        if (instance->import_cifs) {
+            free(instance->import_cifs);
+            instance->import_cifs = NULL;
+        }
+        if (instance->import_cif_arg_types) {
+            free(instance->import_cif_arg_types);
+            instance->import_cif_arg_types = NULL;
+        }
+        espb_call_ic_free(instance);
+        espb_marshal_plans_free(instance);
+        espb_runtime_var_cifs_free(instance);
+        EspbModule *module = (EspbModule *)instance->module;
         free(instance);
+        espb_module_release(module);
     }
 }
 
+EspbResult espb_module_make_shared(EspbModule *module) {
+    if (!module) return ESPB_ERR_INVALID_OPERAND;
+    if (module->shared) return ESPB_OK;
+
+    module->jit_mutex = xSemaphoreCreateMutex();
+    if (!module->jit_mutex) return ESPB_ERR_MEMORY_ALLOC;
+#if CONFIG_ESPB_JIT_ENABLED
+    module->shared_jit_cache = (EspbJitCache*)SAFE_CALLOC(1, sizeof(EspbJitCache));
+    if (!module->shared_jit_cache ||
+        espb_jit_cache_init(module->shared_jit_cache, module) != ESPB_OK) {
+        free(module->shared_jit_cache);
+        module->shared_jit_cache = NULL;
+        vSemaphoreDelete(module->jit_mutex);
+        module->jit_mutex = NULL;
+        return ESPB_ERR_MEMORY_ALLOC;
+    }
+#endif
+    module->shared = true;
+    return ESPB_OK;
+}
+
+void espb_module_retain(EspbModule *module) {
+    if (module) __atomic_fetch_add(&module->refcount, 1, __ATOMIC_RELAXED);
+}
+
+void espb_module_release(EspbModule *module) {
+    if (!module || __atomic_sub_fetch(&module->refcount, 1, __ATOMIC_ACQ_REL) != 0) return;
+
+#if CONFIG_ESPB_JIT_ENABLED
+    if (module->shared_jit_cache) {
+        espb_jit_cache_free(module->shared_jit_cache);
+        free(module->shared_jit_cache);
+        module->shared_jit_cache = NULL;
+    }
+#endif
+    if (module->jit_mutex) {
+        vSemaphoreDelete(module->jit_mutex);
+        module->jit_mutex = NULL;
+    }
+    // Код, имена и сегменты данных могут указывать в буфер модуля (отображённый раздел или
+    // буфер загрузчика) - освобождаем его последним
+    bool mmapped = module->buffer_mmapped;
+    esp_partition_mmap_handle_t mmap_handle = (esp_partition_mmap_handle_t)module->buffer_mmap_handle;
+    uint8_t *owned_buffer = module->buffer_owned ? (uint8_t *)module->buffer : NULL;
+    espb_free_module(module);
+    if (mmapped) {
+        esp_partition_munmap(mmap_handle);
+    }
+    free(owned_buffer);
+}
+
+// --- Снимок экземпляра ---
+//
+// Гость хранит нативные указатели, поэтому образ памяти нельзя просто скопировать по
+// другому адресу. Снимок строится сравнением экземпляра с двойником того же модуля:
+// слово, отличающееся ровно на разницу баз памяти (или глобалов), - указатель. В снимке
+// он хранится смещением от базы, клон прибавляет к нему свою. Любое другое расхождение
+// означает недетерминированную инициализацию, и снимок не делается.
+
+#define SNAPSHOT_RELOC_GLOBALS 0x80000000u // Слово указывает в globals_data, иначе в memory_data
+
+typedef uintptr_t SnapshotWord;
+
+typedef struct {
+    uint32_t *sites;   // Смещения слов в образе (| SNAPSHOT_RELOC_GLOBALS)
+    uint32_t count;
+    uint32_t capacity;
+} SnapshotRelocs;
+
+struct EspbInstanceSnapshot {
+    const EspbModule *module;
+    uint32_t memory_alloc_bytes;       // Для alloc_linear_memory (в песочнице - вместе с глобалами)
+    uint32_t memory_size_bytes;
+    uint32_t memory_capacity_bytes;
+    uint32_t memory_max_size_bytes;
+    uint32_t static_data_end_offset;
+    uint32_t passive_data_at_offset_zero_size;
+    uint8_t *memory;                   // [0, memory_image_bytes), дальше память нулевая
+    uint32_t memory_image_bytes;
+    uint8_t *globals;
+    uint32_t globals_data_size;
+    void **table;
+    uint32_t table_size;
+    uint32_t table_max_size;
+    SnapshotRelocs memory_relocs;
+    SnapshotRelocs globals_relocs;
+    SnapshotRelocs table_relocs;
+
+    // Разрешённые импорты и готовые CIF копируются как есть
+    void **import_funcs;
+    void **import_globals;
+    uint8_t *import_readonly;
+    bool *import_blocking;
+    ffi_cif *import_cifs;
+    ffi_type **import_cif_arg_types;
+    size_t num_import_cif_arg_types;
+#if CONFIG_ESPB_RODATA_IN_PLACE
+    EspbRodataSpan *rodata;
+    uint32_t num_rodata;
+#endif
+
+    // Куча: смещения регионов в memory_data (отдельных блоков в снимке нет)
+    uint8_t num_heap_regions;
+    uint32_t heap_region_base[ESPB_HEAP_MAX_REGIONS];
+    uint32_t heap_region_handle[ESPB_HEAP_MAX_REGIONS];
+    uint32_t heap_region_size[ESPB_HEAP_MAX_REGIONS];
+#if CONFIG_ESPB_HEAP_SLABS
+    uint32_t slab_free[ESPB_HEAP_SLAB_CLASSES]; // Смещение + 1, 0 - список пуст
+    uint8_t *slab_map;
+    uint32_t slab_map_pages;
+#endif
+};
+
+// Память, в которую могут указывать слова экземпляра (с запасом MEMORY.GROW и глобалами песочницы)
+static uint32_t snapshot_memory_extent(const EspbInstance *instance) {
+#if CONFIG_ESPB_SANDBOX_MASKED
+    return instance->memory_data ? instance->memory_mask + 1 : 0;
+#else
+    return instance->memory_capacity_bytes;
+#endif
+}
+
+static bool snapshot_reloc_push(SnapshotRelocs *relocs, uint32_t site) {
+    if (relocs->count == relocs->capacity) {
+        uint32_t cap = relocs->capacity ? relocs->capacity * 2 : 16;
+        uint32_t *sites = (uint32_t *)realloc(relocs->sites, cap * sizeof(uint32_t));
+        if (!sites) return false;
+        relocs->sites = sites;
+        relocs->capacity = cap;
+    }
+    relocs->sites[relocs->count++] = site;
+    return true;
+}
+
+// Сравнивает образ экземпляра a (image, size кратен слову) с тем же образом двойника b.
+// Указатели в image заменяются смещениями от своей базы, их позиции уходят в relocs.
+static EspbResult snapshot_diff(uint8_t *image, const uint8_t *twin, uint32_t size,
+                                const EspbInstance *a, const EspbInstance *b, SnapshotRelocs *relocs) {
+    uintptr_t mem_a = (uintptr_t)a->memory_data;
+    uintptr_t mem_delta = (uintptr_t)b->memory_data - mem_a;
+    uint32_t mem_extent = snapshot_memory_extent(a);
+    uintptr_t glob_a = (uintptr_t)a->globals_data;
+    uintptr_t glob_delta = (uintptr_t)b->globals_data - glob_a;
+
+    for (uint32_t off = 0; off < size; off += sizeof(SnapshotWord)) {
+        SnapshotWord wa, wb;
+        memcpy(&wa, image + off, sizeof(wa));
+        memcpy(&wb, twin + off, sizeof(wb));
+        if (wa == wb) continue;
+
+        uint32_t site = off;
+        if (mem_a && wb - wa == mem_delta && wa - mem_a <= mem_extent) {
+            wa -= mem_a;
+        } else if (glob_a && wb - wa == glob_delta && wa - glob_a <= a->globals_data_size) {
+            wa -= glob_a;
+            site |= SNAPSHOT_RELOC_GLOBALS;
+        } else {
+            fprintf(stderr, "Error: Snapshot: word at offset %" PRIu32 " differs between instances (0x%08" PRIxPTR " vs 0x%08" PRIxPTR "); initialization is not deterministic.\n",
+                    off, (uintptr_t)wa, (uintptr_t)wb);
+            return ESPB_ERR_INSTANTIATION_FAILED;
+        }
+        if (!snapshot_reloc_push(relocs, site)) return ESPB_ERR_MEMORY_ALLOC;
+        memcpy(image + off, &wa, sizeof(wa));
+    }
+    return ESPB_OK;
+}
+
+static void snapshot_relocate(uint8_t *image, const SnapshotRelocs *relocs, const EspbInstance *instance) {
+    for (uint32_t i = 0; i < relocs->count; ++i) {
+        uint32_t site = relocs->sites[i];
+        uintptr_t base = (site & SNAPSHOT_RELOC_GLOBALS) ? (uintptr_t)instance->globals_data : (uintptr_t)instance->memory_data;
+        uint8_t *p = image + (site & ~SNAPSHOT_RELOC_GLOBALS);
+        SnapshotWord w;
+        memcpy(&w, p, sizeof(w));
+        w += base;
+        memcpy(p, &w, sizeof(w));
+    }
+}
+
+// Конец ненулевых данных памяти, округлённый до слова
+static uint32_t snapshot_used_bytes(const uint8_t *mem, uint32_t size) {
+    while (size > 0 && mem[size - 1] == 0) size--;
+    return (size + sizeof(SnapshotWord) - 1) & ~(uint32_t)(sizeof(SnapshotWord) - 1);
+}
+
+static void *snapshot_dup(const void *src, size_t size) {
+    if (!src || size == 0) return NULL;
+    void *dst = malloc(size);
+    if (dst) memcpy(dst, src, size);
+    return dst;
+}
+
+static EspbResult snapshot_check_supported(const EspbInstance *instance) {
+    const EspbModule *module = instance->module;
+#if CONFIG_ESPB_JIT_ENABLED
+    // JIT-код неразделяемого модуля принадлежит jit_cache исходного экземпляра и
+    // освобождается вместе с ним (или вытесняется), а клон вызывал бы его через body->jit_code
+    if (!module->shared) {
+        fprintf(stderr, "Error: Snapshot: module is not shared (espb_module_make_shared), JIT code belongs to the instance.\n");
+        return ESPB_ERR_FEATURE_NOT_SUPPORTED;
+    }
+#endif
+    for (uint32_t i = 0; i < module->num_imports; ++i) {
+        if (module->imports[i].kind == ESPB_IMPORT_KIND_MEMORY) {
+            fprintf(stderr, "Error: Snapshot: imported linear memory belongs to the host and cannot be cloned.\n");
+            return ESPB_ERR_FEATURE_NOT_SUPPORTED;
+        }
+    }
+    if (instance->num_async_wrappers > 0) {
+        fprintf(stderr, "Error: Snapshot: instance already owns async wrappers (closures are bound to the instance).\n");
+        return ESPB_ERR_FEATURE_NOT_SUPPORTED;
+    }
+    for (uint32_t i = 0; i < instance->heap_ctx.num_regions; ++i) {
+        if (instance->heap_ctx.regions[i].owned) {
+            fprintf(stderr, "Error: Snapshot: guest heap has grown outside linear memory.\n");
+            return ESPB_ERR_FEATURE_NOT_SUPPORTED;
+        }
+    }
+    return ESPB_OK;
+}
+
+void espb_instance_snapshot_free(EspbInstanceSnapshot *snapshot) {
+    if (!snapshot) return;
+    free(snapshot->memory);
+    free(snapshot->globals);
+    free(snapshot->table);
+    free(snapshot->memory_relocs.sites);
+    free(snapshot->globals_relocs.sites);
+    free(snapshot->table_relocs.sites);
+    free(snapshot->import_funcs);
+    free(snapshot->import_globals);
+    free(snapshot->import_readonly);
+    free(snapshot->import_blocking);
+    free(snapshot->import_cifs);
+    free(snapshot->import_cif_arg_types);
+#if CONFIG_ESPB_RODATA_IN_PLACE
+    free(snapshot->rodata);
+#endif
+#if CONFIG_ESPB_HEAP_SLABS
+    free(snapshot->slab_map);
+#endif
+    if (snapshot->module) espb_module_release((EspbModule *)snapshot->module);
+    free(snapshot);
+}
+
+EspbResult espb_instance_snapshot(const EspbInstance *instance, EspbInstanceSnapshot **out_snapshot) {
+    *out_snapshot = NULL;
+    EspbResult res = snapshot_check_supported(instance);
+    if (res != ESPB_OK) return res;
+
+    const EspbModule *module = instance->module;
+    EspbInstanceSnapshot *snap = NULL;
+    EspbInstance *twin = NULL;
+    res = espb_instantiate(&twin, module);
+    if (res != ESPB_OK) return res;
+
+    if (twin->memory_size_bytes != instance->memory_size_bytes ||
+        twin->globals_data_size != instance->globals_data_size ||
+        twin->table_size != instance->table_size ||
+        twin->static_data_end_offset != instance->static_data_end_offset ||
+        twin->heap_ctx.num_regions != instance->heap_ctx.num_regions) {
+        fprintf(stderr, "Error: Snapshot: instance layout differs from a fresh instance; snapshot must be taken right after espb_instantiate.\n");
+        res = ESPB_ERR_INSTANTIATION_FAILED;
+        goto cleanup;
+    }
+
+    snap = (EspbInstanceSnapshot *)calloc(1, sizeof(EspbInstanceSnapshot));
+    if (!snap) {
+        res = ESPB_ERR_MEMORY_ALLOC;
+        goto cleanup;
+    }
+    snap->module = module;
+    espb_module_retain((EspbModule *)module);
+
+    res = ESPB_ERR_MEMORY_ALLOC;
+    snap->memory_size_bytes = instance->memory_size_bytes;
+    snap->memory_capacity_bytes = instance->memory_capacity_bytes;
+    snap->memory_max_size_bytes = instance->memory_max_size_bytes;
+#if CONFIG_ESPB_SANDBOX_MASKED
+    snap->memory_alloc_bytes = snapshot_memory_extent(instance);
+#else
+    snap->memory_alloc_bytes = instance->memory_size_bytes;
+#endif
+    snap->static_data_end_offset = instance->static_data_end_offset;
+    snap->passive_data_at_offset_zero_size = instance->passive_data_at_offset_zero_size;
+
+    // Память: сравнивается до последнего ненулевого слова любого из экземпляров
+    uint32_t used = snapshot_used_bytes(instance->memory_data, instance->memory_size_bytes);
+    uint32_t twin_used = snapshot_used_bytes(twin->memory_data, twin->memory_size_bytes);
+    snap->memory_image_bytes = used > twin_used ? used : twin_used;
+    if (snap->memory_image_bytes > 0) {
+        snap->memory = (uint8_t *)snapshot_dup(instance->memory_data, snap->memory_image_bytes);
+        if (!snap->memory) goto cleanup;
+        res = snapshot_diff(snap->memory, twin->memory_data, snap->memory_image_bytes, instance, twin, &snap->memory_relocs);
+        if (res != ESPB_OK) goto cleanup;
+        res = ESPB_ERR_MEMORY_ALLOC;
+    }
+
+    snap->globals_data_size = instance->globals_data_size;
+    if (instance->globals_data_size > 0) {
+        snap->globals = (uint8_t *)snapshot_dup(instance->globals_data, instance->globals_data_size);
+        if (!snap->globals) goto cleanup;
+        uint32_t words = instance->globals_data_size & ~(uint32_t)(sizeof(SnapshotWord) - 1);
+        res = snapshot_diff(snap->globals, twin->globals_data, words, instance, twin, &snap->globals_relocs);
+        if (res != ESPB_OK) goto cleanup;
+        if (memcmp(snap->globals + words, twin->globals_data + words, instance->globals_data_size - words) != 0) {
+            fprintf(stderr, "Error: Snapshot: globals differ between instances; initialization is not deterministic.\n");
+            res = ESPB_ERR_INSTANTIATION_FAILED;
+            goto cleanup;
+        }
+        res = ESPB_ERR_MEMORY_ALLOC;
+    }
+
+    snap->table_size = instance->table_size;
+    snap->table_max_size = instance->table_max_size;
+    if (instance->table_size > 0) {
+        snap->table = (void **)snapshot_dup(instance->table_data, instance->table_size * sizeof(void *));
+        if (!snap->table) goto cleanup;
+        res = snapshot_diff((uint8_t *)snap->table, (const uint8_t *)twin->table_data, instance->table_size * sizeof(void *),
+                            instance, twin, &snap->table_relocs);
+        if (res != ESPB_OK) goto cleanup;
+        res = ESPB_ERR_MEMORY_ALLOC;
+    }
+
+    uint32_t num_imports = module->num_imports;
+    if (num_imports > 0) {
+        snap->import_funcs = (void **)snapshot_dup(instance->resolved_import_funcs, num_imports * sizeof(void *));
+        snap->import_globals = (void **)snapshot_dup(instance->resolved_import_globals, num_imports * sizeof(void *));
+        snap->import_readonly = (uint8_t *)snapshot_dup(instance->import_is_readonly, (num_imports + 7u) / 8u);
+        snap->import_blocking = (bool *)snapshot_dup(instance->import_is_blocking, num_imports * sizeof(bool));
+        snap->import_cifs = (ffi_cif *)snapshot_dup(instance->import_cifs, num_imports * sizeof(ffi_cif));
+        snap->num_import_cif_arg_types = import_cif_param_count(module);
+        snap->import_cif_arg_types = (ffi_type **)snapshot_dup(instance->import_cif_arg_types,
+                                                              snap->num_import_cif_arg_types * sizeof(ffi_type *));
+        if (!snap->import_funcs || !snap->import_globals || !snap->import_readonly || !snap->import_blocking ||
+            !snap->import_cifs || (snap->num_import_cif_arg_types > 0 && !snap->import_cif_arg_types)) {
+            goto cleanup;
+        }
+    }
+
+#if CONFIG_ESPB_RODATA_IN_PLACE
+    snap->num_rodata = instance->num_rodata;
+    if (instance->num_rodata > 0) {
+        snap->rodata = (EspbRodataSpan *)snapshot_dup(instance->rodata, instance->num_rodata * sizeof(EspbRodataSpan));
+        if (!snap->rodata) goto cleanup;
+    }
+#endif
+
+    const EspbHeapContext *heap = &instance->heap_ctx;
+    uintptr_t mem = (uintptr_t)instance->memory_data;
+    snap->num_heap_regions = heap->num_regions;
+    for (uint32_t i = 0; i < heap->num_regions; ++i) {
+        snap->heap_region_base[i] = (uint32_t)((uintptr_t)heap->regions[i].base - mem);
+        snap->heap_region_handle[i] = (uint32_t)((uintptr_t)heap->regions[i].handle - mem);
+        snap->heap_region_size[i] = heap->regions[i].size;
+    }
+#if CONFIG_ESPB_HEAP_SLABS
+    for (uint32_t c = 0; c < ESPB_HEAP_SLAB_CLASSES; ++c) {
+        snap->slab_free[c] = heap->slab_free[c] ? (uint32_t)((uintptr_t)heap->slab_free[c] - mem) + 1 : 0;
+    }
+    snap->slab_map_pages = heap->slab_map_pages;
+    if (heap->slab_map_pages > 0) {
+        snap->slab_map = (uint8_t *)snapshot_dup(heap->slab_map, heap->slab_map_pages);
+        if (!snap->slab_map) goto cleanup;
+    }
+#endif
+
+    ESP_LOGI(TAG, "Instance snapshot: %u bytes of memory, %u/%u/%u pointer sites (memory/globals/table)",
+             (unsigned)snap->memory_image_bytes, (unsigned)snap->memory_relocs.count,
+             (unsigned)snap->globals_relocs.count, (unsigned)snap->table_relocs.count);
+    *out_snapshot = snap;
+    snap = NULL;
+    res = ESPB_OK;
+
+cleanup:
+    espb_instance_snapshot_free(snap);
+    espb_free_instance(twin);
+    return res;
+}
+
+EspbResult espb_instance_clone(const EspbInstanceSnapshot *snapshot, EspbInstance **out_instance) {
+    *out_instance = NULL;
+    const EspbModule *module = snapshot->module;
+    EspbResult res = ESPB_ERR_MEMORY_ALLOC;
+
+    EspbInstance *instance = (EspbInstance *)SAFE_CALLOC(1, sizeof(EspbInstance));
+    if (!instance) return ESPB_ERR_MEMORY_ALLOC;
+    instance->module = module;
+    espb_module_retain((EspbModule *)module);
+
+    instance->instance_mutex = xSemaphoreCreateMutex();
+    if (!instance->instance_mutex) goto clone_error;
+#if CONFIG_ESPB_CONCURRENT_CALLS
+    instance->heap_mutex = xSemaphoreCreateMutex();
+    instance->async_mutex = xSemaphoreCreateRecursiveMutex();
+    if (!instance->heap_mutex || !instance->async_mutex) goto clone_error;
+#endif
+
+    if (snapshot->memory_alloc_bytes > 0) {
+        instance->memory_data = alloc_linear_memory(instance, snapshot->memory_alloc_bytes, snapshot->memory_capacity_bytes);
+        if (!instance->memory_data) goto clone_error;
+        if (snapshot->memory_image_bytes > 0) memcpy(instance->memory_data, snapshot->memory, snapshot->memory_image_bytes);
+    }
+    instance->memory_size_bytes = snapshot->memory_alloc_bytes;
+    instance->memory_max_size_bytes = snapshot->memory_max_size_bytes;
+
+    // Раскладка глобалов (в песочнице - хвост памяти) та же, что у исходного экземпляра
+    res = allocate_globals(instance);
+    if (res != ESPB_OK) goto clone_error;
+    instance->memory_size_bytes = snapshot->memory_size_bytes;
+    res = ESPB_ERR_MEMORY_ALLOC;
+    if (snapshot->globals_data_size > 0) memcpy(instance->globals_data, snapshot->globals, snapshot->globals_data_size);
+
+    instance->table_size = snapshot->table_size;
+    instance->table_max_size = snapshot->table_max_size;
+    if (snapshot->table_size > 0) {
+        instance->table_data = (void **)snapshot_dup(snapshot->table, snapshot->table_size * sizeof(void *));
+        if (!instance->table_data) goto clone_error;
+    }
+
+    snapshot_relocate(instance->memory_data, &snapshot->memory_relocs, instance);
+    snapshot_relocate(instance->globals_data, &snapshot->globals_relocs, instance);
+    snapshot_relocate((uint8_t *)instance->table_data, &snapshot->table_relocs, instance);
+
+    uint32_t num_imports = module->num_imports;
+    if (num_imports > 0) {
+        instance->resolved_import_funcs = (void **)snapshot_dup(snapshot->import_funcs, num_imports * sizeof(void *));
+        instance->resolved_import_globals = (void **)snapshot_dup(snapshot->import_globals, num_imports * sizeof(void *));
+        instance->import_is_readonly = (uint8_t *)snapshot_dup(snapshot->import_readonly, (num_imports + 7u) / 8u);
+        instance->import_is_blocking = (bool *)snapshot_dup(snapshot->import_blocking, num_imports * sizeof(bool));
+        instance->import_cifs = (ffi_cif *)snapshot_dup(snapshot->import_cifs, num_imports * sizeof(ffi_cif));
+        instance->import_cif_arg_types = (ffi_type **)snapshot_dup(snapshot->import_cif_arg_types,
+                                                                   snapshot->num_import_cif_arg_types * sizeof(ffi_type *));
+        if (!instance->resolved_import_funcs || !instance->resolved_import_globals || !instance->import_is_readonly ||
+            !instance->import_is_blocking || !instance->import_cifs ||
+            (snapshot->num_import_cif_arg_types > 0 && !instance->import_cif_arg_types)) {
+            goto clone_error;
+        }
+        // arg_types каждого CIF указывает в общий пул - переносим на копию пула
+        for (uint32_t i = 0; i < num_imports; ++i) {
+            ffi_cif *cif = &instance->import_cifs[i];
+            if (cif->arg_types) {
+                cif->arg_types = instance->import_cif_arg_types + (cif->arg_types - snapshot->import_cif_arg_types);
+            }
+        }
+    }
+
+#if CONFIG_ESPB_RODATA_IN_PLACE
+    if (snapshot->num_rodata > 0) {
+        instance->rodata = (EspbRodataSpan *)snapshot_dup(snapshot->rodata, snapshot->num_rodata * sizeof(EspbRodataSpan));
+        if (!instance->rodata) goto clone_error;
+        instance->num_rodata = snapshot->num_rodata;
+    }
+#endif
+
+    res = espb_call_ic_init(instance);
+    if (res != ESPB_OK) goto clone_error;
+    espb_fuel_init(instance);
+
+    res = espb_marshal_plans_init(instance);
+    if (res != ESPB_OK) goto clone_error;
+
+    res = espb_runtime_var_cifs_init(instance);
+    if (res != ESPB_OK) goto clone_error;
+
+    // Куча: метаданные multi_heap и списки slab уже в образе памяти
+    EspbHeapContext *heap = &instance->heap_ctx;
+    for (uint32_t i = 0; i < snapshot->num_heap_regions; ++i) {
+        heap->regions[i].base = instance->memory_data + snapshot->heap_region_base[i];
+        heap->regions[i].handle = (multi_heap_handle_t)(instance->memory_data + snapshot->heap_region_handle[i]);
+        heap->regions[i].size = snapshot->heap_region_size[i];
+        heap->regions[i].owned = false;
+    }
+    heap->num_regions = snapshot->num_heap_regions;
+#if CONFIG_ESPB_HEAP_SLABS
+    for (uint32_t c = 0; c < ESPB_HEAP_SLAB_CLASSES; ++c) {
+        heap->slab_free[c] = snapshot->slab_free[c] ? instance->memory_data + snapshot->slab_free[c] - 1 : NULL;
+    }
+    if (snapshot->slab_map_pages > 0) {
+        heap->slab_map = (uint8_t *)snapshot_dup(snapshot->slab_map, snapshot->slab_map_pages);
+        if (!heap->slab_map) {
+            res = ESPB_ERR_MEMORY_ALLOC;
+            goto clone_error;
+        }
+        heap->slab_map_pages = snapshot->slab_map_pages;
+    }
+#endif
+    heap->initialized = true;
+    instance->static_data_end_offset = snapshot->static_data_end_offset;
+    instance->passive_data_at_offset_zero_size = snapshot->passive_data_at_offset_zero_size;
+
+    res = instance_prepare_execution(instance);
+    if (res != ESPB_OK) goto clone_error;
+
+    espb_memory_note_peak(instance);
+    *out_instance = instance;
+    return ESPB_OK;
+
+clone_error:
+    fprintf(stderr, "Runtime: Instance clone failed with code %d\n", res);
+    espb_free_instance(instance);
+    return res;
+}
+
 static EspbResult espb_evaluate_init_expr(const EspbInstance *instance, const uint8_t *expr, size_t expr_len, uint32_t *out_value) {
     if (!expr || expr_len == 0) {
         fprintf(stderr, "Error: Init expr is NULL or empty.\n");
@@ -988,7 +1790,7 @@ EspbResult espb_apply_relocations(EspbInstance *instance) {
                                 fprintf(stderr, "Error: Reloc[%lu]: memory_data is NULL for ABS32_GLOBAL DATA_OFFSET.\n", i);
                                 return ESPB_ERR_INSTANTIATION_FAILED;
                             }
-                            symbol_val = (uint32_t)(uintptr_t)(instance->memory_data + g->initializer.data_section_offset);
+                            symbol_val = (uint32_t)(uintptr_t)(espb_data_address(instance, g->initializer.data_section_offset));
                         } else {
                             if (!instance->globals_data) {
                                 fprintf(stderr, "Error: Reloc[%lu]: globals_data is NULL for ABS32_GLOBAL.\n", i);
@@ -1068,6 +1870,12 @@ EspbResult espb_initialize_data_segments(EspbInstance *instance) {
                 return res;
             }
             
+#if CONFIG_ESPB_RODATA_IN_PLACE
+            uint32_t rodata_start;
+            if (rodata_segment_in_place(module, seg, &rodata_start)) {
+                continue; // Читается из образа модуля (map_rodata_segments)
+            }
+#endif
             if (offset + seg->data_size > max_offset_end) {
                 max_offset_end = offset + seg->data_size;
             }
@@ -0,0 +1,582 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "espb_interpreter_threaded.h"
+#include "espb_simd.h" // espb_v128_operand_len
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include "esp_log.h"
+
+static const char *TAG = "espb_threaded";
+
+#define THREADED_NO_OFFSET UINT32_MAX
+
+// Полная длина инструкций фиксированного размера (опкод + операнды).
+// 0 - опкод неизвестен/зарезервирован либо имеет переменную длину (0x04, 0x09, 0xFC).
+static const uint8_t s_insn_len[256] = {
+    [0x00 ... 0x01] = 1,    // padding NOP, NOP
+    [0x02] = 3,             // BR offset(i16)
+    [0x03] = 4,             // BR_IF reg, offset(i16)
+    [0x05] = 1,             // UNREACHABLE
+    [0x0A] = 3,             // CALL local_func_idx(u16)
+    [0x0B] = 4,             // CALL_INDIRECT Rfunc, type_idx(u16)
+    [0x0D] = 4,             // CALL_INDIRECT_PTR Rptr, type_idx(u16)
+    [0x0F] = 1,             // END
+    [0x10 ... 0x13] = 3,    // MOV.*
+    [0x18] = 6,             // LDC.I32.IMM
+    [0x19] = 10,            // LDC.I64.IMM
+    [0x1A] = 6,             // LDC.F32.IMM
+    [0x1B] = 10,            // LDC.F64.IMM
+    [0x1C] = 6,             // LDC.PTR.IMM
+    [0x1D ... 0x1F] = 4,    // LD_GLOBAL_ADDR / LD_GLOBAL / ST_GLOBAL
+    [0x20 ... 0x24] = 4,    // I32 арифметика
+    [0x26 ... 0x2D] = 4,    // I32 арифметика/логика
+    [0x2E] = 3,             // NOT.I32
+    [0x30 ... 0x34] = 4,    // I64 арифметика
+    [0x36 ... 0x3D] = 4,    // I64 арифметика/логика
+    [0x3E] = 3,             // NOT.I64
+    [0x40 ... 0x4B] = 4,    // *.IMM8
+    [0x50 ... 0x56] = 4,    // *.IMM8 (продолжение)
+    [0x58] = 4,
+    [0x60 ... 0x65] = 4,    // F32 арифметика
+    [0x66 ... 0x67] = 3,    // ABS/SQRT.F32
+    [0x68 ... 0x6D] = 4,    // F64 арифметика
+    [0x6E ... 0x6F] = 3,    // ABS/SQRT.F64
+    [0x70 ... 0x74] = 5,    // STORE.*
+    [0x76] = 5,
+    [0x78 ... 0x7B] = 5,
+    [0x80 ... 0x89] = 5,    // LOAD.*
+    [0x8E] = 3,             // ADDR_OF
+    [0x8F] = 4,             // ALLOCA
+    [0x90] = 3,             // преобразования
+    [0x92 ... 0x99] = 3,
+    [0x9B ... 0xA1] = 3,
+    [0xA4 ... 0xB5] = 3,
+    [0xBC ... 0xBD] = 3,
+    [0xBE ... 0xBF] = 5,    // SELECT.I32 / SELECT.I64
+    [0xC0 ... 0xD3] = 4,    // сравнения
+    [0xD4 ... 0xD6] = 5,    // SELECT.F32/F64/PTR
+    [0xD7 ... 0xDC] = 4,    // ATOMIC.RMW.*.I32
+    [0xDD] = 5,             // ATOMIC.RMW.CMPXCHG.I32
+    [0xDE ... 0xDF] = 3,    // ATOMIC.LOAD/STORE.I32
+    [0xE0 ... 0xEB] = 4,    // сравнения
+    [0xEC ... 0xED] = 3,    // ATOMIC.LOAD/STORE.I64
+    [0xEE] = 1,             // ATOMIC.FENCE
+    [0xF0 ... 0xF5] = 4,    // ATOMIC.RMW.*.I64
+    [0xF6] = 5,             // ATOMIC.RMW.CMPXCHG.I64
+};
+
+#if UINTPTR_MAX <= UINT32_MAX
+// Опкоды, которые читают или пишут 64-битные значения (I64/U64/F64), занимают пару
+// регистров (V128) или адресуют регистр через указатель (ADDR_OF).
+static const bool s_insn_wide[256] = {
+    [0x13] = true,          // MOV.I64
+    [0x19] = true,          // LDC.I64.IMM
+    [0x1B] = true,          // LDC.F64.IMM
+    [0x30 ... 0x3E] = true, // I64 арифметика/логика
+    [0x50 ... 0x58] = true, // I64 *.IMM8
+    [0x68 ... 0x6F] = true, // F64 арифметика
+    [0x76] = true,          // STORE.I64
+    [0x79] = true,          // STORE.F64
+    [0x85] = true,          // LOAD.I64
+    [0x87] = true,          // LOAD.F64
+    [0x8E] = true,          // ADDR_OF
+    [0x90] = true,          // TRUNC.I64.I32
+    [0x92] = true,          // TRUNC.I64.I8
+    [0x98] = true,          // ZEXT.I8.I64
+    [0x9B] = true,          // ZEXT.I32.I64
+    [0x9E] = true,          // SEXT.I8.I64
+    [0xA0 ... 0xA1] = true, // SEXT.I16/I32.I64
+    [0xA4 ... 0xA5] = true, // FPROUND / FPROMOTE
+    [0xA7 ... 0xA9] = true, // CVT.F32.U64, CVT.F64.U32/U64
+    [0xAB ... 0xAD] = true, // CVT.F32.I64, CVT.F64.I32/I64
+    [0xAF ... 0xB1] = true, // CVT.U32.F64, CVT.U64.F32/F64
+    [0xB3 ... 0xB5] = true, // CVT.I32.F64, CVT.I64.F32/F64
+    [0xBF] = true,          // SELECT.I64
+    [0xCA ... 0xD3] = true, // CMP.*.I64
+    [0xD5] = true,          // SELECT.F64
+    [0xE6 ... 0xEB] = true, // CMP.*.F64
+    [0xEC ... 0xED] = true, // ATOMIC.LOAD/STORE.I64
+    [0xF0 ... 0xF6] = true, // ATOMIC.RMW.*.I64
+    [0xFD] = true,          // V128
+};
+
+static inline bool value_type_wide(EspbValueType type) {
+    return type == ESPB_TYPE_I64 || type == ESPB_TYPE_U64 || type == ESPB_TYPE_F64 || type == ESPB_TYPE_V128;
+}
+
+static bool signature_wide(const EspbModule *module, uint32_t sig_idx) {
+    if (sig_idx >= module->num_signatures) return true;
+    const EspbFuncSignature *sig = &module->signatures[sig_idx];
+    for (uint32_t i = 0; i < sig->num_params; ++i) {
+        if (value_type_wide(sig->param_types[i])) return true;
+    }
+    for (uint32_t i = 0; i < sig->num_returns; ++i) {
+        if (value_type_wide(sig->return_types[i])) return true;
+    }
+    return false;
+}
+#endif
+
+// Длина операндов 0xFC-инструкции после байта подкода.
+static size_t fc_operand_len(uint8_t sub_op) {
+    switch (sub_op) {
+        case 0x00: return 4 + 3;       // MEMORY.INIT seg(u32), Rd, Rs, Rn
+        case 0x01: return 4;           // DATA.DROP seg(u32)
+        case 0x02:                     // MEMORY.COPY
+        case 0x03:                     // MEMORY.FILL
+        case 0x06:                     // HEAP_REALLOC
+        case 0x09:                     // HEAP_CALLOC
+        case 0x18:                     // TABLE.GET
+        case 0x19: return 3;           // TABLE.SET
+        case 0x04: return 1 + 4 + 3;   // TABLE.INIT table(u8), seg(u32), Rd, Rs, Rn
+        case 0x07:                     // HEAP_FREE
+        case 0x0C: return 1;           // MEMORY.SIZE
+        case 0x08:                     // TABLE.SIZE
+        case 0x0B:                     // HEAP_MALLOC
+        case 0x0D: return 2;           // MEMORY.GROW
+        case 0x16: return 5;           // TABLE.COPY
+        case 0x17: return 4;           // TABLE.FILL
+        default:   return 0;
+    }
+}
+
+size_t espb_instruction_length(const uint8_t *pc, const uint8_t *end) {
+    if (!pc || pc >= end) return 0;
+
+    const size_t avail = (size_t)(end - pc);
+    const uint8_t opcode = pc[0];
+    size_t len;
+
+    switch (opcode) {
+        case 0x04: { // BR_TABLE Ridx(u8), num_targets(u16), targets(i16)[n], default(i16)
+            if (avail < 4) return 0;
+            uint16_t num_targets;
+            memcpy(&num_targets, pc + 2, sizeof(num_targets));
+            len = 1 + 1 + 2 + (size_t)num_targets * 2 + 2;
+            break;
+        }
+        case 0x09: { // CALL_IMPORT import_idx(u16) [0xAA, n, types[n]]
+            len = 3;
+            if (avail > len && pc[len] == 0xAA) {
+                if (avail < len + 2) return 0;
+                len += 2 + pc[len + 1];
+            }
+            break;
+        }
+        case 0xFC: {
+            if (avail < 2) return 0;
+            size_t sub_len = fc_operand_len(pc[1]);
+            if (sub_len == 0) return 0;
+            len = 2 + sub_len;
+            break;
+        }
+        case 0xFD: { // V128
+            if (avail < 2) return 0;
+            size_t sub_len = espb_v128_operand_len(pc[1]);
+            if (sub_len == 0) return 0;
+            len = 2 + sub_len;
+            break;
+        }
+        default:
+            len = s_insn_len[opcode];
+            if (len == 0) return 0;
+            break;
+    }
+    return len <= avail ? len : 0;
+}
+
+// Размер инструкции в прошитом потоке
+static size_t threaded_insn_size(const uint8_t *insn, size_t len) {
+    switch (insn[0]) {
+        case 0x00:
+        case 0x01: {
+            return 0; // NOP в поток не попадает: его смещение совпадает со следующей инструкцией
+        }
+        case 0x02:
+        case 0x03: {
+            return ESPB_THREADED_BR_LEN;
+        }
+        case 0x04: {
+            uint16_t num_targets;
+            memcpy(&num_targets, insn + 2, sizeof(num_targets));
+            return ESPB_THREADED_BR_TABLE_LEN(num_targets);
+        }
+        default:
+            return ESPB_THREADED_ALIGN(ESPB_THREADED_HDR + (len - 1));
+    }
+}
+
+// Смещение цели перехода в прошитом потоке относительно начала прошитой инструкции.
+static bool map_branch_target(const uint32_t *offset_map, uint32_t code_size,
+                              int64_t target, uint32_t insn_new_off, int32_t *out_disp) {
+    if (target < 0 || target > (int64_t)code_size) return false;
+    uint32_t new_target = offset_map[target];
+    if (new_target == THREADED_NO_OFFSET) return false; // Переход в середину инструкции
+    *out_disp = (int32_t)((int64_t)new_target - (int64_t)insn_new_off);
+    return true;
+}
+
+static inline void mark_target(uint8_t *targets, uint32_t code_size, int64_t target) {
+    if (target >= 0 && target <= (int64_t)code_size) {
+        targets[target >> 3] |= (uint8_t)(1u << (target & 7));
+    }
+}
+
+static inline bool is_target(const uint8_t *targets, uint32_t off) {
+    return (targets[off >> 3] & (1u << (off & 7))) != 0;
+}
+
+// Суперинструкции: пара (insn, next) заменяется одной прошитой инструкцией.
+// Вторая инструкция пары не должна быть целью перехода.
+typedef enum {
+    FUSED_NONE = 0,
+    FUSED_CMP_I32_BR_IF,    // CMP.*.I32 Rd, R1, R2 ; BR_IF Rd, off
+    FUSED_ADD_I32_IMM8_BR,  // ADD.I32.IMM8 Rd, R1, imm8 ; BR off
+} FusedKind;
+
+static FusedKind fused_pair_kind(const uint8_t *code, uint32_t code_size, uint32_t off, size_t len,
+                                 const uint8_t *targets, const EspbThreadedHandlers *handlers) {
+    const uint32_t next = off + (uint32_t)len;
+    if (next >= code_size || is_target(targets, next)) return FUSED_NONE;
+    const uint8_t op = code[off];
+    const uint8_t next_op = code[next];
+
+    if (op >= 0xC0 && op <= 0xC9 && next_op == 0x03 &&
+        next + 4 <= code_size && code[next + 1] == code[off + 1] &&
+        handlers->cmp_i32_br_if != NULL) {
+        return FUSED_CMP_I32_BR_IF;
+    }
+    if (op == 0x40 && next_op == 0x02 && next + 3 <= code_size &&
+        handlers->add_i32_imm8_br != NULL) {
+        return FUSED_ADD_I32_IMM8_BR;
+    }
+    return FUSED_NONE;
+}
+
+// Проходы 0 и 1 трансляции: проверка длин, сбор целей переходов (targets) и размещение
+// инструкций: offset_map[orig] = смещение в прошитом потоке, offset_map[code_size] = страж.
+static EspbResult threaded_layout(const EspbFunctionBody *body, const EspbThreadedHandlers *handlers,
+                                  uint32_t *offset_map, uint8_t *targets, size_t *out_size) {
+    const uint8_t *code = body->code;
+    const uint8_t *code_end = code + body->code_size;
+    const uint32_t code_size = body->code_size;
+    memset(offset_map, 0xFF, ((size_t)code_size + 1) * sizeof(uint32_t));
+
+    // Проход 0: проверка длин и сбор целей переходов
+    for (uint32_t off = 0; off < code_size; ) {
+        const uint8_t *insn = code + off;
+        size_t len = espb_instruction_length(insn, code_end);
+        if (len == 0) {
+            return ESPB_ERR_INVALID_OPCODE;
+        }
+        int16_t rel;
+        if (insn[0] == 0x02) {
+            memcpy(&rel, insn + 1, sizeof(rel));
+            mark_target(targets, code_size, (int64_t)off + rel);
+        } else if (insn[0] == 0x03) {
+            memcpy(&rel, insn + 2, sizeof(rel));
+            mark_target(targets, code_size, (int64_t)off + rel);
+        } else if (insn[0] == 0x04) {
+            uint16_t num_targets;
+            memcpy(&num_targets, insn + 2, sizeof(num_targets));
+            for (uint32_t i = 0; i <= num_targets; ++i) {
+                memcpy(&rel, insn + 4 + i * 2, sizeof(rel));
+                mark_target(targets, code_size, (int64_t)off + (int64_t)len + rel);
+            }
+        }
+        off += (uint32_t)len;
+    }
+
+    // Проход 1: размещение инструкций в прошитом потоке
+    size_t threaded_size = 0;
+    for (uint32_t off = 0; off < code_size; ) {
+        size_t len = espb_instruction_length(code + off, code_end);
+        if (threaded_size > UINT32_MAX / 2) {
+            return ESPB_ERR_INVALID_CODE_SECTION;
+        }
+        offset_map[off] = (uint32_t)threaded_size;
+        if (fused_pair_kind(code, code_size, off, len, targets, handlers) != FUSED_NONE) {
+            threaded_size += ESPB_THREADED_FUSED_LEN;
+            off += (uint32_t)len;
+            len = espb_instruction_length(code + off, code_end); // вторая инструкция пары
+        } else {
+            threaded_size += threaded_insn_size(code + off, len);
+        }
+        off += (uint32_t)len;
+    }
+    offset_map[code_size] = (uint32_t)threaded_size;
+    *out_size = threaded_size;
+    return ESPB_OK;
+}
+
+EspbResult espb_threaded_translate_function(EspbFunctionBody *body, const EspbThreadedHandlers *handlers) {
+    if (!body || !handlers || !handlers->dispatch_table) return ESPB_ERR_INVALID_OPERAND;
+    if (body->is_threaded) return ESPB_OK;
+    if (!body->code || body->code_size == 0) return ESPB_ERR_INVALID_CODE_SECTION;
+
+    const uint8_t *code = body->code;
+    const uint8_t *code_end = code + body->code_size;
+    const uint32_t code_size = body->code_size;
+    EspbResult res = ESPB_OK;
+    uint8_t *buf = NULL;
+
+    // offset_map[orig] = смещение инструкции в прошитом потоке (только на границах инструкций);
+    // offset_map[code_size] = смещение стража. targets - битовая карта целей переходов.
+    uint32_t *offset_map = (uint32_t *)malloc(((size_t)code_size + 1) * sizeof(uint32_t));
+    uint8_t *targets = (uint8_t *)calloc(((size_t)code_size + 1 + 7) / 8, 1);
+    if (!offset_map || !targets) {
+        res = ESPB_ERR_MEMORY_ALLOC;
+        goto cleanup;
+    }
+
+    size_t threaded_size = 0;
+    res = threaded_layout(body, handlers, offset_map, targets, &threaded_size);
+    if (res != ESPB_OK) goto cleanup;
+    const size_t sentinel_off = threaded_size;
+    threaded_size += ESPB_THREADED_ALIGN(ESPB_THREADED_HDR);
+
+    buf = (uint8_t *)calloc(1, threaded_size); // нули в паддинге обязательны
+    if (!buf) {
+        res = ESPB_ERR_MEMORY_ALLOC;
+        goto cleanup;
+    }
+
+    // Проход 2: эмиссия
+    uint32_t fused_count = 0;
+    for (uint32_t off = 0; off < code_size; ) {
+        const uint8_t *insn = code + off;
+        size_t len = espb_instruction_length(insn, code_end);
+        const uint32_t new_off = offset_map[off];
+        uint8_t *out = buf + new_off;
+        const uint8_t opcode = insn[0];
+        const FusedKind fused = fused_pair_kind(code, code_size, off, len, targets, handlers);
+        bool ok = true;
+
+        if (opcode == 0x00 || opcode == 0x01) {
+            off += (uint32_t)len;
+            continue;
+        }
+        out[ESPB_THREADED_SLOT] = opcode;
+        if (fused != FUSED_NONE) {
+            // [handler][opcode первой инструкции][её 3 байта операндов] @FUSED_DISP: i32 disp
+            const uint8_t *second = insn + len;
+            int16_t rel;
+            int32_t disp = 0; // map_branch_target не пишет его, если цель не найдена
+            if (fused == FUSED_CMP_I32_BR_IF) {
+                memcpy(&rel, second + 2, sizeof(rel));
+                memcpy(out, &handlers->cmp_i32_br_if, sizeof(void *));
+            } else {
+                memcpy(&rel, second + 1, sizeof(rel));
+                memcpy(out, &handlers->add_i32_imm8_br, sizeof(void *));
+            }
+            memcpy(out + ESPB_THREADED_HDR, insn + 1, 3);
+            ok = map_branch_target(offset_map, code_size, (int64_t)(off + len) + rel, new_off, &disp);
+            if (ok) memcpy(out + ESPB_THREADED_FUSED_DISP, &disp, sizeof(disp));
+            len += espb_instruction_length(second, code_end);
+            fused_count++;
+        } else switch (opcode) {
+            case 0x02: { // BR offset(i16) от начала инструкции
+                int16_t rel;
+                memcpy(&rel, insn + 1, sizeof(rel));
+                int32_t disp = 0;
+                ok = map_branch_target(offset_map, code_size, (int64_t)off + rel, new_off, &disp);
+                memcpy(out, &handlers->br, sizeof(void *));
+                if (ok) memcpy(out + ESPB_THREADED_BR_DISP, &disp, sizeof(disp));
+                break;
+            }
+            case 0x03: { // BR_IF reg(u8), offset(i16) от начала инструкции
+                int16_t rel;
+                memcpy(&rel, insn + 2, sizeof(rel));
+                int32_t disp = 0;
+                ok = map_branch_target(offset_map, code_size, (int64_t)off + rel, new_off, &disp);
+                memcpy(out, &handlers->br_if, sizeof(void *));
+                out[ESPB_THREADED_HDR] = insn[1];
+                if (ok) memcpy(out + ESPB_THREADED_BR_DISP, &disp, sizeof(disp));
+                break;
+            }
+            case 0x04: { // BR_TABLE: смещения считаются от конца инструкции
+                uint16_t num_targets;
+                memcpy(&num_targets, insn + 2, sizeof(num_targets));
+                const int64_t base = (int64_t)off + (int64_t)len;
+                const uint32_t count = num_targets;
+                memcpy(out, &handlers->br_table, sizeof(void *));
+                out[ESPB_THREADED_HDR] = insn[1];
+                memcpy(out + ESPB_THREADED_BR_DISP, &count, sizeof(count));
+                for (uint32_t i = 0; ok && i <= count; ++i) { // i == count - default
+                    int16_t rel;
+                    memcpy(&rel, insn + 4 + i * 2, sizeof(rel));
+                    int32_t disp = 0;
+                    ok = map_branch_target(offset_map, code_size, base + rel, new_off, &disp);
+                    if (ok) memcpy(out + ESPB_THREADED_BR_DISP + 4 + i * 4, &disp, sizeof(disp));
+                }
+                break;
+            }
+            case 0x10:
+            case 0x11:
+            case 0x12: { // MOV: в функции без 64-битных значений старшее слово регистра не читается
+                void *handler = (body->regs32 && handlers->mov32) ? handlers->mov32 : handlers->dispatch_table[opcode];
+                memcpy(out, &handler, sizeof(void *));
+                memcpy(out + ESPB_THREADED_HDR, insn + 1, len - 1);
+                break;
+            }
+            default:
+                memcpy(out, &handlers->dispatch_table[opcode], sizeof(void *));
+                memcpy(out + ESPB_THREADED_HDR, insn + 1, len - 1);
+                break;
+        }
+
+        if (!ok) {
+            // Поток не достроен: буфер освобождается, функция остаётся на байт-коде
+            ESP_LOGW(TAG, "Branch at offset %" PRIu32 " has invalid target, keeping bytecode", off);
+            res = ESPB_ERR_INVALID_OPERAND;
+            goto cleanup;
+        }
+        off += (uint32_t)len;
+    }
+
+    memcpy(buf + sentinel_off, &handlers->end_of_code, sizeof(void *));
+
+    body->threaded_code_buffer = buf;
+    body->threaded_code_size_bytes = threaded_size;
+    body->is_threaded = true;
+    buf = NULL;
+    ESP_LOGD(TAG, "Translated %" PRIu32 " bytes -> %zu bytes, %" PRIu32 " superinstructions",
+             code_size, threaded_size, fused_count);
+
+cleanup:
+    free(buf);
+    free(targets);
+    free(offset_map);
+    return res;
+}
+
+bool espb_threaded_bytecode_offset(const EspbFunctionBody *body, const EspbThreadedHandlers *handlers,
+                                   uint32_t threaded_off, uint32_t *out_bc_off) {
+    if (!body || !handlers || !body->is_threaded || !body->code || !out_bc_off) return false;
+    const uint32_t code_size = body->code_size;
+    uint32_t *offset_map = (uint32_t *)malloc(((size_t)code_size + 1) * sizeof(uint32_t));
+    uint8_t *targets = (uint8_t *)calloc(((size_t)code_size + 1 + 7) / 8, 1);
+    bool found = false;
+    size_t threaded_size = 0;
+    if (offset_map && targets && threaded_layout(body, handlers, offset_map, targets, &threaded_size) == ESPB_OK) {
+        // Серия NOP делит смещение со следующей инструкцией: предпочитаем цель перехода
+        // (заголовок цикла для OSR), иначе первое совпадение
+        for (uint32_t off = 0; off < code_size; ++off) {
+            if (offset_map[off] == threaded_off) {
+                if (!found) *out_bc_off = off;
+                found = true;
+                if (is_target(targets, off)) {
+                    *out_bc_off = off;
+                    break;
+                }
+            } else if (found) {
+                break;
+            }
+        }
+    }
+    free(targets);
+    free(offset_map);
+    return found;
+}
+
+bool espb_function_regs32(const EspbModule *module, uint32_t local_func_idx) {
+#if UINTPTR_MAX > UINT32_MAX
+    (void)module;
+    (void)local_func_idx;
+    return false; // PTR в регистре занимает все 8 байт
+#else
+    if (!module || local_func_idx >= module->num_functions) return false;
+    const EspbFunctionBody *body = &module->function_bodies[local_func_idx];
+    if (!body->code || signature_wide(module, module->function_signature_indices[local_func_idx])) return false;
+
+    const uint8_t *code_end = body->code + body->code_size;
+    for (const uint8_t *insn = body->code; insn < code_end; ) {
+        size_t len = espb_instruction_length(insn, code_end);
+        if (len == 0 || s_insn_wide[insn[0]]) return false;
+        uint16_t idx;
+        switch (insn[0]) {
+            case 0x09: { // CALL_IMPORT import_idx(u16) [0xAA, n, types[n]]
+                memcpy(&idx, insn + 1, sizeof(idx));
+                if (idx >= module->num_imports || module->imports[idx].kind != ESPB_IMPORT_KIND_FUNC ||
+                    signature_wide(module, module->imports[idx].desc.func.type_idx)) {
+                    return false;
+                }
+                for (size_t i = 5; i < len; ++i) {
+                    if (value_type_wide((EspbValueType)insn[i])) return false;
+                }
+                break;
+            }
+            case 0x0A: { // CALL local_func_idx(u16)
+                memcpy(&idx, insn + 1, sizeof(idx));
+                if (idx >= module->num_functions || signature_wide(module, module->function_signature_indices[idx])) {
+                    return false;
+                }
+                break;
+            }
+            case 0x0B: // CALL_INDIRECT Rfunc, type_idx(u16)
+            case 0x0D: { // CALL_INDIRECT_PTR Rptr, type_idx(u16)
+                memcpy(&idx, insn + 2, sizeof(idx));
+                if (signature_wide(module, idx)) return false;
+                break;
+            }
+            case 0x1E: // LD_GLOBAL Rd, global_idx(u16)
+            case 0x1F: { // ST_GLOBAL global_idx(u16), Rs
+                memcpy(&idx, insn + (insn[0] == 0x1E ? 2 : 1), sizeof(idx));
+                if (idx >= module->num_globals || value_type_wide(module->globals[idx].type)) return false;
+                break;
+            }
+            default:
+                break;
+        }
+        insn += len;
+    }
+    return true;
+#endif
+}
+
+void espb_threaded_translate_module(EspbModule *module, const EspbThreadedHandlers *handlers) {
+    if (!module || !handlers || module->threaded_code_prepared) return;
+    module->threaded_code_prepared = true;
+
+    uint32_t translated = 0;
+    size_t total_bytes = 0;
+    for (uint32_t i = 0; i < module->num_functions; ++i) {
+        EspbFunctionBody *body = &module->function_bodies[i];
+        // Функции, уже скомпилированные JIT, интерпретатором не исполняются
+        if (body->is_jit_compiled && body->jit_code != NULL) continue;
+        if (espb_threaded_translate_function(body, handlers) == ESPB_OK) {
+            translated++;
+            total_bytes += body->threaded_code_size_bytes;
+        } else {
+            ESP_LOGD(TAG, "Func[%" PRIu32 "] stays on bytecode dispatch", i);
+        }
+    }
+    ESP_LOGI(TAG, "Threaded code: %" PRIu32 "/%" PRIu32 " functions, %zu bytes",
+             translated, module->num_functions, total_bytes);
+}
+
+void espb_threaded_free_function(EspbFunctionBody *body) {
+    if (!body) return;
+    body->is_threaded = false;
+    free(body->threaded_code_buffer);
+    body->threaded_code_buffer = NULL;
+    body->threaded_code_size_bytes = 0;
+}
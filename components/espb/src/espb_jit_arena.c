@@ -0,0 +1,158 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "espb_jit_arena.h"
+#include "espb_exec_memory.h"
+#include "esp_log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "espb_jit_arena";
+
+#define ARENA_ALIGN4(x) (((x) + 3u) & ~(size_t)3u)
+
+void espb_jit_arena_init(EspbJitArena *arena, size_t chunk_size) {
+    arena->chunks = NULL;
+    arena->reserved = NULL;
+    arena->chunk_size = chunk_size;
+}
+
+static void arena_free_chunk(EspbJitArena *arena, EspbJitArenaChunk *chunk) {
+    EspbJitArenaChunk **link = &arena->chunks;
+    while (*link && *link != chunk) link = &(*link)->next;
+    if (*link) *link = chunk->next;
+    if (arena->reserved == chunk) arena->reserved = NULL;
+    espb_exec_free(chunk->base);
+    free(chunk);
+}
+
+void espb_jit_arena_destroy(EspbJitArena *arena) {
+    while (arena->chunks) {
+        arena_free_chunk(arena, arena->chunks);
+    }
+}
+
+static EspbJitArenaChunk *arena_find_chunk(const EspbJitArena *arena, const void *code) {
+    const uint8_t *p = (const uint8_t *)code;
+    for (EspbJitArenaChunk *c = arena->chunks; c; c = c->next) {
+        if (p >= c->base && p < c->base + c->size) return c;
+    }
+    return NULL;
+}
+
+bool espb_jit_arena_owns(const EspbJitArena *arena, const void *code) {
+    return arena_find_chunk(arena, code) != NULL;
+}
+
+// Остров сравнивается словами: байтовое чтение IRAM на Xtensa вызывает LoadStoreError
+static bool chunk_island_matches(const EspbJitArenaChunk *chunk, const uint32_t *island, size_t island_count) {
+    if (chunk->island_count != island_count) return false;
+    const uint32_t *words = (const uint32_t *)chunk->base;
+    for (size_t i = 0; i < island_count; i++) {
+        if (words[i] != island[i]) return false;
+    }
+    return true;
+}
+
+__attribute__((noinline, cold))
+static EspbJitArenaChunk *arena_new_chunk(EspbJitArena *arena, size_t need, const uint32_t *island,
+                                          size_t island_count) {
+    size_t island_bytes = island_count * sizeof(uint32_t);
+    size_t exact = island_bytes + need;
+    size_t size = exact < arena->chunk_size ? arena->chunk_size : exact;
+
+    EspbJitArenaChunk *chunk = (EspbJitArenaChunk *)malloc(sizeof(*chunk));
+    if (!chunk) return NULL;
+    chunk->base = (uint8_t *)espb_exec_alloc(size);
+    if (!chunk->base && size > exact) {
+        // Полный блок не помещается: хотя бы блок под одну функцию
+        size = exact;
+        chunk->base = (uint8_t *)espb_exec_alloc(size);
+    }
+    if (!chunk->base) {
+        free(chunk);
+        return NULL;
+    }
+
+    uint32_t *words = (uint32_t *)chunk->base;
+    for (size_t i = 0; i < island_count; i++) words[i] = island[i];
+    chunk->size = size;
+    chunk->used = island_bytes;
+    chunk->live = 0;
+    chunk->island_count = island_count;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+
+    ESP_LOGD(TAG, "New chunk %p size=%u island=%u", (void *)chunk->base, (unsigned)size, (unsigned)island_count);
+    return chunk;
+}
+
+bool espb_jit_arena_reserve(EspbJitArena *arena, size_t max_size, const uint32_t *island, size_t island_count,
+                            EspbJitArenaReservation *out) {
+    if (arena->reserved) espb_jit_arena_abort(arena, NULL);
+
+    size_t need = ARENA_ALIGN4(max_size);
+    EspbJitArenaChunk *chunk = NULL;
+    for (EspbJitArenaChunk *c = arena->chunks; c; c = c->next) {
+        if (c->size - c->used >= need && chunk_island_matches(c, island, island_count)) {
+            chunk = c;
+            break;
+        }
+    }
+    if (!chunk) chunk = arena_new_chunk(arena, need, island, island_count);
+    if (!chunk) return false;
+
+    arena->reserved = chunk;
+    out->code = chunk->base + chunk->used;
+    out->capacity = chunk->size - chunk->used;
+    out->island = chunk->island_count ? (const uint32_t *)chunk->base : NULL;
+    out->island_count = chunk->island_count;
+    return true;
+}
+
+void espb_jit_arena_commit(EspbJitArena *arena, void *code, size_t used) {
+    EspbJitArenaChunk *chunk = arena->reserved;
+    if (!chunk || (uint8_t *)code != chunk->base + chunk->used) {
+        ESP_LOGE(TAG, "Commit of %p without matching reservation", code);
+        return;
+    }
+    size_t bytes = ARENA_ALIGN4(used);
+    chunk->used += bytes;
+    chunk->live += bytes;
+    arena->reserved = NULL;
+}
+
+void espb_jit_arena_abort(EspbJitArena *arena, void *code) {
+    (void)code;
+    EspbJitArenaChunk *chunk = arena->reserved;
+    arena->reserved = NULL;
+    if (chunk && chunk->live == 0) arena_free_chunk(arena, chunk);
+}
+
+void espb_jit_arena_release(EspbJitArena *arena, void *code, size_t size) {
+    EspbJitArenaChunk *chunk = arena_find_chunk(arena, code);
+    if (!chunk) return;
+    size_t bytes = ARENA_ALIGN4(size);
+    chunk->live = bytes < chunk->live ? chunk->live - bytes : 0;
+    if (chunk == arena->reserved) return;
+    // Последняя функция блока возвращает байты в хвост: их займёт следующая компиляция.
+    // Дыры внутри блока не переиспользуются (живой код не перемещается), блок
+    // возвращается региону JIT целиком, когда пуст.
+    if ((uint8_t *)code + bytes == chunk->base + chunk->used) chunk->used -= bytes;
+    if (chunk->live == 0) arena_free_chunk(arena, chunk);
+}
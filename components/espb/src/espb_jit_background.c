@@ -0,0 +1,161 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "espb_jit_background.h"
+#include "espb_jit_dispatcher.h"
+
+#include <stdlib.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+#if CONFIG_ESPB_JIT_ENABLED && CONFIG_ESPB_JIT_BACKGROUND
+
+static const char *TAG = "espb_jit_bg";
+
+#define ESPB_JIT_BG_STOP UINT32_MAX  // local_func_idx запроса остановки
+
+#if CONFIG_FREERTOS_UNICORE
+#define ESPB_JIT_BG_CORE 0
+#else
+#define ESPB_JIT_BG_CORE CONFIG_ESPB_JIT_BG_TASK_CORE
+#endif
+
+typedef struct {
+    uint32_t local_func_idx;
+    bool tier_up;
+} EspbJitBgRequest;
+
+struct EspbJitBackground {
+    EspbInstance *instance;
+    QueueHandle_t queue;
+    SemaphoreHandle_t stopped;   // Отдаётся задачей перед самоудалением
+    TaskHandle_t task;
+};
+
+static void espb_jit_bg_task(void *arg) {
+    EspbJitBackground *bg = (EspbJitBackground *)arg;
+    EspbInstance *instance = bg->instance;
+    EspbJitBgRequest req;
+
+    for (;;) {
+        if (xQueueReceive(bg->queue, &req, portMAX_DELAY) != pdTRUE) continue;
+        if (req.local_func_idx == ESPB_JIT_BG_STOP) break;
+
+        uint32_t func_idx = req.local_func_idx + instance->module->num_imported_funcs;
+        int64_t t0 = esp_timer_get_time();
+#if CONFIG_ESPB_JIT_TIERED
+        if (req.tier_up) {
+            if (!espb_jit_tier_up_compile(instance, req.local_func_idx)) continue;
+        } else
+#endif
+        {
+            size_t jit_size = 0;
+            EspbResult res = espb_jit_compile_and_publish(instance, req.local_func_idx, &jit_size);
+            if (res == ESPB_ERR_JIT_BUSY || (res == ESPB_OK && jit_size == 0)) continue; // Компилирует/скомпилировал другой путь
+            if (res == ESPB_ERR_MEMORY_ALLOC || res == ESPB_ERR_OUT_OF_MEMORY) {
+                // Нехватка памяти временна (jit_state снова NONE): следующий вызов поставит заново
+                __atomic_store_n(&instance->module->function_bodies[req.local_func_idx].jit_bg_queued, false,
+                                 __ATOMIC_RELEASE);
+                continue;
+            }
+            if (res != ESPB_OK) {
+                // jit_bg_queued остаётся установленным: функция остаётся в интерпретаторе
+                ESP_LOGW(TAG, "Failed to compile function %u (error %d), using interpreter", (unsigned)func_idx, res);
+                continue;
+            }
+        }
+        ESP_LOGI(TAG, "Function %u compiled in background (%lld us)", (unsigned)func_idx,
+                 (long long)(esp_timer_get_time() - t0));
+    }
+
+    xSemaphoreGive(bg->stopped);
+    vTaskDelete(NULL);
+}
+
+EspbResult espb_jit_bg_start(EspbInstance *instance) {
+    if (!instance) return ESPB_ERR_INVALID_OPERAND;
+    if (instance->jit_bg) return ESPB_OK;
+
+    EspbJitBackground *bg = (EspbJitBackground *)calloc(1, sizeof(EspbJitBackground));
+    if (!bg) return ESPB_ERR_MEMORY_ALLOC;
+    bg->instance = instance;
+    bg->queue = xQueueCreate(CONFIG_ESPB_JIT_BG_QUEUE_LENGTH, sizeof(EspbJitBgRequest));
+    bg->stopped = xSemaphoreCreateBinary();
+    if (!bg->queue || !bg->stopped) goto fail;
+
+    if (xTaskCreatePinnedToCore(espb_jit_bg_task, "espb_jit", CONFIG_ESPB_JIT_BG_TASK_STACK_SIZE, bg,
+                                CONFIG_ESPB_JIT_BG_TASK_PRIORITY, &bg->task, ESPB_JIT_BG_CORE) != pdPASS) {
+        goto fail;
+    }
+    instance->jit_bg = bg;
+    return ESPB_OK;
+
+fail:
+    ESP_LOGE(TAG, "Failed to start background JIT task");
+    if (bg->queue) vQueueDelete(bg->queue);
+    if (bg->stopped) vSemaphoreDelete(bg->stopped);
+    free(bg);
+    return ESPB_ERR_MEMORY_ALLOC;
+}
+
+void espb_jit_bg_stop(EspbInstance *instance) {
+    if (!instance || !instance->jit_bg) return;
+    EspbJitBackground *bg = instance->jit_bg;
+
+    // Запрос остановки идёт вне очереди: необработанные запросы не компилируются
+    EspbJitBgRequest stop = { .local_func_idx = ESPB_JIT_BG_STOP, .tier_up = false };
+    xQueueSendToFront(bg->queue, &stop, portMAX_DELAY);
+    xSemaphoreTake(bg->stopped, portMAX_DELAY);
+
+    // Тела функций разделяемого модуля переживают экземпляр: снимаем отметки
+    // необработанных запросов, чтобы их скомпилировали другие экземпляры
+    EspbJitBgRequest req;
+    while (xQueueReceive(bg->queue, &req, 0) == pdTRUE) {
+        if (req.local_func_idx < instance->module->num_functions) {
+            __atomic_store_n(&instance->module->function_bodies[req.local_func_idx].jit_bg_queued, false, __ATOMIC_RELEASE);
+        }
+    }
+
+    instance->jit_bg = NULL;
+    vQueueDelete(bg->queue);
+    vSemaphoreDelete(bg->stopped);
+    free(bg);
+}
+
+bool espb_jit_bg_request(EspbInstance *instance, uint32_t local_func_idx, bool tier_up) {
+    EspbJitBackground *bg = instance->jit_bg;
+    if (!bg) return false;
+
+    EspbFunctionBody *body = &instance->module->function_bodies[local_func_idx];
+    if (body->jit_bg_queued || __atomic_exchange_n(&body->jit_bg_queued, true, __ATOMIC_ACQ_REL)) {
+        return true;
+    }
+
+    EspbJitBgRequest req = { .local_func_idx = local_func_idx, .tier_up = tier_up };
+    if (xQueueSend(bg->queue, &req, 0) != pdTRUE) {
+        // Очередь заполнена - повторим при одном из следующих вызовов
+        __atomic_store_n(&body->jit_bg_queued, false, __ATOMIC_RELEASE);
+    }
+    return true;
+}
+
+#endif // CONFIG_ESPB_JIT_ENABLED && CONFIG_ESPB_JIT_BACKGROUND
@@ -21,11 +21,21 @@
  */
 
 #include "espb_jit.h"
+#include "espb_exec_memory.h"
+#include "espb_jit_code_map.h"
+#include "sdkconfig.h"
 #include "esp_log.h"
-#include "esp_heap_caps.h"  // heap_caps_free for MALLOC_CAP_EXEC allocations
 #include <stdlib.h>
 #include <string.h>
 
+#ifndef CONFIG_ESPB_JIT_IRAM_BUDGET
+#define CONFIG_ESPB_JIT_IRAM_BUDGET 0
+#endif
+
+#ifndef CONFIG_ESPB_JIT_ARENA_CHUNK_SIZE
+#define CONFIG_ESPB_JIT_ARENA_CHUNK_SIZE 16384
+#endif
+
 #ifndef ESPB_JIT_DEBUG
 #define ESPB_JIT_DEBUG 0
 #endif
@@ -45,11 +55,13 @@ static const char *TAG = "espb_jit_cache";
 /**
  * @brief Инициализирует JIT cache
  */
-EspbResult espb_jit_cache_init(EspbJitCache* cache, size_t capacity) {
-    if (!cache || capacity == 0) {
+EspbResult espb_jit_cache_init(EspbJitCache* cache, const EspbModule* module) {
+    if (!cache || !module) {
         return ESPB_ERR_INVALID_OPERAND; // Используем существующую константу
     }
 
+    // Слот на каждую локальную функцию: поиск и вставка - O(1) по индексу
+    size_t capacity = module->num_functions > 0 ? module->num_functions : 1;
     cache->entries = (EspbJitCacheEntry*)calloc(capacity, sizeof(EspbJitCacheEntry));
     if (!cache->entries) {
         ESP_LOGE(TAG, "Failed to allocate JIT cache entries");
@@ -58,11 +70,36 @@ EspbResult espb_jit_cache_init(EspbJitCache* cache, size_t capacity) {
 
     cache->capacity = capacity;
     cache->count = 0;
+    cache->first_func_idx = module->num_imported_funcs;
+    cache->module = module;
+    cache->used_bytes = 0;
+    cache->budget_bytes = CONFIG_ESPB_JIT_IRAM_BUDGET;
+    cache->clock = 0;
+#if CONFIG_ESPB_JIT_ARENA
+    espb_jit_arena_init(&cache->arena, CONFIG_ESPB_JIT_ARENA_CHUNK_SIZE);
+#endif
 
     JIT_LOGI(TAG, "JIT cache initialized with capacity=%zu", capacity);
     return ESPB_OK;
 }
 
+// Код из арены возвращается ей; код снимка и сборок без арены - отдельные блоки
+static void cache_release_code(EspbJitCache* cache, void* code, size_t code_size) {
+#if CONFIG_ESPB_JIT_CODE_MAP
+    espb_jit_code_map_remove(code);
+#endif
+#if CONFIG_ESPB_JIT_ARENA
+    if (espb_jit_arena_owns(&cache->arena, code)) {
+        espb_jit_arena_release(&cache->arena, code, code_size);
+        return;
+    }
+#endif
+    (void)cache;
+    (void)code_size;
+    // Код из региона JIT или из исполняемой кучи: разбирается espb_exec_free
+    espb_exec_free(code);
+}
+
 /**
  * @brief Освобождает JIT cache
  */
@@ -71,18 +108,21 @@ void espb_jit_cache_free(EspbJitCache* cache) {
         return;
     }
 
-    // Освобождаем все скомпилированные JIT-коды (выделены из heap_caps с MALLOC_CAP_EXEC)
-    for (size_t i = 0; i < cache->count; i++) {
+    // Освобождаем все скомпилированные JIT-коды (регион JIT или исполняемая куча)
+    for (size_t i = 0; i < cache->capacity; i++) {
         if (cache->entries[i].is_valid && cache->entries[i].jit_code) {
-            // JIT code is allocated from executable-capable heap (MALLOC_CAP_EXEC), so free via heap_caps_free.
-            heap_caps_free(cache->entries[i].jit_code);
+            cache_release_code(cache, cache->entries[i].jit_code, cache->entries[i].code_size);
         }
     }
+#if CONFIG_ESPB_JIT_ARENA
+    espb_jit_arena_destroy(&cache->arena);
+#endif
 
     free(cache->entries);
     cache->entries = NULL;
     cache->capacity = 0;
     cache->count = 0;
+    cache->used_bytes = 0;
 
     JIT_LOGI(TAG, "JIT cache freed");
 }
@@ -92,16 +132,14 @@ void espb_jit_cache_free(EspbJitCache* cache) {
  * @return Указатель на JIT-код или NULL, если не найдено
  */
 void* espb_jit_cache_lookup(EspbJitCache* cache, uint32_t func_idx) {
-    if (!cache || !cache->entries) {
+    if (!cache) {
         return NULL;
     }
 
-    // Линейный поиск (для небольших cache это приемлемо)
-    for (size_t i = 0; i < cache->count; i++) {
-        if (cache->entries[i].is_valid && cache->entries[i].func_idx == func_idx) {
-            JIT_LOGD(TAG, "Cache HIT: func_idx=%u", func_idx);
-            return cache->entries[i].jit_code;
-        }
+    EspbJitCacheEntry* entry = espb_jit_cache_entry(cache, func_idx);
+    if (entry) {
+        JIT_LOGD(TAG, "Cache HIT: func_idx=%u", func_idx);
+        return entry->jit_code;
     }
 
     JIT_LOGD(TAG, "Cache MISS: func_idx=%u", func_idx);
@@ -116,27 +154,31 @@ EspbResult espb_jit_cache_insert(EspbJitCache* cache, uint32_t func_idx, void* j
         return ESPB_ERR_INVALID_OPERAND; // Используем существующую константу
     }
 
-    // Проверяем, не переполнен ли cache
-    if (cache->count >= cache->capacity) {
-        JIT_LOGW(TAG, "JIT cache is full (capacity=%zu), cannot insert func_idx=%u", 
-                 cache->capacity, func_idx);
-        return ESPB_ERR_OUT_OF_MEMORY;
+    uint32_t slot = func_idx - cache->first_func_idx;
+    if (slot >= cache->capacity) {
+        JIT_LOGW(TAG, "func_idx=%u is not a local function, cannot insert", func_idx);
+        return ESPB_ERR_INVALID_FUNC_INDEX;
     }
 
     // Проверяем, нет ли уже этой функции в cache
-    if (espb_jit_cache_lookup(cache, func_idx) != NULL) {
+    EspbJitCacheEntry* entry = &cache->entries[slot];
+    if (entry->is_valid) {
         JIT_LOGD(TAG, "Function func_idx=%u already in cache, skipping", func_idx);
         return ESPB_OK;
     }
 
     // Добавляем новую запись
-    EspbJitCacheEntry* entry = &cache->entries[cache->count];
     entry->func_idx = func_idx;
     entry->jit_code = jit_code;
     entry->code_size = code_size;
     entry->is_valid = true;
+    entry->last_use = ++cache->clock;
 
     cache->count++;
+    cache->used_bytes += code_size;
+#if CONFIG_ESPB_JIT_CODE_MAP
+    espb_jit_code_map_add(cache->module, slot, jit_code, code_size);
+#endif
 
     JIT_LOGI(TAG, "Inserted func_idx=%u into cache (code_size=%zu, total=%zu/%zu)", 
              func_idx, code_size, cache->count, cache->capacity);
@@ -151,25 +193,82 @@ void espb_jit_cache_remove(EspbJitCache* cache, uint32_t func_idx) {
         return;
     }
 
-    for (size_t i = 0; i < cache->count; i++) {
-        if (cache->entries[i].is_valid && cache->entries[i].func_idx == func_idx) {
-            // Освобождаем скомпилированный код
-            if (cache->entries[i].jit_code) {
-                // See espb_jit_cache_free(): JIT code must be freed with heap_caps_free.
-                heap_caps_free(cache->entries[i].jit_code);
-            }
+    EspbJitCacheEntry* entry = espb_jit_cache_entry(cache, func_idx);
+    if (!entry) {
+        JIT_LOGD(TAG, "func_idx=%u not found in cache", func_idx);
+        return;
+    }
+
+    // Освобождаем скомпилированный код
+    if (entry->jit_code) {
+        cache_release_code(cache, entry->jit_code, entry->code_size);
+    }
+    cache->used_bytes -= entry->code_size;
+    cache->count--;
+    memset(entry, 0, sizeof(*entry));
+    JIT_LOGI(TAG, "Removed func_idx=%u from cache", func_idx);
+}
 
-            // Сдвигаем остальные записи
-            if (i < cache->count - 1) {
-                memmove(&cache->entries[i], &cache->entries[i + 1], 
-                        (cache->count - i - 1) * sizeof(EspbJitCacheEntry));
-            }
+/**
+ * @brief Находит наименее недавно использованную запись
+ */
+uint32_t espb_jit_cache_lru(EspbJitCache* cache) {
+    if (!cache || !cache->entries || cache->count == 0) {
+        return UINT32_MAX;
+    }
 
-            cache->count--;
-            JIT_LOGI(TAG, "Removed func_idx=%u from cache", func_idx);
-            return;
+    // Линейный проход только при вытеснении (редкое событие), не на пути вызова
+    uint32_t best = UINT32_MAX;
+    uint32_t best_age = 0;
+    for (size_t i = 0; i < cache->capacity; i++) {
+        const EspbJitCacheEntry* entry = &cache->entries[i];
+        if (!entry->is_valid) continue;
+        uint32_t age = cache->clock - entry->last_use;
+        if (best == UINT32_MAX || age > best_age) {
+            best = entry->func_idx;
+            best_age = age;
         }
     }
+    return best;
+}
+
+bool espb_jit_code_reserve(EspbInstance* instance, size_t max_size, const uint32_t* island, size_t island_count,
+                           EspbJitArenaReservation* out) {
+#if CONFIG_ESPB_JIT_ARENA
+    if (instance && instance->jit_cache && instance->jit_cache->entries) {
+        return espb_jit_arena_reserve(&instance->jit_cache->arena, max_size, island, island_count, out);
+    }
+#endif
+    (void)instance;
+    (void)island;
+    (void)island_count;
+    out->code = espb_exec_alloc(max_size);
+    out->capacity = max_size;
+    out->island = NULL;
+    out->island_count = 0;
+    return out->code != NULL;
+}
 
-    JIT_LOGD(TAG, "func_idx=%u not found in cache", func_idx);
+bool espb_jit_code_commit(EspbInstance* instance, void* code, size_t used) {
+#if CONFIG_ESPB_JIT_ARENA
+    if (instance && instance->jit_cache && espb_jit_arena_owns(&instance->jit_cache->arena, code)) {
+        espb_jit_arena_commit(&instance->jit_cache->arena, code, used);
+        return true;
+    }
+#endif
+    (void)instance;
+    (void)code;
+    (void)used;
+    return false;
+}
+
+void espb_jit_code_abort(EspbInstance* instance, void* code) {
+#if CONFIG_ESPB_JIT_ARENA
+    if (instance && instance->jit_cache && espb_jit_arena_owns(&instance->jit_cache->arena, code)) {
+        espb_jit_arena_abort(&instance->jit_cache->arena, code);
+        return;
+    }
+#endif
+    (void)instance;
+    espb_exec_free(code);
 }
@@ -0,0 +1,232 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "espb_jit_code_map.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if ESPB_JIT_PC_MAPS
+
+static int pc_map_entry_cmp(const void *a, const void *b) {
+    const EspbJitPcMapEntry *x = (const EspbJitPcMapEntry *)a;
+    const EspbJitPcMapEntry *y = (const EspbJitPcMapEntry *)b;
+    if (x->native_offset != y->native_offset) return x->native_offset < y->native_offset ? -1 : 1;
+    if (x->bc_offset != y->bc_offset) return x->bc_offset < y->bc_offset ? -1 : 1;
+    return 0;
+}
+
+EspbJitPcMap *espb_jit_pc_map_create(EspbJitPcMapEntry *entries, size_t num_entries) {
+    if (!entries || num_entries == 0) return NULL;
+    qsort(entries, num_entries, sizeof(EspbJitPcMapEntry), pc_map_entry_cmp);
+    size_t n = 0;
+    for (size_t i = 0; i < num_entries; i++) {
+        if (n > 0 && entries[n - 1].native_offset == entries[i].native_offset) n--;
+        entries[n++] = entries[i];
+    }
+    EspbJitPcMap *map = (EspbJitPcMap *)malloc(sizeof(EspbJitPcMap) + n * sizeof(EspbJitPcMapEntry));
+    if (!map) return NULL;
+    map->num_entries = (uint32_t)n;
+    memcpy(map->entries, entries, n * sizeof(EspbJitPcMapEntry));
+    return map;
+}
+
+uint32_t espb_jit_pc_map_lookup(const EspbJitPcMap *map, uint32_t native_offset) {
+    uint32_t lo = 0, hi = map->num_entries;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (map->entries[mid].native_offset <= native_offset) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo > 0 ? map->entries[lo - 1].bc_offset : 0;
+}
+
+#endif // ESPB_JIT_PC_MAPS
+
+#if CONFIG_ESPB_JIT_CODE_MAP
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_rom_sys.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#if CONFIG_APPTRACE_SV_ENABLE
+#include "SEGGER_SYSVIEW.h"
+#endif
+
+static const char *TAG = "espb_jit_code_map";
+
+typedef struct CodeMapNode {
+    struct CodeMapNode *next;
+    uintptr_t start;
+    uint32_t size;
+    const EspbModule *module;
+    uint32_t local_func_idx;
+} CodeMapNode;
+
+// Список пишут задачи компиляции под s_lock; читатель паники идёт по нему без блокировки,
+// поэтому узел публикуется уже заполненным
+static CodeMapNode *s_head;
+static uint8_t s_lock;
+
+static void code_map_lock(void) {
+    while (__atomic_exchange_n(&s_lock, 1, __ATOMIC_ACQUIRE)) {
+        vTaskDelay(1);
+    }
+}
+
+static void code_map_unlock(void) {
+    __atomic_store_n(&s_lock, 0, __ATOMIC_RELEASE);
+}
+
+// Вызывается и из обработчика паники
+static IRAM_ATTR const char *code_map_export_name(const EspbModule *module, uint32_t local_func_idx) {
+    for (uint32_t e = 0; e < module->num_exports; e++) {
+        if (module->exports[e].kind == ESPB_IMPORT_KIND_FUNC && module->exports[e].index == local_func_idx) {
+            return module->exports[e].name;
+        }
+    }
+    return NULL;
+}
+
+void espb_jit_code_map_add(const EspbModule *module, uint32_t local_func_idx, const void *code, size_t code_size) {
+    if (!module || !code) return;
+    CodeMapNode *node = (CodeMapNode *)malloc(sizeof(CodeMapNode));
+    if (!node) {
+        ESP_LOGW(TAG, "No memory for code map entry of function %u", (unsigned)local_func_idx);
+        return;
+    }
+    node->start = (uintptr_t)code;
+    node->size = (uint32_t)code_size;
+    node->module = module;
+    node->local_func_idx = local_func_idx;
+
+    code_map_lock();
+    node->next = s_head;
+    __atomic_store_n(&s_head, node, __ATOMIC_RELEASE);
+    code_map_unlock();
+
+#if CONFIG_APPTRACE_SV_ENABLE
+    // Адрес кода получает имя в SystemView (ресурсы по адресу)
+    const char *name = code_map_export_name(module, local_func_idx);
+    char buf[24];
+    if (!name) {
+        snprintf(buf, sizeof(buf), "espb_func_%u", (unsigned)(local_func_idx + module->num_imported_funcs));
+        name = buf;
+    }
+    SEGGER_SYSVIEW_NameResource((U32)node->start, name);
+#endif
+}
+
+void espb_jit_code_map_remove(const void *code) {
+    code_map_lock();
+    CodeMapNode **link = &s_head;
+    CodeMapNode *node = NULL;
+    while (*link) {
+        if ((*link)->start == (uintptr_t)code) {
+            node = *link;
+            __atomic_store_n(link, node->next, __ATOMIC_RELEASE);
+            break;
+        }
+        link = &(*link)->next;
+    }
+    code_map_unlock();
+    free(node);
+}
+
+static const CodeMapNode *code_map_find(uintptr_t pc) {
+    for (const CodeMapNode *n = __atomic_load_n(&s_head, __ATOMIC_ACQUIRE); n; n = n->next) {
+        if (pc >= n->start && pc - n->start < n->size) return n;
+    }
+    return NULL;
+}
+
+bool espb_jit_code_map_lookup(uintptr_t pc, espb_jit_code_info_t *out) {
+    code_map_lock();
+    const CodeMapNode *n = code_map_find(pc);
+    if (n && out) {
+        const EspbFunctionBody *body = &n->module->function_bodies[n->local_func_idx];
+        const EspbJitPcMap *map = __atomic_load_n(&body->jit_pc_map, __ATOMIC_ACQUIRE);
+        out->code = (const void *)n->start;
+        out->code_size = n->size;
+        out->module = n->module;
+        out->func = n->local_func_idx + n->module->num_imported_funcs;
+        out->name = code_map_export_name(n->module, n->local_func_idx);
+        out->bc_offset = map ? espb_jit_pc_map_lookup(map, (uint32_t)(pc - n->start)) : ESPB_SAMPLE_OFFSET_UNKNOWN;
+    }
+    code_map_unlock();
+    return n != NULL;
+}
+
+static void code_map_write_symbol(espb_sampler_write_t write, void *user_data, uintptr_t start, uint32_t size,
+                                  const CodeMapNode *n, const char *name, uint32_t bc_offset) {
+    char buf[80];
+    int len;
+    uint32_t func = n->local_func_idx + n->module->num_imported_funcs;
+    if (name) len = snprintf(buf, sizeof(buf), "%08lx %lx espb:%s", (unsigned long)start, (unsigned long)size, name);
+    else len = snprintf(buf, sizeof(buf), "%08lx %lx espb:func_%u", (unsigned long)start, (unsigned long)size,
+                        (unsigned)func);
+    write(buf, (size_t)len, user_data);
+    if (bc_offset != ESPB_SAMPLE_OFFSET_UNKNOWN) {
+        len = snprintf(buf, sizeof(buf), "+bc_%lx", (unsigned long)bc_offset);
+        write(buf, (size_t)len, user_data);
+    }
+    write("\n", 1, user_data);
+}
+
+void espb_jit_code_map_write_all(espb_sampler_write_t write, void *user_data, bool with_offsets) {
+    code_map_lock();
+    for (const CodeMapNode *n = s_head; n; n = n->next) {
+        const char *name = code_map_export_name(n->module, n->local_func_idx);
+        const EspbJitPcMap *map = n->module->function_bodies[n->local_func_idx].jit_pc_map;
+        if (!with_offsets || !map) {
+            code_map_write_symbol(write, user_data, n->start, n->size, n, name, ESPB_SAMPLE_OFFSET_UNKNOWN);
+            continue;
+        }
+        // Диапазон на инструкцию байт-кода: от её нативного смещения до следующего
+        uint32_t begin = 0;
+        for (uint32_t i = 0; i <= map->num_entries; i++) {
+            uint32_t end = i < map->num_entries ? map->entries[i].native_offset : n->size;
+            if (end > n->size) end = n->size;
+            if (end <= begin) continue;
+            uint32_t bc = i > 0 ? map->entries[i - 1].bc_offset : 0;
+            code_map_write_symbol(write, user_data, n->start + begin, end - begin, n, name, bc);
+            begin = end;
+        }
+    }
+    code_map_unlock();
+}
+
+#if CONFIG_ESPB_JIT_CODE_MAP_PANIC
+// Обработчик паники ESP-IDF оборачивается компоновщиком (-Wl,--wrap=esp_panic_handler,
+// см. CMakeLists.txt): перед дампом регистров и backtrace печатаются диапазоны JIT-кода,
+// по которым адреса из backtrace сопоставляются функциям ESPB.
+void __real_esp_panic_handler(void *info);
+
+void IRAM_ATTR __wrap_esp_panic_handler(void *info) {
+    const CodeMapNode *n = __atomic_load_n(&s_head, __ATOMIC_ACQUIRE);
+    if (n) esp_rom_printf("\r\nESPB JIT code map:\r\n");
+    for (unsigned i = 0; n && i < CONFIG_ESPB_JIT_CODE_MAP_PANIC_MAX; n = n->next, i++) {
+        const char *name = code_map_export_name(n->module, n->local_func_idx);
+        esp_rom_printf("  0x%08x-0x%08x func %u %s\r\n", (unsigned)n->start, (unsigned)(n->start + n->size),
+                       (unsigned)(n->local_func_idx + n->module->num_imported_funcs), name ? name : "");
+    }
+    __real_esp_panic_handler(info);
+}
+#endif // CONFIG_ESPB_JIT_CODE_MAP_PANIC
+
+#endif // CONFIG_ESPB_JIT_CODE_MAP
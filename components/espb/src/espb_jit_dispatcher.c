@@ -17,12 +17,15 @@
  */
 #include "espb_jit_dispatcher.h"
 #include "espb_interpreter.h" // Для espb_call_function
+#include "espb_interpreter_runtime_oc.h" // espb_ensure_function_ready
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>  // Для memset
 
 #include "sdkconfig.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "esp_memory_utils.h"  // for esp_ptr_executable, esp_ptr_in_iram, esp_ptr_in_dram
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -34,10 +37,21 @@
 
 #if CONFIG_ESPB_JIT_ENABLED
 #include "espb_jit.h"         // Для espb_jit_compile_function
+#include "espb_jit_code_map.h" // ESPB_JIT_PC_MAPS
+#include "espb_jit_budget.h"
+#include "espb_memory_stats.h"
+#include "espb_runtime_alloca.h" // espb_jit_alloca_mark
+#endif
+#if CONFIG_ESPB_JIT_BACKGROUND
+#include "espb_jit_background.h"
+#endif
+#if CONFIG_ESPB_JIT_OSR
+#include "espb_jit_osr.h"
 #endif
 
 #if CONFIG_ESPB_JIT_ENABLED
 static size_t total_jit_size = 0;
+static const char *TAG = "espb_jit";
 #endif
 
 static uint8_t espb_get_declared_num_args_for_local(const EspbInstance *instance, uint32_t local_func_idx) {
@@ -58,7 +72,13 @@ EspbResult espb_execute_function(EspbInstance *instance, ExecutionContext *exec_
 
     // FAST PATH: если в модуле вообще нет HOT функций, JIT не может быть использован.
     // В этом случае важно не платить за какие-либо JIT-проверки и сразу идти в интерпретатор.
+    // С tier-up здесь только тикает счётчик вызовов: порог уводит на медленный путь.
     if (__builtin_expect(instance->jit_hot_function_count == 0, 1)) {
+#if CONFIG_ESPB_JIT_TIERED
+        uint32_t tier_idx = func_idx - instance->module->num_imported_funcs;
+        if (tier_idx >= instance->module->num_functions ||
+            !espb_jit_tier_up_tick(&instance->module->function_bodies[tier_idx], 1))
+#endif
         return espb_call_function(instance, exec_ctx, func_idx, args, results);
     }
 
@@ -75,44 +95,70 @@ EspbResult espb_execute_function(EspbInstance *instance, ExecutionContext *exec_
 
     // Проверяем флаг ESPB_FUNC_FLAG_HOT (0x40) - должна ли функция компилироваться через JIT
     bool is_hot_function = (body->header.flags & ESPB_FUNC_FLAG_HOT) != 0;
+#if CONFIG_ESPB_JIT_TIERED
+    is_hot_function = is_hot_function || body->tier_up_hot;
+#endif
 
     // Проверяем, скомпилирована ли функция
     if (body->is_jit_compiled && body->jit_code != NULL) {
         // JIT-путь
+        espb_jit_note_call(instance, func_idx);
         uint8_t num_args = espb_get_declared_num_args_for_local(instance, local_func_idx);
-        return execute_jit_code(instance, body->jit_code, args, num_args, results, body->header.num_virtual_regs);
+        return execute_jit_code(instance, body->jit_code, args, num_args, results, body->header.num_virtual_regs,
+                                ESPB_FRAME_ZERO_INIT_REGS(body));
     }
     
     // Функция НЕ скомпилирована
     // Компилируем ТОЛЬКО если установлен флаг ESPB_FUNC_FLAG_HOT
     if (!is_hot_function) {
+#if CONFIG_ESPB_JIT_TIERED
+        if (espb_jit_tier_up_tick(body, 1) && espb_jit_tier_up(instance, local_func_idx)) {
+            uint8_t num_args = espb_get_declared_num_args_for_local(instance, local_func_idx);
+            return execute_jit_code(instance, body->jit_code, args, num_args, results, body->header.num_virtual_regs,
+                                    ESPB_FRAME_ZERO_INIT_REGS(body));
+        }
+#endif
         // Функция НЕ помечена как HOT - выполняем через интерпретатор (по умолчанию)
         return espb_call_function(instance, exec_ctx, func_idx, args, results);
     }
 
+    // Компилирует другая задача или компиляция уже не удалась: не ждём, работает интерпретатор
+    if (__atomic_load_n(&body->jit_state, __ATOMIC_ACQUIRE) != ESPB_JIT_STATE_NONE) {
+        espb_jit_stats_fallback(instance, func_idx);
+        return espb_call_function(instance, exec_ctx, func_idx, args, results);
+    }
+
+#if CONFIG_ESPB_JIT_BACKGROUND
+    // Компиляция уходит в фоновую задачу, этот вызов (и следующие до публикации кода)
+    // обслуживает интерпретатор
+    if (espb_jit_bg_request(instance, local_func_idx, false)) {
+        espb_jit_stats_fallback(instance, func_idx);
+        return espb_call_function(instance, exec_ctx, func_idx, args, results);
+    }
+#endif
+
     // Функция помечена как HOT - пытаемся JIT-компиляцию
-    void* jit_code = NULL;
     size_t jit_size = 0;
-    EspbResult jit_res = espb_jit_compile_function(instance, func_idx, body, &jit_code, &jit_size);
+    EspbResult jit_res = espb_jit_compile_and_publish(instance, local_func_idx, &jit_size);
 
     if (jit_res == ESPB_OK) {
-        total_jit_size += jit_size;
-        printf("[JIT] Compiled HOT function %u, code size: %zu bytes. Total JIT size: %zu bytes\n", (unsigned)func_idx, jit_size, total_jit_size);
-        body->jit_code = jit_code;
-        body->jit_code_size = jit_size;
-        body->is_jit_compiled = true;
-        
-        // Добавляем в JIT cache
-        if (instance->jit_cache) {
-            espb_jit_cache_insert(instance->jit_cache, func_idx, jit_code, jit_size);
+        if (jit_size) {
+            printf("[JIT] Compiled HOT function %u, code size: %zu bytes. Total JIT size: %zu bytes\n", (unsigned)func_idx, jit_size,
+                   __atomic_load_n(&total_jit_size, __ATOMIC_RELAXED));
         }
         
         // Выполняем через JIT
         uint8_t num_args = espb_get_declared_num_args_for_local(instance, local_func_idx);
-        return execute_jit_code(instance, body->jit_code, args, num_args, results, body->header.num_virtual_regs);
+        return execute_jit_code(instance, __atomic_load_n(&body->jit_code, __ATOMIC_ACQUIRE), args, num_args, results,
+                                body->header.num_virtual_regs, ESPB_FRAME_ZERO_INIT_REGS(body));
+    } else if (jit_res == ESPB_ERR_JIT_BUSY) {
+        // Компиляцию захватила другая задача между проверкой и захватом
+        espb_jit_stats_fallback(instance, func_idx);
+        return espb_call_function(instance, exec_ctx, func_idx, args, results);
     } else {
         // Если JIT-компиляция не удалась, выполняем в интерпретаторе
         printf("[JIT] Failed to compile HOT function %u (error %d), using interpreter\n", (unsigned)func_idx, jit_res);
+        espb_jit_stats_fallback(instance, func_idx);
         return espb_call_function(instance, exec_ctx, func_idx, args, results);
     }
 #else
@@ -120,6 +166,316 @@ EspbResult espb_execute_function(EspbInstance *instance, ExecutionContext *exec_
 #endif
 }
 
+#if CONFIG_ESPB_JIT_ENABLED
+// Пакет вызовов одного JIT-кода: проверка кода, кадр регистров и счётчик активных
+// вызовов (защита от вытеснения) - один раз на весь пакет
+static EspbResult execute_jit_code_batch(EspbInstance *instance, const EspbFunctionBody *body, void *jit_code,
+                                         uint8_t num_args, const Value *args, size_t stride, size_t count,
+                                         Value *results) {
+    if (!esp_ptr_in_iram(jit_code) && !esp_ptr_in_rom(jit_code)) {
+        printf("[JIT ERROR] JIT code at %p is not in IRAM/ROM!\n", jit_code);
+        return ESPB_ERR_INVALID_OPERAND;
+    }
+
+    typedef void (*JitFunc)(EspbInstance *instance, Value *v_regs);
+    JitFunc jit_func = (JitFunc)jit_code;
+
+    uint16_t actual_regs = body->header.num_virtual_regs > 256 ? 256 : body->header.num_virtual_regs;
+    if (actual_regs < 8) actual_regs = 8;
+    Value v_regs[actual_regs] __attribute__((aligned(8)));
+
+    uint16_t n = args ? num_args : 0;
+    if (n > actual_regs) n = actual_regs;
+    uint16_t zero_regs = ESPB_FRAME_ZERO_INIT_REGS(body) < 8 ? 8 : ESPB_FRAME_ZERO_INIT_REGS(body);
+    if (zero_regs > actual_regs) zero_regs = actual_regs;
+
+#if ESPB_JIT_EVICTION
+    __atomic_fetch_add(&instance->jit_active_calls, 1, __ATOMIC_ACQ_REL);
+#endif
+    uint32_t alloca_mark = espb_jit_alloca_mark();
+    for (size_t i = 0; i < count; i++) {
+        if (n > 0) memcpy(v_regs, args + i * stride, n * sizeof(Value));
+        if (zero_regs > n) memset(&v_regs[n], 0, (size_t)(zero_regs - n) * sizeof(Value));
+        jit_func(instance, v_regs);
+        espb_jit_alloca_restore(alloca_mark);
+        if (results) results[i] = v_regs[0];
+    }
+#if ESPB_JIT_EVICTION
+    __atomic_fetch_sub(&instance->jit_active_calls, 1, __ATOMIC_ACQ_REL);
+#endif
+    return ESPB_OK;
+}
+#endif
+
+EspbResult espb_execute_function_batch(EspbInstance *instance, ExecutionContext *exec_ctx, uint32_t func_idx,
+                                       const Value *args, size_t stride, size_t count, Value *results) {
+    if (!instance || !instance->module) return ESPB_ERR_INVALID_OPERAND;
+    const EspbModule *module = instance->module;
+    uint32_t num_imported_funcs = module->num_imported_funcs;
+    if (func_idx < num_imported_funcs || func_idx >= num_imported_funcs + module->num_functions) {
+        return ESPB_ERR_INVALID_FUNC_INDEX;
+    }
+
+#if CONFIG_ESPB_JIT_ENABLED
+    uint32_t local_func_idx = func_idx - num_imported_funcs;
+    EspbFunctionBody *body = &module->function_bodies[local_func_idx];
+    uint8_t num_args = espb_get_declared_num_args_for_local(instance, local_func_idx);
+#endif
+
+    for (size_t i = 0; i < count; i++) {
+        const Value *call_args = args ? args + i * stride : NULL;
+#if CONFIG_ESPB_JIT_ENABLED
+        // Как только у функции есть JIT-код (сразу, после компиляции HOT-функции первым
+        // вызовом, tier-up или фоновой публикации), остаток пакета идёт плотным циклом
+        if (body->is_jit_compiled && body->jit_code != NULL) {
+            espb_jit_note_call(instance, func_idx);
+            espb_jit_stats_exec(instance, func_idx, (uint32_t)(count - i - 1)); // Остаток пакета
+            return execute_jit_code_batch(instance, body, body->jit_code, num_args, call_args, stride, count - i,
+                                          results ? results + i : NULL);
+        }
+        EspbResult res = espb_execute_function(instance, exec_ctx, func_idx, call_args, results ? &results[i] : NULL);
+#else
+        EspbResult res = espb_call_function(instance, exec_ctx, func_idx, call_args, results ? &results[i] : NULL);
+#endif
+        if (res != ESPB_OK) return res;
+    }
+    return ESPB_OK;
+}
+
+#if ESPB_JIT_EVICTION
+// Вытесняет наименее недавно вызванную функцию, кроме protect_local_idx.
+// Вызывается под instance_mutex и только когда JIT-код нигде не исполняется:
+// иначе освобождаемый код может быть на стеке вызовов.
+__attribute__((noinline, cold))
+static bool espb_jit_evict_lru(EspbInstance *instance, uint32_t protect_local_idx) {
+    EspbJitCache *cache = instance->jit_cache;
+    if (!cache || __atomic_load_n(&instance->jit_active_calls, __ATOMIC_ACQUIRE) != 0) return false;
+    // Таймер сэмплера читает jit_code и карты кода без блокировок
+    if (instance->sampler) return false;
+
+    const EspbModule *module = instance->module;
+    // Код разделяемого модуля может исполняться другими экземплярами - не вытесняем
+    if (module->shared) return false;
+    uint32_t victim = espb_jit_cache_lru(cache);
+    if (victim == UINT32_MAX || victim - module->num_imported_funcs == protect_local_idx) return false;
+
+    EspbFunctionBody *body = &module->function_bodies[victim - module->num_imported_funcs];
+    // Снимаем публикацию в обратном порядке; функция вернётся в интерпретатор и,
+    // если остаётся HOT, будет перекомпилирована при следующем вызове
+    __atomic_store_n(&body->is_jit_compiled, false, __ATOMIC_RELEASE);
+    __atomic_store_n(&body->jit_code, NULL, __ATOMIC_RELEASE);
+    body->jit_code_size = 0;
+    __atomic_store_n(&body->jit_state, ESPB_JIT_STATE_NONE, __ATOMIC_RELEASE);
+#if CONFIG_ESPB_JIT_OSR
+    EspbJitOsrInfo *osr = body->jit_osr;
+    __atomic_store_n(&body->jit_osr, NULL, __ATOMIC_RELEASE);
+    free(osr);
+#endif
+    free(body->jit_pc_map);
+    body->jit_pc_map = NULL;
+    free(body->jit_relocs);
+    body->jit_relocs = NULL;
+#if CONFIG_ESPB_JIT_TIERED
+    body->tier_up_counter = 0;
+#endif
+#if CONFIG_ESPB_JIT_BACKGROUND
+    __atomic_store_n(&body->jit_bg_queued, false, __ATOMIC_RELEASE); // Иначе фоновая задача её больше не получит
+#endif
+    __atomic_sub_fetch(&total_jit_size, cache->entries[victim - cache->first_func_idx].code_size, __ATOMIC_RELAXED);
+    ESP_LOGI(TAG, "Evicted function %u from JIT cache", (unsigned)victim);
+    espb_jit_stats_evicted(instance);
+    espb_jit_cache_remove(cache, victim);
+    return true;
+}
+#endif
+
+#if CONFIG_ESPB_JIT_ENABLED
+void espb_jit_publish(EspbInstance *instance, uint32_t local_func_idx, void *code, size_t code_size,
+                      EspbJitOsrInfo *osr, EspbJitPcMap *pc_map, EspbJitRelocs *relocs) {
+    EspbFunctionBody *body = &instance->module->function_bodies[local_func_idx];
+    __atomic_add_fetch(&total_jit_size, code_size, __ATOMIC_RELAXED);
+    // Публикация: сначала код и размер, затем флаг. Читатель, увидевший jit_code != NULL
+    // или is_jit_compiled, видит полностью записанный код.
+    body->jit_code_size = code_size;
+#if CONFIG_ESPB_JIT_OSR
+    free(body->jit_osr);
+    __atomic_store_n(&body->jit_osr, osr, __ATOMIC_RELEASE);
+#else
+    free(osr);
+#endif
+    free(body->jit_pc_map);
+    __atomic_store_n(&body->jit_pc_map, pc_map, __ATOMIC_RELEASE);
+    free(body->jit_relocs);
+    body->jit_relocs = relocs;
+    __atomic_store_n(&body->jit_code, code, __ATOMIC_RELEASE);
+    __atomic_store_n(&body->is_jit_compiled, true, __ATOMIC_RELEASE);
+
+    if (instance->jit_cache) {
+        espb_jit_cache_insert(instance->jit_cache, local_func_idx + instance->module->num_imported_funcs, code,
+                              code_size);
+    }
+    espb_memory_note_peak(instance);
+    __atomic_store_n(&body->jit_state, ESPB_JIT_STATE_READY, __ATOMIC_RELEASE);
+}
+
+EspbResult espb_jit_compile_and_publish(EspbInstance *instance, uint32_t local_func_idx, size_t *out_size) {
+    const EspbModule *module = instance->module;
+    EspbFunctionBody *body = &module->function_bodies[local_func_idx];
+    uint32_t func_idx = local_func_idx + module->num_imported_funcs;
+    if (out_size) *out_size = 0;
+
+    // Захват компиляции NONE -> COMPILING: функцию компилирует ровно одна задача,
+    // остальные не тратят время и исполняемую память на второй экземпляр кода
+    uint8_t state = ESPB_JIT_STATE_NONE;
+    if (!__atomic_compare_exchange_n(&body->jit_state, &state, ESPB_JIT_STATE_COMPILING, false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+        if (state == ESPB_JIT_STATE_READY) return ESPB_OK;
+        if (state == ESPB_JIT_STATE_FAILED) return ESPB_ERR_UNSUPPORTED;
+        return ESPB_ERR_JIT_BUSY;
+    }
+
+    // JIT компилирует проверенное и оптимизированное тело
+    EspbResult prep_res = espb_ensure_function_ready(module, local_func_idx);
+    if (prep_res != ESPB_OK) {
+        body->jit_reject = ESPB_JIT_REJECT_UNSUPPORTED;
+        __atomic_store_n(&body->jit_state, ESPB_JIT_STATE_FAILED, __ATOMIC_RELEASE);
+        return prep_res;
+    }
+
+    // Разные функции компилируются по очереди: instance_mutex (фоновая задача и синхронные
+    // пути); у разделяемого модуля код и cache общие, поэтому - jit_mutex модуля
+    SemaphoreHandle_t lock = module->jit_mutex ? module->jit_mutex : instance->instance_mutex;
+    bool locked = lock && xSemaphoreTake(lock, portMAX_DELAY) == pdTRUE;
+
+    void *jit_code = NULL;
+    size_t jit_size = 0;
+#if ESPB_JIT_EVICTION
+    // Освобождаем место под новый код заранее, пока бюджет превышен
+    while (instance->jit_cache && instance->jit_cache->used_bytes >= instance->jit_cache->budget_bytes &&
+           espb_jit_evict_lru(instance, local_func_idx)) {
+    }
+#endif
+    EspbJitOsrInfo *osr = NULL;
+#if CONFIG_ESPB_JIT_OSR
+    EspbJitOsrInfo **out_osr = &osr; // Таблица OSR-точек: интерпретатор переходит в код посреди цикла
+#else
+    EspbJitOsrInfo **out_osr = NULL;
+#endif
+    EspbJitPcMap *pc_map = NULL;
+#if ESPB_JIT_PC_MAPS
+    EspbJitPcMap **out_pc_map = &pc_map; // Нативное смещение -> байт-код (сэмплер, карта JIT-кода)
+#else
+    EspbJitPcMap **out_pc_map = NULL;
+#endif
+    EspbJitRelocs *relocs = NULL;
+#if CONFIG_ESPB_JIT_RELOAD
+    EspbJitRelocs **out_relocs = &relocs; // Релокации: код переносится в новую версию модуля
+#else
+    EspbJitRelocs **out_relocs = NULL;
+#endif
+#if CONFIG_ESPB_JIT_STATS
+    int64_t compile_start = esp_timer_get_time();
+#endif
+    // Бюджеты (espb_jit_budget.h): что заведомо не влезает, не компилируем вовсе
+    uint8_t reject = ESPB_JIT_REJECT_NONE;
+    if (CONFIG_ESPB_JIT_MAX_BYTECODE_SIZE > 0 && body->code_size > CONFIG_ESPB_JIT_MAX_BYTECODE_SIZE) {
+        reject = ESPB_JIT_REJECT_BYTECODE_SIZE;
+    } else if (espb_jit_native_limit(instance, NULL) == 0) {
+        reject = ESPB_JIT_REJECT_IRAM_QUOTA;
+    }
+    EspbResult jit_res = reject != ESPB_JIT_REJECT_NONE
+        ? ESPB_ERR_JIT_CODE_TOO_LARGE
+        : espb_jit_compile_function_ex(instance, func_idx, body, &jit_code, &jit_size, out_osr, out_pc_map,
+                                       out_relocs);
+#if ESPB_JIT_EVICTION
+    // Исполняемая куча исчерпана: вытесняем по одной и повторяем
+    while ((jit_res == ESPB_ERR_MEMORY_ALLOC || jit_res == ESPB_ERR_OUT_OF_MEMORY) &&
+           espb_jit_evict_lru(instance, local_func_idx)) {
+        jit_res = espb_jit_compile_function_ex(instance, func_idx, body, &jit_code, &jit_size, out_osr, out_pc_map,
+                                               out_relocs);
+    }
+#endif
+    if (jit_res == ESPB_OK) {
+#if CONFIG_ESPB_JIT_STATS
+        espb_jit_stats_compiled(instance, func_idx, (uint32_t)(esp_timer_get_time() - compile_start));
+#endif
+        if (out_size) *out_size = jit_size;
+        espb_jit_publish(instance, local_func_idx, jit_code, jit_size, osr, pc_map, relocs);
+    } else if (jit_res == ESPB_ERR_MEMORY_ALLOC || jit_res == ESPB_ERR_OUT_OF_MEMORY) {
+        // Нехватка памяти временна (вытеснение, освобождение кучи): следующий вызов повторит
+        __atomic_store_n(&body->jit_state, ESPB_JIT_STATE_NONE, __ATOMIC_RELEASE);
+    } else {
+        if (reject == ESPB_JIT_REJECT_NONE) {
+            bool quota_bound = false;
+            espb_jit_native_limit(instance, &quota_bound);
+            if (jit_res == ESPB_ERR_JIT_CODE_TOO_LARGE) {
+                reject = quota_bound ? ESPB_JIT_REJECT_IRAM_QUOTA : ESPB_JIT_REJECT_NATIVE_SIZE;
+            } else if (jit_res == ESPB_ERR_JIT_TIMEOUT) {
+                reject = ESPB_JIT_REJECT_COMPILE_TIME;
+            } else {
+                reject = ESPB_JIT_REJECT_UNSUPPORTED;
+            }
+        }
+        if (reject != ESPB_JIT_REJECT_UNSUPPORTED) {
+            ESP_LOGW(TAG, "Function %u exceeds the JIT budget (reason %u), staying in interpreter",
+                     (unsigned)func_idx, (unsigned)reject);
+        }
+        body->jit_reject = reject;
+        espb_jit_stats_compile_failed(instance);
+        __atomic_store_n(&body->jit_state, ESPB_JIT_STATE_FAILED, __ATOMIC_RELEASE);
+    }
+    if (locked) xSemaphoreGive(lock);
+    return jit_res;
+}
+#endif
+
+#if CONFIG_ESPB_JIT_TIERED
+__attribute__((noinline, cold))
+bool espb_jit_tier_up(EspbInstance *instance, uint32_t local_func_idx) {
+    EspbFunctionBody *body = &instance->module->function_bodies[local_func_idx];
+    body->tier_up_counter = 0;
+
+    if (body->is_jit_compiled && body->jit_code != NULL) return true;
+    if (body->tier_up_blocked) return false;
+#if CONFIG_ESPB_JIT_BACKGROUND
+    if (espb_jit_bg_request(instance, local_func_idx, true)) return false;
+#endif
+    return espb_jit_tier_up_compile(instance, local_func_idx);
+}
+
+bool espb_jit_tier_up_compile(EspbInstance *instance, uint32_t local_func_idx) {
+    const EspbModule *module = instance->module;
+    EspbFunctionBody *body = &module->function_bodies[local_func_idx];
+    if (body->is_jit_compiled && body->jit_code != NULL) return true;
+    if (instance->jit_tier_up_bytes >= CONFIG_ESPB_JIT_TIER_UP_IRAM_BUDGET) {
+        body->tier_up_blocked = true;
+        return false;
+    }
+
+    uint32_t func_idx = local_func_idx + module->num_imported_funcs;
+    size_t jit_size = 0;
+    EspbResult jit_res = espb_jit_compile_and_publish(instance, local_func_idx, &jit_size);
+    if (jit_res == ESPB_ERR_JIT_BUSY) return false; // Код опубликует компилирующая задача
+    if (jit_res != ESPB_OK) {
+        ESP_LOGW(TAG, "Tier-up of function %u failed (error %d), staying in interpreter", (unsigned)func_idx, jit_res);
+        body->tier_up_blocked = true;
+        return false;
+    }
+    // Код опубликован другим путём (HOT-вызов, предкомпиляция): учитывать и помечать нечего
+    if (jit_size == 0) return true;
+    // Превышение бюджета последней функцией допустимо: код уже выделен, дальнейший tier-up прекращается
+    __atomic_add_fetch(&instance->jit_tier_up_bytes, jit_size, __ATOMIC_RELAXED);
+
+    ESP_LOGD(TAG, "Tier-up function %u, code size: %zu bytes. Total JIT size: %zu bytes", (unsigned)func_idx, jit_size,
+             __atomic_load_n(&total_jit_size, __ATOMIC_RELAXED));
+    // Дальше функция обслуживается всеми существующими HOT-путями (диспетчер, JIT-to-JIT CALL).
+    // header.flags - данные модуля, состояние tier-up хранится в полях времени исполнения
+    body->tier_up_hot = true;
+    __atomic_fetch_add(&instance->jit_hot_function_count, 1, __ATOMIC_RELAXED);
+    return true;
+}
+#endif
+
 EspbResult espb_execute_function_jit_only(EspbInstance *instance, ExecutionContext *exec_ctx, uint32_t func_idx, const Value *args, Value *results) {
 #if CONFIG_ESPB_JIT_ENABLED
     if (!instance || !instance->module) {
@@ -138,33 +494,39 @@ EspbResult espb_execute_function_jit_only(EspbInstance *instance, ExecutionConte
 
     // Если уже скомпилировано — сразу выполняем.
     if (body->is_jit_compiled && body->jit_code != NULL) {
+        espb_jit_note_call(instance, func_idx);
         uint8_t num_args = espb_get_declared_num_args_for_local(instance, local_func_idx);
-        return execute_jit_code(instance, body->jit_code, args, num_args, results, body->header.num_virtual_regs);
+        return execute_jit_code(instance, body->jit_code, args, num_args, results, body->header.num_virtual_regs,
+                                ESPB_FRAME_ZERO_INIT_REGS(body));
     }
 
     // Пытаемся скомпилировать. Если не вышло — возвращаем ошибку (без interpreter fallback).
-    void *jit_code = NULL;
     size_t jit_size = 0;
-    EspbResult jit_res = espb_jit_compile_function(instance, func_idx, body, &jit_code, &jit_size);
+    EspbResult jit_res = espb_jit_compile_and_publish(instance, local_func_idx, &jit_size);
+    while (jit_res == ESPB_ERR_JIT_BUSY) {
+        // Интерпретатор здесь недопустим: ждём публикации кода компилирующей задачей
+        vTaskDelay(1);
+        jit_res = espb_jit_compile_and_publish(instance, local_func_idx, &jit_size);
+    }
     if (jit_res != ESPB_OK) {
         return jit_res;
     }
 
-    total_jit_size += jit_size;
-    printf("[JIT] Compiled function %u, code size: %zu bytes. Total JIT size: %zu bytes\n", (unsigned)func_idx, jit_size, total_jit_size);
-    body->jit_code = jit_code;
-    body->jit_code_size = jit_size;
-    body->is_jit_compiled = true;
+    if (jit_size) {
+        printf("[JIT] Compiled function %u, code size: %zu bytes. Total JIT size: %zu bytes\n", (unsigned)func_idx, jit_size,
+               __atomic_load_n(&total_jit_size, __ATOMIC_RELAXED));
+    }
 
     uint8_t num_args = espb_get_declared_num_args_for_local(instance, local_func_idx);
-    return execute_jit_code(instance, body->jit_code, args, num_args, results, body->header.num_virtual_regs);
+    return execute_jit_code(instance, __atomic_load_n(&body->jit_code, __ATOMIC_ACQUIRE), args, num_args, results,
+                            body->header.num_virtual_regs, ESPB_FRAME_ZERO_INIT_REGS(body));
 #else
     return ESPB_ERR_UNSUPPORTED; // JIT is disabled
 #endif
 }
 
 #if CONFIG_ESPB_JIT_ENABLED
-EspbResult execute_jit_code(EspbInstance *instance, void *jit_code, const Value *args, uint8_t num_args, Value *results, uint16_t num_virtual_regs) {
+EspbResult execute_jit_code(EspbInstance *instance, void *jit_code, const Value *args, uint8_t num_args, Value *results, uint16_t num_virtual_regs, uint16_t zero_init_regs) {
     if (!jit_code) {
         printf("JIT: Error - jit_code is NULL\n");
         return ESPB_ERR_INVALID_OPERAND;
@@ -197,16 +559,22 @@ EspbResult execute_jit_code(EspbInstance *instance, void *jit_code, const Value
 
     // Выделяем v_regs динамически на стеке (VLA - Variable Length Array)
     Value v_regs[actual_regs] __attribute__((aligned(8)));
-    memset(v_regs, 0, actual_regs * sizeof(Value));
     
     // Копируем аргументы в регистры R0-R7 (или сколько есть)
+    uint8_t n = 0;
     if (args) {
-        uint8_t n = num_args;
+        n = num_args;
         if (n > actual_regs) n = actual_regs;
         for (uint8_t i = 0; i < n; i++) {
             v_regs[i] = args[i];
         }
     }
+    // Обнуляем только регистры, которые могут читаться до записи (R0-R7 - всегда)
+    uint16_t zero_regs = zero_init_regs < 8 ? 8 : zero_init_regs;
+    if (zero_regs > actual_regs) zero_regs = actual_regs;
+    if (zero_regs > n) {
+        memset(&v_regs[n], 0, (size_t)(zero_regs - n) * sizeof(Value));
+    }
     
     // ОПТИМИЗАЦИЯ #2: Убраны избыточные проверки (только в debug режиме)
     #if LOG_LOCAL_LEVEL >= ESP_LOG_DEBUG
@@ -220,10 +588,19 @@ EspbResult execute_jit_code(EspbInstance *instance, void *jit_code, const Value
     // (уже выполняется в espb_jit_compile_function)
     
     // Вызываем JIT-скомпилированный код
-    ESP_LOGD("espb_jit", "Calling JIT function at %p with instance=%p, v_regs=%p", jit_func, instance, v_regs);
+    ESP_LOGD(TAG, "Calling JIT function at %p with instance=%p, v_regs=%p", jit_func, instance, v_regs);
     
+    // ALLOCA из JIT-кода (и из его прямых вызовов) живут до возврата на эту границу
+    uint32_t alloca_mark = espb_jit_alloca_mark();
+#if ESPB_JIT_EVICTION
+    __atomic_fetch_add(&instance->jit_active_calls, 1, __ATOMIC_ACQ_REL);
     jit_func(instance, v_regs);
-    ESP_LOGD("espb_jit", "JIT function returned");
+    __atomic_fetch_sub(&instance->jit_active_calls, 1, __ATOMIC_ACQ_REL);
+#else
+    jit_func(instance, v_regs);
+#endif
+    espb_jit_alloca_restore(alloca_mark);
+    ESP_LOGD(TAG, "JIT function returned");
     
     // Копируем результаты из регистров обратно (R0 содержит возвращаемое значение)
     if (results) {
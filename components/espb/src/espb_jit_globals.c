@@ -16,6 +16,7 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 #include "espb_jit_globals.h"
+#include "espb_rodata.h"
 
 #include <string.h>
 #include <stdint.h>
@@ -26,9 +27,9 @@
 
 static inline uint8_t espb_value_size(EspbValueType t) {
     switch (t) {
-        case ESPB_TYPE_I8:  case ESPB_TYPE_U8:  return 1;
+        case ESPB_TYPE_I8:  case ESPB_TYPE_U8:  case ESPB_TYPE_BOOL: return 1; // BOOL занимает байт, как в интерпретаторе
         case ESPB_TYPE_I16: case ESPB_TYPE_U16: return 2;
-        case ESPB_TYPE_I32: case ESPB_TYPE_U32: case ESPB_TYPE_F32: case ESPB_TYPE_BOOL: case ESPB_TYPE_PTR: return 4;
+        case ESPB_TYPE_I32: case ESPB_TYPE_U32: case ESPB_TYPE_F32: case ESPB_TYPE_PTR: return 4;
         case ESPB_TYPE_I64: case ESPB_TYPE_U64: case ESPB_TYPE_F64: return 8;
         default: return 8;
     }
@@ -66,7 +67,7 @@ void espb_jit_ld_global_addr(EspbInstance* instance, uint16_t symbol_idx, Value*
         const EspbGlobalDesc* g = &module->globals[symbol_idx];
         if (g->init_kind == ESPB_INIT_KIND_DATA_OFFSET) {
             if (!instance->memory_data) return;
-            addr = (uintptr_t)(instance->memory_data + g->initializer.data_section_offset);
+            addr = (uintptr_t)(espb_data_address(instance, g->initializer.data_section_offset));
         } else if (g->init_kind == ESPB_INIT_KIND_CONST || g->init_kind == ESPB_INIT_KIND_ZERO) {
             if (!instance->globals_data || !instance->global_offsets) return;
             addr = (uintptr_t)(instance->globals_data + instance->global_offsets[symbol_idx]);
@@ -101,7 +102,7 @@ void espb_jit_ld_global(EspbInstance* instance, uint16_t global_idx, Value* v_re
     uint8_t* base = NULL;
     if (g->init_kind == ESPB_INIT_KIND_DATA_OFFSET) {
         if (!instance->memory_data) return;
-        base = instance->memory_data + g->initializer.data_section_offset;
+        base = espb_data_address(instance, g->initializer.data_section_offset);
         if (g->type == ESPB_TYPE_PTR) {
             // Return address itself
             uintptr_t addr = (uintptr_t)base;
@@ -133,7 +134,7 @@ void espb_jit_st_global(EspbInstance* instance, uint16_t global_idx, const Value
     uint8_t* target_addr = NULL;
     if (g->init_kind == ESPB_INIT_KIND_DATA_OFFSET) {
         if (!instance->memory_data) return;
-        target_addr = instance->memory_data + g->initializer.data_section_offset;
+        target_addr = espb_data_address(instance, g->initializer.data_section_offset);
     } else {
         if (!instance->globals_data || !instance->global_offsets) return;
         target_addr = instance->globals_data + instance->global_offsets[global_idx];
@@ -20,16 +20,17 @@
 #include "espb_runtime_alloca.h"
 
 // JIT helper for ALLOCA opcode (0x8F).
-// Shared implementation lives in espb_runtime_alloca.c.
-void espb_jit_alloca_ex(EspbInstance *instance, Value *v_regs, uint16_t num_regs_allocated,
-                        uint8_t rd, uint8_t rs_size, uint8_t align)
+// Shared implementation lives in espb_runtime_alloca.c; without an ExecutionContext
+// the allocation goes to the task's JIT ALLOCA stack.
+EspbResult espb_jit_alloca_ex(EspbInstance *instance, Value *v_regs, uint16_t num_regs_allocated,
+                              uint8_t rd, uint8_t rs_size, uint8_t align)
 {
-    if (!instance || !v_regs) return;
-    (void)espb_runtime_alloca(instance, NULL, v_regs, num_regs_allocated, rd, rs_size, align);
+    if (!instance || !v_regs) return ESPB_ERR_INVALID_OPERAND;
+    return espb_runtime_alloca(instance, NULL, v_regs, num_regs_allocated, rd, rs_size, align);
 }
 
-void espb_jit_alloca(EspbInstance *instance, Value *v_regs, uint8_t rd, uint8_t rs_size, uint8_t align) {
+EspbResult espb_jit_alloca(EspbInstance *instance, Value *v_regs, uint8_t rd, uint8_t rs_size, uint8_t align) {
     // Backward-compatible wrapper
-    espb_jit_alloca_ex(instance, v_regs, 256, rd, rs_size, align);
+    return espb_jit_alloca_ex(instance, v_regs, 256, rd, rs_size, align);
 }
 
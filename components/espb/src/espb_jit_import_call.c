@@ -20,6 +20,8 @@
 #include "ffi.h"
 
 #include "espb_callback_system.h" // FEATURE_CALLBACK_AUTO, espb_auto_create_callbacks_for_import
+#include "espb_import_profile.h"
+#include "espb_marshal_plan.h"
 #include "espb_runtime_ffi_call.h"
 #include "espb_runtime_ffi_types.h"
 #include "espb_runtime_ffi_pack.h"
@@ -68,6 +70,7 @@ void espb_jit_call_import(EspbInstance *instance,
     }
 #endif
     (void)num_virtual_regs;
+    uint32_t prof_t_begin = ESPB_IMPORT_PROFILE_NOW();
 
     if (!instance || !instance->module || !v_regs) return;
 
@@ -161,17 +164,74 @@ void espb_jit_call_import(EspbInstance *instance,
         espb_auto_create_callbacks_for_import(instance, import_idx, arg_values, num_args);
     }
 
-    (void)espb_runtime_ffi_call(fptr,
-                               has_variadic_info != 0,
-                               (uint32_t)nfixedargs,
-                               (uint32_t)num_args,
-                               ret_type,
-                               arg_types,
-                               arg_values,
-                               ret_es,
-                               v_regs);
+    // Стандартный маршалинг immeta по плану импорта (как в интерпретаторе). Импорты с
+    // async OUT-параметрами JIT по-прежнему вызывает без маршалинга.
+    const EspbMarshalPlan *marshal_plan = espb_marshal_plan(instance, import_idx);
+    if (marshal_plan && marshal_plan->has_async_out) marshal_plan = NULL;
+    EspbMarshalFrame marshal_frame;
+    if (marshal_plan && espb_marshal_begin(marshal_plan, v_regs, num_args, arg_values, &marshal_frame) != ESPB_OK) {
+        return;
+    }
+
+    ffi_cif *prepared_cif = (has_variadic_info == 0)
+        ? espb_runtime_import_cif(instance, import_idx)
+        : espb_runtime_var_cif(instance, import_idx, nfixedargs, num_args, ret_type, arg_types);
+    // Нативное время включает преобразование результата в espb_runtime_ffi_call*
+    uint32_t prof_t_call = ESPB_IMPORT_PROFILE_NOW();
+    if (prepared_cif) {
+        (void)espb_runtime_ffi_call_with_cif(prepared_cif, fptr, arg_values, ret_es, v_regs);
+    } else {
+        (void)espb_runtime_ffi_call(fptr,
+                                   has_variadic_info != 0,
+                                   (uint32_t)nfixedargs,
+                                   (uint32_t)num_args,
+                                   ret_type,
+                                   arg_types,
+                                   arg_values,
+                                   ret_es,
+                                   v_regs);
+    }
+
+    uint32_t prof_t_ret = ESPB_IMPORT_PROFILE_NOW();
+
+    if (marshal_plan) espb_marshal_end(marshal_plan, &marshal_frame);
+    espb_import_profile_record(instance, import_idx, prof_t_begin, prof_t_call, prof_t_ret, ESPB_IMPORT_PROFILE_NOW());
+    (void)prof_t_begin; (void)prof_t_call; (void)prof_t_ret;
 
 #if ESPB_JIT_DEBUG
     printf("[jit] CALL_IMPORT: ffi_call returned\n");
 #endif
 }
+
+bool espb_jit_import_can_call_direct(const EspbInstance *instance,
+                                     uint16_t import_idx,
+                                     const EspbFuncSignature **out_sig,
+                                     void **out_fptr)
+{
+    if (!instance || !instance->module || !instance->resolved_import_funcs) return false;
+    const EspbModule *module = instance->module;
+    if (import_idx >= module->num_imports) return false;
+    if (module->imports[import_idx].kind != ESPB_IMPORT_KIND_FUNC) return false;
+
+    void *fptr = instance->resolved_import_funcs[import_idx];
+    if (!fptr) return false;
+
+    uint16_t sig_idx = module->imports[import_idx].desc.func.type_idx;
+    if (sig_idx >= module->num_signatures) return false;
+
+    // Колбэки создаются в espb_auto_create_callbacks_for_import — только через helper
+    EspbCbmetaImportEntry *cb_entry = NULL;
+    if ((module->header.features & FEATURE_CALLBACK_AUTO) != 0 &&
+        espb_find_callback_metadata(module, import_idx, &cb_entry)) {
+        return false;
+    }
+
+    if (espb_marshal_plan(instance, import_idx)) return false;
+
+    // Прямой вызов из JIT-кода не проходит через счётчики профиля импортов
+    if (instance->import_profile) return false;
+
+    if (out_sig) *out_sig = &module->signatures[sig_idx];
+    if (out_fptr) *out_fptr = fptr;
+    return true;
+}
@@ -19,21 +19,46 @@
 
 #include "espb_api.h"
 #include "espb_interpreter_runtime_oc.h" // init_execution_context, espb_call_function
+#include "espb_interpreter_parser.h" // espb_find_func_ptr
 #include "ffi.h"
 #include "espb_runtime_ffi_call.h"
 #include "espb_runtime_ffi_types.h"
 #include "espb_runtime_ffi_pack.h"
+#include "espb_call_ic.h"
 
 #include <string.h>
 #include <stdlib.h>
 
-// comparator for bsearch
-static int compare_func_ptr_map_entry_for_search(const void *key, const void *element) {
-    uint32_t k = *(const uint32_t*)key;
-    const EspbFuncPtrMapEntry* e = (const EspbFuncPtrMapEntry*)element;
-    if (k < e->data_offset) return -1;
-    if (k > e->data_offset) return 1;
-    return 0;
+// Calls local ESPB function local_idx with arguments from R0, R1, ... skipping skip_reg
+// (the callee pointer register of CALL_INDIRECT_PTR; UINT32_MAX - nothing to skip).
+static void call_local_function(EspbInstance* instance, uint32_t local_idx, Value* v_regs,
+                                uint16_t num_virtual_regs, uint32_t skip_reg) {
+    EspbModule* module = (EspbModule*)instance->module;
+    EspbFuncSignature* sig = &module->signatures[module->function_signature_indices[local_idx]];
+    uint8_t num_args = sig->num_params;
+    if (num_args > 8) num_args = 8;
+
+    Value args[8];
+    memset(args, 0, sizeof(args));
+    for (uint8_t i = 0; i < num_args; ++i) {
+        uint32_t src_reg = i;
+        if (skip_reg <= src_reg) {
+            src_reg++;
+        }
+        if (src_reg < num_virtual_regs) args[i] = v_regs[src_reg];
+    }
+
+    ExecutionContext* exec_ctx = init_execution_context();
+    if (!exec_ctx) return;
+
+    uint32_t global_idx = local_idx + module->num_imported_funcs;
+    Value result;
+    memset(&result, 0, sizeof(result));
+    espb_call_function(instance, exec_ctx, global_idx, args, &result);
+    if (sig->num_returns > 0) {
+        v_regs[0] = result;
+    }
+    free_execution_context(exec_ctx);
 }
 
 void espb_jit_call_indirect_ptr(EspbInstance* instance,
@@ -46,6 +71,16 @@ void espb_jit_call_indirect_ptr(EspbInstance* instance,
 
     EspbModule* module = (EspbModule*)instance->module;
 
+    // Inline cache keyed by the JIT call site: a hit is a target that already passed
+    // the func_ptr_map lookup and the signature check below.
+    uintptr_t ic_site = (uintptr_t)__builtin_return_address(0);
+    uintptr_t ic_target = (uintptr_t)target_ptr;
+    uint32_t local_idx;
+    if (espb_call_ic_lookup(instance, ic_site, ic_target, type_idx, &local_idx)) {
+        call_local_function(instance, local_idx, v_regs, num_virtual_regs, func_ptr_reg);
+        return;
+    }
+
     // Determine if pointer is inside ESPB memory or is a tagged DATA_OFFSET pointer
     uintptr_t mem_base = (uintptr_t)instance->memory_data;
     uintptr_t mem_end  = mem_base + instance->memory_size_bytes;
@@ -68,16 +103,8 @@ void espb_jit_call_indirect_ptr(EspbInstance* instance,
         }
     }
 
-    if (is_in_data_segment && module->func_ptr_map && module->num_func_ptr_map_entries > 0) {
-        EspbFuncPtrMapEntry* found = (EspbFuncPtrMapEntry*)bsearch(
-            &data_offset,
-            module->func_ptr_map,
-            module->num_func_ptr_map_entries,
-            sizeof(EspbFuncPtrMapEntry),
-            compare_func_ptr_map_entry_for_search);
-
-        if (found) {
-            uint32_t local_idx = found->function_index;
+    if (is_in_data_segment && module->func_ptr_hash_slots) {
+        if (espb_find_func_ptr(module, data_offset, &local_idx)) {
             if (local_idx >= module->num_functions) return;
 
             uint16_t actual_sig_idx = module->function_signature_indices[local_idx];
@@ -89,34 +116,8 @@ void espb_jit_call_indirect_ptr(EspbInstance* instance,
                 return;
             }
 
-            // Call ESPB function by index
-            EspbFuncSignature* sig = &module->signatures[actual_sig_idx];
-            uint8_t num_args = sig->num_params;
-            if (num_args > 8) num_args = 8;
-
-            Value args[8];
-            memset(args, 0, sizeof(args));
-            for (uint8_t i = 0; i < num_args; ++i) {
-                // Arguments are in R0, R1, R2, ...
-                // Skip func_ptr_reg if it occupies an argument slot
-                uint16_t src_reg = i;
-                if (func_ptr_reg <= src_reg) {
-                    src_reg++;
-                }
-                if (src_reg < num_virtual_regs) args[i] = v_regs[src_reg];
-            }
-
-            ExecutionContext* exec_ctx = init_execution_context();
-            if (!exec_ctx) return;
-
-            uint32_t global_idx = local_idx + module->num_imported_funcs;
-            Value result;
-            memset(&result, 0, sizeof(result));
-            espb_call_function(instance, exec_ctx, global_idx, args, &result);
-            if (sig->num_returns > 0) {
-                v_regs[0] = result;
-            }
-            free_execution_context(exec_ctx);
+            espb_call_ic_update(instance, ic_site, ic_target, type_idx, local_idx);
+            call_local_function(instance, local_idx, v_regs, num_virtual_regs, func_ptr_reg);
             return;
         }
 
@@ -233,7 +234,15 @@ void espb_jit_call_indirect(EspbInstance* instance,
     EspbModule* module = (EspbModule*)instance->module;
     uint32_t local_func_idx = func_idx_or_ptr;
     
-    // Если значение >= num_functions, это может быть указатель/offset в data segment
+    // Если значение >= num_functions, это может быть указатель/offset в data segment.
+    // Разрешённые и проверенные цели кэшируются по месту вызова в JIT-коде.
+    uintptr_t ic_site = (uintptr_t)__builtin_return_address(0);
+    if (local_func_idx >= module->num_functions &&
+        espb_call_ic_lookup(instance, ic_site, func_idx_or_ptr, type_idx, &local_func_idx)) {
+        call_local_function(instance, local_func_idx, v_regs, num_virtual_regs, UINT32_MAX);
+        return;
+    }
+    bool resolved_from_ptr = false;
     if (local_func_idx >= module->num_functions) {
         uintptr_t mem_base = (uintptr_t)instance->memory_data;
         uintptr_t mem_end = mem_base + instance->memory_size_bytes;
@@ -251,16 +260,9 @@ void espb_jit_call_indirect(EspbInstance* instance,
             found_offset = true;
         }
         
-        if (found_offset && module->func_ptr_map && module->num_func_ptr_map_entries > 0) {
-            EspbFuncPtrMapEntry *found_entry = (EspbFuncPtrMapEntry *)bsearch(
-                &data_offset,
-                module->func_ptr_map,
-                module->num_func_ptr_map_entries,
-                sizeof(EspbFuncPtrMapEntry),
-                compare_func_ptr_map_entry_for_search
-            );
-            if (found_entry) {
-                local_func_idx = found_entry->function_index;
+        if (found_offset && module->func_ptr_hash_slots) {
+            if (espb_find_func_ptr(module, data_offset, &local_func_idx)) {
+                resolved_from_ptr = true;
             } else {
                 // Не найдено в func_ptr_map - невалидный вызов
                 return;
@@ -283,34 +285,10 @@ void espb_jit_call_indirect(EspbInstance* instance,
         return;
     }
     
-    // Получаем сигнатуру и вызываем функцию
-    EspbFuncSignature* sig = &module->signatures[actual_sig_idx];
-    uint8_t num_args = sig->num_params;
-    if (num_args > 8) num_args = 8;
-    
-    // Копируем аргументы из v_regs (R0, R1, R2, ...)
-    // Аргументы уже находятся в правильных регистрах для CALL_INDIRECT
-    Value args[8];
-    memset(args, 0, sizeof(args));
-    for (uint8_t i = 0; i < num_args; ++i) {
-        if (i < num_virtual_regs) {
-            args[i] = v_regs[i];
-        }
-    }
-    
-    // Создаем контекст выполнения и вызываем функцию
-    ExecutionContext* exec_ctx = init_execution_context();
-    if (!exec_ctx) return;
-    
-    uint32_t global_func_idx = local_func_idx + module->num_imported_funcs;
-    Value result;
-    memset(&result, 0, sizeof(result));
-    espb_call_function(instance, exec_ctx, global_func_idx, args, &result);
-    
-    // Сохраняем результат в v_regs[0]
-    if (sig->num_returns > 0) {
-        v_regs[0] = result;
+    if (resolved_from_ptr) {
+        espb_call_ic_update(instance, ic_site, func_idx_or_ptr, type_idx, local_func_idx);
     }
-    
-    free_execution_context(exec_ctx);
+
+    // Аргументы уже находятся в правильных регистрах для CALL_INDIRECT (R0, R1, R2, ...)
+    call_local_function(instance, local_func_idx, v_regs, num_virtual_regs, UINT32_MAX);
 }
@@ -0,0 +1,165 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "espb_jit_osr.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if CONFIG_ESPB_JIT_ENABLED && (CONFIG_ESPB_JIT_OSR || CONFIG_ESPB_FUEL)
+
+#include "espb_interpreter_threaded.h"
+#include "espb_jit.h"
+#include "espb_runtime_alloca.h" // espb_jit_alloca_mark
+
+static int osr_cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static bool osr_add_header(uint32_t **headers, size_t *count, size_t *capacity, int64_t target, uint32_t off,
+                           size_t code_size) {
+    // Обратный переход (в том числе на себя) - заголовок цикла
+    if (target < 0 || target > (int64_t)off || (size_t)target >= code_size) return true;
+    if (*count == *capacity) {
+        size_t new_cap = *capacity ? *capacity * 2 : 8;
+        uint32_t *grown = (uint32_t *)realloc(*headers, new_cap * sizeof(uint32_t));
+        if (!grown) return false;
+        *headers = grown;
+        *capacity = new_cap;
+    }
+    (*headers)[(*count)++] = (uint32_t)target;
+    return true;
+}
+
+uint32_t *espb_jit_osr_scan_headers(const uint8_t *code, size_t code_size, size_t *out_count) {
+    uint32_t *headers = NULL;
+    size_t count = 0, capacity = 0;
+    const uint8_t *end = code + code_size;
+    *out_count = 0;
+
+    for (size_t off = 0; off < code_size; ) {
+        const uint8_t *insn = code + off;
+        // Длина 0x16 считается так же, как в кодогенераторе JIT
+        size_t len = (insn[0] == 0x16) ? 4 : espb_instruction_length(insn, end);
+        if (len == 0 || off + len > code_size) {
+            free(headers);
+            return NULL;
+        }
+        int16_t rel;
+        bool ok = true;
+        if (insn[0] == 0x02) {        // BR offset(i16) от начала инструкции
+            memcpy(&rel, insn + 1, sizeof(rel));
+            ok = osr_add_header(&headers, &count, &capacity, (int64_t)off + rel, (uint32_t)off, code_size);
+        } else if (insn[0] == 0x03) { // BR_IF reg, offset(i16) от начала инструкции
+            memcpy(&rel, insn + 2, sizeof(rel));
+            ok = osr_add_header(&headers, &count, &capacity, (int64_t)off + rel, (uint32_t)off, code_size);
+        } else if (insn[0] == 0x04) { // BR_TABLE: смещения от конца инструкции
+            uint16_t num_targets;
+            memcpy(&num_targets, insn + 2, sizeof(num_targets));
+            for (uint32_t i = 0; ok && i <= num_targets; ++i) {
+                memcpy(&rel, insn + 4 + i * 2, sizeof(rel));
+                ok = osr_add_header(&headers, &count, &capacity, (int64_t)(off + len) + rel, (uint32_t)off, code_size);
+            }
+        }
+        if (!ok) {
+            free(headers);
+            return NULL;
+        }
+        off += len;
+    }
+    if (count == 0) {
+        free(headers);
+        return NULL;
+    }
+
+    qsort(headers, count, sizeof(uint32_t), osr_cmp_u32);
+    size_t unique = 1;
+    for (size_t i = 1; i < count; ++i) {
+        if (headers[i] != headers[unique - 1]) headers[unique++] = headers[i];
+    }
+    *out_count = unique;
+    return headers;
+}
+
+#endif // CONFIG_ESPB_JIT_ENABLED && (CONFIG_ESPB_JIT_OSR || CONFIG_ESPB_FUEL)
+
+#if CONFIG_ESPB_JIT_ENABLED && CONFIG_ESPB_JIT_OSR
+
+EspbJitOsrInfo *espb_jit_osr_info_create(uint32_t stub_offset, const EspbJitOsrPoint *points, size_t num_points) {
+    if (num_points == 0 || num_points > UINT32_MAX) return NULL;
+    EspbJitOsrInfo *osr = (EspbJitOsrInfo *)malloc(sizeof(EspbJitOsrInfo) + num_points * sizeof(EspbJitOsrPoint));
+    if (!osr) return NULL;
+    osr->stub_offset = stub_offset;
+    osr->num_points = (uint32_t)num_points;
+    memcpy(osr->points, points, num_points * sizeof(EspbJitOsrPoint));
+    return osr;
+}
+
+static const EspbJitOsrPoint *osr_find_point(const EspbJitOsrInfo *osr, uint32_t bc_offset) {
+    uint32_t lo = 0, hi = osr->num_points;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (osr->points[mid].bc_offset < bc_offset) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return (lo < osr->num_points && osr->points[lo].bc_offset == bc_offset) ? &osr->points[lo] : NULL;
+}
+
+__attribute__((noinline, cold))
+bool espb_jit_osr_enter(EspbInstance *instance, const EspbFunctionBody *body, uint32_t bc_offset,
+                        Value *locals, uint16_t num_virtual_regs) {
+    uint8_t *code = (uint8_t *)__atomic_load_n(&body->jit_code, __ATOMIC_ACQUIRE);
+    const EspbJitOsrInfo *osr = __atomic_load_n(&body->jit_osr, __ATOMIC_ACQUIRE);
+    if (!code || !osr) return false;
+    const EspbJitOsrPoint *point = osr_find_point(osr, bc_offset);
+    if (!point) return false;
+
+    typedef void (*JitOsrStub)(EspbInstance *instance, Value *v_regs, void *target);
+    JitOsrStub stub = (JitOsrStub)(void *)(code + osr->stub_offset);
+
+    // Кадр такой же, как в execute_jit_code: живые регистры берутся из интерпретатора целиком
+    uint16_t actual_regs = body->header.num_virtual_regs > 256 ? 256 : body->header.num_virtual_regs;
+    if (actual_regs < 8) actual_regs = 8;
+    Value v_regs[actual_regs] __attribute__((aligned(8)));
+    uint16_t n = num_virtual_regs < actual_regs ? num_virtual_regs : actual_regs;
+    memcpy(v_regs, locals, (size_t)n * sizeof(Value));
+    if (n < actual_regs) {
+        memset(&v_regs[n], 0, (size_t)(actual_regs - n) * sizeof(Value));
+    }
+
+    const EspbModule *module = instance->module;
+    espb_jit_note_call(instance, (uint32_t)(body - module->function_bodies) + module->num_imported_funcs);
+    uint32_t alloca_mark = espb_jit_alloca_mark();
+#if ESPB_JIT_EVICTION
+    __atomic_fetch_add(&instance->jit_active_calls, 1, __ATOMIC_ACQ_REL);
+    stub(instance, v_regs, code + point->native_offset);
+    __atomic_fetch_sub(&instance->jit_active_calls, 1, __ATOMIC_ACQ_REL);
+#else
+    stub(instance, v_regs, code + point->native_offset);
+#endif
+    espb_jit_alloca_restore(alloca_mark);
+
+    locals[0] = v_regs[0];
+    return true;
+}
+
+#endif // CONFIG_ESPB_JIT_ENABLED && CONFIG_ESPB_JIT_OSR
@@ -18,6 +18,8 @@
 #include "espb_jit_precompile.h"
 #include "espb_jit.h"
 #include "espb_interpreter.h"
+#include "espb_jit_dispatcher.h"
+#include "espb_interpreter_runtime_oc.h" // espb_ensure_function_ready
 #include "esp_log.h"
 #include <string.h>
 
@@ -84,23 +86,46 @@ EspbResult espb_jit_precompile_hot_functions(EspbInstance* instance, espb_jit_pr
             continue;
         }
         
+#if ESPB_JIT_EVICTION
+        // Бюджет IRAM исчерпан: остальные HOT функции компилируются при первом вызове
+        // (с вытеснением), а не вытесняют друг друга здесь
+        if (instance->jit_cache && instance->jit_cache->used_bytes >= instance->jit_cache->budget_bytes) {
+            JIT_LOGW(TAG, "JIT IRAM budget exhausted, deferring remaining HOT functions");
+            break;
+        }
+#endif
+
         // Компилируем
         void* jit_code = NULL;
         size_t jit_size = 0;
         uint32_t global_func_idx = i + module->num_imported_funcs;
         
-        EspbResult res = espb_jit_compile_function(instance, global_func_idx, body, &jit_code, &jit_size);
-        
+        EspbResult res;
+#if CONFIG_ESPB_JIT_ENABLED
+        // Публикация через jit_state: ту же функцию может компилировать диспетчер, фоновая
+        // задача или другой экземпляр разделяемого модуля
+        (void)jit_code;
+        (void)global_func_idx;
+        res = espb_jit_compile_and_publish(instance, i, &jit_size);
+#else
+        res = espb_ensure_function_ready(module, i);
+        if (res == ESPB_OK) {
+            res = espb_jit_compile_function(instance, global_func_idx, body, &jit_code, &jit_size);
+        }
         if (res == ESPB_OK) {
             body->jit_code = jit_code;
             body->jit_code_size = jit_size;
             body->is_jit_compiled = true;
-            compiled_count++;
-            
+
             // Добавляем в cache
             if (instance->jit_cache) {
                 espb_jit_cache_insert(instance->jit_cache, global_func_idx, jit_code, jit_size);
             }
+        }
+#endif
+        
+        if (res == ESPB_OK) {
+            compiled_count++;
             
             ESP_LOGI(TAG, "[%u/%u] Precompiled HOT function #%u (%zu bytes)", 
                     current, hot_count, i, jit_size);
@@ -144,12 +169,21 @@ EspbResult espb_jit_precompile_function(EspbInstance* instance, uint32_t func_id
         JIT_LOGD(TAG, "Function #%u already compiled", func_idx);
         return ESPB_OK;
     }
-    
+#if CONFIG_ESPB_JIT_ENABLED
+    EspbResult pub_res = espb_jit_compile_and_publish(instance, local_func_idx, NULL);
+    if (pub_res != ESPB_OK && pub_res != ESPB_ERR_JIT_BUSY) {
+        ESP_LOGE(TAG, "Failed to precompile function #%u (error %d)", func_idx, pub_res);
+    }
+    return pub_res;
+#else
+    EspbResult res = espb_ensure_function_ready(module, local_func_idx);
+    if (res != ESPB_OK) return res;
+
     // Компилируем
     void* jit_code = NULL;
     size_t jit_size = 0;
     
-    EspbResult res = espb_jit_compile_function(instance, func_idx, body, &jit_code, &jit_size);
+    res = espb_jit_compile_function(instance, func_idx, body, &jit_code, &jit_size);
     
     if (res == ESPB_OK) {
         body->jit_code = jit_code;
@@ -167,6 +201,21 @@ EspbResult espb_jit_precompile_function(EspbInstance* instance, uint32_t func_id
     }
     
     return res;
+#endif
+}
+
+EspbResult espb_jit_precompile_prepare(EspbInstance* instance, uint32_t func_idx) {
+    if (!instance || !instance->module) {
+        ESP_LOGE(TAG, "Invalid instance");
+        return ESPB_ERR_INVALID_OPERAND;
+    }
+
+    const EspbModule* module = instance->module;
+    if (func_idx < module->num_imported_funcs || func_idx >= module->num_imported_funcs + module->num_functions) {
+        ESP_LOGE(TAG, "Invalid function index %u", func_idx);
+        return ESPB_ERR_INVALID_FUNC_INDEX;
+    }
+    return espb_ensure_function_ready(module, func_idx - module->num_imported_funcs);
 }
 
 EspbResult espb_jit_precompile_by_name(EspbInstance* instance, const char* func_name) {
@@ -0,0 +1,290 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "espb_jit_reload.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if CONFIG_ESPB_JIT_ENABLED && CONFIG_ESPB_JIT_RELOAD
+
+#include "espb_jit.h"
+#include "espb_jit_budget.h"
+#include "espb_jit_code_map.h"
+#include "espb_jit_dispatcher.h"
+#include "espb_jit_import_call.h"
+#include "espb_jit_osr.h"
+#include "espb_jit_snapshot.h"
+#include "espb_interpreter_runtime_oc.h"
+#include "espb_interpreter_threaded.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "espb_jit_reload";
+
+#define RELOAD_HASH_INIT 0xcbf29ce484222325ull // FNV-1a 64
+
+static uint64_t reload_mix(uint64_t h, const void *data, size_t len) {
+    const uint8_t *p = (const uint8_t *)data;
+    for (size_t i = 0; i < len; i++) {
+        h = (h ^ p[i]) * 0x100000001b3ull;
+    }
+    return h;
+}
+
+static inline uint64_t reload_mix_u32(uint64_t h, uint32_t v) {
+    return reload_mix(h, &v, sizeof(v));
+}
+
+static uint64_t reload_mix_sig(uint64_t h, const EspbModule *module, uint32_t sig_idx) {
+    if (sig_idx >= module->num_signatures) return reload_mix_u32(h, UINT32_MAX);
+    const EspbFuncSignature *sig = &module->signatures[sig_idx];
+    h = reload_mix_u32(h, sig->num_params);
+    h = reload_mix(h, sig->param_types, sig->num_params * sizeof(EspbValueType));
+    h = reload_mix_u32(h, sig->num_returns);
+    return reload_mix(h, sig->return_types, sig->num_returns * sizeof(EspbValueType));
+}
+
+// Имя и тип импорта определяют адрес функции и способ вызова (прямой или через helper)
+static uint64_t reload_mix_import(uint64_t h, const EspbInstance *instance, uint16_t import_idx) {
+    const EspbModule *module = instance->module;
+    if (import_idx >= module->num_imports || module->imports[import_idx].kind != ESPB_IMPORT_KIND_FUNC) {
+        return reload_mix_u32(h, UINT32_MAX);
+    }
+    const EspbImportDesc *imp = &module->imports[import_idx];
+    h = reload_mix_u32(h, imp->module_num);
+    if (imp->entity_name) h = reload_mix(h, imp->entity_name, strlen(imp->entity_name) + 1);
+    h = reload_mix_u32(h, imp->desc.func.import_flags);
+    h = reload_mix_u32(h, imp->desc.func.symbol_index);
+    h = reload_mix_sig(h, module, imp->desc.func.type_idx);
+    return reload_mix_u32(h, espb_jit_import_can_call_direct(instance, import_idx, NULL, NULL));
+}
+
+// Смещение глобала в globals_data встраивается в код константой
+static uint64_t reload_mix_global(uint64_t h, const EspbInstance *instance, uint16_t idx) {
+    const EspbModule *module = instance->module;
+    idx &= 0x7FFF;
+    if (idx >= module->num_globals) return reload_mix_u32(h, UINT32_MAX);
+    const EspbGlobalDesc *g = &module->globals[idx];
+    h = reload_mix_u32(h, g->type);
+    h = reload_mix_u32(h, g->mutability);
+    h = reload_mix_u32(h, g->shared_flag);
+    h = reload_mix_u32(h, g->init_kind);
+    return reload_mix_u32(h, instance->global_offsets ? instance->global_offsets[idx] : 0);
+}
+
+static uint64_t reload_mix_body(uint64_t h, const EspbInstance *instance, const EspbFunctionBody *body, int depth);
+
+static uint64_t reload_mix_callee(uint64_t h, const EspbInstance *instance, uint16_t local_idx, int depth) {
+    const EspbModule *module = instance->module;
+    if (local_idx >= module->num_functions) return reload_mix_u32(h, UINT32_MAX);
+    const EspbFunctionBody *callee = &module->function_bodies[local_idx];
+    h = reload_mix_sig(h, module, module->function_signature_indices[local_idx]);
+    h = reload_mix(h, &callee->header, sizeof(callee->header));
+#if CONFIG_ESPB_JIT_INLINE
+    // Маленький callee мог быть встроен: его тело - часть кода вызывающего
+    if (depth == 0 && callee->code_size <= CONFIG_ESPB_JIT_INLINE_MAX_BYTES &&
+        espb_ensure_function_ready(module, local_idx) == ESPB_OK) {
+        h = reload_mix_body(h, instance, callee, depth + 1);
+    }
+#else
+    (void)depth;
+#endif
+    return h;
+}
+
+// Байт-код тела и всё, что JIT берёт из модуля по индексам из операндов
+static uint64_t reload_mix_body(uint64_t h, const EspbInstance *instance, const EspbFunctionBody *body, int depth) {
+    const EspbModule *module = instance->module;
+    h = reload_mix_u32(h, body->code_size);
+    h = reload_mix(h, body->code, body->code_size);
+    const uint8_t *pc = body->code;
+    const uint8_t *end = pc + body->code_size;
+    while (pc < end) {
+        size_t len = espb_instruction_length(pc, end);
+        if (len == 0) break;
+        uint16_t idx;
+        switch (*pc) {
+            case 0x09: // CALL_IMPORT import_idx(u16)
+                memcpy(&idx, pc + 1, sizeof(idx));
+                h = reload_mix_import(h, instance, idx);
+                break;
+            case 0x0A: // CALL local_func_idx(u16)
+                memcpy(&idx, pc + 1, sizeof(idx));
+                h = reload_mix_callee(h, instance, idx, depth);
+                break;
+            case 0x0B: case 0x0D: // CALL_INDIRECT / CALL_INDIRECT_PTR Rfunc, type_idx(u16)
+                memcpy(&idx, pc + 2, sizeof(idx));
+                h = reload_mix_sig(h, module, idx);
+                break;
+            case 0x1D: case 0x1E: // LD_GLOBAL_ADDR / LD_GLOBAL Rd, idx(u16)
+                memcpy(&idx, pc + 2, sizeof(idx));
+                h = reload_mix_global(h, instance, idx);
+                break;
+            case 0x1F: // ST_GLOBAL idx(u16), Rs
+                memcpy(&idx, pc + 1, sizeof(idx));
+                h = reload_mix_global(h, instance, idx);
+                break;
+            default:
+                break;
+        }
+        pc += len;
+    }
+    return h;
+}
+
+static uint64_t reload_function_hash(const EspbInstance *instance, uint32_t local_idx) {
+    const EspbModule *module = instance->module;
+    const EspbFunctionBody *body = &module->function_bodies[local_idx];
+    uint64_t h = reload_mix_sig(RELOAD_HASH_INIT, module, module->function_signature_indices[local_idx]);
+    h = reload_mix(h, &body->header, sizeof(body->header));
+#if CONFIG_ESPB_SANDBOX_MASKED
+    // Маска песочницы зашита в код константой (база читается через экземпляр)
+    h = reload_mix_u32(h, instance->memory_mask);
+#endif
+    return reload_mix_body(h, instance, body, 0);
+}
+
+static void *reload_dup(const void *src, size_t size) {
+    if (!src) return NULL;
+    void *dst = malloc(size);
+    if (dst) memcpy(dst, src, size);
+    return dst;
+}
+
+// Копия кода старой функции в исполняемой памяти нового экземпляра; вызывается под захватом
+// компиляции new_body (jit_state == COMPILING)
+static EspbResult reload_carry_one(EspbInstance *new_instance, uint32_t local_idx, const EspbFunctionBody *old_body) {
+    const EspbJitRelocs *relocs = old_body->jit_relocs;
+    size_t size = old_body->jit_code_size;
+    if (size > espb_jit_native_limit(new_instance, NULL)) return ESPB_ERR_JIT_CODE_TOO_LARGE;
+
+    EspbJitRelocs *new_relocs = (EspbJitRelocs *)reload_dup(relocs, sizeof(EspbJitRelocs) +
+                                                            relocs->count * sizeof(EspbJitReloc));
+    EspbJitOsrInfo *osr = NULL;
+#if CONFIG_ESPB_JIT_OSR
+    const EspbJitOsrInfo *old_osr = old_body->jit_osr;
+    if (old_osr) {
+        osr = (EspbJitOsrInfo *)reload_dup(old_osr, sizeof(EspbJitOsrInfo) +
+                                           old_osr->num_points * sizeof(EspbJitOsrPoint));
+    }
+#endif
+    const EspbJitPcMap *old_map = old_body->jit_pc_map;
+    EspbJitPcMap *pc_map = old_map ? (EspbJitPcMap *)reload_dup(old_map, sizeof(EspbJitPcMap) +
+                                                                 old_map->num_entries * sizeof(EspbJitPcMapEntry))
+                                   : NULL;
+
+    EspbJitArenaReservation res;
+    uint8_t *code = espb_jit_code_reserve(new_instance, size, NULL, 0, &res) ? (uint8_t *)res.code : NULL;
+    if (!code || !new_relocs || (CONFIG_ESPB_JIT_OSR && old_body->jit_osr && !osr) || (old_map && !pc_map)) {
+        if (code) espb_jit_code_abort(new_instance, code);
+        free(new_relocs);
+        free(osr);
+        free(pc_map);
+        return ESPB_ERR_MEMORY_ALLOC;
+    }
+
+    memcpy(code, old_body->jit_code, size);
+    for (uint32_t i = 0; i < relocs->count; i++) {
+        espb_jit_reloc_apply(code, &relocs->entries[i]);
+    }
+    espb_jit_code_commit(new_instance, code, size);
+#ifdef ESP_PLATFORM
+    __asm__ volatile("fence.i" ::: "memory");
+#endif
+    espb_jit_publish(new_instance, local_idx, code, size, osr, pc_map, new_relocs);
+    return ESPB_OK;
+}
+
+EspbResult espb_jit_reload_carry(EspbInstance *old_instance, EspbInstance *new_instance, uint32_t *out_carried) {
+    if (out_carried) *out_carried = 0;
+    if (!old_instance || !new_instance || !old_instance->module || !new_instance->module) {
+        return ESPB_ERR_INVALID_OPERAND;
+    }
+    const EspbModule *old_module = old_instance->module;
+    const EspbModule *new_module = new_instance->module;
+
+    // Хэши старых функций, у которых есть переносимый код; 0 - переносить нечего
+    uint64_t *old_hashes = (uint64_t *)calloc(old_module->num_functions ? old_module->num_functions : 1,
+                                              sizeof(uint64_t));
+    if (!old_hashes) return ESPB_ERR_MEMORY_ALLOC;
+    uint32_t candidates = 0;
+    for (uint32_t i = 0; i < old_module->num_functions; i++) {
+        const EspbFunctionBody *body = &old_module->function_bodies[i];
+        if (__atomic_load_n(&body->jit_state, __ATOMIC_ACQUIRE) != ESPB_JIT_STATE_READY || !body->jit_relocs) continue;
+        old_hashes[i] = reload_function_hash(old_instance, i) | 1u;
+        candidates++;
+    }
+
+    EspbResult result = ESPB_OK;
+    uint32_t carried = 0;
+    SemaphoreHandle_t lock = new_module->jit_mutex ? new_module->jit_mutex : new_instance->instance_mutex;
+    bool locked = candidates && lock && xSemaphoreTake(lock, portMAX_DELAY) == pdTRUE;
+
+    for (uint32_t n = 0; candidates && n < new_module->num_functions; n++) {
+        EspbFunctionBody *new_body = &new_module->function_bodies[n];
+        if (espb_ensure_function_ready(new_module, n) != ESPB_OK) continue;
+        uint64_t h = reload_function_hash(new_instance, n) | 1u;
+
+        // Сначала та же позиция (обычный случай), затем любая другая
+        uint32_t match = UINT32_MAX;
+        if (n < old_module->num_functions && old_hashes[n] == h) {
+            match = n;
+        } else {
+            for (uint32_t o = 0; o < old_module->num_functions; o++) {
+                if (old_hashes[o] == h) {
+                    match = o;
+                    break;
+                }
+            }
+        }
+        if (match == UINT32_MAX) continue;
+        // Хэш зависимостей может совпасть случайно, байт-код сверяем целиком
+        const EspbFunctionBody *old_body = &old_module->function_bodies[match];
+        if (old_body->code_size != new_body->code_size ||
+            memcmp(old_body->code, new_body->code, new_body->code_size) != 0) {
+            continue;
+        }
+
+        uint8_t state = ESPB_JIT_STATE_NONE;
+        if (!__atomic_compare_exchange_n(&new_body->jit_state, &state, ESPB_JIT_STATE_COMPILING, false,
+                                         __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+            continue;
+        }
+        EspbResult res = reload_carry_one(new_instance, n, old_body);
+        if (res == ESPB_OK) {
+            carried++;
+            continue;
+        }
+        __atomic_store_n(&new_body->jit_state, ESPB_JIT_STATE_NONE, __ATOMIC_RELEASE);
+        if (res == ESPB_ERR_MEMORY_ALLOC) {
+            // Исполняемая память кончилась: остальное компилируется при вызове
+            result = res;
+            break;
+        }
+    }
+
+    if (locked) xSemaphoreGive(lock);
+    free(old_hashes);
+    ESP_LOGI(TAG, "Carried JIT code of %u/%u functions to the new module", (unsigned)carried,
+             (unsigned)new_module->num_functions);
+    if (out_carried) *out_carried = carried;
+    return result;
+}
+
+#endif // CONFIG_ESPB_JIT_ENABLED && CONFIG_ESPB_JIT_RELOAD
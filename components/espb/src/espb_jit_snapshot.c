@@ -0,0 +1,284 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "espb_jit_snapshot.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if CONFIG_ESPB_JIT_ENABLED && (CONFIG_ESPB_JIT_SNAPSHOT || CONFIG_ESPB_JIT_RELOAD)
+
+// Перекодирует пару auipc t0 / jalr ra, lo12(t0) под новый адрес кода
+void espb_jit_reloc_apply(uint8_t *code, const EspbJitReloc *rel) {
+    uint32_t auipc, jalr;
+    memcpy(&auipc, code + rel->native_offset, 4);
+    memcpy(&jalr, code + rel->native_offset + 4, 4);
+    int64_t pcrel = (int64_t)rel->target - (int64_t)(uintptr_t)(code + rel->native_offset);
+    int64_t hi20 = (pcrel + 0x800) >> 12;
+    int64_t lo12 = pcrel - (hi20 << 12);
+    auipc = (auipc & 0xFFFu) | (((uint32_t)hi20 & 0xFFFFFu) << 12);
+    jalr = (jalr & 0xFFFFFu) | (((uint32_t)lo12 & 0xFFFu) << 20);
+    memcpy(code + rel->native_offset, &auipc, 4);
+    memcpy(code + rel->native_offset + 4, &jalr, 4);
+}
+
+EspbJitRelocs *espb_jit_relocs_create(const EspbJitReloc *relocs, size_t count) {
+    EspbJitRelocs *out = (EspbJitRelocs *)malloc(sizeof(EspbJitRelocs) + count * sizeof(EspbJitReloc));
+    if (!out) return NULL;
+    out->count = (uint32_t)count;
+    if (count) memcpy(out->entries, relocs, count * sizeof(EspbJitReloc));
+    return out;
+}
+
+#endif
+
+#if CONFIG_ESPB_JIT_ENABLED && CONFIG_ESPB_JIT_SNAPSHOT
+
+#include "espb_exec_memory.h"
+#include "espb_jit.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_app_desc.h"
+#include "esp_rom_crc.h"
+
+static const char *TAG = "espb_jit_snap";
+
+#define ESPB_JIT_SNAP_MAGIC   0x50534A45u  // "EJSP"
+#define ESPB_JIT_SNAP_NONE    UINT32_MAX
+#define ESPB_JIT_SNAP_FW_ID_LEN 8
+
+// Запись в разделе (журнал, только дозапись):
+// [EspbJitSnapRecord][code, выровнен до 4][EspbJitReloc x num_relocs]
+typedef struct {
+    uint32_t magic;                          // 0xFFFFFFFF - свободное место, конец журнала
+    uint32_t module_hash;                    // FNV-1a буфера модуля
+    uint8_t  fw_id[ESPB_JIT_SNAP_FW_ID_LEN]; // Начало SHA256 ELF прошивки
+    uint32_t func_idx;                       // Глобальный индекс функции
+    uint32_t code_size;
+    uint32_t num_relocs;
+    uint32_t crc;                            // CRC32 кода и релокаций
+} EspbJitSnapRecord;
+
+struct EspbJitSnapshot {
+    const esp_partition_t *part;
+    uint32_t module_hash;
+    uint8_t fw_id[ESPB_JIT_SNAP_FW_ID_LEN];
+    uint32_t write_offset;
+    uint32_t num_functions;
+    uint32_t *record_offsets;                // [num_functions], ESPB_JIT_SNAP_NONE - записи нет
+};
+
+static inline uint32_t snap_align4(uint32_t v) { return (v + 3u) & ~3u; }
+
+static inline uint32_t snap_record_size(const EspbJitSnapRecord *rec) {
+    return (uint32_t)sizeof(EspbJitSnapRecord) + snap_align4(rec->code_size) + rec->num_relocs * (uint32_t)sizeof(EspbJitReloc);
+}
+
+static uint32_t snap_module_hash(const EspbModule *module) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < module->buffer_size; i++) {
+        h = (h ^ module->buffer[i]) * 16777619u;
+    }
+    return h;
+}
+
+EspbResult espb_jit_snapshot_open(EspbInstance *instance) {
+    if (!instance || !instance->module) return ESPB_ERR_INVALID_OPERAND;
+    const EspbModule *module = instance->module;
+
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                                           CONFIG_ESPB_JIT_SNAPSHOT_PARTITION);
+    if (!part) {
+        ESP_LOGW(TAG, "Partition '%s' not found, JIT snapshot disabled", CONFIG_ESPB_JIT_SNAPSHOT_PARTITION);
+        return ESPB_OK;
+    }
+    if (module->num_functions == 0) return ESPB_OK;
+
+    EspbJitSnapshot *snap = (EspbJitSnapshot *)calloc(1, sizeof(EspbJitSnapshot));
+    if (!snap) return ESPB_ERR_MEMORY_ALLOC;
+    snap->record_offsets = (uint32_t *)malloc(module->num_functions * sizeof(uint32_t));
+    if (!snap->record_offsets) {
+        free(snap);
+        return ESPB_ERR_MEMORY_ALLOC;
+    }
+    for (uint32_t i = 0; i < module->num_functions; i++) snap->record_offsets[i] = ESPB_JIT_SNAP_NONE;
+    snap->part = part;
+    snap->num_functions = module->num_functions;
+    snap->module_hash = snap_module_hash(module);
+    memcpy(snap->fw_id, esp_app_get_description()->app_elf_sha256, ESPB_JIT_SNAP_FW_ID_LEN);
+
+    // Сканируем журнал: индекс записей этого модуля и позиция дозаписи
+    uint32_t off = 0;
+    bool stale = false;
+    while (off + sizeof(EspbJitSnapRecord) <= part->size) {
+        EspbJitSnapRecord rec;
+        if (esp_partition_read(part, off, &rec, sizeof(rec)) != ESP_OK) break;
+        if (rec.magic != ESPB_JIT_SNAP_MAGIC) break;  // Свободное место или оборванная запись
+        uint32_t size = snap_record_size(&rec);
+        if (rec.code_size == 0 || size > part->size - off) break;
+
+        if (memcmp(rec.fw_id, snap->fw_id, ESPB_JIT_SNAP_FW_ID_LEN) != 0) {
+            stale = true;
+        } else if (rec.module_hash == snap->module_hash) {
+            uint32_t local_idx = rec.func_idx - module->num_imported_funcs;
+            if (rec.func_idx >= module->num_imported_funcs && local_idx < module->num_functions) {
+                snap->record_offsets[local_idx] = off;
+            }
+        }
+        off += size;
+    }
+    snap->write_offset = off;
+
+    if (stale) {
+        // Код другой прошивки вызывает helper'ы по чужим адресам - бесполезен целиком
+        ESP_LOGI(TAG, "Firmware changed, erasing JIT snapshot partition");
+        esp_partition_erase_range(part, 0, part->size);
+        for (uint32_t i = 0; i < module->num_functions; i++) snap->record_offsets[i] = ESPB_JIT_SNAP_NONE;
+        snap->write_offset = 0;
+    }
+
+    instance->jit_snapshot = snap;
+    return ESPB_OK;
+}
+
+void espb_jit_snapshot_close(EspbInstance *instance) {
+    if (!instance || !instance->jit_snapshot) return;
+    free(instance->jit_snapshot->record_offsets);
+    free(instance->jit_snapshot);
+    instance->jit_snapshot = NULL;
+}
+
+EspbResult espb_jit_snapshot_load(EspbInstance *instance, uint32_t func_idx, void **out_code, size_t *out_size,
+                                  EspbJitRelocs **out_relocs) {
+    EspbJitSnapshot *snap = instance->jit_snapshot;
+    if (!snap) return ESPB_ERR_UNSUPPORTED;
+    uint32_t local_idx = func_idx - instance->module->num_imported_funcs;
+    if (local_idx >= snap->num_functions || snap->record_offsets[local_idx] == ESPB_JIT_SNAP_NONE) {
+        return ESPB_ERR_UNSUPPORTED;
+    }
+
+    uint32_t off = snap->record_offsets[local_idx];
+    EspbJitSnapRecord rec;
+    if (esp_partition_read(snap->part, off, &rec, sizeof(rec)) != ESP_OK) return ESPB_ERR_RUNTIME_ERROR;
+
+    EspbJitArenaReservation code_res;
+    uint8_t *code = espb_jit_code_reserve(instance, rec.code_size, NULL, 0, &code_res) ? (uint8_t *)code_res.code : NULL;
+    EspbJitReloc *relocs = rec.num_relocs ? (EspbJitReloc *)malloc(rec.num_relocs * sizeof(EspbJitReloc)) : NULL;
+    if (!code || (rec.num_relocs && !relocs)) {
+        if (code) espb_jit_code_abort(instance, code);
+        free(relocs);
+        return ESPB_ERR_MEMORY_ALLOC;
+    }
+
+    off += sizeof(rec);
+    bool ok = esp_partition_read(snap->part, off, code, rec.code_size) == ESP_OK;
+    off += snap_align4(rec.code_size);
+    if (ok && relocs) {
+        ok = esp_partition_read(snap->part, off, relocs, rec.num_relocs * sizeof(EspbJitReloc)) == ESP_OK;
+    }
+    if (ok) {
+        uint32_t crc = esp_rom_crc32_le(0, code, rec.code_size);
+        if (relocs) crc = esp_rom_crc32_le(crc, (const uint8_t *)relocs, rec.num_relocs * sizeof(EspbJitReloc));
+        ok = (crc == rec.crc);
+    }
+    for (uint32_t i = 0; ok && i < rec.num_relocs; i++) {
+        if (relocs[i].native_offset + 8 > rec.code_size) {
+            ok = false;
+            break;
+        }
+        espb_jit_reloc_apply(code, &relocs[i]);
+    }
+#if CONFIG_ESPB_JIT_RELOAD
+    if (ok && out_relocs) *out_relocs = espb_jit_relocs_create(relocs, rec.num_relocs);
+#else
+    (void)out_relocs;
+#endif
+    free(relocs);
+
+    if (!ok) {
+        ESP_LOGW(TAG, "Snapshot record for function %u is corrupt, recompiling", (unsigned)func_idx);
+        snap->record_offsets[local_idx] = ESPB_JIT_SNAP_NONE;
+        espb_jit_code_abort(instance, code);
+        return ESPB_ERR_RUNTIME_ERROR;
+    }
+    espb_jit_code_commit(instance, code, rec.code_size);
+
+#ifdef ESP_PLATFORM
+    __asm__ volatile("fence.i" ::: "memory");
+#endif
+    *out_code = code;
+    *out_size = rec.code_size;
+    ESP_LOGD(TAG, "Function %u loaded from snapshot (%u bytes, %u relocs)", (unsigned)func_idx,
+             (unsigned)rec.code_size, (unsigned)rec.num_relocs);
+    return ESPB_OK;
+}
+
+void espb_jit_snapshot_store(EspbInstance *instance, uint32_t func_idx, const void *code, size_t code_size,
+                             const EspbJitReloc *relocs, size_t num_relocs) {
+    EspbJitSnapshot *snap = instance->jit_snapshot;
+    if (!snap || !code || code_size == 0) return;
+    uint32_t local_idx = func_idx - instance->module->num_imported_funcs;
+    if (local_idx >= snap->num_functions || snap->record_offsets[local_idx] != ESPB_JIT_SNAP_NONE) return;
+
+    EspbJitSnapRecord rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.magic = ESPB_JIT_SNAP_MAGIC;
+    rec.module_hash = snap->module_hash;
+    memcpy(rec.fw_id, snap->fw_id, ESPB_JIT_SNAP_FW_ID_LEN);
+    rec.func_idx = func_idx;
+    rec.code_size = (uint32_t)code_size;
+    rec.num_relocs = (uint32_t)num_relocs;
+    rec.crc = esp_rom_crc32_le(0, (const uint8_t *)code, code_size);
+    if (num_relocs) rec.crc = esp_rom_crc32_le(rec.crc, (const uint8_t *)relocs, num_relocs * sizeof(EspbJitReloc));
+
+    uint32_t size = snap_record_size(&rec);
+    if (size > snap->part->size) return;
+    if (size > snap->part->size - snap->write_offset) {
+        // Журнал заполнен: начинаем заново, записи перезапишутся при следующих компиляциях
+        ESP_LOGI(TAG, "JIT snapshot partition full, erasing");
+        if (esp_partition_erase_range(snap->part, 0, snap->part->size) != ESP_OK) return;
+        for (uint32_t i = 0; i < snap->num_functions; i++) snap->record_offsets[i] = ESPB_JIT_SNAP_NONE;
+        snap->write_offset = 0;
+    }
+
+    // Тело пишется до заголовка: оборванная запись выглядит как свободное место либо не проходит CRC
+    uint32_t off = snap->write_offset;
+    uint32_t body_off = off + sizeof(rec);
+    uint32_t code_aligned = snap_align4((uint32_t)code_size);
+    bool ok = esp_partition_write(snap->part, body_off, code, code_size & ~(size_t)3u) == ESP_OK;
+    if (ok && (code_size & 3u)) {
+        uint8_t tail[4] = { 0xFF, 0xFF, 0xFF, 0xFF };
+        memcpy(tail, (const uint8_t *)code + (code_size & ~(size_t)3u), code_size & 3u);
+        ok = esp_partition_write(snap->part, body_off + (code_size & ~(uint32_t)3u), tail, sizeof(tail)) == ESP_OK;
+    }
+    if (ok && num_relocs) {
+        ok = esp_partition_write(snap->part, body_off + code_aligned, relocs, num_relocs * sizeof(EspbJitReloc)) == ESP_OK;
+    }
+    if (ok) {
+        ok = esp_partition_write(snap->part, off, &rec, sizeof(rec)) == ESP_OK;
+    }
+    // Даже при ошибке место занято - следующая запись идёт после него
+    snap->write_offset = off + size;
+    if (ok) {
+        snap->record_offsets[local_idx] = off;
+        ESP_LOGD(TAG, "Function %u stored to snapshot (%u bytes)", (unsigned)func_idx, (unsigned)code_size);
+    } else {
+        ESP_LOGW(TAG, "Failed to store function %u to snapshot", (unsigned)func_idx);
+    }
+}
+
+#endif // CONFIG_ESPB_JIT_ENABLED && CONFIG_ESPB_JIT_SNAPSHOT
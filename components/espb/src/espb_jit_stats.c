@@ -0,0 +1,58 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "espb_jit_stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+EspbResult espb_jit_stats_init(EspbInstance *instance) {
+    if (!instance || !instance->module) return ESPB_ERR_INVALID_OPERAND;
+#if CONFIG_ESPB_JIT_STATS
+    EspbJitStats *stats = (EspbJitStats *)calloc(1, sizeof(EspbJitStats));
+    if (!stats) return ESPB_ERR_MEMORY_ALLOC;
+    stats->num_functions = instance->module->num_functions;
+    if (stats->num_functions > 0) {
+        stats->funcs = (EspbJitFuncStats *)calloc(stats->num_functions, sizeof(EspbJitFuncStats));
+        if (!stats->funcs) {
+            free(stats);
+            return ESPB_ERR_MEMORY_ALLOC;
+        }
+    }
+    instance->jit_stats = stats;
+#endif
+    return ESPB_OK;
+}
+
+void espb_jit_stats_free(EspbInstance *instance) {
+    if (!instance || !instance->jit_stats) return;
+    free(instance->jit_stats->funcs);
+    free(instance->jit_stats);
+    instance->jit_stats = NULL;
+}
+
+void espb_jit_stats_clear(EspbJitStats *stats) {
+    if (!stats) return;
+    // Сведения о коде (helper'ы, spills, время компиляции) описывают опубликованный код
+    // и сохраняются; обнуляются только счётчики событий
+    for (uint32_t i = 0; stats->funcs && i < stats->num_functions; i++) {
+        stats->funcs[i].fallbacks = 0;
+        stats->funcs[i].exec_count = 0;
+    }
+    stats->compile_failures = 0;
+    stats->evictions = 0;
+}
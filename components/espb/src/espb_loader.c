@@ -0,0 +1,238 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "espb_loader.h"
+#include "espb_interpreter.h"
+#include "espb_interpreter_parser.h"
+#include "esp_partition.h"
+#include "esp_log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "espb_loader";
+
+// Magic (4) + Version (4) + Flags (4) + Features (4) + NumSections (2)
+#define LOADER_HEADER_SIZE 18
+#define LOADER_SECTION_ENTRY_SIZE 12
+#define LOADER_MAX_SECTIONS 256
+#define LOADER_SECTOR_SIZE 4096
+
+struct EspbLoader {
+    const esp_partition_t *partition;  // NULL - модуль собирается в RAM
+    // Заголовок и таблица секций копятся здесь, пока не известен размер модуля
+    uint8_t prefix[LOADER_HEADER_SIZE + LOADER_MAX_SECTIONS * LOADER_SECTION_ENTRY_SIZE];
+    size_t prefix_size;                // 0 - число секций ещё не прочитано
+    size_t extent;                     // Размер модуля; 0 - ещё не известен
+    size_t received;
+
+    uint8_t *ram;                      // Окончательный буфер модуля (RAM)
+    const uint8_t *image;              // Окончательное место модуля: ram или отображение раздела
+    esp_partition_mmap_handle_t mmap_handle;
+    bool mapped;
+    size_t erased;                     // Граница уже стёртой части раздела
+
+    EspbModule *module;                // Разбирается по мере поступления секций
+    bool parsed;
+    EspbResult error;                  // Первая ошибка; дальнейшие вызовы возвращают её
+};
+
+EspbResult espb_loader_begin(const char *partition_label, espb_loader_t *out_loader) {
+    if (!out_loader) return ESPB_ERR_INVALID_STATE;
+    *out_loader = NULL;
+
+    const esp_partition_t *part = NULL;
+    if (partition_label) {
+        part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, partition_label);
+        if (!part) {
+            ESP_LOGE(TAG, "Partition '%s' not found", partition_label);
+            return ESPB_ERR_INVALID_STATE;
+        }
+    }
+
+    espb_loader_t loader = (espb_loader_t)calloc(1, sizeof(*loader));
+    if (!loader) return ESPB_ERR_MEMORY_ALLOC;
+    loader->partition = part;
+    loader->error = ESPB_OK;
+    *out_loader = loader;
+    return ESPB_OK;
+}
+
+static EspbResult loader_check_header(espb_loader_t loader) {
+    uint32_t magic, version;
+    uint16_t num_sections;
+    memcpy(&magic, loader->prefix, sizeof(magic));
+    memcpy(&version, loader->prefix + 4, sizeof(version));
+    memcpy(&num_sections, loader->prefix + 16, sizeof(num_sections));
+    if (magic != ESPB_MAGIC_NUMBER) return ESPB_ERR_INVALID_MAGIC;
+    if (version != ESPB_VERSION_1_7 && version != ESPB_VERSION_1_6) return ESPB_ERR_UNSUPPORTED_VERSION;
+    if (num_sections == 0 || num_sections > LOADER_MAX_SECTIONS) return ESPB_ERR_INVALID_SECTION_TABLE;
+    loader->prefix_size = LOADER_HEADER_SIZE + (size_t)num_sections * LOADER_SECTION_ENTRY_SIZE;
+    return ESPB_OK;
+}
+
+// Стирает раздел секторами, пока стёртая часть не покроет end
+static EspbResult loader_erase_to(espb_loader_t loader, size_t end) {
+    if (end <= loader->erased) return ESPB_OK;
+    size_t new_erased = (end + LOADER_SECTOR_SIZE - 1) & ~(size_t)(LOADER_SECTOR_SIZE - 1);
+    if (new_erased > loader->partition->size) new_erased = loader->partition->size;
+    if (esp_partition_erase_range(loader->partition, loader->erased, new_erased - loader->erased) != ESP_OK) {
+        ESP_LOGE(TAG, "Erase of 0x%x..0x%x failed", (unsigned)loader->erased, (unsigned)new_erased);
+        return ESPB_ERR_INVALID_STATE;
+    }
+    loader->erased = new_erased;
+    return ESPB_OK;
+}
+
+// Пишет байты модуля в окончательное место. esp_partition_write сбрасывает кэш flash
+// для записанного диапазона, поэтому отображение сразу видит новые данные.
+static EspbResult loader_store(espb_loader_t loader, size_t offset, const uint8_t *data, size_t len) {
+    if (!loader->partition) {
+        memcpy(loader->ram + offset, data, len);
+        return ESPB_OK;
+    }
+    EspbResult result = loader_erase_to(loader, offset + len);
+    if (result != ESPB_OK) return result;
+    if (esp_partition_write(loader->partition, offset, data, len) != ESP_OK) {
+        ESP_LOGE(TAG, "Write of %u bytes at 0x%x failed", (unsigned)len, (unsigned)offset);
+        return ESPB_ERR_INVALID_STATE;
+    }
+    return ESPB_OK;
+}
+
+// Таблица секций получена: размер модуля известен, выделяем окончательное место,
+// переносим в него заголовок и таблицу и начинаем разбор
+static EspbResult loader_open_image(espb_loader_t loader) {
+    size_t extent = loader->prefix_size;
+    for (size_t off = LOADER_HEADER_SIZE; off < loader->prefix_size; off += LOADER_SECTION_ENTRY_SIZE) {
+        uint32_t sec_offset, sec_size;
+        memcpy(&sec_offset, loader->prefix + off + 4, sizeof(sec_offset));
+        memcpy(&sec_size, loader->prefix + off + 8, sizeof(sec_size));
+        if ((size_t)sec_offset + sec_size > extent) extent = (size_t)sec_offset + sec_size;
+    }
+
+    if (loader->partition) {
+        if (extent > loader->partition->size) {
+            ESP_LOGE(TAG, "Module (%u bytes) does not fit partition '%s'", (unsigned)extent, loader->partition->label);
+            return ESPB_ERR_BUFFER_TOO_SMALL;
+        }
+        const void *view = NULL;
+        if (esp_partition_mmap(loader->partition, 0, extent, ESP_PARTITION_MMAP_DATA, &view, &loader->mmap_handle) != ESP_OK) {
+            return ESPB_ERR_MEMORY_ALLOC;
+        }
+        loader->mapped = true;
+        loader->image = (const uint8_t *)view;
+    } else {
+        loader->ram = (uint8_t *)malloc(extent);
+        if (!loader->ram) {
+            ESP_LOGE(TAG, "Failed to allocate %u bytes for module", (unsigned)extent);
+            return ESPB_ERR_MEMORY_ALLOC;
+        }
+        loader->image = loader->ram;
+    }
+    loader->extent = extent;
+
+    EspbResult result = loader_store(loader, 0, loader->prefix, loader->prefix_size);
+    if (result != ESPB_OK) return result;
+    ESP_LOGI(TAG, "Receiving module: %u bytes, %u sections, %s", (unsigned)extent,
+             (unsigned)((loader->prefix_size - LOADER_HEADER_SIZE) / LOADER_SECTION_ENTRY_SIZE),
+             loader->partition ? loader->partition->label : "RAM");
+    return espb_parse_module_begin(&loader->module, loader->image, extent, loader->received);
+}
+
+static EspbResult loader_feed(espb_loader_t loader, const uint8_t *data, size_t len) {
+    while (len > 0) {
+        if (loader->extent == 0) {
+            size_t need = loader->prefix_size ? loader->prefix_size : LOADER_HEADER_SIZE;
+            size_t take = need - loader->received;
+            if (take > len) take = len;
+            memcpy(loader->prefix + loader->received, data, take);
+            loader->received += take;
+            data += take;
+            len -= take;
+            if (loader->received < need) return ESPB_OK;
+
+            EspbResult result = loader->prefix_size ? loader_open_image(loader) : loader_check_header(loader);
+            if (result != ESPB_OK) return result;
+            continue;
+        }
+
+        if (loader->received >= loader->extent) break; // Хвост после модуля
+        size_t take = loader->extent - loader->received;
+        if (take > len) take = len;
+        EspbResult result = loader_store(loader, loader->received, data, take);
+        if (result != ESPB_OK) return result;
+        loader->received += take;
+        data += take;
+        len -= take;
+    }
+
+    if (loader->module && !loader->parsed) {
+        return espb_parse_module_advance(loader->module, loader->received, &loader->parsed);
+    }
+    return ESPB_OK;
+}
+
+EspbResult espb_loader_feed(espb_loader_t loader, const uint8_t *data, size_t len) {
+    if (!loader || (!data && len > 0)) return ESPB_ERR_INVALID_STATE;
+    if (loader->error == ESPB_OK) {
+        loader->error = loader_feed(loader, data, len);
+    }
+    return loader->error;
+}
+
+void espb_loader_abort(espb_loader_t loader) {
+    if (!loader) return;
+    espb_free_module(loader->module);
+    if (loader->mapped) esp_partition_munmap(loader->mmap_handle);
+    free(loader->ram);
+    free(loader);
+}
+
+EspbResult espb_loader_take_module(espb_loader_t loader, EspbModule **out_module) {
+    if (!loader || !out_module) {
+        espb_loader_abort(loader);
+        return ESPB_ERR_INVALID_STATE;
+    }
+    *out_module = NULL;
+
+    EspbResult result = loader->error;
+    if (result == ESPB_OK && (loader->extent == 0 || loader->received < loader->extent)) {
+        ESP_LOGE(TAG, "Module truncated: %u of %u bytes received", (unsigned)loader->received, (unsigned)loader->extent);
+        result = ESPB_ERR_BUFFER_TOO_SMALL;
+    }
+    if (result == ESPB_OK && !loader->parsed) {
+        result = espb_parse_module_advance(loader->module, loader->received, &loader->parsed);
+        if (result == ESPB_OK && !loader->parsed) result = ESPB_ERR_PARSE_ERROR;
+    }
+    if (result != ESPB_OK) {
+        espb_loader_abort(loader);
+        return result;
+    }
+
+    // Буфер переходит к модулю и освобождается в espb_module_release
+    EspbModule *module = loader->module;
+    if (loader->mapped) {
+        module->buffer_mmapped = true;
+        module->buffer_mmap_handle = (uint32_t)loader->mmap_handle;
+    } else {
+        module->buffer_owned = true;
+    }
+    free(loader);
+    *out_module = module;
+    return ESPB_OK;
+}
@@ -0,0 +1,128 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "espb_marshal_plan.h"
+#include "esp_log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "espb_marshal";
+
+EspbResult espb_marshal_plans_init(EspbInstance *instance) {
+    const EspbModule *module = instance->module;
+    instance->import_marshal = NULL;
+    if ((module->header.features & FEATURE_MARSHALLING_META) == 0 ||
+        module->immeta.num_imports_with_meta <= 0 || !module->immeta.imports || module->num_imports == 0) {
+        return ESPB_OK;
+    }
+
+    size_t total_ops = 0;
+    for (int64_t i = 0; i < module->immeta.num_imports_with_meta; ++i) {
+        total_ops += module->immeta.imports[i].num_marshalled_args;
+    }
+
+    // Планы и операции - одним блоком
+    size_t plans_bytes = module->num_imports * sizeof(EspbMarshalPlan);
+    uint8_t *block = (uint8_t *)calloc(1, plans_bytes + total_ops * sizeof(EspbMarshalOp));
+    if (!block) {
+        ESP_LOGE(TAG, "Failed to allocate marshalling plans");
+        return ESPB_ERR_MEMORY_ALLOC;
+    }
+    EspbMarshalPlan *plans = (EspbMarshalPlan *)block;
+    EspbMarshalOp *ops = (EspbMarshalOp *)(block + plans_bytes);
+
+    for (int64_t i = 0; i < module->immeta.num_imports_with_meta; ++i) {
+        const EspbImmetaImportEntry *entry = &module->immeta.imports[i];
+        // Как и прежний поиск: действует первая запись импорта и первая запись аргумента
+        if (entry->import_index >= module->num_imports || plans[entry->import_index].ops) continue;
+
+        EspbMarshalPlan *plan = &plans[entry->import_index];
+        plan->ops = ops;
+        uint32_t seen = 0;
+        for (uint8_t a = 0; a < entry->num_marshalled_args; ++a) {
+            const EspbImmetaArgEntry *arg = &entry->args[a];
+            if (arg->arg_index >= ESPB_MARSHAL_MAX_OPS || (seen & (1u << arg->arg_index))) continue;
+            seen |= 1u << arg->arg_index;
+
+            EspbMarshalOp *op = &ops[plan->num_ops++];
+            op->arg = arg->arg_index;
+            op->flags = arg->direction_flags & (ESPB_MARSHAL_OP_COPY_IN | ESPB_MARSHAL_OP_COPY_OUT);
+            if (arg->handler_index == 1) {
+                op->flags |= ESPB_MARSHAL_OP_ASYNC;
+                if (op->flags & ESPB_MARSHAL_OP_COPY_OUT) plan->has_async_out = true;
+            }
+            op->size_kind = arg->size_kind;
+            op->size_value = arg->size_value;
+        }
+        ops += plan->num_ops;
+    }
+
+    instance->import_marshal = plans;
+    return ESPB_OK;
+}
+
+void espb_marshal_plans_free(EspbInstance *instance) {
+    free(instance->import_marshal);
+    instance->import_marshal = NULL;
+}
+
+EspbResult espb_marshal_begin(const EspbMarshalPlan *plan, const Value *args, uint32_t num_args,
+                              void **arg_values, EspbMarshalFrame *frame) {
+    for (uint8_t k = 0; k < plan->num_ops; ++k) {
+        const EspbMarshalOp *op = &plan->ops[k];
+        frame->temp[k] = NULL;
+        if (op->arg >= num_args || (op->flags & ESPB_MARSHAL_OP_ASYNC)) continue;
+
+        uint32_t size = espb_marshal_op_size(op, args, num_args);
+        if (size == 0) continue;
+        void *temp = malloc(size);
+        if (!temp) {
+            for (uint8_t j = 0; j < k; ++j) free(frame->temp[j]);
+            return ESPB_ERR_MEMORY_ALLOC;
+        }
+
+        void *original = *(void **)arg_values[op->arg];
+        if ((op->flags & ESPB_MARSHAL_OP_COPY_IN) && original) {
+            memcpy(temp, original, size);
+        } else {
+            memset(temp, 0, size);
+        }
+        frame->temp[k] = temp;
+        frame->original[k] = original;
+        frame->size[k] = size;
+        arg_values[op->arg] = &frame->temp[k];
+    }
+    return ESPB_OK;
+}
+
+void espb_marshal_end(const EspbMarshalPlan *plan, EspbMarshalFrame *frame) {
+    for (uint8_t k = 0; k < plan->num_ops; ++k) {
+        void *temp = frame->temp[k];
+        if (!temp) continue;
+        // Copy-back определяется только направлением immeta, а не readonly-статусом функции
+        if (plan->ops[k].flags & ESPB_MARSHAL_OP_COPY_OUT) {
+            if (frame->original[k]) {
+                memcpy(frame->original[k], temp, frame->size[k]);
+            } else {
+                ESP_LOGW(TAG, "Copy-back of arg %u skipped: original pointer is NULL", plan->ops[k].arg);
+            }
+        }
+        free(temp);
+        frame->temp[k] = NULL;
+    }
+}
@@ -0,0 +1,117 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "espb_memory_stats.h"
+#include "espb_callback_system.h"
+#include "espb_call_ic.h"
+#include "espb_jit.h"
+#include "espb_runtime_ffi_call.h"
+#include "esp_memory_utils.h"
+#include "multi_heap.h"
+#include "ffi.h"
+
+#include <string.h>
+
+static inline void mem_add(size_t usage[ESPB_MEM_NUM_KINDS], const void *ptr, size_t bytes) {
+    if (!ptr || bytes == 0) return;
+    usage[esp_ptr_external_ram(ptr) ? ESPB_MEM_PSRAM : ESPB_MEM_INTERNAL] += bytes;
+}
+
+static void jit_cache_usage(const EspbJitCache *cache, size_t usage[ESPB_MEM_NUM_KINDS]) {
+    mem_add(usage, cache, sizeof(EspbJitCache));
+    mem_add(usage, cache->entries, cache->capacity * sizeof(EspbJitCacheEntry));
+#if CONFIG_ESPB_JIT_ARENA
+    // Блоки арены заняты целиком, включая ещё не занятый хвост
+    for (const EspbJitArenaChunk *chunk = cache->arena.chunks; chunk; chunk = chunk->next) {
+        mem_add(usage, chunk, sizeof(EspbJitArenaChunk));
+        usage[ESPB_MEM_EXEC] += chunk->size;
+    }
+#else
+    usage[ESPB_MEM_EXEC] += cache->used_bytes;
+#endif
+}
+
+void espb_memory_usage(const EspbInstance *instance, size_t usage[ESPB_MEM_NUM_KINDS]) {
+    memset(usage, 0, ESPB_MEM_NUM_KINDS * sizeof(size_t));
+    const EspbModule *module = instance->module;
+
+    mem_add(usage, instance, sizeof(EspbInstance));
+    mem_add(usage, instance->memory_data, instance->memory_capacity_bytes);
+#if !CONFIG_ESPB_SANDBOX_MASKED
+    mem_add(usage, instance->globals_data, instance->globals_data_size); // в песочнице - часть memory_data
+#endif
+    mem_add(usage, instance->global_offsets, module->num_globals * sizeof(uint32_t));
+    mem_add(usage, instance->table_data, instance->table_size * sizeof(void *));
+
+    // Регионы кучи вне линейной памяти
+    for (uint32_t i = 0; i < instance->heap_ctx.num_regions; i++) {
+        const EspbHeapRegion *r = &instance->heap_ctx.regions[i];
+        if (r->owned) mem_add(usage, r->base, r->size);
+    }
+
+    // Импорты: разрешённые адреса, флаги, подготовленные CIF
+    mem_add(usage, instance->resolved_import_funcs, module->num_imports * sizeof(void *));
+    mem_add(usage, instance->resolved_import_globals, module->num_imports * sizeof(void *));
+    mem_add(usage, instance->import_is_blocking, module->num_imports * sizeof(bool));
+    mem_add(usage, instance->import_is_readonly, (module->num_imports + 7) / 8);
+    mem_add(usage, instance->import_cifs, module->num_imports * sizeof(ffi_cif));
+    if (instance->var_cifs) usage[ESPB_MEM_INTERNAL] += espb_runtime_var_cifs_bytes(instance);
+    if (instance->call_ic) mem_add(usage, instance->call_ic, (instance->call_ic_mask + 1) * sizeof(EspbCallIcEntry));
+
+    // Async wrappers: контекст в DRAM, замыкание libffi в исполняемой памяти
+    mem_add(usage, instance->async_wrappers, instance->num_async_wrappers * sizeof(AsyncWrapper *));
+    for (uint32_t i = 0; instance->async_wrappers && i < instance->num_async_wrappers; i++) {
+        const AsyncWrapper *wrapper = instance->async_wrappers[i];
+        if (!wrapper) continue;
+        mem_add(usage, wrapper, sizeof(AsyncWrapper));
+        mem_add(usage, wrapper->context.out_params, wrapper->context.num_out_params * sizeof(AsyncOutParam));
+        if (wrapper->closure_ptr) usage[ESPB_MEM_EXEC] += sizeof(ffi_closure);
+    }
+
+    // Колбэки: замыкания из общего реестра, занятые экземпляром, и кэш CIF
+    uint32_t closures = espb_callback_instance_closures(instance);
+    usage[ESPB_MEM_INTERNAL] += closures * sizeof(EspbCallbackClosure);
+    usage[ESPB_MEM_EXEC] += closures * sizeof(ffi_closure);
+    for (const EspbCallbackCif *cif = instance->callback_cifs; cif; cif = cif->next) {
+        mem_add(usage, cif, sizeof(EspbCallbackCif));
+    }
+
+    if (instance->jit_cache) jit_cache_usage(instance->jit_cache, usage);
+}
+
+void espb_memory_note_peak(EspbInstance *instance) {
+    size_t usage[ESPB_MEM_NUM_KINDS];
+    espb_memory_usage(instance, usage);
+    for (int k = 0; k < ESPB_MEM_NUM_KINDS; k++) {
+        if (usage[k] > instance->mem_peak[k]) instance->mem_peak[k] = usage[k];
+    }
+}
+
+void espb_memory_heap_usage(const EspbInstance *instance, size_t *out_used, size_t *out_free, size_t *out_peak) {
+    size_t used = 0, free_bytes = 0, peak = 0;
+    uint32_t num_regions = __atomic_load_n(&instance->heap_ctx.num_regions, __ATOMIC_ACQUIRE);
+    for (uint32_t i = 0; i < num_regions; i++) {
+        const EspbHeapRegion *r = &instance->heap_ctx.regions[i];
+        size_t region_free = multi_heap_free_size(r->handle);
+        used += r->size - region_free;
+        free_bytes += region_free;
+        peak += r->size - multi_heap_minimum_free_size(r->handle);
+    }
+    if (out_used) *out_used = used;
+    if (out_free) *out_free = free_bytes;
+    if (out_peak) *out_peak = peak;
+}
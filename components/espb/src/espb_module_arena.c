@@ -0,0 +1,127 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "espb_module_arena.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "sdkconfig.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "espb_mod_arena";
+
+#define MODULE_ARENA_ALIGN 8u
+#define MODULE_ARENA_ALIGN_UP(x) (((x) + (MODULE_ARENA_ALIGN - 1)) & ~(size_t)(MODULE_ARENA_ALIGN - 1))
+// Минимальный дополнительный блок: мелкие недоборы оценки не должны плодить блоки
+#define MODULE_ARENA_GROW_MIN 512u
+#define MODULE_ARENA_HDR MODULE_ARENA_ALIGN_UP(sizeof(EspbModuleArenaChunk))
+
+static EspbModuleArenaChunk *arena_new_chunk(EspbModuleArena *arena, size_t size, EspbModuleArenaRegionId region) {
+    EspbModuleArenaChunk *chunk = NULL;
+#if CONFIG_ESPB_MODULE_ARENA_COLD_PSRAM
+    if (region == ESPB_MODULE_ARENA_COLD) {
+        chunk = (EspbModuleArenaChunk *)heap_caps_calloc(1, MODULE_ARENA_HDR + size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    }
+#else
+    (void)region;
+#endif
+    if (!chunk) {
+        chunk = (EspbModuleArenaChunk *)calloc(1, MODULE_ARENA_HDR + size);
+    }
+    if (!chunk) return NULL;
+    chunk->size = size;
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    arena->total += size;
+    return chunk;
+}
+
+static inline uint8_t *chunk_data(EspbModuleArenaChunk *chunk) {
+    return (uint8_t *)chunk + MODULE_ARENA_HDR;
+}
+
+bool espb_module_arena_init(EspbModuleArena *arena, size_t hot_bytes, size_t cold_bytes) {
+    memset(arena, 0, sizeof(*arena));
+    hot_bytes = MODULE_ARENA_ALIGN_UP(hot_bytes);
+    cold_bytes = MODULE_ARENA_ALIGN_UP(cold_bytes);
+
+#if CONFIG_ESPB_MODULE_ARENA_COLD_PSRAM
+    if (cold_bytes > 0) {
+        EspbModuleArenaChunk *cold = arena_new_chunk(arena, cold_bytes, ESPB_MODULE_ARENA_COLD);
+        if (!cold) return false;
+        arena->regions[ESPB_MODULE_ARENA_COLD].cur = chunk_data(cold);
+        arena->regions[ESPB_MODULE_ARENA_COLD].end = chunk_data(cold) + cold_bytes;
+        cold_bytes = 0;
+    }
+#endif
+
+    EspbModuleArenaChunk *chunk = arena_new_chunk(arena, hot_bytes + cold_bytes, ESPB_MODULE_ARENA_HOT);
+    if (!chunk) {
+        espb_module_arena_destroy(arena);
+        return false;
+    }
+    uint8_t *base = chunk_data(chunk);
+    arena->regions[ESPB_MODULE_ARENA_HOT].cur = base;
+    arena->regions[ESPB_MODULE_ARENA_HOT].end = base + hot_bytes;
+    if (cold_bytes > 0) {
+        arena->regions[ESPB_MODULE_ARENA_COLD].cur = base + hot_bytes;
+        arena->regions[ESPB_MODULE_ARENA_COLD].end = base + hot_bytes + cold_bytes;
+    }
+    ESP_LOGD(TAG, "Arena %p: hot=%u cold=%u", (void *)base, (unsigned)hot_bytes, (unsigned)cold_bytes);
+    return true;
+}
+
+void *espb_module_arena_alloc(EspbModuleArena *arena, EspbModuleArenaRegionId region, size_t size) {
+    EspbModuleArenaRegion *r = &arena->regions[region];
+    size_t need = MODULE_ARENA_ALIGN_UP(size);
+    if (r->cur == NULL || (size_t)(r->end - r->cur) < need) {
+        size_t grow = need < MODULE_ARENA_GROW_MIN ? MODULE_ARENA_GROW_MIN : need;
+        EspbModuleArenaChunk *chunk = arena_new_chunk(arena, grow, region);
+        if (!chunk) {
+            ESP_LOGE(TAG, "Out of memory growing module arena by %u bytes", (unsigned)grow);
+            return NULL;
+        }
+        ESP_LOGD(TAG, "Estimate exceeded: region %d grown by %u bytes", (int)region, (unsigned)grow);
+        r->cur = chunk_data(chunk);
+        r->end = r->cur + grow;
+    }
+    void *p = r->cur;
+    r->cur += need;
+    return p; // Блоки выделены calloc, память уже обнулена
+}
+
+bool espb_module_arena_owns(const EspbModuleArena *arena, const void *p) {
+    const uint8_t *b = (const uint8_t *)p;
+    for (EspbModuleArenaChunk *c = arena->chunks; c; c = c->next) {
+        const uint8_t *data = (const uint8_t *)c + MODULE_ARENA_HDR;
+        if (b >= data && b < data + c->size) return true;
+    }
+    return false;
+}
+
+void espb_module_arena_destroy(EspbModuleArena *arena) {
+    EspbModuleArenaChunk *c = arena->chunks;
+    arena->chunks = NULL;
+    memset(arena->regions, 0, sizeof(arena->regions));
+    arena->total = 0;
+    while (c) {
+        EspbModuleArenaChunk *next = c->next;
+        free(c);
+        c = next;
+    }
+}
@@ -0,0 +1,54 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "espb_profiler.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+EspbResult espb_profile_init(EspbInstance *instance) {
+    if (!instance || !instance->module) return ESPB_ERR_INVALID_OPERAND;
+#if CONFIG_ESPB_PROFILER
+    EspbProfile *prof = (EspbProfile *)calloc(1, sizeof(EspbProfile));
+    if (!prof) return ESPB_ERR_MEMORY_ALLOC;
+    prof->num_functions = instance->module->num_functions;
+    if (prof->num_functions > 0) {
+        prof->funcs = (EspbFuncProfile *)calloc(prof->num_functions, sizeof(EspbFuncProfile));
+        if (!prof->funcs) {
+            free(prof);
+            return ESPB_ERR_MEMORY_ALLOC;
+        }
+    }
+    instance->profile = prof;
+#endif
+    return ESPB_OK;
+}
+
+void espb_profile_free(EspbInstance *instance) {
+    if (!instance || !instance->profile) return;
+    free(instance->profile->funcs);
+    free(instance->profile);
+    instance->profile = NULL;
+}
+
+void espb_profile_clear(EspbProfile *profile) {
+    if (!profile) return;
+    memset(profile->opcode_counts, 0, sizeof(profile->opcode_counts));
+    if (profile->funcs) {
+        memset(profile->funcs, 0, profile->num_functions * sizeof(EspbFuncProfile));
+    }
+}
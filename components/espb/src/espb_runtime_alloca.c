@@ -18,8 +18,63 @@
 #include "espb_runtime_alloca.h"
 
 #include "espb_heap_manager.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
 
-#include <string.h>
+static const char *TAG = "espb_alloca";
+
+// JIT code has no ExecutionContext: its ALLOCAs go to a per-task stack
+static __thread EspbAllocaStack s_jit_alloca_stack;
+
+EspbResult espb_alloca_stack_attach(EspbAllocaStack *stack, EspbInstance *instance) {
+    if (stack->base) {
+        // Live allocations of another instance (a nested call crossed instances on one stack)
+        ESP_LOGE(TAG, "ALLOCA stack is in use by another instance");
+        return ESPB_ERR_INVALID_STATE;
+    }
+    void *block = __atomic_exchange_n(&instance->alloca_stack_spare, NULL, __ATOMIC_ACQ_REL);
+    if (!block) {
+        block = espb_heap_malloc_aligned(instance, CONFIG_ESPB_ALLOCA_STACK_SIZE, 16);
+        if (!block) {
+            ESP_LOGE(TAG, "Failed to allocate %d byte ALLOCA stack", CONFIG_ESPB_ALLOCA_STACK_SIZE);
+            return ESPB_ERR_OUT_OF_MEMORY;
+        }
+    }
+    stack->base = (uint8_t *)block;
+    stack->size = CONFIG_ESPB_ALLOCA_STACK_SIZE;
+    stack->sp = 0;
+    stack->instance = instance;
+    return ESPB_OK;
+}
+
+void espb_alloca_stack_detach(EspbAllocaStack *stack) {
+    EspbInstance *instance = stack->instance;
+    // One spare per instance: a second block (parallel contexts) goes back to the heap
+    void *prev = __atomic_exchange_n(&instance->alloca_stack_spare, stack->base, __ATOMIC_ACQ_REL);
+    if (prev) espb_heap_free(instance, prev);
+    stack->base = NULL;
+    stack->sp = 0;
+    stack->instance = NULL;
+}
+
+void espb_alloca_stack_reset(EspbAllocaStack *stack, EspbInstance *instance) {
+    if (stack->base && instance && stack->instance == instance) {
+        espb_alloca_stack_detach(stack);
+        return;
+    }
+    // A block of another, possibly freed, instance is left alone: it goes away with that heap
+    stack->base = NULL;
+    stack->sp = 0;
+    stack->instance = NULL;
+}
+
+uint32_t espb_jit_alloca_mark(void) {
+    return s_jit_alloca_stack.sp;
+}
+
+void espb_jit_alloca_restore(uint32_t mark) {
+    if (s_jit_alloca_stack.sp != mark) espb_alloca_stack_pop(&s_jit_alloca_stack, mark);
+}
 
 EspbResult espb_runtime_alloca(EspbInstance *instance,
                               ExecutionContext *exec_ctx,
@@ -41,31 +96,16 @@ EspbResult espb_runtime_alloca(EspbInstance *instance,
         return ESPB_ERR_INVALID_OPERAND;
     }
 
-    size_t required_alignment = (align > 8) ? align : 8;
-    void *allocated_ptr = espb_heap_malloc_aligned(instance, size_to_alloc, required_alignment);
-    if (!allocated_ptr) {
-        return ESPB_ERR_OUT_OF_MEMORY;
-    }
-
-    memset(allocated_ptr, 0, size_to_alloc);
-
-    // NOTE: ALLOCA allocates from heap, NOT from linear memory (memory_data).
-    // Heap pointers are always outside memory_data range — do not check against it.
-
-    // Track allocation for frame cleanup (interpreter path)
-    if (exec_ctx && exec_ctx->call_stack && exec_ctx->call_stack_top > 0) {
-        RuntimeFrame *frame = &exec_ctx->call_stack[exec_ctx->call_stack_top - 1];
-        if (frame->alloca_count >= 32) {
-            espb_heap_free(instance, allocated_ptr);
-            return ESPB_ERR_OUT_OF_MEMORY;
-        }
-        frame->alloca_ptrs[frame->alloca_count++] = allocated_ptr;
-        if (required_alignment > 4) {
-            frame->has_custom_aligned = true;
-        }
+    uint32_t required_alignment = (align > 8) ? align : 8;
+    EspbAllocaStack *stack = exec_ctx ? &exec_ctx->alloca_stack : &s_jit_alloca_stack;
+    void *allocated_ptr = NULL;
+    EspbResult res = espb_alloca_stack_push(stack, instance, size_to_alloc, required_alignment, &allocated_ptr);
+    if (res != ESPB_OK) {
+        ESP_LOGE(TAG, "ALLOCA of %u bytes failed: %d", (unsigned)size_to_alloc, (int)res);
     }
 
+    // On failure rd must not keep a stale pointer the guest would write through
     SET_TYPE(regs[rd], ESPB_TYPE_PTR);
     V_PTR(regs[rd]) = allocated_ptr;
-    return ESPB_OK;
+    return res;
 }
@@ -19,6 +19,8 @@
 
 #include "ffi.h"
 #include "espb_runtime_ffi_types.h"
+#include "espb_runtime_ffi_call.h"
+#include "espb_import_profile.h"
 
 #include <string.h>
 
@@ -30,6 +32,7 @@ EspbResult espb_runtime_call_import_basic(EspbInstance *instance,
                                          uint8_t num_total_args,
                                          const EspbValueType *arg_types)
 {
+    uint32_t prof_t_begin = ESPB_IMPORT_PROFILE_NOW();
     if (!instance || !instance->module || !regs) return ESPB_ERR_INVALID_OPERAND;
     const EspbModule *module = (const EspbModule*)instance->module;
 
@@ -106,18 +109,26 @@ EspbResult espb_runtime_call_import_basic(EspbInstance *instance,
     if (!ffi_ret_type) return ESPB_ERR_INVALID_OPERAND;
 
     ffi_cif cif;
-    ffi_status st;
-    if (has_variadic_info) {
-        st = ffi_prep_cif_var(&cif, FFI_DEFAULT_ABI, nfixedargs, num_args, ffi_ret_type, ffi_arg_types);
-    } else {
-        st = ffi_prep_cif(&cif, FFI_DEFAULT_ABI, num_args, ffi_ret_type, ffi_arg_types);
+    ffi_cif *cif_ptr = has_variadic_info
+        ? espb_runtime_var_cif(instance, import_idx, nfixedargs, num_args, ffi_ret_type, ffi_arg_types)
+        : espb_runtime_import_cif(instance, import_idx);
+    if (!cif_ptr) {
+        ffi_status st;
+        if (has_variadic_info) {
+            st = ffi_prep_cif_var(&cif, FFI_DEFAULT_ABI, nfixedargs, num_args, ffi_ret_type, ffi_arg_types);
+        } else {
+            st = ffi_prep_cif(&cif, FFI_DEFAULT_ABI, num_args, ffi_ret_type, ffi_arg_types);
+        }
+        if (st != FFI_OK) return ESPB_ERR_INVALID_OPERAND;
+        cif_ptr = &cif;
     }
-    if (st != FFI_OK) return ESPB_ERR_INVALID_OPERAND;
 
     union { int32_t i32; uint32_t u32; int64_t i64; uint64_t u64; float f32; double f64; void *p; } ret;
     memset(&ret, 0, sizeof(ret));
 
-    ffi_call(&cif, FFI_FN(fptr), &ret, ffi_arg_values);
+    uint32_t prof_t_call = ESPB_IMPORT_PROFILE_NOW();
+    ffi_call(cif_ptr, FFI_FN(fptr), &ret, ffi_arg_values);
+    uint32_t prof_t_ret = ESPB_IMPORT_PROFILE_NOW();
 
     if (native_sig->num_returns > 0) {
         switch (ret_t) {
@@ -131,6 +142,8 @@ EspbResult espb_runtime_call_import_basic(EspbInstance *instance,
             default: break;
         }
     }
+    espb_import_profile_record(instance, import_idx, prof_t_begin, prof_t_call, prof_t_ret, ESPB_IMPORT_PROFILE_NOW());
+    (void)prof_t_begin; (void)prof_t_call; (void)prof_t_ret;
 
     return ESPB_OK;
 }
@@ -17,6 +17,7 @@
  */
 #include "espb_runtime_ffi_call.h"
 
+#include <stdlib.h>
 #include <string.h>
 
 EspbResult espb_runtime_ffi_call(void *fptr,
@@ -40,10 +41,21 @@ EspbResult espb_runtime_ffi_call(void *fptr,
     }
     if (st != FFI_OK) return ESPB_ERR_INVALID_OPERAND;
 
+    return espb_runtime_ffi_call_with_cif(&cif, fptr, arg_values, ret_es_type, regs);
+}
+
+EspbResult espb_runtime_ffi_call_with_cif(ffi_cif *cif,
+                                         void *fptr,
+                                         void **arg_values,
+                                         EspbValueType ret_es_type,
+                                         Value *regs)
+{
+    if (!cif || !fptr || (!regs && ret_es_type != ESPB_TYPE_VOID)) return ESPB_ERR_INVALID_OPERAND;
+
     union { int32_t i32; uint32_t u32; int64_t i64; uint64_t u64; float f32; double f64; void *p; } ret;
     memset(&ret, 0, sizeof(ret));
 
-    espb_runtime_ffi_call_prepared(&cif, fptr, &ret, arg_values);
+    espb_runtime_ffi_call_prepared(cif, fptr, &ret, arg_values);
 
     if (ret_es_type != ESPB_TYPE_VOID) {
         espb_runtime_store_ffi_ret(regs, 0, ret_es_type, &ret);
@@ -99,3 +111,124 @@ void espb_runtime_store_ffi_ret(Value *regs, uint8_t ret_reg, EspbValueType ret_
             break;
     }
 }
+
+struct EspbVarCif {
+    struct EspbVarCif *next;
+    uint32_t hash;
+    uint16_t import_idx;
+    uint16_t nfixedargs;
+    uint16_t nargs;
+    ffi_type *ret_type;
+    ffi_cif cif;
+    ffi_type *arg_types[]; // cif.arg_types points here
+};
+
+static uint32_t var_cif_hash(uint16_t import_idx, uint32_t nfixedargs, uint32_t nargs,
+                             ffi_type *ret_ffi_type, ffi_type **arg_types) {
+    uint32_t h = 2166136261u;
+    h = (h ^ import_idx) * 16777619u;
+    h = (h ^ (nfixedargs << 8 | nargs)) * 16777619u;
+    h = (h ^ (uint32_t)(uintptr_t)ret_ffi_type) * 16777619u;
+    for (uint32_t i = 0; i < nargs; i++) {
+        h = (h ^ (uint32_t)(uintptr_t)arg_types[i]) * 16777619u;
+    }
+    return h;
+}
+
+static EspbVarCif *var_cif_find(EspbVarCif *head, uint32_t hash, uint16_t import_idx, uint32_t nfixedargs,
+                                uint32_t nargs, ffi_type *ret_ffi_type, ffi_type **arg_types) {
+    for (EspbVarCif *e = head; e; e = e->next) {
+        if (e->hash == hash && e->import_idx == import_idx && e->nfixedargs == nfixedargs &&
+            e->nargs == nargs && e->ret_type == ret_ffi_type &&
+            memcmp(e->arg_types, arg_types, nargs * sizeof(ffi_type *)) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+// Miss: prepare a new entry and publish it with a CAS on the bucket head. A racing
+// insert of the same key wins, our copy is dropped.
+__attribute__((noinline, cold))
+static ffi_cif *var_cif_insert(const EspbInstance *instance, EspbVarCif **bucket, uint32_t hash,
+                               uint16_t import_idx, uint32_t nfixedargs, uint32_t nargs,
+                               ffi_type *ret_ffi_type, ffi_type **arg_types) {
+    uint32_t count = __atomic_load_n(&instance->var_cif_count, __ATOMIC_RELAXED);
+    if (count >= ESPB_VAR_CIF_MAX_ENTRIES) return NULL;
+
+    EspbVarCif *entry = (EspbVarCif *)malloc(sizeof(EspbVarCif) + nargs * sizeof(ffi_type *));
+    if (!entry) return NULL;
+    entry->hash = hash;
+    entry->import_idx = import_idx;
+    entry->nfixedargs = (uint16_t)nfixedargs;
+    entry->nargs = (uint16_t)nargs;
+    entry->ret_type = ret_ffi_type;
+    memcpy(entry->arg_types, arg_types, nargs * sizeof(ffi_type *));
+    if (ffi_prep_cif_var(&entry->cif, FFI_DEFAULT_ABI, nfixedargs, nargs, ret_ffi_type,
+                         entry->arg_types) != FFI_OK) {
+        free(entry);
+        return NULL;
+    }
+
+    EspbVarCif *head = __atomic_load_n(bucket, __ATOMIC_ACQUIRE);
+    do {
+        EspbVarCif *found = var_cif_find(head, hash, import_idx, nfixedargs, nargs, ret_ffi_type, arg_types);
+        if (found) {
+            free(entry);
+            return &found->cif;
+        }
+        entry->next = head;
+    } while (!__atomic_compare_exchange_n(bucket, &head, entry, false, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE));
+
+    __atomic_add_fetch(&((EspbInstance *)instance)->var_cif_count, 1, __ATOMIC_RELAXED);
+    return &entry->cif;
+}
+
+ffi_cif *espb_runtime_var_cif(const EspbInstance *instance,
+                              uint16_t import_idx,
+                              uint32_t nfixedargs,
+                              uint32_t nargs,
+                              ffi_type *ret_ffi_type,
+                              ffi_type **arg_types)
+{
+    if (!instance->var_cifs || nargs > UINT16_MAX) return NULL;
+
+    uint32_t hash = var_cif_hash(import_idx, nfixedargs, nargs, ret_ffi_type, arg_types);
+    EspbVarCif **bucket = &instance->var_cifs[hash & (ESPB_VAR_CIF_BUCKETS - 1)];
+    EspbVarCif *e = var_cif_find(__atomic_load_n(bucket, __ATOMIC_ACQUIRE), hash, import_idx, nfixedargs,
+                                 nargs, ret_ffi_type, arg_types);
+    if (e) return &e->cif;
+    return var_cif_insert(instance, bucket, hash, import_idx, nfixedargs, nargs, ret_ffi_type, arg_types);
+}
+
+EspbResult espb_runtime_var_cifs_init(EspbInstance *instance) {
+    instance->var_cif_count = 0;
+    instance->var_cifs = (EspbVarCif **)calloc(ESPB_VAR_CIF_BUCKETS, sizeof(EspbVarCif *));
+    return instance->var_cifs ? ESPB_OK : ESPB_ERR_MEMORY_ALLOC;
+}
+
+void espb_runtime_var_cifs_free(EspbInstance *instance) {
+    if (!instance->var_cifs) return;
+    for (uint32_t i = 0; i < ESPB_VAR_CIF_BUCKETS; i++) {
+        EspbVarCif *e = instance->var_cifs[i];
+        while (e) {
+            EspbVarCif *next = e->next;
+            free(e);
+            e = next;
+        }
+    }
+    free(instance->var_cifs);
+    instance->var_cifs = NULL;
+    instance->var_cif_count = 0;
+}
+
+size_t espb_runtime_var_cifs_bytes(const EspbInstance *instance) {
+    if (!instance->var_cifs) return 0;
+    size_t bytes = ESPB_VAR_CIF_BUCKETS * sizeof(EspbVarCif *);
+    for (uint32_t i = 0; i < ESPB_VAR_CIF_BUCKETS; i++) {
+        for (const EspbVarCif *e = instance->var_cifs[i]; e; e = e->next) {
+            bytes += sizeof(EspbVarCif) + e->nargs * sizeof(ffi_type *);
+        }
+    }
+    return bytes;
+}
@@ -0,0 +1,390 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "espb_sampler.h"
+#include "espb_api.h"
+#include "espb_interpreter_runtime_oc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if CONFIG_ESPB_SAMPLER
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#if defined(__XTENSA__)
+#include "xtensa_context.h"
+#elif defined(__riscv)
+#include "riscv/rvruntime-frames.h"
+#endif
+
+static const char *TAG = "espb_sampler";
+
+// Ключ гистограммы смещений: локальный индекс + 1 и вид отсчёта; 0 - свободный слот
+#define SAMPLE_KEY_JIT      0x80000000u  // offset - смещение байт-кода из карты JIT-кода
+#define SAMPLE_KEY_THREADED 0x40000000u  // offset - смещение в прошитом потоке
+#define SAMPLE_KEY_FUNC     0x0000FFFFu
+
+typedef struct {
+    uint32_t key;
+    uint32_t offset;
+    uint32_t count;
+} SamplerOffsetSlot;
+
+typedef struct {
+    uint32_t hash;                  // 0 - свободный слот
+    uint32_t count;
+    uint8_t depth;
+    bool jit;                       // Вершина исполнялась JIT-кодом (стек под ней не известен)
+    uint16_t frames[ESPB_SAMPLER_MAX_DEPTH]; // Локальные индексы, от корня к вершине
+} SamplerStack;
+
+struct EspbSampler {
+    EspbInstance *instance;
+    esp_timer_handle_t timer;
+    TaskHandle_t task;
+    bool stopping;                  // Остановка: колбэк таймера больше не трогает инстанс
+    uint32_t in_callback;           // Колбэк таймера исполняется
+    uint8_t busy;                   // Таблицы пишут таймер и интерпретатор: занято - отсчёт теряется
+    uint32_t samples, jit, interp, idle, missed, dropped;
+    uint32_t num_functions;
+    uint32_t *func_interp;          // [num_functions]
+    uint32_t *func_jit;             // [num_functions]
+    SamplerOffsetSlot offsets[CONFIG_ESPB_SAMPLER_SLOTS];
+    SamplerStack stacks[CONFIG_ESPB_SAMPLER_STACKS];
+};
+
+// Сохранённый PC вытесненной задачи: pxTopOfStack (первое поле TCB) указывает на кадр
+// контекста, записанный при переключении
+static uintptr_t sampler_saved_pc(TaskHandle_t task) {
+#if defined(__XTENSA__)
+    const XtExcFrame *frame = *(const XtExcFrame *const *)task; // XtSolFrame хранит pc там же
+    return frame ? (uintptr_t)frame->pc : 0;
+#elif defined(__riscv)
+    const RvExcFrame *frame = *(const RvExcFrame *const *)task;
+    return frame ? (uintptr_t)frame->mepc : 0;
+#else
+    (void)task;
+    return 0;
+#endif
+}
+
+static bool sampler_resolve_jit_pc(const EspbInstance *instance, uintptr_t pc, uint32_t *out_local,
+                                   uint32_t *out_offset) {
+    const EspbModule *module = instance->module;
+    for (uint32_t i = 0; i < module->num_functions; i++) {
+        const EspbFunctionBody *body = &module->function_bodies[i];
+        uintptr_t code = (uintptr_t)__atomic_load_n(&body->jit_code, __ATOMIC_ACQUIRE);
+        if (!code || pc < code || pc - code >= body->jit_code_size) continue;
+        const EspbJitPcMap *map = __atomic_load_n(&body->jit_pc_map, __ATOMIC_ACQUIRE);
+        *out_local = i;
+        *out_offset = map ? espb_jit_pc_map_lookup(map, (uint32_t)(pc - code)) : ESPB_SAMPLE_OFFSET_UNKNOWN;
+        return true;
+    }
+    return false;
+}
+
+static void sampler_add_offset(EspbSampler *s, uint32_t key, uint32_t offset) {
+    uint32_t h = ((key * 2654435761u) ^ (offset * 40503u)) % CONFIG_ESPB_SAMPLER_SLOTS;
+    for (uint32_t probe = 0; probe < CONFIG_ESPB_SAMPLER_SLOTS; probe++) {
+        SamplerOffsetSlot *slot = &s->offsets[(h + probe) % CONFIG_ESPB_SAMPLER_SLOTS];
+        if (slot->key == 0) {
+            slot->key = key;
+            slot->offset = offset;
+        }
+        if (slot->key == key && slot->offset == offset) {
+            slot->count++;
+            return;
+        }
+    }
+    s->dropped++;
+}
+
+static void sampler_add_stack(EspbSampler *s, const uint16_t *frames, uint8_t depth, bool jit) {
+    uint32_t hash = 2166136261u ^ (jit ? 1u : 0u);
+    for (uint8_t i = 0; i < depth; i++) hash = (hash ^ frames[i]) * 16777619u;
+    if (hash == 0) hash = 1;
+    for (uint32_t probe = 0; probe < CONFIG_ESPB_SAMPLER_STACKS; probe++) {
+        SamplerStack *st = &s->stacks[(hash + probe) % CONFIG_ESPB_SAMPLER_STACKS];
+        if (st->hash == 0) {
+            st->hash = hash;
+            st->depth = depth;
+            st->jit = jit;
+            memcpy(st->frames, frames, depth * sizeof(uint16_t));
+        }
+        if (st->hash == hash && st->depth == depth && st->jit == jit &&
+            memcmp(st->frames, frames, depth * sizeof(uint16_t)) == 0) {
+            st->count++;
+            return;
+        }
+    }
+    s->dropped++;
+}
+
+static void sampler_record(EspbSampler *s, uint32_t local_func_idx, uint32_t key_flags, uint32_t offset,
+                           const uint16_t *frames, uint8_t depth) {
+    if (local_func_idx >= s->num_functions) return;
+    bool jit = (key_flags & SAMPLE_KEY_JIT) != 0;
+    if (jit) s->func_jit[local_func_idx]++;
+    else s->func_interp[local_func_idx]++;
+
+    if (__atomic_exchange_n(&s->busy, 1, __ATOMIC_ACQUIRE)) {
+        s->dropped++;
+        return;
+    }
+    sampler_add_offset(s, (local_func_idx + 1) | key_flags, offset);
+    sampler_add_stack(s, frames, depth, jit);
+    __atomic_store_n(&s->busy, 0, __ATOMIC_RELEASE);
+}
+
+static void sampler_sample(EspbSampler *s) {
+    EspbInstance *instance = s->instance;
+    s->samples++;
+
+    eTaskState state = eTaskGetState(s->task);
+    if (state == eBlocked || state == eSuspended || state == eDeleted) {
+        s->idle++;
+        return;
+    }
+    if (state == eReady) {
+        uint32_t local, offset;
+        uintptr_t pc = sampler_saved_pc(s->task);
+        if (pc && sampler_resolve_jit_pc(instance, pc, &local, &offset)) {
+            uint16_t frame = (uint16_t)local;
+            sampler_record(s, local, SAMPLE_KEY_JIT, offset, &frame, 1);
+            s->jit++;
+            return;
+        }
+    }
+    // Интерпретатор, helper или код на другом ядре: отсчёт снимет ближайшая точка опроса
+    if (__atomic_exchange_n(&instance->sample_pending, 1, __ATOMIC_RELAXED)) s->missed++;
+}
+
+static void sampler_timer_cb(void *arg) {
+    EspbSampler *s = (EspbSampler *)arg;
+    __atomic_add_fetch(&s->in_callback, 1, __ATOMIC_ACQ_REL);
+    if (!__atomic_load_n(&s->stopping, __ATOMIC_ACQUIRE)) sampler_sample(s);
+    __atomic_sub_fetch(&s->in_callback, 1, __ATOMIC_ACQ_REL);
+}
+
+__attribute__((noinline, cold))
+void espb_sampler_take(EspbInstance *instance, ExecutionContext *exec_ctx, uint32_t local_func_idx,
+                       uint32_t offset, bool threaded) {
+    __atomic_store_n(&instance->sample_pending, 0, __ATOMIC_RELAXED);
+    EspbSampler *s = instance->sampler;
+    if (!s) return;
+
+    // Кадр k >= 1 хранит вызывающую функцию; базовый кадр 0 - точку входа, она же
+    // вызывающая кадра 1. Сохраняются ближайшие к вершине ESPB_SAMPLER_MAX_DEPTH функций.
+    uint16_t frames[ESPB_SAMPLER_MAX_DEPTH];
+    int top = exec_ctx->call_stack_top;
+    int first = top - (ESPB_SAMPLER_MAX_DEPTH - 1);
+    if (first < 1) first = 1;
+    uint8_t depth = 0;
+    for (int k = first; k < top; k++) frames[depth++] = (uint16_t)exec_ctx->call_stack[k].caller_local_func_idx;
+    frames[depth++] = (uint16_t)local_func_idx;
+
+    sampler_record(s, local_func_idx, threaded ? SAMPLE_KEY_THREADED : 0, offset, frames, depth);
+    s->interp++;
+}
+
+static EspbResult sampler_start_timer(EspbSampler *s, uint32_t period_us) {
+    const esp_timer_create_args_t args = {
+        .callback = sampler_timer_cb,
+        .arg = s,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "espb_sampler",
+        .skip_unhandled_events = true,
+    };
+    if (period_us == 0) period_us = CONFIG_ESPB_SAMPLER_PERIOD_US;
+    __atomic_store_n(&s->stopping, false, __ATOMIC_RELEASE);
+    if (esp_timer_create(&args, &s->timer) != ESP_OK) {
+        s->timer = NULL;
+        return ESPB_ERR_MEMORY_ALLOC;
+    }
+    if (esp_timer_start_periodic(s->timer, period_us) != ESP_OK) {
+        esp_timer_delete(s->timer);
+        s->timer = NULL;
+        return ESPB_ERR_INVALID_STATE;
+    }
+    ESP_LOGI(TAG, "Sampling every %u us", (unsigned)period_us);
+    return ESPB_OK;
+}
+
+EspbResult espb_sampler_start_instance(EspbInstance *instance, TaskHandle_t task, uint32_t period_us) {
+    EspbSampler *s = instance->sampler;
+    if (s) {
+        // Повторный запуск после espb_sampler_stop продолжает накопление
+        if (s->timer) return ESPB_ERR_INVALID_STATE;
+        s->task = task ? task : xTaskGetCurrentTaskHandle();
+        return sampler_start_timer(s, period_us);
+    }
+    if (instance->module->num_functions > SAMPLE_KEY_FUNC) return ESPB_ERR_UNSUPPORTED;
+
+    s = (EspbSampler *)calloc(1, sizeof(EspbSampler));
+    if (!s) return ESPB_ERR_MEMORY_ALLOC;
+    s->instance = instance;
+    s->task = task ? task : xTaskGetCurrentTaskHandle();
+    s->num_functions = instance->module->num_functions;
+    s->func_interp = (uint32_t *)calloc(s->num_functions ? s->num_functions : 1, sizeof(uint32_t));
+    s->func_jit = (uint32_t *)calloc(s->num_functions ? s->num_functions : 1, sizeof(uint32_t));
+    EspbResult res = ESPB_ERR_MEMORY_ALLOC;
+    if (!s->func_interp || !s->func_jit) goto fail;
+
+    // Инстанс видит сэмплер до первого срабатывания таймера
+    instance->sampler = s;
+    res = sampler_start_timer(s, period_us);
+    if (res != ESPB_OK) {
+        instance->sampler = NULL;
+        goto fail;
+    }
+    return ESPB_OK;
+
+fail:
+    free(s->func_interp);
+    free(s->func_jit);
+    free(s);
+    return res;
+}
+
+EspbResult espb_sampler_stop_instance(EspbInstance *instance) {
+    EspbSampler *s = instance->sampler;
+    if (!s) return ESPB_ERR_INVALID_STATE;
+    if (s->timer) {
+        __atomic_store_n(&s->stopping, true, __ATOMIC_RELEASE);
+        esp_timer_stop(s->timer);
+        esp_timer_delete(s->timer);
+        s->timer = NULL;
+        // esp_timer_stop не ждёт уже начатый колбэк; задача esp_timer приоритетнее
+        // пользовательских, поэтому за тик он завершается
+        do {
+            vTaskDelay(1);
+        } while (__atomic_load_n(&s->in_callback, __ATOMIC_ACQUIRE) != 0);
+    }
+    __atomic_store_n(&instance->sample_pending, 0, __ATOMIC_RELAXED);
+    return ESPB_OK;
+}
+
+void espb_sampler_free(EspbInstance *instance) {
+    if (!instance || !instance->sampler) return;
+    espb_sampler_stop_instance(instance);
+    EspbSampler *s = instance->sampler;
+    instance->sampler = NULL;
+    free(s->func_interp);
+    free(s->func_jit);
+    free(s);
+}
+
+void espb_sampler_clear(EspbSampler *s) {
+    while (__atomic_exchange_n(&s->busy, 1, __ATOMIC_ACQUIRE)) {
+        vTaskDelay(1);
+    }
+    s->samples = s->jit = s->interp = s->idle = s->missed = s->dropped = 0;
+    memset(s->func_interp, 0, s->num_functions * sizeof(uint32_t));
+    memset(s->func_jit, 0, s->num_functions * sizeof(uint32_t));
+    memset(s->offsets, 0, sizeof(s->offsets));
+    memset(s->stacks, 0, sizeof(s->stacks));
+    __atomic_store_n(&s->busy, 0, __ATOMIC_RELEASE);
+}
+
+EspbResult espb_sampler_read_totals(const EspbSampler *s, espb_sampler_totals_t *totals, espb_sample_func_t *funcs,
+                                    uint32_t max_funcs, uint32_t *out_num_funcs) {
+    if (totals) {
+        totals->samples = s->samples;
+        totals->jit = s->jit;
+        totals->interp = s->interp;
+        totals->idle = s->idle;
+        totals->missed = s->missed;
+        totals->dropped = s->dropped;
+    }
+    uint32_t num_imported = s->instance->module->num_imported_funcs;
+    for (uint32_t i = 0; funcs && i < s->num_functions && i < max_funcs; i++) {
+        funcs[i].func = i + num_imported;
+        funcs[i].interp_samples = s->func_interp[i];
+        funcs[i].jit_samples = s->func_jit[i];
+    }
+    if (out_num_funcs) *out_num_funcs = s->num_functions;
+    return ESPB_OK;
+}
+
+EspbResult espb_sampler_read_offsets(const EspbSampler *s, espb_sample_offset_t *out, uint32_t max_entries,
+                                     uint32_t *out_num_entries) {
+    const EspbModule *module = s->instance->module;
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < CONFIG_ESPB_SAMPLER_SLOTS; i++) {
+        const SamplerOffsetSlot *slot = &s->offsets[i];
+        if (slot->key == 0 || slot->count == 0) continue;
+        if (out && n < max_entries) {
+            uint32_t local = (slot->key & SAMPLE_KEY_FUNC) - 1;
+            uint32_t offset = slot->offset;
+#if CONFIG_ESPB_THREADED_CODE
+            if ((slot->key & SAMPLE_KEY_THREADED) &&
+                !espb_interpreter_bytecode_offset(&module->function_bodies[local], offset, &offset)) {
+                offset = ESPB_SAMPLE_OFFSET_UNKNOWN;
+            }
+#endif
+            out[n].func = local + module->num_imported_funcs;
+            out[n].bc_offset = offset;
+            out[n].samples = slot->count;
+            out[n].jit = (slot->key & SAMPLE_KEY_JIT) != 0;
+        }
+        n++;
+    }
+    if (out_num_entries) *out_num_entries = n;
+    return ESPB_OK;
+}
+
+// Имя функции для свёрнутых стеков: имя экспорта или func_<глобальный индекс>
+static void sampler_write_name(const EspbModule *module, uint32_t local, espb_sampler_write_t write, void *user_data) {
+    for (uint32_t e = 0; e < module->num_exports; e++) {
+        if (module->exports[e].kind == ESPB_IMPORT_KIND_FUNC && module->exports[e].index == local) {
+            write(module->exports[e].name, strlen(module->exports[e].name), user_data);
+            return;
+        }
+    }
+    char buf[24];
+    int len = snprintf(buf, sizeof(buf), "func_%u", (unsigned)(local + module->num_imported_funcs));
+    write(buf, (size_t)len, user_data);
+}
+
+EspbResult espb_sampler_write_folded_stacks(const EspbSampler *s, espb_sampler_write_t write, void *user_data) {
+    const EspbModule *module = s->instance->module;
+    for (uint32_t i = 0; i < CONFIG_ESPB_SAMPLER_STACKS; i++) {
+        const SamplerStack *st = &s->stacks[i];
+        if (st->hash == 0 || st->count == 0) continue;
+        for (uint8_t f = 0; f < st->depth; f++) {
+            if (f > 0) write(";", 1, user_data);
+            sampler_write_name(module, st->frames[f], write, user_data);
+        }
+        // Суффикс JIT-кадра, как у async-profiler
+        if (st->jit) write("_[j]", 4, user_data);
+        char buf[16];
+        int len = snprintf(buf, sizeof(buf), " %u\n", (unsigned)st->count);
+        write(buf, (size_t)len, user_data);
+    }
+    return ESPB_OK;
+}
+
+#else
+
+void espb_sampler_free(EspbInstance *instance) {
+    (void)instance;
+}
+
+#endif // CONFIG_ESPB_SAMPLER
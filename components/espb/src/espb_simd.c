@@ -0,0 +1,414 @@
+﻿/*
+ * espb component
+ * Copyright (C) 2025 Smersh
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+#include "espb_simd.h"
+#include "espb_sandbox.h" // CONFIG_ESPB_SANDBOX_MASKED
+
+#include <string.h>
+#include "esp_log.h"
+
+static const char *TAG = "espb_simd";
+
+#define V128_H8     0x8080808080808080ull  // Старшие биты дорожек i8
+#define V128_H16    0x8000800080008000ull  // Старшие биты дорожек i16
+
+static inline int32_t v128_sat_i8(int32_t v)  { return v > INT8_MAX ? INT8_MAX : (v < INT8_MIN ? INT8_MIN : v); }
+static inline int32_t v128_sat_i16(int32_t v) { return v > INT16_MAX ? INT16_MAX : (v < INT16_MIN ? INT16_MIN : v); }
+
+// --- Сложение/вычитание без насыщения: SWAR по 64-битным половинам ---
+
+static void v128_i8x16_add(EspbV128 *d, const EspbV128 *a, const EspbV128 *b) {
+    EspbV128 r;
+    for (int i = 0; i < 2; ++i) {
+        const uint64_t x = a->u64[i], y = b->u64[i];
+        r.u64[i] = ((x & ~V128_H8) + (y & ~V128_H8)) ^ ((x ^ y) & V128_H8);
+    }
+    *d = r;
+}
+
+static void v128_i8x16_sub(EspbV128 *d, const EspbV128 *a, const EspbV128 *b) {
+    EspbV128 r;
+    for (int i = 0; i < 2; ++i) {
+        const uint64_t x = a->u64[i], y = b->u64[i];
+        r.u64[i] = ((x | V128_H8) - (y & ~V128_H8)) ^ ((x ^ ~y) & V128_H8);
+    }
+    *d = r;
+}
+
+static void v128_i16x8_add(EspbV128 *d, const EspbV128 *a, const EspbV128 *b) {
+    EspbV128 r;
+    for (int i = 0; i < 2; ++i) {
+        const uint64_t x = a->u64[i], y = b->u64[i];
+        r.u64[i] = ((x & ~V128_H16) + (y & ~V128_H16)) ^ ((x ^ y) & V128_H16);
+    }
+    *d = r;
+}
+
+static void v128_i16x8_sub(EspbV128 *d, const EspbV128 *a, const EspbV128 *b) {
+    EspbV128 r;
+    for (int i = 0; i < 2; ++i) {
+        const uint64_t x = a->u64[i], y = b->u64[i];
+        r.u64[i] = ((x | V128_H16) - (y & ~V128_H16)) ^ ((x ^ ~y) & V128_H16);
+    }
+    *d = r;
+}
+
+// --- Поэлементные операции ---
+
+#define V128_LANEWISE(name, field, lanes, expr)                                  \
+    static void name(EspbV128 *d, const EspbV128 *a, const EspbV128 *b) {       \
+        EspbV128 r;                                                             \
+        for (int i = 0; i < (lanes); ++i) {                                     \
+            const __typeof__(a->field[0]) x = a->field[i], y = b->field[i];     \
+            r.field[i] = (expr);                                                \
+        }                                                                       \
+        *d = r;                                                                 \
+    }
+
+V128_LANEWISE(v128_i8x16_add_sat_s, i8, 16, (int8_t)v128_sat_i8((int32_t)x + y))
+V128_LANEWISE(v128_i8x16_sub_sat_s, i8, 16, (int8_t)v128_sat_i8((int32_t)x - y))
+V128_LANEWISE(v128_i8x16_min_s, i8, 16, x < y ? x : y)
+V128_LANEWISE(v128_i8x16_max_s, i8, 16, x > y ? x : y)
+V128_LANEWISE(v128_i8x16_min_u, u8, 16, x < y ? x : y)
+V128_LANEWISE(v128_i8x16_max_u, u8, 16, x > y ? x : y)
+
+V128_LANEWISE(v128_i16x8_add_sat_s, i16, 8, (int16_t)v128_sat_i16((int32_t)x + y))
+V128_LANEWISE(v128_i16x8_sub_sat_s, i16, 8, (int16_t)v128_sat_i16((int32_t)x - y))
+V128_LANEWISE(v128_i16x8_min_s, i16, 8, x < y ? x : y)
+V128_LANEWISE(v128_i16x8_max_s, i16, 8, x > y ? x : y)
+V128_LANEWISE(v128_i16x8_mul, u16, 8, (uint16_t)((uint32_t)x * y))
+V128_LANEWISE(v128_i16x8_q15mulr_sat_s, i16, 8, (int16_t)v128_sat_i16(((int32_t)x * y + 0x4000) >> 15))
+
+V128_LANEWISE(v128_i32x4_add, u32, 4, x + y)
+V128_LANEWISE(v128_i32x4_sub, u32, 4, x - y)
+V128_LANEWISE(v128_i32x4_mul, u32, 4, x * y)
+V128_LANEWISE(v128_i32x4_min_s, i32, 4, x < y ? x : y)
+V128_LANEWISE(v128_i32x4_max_s, i32, 4, x > y ? x : y)
+
+V128_LANEWISE(v128_f32x4_add, f32, 4, x + y)
+V128_LANEWISE(v128_f32x4_sub, f32, 4, x - y)
+V128_LANEWISE(v128_f32x4_mul, f32, 4, x * y)
+
+// MIN/MAX.F32 по дорожкам: NaN распространяется, -0 меньше +0.
+static void v128_f32x4_minmax(EspbV128 *d, const EspbV128 *a, const EspbV128 *b, bool is_max) {
+    EspbV128 r;
+    for (int i = 0; i < 4; ++i) {
+        const float x = a->f32[i], y = b->f32[i];
+        if (x != x || y != y) {
+            r.f32[i] = x + y;
+        } else if (x == y) {
+            r.u32[i] = is_max ? (a->u32[i] & b->u32[i]) : (a->u32[i] | b->u32[i]);
+        } else {
+            r.f32[i] = ((x < y) != is_max) ? x : y;
+        }
+    }
+    *d = r;
+}
+
+static void v128_f32x4_min(EspbV128 *d, const EspbV128 *a, const EspbV128 *b) { v128_f32x4_minmax(d, a, b, false); }
+static void v128_f32x4_max(EspbV128 *d, const EspbV128 *a, const EspbV128 *b) { v128_f32x4_minmax(d, a, b, true); }
+
+V128_LANEWISE(v128_and, u64, 2, x & y)
+V128_LANEWISE(v128_or, u64, 2, x | y)
+V128_LANEWISE(v128_xor, u64, 2, x ^ y)
+V128_LANEWISE(v128_andnot, u64, 2, x & ~y)
+
+static void v128_not(EspbV128 *d, const EspbV128 *a, const EspbV128 *b) {
+    (void)b;
+    const uint64_t lo = a->u64[0], hi = a->u64[1];
+    d->u64[0] = ~lo;
+    d->u64[1] = ~hi;
+}
+
+#if CONFIG_ESPB_SIMD_PIE
+/*
+ * PIE ESP32-S3: 128-битные регистры q0..q7. ee.vld/ee.vst игнорируют младшие 4 бита
+ * адреса, а регистры ESPB выровнены только на 8, поэтому операнды проходят через
+ * выровненные копии. Выигрыш есть для дорожек i8/i16 с насыщением и min/max, где
+ * скалярный код проверяет каждую дорожку; остальное дешевле без копий.
+ * На ESP32-P4 те же инструкции Xesppie имеют префикс esp., а сложение и вычитание
+ * насыщают без суффикса s.
+ */
+#if CONFIG_IDF_TARGET_ESP32P4
+#define V128_PIE(s3, p4)  p4
+#else
+#define V128_PIE(s3, p4)  s3
+#endif
+
+#define V128_PIE_OP(name, insn)                                                     \
+    static void name(EspbV128 *d, const EspbV128 *a, const EspbV128 *b) {           \
+        EspbV128 ta __attribute__((aligned(16))) = *a;                              \
+        EspbV128 tb __attribute__((aligned(16))) = *b;                              \
+        EspbV128 td __attribute__((aligned(16)));                                   \
+        __asm__ volatile(V128_PIE("ee", "esp") ".vld.128.ip q0, %[pa], 0\n"         \
+                         V128_PIE("ee", "esp") ".vld.128.ip q1, %[pb], 0\n"         \
+                         insn " q2, q0, q1\n"                                       \
+                         V128_PIE("ee", "esp") ".vst.128.ip q2, %[pd], 0\n"         \
+                         :                                                          \
+                         : [pa] "r"(&ta), [pb] "r"(&tb), [pd] "r"(&td)              \
+                         : "memory");                                               \
+        *d = td;                                                                    \
+    }
+
+V128_PIE_OP(v128_pie_i8x16_add_sat_s, V128_PIE("ee.vadds.s8", "esp.vadd.s8"))
+V128_PIE_OP(v128_pie_i8x16_sub_sat_s, V128_PIE("ee.vsubs.s8", "esp.vsub.s8"))
+V128_PIE_OP(v128_pie_i8x16_min_s, V128_PIE("ee.vmin.s8", "esp.vmin.s8"))
+V128_PIE_OP(v128_pie_i8x16_max_s, V128_PIE("ee.vmax.s8", "esp.vmax.s8"))
+V128_PIE_OP(v128_pie_i16x8_add_sat_s, V128_PIE("ee.vadds.s16", "esp.vadd.s16"))
+V128_PIE_OP(v128_pie_i16x8_sub_sat_s, V128_PIE("ee.vsubs.s16", "esp.vsub.s16"))
+V128_PIE_OP(v128_pie_i16x8_min_s, V128_PIE("ee.vmin.s16", "esp.vmin.s16"))
+V128_PIE_OP(v128_pie_i16x8_max_s, V128_PIE("ee.vmax.s16", "esp.vmax.s16"))
+
+#define V128_OP_SAT(scalar, pie)  pie
+#else
+#define V128_OP_SAT(scalar, pie)  scalar
+#endif // CONFIG_ESPB_SIMD_PIE
+
+static const EspbV128Op s_v128_ops[ESPB_V128_ANDNOT + 1] = {
+    [ESPB_V128_NOT]                 = v128_not,
+    [ESPB_V128_I8X16_ADD]           = v128_i8x16_add,
+    [ESPB_V128_I8X16_SUB]           = v128_i8x16_sub,
+    [ESPB_V128_I8X16_ADD_SAT_S]     = V128_OP_SAT(v128_i8x16_add_sat_s, v128_pie_i8x16_add_sat_s),
+    [ESPB_V128_I8X16_SUB_SAT_S]     = V128_OP_SAT(v128_i8x16_sub_sat_s, v128_pie_i8x16_sub_sat_s),
+    [ESPB_V128_I8X16_MIN_S]         = V128_OP_SAT(v128_i8x16_min_s, v128_pie_i8x16_min_s),
+    [ESPB_V128_I8X16_MAX_S]         = V128_OP_SAT(v128_i8x16_max_s, v128_pie_i8x16_max_s),
+    [ESPB_V128_I8X16_MIN_U]         = v128_i8x16_min_u,
+    [ESPB_V128_I8X16_MAX_U]         = v128_i8x16_max_u,
+    [ESPB_V128_I16X8_ADD]           = v128_i16x8_add,
+    [ESPB_V128_I16X8_SUB]           = v128_i16x8_sub,
+    [ESPB_V128_I16X8_ADD_SAT_S]     = V128_OP_SAT(v128_i16x8_add_sat_s, v128_pie_i16x8_add_sat_s),
+    [ESPB_V128_I16X8_SUB_SAT_S]     = V128_OP_SAT(v128_i16x8_sub_sat_s, v128_pie_i16x8_sub_sat_s),
+    [ESPB_V128_I16X8_MIN_S]         = V128_OP_SAT(v128_i16x8_min_s, v128_pie_i16x8_min_s),
+    [ESPB_V128_I16X8_MAX_S]         = V128_OP_SAT(v128_i16x8_max_s, v128_pie_i16x8_max_s),
+    [ESPB_V128_I16X8_MUL]           = v128_i16x8_mul,
+    [ESPB_V128_I16X8_Q15MULR_SAT_S] = v128_i16x8_q15mulr_sat_s,
+    [ESPB_V128_I32X4_ADD]           = v128_i32x4_add,
+    [ESPB_V128_I32X4_SUB]           = v128_i32x4_sub,
+    [ESPB_V128_I32X4_MUL]           = v128_i32x4_mul,
+    [ESPB_V128_I32X4_MIN_S]         = v128_i32x4_min_s,
+    [ESPB_V128_I32X4_MAX_S]         = v128_i32x4_max_s,
+    [ESPB_V128_F32X4_ADD]           = v128_f32x4_add,
+    [ESPB_V128_F32X4_SUB]           = v128_f32x4_sub,
+    [ESPB_V128_F32X4_MUL]           = v128_f32x4_mul,
+    [ESPB_V128_F32X4_MIN]           = v128_f32x4_min,
+    [ESPB_V128_F32X4_MAX]           = v128_f32x4_max,
+    [ESPB_V128_AND]                 = v128_and,
+    [ESPB_V128_OR]                  = v128_or,
+    [ESPB_V128_XOR]                 = v128_xor,
+    [ESPB_V128_ANDNOT]              = v128_andnot,
+};
+
+EspbV128Op espb_v128_op(uint8_t sub_op) {
+    return sub_op < sizeof(s_v128_ops) / sizeof(s_v128_ops[0]) ? s_v128_ops[sub_op] : NULL;
+}
+
+// --- SPLAT ---
+
+static void v128_splat_u64(EspbV128 *d, uint64_t pattern) {
+    d->u64[0] = pattern;
+    d->u64[1] = pattern;
+}
+
+static void v128_i8x16_splat(EspbV128 *d, uint32_t x)  { v128_splat_u64(d, 0x0101010101010101ull * (uint8_t)x); }
+static void v128_i16x8_splat(EspbV128 *d, uint32_t x)  { v128_splat_u64(d, 0x0001000100010001ull * (uint16_t)x); }
+static void v128_i32x4_splat(EspbV128 *d, uint32_t x)  { v128_splat_u64(d, 0x0000000100000001ull * x); }
+
+EspbV128SplatOp espb_v128_splat_op(uint8_t sub_op) {
+    switch (sub_op) {
+        case ESPB_V128_I8X16_SPLAT: return v128_i8x16_splat;
+        case ESPB_V128_I16X8_SPLAT: return v128_i16x8_splat;
+        case ESPB_V128_I32X4_SPLAT: return v128_i32x4_splat;
+        default:                    return NULL;
+    }
+}
+
+// --- Память и перестановки ---
+
+void espb_v128_load(EspbV128 *d, const void *addr) {
+    memcpy(d, addr, sizeof(*d));
+}
+
+void espb_v128_store(const EspbV128 *s, void *addr) {
+    memcpy(addr, s, sizeof(*s));
+}
+
+void espb_v128_shuffle(EspbV128 *d, const EspbV128 *a, const EspbV128 *b, const uint8_t lanes[16]) {
+    uint8_t src[32];
+    memcpy(src, a, 16);
+    memcpy(src + 16, b, 16);
+    for (int i = 0; i < 16; ++i) d->u8[i] = src[lanes[i] & 31];
+}
+
+void espb_v128_shuffle_pack(const uint8_t lanes[16], uint32_t w[3]) {
+    w[0] = w[1] = w[2] = 0;
+    for (int i = 0; i < 16; ++i) w[i / 6] |= (uint32_t)(lanes[i] & 31) << ((i % 6) * 5);
+}
+
+void espb_v128_shuffle_packed(EspbV128 *d, const EspbV128 *a, const EspbV128 *b,
+                              uint32_t w0, uint32_t w1, uint32_t w2) {
+    const uint32_t w[3] = { w0, w1, w2 };
+    uint8_t lanes[16];
+    for (int i = 0; i < 16; ++i) lanes[i] = (uint8_t)((w[i / 6] >> ((i % 6) * 5)) & 31);
+    espb_v128_shuffle(d, a, b, lanes);
+}
+
+// --- Интерпретатор ---
+
+size_t espb_v128_operand_len(uint8_t sub_op) {
+    switch (sub_op) {
+        case ESPB_V128_LOAD:
+        case ESPB_V128_STORE:                return 1 + 1 + 2;  // V, Ra, offset(i16)
+        case ESPB_V128_CONST:                return 1 + 16;     // Vd, imm[16]
+        case ESPB_V128_I8X16_SPLAT:
+        case ESPB_V128_I16X8_SPLAT:
+        case ESPB_V128_I32X4_SPLAT:          return 2;          // Vd, Rs
+        case ESPB_V128_I16X8_EXTRACT_LANE_S:
+        case ESPB_V128_I32X4_EXTRACT_LANE:   return 3;          // Rd, Vs, lane
+        case ESPB_V128_I32X4_REPLACE_LANE:   return 4;          // Vd, Va, Rs, lane
+        case ESPB_V128_I8X16_SHUFFLE:        return 3 + 16;     // Vd, Va, Vb, lanes[16]
+        default:
+            if (!espb_v128_op(sub_op)) return 0;
+            return espb_v128_is_unary(sub_op) ? 2 : 3;
+    }
+}
+
+uint32_t espb_v128_reads(uint8_t sub_op, const uint8_t *a, uint8_t out[ESPB_V128_MAX_READS]) {
+    uint32_t n = 0;
+#define V128_READ_PAIR(r) do { out[n++] = (r); out[n++] = (uint8_t)((r) + 1); } while (0)
+    switch (sub_op) {
+        case ESPB_V128_LOAD:                 out[n++] = a[1]; break;
+        case ESPB_V128_STORE:                V128_READ_PAIR(a[0]); out[n++] = a[1]; break;
+        case ESPB_V128_CONST:                break;
+        case ESPB_V128_I8X16_SPLAT:
+        case ESPB_V128_I16X8_SPLAT:
+        case ESPB_V128_I32X4_SPLAT:          out[n++] = a[1]; break;
+        case ESPB_V128_I16X8_EXTRACT_LANE_S:
+        case ESPB_V128_I32X4_EXTRACT_LANE:   V128_READ_PAIR(a[1]); break;
+        case ESPB_V128_I32X4_REPLACE_LANE:   V128_READ_PAIR(a[1]); out[n++] = a[2]; break;
+        case ESPB_V128_I8X16_SHUFFLE:        V128_READ_PAIR(a[1]); V128_READ_PAIR(a[2]); break;
+        default:
+            V128_READ_PAIR(a[1]);
+            if (!espb_v128_is_unary(sub_op)) V128_READ_PAIR(a[2]);
+            break;
+    }
+#undef V128_READ_PAIR
+    return n;
+}
+
+#if !CONFIG_ESPB_SANDBOX_MASKED
+// Адрес 16-байтного доступа V_PTR(ra) + offset; NULL - вне линейной памяти.
+static uint8_t *v128_mem_addr(EspbInstance *instance, const Value *ra, int16_t offset) {
+    uintptr_t base = (uintptr_t)instance->memory_data;
+    uintptr_t addr = (uintptr_t)V_PTR(*ra);
+    if (addr < base) return NULL;
+    int64_t tgt = (int64_t)(addr - base) + offset;
+    if (tgt < 0 || (uint64_t)tgt + sizeof(EspbV128) > instance->memory_size_bytes) return NULL;
+    return instance->memory_data + tgt;
+}
+#endif
+
+static __attribute__((noinline, cold)) EspbResult v128_invalid(const uint8_t *insn, EspbResult res) {
+    ESP_LOGE(TAG, "Invalid V128 instruction 0xFD 0x%02X: %d", insn[1], (int)res);
+    return res;
+}
+
+EspbResult espb_v128_execute(EspbInstance *instance, Value *locals, uint8_t max_reg_used,
+                             const uint8_t *insn, const uint8_t **next_pc) {
+    const uint8_t sub_op = insn[1];
+    const uint8_t *a = insn + 2;
+    const size_t len = espb_v128_operand_len(sub_op);
+    if (len == 0) return v128_invalid(insn, ESPB_ERR_UNKNOWN_OPCODE);
+    *next_pc = a + len;
+
+// Вектор занимает два регистра: второй тоже должен быть в кадре
+#define V128_REG(r) do { if ((uint32_t)(r) + 1u > max_reg_used) return v128_invalid(insn, ESPB_ERR_INVALID_REGISTER_INDEX); } while (0)
+
+    switch (sub_op) {
+        case ESPB_V128_LOAD:
+        case ESPB_V128_STORE: {
+            V128_REG(a[0]);
+            int16_t offset;
+            memcpy(&offset, a + 2, sizeof(offset));
+            EspbV128 *v = &V_V128(locals, a[0]);
+#if CONFIG_ESPB_SANDBOX_MASKED
+            // Запас за памятью - 8 байт, поэтому каждая половина маскируется отдельно
+            uint8_t *lo = espb_sandbox_addr(instance, V_PTR(locals[a[1]]), offset);
+            uint8_t *hi = espb_sandbox_addr(instance, V_PTR(locals[a[1]]), offset + 8);
+            if (sub_op == ESPB_V128_LOAD) {
+                memcpy(&v->u64[0], lo, 8);
+                memcpy(&v->u64[1], hi, 8);
+            } else {
+                memcpy(lo, &v->u64[0], 8);
+                memcpy(hi, &v->u64[1], 8);
+            }
+#else
+            uint8_t *p = v128_mem_addr(instance, &locals[a[1]], offset);
+            if (!p) return ESPB_ERR_MEMORY_ACCESS_OUT_OF_BOUNDS;
+            if (sub_op == ESPB_V128_LOAD) espb_v128_load(v, p);
+            else espb_v128_store(v, p);
+#endif
+            return ESPB_OK;
+        }
+        case ESPB_V128_CONST:
+            V128_REG(a[0]);
+            memcpy(&V_V128(locals, a[0]), a + 1, sizeof(EspbV128));
+            return ESPB_OK;
+        case ESPB_V128_I8X16_SPLAT:
+        case ESPB_V128_I16X8_SPLAT:
+        case ESPB_V128_I32X4_SPLAT:
+            V128_REG(a[0]);
+            espb_v128_splat_op(sub_op)(&V_V128(locals, a[0]), locals[a[1]].u32);
+            return ESPB_OK;
+        case ESPB_V128_I16X8_EXTRACT_LANE_S:
+            V128_REG(a[1]);
+            if (a[2] >= 8) return v128_invalid(insn, ESPB_ERR_INVALID_OPERAND);
+            V_I32(locals[a[0]]) = V_V128(locals, a[1]).i16[a[2]];
+            return ESPB_OK;
+        case ESPB_V128_I32X4_EXTRACT_LANE:
+            V128_REG(a[1]);
+            if (a[2] >= 4) return v128_invalid(insn, ESPB_ERR_INVALID_OPERAND);
+            V_I32(locals[a[0]]) = V_V128(locals, a[1]).i32[a[2]];
+            return ESPB_OK;
+        case ESPB_V128_I32X4_REPLACE_LANE: {
+            V128_REG(a[0]);
+            V128_REG(a[1]);
+            if (a[3] >= 4) return v128_invalid(insn, ESPB_ERR_INVALID_OPERAND);
+            const uint32_t x = locals[a[2]].u32;
+            memmove(&V_V128(locals, a[0]), &V_V128(locals, a[1]), sizeof(EspbV128));
+            V_V128(locals, a[0]).u32[a[3]] = x;
+            return ESPB_OK;
+        }
+        case ESPB_V128_I8X16_SHUFFLE:
+            V128_REG(a[0]);
+            V128_REG(a[1]);
+            V128_REG(a[2]);
+            for (int i = 0; i < 16; ++i) {
+                if (a[3 + i] >= 32) return v128_invalid(insn, ESPB_ERR_INVALID_OPERAND);
+            }
+            espb_v128_shuffle(&V_V128(locals, a[0]), &V_V128(locals, a[1]), &V_V128(locals, a[2]), a + 3);
+            return ESPB_OK;
+        default: {
+            const uint8_t vb = espb_v128_is_unary(sub_op) ? a[1] : a[2];
+            V128_REG(a[0]);
+            V128_REG(a[1]);
+            V128_REG(vb);
+            espb_v128_op(sub_op)(&V_V128(locals, a[0]), &V_V128(locals, a[1]), &V_V128(locals, vb));
+            return ESPB_OK;
+        }
+    }
+#undef V128_REG
+}
@@ -19,6 +19,7 @@
 // Пока не решена проблема с линковкой libffi
 
 #include "iram_pool.h"
+#include "espb_exec_memory.h"
 #include <stdio.h>
 
 // Простая заглушка для инициализации
@@ -29,6 +30,12 @@ void iram_pool_init_wrapper(void) {
     if (iram_pool_init) {
         iram_pool_init();
     }
+    // Замыкания libffi - из того же исполняемого региона, что и JIT-код
+    espb_exec_region_init();
+    extern void iram_pool_set_backend(void *(*alloc_fn)(size_t), void (*free_fn)(void *)) __attribute__((weak));
+    if (iram_pool_set_backend) {
+        iram_pool_set_backend(espb_exec_alloc, espb_exec_free);
+    }
 }
 
 // Простая заглушка для отладки
@@ -342,7 +342,10 @@ typedef struct {
   void *trampoline_table;
   void *trampoline_table_entry;
 #else
+  union {
     char tramp[FFI_TRAMPOLINE_SIZE];
+    void *ftramp;   /* Статический трамплин (CONFIG_LIBFFI_STATIC_TRAMPOLINES) */
+  };
 #endif
   ffi_cif   *cif;
   void     (*fun)(ffi_cif*,void*,void**,void*);
@@ -69,4 +69,13 @@ size_t iram_pool_get_used_size(void);
  */
 size_t iram_pool_get_free_size(void);
 
+/**
+ * @brief Подменяет источник исполняемой памяти пула.
+ *
+ * Среда исполнения (espb) передаёт сюда свой аллокатор, чтобы замыкания брались из
+ * того же зарезервированного региона, что и JIT-код. free_fn обязан принимать и блоки,
+ * выделенные до подмены (из heap_caps).
+ */
+void iram_pool_set_backend(void *(*alloc_fn)(size_t size), void (*free_fn)(void *ptr));
+
 #endif // IRAM_POOL_H 
\ No newline at end of file
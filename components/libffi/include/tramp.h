@@ -58,6 +58,8 @@ void *ffi_tramp_alloc (int flags);
 void ffi_tramp_set_parms (void *tramp, void *data, void *code);
 void *ffi_tramp_get_addr (void *tramp);
 void ffi_tramp_free (void *tramp);
+/* ESP: tramp - слот статической таблицы (а не код трамплина в closure->tramp) */
+int ffi_tramp_owns (void *tramp);
 
 #ifdef __cplusplus
 }
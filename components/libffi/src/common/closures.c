@@ -1077,8 +1077,10 @@ ffi_tramp_is_present (__attribute__((unused)) void *ptr)
 
 #include <stdlib.h>
 
-#if defined(ESP_PLATFORM) && defined(CONFIG_LIBFFI_USE_IRAM_POOL)
+#ifdef ESP_PLATFORM
 #include "sdkconfig.h"
+#endif
+#if defined(ESP_PLATFORM) && defined(CONFIG_LIBFFI_USE_IRAM_POOL)
 #include "iram_pool.h"
 #endif
 
@@ -1091,6 +1093,24 @@ ffi_closure_alloc (size_t size, void **code)
   if (!code)
     return NULL;
 
+#if defined(ESP_PLATFORM) && defined(CONFIG_LIBFFI_STATIC_TRAMPOLINES)
+  // Статический трамплин из таблицы в IRAM: сама closure - обычные данные,
+  // исполняемая память не выделяется. Таблица занята - трамплин в closure, как раньше.
+  void *ftramp = ffi_tramp_alloc (0);
+  if (ftramp)
+    {
+      closure = malloc (size);
+      if (!closure)
+        {
+          ffi_tramp_free (ftramp);
+          return NULL;
+        }
+      ((ffi_closure *)closure)->ftramp = ftramp;
+      *code = ffi_tramp_get_addr (ftramp);
+      return closure;
+    }
+#endif
+
   // Выделяем память под структуру ffi_closure
   // Для RISC-V: closure содержит tramp[24] + cif + fun + user_data
 #if defined(ESP_PLATFORM) && defined(CONFIG_LIBFFI_USE_IRAM_POOL)
@@ -1102,6 +1122,11 @@ ffi_closure_alloc (size_t size, void **code)
   if (!closure)
     return NULL;
 
+#if defined(ESP_PLATFORM) && defined(CONFIG_LIBFFI_STATIC_TRAMPOLINES)
+  // До ffi_prep_closure_loc первое слово tramp не должно походить на слот таблицы
+  ((ffi_closure *)closure)->ftramp = NULL;
+#endif
+
   // Для RISC-V: исполняемый код находится в начале структуры closure (tramp)
   *code = closure;  // code указывает на closure->tramp
 
@@ -1111,6 +1136,14 @@ ffi_closure_alloc (size_t size, void **code)
 void
 ffi_closure_free (void *ptr)
 {
+#if defined(ESP_PLATFORM) && defined(CONFIG_LIBFFI_STATIC_TRAMPOLINES)
+  if (ptr && ffi_tramp_is_present (ptr))
+    {
+      ffi_tramp_free (((ffi_closure *)ptr)->ftramp);
+      free (ptr);
+      return;
+    }
+#endif
 #if defined(ESP_PLATFORM) && defined(CONFIG_LIBFFI_USE_IRAM_POOL)
     iram_pool_free(ptr);
 #else
@@ -1127,7 +1160,11 @@ ffi_data_to_code_pointer (void *data)
 int
 ffi_tramp_is_present (__attribute__((unused)) void *ptr)
 {
+#if defined(ESP_PLATFORM) && defined(CONFIG_LIBFFI_STATIC_TRAMPOLINES)
+  return ffi_tramp_owns (((ffi_closure *)ptr)->ftramp);
+#else
   return 0;
+#endif
 }
 
 # endif /* ! FFI_MMAP_EXEC_WRIT */
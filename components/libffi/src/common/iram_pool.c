@@ -30,13 +30,21 @@
 
 static const char *TAG = "IRAM_POOL_SHIM";
 
+static void *(*s_backend_alloc)(size_t size);
+static void (*s_backend_free)(void *ptr);
+
+void iram_pool_set_backend(void *(*alloc_fn)(size_t size), void (*free_fn)(void *ptr)) {
+    s_backend_free = free_fn;
+    s_backend_alloc = alloc_fn;
+}
+
 void iram_pool_init(void) {
    ESP_LOGD(TAG, "Shim: iram_pool_init() called. Using heap_caps for executable memory.");
 }
 
 void* iram_pool_alloc(size_t size) {
    ESP_LOGD(TAG, "Shim: iram_pool_alloc(%d) -> heap_caps_malloc(MALLOC_CAP_EXEC)", size);
-    void* ptr = heap_caps_malloc(size, MALLOC_CAP_EXEC);
+    void* ptr = s_backend_alloc ? s_backend_alloc(size) : heap_caps_malloc(size, MALLOC_CAP_EXEC);
     if (!ptr) {
         ESP_LOGE(TAG, "heap_caps_malloc failed to allocate %d bytes of executable memory", size);
     } else {
@@ -47,7 +55,11 @@ void* iram_pool_alloc(size_t size) {
 
 void iram_pool_free(void* ptr) {
    ESP_LOGD(TAG, "Shim: iram_pool_free(%p)", ptr);
-    heap_caps_free(ptr);
+    if (s_backend_free) {
+        s_backend_free(ptr);
+    } else {
+        heap_caps_free(ptr);
+    }
 }
 
 void iram_pool_debug(void) {
@@ -48,6 +48,9 @@
    ----------------------------------------------------------------------- */
 
 #include <fficonfig.h>
+#ifdef ESP_PLATFORM
+#include "sdkconfig.h"
+#endif
 
 #ifdef FFI_EXEC_STATIC_TRAMP
 
@@ -702,6 +705,96 @@ ffi_tramp_free (void *arg)
 
 /* ------------------------------------------------------------------------- */
 
+#elif defined(ESP_PLATFORM) && defined(CONFIG_LIBFFI_STATIC_TRAMPOLINES)
+
+/* ------------------------------------------------------------------------- */
+/*
+ * Статические трамплины ESP (RISC-V).
+ *
+ * Таблица из CONFIG_LIBFFI_STATIC_TRAMPOLINE_COUNT трамплинов собирается на этапе
+ * сборки в IRAM (sysv_esp.S). Трамплин слота i берёт адрес обработчика и данные
+ * (closure) из ffi_esp_tramp_parms[i] в DRAM. Создание замыкания - выбор свободного
+ * слота в битовой карте и запись двух указателей: ни выделения исполняемой памяти,
+ * ни записи кода, ни синхронизации I-cache.
+ */
+
+#include <ffi.h>
+#include <ffi_common.h>
+#include <tramp.h>
+#include <stdint.h>
+
+#define ESP_TRAMP_COUNT  CONFIG_LIBFFI_STATIC_TRAMPOLINE_COUNT
+#define ESP_TRAMP_SIZE   20    /* auipc, addi, lw, lw, jr - без сжатых инструкций */
+#define ESP_TRAMP_WORDS  ((ESP_TRAMP_COUNT + 31) / 32)
+
+typedef struct {
+  void *target;
+  void *data;
+} esp_tramp_parms;
+
+/* Читается трамплинами из sysv_esp.S */
+esp_tramp_parms ffi_esp_tramp_parms[ESP_TRAMP_COUNT] FFI_HIDDEN;
+extern char ffi_esp_tramp_code[] FFI_HIDDEN;
+
+static uint32_t esp_tramp_used[ESP_TRAMP_WORDS];
+
+int
+ffi_tramp_is_supported(void)
+{
+  return 1;
+}
+
+void *
+ffi_tramp_alloc (int flags)
+{
+  (void)flags;
+  for (int w = 0; w < ESP_TRAMP_WORDS; w++)
+    {
+      uint32_t limit = (w == ESP_TRAMP_WORDS - 1 && (ESP_TRAMP_COUNT % 32))
+                       ? ((1u << (ESP_TRAMP_COUNT % 32)) - 1) : 0xFFFFFFFFu;
+      uint32_t used = __atomic_load_n (&esp_tramp_used[w], __ATOMIC_RELAXED);
+      while ((~used & limit) != 0)
+        {
+          uint32_t bit = (uint32_t)__builtin_ctz (~used & limit);
+          if (__atomic_compare_exchange_n (&esp_tramp_used[w], &used, used | (1u << bit),
+                                           0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            return &ffi_esp_tramp_parms[w * 32 + bit];
+        }
+    }
+  return NULL;
+}
+
+void
+ffi_tramp_set_parms (void *arg, void *target, void *data)
+{
+  esp_tramp_parms *parms = (esp_tramp_parms *)arg;
+  parms->target = target;
+  parms->data = data;
+  /* Трамплин читает параметры обычными загрузками: достаточно упорядочить запись */
+  __atomic_thread_fence (__ATOMIC_RELEASE);
+}
+
+void *
+ffi_tramp_get_addr (void *arg)
+{
+  size_t idx = (esp_tramp_parms *)arg - ffi_esp_tramp_parms;
+  return ffi_esp_tramp_code + idx * ESP_TRAMP_SIZE;
+}
+
+void
+ffi_tramp_free (void *arg)
+{
+  size_t idx = (esp_tramp_parms *)arg - ffi_esp_tramp_parms;
+  __atomic_fetch_and (&esp_tramp_used[idx / 32], ~(1u << (idx % 32)), __ATOMIC_RELEASE);
+}
+
+int
+ffi_tramp_owns (void *arg)
+{
+  return (esp_tramp_parms *)arg >= ffi_esp_tramp_parms
+         && (esp_tramp_parms *)arg < ffi_esp_tramp_parms + ESP_TRAMP_COUNT;
+}
+
 #else /* !FFI_EXEC_STATIC_TRAMP */
 
 #include <stddef.h>
@@ -734,4 +827,10 @@ ffi_tramp_free (void *arg)
 {
 }
 
+int
+ffi_tramp_owns (void *arg)
+{
+  return 0;
+}
+
 #endif /* FFI_EXEC_STATIC_TRAMP */
@@ -23,6 +23,7 @@
 #include <ffi.h>
 #include <ffi_common.h>
 #include "ffitarget_esp.h"
+#include <tramp.h>
 
 #include <stdlib.h>
 #include <stdint.h>
@@ -363,9 +364,64 @@ static int passed_by_ref(call_builder *cb, ffi_type *type, int var) {
  * что гарантирует консистентность во всем проекте.
  */
 
+/*
+ * Быстрый вызов: до NARGREG аргументов, каждый целиком в одном целочисленном регистре
+ * (целые до 32 бит, указатели, float при soft-float ABI), возврат void или такого же
+ * атома. Такие CIF вызываются прямым приведением fn к функции от NARGREG слов - без
+ * call_builder, marshal и ffi_call_asm. В riscv_fastcall по 3 бита на вид аргумента,
+ * вид результата с FAST_RET_SHIFT и признак FAST_CALL.
+ */
+#define FAST_CALL       0x80000000u
+#define FAST_ARG_BITS   3
+#define FAST_RET_SHIFT  24
+
+enum {
+    FAST_WORD = 0,  /* uint32/sint32/pointer/float - значение как есть */
+    FAST_U8,
+    FAST_S8,
+    FAST_U16,
+    FAST_S16,
+    FAST_VOID,      /* Только для результата */
+    FAST_NONE
+};
+
+static unsigned fast_kind(const ffi_type *type) {
+    switch (type->type) {
+        case FFI_TYPE_UINT8:   return FAST_U8;
+        case FFI_TYPE_SINT8:   return FAST_S8;
+        case FFI_TYPE_UINT16:  return FAST_U16;
+        case FFI_TYPE_SINT16:  return FAST_S16;
+#if __SIZEOF_POINTER__ == 4
+        case FFI_TYPE_UINT32:
+        case FFI_TYPE_SINT32:
+#endif
+        case FFI_TYPE_POINTER: return FAST_WORD;
+#if !ABI_FLEN
+        case FFI_TYPE_FLOAT:   return FAST_WORD;
+#endif
+        default:               return FAST_NONE;
+    }
+}
+
+static unsigned classify_fast_call(const ffi_cif *cif) {
+    if (cif->abi != FFI_SYSV || cif->nargs > NARGREG) return 0;
+
+    unsigned ret_kind = cif->rtype->type == FFI_TYPE_VOID ? FAST_VOID : fast_kind(cif->rtype);
+    if (ret_kind == FAST_NONE) return 0;
+
+    unsigned flags = FAST_CALL | (ret_kind << FAST_RET_SHIFT);
+    for (unsigned i = 0; i < cif->nargs; i++) {
+        unsigned kind = fast_kind(cif->arg_types[i]);
+        if (kind == FAST_NONE) return 0;
+        flags |= kind << (i * FAST_ARG_BITS);
+    }
+    return flags;
+}
+
 ffi_status ffi_prep_cif_machdep(ffi_cif *cif) {
     /* Для обычных функций количество фиксированных аргументов равно общему количеству */
     cif->flags = cif->nargs;
+    cif->riscv_fastcall = classify_fast_call(cif);
     return FFI_OK;
 }
 
@@ -374,6 +430,7 @@ ffi_status ffi_prep_cif_machdep(ffi_cif *cif) {
 ffi_status ffi_prep_cif_machdep_var(ffi_cif *cif, unsigned int nfixedargs, unsigned int ntotalargs) {
     /* Сохраняем количество фиксированных аргументов в cif->flags */
     cif->flags = nfixedargs;
+    cif->riscv_fastcall = 0;
     return FFI_OK;
 }
 
@@ -426,9 +483,47 @@ ffi_status ffi_call_int(ffi_cif *cif, void (*fn)(void), void *rvalue,
     return FFI_OK;
 }
 
+/* Все аргументы в a0..a7: лишние регистры вызываемая функция не читает */
+typedef size_t (*fast_fn_t)(size_t, size_t, size_t, size_t, size_t, size_t, size_t, size_t);
+
+static inline size_t fast_load(unsigned kind, const void *data) {
+    switch (kind) {
+        case FAST_U8:  return *(const uint8_t *)data;
+        case FAST_S8:  return (size_t)*(const int8_t *)data;
+        case FAST_U16: return *(const uint16_t *)data;
+        case FAST_S16: return (size_t)*(const int16_t *)data;
+        default:       return *(const uint32_t *)data;
+    }
+}
+
+static void ffi_call_fast(ffi_cif *cif, void (*fn)(void), void *rvalue, void **avalue) {
+    unsigned flags = cif->riscv_fastcall;
+    size_t a[NARGREG] = {0};
+    for (unsigned i = 0; i < cif->nargs; i++) {
+        a[i] = fast_load((flags >> (i * FAST_ARG_BITS)) & 7u, avalue[i]);
+    }
+
+    size_t value = ((fast_fn_t)fn)(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]);
+
+    if (!rvalue) return;
+    switch ((flags >> FAST_RET_SHIFT) & 7u) {
+        case FAST_VOID: break;
+        case FAST_U8:   *(uint8_t *)rvalue = value; break;
+        case FAST_S8:   *(int8_t *)rvalue = value; break;
+        case FAST_U16:  *(uint16_t *)rvalue = value; break;
+        case FAST_S16:  *(int16_t *)rvalue = value; break;
+        default:        *(size_t *)rvalue = value; break;
+    }
+}
+
 void
 ffi_call (ffi_cif *cif, void (*fn) (void), void *rvalue, void **avalue)
 {
+  if (cif->riscv_fastcall & FAST_CALL)
+    {
+      ffi_call_fast(cif, fn, rvalue, avalue);
+      return;
+    }
   ffi_call_int(cif, fn, rvalue, avalue, NULL);
 }
 
@@ -466,6 +561,14 @@ ffi_prep_closure_loc (ffi_closure *closure,
     closure->fun = fun;
     closure->user_data = user_data;
 
+#if defined(CONFIG_LIBFFI_STATIC_TRAMPOLINES)
+    if (ffi_tramp_is_present(closure)) {
+        /* Статический трамплин: только два указателя в DRAM, без записи кода и fence.i */
+        ffi_tramp_set_parms(closure->ftramp, (void *)ffi_closure_asm, closure);
+        return FFI_OK;
+    }
+#endif
+
     /*
      * Генерация tramp для RISC-V (RV32I):
      *
@@ -36,7 +36,7 @@
 typedef unsigned long ffi_arg;
 typedef   signed long ffi_sarg;
 
-/* FFI_UNUSED_NN and riscv_unused are to maintain ABI compatibility with a
+/* FFI_UNUSED_NN are to maintain ABI compatibility with a
    distributed Berkeley patch from 2014, and can be removed at SONAME bump */
 typedef enum ffi_abi {
     FFI_FIRST_ABI = 0,
@@ -57,7 +57,8 @@ typedef enum ffi_abi {
 #define FFI_GO_CLOSURES 1
 #define FFI_TRAMPOLINE_SIZE 24
 #define FFI_NATIVE_RAW_API 0
-#define FFI_EXTRA_CIF_FIELDS unsigned riscv_nfixedargs; unsigned riscv_unused;
+/* riscv_fastcall: класс быстрого вызова, выставляется в ffi_prep_cif_machdep (ffi_esp.c) */
+#define FFI_EXTRA_CIF_FIELDS unsigned riscv_nfixedargs; unsigned riscv_fastcall;
 #define FFI_TARGET_SPECIFIC_VARIADIC 0
 
 #endif